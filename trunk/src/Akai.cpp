@@ -36,6 +36,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <errno.h>
+#if defined(_CARBON_) || defined(__APPLE__) || LINUX
+# include <sys/mman.h>
+#endif
 #if defined(_CARBON_) || defined(__APPLE__)
 #include <paths.h>
 #include <sys/ioctl.h>
@@ -305,6 +308,35 @@ static struct _CDTOC * ReadTOC(const char *devpath) {
 
 #endif // defined(_CARBON_) || defined(__APPLE__)
 
+//////////////////////////////////
+// Sample allocator:
+static akai_allocator_t* pSampleAllocator = NULL;
+
+void AkaiSetSampleAllocator(akai_allocator_t* pAllocator)
+{
+  pSampleAllocator = pAllocator;
+}
+
+akai_allocator_t* AkaiGetSampleAllocator()
+{
+  return pSampleAllocator;
+}
+
+static void* AllocateSampleBuffer(size_t Size)
+{
+  if (pSampleAllocator && pSampleAllocator->allocate)
+    return pSampleAllocator->allocate(pSampleAllocator, Size);
+  return malloc(Size);
+}
+
+static void FreeSampleBuffer(void* pData, size_t Size)
+{
+  if (pSampleAllocator && pSampleAllocator->deallocate)
+    pSampleAllocator->deallocate(pSampleAllocator, pData, Size);
+  else
+    free(pData);
+}
+
 //////////////////////////////////
 // AkaiSample:
 AkaiSample::AkaiSample(DiskImage* pDisk, AkaiVolume* pParent, const AkaiDirEntry& DirEntry)
@@ -314,6 +346,7 @@ AkaiSample::AkaiSample(DiskImage* pDisk, AkaiVolume* pParent, const AkaiDirEntry
   mpDisk = pDisk;
   mDirEntry = DirEntry;
   mpSamples = NULL;
+  mSamplesMapped = false;
   mHeaderOK = false;
   mPos = 0;
 
@@ -323,8 +356,7 @@ AkaiSample::AkaiSample(DiskImage* pDisk, AkaiVolume* pParent, const AkaiDirEntry
 
 AkaiSample::~AkaiSample()
 {
-  if (mpSamples)
-    free(mpSamples);
+  ReleaseSampleData();
 }
 
 AkaiDirEntry AkaiSample::GetDirEntry()
@@ -339,8 +371,19 @@ bool AkaiSample::LoadSampleData()
   if (mpSamples)
     return true;
 
+#if !WORDS_BIGENDIAN
+  // sample data is stored as little endian 16 bit words, so on little endian
+  // machines we can simply use the (copy-on-write) mapping of the image file
+  void* pMapped = mpDisk->GetMappedData(mImageOffset, mNumberOfSamples * sizeof(int16_t));
+  if (pMapped && !((uintptr_t)pMapped & 1)) {
+    mpSamples = (int16_t*) pMapped;
+    mSamplesMapped = true;
+    return true;
+  }
+#endif
+
   mpDisk->SetPos(mImageOffset);
-  mpSamples = (int16_t*) malloc(mNumberOfSamples * sizeof(int16_t));
+  mpSamples = (int16_t*) AllocateSampleBuffer(mNumberOfSamples * sizeof(int16_t));
   if (!mpSamples)
     return false;
 
@@ -352,8 +395,10 @@ void AkaiSample::ReleaseSampleData()
 {
   if (!mpSamples)
     return;
-  free(mpSamples);
+  if (!mSamplesMapped)
+    FreeSampleBuffer(mpSamples, mNumberOfSamples * sizeof(int16_t));
   mpSamples = NULL;
+  mSamplesMapped = false;
 }
 
 int AkaiSample::SetPos(int Where, akai_stream_whence_t Whence)
@@ -379,17 +424,105 @@ int AkaiSample::SetPos(int Where, akai_stream_whence_t Whence)
   return mPos;
 }
 
+/**
+ * Reads SampleCount sample points from the current position (see SetPos())
+ * into the caller supplied buffer and advances the position accordingly.
+ * This allows streaming a sample block by block in constant memory. If the
+ * sample was already loaded into RAM with LoadSampleData(), the data is
+ * copied from there instead of reading it from disk again.
+ *
+ * @param pBuffer     - destination buffer for at least SampleCount 16 bit words
+ * @param SampleCount - amount of sample points to read
+ * @returns amount of sample points actually read
+ */
 int AkaiSample::Read(void* pBuffer, uint SampleCount)
 {
-  if (!mHeaderOK) return 0;
+  if (!LoadHeader()) return 0;
 
-  if (mPos + SampleCount > mNumberOfSamples) SampleCount = mNumberOfSamples - mPos;
+  if ((uint32_t)mPos >= mNumberOfSamples) return 0;
+  if (SampleCount > mNumberOfSamples - mPos) SampleCount = mNumberOfSamples - mPos;
 
-  mpDisk->SetPos(mImageOffset + mPos * 2); // FIXME: assumes 16 bit sample depth
-  mpDisk->ReadInt16((uint16_t*)pBuffer, SampleCount);
+  if (mpSamples) {
+    memcpy(pBuffer, mpSamples + mPos, SampleCount * sizeof(int16_t));
+  } else {
+    mpDisk->SetPos(mImageOffset + mPos * 2); // FIXME: assumes 16 bit sample depth
+    mpDisk->ReadInt16((uint16_t*)pBuffer, SampleCount);
+  }
+  mPos += SampleCount;
   return SampleCount;
 }
 
+/**
+ * Returns the format and length of this sample as stream (see
+ * SampleStream::Source): Akai samples are always mono 16 bit.
+ */
+SampleStream::info_t AkaiSample::GetStreamInfo()
+{
+  SampleStream::info_t info;
+  if (!LoadHeader()) return info;
+  info.Channels    = 1;
+  info.BitDepth    = 16;
+  info.FrameSize   = 2;
+  info.SampleRate  = mSamplingFrequency;
+  info.SampleCount = mNumberOfSamples;
+  return info;
+}
+
+/**
+ * Reads sample points from any position in the given output format (see
+ * SampleStream::Source). Like Read() the data is copied from RAM if the
+ * sample was loaded by LoadSampleData(), otherwise it is read from disk and
+ * the read position of SetPos() is restored afterwards.
+ */
+SampleStream::pos_t AkaiSample::ReadStream(SampleStream::pos_t Pos, void* pBuffer, SampleStream::pos_t SampleCount, SampleStream::format_t Format)
+{
+  const SampleStream::info_t info = GetStreamInfo();
+  if (Pos >= info.SampleCount) return 0;
+  if (SampleCount > info.SampleCount - Pos) SampleCount = info.SampleCount - Pos;
+  if (Format == SampleStream::format_float)
+    return ReadStreamConverted(info, Pos, pBuffer, SampleCount, Format);
+  if (mpSamples) {
+    memcpy(pBuffer, mpSamples + Pos, size_t(SampleCount) * sizeof(int16_t));
+    return SampleCount;
+  }
+  const int oldPos = mPos;
+  mPos = (int) Pos;
+  const int n = Read(pBuffer, (uint) SampleCount);
+  mPos = oldPos;
+  return (n > 0) ? n : 0;
+}
+
+/**
+ * Returns the first active loop of this sample (if any and if the loop
+ * mode is not "none"). The loop marker is the end of the loop, the coarse
+ * length is counted backwards from there; the fine length is ignored. The
+ * loop time is a duration, so the loop is reported as infinite.
+ */
+bool AkaiSample::GetStreamLoop(SampleStream::loop_t& Loop)
+{
+  Loop = SampleStream::loop_t();
+  if (!LoadHeader() || mLoopMode == 2 || !mFirstActiveLoop || mFirstActiveLoop > 8)
+    return false;
+  const AkaiSampleLoop& l = mLoops[mFirstActiveLoop - 1];
+  if (!l.mCoarseLength || l.mCoarseLength > l.mMarker || l.mMarker > mNumberOfSamples)
+    return false;
+  Loop.Start = l.mMarker - l.mCoarseLength;
+  Loop.End   = l.mMarker;
+  return true;
+}
+
+/**
+ * Returns the sample data loaded (or mapped) by LoadSampleData(), if any.
+ */
+SampleStream::head_t AkaiSample::GetStreamHead()
+{
+  SampleStream::head_t head;
+  if (!mpSamples) return head;
+  head.pData       = mpSamples;
+  head.SampleCount = mNumberOfSamples;
+  return head;
+}
+
 bool AkaiSample::LoadHeader()
 {
   if (mHeaderOK)
@@ -485,6 +618,7 @@ AkaiProgram::AkaiProgram(DiskImage* pDisk, AkaiVolume* pParent, const AkaiDirEnt
   mpDisk = pDisk;
   mDirEntry = DirEntry;
   mpKeygroups = NULL;
+  BuildKeyTable(0);
   Load();
 }
 
@@ -627,14 +761,73 @@ bool AkaiProgram::Load()
     if (!mpKeygroups[i].Load(mpDisk))
     {
       mpDisk->SetPos(temppos);
+      BuildKeyTable(i);
       return false;
     }
   }
 
   mpDisk->SetPos(temppos);
+  BuildKeyTable(mNumberOfKeygroups);
   return true;
 }
 
+// Builds the note to keygroup lookup table from the first Keygroups
+// keygroups (the ones loaded successfully).
+void AkaiProgram::BuildKeyTable(uint Keygroups)
+{
+  mKeyKeygroups.clear();
+  mKeyZones.clear();
+  for (uint key = 0; key < 128; key++)
+  {
+    mKeyKeygroupsOffset[key] = mKeyKeygroups.size();
+    mKeyZonesOffset[key] = mKeyZones.size();
+    for (uint i = 0; i < Keygroups; i++)
+    {
+      AkaiKeygroup* pKeygroup = &mpKeygroups[i];
+      if (key < pKeygroup->mLowKey || key > pKeygroup->mHighKey) continue;
+      mKeyKeygroups.push_back(pKeygroup);
+      const uint zones = (pKeygroup->mVelocityZoneUsed < 4) ? pKeygroup->mVelocityZoneUsed : 4;
+      for (uint z = 0; z < zones; z++)
+      {
+        const AkaiKeygroupSample& sample = pKeygroup->mSamples[z];
+        if (sample.mName.empty()) continue;
+        AkaiKeygroupZone zone;
+        zone.mpKeygroup    = pKeygroup;
+        zone.mSample       = z;
+        zone.mLowVelocity  = sample.mLowLevel;
+        zone.mHighVelocity = sample.mHighLevel;
+        mKeyZones.push_back(zone);
+      }
+    }
+  }
+  mKeyKeygroupsOffset[128] = mKeyKeygroups.size();
+  mKeyZonesOffset[128] = mKeyZones.size();
+}
+
+AkaiKeygroup* const* AkaiProgram::GetKeygroupsOfKey(uint Key, uint& rCount) const
+{
+  if (Key > 127)
+  {
+    rCount = 0;
+    return NULL;
+  }
+  rCount = mKeyKeygroupsOffset[Key + 1] - mKeyKeygroupsOffset[Key];
+  return (rCount) ? &mKeyKeygroups[mKeyKeygroupsOffset[Key]] : NULL;
+}
+
+uint AkaiProgram::GetZonesOfNote(uint Key, uint Velocity, AkaiKeygroupZone* pZones, uint MaxZones) const
+{
+  if (Key > 127) return 0;
+  uint count = 0;
+  for (uint i = mKeyZonesOffset[Key]; i < mKeyZonesOffset[Key + 1] && count < MaxZones; i++)
+  {
+    const AkaiKeygroupZone& zone = mKeyZones[i];
+    if (Velocity < zone.mLowVelocity || Velocity > zone.mHighVelocity) continue;
+    pZones[count++] = zone;
+  }
+  return count;
+}
+
 uint AkaiProgram::ListSamples(std::list<String>& rSamples)
 {
   return 0;
@@ -824,6 +1017,7 @@ AkaiVolume::AkaiVolume(DiskImage* pDisk, AkaiPartition* pParent, const AkaiDirEn
   mpDisk = pDisk;
   mpParent = pParent;
   mDirEntry = DirEntry;
+  mDirRead = false;
 
   if (mDirEntry.mType != AKAI_TYPE_DIR_S1000 && mDirEntry.mType != AKAI_TYPE_DIR_S3000)
   {
@@ -853,11 +1047,18 @@ AkaiVolume::~AkaiVolume()
   }
 }
 
+/**
+ * Reads the file entries of this volume's directory (only once). The
+ * actual AkaiProgram and AkaiSample objects (and with them their headers)
+ * are not created before they are requested with GetProgram() respectively
+ * GetSample() for the first time.
+ */
 uint AkaiVolume::ReadDir()
 {
   uint i;
-  if (mpPrograms.empty())
+  if (!mDirRead)
   {
+    mDirRead = true;
     uint maxfiles = ReadFAT(mpDisk, mpParent,mDirEntry.mStart) ? AKAI_MAX_FILE_ENTRIES_S1000 : AKAI_MAX_FILE_ENTRIES_S3000;
     for (i = 0; i < maxfiles; i++) 
     {
@@ -866,31 +1067,23 @@ uint AkaiVolume::ReadDir()
       DirEntry.mIndex = i;
       if (DirEntry.mType == 'p') 
       {
-        AkaiProgram* pProgram = new AkaiProgram(mpDisk, this, DirEntry);
-        pProgram->Acquire();
-        mpPrograms.push_back(pProgram);
+        mProgramEntries.push_back(DirEntry);
+        mpPrograms.push_back(NULL);
       }
       else if (DirEntry.mType == 's') 
       {
-        AkaiSample* pSample = new AkaiSample(mpDisk, this, DirEntry);
-        pSample->Acquire();
-        mpSamples.push_back(pSample);
+        mSampleEntries.push_back(DirEntry);
+        mpSamples.push_back(NULL);
       }
     }
   }
-  return (uint)(mpPrograms.size() + mpSamples.size());
+  return (uint)(mProgramEntries.size() + mSampleEntries.size());
 }
 
 uint AkaiVolume::ListPrograms(std::list<AkaiDirEntry>& rPrograms)
 {
-  rPrograms.clear();
   ReadDir();
-
-  std::list<AkaiProgram*>::iterator it;
-  std::list<AkaiProgram*>::iterator end = mpPrograms.end();
-  for (it = mpPrograms.begin(); it != end; it++)
-    if (*it)
-      rPrograms.push_back((*it)->GetDirEntry());
+  rPrograms = mProgramEntries;
   return (uint)rPrograms.size();
 }
 
@@ -898,18 +1091,20 @@ AkaiProgram* AkaiVolume::GetProgram(uint Index)
 {
   uint i = 0;
 
-  if (mpPrograms.empty())
-  {
-    std::list<AkaiDirEntry> dummy;
-    ListPrograms(dummy);
-  }
+  ReadDir();
 
   std::list<AkaiProgram*>::iterator it;
   std::list<AkaiProgram*>::iterator end = mpPrograms.end();
-  for (it = mpPrograms.begin(); it != end; it++)
+  std::list<AkaiDirEntry>::iterator itEntry = mProgramEntries.begin();
+  for (it = mpPrograms.begin(); it != end; it++, itEntry++)
   {
-    if (*it && i == Index)
+    if (i == Index)
     {
+      if (!*it)
+      {
+        *it = new AkaiProgram(mpDisk, this, *itEntry);
+        (*it)->Acquire();
+      }
       (*it)->Acquire();
       return *it;
     }
@@ -920,35 +1115,23 @@ AkaiProgram* AkaiVolume::GetProgram(uint Index)
 
 AkaiProgram* AkaiVolume::GetProgram(const String& rName)
 {
-  if (mpPrograms.empty())
-  {
-    std::list<AkaiDirEntry> dummy;
-    ListPrograms(dummy);
-  }
+  ReadDir();
 
-  std::list<AkaiProgram*>::iterator it;
-  std::list<AkaiProgram*>::iterator end = mpPrograms.end();
-  for (it = mpPrograms.begin(); it != end; it++)
+  uint i = 0;
+  std::list<AkaiDirEntry>::iterator it;
+  std::list<AkaiDirEntry>::iterator end = mProgramEntries.end();
+  for (it = mProgramEntries.begin(); it != end; it++, i++)
   {
-    if (*it && rName == (*it)->GetDirEntry().mName)
-    {
-      (*it)->Acquire();
-      return *it;
-    }
+    if (rName == it->mName)
+      return GetProgram(i);
   }
   return NULL;
 }
 
 uint AkaiVolume::ListSamples(std::list<AkaiDirEntry>& rSamples)
 {
-  rSamples.clear();
   ReadDir();
-
-  std::list<AkaiSample*>::iterator it;
-  std::list<AkaiSample*>::iterator end = mpSamples.end();
-  for (it = mpSamples.begin(); it != end; it++)
-    if (*it)
-      rSamples.push_back((*it)->GetDirEntry());
+  rSamples = mSampleEntries;
   return (uint)rSamples.size();
 }
 
@@ -956,18 +1139,20 @@ AkaiSample* AkaiVolume::GetSample(uint Index)
 {
   uint i = 0;
 
-  if (mpSamples.empty())
-  {
-    std::list<AkaiDirEntry> dummy;
-    ListSamples(dummy);
-  }
+  ReadDir();
 
   std::list<AkaiSample*>::iterator it;
   std::list<AkaiSample*>::iterator end = mpSamples.end();
-  for (it = mpSamples.begin(); it != end; it++)
+  std::list<AkaiDirEntry>::iterator itEntry = mSampleEntries.begin();
+  for (it = mpSamples.begin(); it != end; it++, itEntry++)
   {
-    if (*it && i == Index)
+    if (i == Index)
     {
+      if (!*it)
+      {
+        *it = new AkaiSample(mpDisk, this, *itEntry);
+        (*it)->Acquire();
+      }
       (*it)->Acquire();
       return *it;
     }
@@ -978,21 +1163,15 @@ AkaiSample* AkaiVolume::GetSample(uint Index)
 
 AkaiSample* AkaiVolume::GetSample(const String& rName)
 {
-  if (mpSamples.empty())
-  {
-    std::list<AkaiDirEntry> dummy;
-    ListSamples(dummy);
-  }
+  ReadDir();
 
-  std::list<AkaiSample*>::iterator it;
-  std::list<AkaiSample*>::iterator end = mpSamples.end();
-  for (it = mpSamples.begin(); it != end; it++)
+  uint i = 0;
+  std::list<AkaiDirEntry>::iterator it;
+  std::list<AkaiDirEntry>::iterator end = mSampleEntries.end();
+  for (it = mSampleEntries.begin(); it != end; it++, i++)
   {
-    if (*it && rName == (*it)->GetDirEntry().mName)
-    {
-      (*it)->Acquire();
-      return *it;
-    }
+    if (rName == it->mName)
+      return GetSample(i);
   }
   return NULL;
 }
@@ -1014,6 +1193,7 @@ AkaiPartition::AkaiPartition(DiskImage* pDisk, AkaiDisk* pParent)
 {
   mpDisk = pDisk;
   mpParent = pParent;
+  mVolumesRead = false;
 }
 
 AkaiPartition::~AkaiPartition()
@@ -1029,8 +1209,9 @@ uint AkaiPartition::ListVolumes(std::list<AkaiDirEntry>& rVolumes)
 {
   rVolumes.clear();
   uint i;
-  if (mpVolumes.empty())
+  if (!mVolumesRead)
   {
+    mVolumesRead = true;
     for (i = 0; i < AKAI_MAX_DIR_ENTRIES; i++)
     {
       AkaiDirEntry DirEntry;
@@ -1065,7 +1246,7 @@ AkaiVolume* AkaiPartition::GetVolume(uint Index)
 {
   uint i = 0;
 
-  if (mpVolumes.empty())
+  if (!mVolumesRead)
   {
     std::list<AkaiDirEntry> dummy;
     ListVolumes(dummy);
@@ -1087,7 +1268,7 @@ AkaiVolume* AkaiPartition::GetVolume(uint Index)
 
 AkaiVolume* AkaiPartition::GetVolume(const String& rName)
 {
-  if (mpVolumes.empty())
+  if (!mVolumesRead)
   {
     std::list<AkaiDirEntry> dummy;
     ListVolumes(dummy);
@@ -1179,9 +1360,13 @@ AkaiPartition* AkaiDisk::GetPartition(uint count)
 
 int AkaiDiskElement::ReadFAT(DiskImage* pDisk, AkaiPartition* pPartition, int block)
 { 
+  std::map<int,int>::iterator it = pPartition->mFATCache.find(block);
+  if (it != pPartition->mFATCache.end())
+    return it->second;
   int16_t value = 0;
   pDisk->SetPos(pPartition->GetOffset()+AKAI_FAT_OFFSET + block*2); 
   pDisk->Read(&value, 2,1); 
+  pPartition->mFATCache[block] = value;
   return value;
 }
 
@@ -1580,18 +1765,32 @@ void DiskImage::Init()
 {
   mFile        = 0;
   mPos         = 0;
+  mSize        = 0;
   mCluster     = (uint)-1;
+  mClusterSize = DISK_CLUSTER_SIZE;
+  mRegularFile = true;
   mStartFrame  = -1;
   mEndFrame    = -1;
+  // we allocate the cache later when we know what type of media we access
+  mpCache           = NULL;
+  mpCurrentCluster  = NULL;
+  mpSlotCluster     = NULL;
+  mpSlotStamp       = NULL;
+  mCacheClusters    = 0;
+  mReadAheadClusters = 0;
+  mStamp            = 0;
+  mReadAheadFirst   = -1;
+  mReadAheadCount   = 0;
+  mTransferSize     = 0;
+  mpMapping         = NULL;
 #ifdef WIN32
-  mpCache = (char*) VirtualAlloc(NULL,mClusterSize,MEM_COMMIT,PAGE_READWRITE);
-#else
-  mpCache = NULL; // we allocate the cache later when we know what type of media we access
+  mMapping          = NULL;
 #endif
 }
 
 DiskImage::~DiskImage()
 {
+  UnmapImage();
 #ifdef WIN32
   if (mFile != INVALID_HANDLE_VALUE)
   {
@@ -1603,6 +1802,138 @@ DiskImage::~DiskImage()
     close(mFile);
   }
 #endif
+  FreeCache();
+}
+
+/**
+ * Change the size of the cluster cache. The LRU cache keeps the given amount
+ * of clusters around, the read-ahead window is filled with one system call
+ * each time a read crosses into the cluster following the previously
+ * accessed one. Passing 0 for either argument restores the respective
+ * default, which is derived from DISK_CACHE_SIZE and DISK_READ_AHEAD_SIZE.
+ * A ReadAheadClusters value of 1 disables read-ahead.
+ *
+ * All currently cached data is discarded.
+ *
+ * @param Clusters          - amount of clusters in the LRU cache
+ * @param ReadAheadClusters - amount of clusters read ahead on sequential access
+ */
+void DiskImage::SetCacheSize(uint Clusters, uint ReadAheadClusters)
+{
+  FreeCache();
+  mCacheClusters     = Clusters;
+  mReadAheadClusters = ReadAheadClusters;
+}
+
+/**
+ * Change the maximum amount of bytes requested from a drive with one system
+ * call. On a drive each cluster is just one sector, so clusters missing in
+ * the cache are fetched as a whole transfer of this size, and the read-ahead
+ * window is filled with as many transfers as it takes. The size is rounded
+ * down to a multiple of the cluster size. Passing 0 restores the default
+ * DISK_TRANSFER_SIZE. Reads from regular image files are not affected.
+ *
+ * All currently cached data is discarded.
+ *
+ * @param Bytes - maximum size of one read request in bytes
+ */
+void DiskImage::SetTransferSize(uint Bytes)
+{
+  FreeCache();
+  mTransferSize = Bytes;
+}
+
+/**
+ * Maps the whole (regular) image file into memory. Read() then copies
+ * directly from the mapping instead of going through the cluster cache. The
+ * view is copy-on-write, so pointers returned by GetMappedData() may be
+ * written to without altering the image file. If mapping fails, the cluster
+ * cache is used as usual.
+ */
+void DiskImage::MapImage()
+{
+  if (!mRegularFile || mSize <= 0) return;
+#ifdef WIN32
+  mMapping = CreateFileMapping(mFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  if (!mMapping) return;
+  mpMapping = (char*) MapViewOfFile(mMapping, FILE_MAP_COPY, 0, 0, 0);
+  if (!mpMapping) {
+    CloseHandle(mMapping);
+    mMapping = NULL;
+  }
+#elif defined(_CARBON_) || defined(__APPLE__) || LINUX
+  void* p = mmap(NULL, mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, mFile, 0);
+  if (p == MAP_FAILED) return;
+  mpMapping = (char*) p;
+#endif
+}
+
+void DiskImage::UnmapImage()
+{
+  if (!mpMapping) return;
+#ifdef WIN32
+  UnmapViewOfFile(mpMapping);
+  CloseHandle(mMapping);
+  mMapping = NULL;
+#elif defined(_CARBON_) || defined(__APPLE__) || LINUX
+  munmap(mpMapping, mSize);
+#endif
+  mpMapping = NULL;
+}
+
+/**
+ * Returns a pointer to the requested range of the image file's memory
+ * mapping. The returned memory stays valid for the lifetime of this
+ * DiskImage object.
+ *
+ * @param Pos  - byte position in the image
+ * @param Size - amount of bytes requested
+ * @returns pointer to the data or NULL if the image is not memory-mapped or
+ *          the range exceeds the image
+ */
+void* DiskImage::GetMappedData(int Pos, int Size)
+{
+  if (!mpMapping || Pos < 0 || Size < 0 || Pos > mSize - Size) return NULL;
+  return mpMapping + Pos;
+}
+
+bool DiskImage::AllocateCache()
+{
+  if (!mCacheClusters) {
+    mCacheClusters = DISK_CACHE_SIZE / mClusterSize;
+    if (!mCacheClusters) mCacheClusters = 1;
+  }
+  if (!mReadAheadClusters) {
+    mReadAheadClusters = DISK_READ_AHEAD_SIZE / mClusterSize;
+    if (!mReadAheadClusters) mReadAheadClusters = 1;
+  }
+  if (!mTransferSize) mTransferSize = DISK_TRANSFER_SIZE;
+  if (mTransferSize < (uint) mClusterSize) mTransferSize = mClusterSize;
+  mTransferSize -= mTransferSize % mClusterSize;
+  const size_t size = size_t(mCacheClusters + mReadAheadClusters) * mClusterSize;
+#ifdef WIN32
+  // page aligned memory, required for unbuffered device access
+  mpCache = (char*) VirtualAlloc(NULL,size,MEM_COMMIT,PAGE_READWRITE);
+#else
+  void* p = NULL;
+  if (posix_memalign(&p, DISK_BUFFER_ALIGNMENT, size)) p = NULL;
+  mpCache = (char*) p;
+#endif
+  if (!mpCache) return false;
+  mpSlotCluster = new int[mCacheClusters];
+  mpSlotStamp   = new uint[mCacheClusters];
+  for (uint i = 0; i < mCacheClusters; i++) {
+    mpSlotCluster[i] = -1;
+    mpSlotStamp[i]   = 0;
+  }
+  mStamp          = 0;
+  mReadAheadFirst = -1;
+  mReadAheadCount = 0;
+  return true;
+}
+
+void DiskImage::FreeCache()
+{
   if (mpCache)
   {
 #ifdef WIN32
@@ -1610,7 +1941,16 @@ DiskImage::~DiskImage()
 #elif defined(_CARBON_) || defined(__APPLE__) || LINUX
     free(mpCache);
 #endif
+    mpCache = NULL;
   }
+  if (mpSlotCluster) delete[] mpSlotCluster;
+  if (mpSlotStamp)   delete[] mpSlotStamp;
+  mpSlotCluster    = NULL;
+  mpSlotStamp      = NULL;
+  mpCurrentCluster = NULL;
+  mCluster         = (uint)-1;
+  mReadAheadFirst  = -1;
+  mReadAheadCount  = 0;
 }
 
 akai_stream_state_t DiskImage::GetState() const
@@ -1660,15 +2000,20 @@ int DiskImage::Read(void* pData, uint WordCount, uint WordSize)
   int readbytes = 0;
   int sizetoread = WordCount * WordSize;
 
+  if (mpMapping) { // memory-mapped image file, no caching needed
+    if (mSize <= mPos) return 0;
+    readbytes = (sizetoread > mSize - mPos) ? mSize - mPos : sizetoread;
+    memcpy(pData, mpMapping + mPos, readbytes);
+    mPos += readbytes;
+    return readbytes / WordSize;
+  }
+
   while (sizetoread > 0) {
     if (mSize <= mPos) return readbytes / WordSize;
     int requestedCluster = (mRegularFile) ? mPos / mClusterSize
                                           : mPos / mClusterSize + mStartFrame;
-    if (mCluster != requestedCluster) { // read the requested cluster into cache
-      mCluster = requestedCluster;
-#ifdef WIN32
-      if (mCluster * mClusterSize != SetFilePointer(mFile, mCluster * mClusterSize, NULL, FILE_BEGIN)) {
-        printf("ERROR: couldn't seek device!\n");
+    if (mCluster != requestedCluster || !mpCurrentCluster) { // look up the requested cluster in cache
+      if (!GetCluster(requestedCluster)) {
 #if 0 // FIXME: endian correction is missing correct detection
         if ((readbytes > 0) && (mEndian != eEndianNative)) {
           switch (WordSize) {
@@ -1680,15 +2025,6 @@ int DiskImage::Read(void* pData, uint WordCount, uint WordSize)
 #endif
         return readbytes / WordSize;
       }
-      DWORD size;
-      ReadFile(mFile, mpCache, mClusterSize, &size, NULL);
-#elif defined(_CARBON_) || defined(__APPLE__) || LINUX
-      if (mCluster * mClusterSize != lseek(mFile, mCluster * mClusterSize, SEEK_SET))
-        return readbytes / WordSize;
-//          printf("trying to read %d bytes from device!\n",mClusterSize);
-      /*int size =*/ read(mFile, mpCache, mClusterSize);
-//          printf("read %d bytes from device!\n",size);
-#endif
     }
 //      printf("read %d bytes at pos %d\n",WordCount*WordSize,mPos);
 
@@ -1696,8 +2032,10 @@ int DiskImage::Read(void* pData, uint WordCount, uint WordSize)
     int posInCluster = mPos % mClusterSize;
     if (currentReadSize > mClusterSize - posInCluster) // restrict to this current cached cluster.
       currentReadSize = mClusterSize - posInCluster;
+    if (currentReadSize > mSize - mPos) // don't read beyond the end of the medium
+      currentReadSize = mSize - mPos;
 
-    memcpy((uint8_t*)pData + readbytes, mpCache + posInCluster, currentReadSize);
+    memcpy((uint8_t*)pData + readbytes, mpCurrentCluster + posInCluster, currentReadSize);
 
     mPos       += currentReadSize;
     readbytes  += currentReadSize;
@@ -1718,22 +2056,154 @@ int DiskImage::Read(void* pData, uint WordCount, uint WordSize)
   return readbytes / WordSize;
 }
 
+/**
+ * Returns the cached data of the requested cluster, reading it from the
+ * medium if required. The cluster becomes the current one (mCluster,
+ * mpCurrentCluster). Clusters directly following the previously accessed
+ * one are read ahead in one go into the read-ahead window, all other ones
+ * are read individually into the least recently used slot of the cache.
+ * When reading from a drive, a miss of a non-sequential cluster reads one
+ * whole transfer (mTransferSize) into the read-ahead window instead, of which
+ * the requested cluster is also kept in the LRU cache.
+ *
+ * @param Cluster - absolute cluster (respectively frame) number on the medium
+ * @returns pointer to the cluster's data or NULL on error
+ */
+char* DiskImage::GetCluster(int Cluster)
+{
+  if (!mpCache && !AllocateCache()) return NULL;
+  char* pWindow = mpCache + size_t(mCacheClusters) * mClusterSize;
+  char* pData   = NULL;
+  if (Cluster >= mReadAheadFirst && Cluster < mReadAheadFirst + mReadAheadCount) {
+    pData = pWindow + size_t(Cluster - mReadAheadFirst) * mClusterSize;
+  } else {
+    uint lru = 0;
+    for (uint i = 0; i < mCacheClusters; i++) {
+      if (mpSlotCluster[i] == Cluster) {
+        mpSlotStamp[i] = ++mStamp;
+        pData = mpCache + size_t(i) * mClusterSize;
+        break;
+      }
+      if (mpSlotStamp[i] < mpSlotStamp[lru]) lru = i;
+    }
+    if (!pData) { // cache miss
+      const int lastCluster = ((mRegularFile) ? 0 : mStartFrame) + (mSize - 1) / mClusterSize;
+      if (mReadAheadClusters > 1 && Cluster == mCluster + 1 && Cluster < lastCluster) {
+        int count = lastCluster - Cluster + 1;
+        if (count > (int) mReadAheadClusters) count = mReadAheadClusters;
+        mReadAheadCount = 0;
+        const int n = ReadClusters(Cluster, count, pWindow);
+        if (n <= 0) return NULL;
+        mReadAheadFirst = Cluster;
+        mReadAheadCount = n;
+        pData = pWindow;
+      } else if (!mRegularFile && mReadAheadClusters > 1 && Cluster < lastCluster) {
+        // avoid a round trip to the drive for each single sector
+        int count = lastCluster - Cluster + 1;
+        if (count > int(mTransferSize / mClusterSize)) count = mTransferSize / mClusterSize;
+        if (count > (int) mReadAheadClusters) count = mReadAheadClusters;
+        mReadAheadCount = 0;
+        const int n = ReadClusters(Cluster, count, pWindow);
+        if (n <= 0) return NULL;
+        mReadAheadFirst = Cluster;
+        mReadAheadCount = n;
+        memcpy(mpCache + size_t(lru) * mClusterSize, pWindow, mClusterSize);
+        mpSlotCluster[lru] = Cluster;
+        mpSlotStamp[lru]   = ++mStamp;
+        pData = pWindow;
+      } else {
+        mpSlotCluster[lru] = -1;
+        if (ReadClusters(Cluster, 1, mpCache + size_t(lru) * mClusterSize) <= 0)
+          return NULL;
+        mpSlotCluster[lru] = Cluster;
+        mpSlotStamp[lru]   = ++mStamp;
+        pData = mpCache + size_t(lru) * mClusterSize;
+      }
+    }
+  }
+  mCluster         = Cluster;
+  mpCurrentCluster = pData;
+  return pData;
+}
+
+/**
+ * Reads consecutive clusters from the medium. Regular image files are read
+ * with one system call, drives with one system call per mTransferSize bytes.
+ *
+ * @param FirstCluster - absolute number of the first cluster to read
+ * @param Count        - amount of clusters to read
+ * @param pDest        - destination buffer of at least Count clusters
+ * @returns amount of clusters read (the last one possibly only partially,
+ *          if the end of the medium was reached) or -1 on error
+ */
+int DiskImage::ReadClusters(int FirstCluster, int Count, char* pDest)
+{
+  if (!mRegularFile && mTransferSize && Count * mClusterSize > (int) mTransferSize) {
+    const int perTransfer = mTransferSize / mClusterSize;
+    int done = 0;
+    while (done < Count) {
+      const int count = (Count - done > perTransfer) ? perTransfer : Count - done;
+      const int n = ReadClusters(FirstCluster + done, count, pDest + size_t(done) * mClusterSize);
+      if (n < 0) return (done) ? done : -1;
+      done += n;
+      if (n < count) break; // end of medium
+    }
+    return done;
+  }
+#ifdef WIN32
+  if (FirstCluster * mClusterSize != SetFilePointer(mFile, FirstCluster * mClusterSize, NULL, FILE_BEGIN)) {
+    printf("ERROR: couldn't seek device!\n");
+    return -1;
+  }
+  DWORD size;
+  if (!ReadFile(mFile, pDest, Count * mClusterSize, &size, NULL))
+    return -1;
+#elif defined(_CARBON_) || defined(__APPLE__) || LINUX
+  if (FirstCluster * mClusterSize != lseek(mFile, FirstCluster * mClusterSize, SEEK_SET))
+    return -1;
+//      printf("trying to read %d bytes from device!\n",Count * mClusterSize);
+  ssize_t size = read(mFile, pDest, Count * mClusterSize);
+//      printf("read %d bytes from device!\n",size);
+  if (size < 0) return -1;
+#endif
+  return ((int) size + mClusterSize - 1) / mClusterSize;
+}
+
 void DiskImage::ReadInt8(uint8_t* pData, uint WordCount) {
   Read(pData, WordCount, 1);
 }
 
+#if WORDS_BIGENDIAN
+// Plain loops over whole words, so the compiler is able to turn them into
+// SIMD byte shuffles (e.g. AltiVec / NEON) for bulk sample data.
+static void swapWords_16(uint16_t* pData, uint WordCount) {
+  for (uint i = 0; i < WordCount; i++)
+    pData[i] = uint16_t((pData[i] >> 8) | (pData[i] << 8));
+}
+
+static void swapWords_32(uint32_t* pData, uint WordCount) {
+  for (uint i = 0; i < WordCount; i++)
+    pData[i] = (pData[i] >> 24) | ((pData[i] >> 8) & 0x0000ff00) |
+               ((pData[i] << 8) & 0x00ff0000) | (pData[i] << 24);
+}
+#endif
+
 void DiskImage::ReadInt16(uint16_t* pData, uint WordCount) {
-  int i;
-  for (i = 0; i < WordCount; i++) {
-    *(pData + i) = ReadInt16();
-  }
+#if WORDS_BIGENDIAN
+  int words = Read(pData, WordCount, 2);
+  if (words > 0) swapWords_16(pData, words);
+#else
+  Read(pData, WordCount, 2);
+#endif
 }
 
 void DiskImage::ReadInt32(uint32_t* pData, uint WordCount) {
-  int i;
-  for (i = 0; i < WordCount; i++) {
-    *(pData + i) = ReadInt32();
-  }
+#if WORDS_BIGENDIAN
+  int words = Read(pData, WordCount, 4);
+  if (words > 0) swapWords_32(pData, words);
+#else
+  Read(pData, WordCount, 4);
+#endif
 }
 
 int DiskImage::ReadInt8(uint8_t* pData) {
@@ -1789,6 +2259,7 @@ void DiskImage::OpenStream(const char* path) {
   BY_HANDLE_FILE_INFORMATION FileInfo;
   GetFileInformationByHandle(mFile,&FileInfo);
   mSize = FileInfo.nFileSizeLow;
+  MapImage();
 #elif defined(_CARBON_) || defined(__APPLE__) || LINUX
   struct stat filestat;
   stat(path,&filestat);
@@ -1804,14 +2275,13 @@ void DiskImage::OpenStream(const char* path) {
     mRegularFile = true;
     mSize        = (int) filestat.st_size;
     mClusterSize = DISK_CLUSTER_SIZE;
-    mpCache = (char*) malloc(mClusterSize);
+    MapImage();
   } else { // CDROM
 #if defined(_CARBON_) || defined(__APPLE__)
     printf("Can't open %s: not a regular file\n", path);
 #else // Linux ...
     mRegularFile = false;
     mClusterSize = CD_FRAMESIZE;
-    mpCache = (char*) malloc(mClusterSize);
 
     struct cdrom_tochdr   tochdr;
     struct cdrom_tocentry tocentry;
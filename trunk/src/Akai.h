@@ -40,11 +40,15 @@
 #include <stdlib.h>
 #include <iostream>
 #include <list>
+#include <vector>
+#include <map>
 #include <fstream>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/fcntl.h>
 
+#include "SampleStream.h"
+
 #if defined(_CARBON_) || defined(__APPLE__) || LINUX
 # include <sys/ioctl.h>
 # include <unistd.h>
@@ -78,6 +82,22 @@ typedef enum {
   akai_stream_end    = 2
 } akai_stream_whence_t;
 
+/** @brief Allocator for sample data loaded into RAM (see AkaiSetSampleAllocator()).
+ *
+ * Allows applications to provide their own memory for the sample data of
+ * AkaiSample::LoadSampleData(), e.g. memory locked by mlock() to avoid page
+ * faults on a real-time audio thread.
+ */
+struct akai_allocator_t
+{
+  void* (*allocate)(akai_allocator_t* pAllocator, size_t Size); ///< Must return a buffer of at least Size bytes, or NULL if out of memory.
+  void  (*deallocate)(akai_allocator_t* pAllocator, void* pData, size_t Size); ///< Frees a buffer returned by allocate, Size is the same value that was passed to allocate.
+  void* custom; ///< This pointer can be used for arbitrary data.
+};
+
+void AkaiSetSampleAllocator(akai_allocator_t* pAllocator); ///< Install allocator for sample data (NULL = malloc() / free()), must not be changed while sample data is loaded.
+akai_allocator_t* AkaiGetSampleAllocator(); ///< Returns allocator installed by AkaiSetSampleAllocator(), NULL if none.
+
 
 /* We need to cache IO access to reduce IO system calls which else would slow
    down things tremendously. For that we differ between the following two
@@ -87,6 +107,19 @@ typedef enum {
    DISK_CLUSTER_SIZE  for normal IO access (e.g. from hard disk)
 
    Not yet sure if these are the optimum sizes.
+
+   Several of those clusters are kept in a small LRU cache, so that jumping
+   back and forth between directory and header data does not hit the medium
+   every time. Sequential reads (i.e. sample data) are additionally served by
+   a read-ahead window, which fetches several consecutive clusters with one
+   system call. Both are sized in bytes by default and can be changed with
+   DiskImage::SetCacheSize().
+
+   When reading from a drive, where a cluster is just one sector, clusters
+   which are not in the cache are never fetched individually: each miss
+   reads a whole transfer of DISK_TRANSFER_SIZE bytes (see
+   DiskImage::SetTransferSize()) and larger reads are split into transfers
+   of that size, to avoid a round trip to the drive for every sector.
  */
 
 #ifndef CD_FRAMESIZE
@@ -95,6 +128,11 @@ typedef enum {
 
 #define DISK_CLUSTER_SIZE 61440 /* 60 kB */
 
+#define DISK_CACHE_SIZE      983040 /* 960 kB, default size of the LRU cluster cache */
+#define DISK_READ_AHEAD_SIZE 491520 /* 480 kB, default size of the read-ahead window */
+#define DISK_TRANSFER_SIZE   65536  /* 64 kB, default maximum size of one read request to a drive */
+#define DISK_BUFFER_ALIGNMENT 4096  /* alignment of the cache memory, required for unbuffered device access */
+
 typedef std::string String;
 
 /** @brief Accessing AKAI image either from file or a drive (i.e. CDROM).
@@ -112,6 +150,9 @@ public:
   DiskImage(int disk); ///< Open an image from a device number (0='a:', 1='b:', etc...).
 
   bool WriteImage(const char* path); ///< Extract Akai data track and write it into a regular file.
+  void SetCacheSize(uint Clusters, uint ReadAheadClusters); ///< Set amount of cached clusters and of clusters read ahead on sequential access (0 = default).
+  void SetTransferSize(uint Bytes); ///< Set maximum amount of bytes read from a drive with one system call (0 = DISK_TRANSFER_SIZE).
+  void* GetMappedData(int Pos, int Size); ///< Returns pointer to the given range of the memory-mapped image file, NULL if not mapped.
 
   virtual ~DiskImage();
 
@@ -151,15 +192,34 @@ protected:
 #endif
   bool mRegularFile;
   int mPos;
-  int mCluster;
+  int mCluster; ///< Cluster accessed last.
   int mClusterSize;
   int mSize; /* in bytes */
   /* start and end of the data track we chose (if we're reading from CDROM) */
   int mStartFrame;
   int mEndFrame;
-  char* mpCache;
+  char* mpCache; ///< Cluster memory: mCacheClusters LRU slots, followed by the read-ahead window.
+  char* mpCurrentCluster; ///< Cached data of cluster mCluster.
+  uint mCacheClusters; ///< Amount of LRU slots (0 = derive from DISK_CACHE_SIZE).
+  uint mReadAheadClusters; ///< Size of the read-ahead window in clusters (0 = derive from DISK_READ_AHEAD_SIZE).
+  int* mpSlotCluster; ///< Cluster held by the respective LRU slot (-1 = unused).
+  uint* mpSlotStamp; ///< Last access of the respective LRU slot.
+  uint mStamp;
+  int mReadAheadFirst; ///< First cluster held by the read-ahead window.
+  int mReadAheadCount; ///< Amount of valid clusters in the read-ahead window.
+  uint mTransferSize; ///< Maximum bytes per read request to a drive (0 = DISK_TRANSFER_SIZE).
+  char* mpMapping; ///< Copy-on-write view of the whole image (regular files only, NULL otherwise).
+#ifdef WIN32
+  HANDLE mMapping;
+#endif
 
   void OpenStream(const char* path);
+  char* GetCluster(int Cluster);
+  int ReadClusters(int FirstCluster, int Count, char* pDest);
+  bool AllocateCache();
+  void FreeCache();
+  void MapImage();
+  void UnmapImage();
   inline void swapBytes_16(void* Word);
   inline void swapBytes_32(void* Word);
 
@@ -250,7 +310,7 @@ private:
   bool Load(DiskImage* pDisk);
 };
 
-class AkaiSample : public AkaiDiskElement
+class AkaiSample : public AkaiDiskElement, public SampleStream::Source
 {
 public:
   AkaiDirEntry GetDirEntry();
@@ -301,11 +361,17 @@ public:
 
   int16_t* mpSamples;
 
-  bool LoadSampleData(); ///< Load sample into RAM
+  bool LoadSampleData(); ///< Load sample into RAM (or just point into the memory-mapped image file, if possible)
   void ReleaseSampleData(); ///< release the samples once you used them if you don't want to be bothered to
   int SetPos(int Where, akai_stream_whence_t Whence = akai_stream_start); ///< Use this method and Read() if you don't want to load the sample into RAM, thus for disk streaming.
-  int Read(void* pBuffer, uint SampleCount); ///< Use this method and SetPos() if you don't want to load the sample into RAM, thus for disk streaming.
+  int Read(void* pBuffer, uint SampleCount); ///< Use this method and SetPos() if you don't want to load the sample into RAM, thus for disk streaming. Returns number of sample points read and advances the read position.
   bool LoadHeader();
+
+  // implementation of SampleStream::Source
+  virtual SampleStream::info_t GetStreamInfo();
+  virtual SampleStream::pos_t  ReadStream(SampleStream::pos_t Pos, void* pBuffer, SampleStream::pos_t SampleCount, SampleStream::format_t Format = SampleStream::format_native);
+  virtual bool                 GetStreamLoop(SampleStream::loop_t& Loop);
+  virtual SampleStream::head_t GetStreamHead();
 private:
   AkaiSample(DiskImage* pDisk, AkaiVolume* pParent, const AkaiDirEntry& DirEntry);
   virtual ~AkaiSample();
@@ -318,6 +384,7 @@ private:
   bool mHeaderOK;
   int mPos;
   int mImageOffset; // actual position in the image where sample starts
+  bool mSamplesMapped; // mpSamples points into the memory-mapped image
 };
 
 class AkaiKeygroupSample : public AkaiDiskElement
@@ -474,6 +541,19 @@ private:
   bool Load(DiskImage* pDisk);
 };
 
+/** @brief Velocity zone of a keygroup (see AkaiProgram::GetZonesOfNote()).
+ *
+ * Refers to one of the (up to 4) samples of a keygroup, together with the
+ * velocity range it is played for.
+ */
+struct AkaiKeygroupZone
+{
+  AkaiKeygroup* mpKeygroup; ///< Keygroup the zone belongs to.
+  uint8_t mSample; ///< Index of the zone's sample in AkaiKeygroup::mSamples (0..3).
+  uint8_t mLowVelocity; ///< Lowest velocity the zone is played for.
+  uint8_t mHighVelocity; ///< Highest velocity the zone is played for.
+};
+
 /** @brief AKAI instrument definition
  *
  * Represents exactly one sample based instrument on the AKAI media.
@@ -486,6 +566,9 @@ public:
   uint ListSamples(std::list<String>& rSamples);
   AkaiSample* GetSample(uint Index);
   AkaiSample* GetSample(const String& rName);
+  // Keygroup lookup:
+  AkaiKeygroup* const* GetKeygroupsOfKey(uint Key, uint& rCount) const; ///< Returns the keygroups whose key range covers the given MIDI key (rCount of them, NULL if none), taken from a table built when the program is loaded.
+  uint GetZonesOfNote(uint Key, uint Velocity, AkaiKeygroupZone* pZones, uint MaxZones) const; ///< Copies (up to MaxZones of) the velocity zones of all keygroups to be played for the given note to pZones and returns their amount.
 
   //    byte     description                 default     range/comments
   //   ---------------------------------------------------------------------------
@@ -604,6 +687,12 @@ private:
   AkaiVolume* mpParent;
   DiskImage* mpDisk;
   AkaiDirEntry mDirEntry;
+  std::vector<AkaiKeygroup*> mKeyKeygroups; ///< Keygroups covering MIDI key i are mKeyKeygroups[mKeyKeygroupsOffset[i]] to mKeyKeygroups[mKeyKeygroupsOffset[i+1] - 1].
+  uint mKeyKeygroupsOffset[129];
+  std::vector<AkaiKeygroupZone> mKeyZones; ///< Velocity zones of the keygroups covering MIDI key i are mKeyZones[mKeyZonesOffset[i]] to mKeyZones[mKeyZonesOffset[i+1] - 1].
+  uint mKeyZonesOffset[129];
+
+  void BuildKeyTable(uint Keygroups);
 };
 
 /** @brief Subdivision of an AKAI disk partition.
@@ -642,8 +731,11 @@ private:
   friend class AkaiPartition;
 
   String mName;
-  std::list<AkaiProgram*> mpPrograms;
-  std::list<AkaiSample*> mpSamples;
+  std::list<AkaiProgram*> mpPrograms; // NULL until the respective program is requested
+  std::list<AkaiSample*> mpSamples; // NULL until the respective sample is requested
+  std::list<AkaiDirEntry> mProgramEntries;
+  std::list<AkaiDirEntry> mSampleEntries;
+  bool mDirRead;
   DiskImage* mpDisk;
   AkaiPartition* mpParent;
   AkaiDirEntry mDirEntry;
@@ -676,9 +768,12 @@ private:
   virtual ~AkaiPartition();
 
   friend class AkaiDisk;
+  friend class AkaiDiskElement;
 
   String mName;
   std::list<AkaiVolume*> mpVolumes;
+  bool mVolumesRead;
+  std::map<int,int> mFATCache; // FAT entries read so far (block -> next block)
   AkaiDisk* mpParent;
   DiskImage* mpDisk;
 };
@@ -0,0 +1,1049 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this library; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#include "Catalog.h"
+
+#include "gig.h"
+#include "SF.h"
+#include "helper.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <iostream>
+#include <stdio.h>
+
+#if POSIX
+# include <dirent.h>
+# include <sys/mman.h>
+#endif
+
+// *************** Index file format ***************
+// *
+// All integers are stored in little endian, all records are 8 byte aligned:
+//
+//   header           (INDEX_HEADER_SIZE bytes)
+//   file records     (sorted by path, FILE_RECORD_SIZE bytes each)
+//   instrument records (grouped by file)
+//   sample records   (grouped by file)
+//   sample refs      (uint32 sample index each, grouped by instrument)
+//   string pool      (NUL terminated strings, offset 0 is the empty string)
+
+#define INDEX_MAGIC               0x5849474c // "LGIX" in little endian
+#define INDEX_VERSION             1
+#define INDEX_HEADER_SIZE         64
+#define FILE_RECORD_SIZE          48
+#define INSTRUMENT_RECORD_SIZE    32
+#define SAMPLE_RECORD_SIZE        40
+
+#define FILE_FLAG_FAILED          0x01
+#define FILE_FLAG_CRC             0x02
+#define SAMPLE_FLAG_COMPRESSED    0x01
+
+// size of the blocks in which files are read for calculating their checksum
+#define CRC_BLOCK_SIZE            (1024 * 1024)
+
+namespace Catalog {
+
+// *************** Internal functions **************
+// *
+
+    static inline void store64(uint8_t* pData, uint64_t data) {
+        store32(pData, uint32_t(data));
+        store32(pData + 4, uint32_t(data >> 32));
+    }
+
+    static inline uint64_t load64(const uint8_t* pData) {
+        return uint64_t(load32((uint8_t*) pData)) | uint64_t(load32((uint8_t*) pData + 4)) << 32;
+    }
+
+    static inline uint32_t load32c(const uint8_t* pData) {
+        return load32((uint8_t*) pData);
+    }
+
+    static inline uint16_t load16(const uint8_t* pData) {
+        return uint16_t(pData[0] | pData[1] << 8);
+    }
+
+    static inline size_t align8(size_t size) {
+        return (size + 7) & ~size_t(7);
+    }
+
+    // size of the given file in bytes, false if it does not exist
+    static bool fileSize(const String& path, uint64_t& size) {
+        #if POSIX
+        struct stat st;
+        if (stat(path.c_str(), &st)) return false;
+        size = uint64_t(st.st_size);
+        return true;
+        #elif defined(WIN32)
+        WIN32_FILE_ATTRIBUTE_DATA attr;
+        if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &attr)) return false;
+        size = uint64_t(attr.nFileSizeHigh) << 32 | attr.nFileSizeLow;
+        return true;
+        #else
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+        fseek(f, 0, SEEK_END);
+        size = uint64_t(ftell(f));
+        fclose(f);
+        return true;
+        #endif
+    }
+
+    static format_t formatByExtension(const String& path) {
+        const size_t dot = path.rfind('.');
+        if (dot == String::npos) return format_unknown;
+        String ext = path.substr(dot + 1);
+        for (size_t i = 0; i < ext.size(); ++i)
+            if (ext[i] >= 'A' && ext[i] <= 'Z') ext[i] += 'a' - 'A';
+        if (ext == "gig") return format_gig;
+        if (ext == "dls") return format_dls;
+        if (ext == "sf2") return format_sf2;
+        return format_unknown;
+    }
+
+    // CRC-32 of the whole file, read in blocks of bounded size
+    static bool fileCRC(const String& path, uint32_t& crc) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+        std::vector<uint8_t> buffer(CRC_BLOCK_SIZE);
+        crc = 0;
+        size_t n;
+        while ((n = fread(&buffer[0], 1, buffer.size(), f)) > 0)
+            crc = __crc32(crc, &buffer[0], n);
+        const bool ok = !ferror(f);
+        fclose(f);
+        return ok;
+    }
+
+    // a cataloged file with its instruments and samples, where the sample
+    // indices (in Refs) and the instruments' FirstSampleRef are relative to
+    // the file
+    struct file_entry_t {
+        file_info_t                    Info;
+        std::vector<instrument_info_t> Instruments;
+        std::vector<sample_info_t>     Samples;
+        std::vector<uint32_t>          Refs;
+    };
+
+    // adds the distinct samples the instrument uses to the file's refs
+    static void addSampleRefs(file_entry_t& entry, instrument_info_t& instr, const std::set<uint32_t>& samples) {
+        instr.FirstSampleRef = uint32_t(entry.Refs.size());
+        instr.SampleRefs     = uint32_t(samples.size());
+        entry.Refs.insert(entry.Refs.end(), samples.begin(), samples.end());
+    }
+
+    // (the key range of a new instrument is 127 ... 0, i.e. empty)
+    static inline void addKeyRange(instrument_info_t& instr, int low, int high) {
+        if (low > high) return;
+        instr.KeyLow  = std::min(instr.KeyLow, uint8_t(low));
+        instr.KeyHigh = std::max(instr.KeyHigh, uint8_t(high));
+    }
+
+    static instrument_info_t newInstrument(const String& name, uint32_t bank, uint32_t program) {
+        instrument_info_t instr;
+        instr.Name           = name;
+        instr.File           = 0;
+        instr.KeyLow         = 127;
+        instr.KeyHigh        = 0;
+        instr.Regions        = 0;
+        instr.MIDIBank       = bank;
+        instr.MIDIProgram    = program;
+        instr.FirstSampleRef = 0;
+        instr.SampleRefs     = 0;
+        return instr;
+    }
+
+    static inline bool isCompressed(gig::Sample* pSample) { return pSample->Compressed; }
+    static inline bool isCompressed(DLS::Sample* pSample) { return pSample->FormatTag != DLS_WAVE_FORMAT_PCM; }
+
+    // gig regions use different samples for their dimension zones
+    static inline std::vector<gig::Sample*> regionSamples(gig::Region* pRgn) { return pRgn->GetSamples(); }
+    static inline std::vector<DLS::Sample*> regionSamples(DLS::Region* pRgn) { return std::vector<DLS::Sample*>(1, pRgn->GetSample()); }
+
+    // reads a gig or DLS file (both have the same object model, but the gig
+    // classes hide the DLS methods, so this is a template)
+    template<class File_T, class Instrument_T, class Region_T, class Sample_T>
+    static void scanDLSFile(File_T& file, file_entry_t& entry) {
+        std::map<Sample_T*, uint32_t> sampleIndex;
+        for (Sample_T* pSample = file.GetFirstSample(); pSample; pSample = file.GetNextSample()) {
+            sample_info_t s;
+            s.Name       = pSample->pInfo->Name;
+            s.File       = 0;
+            s.SampleRate = pSample->SamplesPerSecond;
+            s.Channels   = pSample->Channels;
+            s.BitDepth   = pSample->BitDepth;
+            s.Frames     = pSample->SamplesTotal;
+            s.DataSize   = uint64_t(pSample->GetSize()) * pSample->FrameSize;
+            s.Compressed = isCompressed(pSample);
+            sampleIndex[pSample] = uint32_t(entry.Samples.size());
+            entry.Samples.push_back(s);
+        }
+        for (Instrument_T* pInstr = file.GetFirstInstrument(); pInstr; pInstr = file.GetNextInstrument()) {
+            instrument_info_t instr = newInstrument(pInstr->pInfo->Name, pInstr->MIDIBank, pInstr->MIDIProgram);
+            std::set<uint32_t> samples;
+            for (Region_T* pRgn = pInstr->GetFirstRegion(); pRgn; pRgn = pInstr->GetNextRegion()) {
+                instr.Regions++;
+                addKeyRange(instr, pRgn->KeyRange.low, pRgn->KeyRange.high);
+                const std::vector<Sample_T*> rgnSamples = regionSamples(pRgn);
+                for (size_t i = 0; i < rgnSamples.size(); ++i) {
+                    typename std::map<Sample_T*, uint32_t>::iterator it = sampleIndex.find(rgnSamples[i]);
+                    if (it != sampleIndex.end()) samples.insert(it->second);
+                }
+            }
+            addSampleRefs(entry, instr, samples);
+            entry.Instruments.push_back(instr);
+        }
+    }
+
+    static void scanGig(const String& path, file_entry_t& entry) {
+        RIFF::File riff(path);
+        gig::File gig(&riff);
+        // only metadata is needed, so neither load dimensions nor scan
+        // compressed samples
+        gig.SetBrowseMode(true);
+        scanDLSFile<gig::File, gig::Instrument, gig::Region, gig::Sample>(gig, entry);
+    }
+
+    static void scanDLS(const String& path, file_entry_t& entry) {
+        RIFF::File riff(path);
+        DLS::File dls(&riff);
+        scanDLSFile<DLS::File, DLS::Instrument, DLS::Region, DLS::Sample>(dls, entry);
+    }
+
+    // sf2 key ranges are NONE if not given, which means the whole key range
+    static inline int sf2Key(int key, int def) {
+        return (key < 0 || key > 127) ? def : key;
+    }
+
+    // catalogs the presets of a sf2 file (the sf2 instruments are just the
+    // presets' building blocks)
+    static void scanSF2(const String& path, file_entry_t& entry) {
+        RIFF::File riff(path);
+        sf2::File sf(&riff);
+        std::map<sf2::Sample*, uint32_t> sampleIndex;
+        for (int i = 0; i < sf.GetSampleCount(); ++i) {
+            sf2::Sample* pSample = sf.GetSample(i);
+            sample_info_t s;
+            s.Name       = pSample->Name;
+            s.File       = 0;
+            s.SampleRate = pSample->SampleRate;
+            s.Channels   = uint16_t(pSample->GetChannelCount());
+            s.BitDepth   = s.Channels ? uint16_t(pSample->GetFrameSize() / s.Channels * 8) : 0;
+            s.Frames     = uint64_t(pSample->GetTotalFrameCount());
+            s.DataSize   = s.Frames * pSample->GetFrameSize();
+            s.Compressed = false;
+            sampleIndex[pSample] = uint32_t(entry.Samples.size());
+            entry.Samples.push_back(s);
+        }
+        for (int i = 0; i < sf.GetPresetCount(); ++i) {
+            sf2::Preset* pPreset = sf.GetPreset(i);
+            instrument_info_t instr = newInstrument(pPreset->Name, pPreset->Bank, pPreset->PresetNum);
+            std::set<uint32_t> samples;
+            for (int r = 0; r < pPreset->GetRegionCount(); ++r) {
+                sf2::Region* pPresetRgn = pPreset->GetRegion(r);
+                instr.Regions++;
+                sf2::Instrument* pInstr = pPresetRgn->pInstrument;
+                if (!pInstr) continue;
+                const int low  = sf2Key(pPresetRgn->loKey, 0);
+                const int high = sf2Key(pPresetRgn->hiKey, 127);
+                for (int k = 0; k < pInstr->GetRegionCount(); ++k) {
+                    sf2::Region* pRgn = pInstr->GetRegion(k);
+                    addKeyRange(instr, std::max(low, sf2Key(pRgn->loKey, 0)), std::min(high, sf2Key(pRgn->hiKey, 127)));
+                    std::map<sf2::Sample*, uint32_t>::iterator it = sampleIndex.find(pRgn->GetSample());
+                    if (it != sampleIndex.end()) samples.insert(it->second);
+                }
+            }
+            addSampleRefs(entry, instr, samples);
+            entry.Instruments.push_back(instr);
+        }
+    }
+
+    // state shared by the scan jobs of Builder::Build()
+    struct scan_job_t {
+        std::vector<file_entry_t>* pEntries;
+        std::vector<size_t>        indices;   ///< Entries to be scanned.
+        bool                       checksums;
+    };
+
+    // takes over a file with its instruments and samples from a previous index
+    static void loadEntry(const Index& index, uint32_t i, file_entry_t& entry) {
+        entry.Info = index.GetFile(i);
+        for (uint32_t k = 0; k < entry.Info.Instruments; ++k) {
+            instrument_info_t instr = index.GetInstrument(entry.Info.FirstInstrument + k);
+            const uint32_t first = instr.FirstSampleRef;
+            instr.FirstSampleRef = uint32_t(entry.Refs.size());
+            for (uint32_t r = 0; r < instr.SampleRefs; ++r) {
+                const uint32_t sample = index.GetSampleRef(first + r);
+                if (sample < entry.Info.FirstSample || sample - entry.Info.FirstSample >= entry.Info.Samples)
+                    throw Exception("Index file is damaged");
+                entry.Refs.push_back(sample - entry.Info.FirstSample);
+            }
+            entry.Instruments.push_back(instr);
+        }
+        for (uint32_t k = 0; k < entry.Info.Samples; ++k)
+            entry.Samples.push_back(index.GetSample(entry.Info.FirstSample + k));
+    }
+
+    // string pool of an index file being written
+    class string_pool_t {
+    public:
+        string_pool_t() : data(1, 0) {} // offset 0: empty string
+        uint32_t add(const String& s) {
+            if (s.empty()) return 0;
+            std::map<String, uint32_t>::iterator it = offsets.find(s);
+            if (it != offsets.end()) return it->second;
+            const uint32_t offset = uint32_t(data.size());
+            data.insert(data.end(), s.begin(), s.end());
+            data.push_back(0);
+            offsets[s] = offset;
+            return offset;
+        }
+        std::vector<uint8_t> data;
+    private:
+        std::map<String, uint32_t> offsets;
+    };
+
+    // writes the index file atomically (to a temporary file first)
+    static void writeIndex(const String& path, const std::vector<file_entry_t>& entries) {
+        uint32_t instrumentCount = 0, sampleCount = 0, refCount = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            instrumentCount += uint32_t(entries[i].Instruments.size());
+            sampleCount     += uint32_t(entries[i].Samples.size());
+            refCount        += uint32_t(entries[i].Refs.size());
+        }
+        const size_t fileTable       = INDEX_HEADER_SIZE;
+        const size_t instrumentTable = fileTable + entries.size() * FILE_RECORD_SIZE;
+        const size_t sampleTable     = instrumentTable + size_t(instrumentCount) * INSTRUMENT_RECORD_SIZE;
+        const size_t refTable        = sampleTable + size_t(sampleCount) * SAMPLE_RECORD_SIZE;
+        const size_t stringPool      = align8(refTable + size_t(refCount) * 4);
+
+        string_pool_t strings;
+        std::vector<uint8_t> data(stringPool, 0);
+        uint32_t firstInstrument = 0, firstSample = 0, firstRef = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const file_entry_t& e = entries[i];
+            uint8_t* p = &data[fileTable + i * FILE_RECORD_SIZE];
+            store32(&p[0], strings.add(e.Info.Path));
+            store32(&p[4], e.Info.Format);
+            store64(&p[8], e.Info.Size);
+            store64(&p[16], e.Info.ModificationTime);
+            store32(&p[24], e.Info.CRC);
+            store32(&p[28], (e.Info.Failed ? FILE_FLAG_FAILED : 0) | (e.Info.HasCRC ? FILE_FLAG_CRC : 0));
+            store32(&p[32], firstInstrument);
+            store32(&p[36], uint32_t(e.Instruments.size()));
+            store32(&p[40], firstSample);
+            store32(&p[44], uint32_t(e.Samples.size()));
+            for (size_t k = 0; k < e.Instruments.size(); ++k) {
+                const instrument_info_t& instr = e.Instruments[k];
+                p = &data[instrumentTable + size_t(firstInstrument + k) * INSTRUMENT_RECORD_SIZE];
+                store32(&p[0], strings.add(instr.Name));
+                store32(&p[4], uint32_t(i));
+                p[8] = instr.KeyLow;
+                p[9] = instr.KeyHigh;
+                store32(&p[12], instr.Regions);
+                store32(&p[16], instr.MIDIBank);
+                store32(&p[20], instr.MIDIProgram);
+                store32(&p[24], firstRef + instr.FirstSampleRef);
+                store32(&p[28], instr.SampleRefs);
+            }
+            for (size_t k = 0; k < e.Samples.size(); ++k) {
+                const sample_info_t& s = e.Samples[k];
+                p = &data[sampleTable + size_t(firstSample + k) * SAMPLE_RECORD_SIZE];
+                store32(&p[0], strings.add(s.Name));
+                store32(&p[4], uint32_t(i));
+                store32(&p[8], s.SampleRate);
+                store16(&p[12], s.Channels);
+                store16(&p[14], s.BitDepth);
+                store64(&p[16], s.Frames);
+                store64(&p[24], s.DataSize);
+                store32(&p[32], s.Compressed ? SAMPLE_FLAG_COMPRESSED : 0);
+            }
+            for (size_t k = 0; k < e.Refs.size(); ++k)
+                store32(&data[refTable + size_t(firstRef + k) * 4], firstSample + e.Refs[k]);
+            firstInstrument += uint32_t(e.Instruments.size());
+            firstSample     += uint32_t(e.Samples.size());
+            firstRef        += uint32_t(e.Refs.size());
+        }
+        data.insert(data.end(), strings.data.begin(), strings.data.end());
+        data.resize(align8(data.size()), 0);
+        if (uint64_t(data.size()) != uint64_t(uint32_t(data.size())))
+            throw Exception("Catalog too large");
+
+        uint8_t* h = &data[0];
+        store32(&h[0],  INDEX_MAGIC);
+        store32(&h[4],  INDEX_VERSION);
+        store32(&h[8],  uint32_t(entries.size()));
+        store32(&h[12], instrumentCount);
+        store32(&h[16], sampleCount);
+        store32(&h[20], refCount);
+        store32(&h[24], uint32_t(fileTable));
+        store32(&h[28], uint32_t(instrumentTable));
+        store32(&h[32], uint32_t(sampleTable));
+        store32(&h[36], uint32_t(refTable));
+        store32(&h[40], uint32_t(stringPool));
+        store32(&h[44], uint32_t(strings.data.size()));
+        store32(&h[48], uint32_t(data.size()));
+
+        const String tmpPath = path + ".tmp";
+        FILE* f = fopen(tmpPath.c_str(), "wb");
+        if (!f) throw Exception("Could not create index file '%s'", tmpPath.c_str());
+        const bool ok = fwrite(&data[0], 1, data.size(), f) == data.size();
+        if (fclose(f) || !ok) {
+            remove(tmpPath.c_str());
+            throw Exception("Could not write index file '%s'", tmpPath.c_str());
+        }
+        #if defined(WIN32)
+        remove(path.c_str()); // rename() does not replace existing files on Windows
+        #endif
+        if (rename(tmpPath.c_str(), path.c_str())) {
+            remove(tmpPath.c_str());
+            throw Exception("Could not replace index file '%s'", path.c_str());
+        }
+    }
+
+
+
+// *************** Index ***************
+// *
+
+    /** @brief Open a catalog index file.
+     *
+     * Maps the given index file (created by Builder::Build()) into memory
+     * and checks its structure.
+     *
+     * @param path - file name of the index file
+     * @throws Catalog::Exception if the file cannot be read or is not a
+     *         valid index file
+     */
+    Index::Index(const String& path) : pData(NULL), DataSize(0), bMapped(false) {
+        #if POSIX
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw Exception("Could not open index file '%s'", path.c_str());
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                pData    = (const uint8_t*) p;
+                DataSize = size_t(st.st_size);
+                bMapped  = true;
+            }
+        }
+        close(fd);
+        #endif
+        if (!pData) { // no memory map available, read the whole file instead
+            FILE* f = fopen(path.c_str(), "rb");
+            if (!f) throw Exception("Could not open index file '%s'", path.c_str());
+            std::vector<uint8_t> buffer;
+            uint8_t block[16384];
+            size_t n;
+            while ((n = fread(block, 1, sizeof(block), f)) > 0)
+                buffer.insert(buffer.end(), block, block + n);
+            fclose(f);
+            if (!buffer.empty()) {
+                uint8_t* p = new uint8_t[buffer.size()];
+                memcpy(p, &buffer[0], buffer.size());
+                pData    = p;
+                DataSize = buffer.size();
+            }
+        }
+
+        const uint8_t* h = pData;
+        if (DataSize < INDEX_HEADER_SIZE || load32c(&h[0]) != INDEX_MAGIC ||
+            load32c(&h[4]) != INDEX_VERSION || load32c(&h[48]) > DataSize)
+        {
+            __close();
+            throw Exception("'%s' is not a catalog index file (or of an unsupported version)", path.c_str());
+        }
+        FileCount       = load32c(&h[8]);
+        InstrumentCount = load32c(&h[12]);
+        SampleCount     = load32c(&h[16]);
+        RefCount        = load32c(&h[20]);
+        FileTable       = load32c(&h[24]);
+        InstrumentTable = load32c(&h[28]);
+        SampleTable     = load32c(&h[32]);
+        RefTable        = load32c(&h[36]);
+        StringPool      = load32c(&h[40]);
+        StringPoolSize  = load32c(&h[44]);
+        const uint64_t size = load32c(&h[48]);
+        if (uint64_t(FileTable) + uint64_t(FileCount) * FILE_RECORD_SIZE > size ||
+            uint64_t(InstrumentTable) + uint64_t(InstrumentCount) * INSTRUMENT_RECORD_SIZE > size ||
+            uint64_t(SampleTable) + uint64_t(SampleCount) * SAMPLE_RECORD_SIZE > size ||
+            uint64_t(RefTable) + uint64_t(RefCount) * 4 > size ||
+            uint64_t(StringPool) + StringPoolSize > size || !StringPoolSize ||
+            pData[StringPool + StringPoolSize - 1] != 0)
+        {
+            __close();
+            throw Exception("Index file '%s' is damaged", path.c_str());
+        }
+    }
+
+    Index::~Index() {
+        __close();
+    }
+
+    void Index::__close() {
+        if (!pData) return;
+        #if POSIX
+        if (bMapped) munmap((void*) pData, DataSize);
+        else
+        #endif
+        delete[] pData;
+        pData = NULL;
+    }
+
+    // the pool ends with a NUL (checked on open), so every offset within
+    // the pool is a valid string
+    String Index::__string(uint32_t offset) const {
+        if (offset >= StringPoolSize) return "";
+        return (const char*) &pData[StringPool + offset];
+    }
+
+    /// Returns the amount of files in the catalog.
+    uint32_t Index::CountFiles() const {
+        return FileCount;
+    }
+
+    /**
+     * Returns the file with the given index. The files are sorted by their
+     * path.
+     *
+     * @param index - index of the file (0 ... CountFiles() - 1)
+     * @throws Catalog::Exception if the index is out of bounds
+     */
+    file_info_t Index::GetFile(uint32_t index) const {
+        if (index >= FileCount) throw Exception("File index %u out of bounds", index);
+        const uint8_t* p = &pData[FileTable + size_t(index) * FILE_RECORD_SIZE];
+        file_info_t info;
+        info.Path             = __string(load32c(&p[0]));
+        info.Format           = (format_t) load32c(&p[4]);
+        info.Size             = load64(&p[8]);
+        info.ModificationTime = load64(&p[16]);
+        info.CRC              = load32c(&p[24]);
+        info.HasCRC           = load32c(&p[28]) & FILE_FLAG_CRC;
+        info.Failed           = load32c(&p[28]) & FILE_FLAG_FAILED;
+        info.FirstInstrument  = load32c(&p[32]);
+        info.Instruments      = load32c(&p[36]);
+        info.FirstSample      = load32c(&p[40]);
+        info.Samples          = load32c(&p[44]);
+        if (uint64_t(info.FirstInstrument) + info.Instruments > InstrumentCount ||
+            uint64_t(info.FirstSample) + info.Samples > SampleCount)
+            throw Exception("Index file is damaged");
+        return info;
+    }
+
+    /**
+     * Returns the index of the file with the given path (exactly as it was
+     * found by the Builder), or -1 if the file is not in the catalog.
+     */
+    int Index::FindFile(const String& path) const {
+        uint32_t lo = 0, hi = FileCount;
+        while (lo < hi) {
+            const uint32_t mid = lo + (hi - lo) / 2;
+            const String s = __string(load32c(&pData[FileTable + size_t(mid) * FILE_RECORD_SIZE]));
+            if (s == path) return int(mid);
+            if (s < path) lo = mid + 1;
+            else hi = mid;
+        }
+        return -1;
+    }
+
+    /// Returns the amount of instruments of all files in the catalog.
+    uint32_t Index::CountInstruments() const {
+        return InstrumentCount;
+    }
+
+    /**
+     * Returns the instrument with the given index. The instruments of each
+     * file are stored consecutively (see file_info_t::FirstInstrument).
+     *
+     * @param index - index of the instrument (0 ... CountInstruments() - 1)
+     * @throws Catalog::Exception if the index is out of bounds
+     */
+    instrument_info_t Index::GetInstrument(uint32_t index) const {
+        if (index >= InstrumentCount) throw Exception("Instrument index %u out of bounds", index);
+        const uint8_t* p = &pData[InstrumentTable + size_t(index) * INSTRUMENT_RECORD_SIZE];
+        instrument_info_t info;
+        info.Name           = __string(load32c(&p[0]));
+        info.File           = load32c(&p[4]);
+        info.KeyLow         = p[8];
+        info.KeyHigh        = p[9];
+        info.Regions        = load32c(&p[12]);
+        info.MIDIBank       = load32c(&p[16]);
+        info.MIDIProgram    = load32c(&p[20]);
+        info.FirstSampleRef = load32c(&p[24]);
+        info.SampleRefs     = load32c(&p[28]);
+        if (uint64_t(info.FirstSampleRef) + info.SampleRefs > RefCount)
+            throw Exception("Index file is damaged");
+        return info;
+    }
+
+    /// Returns the amount of samples of all files in the catalog.
+    uint32_t Index::CountSamples() const {
+        return SampleCount;
+    }
+
+    /**
+     * Returns the sample with the given index. The samples of each file
+     * are stored consecutively (see file_info_t::FirstSample).
+     *
+     * @param index - index of the sample (0 ... CountSamples() - 1)
+     * @throws Catalog::Exception if the index is out of bounds
+     */
+    sample_info_t Index::GetSample(uint32_t index) const {
+        if (index >= SampleCount) throw Exception("Sample index %u out of bounds", index);
+        const uint8_t* p = &pData[SampleTable + size_t(index) * SAMPLE_RECORD_SIZE];
+        sample_info_t info;
+        info.Name       = __string(load32c(&p[0]));
+        info.File       = load32c(&p[4]);
+        info.SampleRate = load32c(&p[8]);
+        info.Channels   = load16(&p[12]);
+        info.BitDepth   = load16(&p[14]);
+        info.Frames     = load64(&p[16]);
+        info.DataSize   = load64(&p[24]);
+        info.Compressed = load32c(&p[32]) & SAMPLE_FLAG_COMPRESSED;
+        return info;
+    }
+
+    /**
+     * Returns the index of the sample (see GetSample()) referenced by the
+     * given sample reference. The samples an instrument uses are the
+     * sample references instrument_info_t::FirstSampleRef ...
+     * FirstSampleRef + SampleRefs - 1.
+     *
+     * @param index - index of the sample reference
+     * @throws Catalog::Exception if the index is out of bounds
+     */
+    uint32_t Index::GetSampleRef(uint32_t index) const {
+        if (index >= RefCount) throw Exception("Sample reference index %u out of bounds", index);
+        const uint32_t sample = load32c(&pData[RefTable + size_t(index) * 4]);
+        if (sample >= SampleCount) throw Exception("Index file is damaged");
+        return sample;
+    }
+
+
+
+// *************** Builder ***************
+// *
+
+    Builder::Builder() : ThreadCount(1), bChecksums(true) {
+    }
+
+    /**
+     * Adds a file or a directory to be cataloged. Directories are searched
+     * recursively for .gig, .dls and .sf2 files when Build() is called
+     * (symbolic links to directories are not followed).
+     */
+    void Builder::AddPath(const String& path) {
+        Paths.push_back(path);
+    }
+
+    /**
+     * Sets the amount of threads scanning files in parallel (default: 1).
+     *
+     * @param count - amount of threads, <= 0 for one thread per CPU core
+     */
+    void Builder::SetThreadCount(int count) {
+        ThreadCount = count;
+    }
+
+    /**
+     * Enables / disables calculating a CRC-32 checksum of each file's whole
+     * contents (enabled by default). Checksums allow to identify duplicate
+     * files, but require reading all sample data of the scanned files.
+     */
+    void Builder::SetChecksums(bool b) {
+        bChecksums = b;
+    }
+
+    // appends the supported files at or below the given path
+    void Builder::__collectFiles(const String& path, std::vector<String>& files) {
+        #if POSIX
+        struct stat st;
+        if (stat(path.c_str(), &st)) return;
+        if (!S_ISDIR(st.st_mode)) {
+            files.push_back(path);
+            return;
+        }
+        DIR* dir = opendir(path.c_str());
+        if (!dir) return;
+        const String prefix = (!path.empty() && path[path.size() - 1] == '/') ? path : path + "/";
+        for (struct dirent* e = readdir(dir); e; e = readdir(dir)) {
+            const String name = e->d_name;
+            if (name == "." || name == "..") continue;
+            const String child = prefix + name;
+            struct stat lst;
+            if (lstat(child.c_str(), &lst)) continue;
+            if (S_ISLNK(lst.st_mode) && (stat(child.c_str(), &lst) || S_ISDIR(lst.st_mode))) continue;
+            if (S_ISDIR(lst.st_mode)) __collectFiles(child, files);
+            else if (S_ISREG(lst.st_mode) && formatByExtension(child) != format_unknown) files.push_back(child);
+        }
+        closedir(dir);
+        #elif defined(WIN32)
+        const DWORD attr = GetFileAttributes(path.c_str());
+        if (attr == INVALID_FILE_ATTRIBUTES) return;
+        if (!(attr & FILE_ATTRIBUTE_DIRECTORY)) {
+            files.push_back(path);
+            return;
+        }
+        const String prefix = (!path.empty() && (path[path.size() - 1] == '\\' || path[path.size() - 1] == '/')) ? path : path + "\\";
+        WIN32_FIND_DATA data;
+        HANDLE h = FindFirstFile((prefix + "*").c_str(), &data);
+        if (h == INVALID_HANDLE_VALUE) return;
+        do {
+            const String name = data.cFileName;
+            if (name == "." || name == "..") continue;
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) continue;
+            const String child = prefix + name;
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) __collectFiles(child, files);
+            else if (formatByExtension(child) != format_unknown) files.push_back(child);
+        } while (FindNextFile(h, &data));
+        FindClose(h);
+        #else
+        files.push_back(path);
+        #endif
+    }
+
+    void Builder::__scanJob(void* arg, size_t index) {
+        scan_job_t* job = (scan_job_t*) arg;
+        file_entry_t& entry = (*job->pEntries)[job->indices[index]];
+        const String path = entry.Info.Path;
+        // sort out foreign files cheaply, without an exception being thrown
+        const format_t format = ProbeFile(path).Format;
+        const bool bSupported = (entry.Info.Format == format_sf2) ?
+            (format == format_sf2) : (format == format_gig || format == format_dls);
+        if (!bSupported) entry.Info.Failed = true;
+        else try {
+            switch (entry.Info.Format) {
+                case format_gig: scanGig(path, entry); break;
+                case format_dls: scanDLS(path, entry); break;
+                case format_sf2: scanSF2(path, entry); break;
+                default: entry.Info.Failed = true;
+            }
+        } catch (...) {
+            entry.Info.Failed = true;
+        }
+        if (entry.Info.Failed) {
+            entry.Instruments.clear();
+            entry.Samples.clear();
+            entry.Refs.clear();
+        }
+        if (job->checksums) entry.Info.HasCRC = fileCRC(path, entry.Info.CRC);
+    }
+
+    /** @brief Create or update the catalog index file.
+     *
+     * Catalogs all files added with AddPath() and writes the index file.
+     * If the index file exists already, the files which did not change
+     * since (same path, size and modification time) are taken over from
+     * it instead of being scanned again, so updating the catalog of a
+     * large library is fast. Files of the existing index which were not
+     * found anymore are dropped.
+     *
+     * The index file is replaced atomically, so an Index may still be
+     * reading the previous version while the catalog is updated.
+     *
+     * @param indexPath - file name of the index file
+     * @param pProgress - optional progress callback, notified as files are scanned
+     * @returns statistics about the files cataloged
+     * @throws Catalog::Exception if the index file cannot be written
+     * @throws RIFF::CancelException if the progress callback requested
+     *         to cancel the operation (the index file is not modified)
+     */
+    build_stats_t Builder::Build(const String& indexPath, RIFF::progress_t* pProgress) {
+        std::vector<String> files;
+        for (size_t i = 0; i < Paths.size(); ++i)
+            __collectFiles(Paths[i], files);
+        std::sort(files.begin(), files.end());
+        files.erase(std::unique(files.begin(), files.end()), files.end());
+
+        Index* pPrevious = NULL;
+        try {
+            pPrevious = new Index(indexPath);
+        } catch (...) { // no (valid) previous index, scan all files
+        }
+
+        build_stats_t stats;
+        stats.Files = uint32_t(files.size());
+        stats.Scanned = stats.Reused = stats.Failed = 0;
+        std::vector<file_entry_t> entries(files.size());
+        scan_job_t job;
+        job.pEntries  = &entries;
+        job.checksums = bChecksums;
+        for (size_t i = 0; i < files.size(); ++i) {
+            file_info_t& info = entries[i].Info;
+            uint64_t size = 0;
+            fileSize(files[i], size);
+            const uint64_t mtime = __fileModificationTime(files[i]);
+            const int previous = pPrevious ? pPrevious->FindFile(files[i]) : -1;
+            if (previous >= 0) {
+                try {
+                    const file_info_t old = pPrevious->GetFile(uint32_t(previous));
+                    if (old.Size == size && old.ModificationTime == mtime && mtime &&
+                        (old.HasCRC || !bChecksums))
+                    {
+                        loadEntry(*pPrevious, uint32_t(previous), entries[i]);
+                        stats.Reused++;
+                        continue;
+                    }
+                } catch (const Exception& e) { // damaged previous entry, rescan file
+                    entries[i] = file_entry_t();
+                }
+            }
+            info.Path             = files[i];
+            info.Format           = formatByExtension(files[i]);
+            info.Size             = size;
+            info.ModificationTime = mtime;
+            info.CRC              = 0;
+            info.HasCRC           = false;
+            info.Failed           = false;
+            job.indices.push_back(i);
+        }
+        delete pPrevious;
+
+        if (!__parallel_for(job.indices.size(), ThreadCount, __scanJob, &job, pProgress))
+            throw RIFF::CancelException();
+        stats.Scanned = uint32_t(job.indices.size());
+        for (size_t i = 0; i < entries.size(); ++i)
+            if (entries[i].Info.Failed) stats.Failed++;
+
+        writeIndex(indexPath, entries);
+        __notify_progress(pProgress, 1.f);
+        return stats;
+    }
+
+
+
+// *************** Probing ***************
+// *
+
+    // upper limit of top level chunks ProbeFile() looks at (real files have
+    // about a dozen)
+    #define PROBE_MAX_CHUNKS 256
+    // size of the AKAI disk image header ProbeFile() checks (partition
+    // header and root directory of the first partition)
+    #define PROBE_AKAI_HEADER_SIZE (0xca + 100 * 16)
+    #define PROBE_AKAI_BLOCK_SIZE  0x2000
+
+    static bool readAt(FILE* f, uint64_t pos, void* pData, size_t size) {
+        #if defined(WIN32)
+        if (_fseeki64(f, pos, SEEK_SET)) return false;
+        #else
+        if (fseeko(f, off_t(pos), SEEK_SET)) return false;
+        #endif
+        return fread(pData, 1, size, f) == size;
+    }
+
+    static uint64_t probeUint(const uint8_t* p, int size, bool bBigEndian) {
+        uint64_t value = 0;
+        for (int i = 0; i < size; ++i)
+            value |= uint64_t(p[bBigEndian ? size - 1 - i : i]) << (8 * i);
+        return value;
+    }
+
+    static bool isGigVersion(uint16_t minor, uint16_t major, uint16_t build, uint16_t release) {
+        const DLS::version_t* versions[] = {
+            &gig::File::VERSION_2, &gig::File::VERSION_3, &gig::File::VERSION_4
+        };
+        for (int i = 0; i < 3; ++i)
+            if (versions[i]->minor == minor && versions[i]->major == major &&
+                versions[i]->build == build && versions[i]->release == release)
+                return true;
+        return false;
+    }
+
+    // walks the top level chunks of a DLS / gig or SoundFont file
+    static void probeRIFF(FILE* f, const RIFF::probe_result_t& riff, probe_info_t& info) {
+        const bool bBigEndian = (riff.Endian == RIFF::endian_big);
+        const int offsetSize = riff.FileOffsetSize;
+        const int headerSize = CHUNK_HEADER_SIZE(offsetSize);
+        const bool bDLS = (riff.FileType == RIFF_TYPE_DLS);
+        if (!bDLS && riff.FileType != RIFF_TYPE_SF2) return;
+        info.b64BitOffsets = (offsetSize == 8);
+
+        uint8_t header[CHUNK_HEADER_SIZE(8) + 4];
+        if (!readAt(f, 0, header, headerSize)) return;
+        const uint64_t end = std::min(info.Size, headerSize + probeUint(&header[4], offsetSize, bBigEndian));
+        bool bGig = false, bVersion = false;
+        uint16_t version[4] = { 0, 0, 0, 0 }; // minor, major, build, release
+        uint64_t pos = RIFF_HEADER_SIZE(offsetSize);
+        for (int n = 0; n < PROBE_MAX_CHUNKS && pos + headerSize <= end; ++n) {
+            if (!readAt(f, pos, header, headerSize)) break;
+            const uint64_t size = probeUint(&header[4], offsetSize, bBigEndian);
+            const uint64_t data = pos + headerSize;
+            if (!memcmp(header, "LIST", 4)) {
+                uint8_t type[4];
+                if (size < 4 || !readAt(f, data, type, 4)) break;
+                if (!memcmp(type, "3gri", 4)) bGig = true;
+                if (!bDLS && !memcmp(type, "INFO", 4)) {
+                    // SoundFont version is the 'ifil' chunk of the INFO list
+                    const uint64_t listEnd = std::min(end, data + size);
+                    uint64_t sub = data + 4;
+                    for (int k = 0; k < PROBE_MAX_CHUNKS && sub + headerSize <= listEnd; ++k) {
+                        if (!readAt(f, sub, header, headerSize)) break;
+                        const uint64_t subSize = probeUint(&header[4], offsetSize, bBigEndian);
+                        uint8_t ifil[4];
+                        if (!memcmp(header, "ifil", 4) && subSize >= 4 && readAt(f, sub + headerSize, ifil, 4)) {
+                            info.VersionMajor = uint16_t(probeUint(&ifil[0], 2, bBigEndian));
+                            info.VersionMinor = uint16_t(probeUint(&ifil[2], 2, bBigEndian));
+                            break;
+                        }
+                        sub += headerSize + subSize + (subSize & 1);
+                    }
+                }
+            } else if (bDLS && !memcmp(header, "einf", 4)) {
+                bGig = true;
+            } else if (bDLS && !memcmp(header, "vers", 4)) {
+                uint8_t vers[8];
+                if (size >= 8 && readAt(f, data, vers, 8)) {
+                    for (int i = 0; i < 4; ++i)
+                        version[i] = uint16_t(probeUint(&vers[2 * i], 2, bBigEndian));
+                    bVersion = true;
+                }
+            } else if (bDLS && !memcmp(header, "ptbl", 4)) {
+                uint8_t ptbl[8];
+                if (size >= 8 && readAt(f, data, ptbl, 8)) {
+                    const uint64_t tableHeaderSize = probeUint(&ptbl[0], 4, bBigEndian);
+                    const uint64_t count = probeUint(&ptbl[4], 4, bBigEndian);
+                    if (tableHeaderSize <= size && size - tableHeaderSize == count * 8) {
+                        // 64 bit wave pool offsets: with gig files smaller than
+                        // 2 GB the high words are extension file numbers
+                        if (info.Size >> 31) {
+                            info.b64BitOffsets = true;
+                        } else {
+                            std::vector<uint8_t> table(std::min<uint64_t>(count, 4096) * 8);
+                            for (uint64_t i = 0; i < count; ) {
+                                const uint64_t entries = std::min<uint64_t>(count - i, table.size() / 8);
+                                if (!readAt(f, data + tableHeaderSize + i * 8, &table[0], entries * 8)) break;
+                                for (uint64_t k = 0; k < entries; ++k) {
+                                    const int fileNo = int(probeUint(&table[k * 8], 4, bBigEndian));
+                                    if (fileNo > info.ExtensionFiles) info.ExtensionFiles = fileNo;
+                                }
+                                i += entries;
+                            }
+                        }
+                    }
+                }
+            }
+            pos = data + size + (size & 1);
+        }
+        if (!bDLS) {
+            info.Format = format_sf2;
+            return;
+        }
+        if (!bGig && bVersion) bGig = isGigVersion(version[0], version[1], version[2], version[3]);
+        info.Format = bGig ? format_gig : format_dls;
+        if (bVersion) {
+            info.VersionMajor = version[1];
+            info.VersionMinor = version[0];
+        }
+        if (!bGig) info.ExtensionFiles = 0;
+    }
+
+    // Korg files and AKAI disk images (which have no signature, so the
+    // partition header and root directory are checked for plausibility)
+    static void probeNonRIFF(FILE* f, probe_info_t& info) {
+        uint8_t header[PROBE_AKAI_HEADER_SIZE];
+        if (!readAt(f, 0, header, 4)) return;
+        if (!memcmp(header, "MSP1", 4)) {
+            info.Format = format_kmp;
+            return;
+        }
+        if (!memcmp(header, "SMP1", 4)) {
+            info.Format = format_ksf;
+            return;
+        }
+        if (info.Size < PROBE_AKAI_BLOCK_SIZE || !readAt(f, 0, header, sizeof(header))) return;
+        const uint16_t partitionSize = uint16_t(probeUint(&header[0], 2, false));
+        if (!partitionSize || partitionSize >= 30720 || partitionSize == 0x0fff) return;
+        int volumes = 0;
+        for (int i = 0; i < 100; ++i) {
+            const uint8_t* entry = &header[0xca + i * 16];
+            const uint16_t type  = uint16_t(probeUint(&entry[12], 2, false));
+            const uint16_t start = uint16_t(probeUint(&entry[14], 2, false));
+            if ((type != 1 && type != 3) || !start) continue; // S1000 / S3000 volume
+            for (int k = 0; k < 12; ++k)
+                if (entry[k] > 40) return; // not in AKAI's character set
+            volumes++;
+        }
+        if (volumes) info.Format = format_akai;
+    }
+
+    /** @brief Detect the format of a file by reading just its header.
+     *
+     * Determines whether the given file is a Gigasampler / GigaStudio,
+     * DLS, SoundFont 2, Korg KMP / KSF file or an AKAI S1000 / S3000 disk
+     * image, without constructing any of the format classes. Only the
+     * first bytes and the headers of the top level chunks are read (plus
+     * the wave pool table of gig files smaller than 2 GB for detecting
+     * extension files), no exception is thrown and no message is
+     * formatted, so this is suitable for quickly sorting out the files
+     * which are not instruments when scanning large directory trees.
+     *
+     * Gig files are told from plain DLS files by their sample group list,
+     * their 'einf' chunk or their gig version number. AKAI disk images
+     * have no signature, they are recognized by a plausible partition
+     * header with at least one (S1000 / S3000) volume.
+     *
+     * @param path - path and file name of the file to be checked
+     * @returns detected format and details, probe_info_t::Format is
+     *          format_unknown if the file could not be read or is none of
+     *          the supported formats
+     */
+    probe_info_t ProbeFile(const String& path) {
+        probe_info_t info = probe_info_t();
+        RIFF::probe_result_t riff;
+        const RIFF::probe_status_t status = RIFF::File::Probe(path, 0, &riff);
+        info.Size = riff.FileSize;
+        if (status == RIFF::probe_open_error) return info;
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return info;
+        if (status == RIFF::probe_ok) probeRIFF(f, riff, info);
+        else probeNonRIFF(f, info);
+        fclose(f);
+        return info;
+    }
+
+// *************** Exception ***************
+// *
+
+    Exception::Exception() : RIFF::Exception() {
+    }
+
+    Exception::Exception(String format, ...) : RIFF::Exception() {
+        va_list arg;
+        va_start(arg, format);
+        Message = assemble(format, arg);
+        va_end(arg);
+    }
+
+    Exception::Exception(String format, va_list arg) : RIFF::Exception() {
+        Message = assemble(format, arg);
+    }
+
+    void Exception::PrintMessage() {
+        std::cout << "Catalog::Exception: " << Message << std::endl;
+    }
+
+} // namespace Catalog
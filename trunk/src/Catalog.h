@@ -0,0 +1,191 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this library; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#ifndef __CATALOG_H__
+#define __CATALOG_H__
+
+#include "RIFF.h"
+
+#include <string>
+#include <vector>
+
+/** @brief Index of the instruments and samples of whole sound libraries.
+ *
+ * A catalog lists the instruments (with their key ranges) and the samples
+ * (with their wave format and size) of any amount of Gigasampler (.gig),
+ * DLS (.dls) and SoundFont 2 (.sf2) files, e.g. all files below some
+ * directories, so applications can browse and search large sound libraries
+ * without opening any of the files.
+ *
+ * A catalog is created by a Builder, which scans the files in parallel and
+ * stores the result as a compact index file. Rebuilding an existing index
+ * file only rescans the files which changed since (by file size and
+ * modification time). The index file is read by class Index, which maps it
+ * into memory, so opening even huge catalogs is instant and only the
+ * records actually accessed are read from disk.
+ */
+namespace Catalog {
+
+    typedef std::string String;
+
+    /// File format of a cataloged file.
+    enum format_t {
+        format_unknown = 0, ///< Not a supported sound file format.
+        format_gig     = 1, ///< Gigasampler / GigaStudio file (.gig).
+        format_dls     = 2, ///< DLS file (.dls).
+        format_sf2     = 3, ///< SoundFont 2 file (.sf2).
+        format_kmp     = 4, ///< Korg multi sample file (.kmp), only reported by ProbeFile(), not cataloged.
+        format_ksf     = 5, ///< Korg sample file (.ksf), only reported by ProbeFile(), not cataloged.
+        format_akai    = 6  ///< AKAI S1000 / S3000 disk image, only reported by ProbeFile(), not cataloged.
+    };
+
+    /// Result of ProbeFile().
+    struct probe_info_t {
+        format_t Format;          ///< Detected file format, format_unknown if the file is none of the supported formats (or could not be read).
+        uint16_t VersionMajor;    ///< gig: 2, 3 or 4; DLS: major version of the 'vers' chunk; SoundFont: major version of the 'ifil' chunk; 0 otherwise.
+        uint16_t VersionMinor;    ///< DLS: minor version of the 'vers' chunk; SoundFont: minor version of the 'ifil' chunk; 0 otherwise.
+        bool     b64BitOffsets;   ///< Whether the file uses 64 bit RIFF chunk offsets (files > 4 GB) or 64 bit wave pool offsets (gig files > 2 GB).
+        int      ExtensionFiles;  ///< gig: amount of extension files (*.gx01, *.gx02, ...) the file's samples are split across, 0 otherwise.
+        uint64_t Size;            ///< File size in bytes.
+    };
+
+    /// A cataloged file.
+    struct file_info_t {
+        String   Path;             ///< File name as found by the Builder.
+        format_t Format;
+        uint64_t Size;             ///< File size in bytes.
+        uint64_t ModificationTime; ///< Last modification time of the file (system specific unit).
+        uint32_t CRC;              ///< CRC-32 checksum of the whole file contents (only if @c HasCRC is true).
+        bool     HasCRC;           ///< Whether the Builder calculated @c CRC.
+        bool     Failed;           ///< Whether the file could not be read, so it has no instruments and samples.
+        uint32_t FirstInstrument;  ///< Index of the file's first instrument (see Index::GetInstrument()).
+        uint32_t Instruments;      ///< Amount of instruments of the file.
+        uint32_t FirstSample;      ///< Index of the file's first sample (see Index::GetSample()).
+        uint32_t Samples;          ///< Amount of samples of the file.
+    };
+
+    /// A cataloged instrument (with SoundFont 2 files: a preset).
+    struct instrument_info_t {
+        String   Name;
+        uint32_t File;           ///< Index of the file the instrument belongs to.
+        uint8_t  KeyLow;         ///< Lowest MIDI key any of the instrument's regions is mapped to.
+        uint8_t  KeyHigh;        ///< Highest MIDI key any of the instrument's regions is mapped to (smaller than @c KeyLow if the instrument has no regions).
+        uint32_t Regions;        ///< Amount of regions of the instrument.
+        uint32_t MIDIBank;
+        uint32_t MIDIProgram;
+        uint32_t FirstSampleRef; ///< Index of the first sample reference of the instrument (see Index::GetSampleRef()).
+        uint32_t SampleRefs;     ///< Amount of distinct samples the instrument uses.
+    };
+
+    /// A cataloged sample.
+    struct sample_info_t {
+        String   Name;
+        uint32_t File;       ///< Index of the file the sample belongs to.
+        uint32_t SampleRate;
+        uint16_t Channels;
+        uint16_t BitDepth;
+        uint64_t Frames;     ///< Length of the sample in sample points (0 with compressed gig samples, whose length is unknown until they are scanned).
+        uint64_t DataSize;   ///< Size of the sample's wave data in the file (in bytes).
+        bool     Compressed;
+    };
+
+    /** @brief Read access to a catalog index file.
+     *
+     * Maps the index file (created by a Builder) into memory. All methods
+     * are const and may be called by several threads at the same time.
+     */
+    class Index {
+        public:
+            Index(const String& path);
+            virtual ~Index();
+            uint32_t          CountFiles() const;
+            file_info_t       GetFile(uint32_t index) const;
+            int               FindFile(const String& path) const;
+            uint32_t          CountInstruments() const;
+            instrument_info_t GetInstrument(uint32_t index) const;
+            uint32_t          CountSamples() const;
+            sample_info_t     GetSample(uint32_t index) const;
+            uint32_t          GetSampleRef(uint32_t index) const;
+        private:
+            const uint8_t* pData;     ///< The whole index file (mapped or loaded).
+            size_t         DataSize;
+            bool           bMapped;   ///< Whether @c pData is a memory map (otherwise it was allocated with new[]).
+            uint32_t       FileCount, InstrumentCount, SampleCount, RefCount;
+            uint32_t       FileTable, InstrumentTable, SampleTable, RefTable, StringPool, StringPoolSize; ///< Offsets (and size) of the index sections.
+
+            String __string(uint32_t offset) const;
+            void   __close();
+            Index(const Index&); // not copyable
+            Index& operator=(const Index&);
+    };
+
+    /// Statistics of the last Builder::Build() call.
+    struct build_stats_t {
+        uint32_t Files;   ///< Amount of files cataloged.
+        uint32_t Scanned; ///< Amount of files read (new or changed files).
+        uint32_t Reused;  ///< Amount of unchanged files taken over from the previous index.
+        uint32_t Failed;  ///< Amount of files which could not be read.
+    };
+
+    /** @brief Creates and updates catalog index files.
+     *
+     * Add the files and directories to be cataloged with AddPath() and
+     * call Build(). Directories are searched recursively for files with
+     * the extensions .gig, .dls and .sf2 (ignoring case). Files which cannot
+     * be read are cataloged as failed files without instruments and samples,
+     * so they are not rescanned until they change.
+     */
+    class Builder {
+        public:
+            Builder();
+            void          AddPath(const String& path);
+            void          SetThreadCount(int count);
+            void          SetChecksums(bool b);
+            build_stats_t Build(const String& indexPath, RIFF::progress_t* pProgress = NULL);
+        private:
+            std::vector<String> Paths;
+            int                 ThreadCount;
+            bool                bChecksums;
+
+            void __collectFiles(const String& path, std::vector<String>& files);
+            static void __scanJob(void* arg, size_t index);
+    };
+
+    probe_info_t ProbeFile(const String& path);
+
+    /**
+     * Will be thrown whenever an error occurs while reading or writing a
+     * catalog index file.
+     */
+    class Exception : public RIFF::Exception {
+        public:
+            Exception(String format, ...);
+            Exception(String format, va_list arg);
+            void PrintMessage();
+        protected:
+            Exception();
+    };
+
+} // namespace Catalog
+
+#endif // __CATALOG_H__
@@ -24,6 +24,7 @@
 #include "DLS.h"
 
 #include <algorithm>
+#include <math.h>
 #include <time.h>
 
 #ifdef __APPLE__
@@ -104,6 +105,79 @@ namespace DLS {
 
 
 
+// *************** Connection transforms  ***************
+// *
+
+    namespace {
+        // unipolar transform curves of the DLS Level 2 specification
+        inline float connCurve(int Transform, float x) {
+            switch (Transform) {
+                case conn_trn_concave:
+                    return (x >= 1.f) ? 1.f : std::min(1.f, float(-40.0 / 96.0 * log10(1.0 - x)));
+                case conn_trn_convex:
+                    return (x <= 0.f) ? 0.f : std::max(0.f, float(1.0 + 40.0 / 96.0 * log10(double(x))));
+                case conn_trn_switch:
+                    return (x >= 0.5f) ? 1.f : 0.f;
+                default:
+                    return x;
+            }
+        }
+
+        template<int Transform, bool Invert, bool Bipolar>
+        float connTransform(float x) {
+            if (x < 0.f) x = 0.f;
+            else if (x > 1.f) x = 1.f;
+            if (Invert) x = 1.f - x;
+            if (!Bipolar) return connCurve(Transform, x);
+            if (Transform == conn_trn_none)   return 2.f * x - 1.f;
+            if (Transform == conn_trn_switch) return (x >= 0.5f) ? 1.f : -1.f;
+            // bipolar curves are mirrored around the center
+            return (x >= 0.5f) ? connCurve(Transform, 2.f * x - 1.f)
+                               : -connCurve(Transform, 1.f - 2.f * x);
+        }
+
+        #define CONN_TRANSFORMS(t) \
+            { { connTransform<t, false, false>, connTransform<t, false, true> }, \
+              { connTransform<t, true,  false>, connTransform<t, true,  true> } }
+
+        const conn_transform_func_t connTransforms[4][2][2] = {
+            CONN_TRANSFORMS(conn_trn_none),
+            CONN_TRANSFORMS(conn_trn_concave),
+            CONN_TRANSFORMS(conn_trn_convex),
+            CONN_TRANSFORMS(conn_trn_switch)
+        };
+
+        #undef CONN_TRANSFORMS
+
+        struct lessConnectionDestination {
+            const Connection* pConnections;
+            lessConnectionDestination(const Connection* p) : pConnections(p) {}
+            bool operator()(uint32_t a, uint32_t b) const {
+                return pConnections[a].Destination < pConnections[b].Destination;
+            }
+        };
+
+        bool lessCompiledDestination(const compiled_destination_t& a, conn_dst_t b) {
+            return a.Destination < b;
+        }
+    }
+
+    /**
+     * Returns the function implementing the given connection transform (as
+     * defined by the DLS Level 2 specification) for a connection's source
+     * or control. Unknown transforms are treated like conn_trn_none.
+     *
+     * @param Transform - transform curve
+     * @param Invert    - whether the input value is inverted
+     * @param Bipolar   - whether the output value is bipolar (-1.0 .. 1.0)
+     */
+    conn_transform_func_t GetConnectionTransform(conn_trn_t Transform, bool Invert, bool Bipolar) {
+        const int t = (Transform >= conn_trn_none && Transform <= conn_trn_switch) ? Transform : conn_trn_none;
+        return connTransforms[t][Invert][Bipolar];
+    }
+
+
+
 // *************** Articulation  ***************
 // *
 
@@ -135,6 +209,104 @@ namespace DLS {
             artl->Read(&connblock.scale, 1, 4);
             pConnections[i].Init(&connblock);
         }
+        Compile();
+    }
+
+    /**
+     * Rebuilds the precompiled form of the connections of this
+     * articulation (see GetDestinations()), which is done automatically
+     * when the articulation is loaded. Call this method after modifying
+     * any connection.
+     */
+    void Articulation::Compile() {
+        std::vector<uint32_t> order(Connections);
+        for (uint32_t i = 0; i < Connections; ++i) order[i] = i;
+        // group by destination, keeping the file order of each group
+        std::stable_sort(order.begin(), order.end(), lessConnectionDestination(pConnections));
+        CompiledConnections.resize(Connections);
+        CompiledDestinations.clear();
+        for (uint32_t i = 0; i < Connections; ++i) {
+            const Connection& conn = pConnections[order[i]];
+            compiled_connection_t& c = CompiledConnections[i];
+            c.Source               = conn.Source;
+            c.Control              = conn.Control;
+            c.SourceTransform      = GetConnectionTransform(conn.SourceTransform, conn.SourceInvert, conn.SourceBipolar);
+            c.ControlTransform     = GetConnectionTransform(conn.ControlTransform, conn.ControlInvert, conn.ControlBipolar);
+            c.DestinationTransform = conn.DestinationTransform;
+            c.Scale                = float(int32_t(conn.Scale)) / 65536.f;
+            if (CompiledDestinations.empty() || CompiledDestinations.back().Destination != conn.Destination) {
+                compiled_destination_t d;
+                d.Destination     = conn.Destination;
+                d.FirstConnection = i;
+                d.Connections     = 0;
+                CompiledDestinations.push_back(d);
+            }
+            CompiledDestinations.back().Connections++;
+        }
+    }
+
+    /**
+     * Returns all destinations affected by this articulation, sorted by
+     * destination, each with the range of its connections within
+     * GetCompiledConnections(). The returned array remains valid until
+     * Compile() is called again.
+     *
+     * @param Count - (out) amount of destinations
+     */
+    const compiled_destination_t* Articulation::GetDestinations(size_t& Count) const {
+        Count = CompiledDestinations.size();
+        return (Count) ? &CompiledDestinations[0] : NULL;
+    }
+
+    /**
+     * Returns the connections affecting the given destination (see
+     * GetDestinations()), NULL if the destination is not affected by this
+     * articulation.
+     */
+    const compiled_destination_t* Articulation::GetDestination(conn_dst_t Destination) const {
+        std::vector<compiled_destination_t>::const_iterator it =
+            std::lower_bound(CompiledDestinations.begin(), CompiledDestinations.end(),
+                             Destination, lessCompiledDestination);
+        return (it != CompiledDestinations.end() && it->Destination == Destination) ? &*it : NULL;
+    }
+
+    /**
+     * Returns the precompiled connections of this articulation, grouped by
+     * destination (see GetDestinations()). The returned array remains
+     * valid until Compile() is called again.
+     *
+     * @param Count - (out) amount of connections
+     */
+    const compiled_connection_t* Articulation::GetCompiledConnections(size_t& Count) const {
+        Count = CompiledConnections.size();
+        return (Count) ? &CompiledConnections[0] : NULL;
+    }
+
+    /**
+     * Calculates the sum of all connections affecting the given
+     * destination, each being its scale multiplied with its transformed
+     * source and control value. This method does not allocate any memory.
+     *
+     * @param pDestination - destination as returned by GetDestination() or
+     *                       GetDestinations() (NULL yields 0.0)
+     * @param SourceValue  - returns the current normalized value of a source
+     *                       (never called for conn_src_none, which is 1.0)
+     * @param pUserData    - custom pointer passed to @a SourceValue
+     * @returns sum in destination units (e.g. cents for conn_dst_pitch)
+     */
+    float Articulation::Evaluate(const compiled_destination_t* pDestination, conn_source_value_func_t SourceValue, void* pUserData) const {
+        if (!pDestination) return 0.f;
+        float sum = 0.f;
+        const compiled_connection_t* c = &CompiledConnections[pDestination->FirstConnection];
+        for (uint32_t i = 0; i < pDestination->Connections; ++i, ++c) {
+            float value = c->Scale;
+            if (c->Source != conn_src_none)
+                value *= c->SourceTransform(SourceValue(c->Source, pUserData));
+            if (c->Control != conn_src_none)
+                value *= c->ControlTransform(SourceValue(c->Control, pUserData));
+            sum += value;
+        }
+        return sum;
     }
 
     Articulation::~Articulation() {
@@ -246,6 +418,41 @@ namespace DLS {
 // *************** Info  ***************
 // *
 
+    /** @brief Constructor.
+     *
+     * Initializes the info strings with values provided by an INFO list chunk.
+     *
+     * @param list - pointer to a list chunk which contains an INFO list chunk
+     */
+    namespace {
+        /// INFO chunk ID to Info member mapping.
+        struct info_field_t {
+            uint32_t       chunkID;
+            String Info::* member;
+        };
+
+        const info_field_t infoFields[] = {
+            { CHUNK_ID_INAM, &Info::Name },
+            { CHUNK_ID_IARL, &Info::ArchivalLocation },
+            { CHUNK_ID_ICRD, &Info::CreationDate },
+            { CHUNK_ID_ICMT, &Info::Comments },
+            { CHUNK_ID_IPRD, &Info::Product },
+            { CHUNK_ID_ICOP, &Info::Copyright },
+            { CHUNK_ID_IART, &Info::Artists },
+            { CHUNK_ID_IGNR, &Info::Genre },
+            { CHUNK_ID_IKEY, &Info::Keywords },
+            { CHUNK_ID_IENG, &Info::Engineer },
+            { CHUNK_ID_ITCH, &Info::Technician },
+            { CHUNK_ID_ISFT, &Info::Software },
+            { CHUNK_ID_IMED, &Info::Medium },
+            { CHUNK_ID_ISRC, &Info::Source },
+            { CHUNK_ID_ISRF, &Info::SourceForm },
+            { CHUNK_ID_ICMS, &Info::Commissioned },
+            { CHUNK_ID_ISBJ, &Info::Subject }
+        };
+        const size_t infoFieldCount = sizeof(infoFields) / sizeof(info_field_t);
+    }
+
     /** @brief Constructor.
      *
      * Initializes the info strings with values provided by an INFO list chunk.
@@ -258,23 +465,19 @@ namespace DLS {
         if (list) {
             RIFF::List* lstINFO = list->GetSubList(LIST_TYPE_INFO);
             if (lstINFO) {
-                LoadString(CHUNK_ID_INAM, lstINFO, Name);
-                LoadString(CHUNK_ID_IARL, lstINFO, ArchivalLocation);
-                LoadString(CHUNK_ID_ICRD, lstINFO, CreationDate);
-                LoadString(CHUNK_ID_ICMT, lstINFO, Comments);
-                LoadString(CHUNK_ID_IPRD, lstINFO, Product);
-                LoadString(CHUNK_ID_ICOP, lstINFO, Copyright);
-                LoadString(CHUNK_ID_IART, lstINFO, Artists);
-                LoadString(CHUNK_ID_IGNR, lstINFO, Genre);
-                LoadString(CHUNK_ID_IKEY, lstINFO, Keywords);
-                LoadString(CHUNK_ID_IENG, lstINFO, Engineer);
-                LoadString(CHUNK_ID_ITCH, lstINFO, Technician);
-                LoadString(CHUNK_ID_ISFT, lstINFO, Software);
-                LoadString(CHUNK_ID_IMED, lstINFO, Medium);
-                LoadString(CHUNK_ID_ISRC, lstINFO, Source);
-                LoadString(CHUNK_ID_ISRF, lstINFO, SourceForm);
-                LoadString(CHUNK_ID_ICMS, lstINFO, Commissioned);
-                LoadString(CHUNK_ID_ISBJ, lstINFO, Subject);
+                // only visit the INFO chunks actually present (usually just
+                // INAM), instead of looking up each of the possible fields
+                // (like with GetSubChunk() the last chunk of an ID wins)
+                const size_t n = lstINFO->CountSubChunks();
+                for (size_t i = 0; i < n; ++i) {
+                    RIFF::Chunk* ck = lstINFO->GetSubChunkAt(i);
+                    const uint32_t id = ck->GetChunkID();
+                    for (size_t f = 0; f < infoFieldCount; ++f) {
+                        if (infoFields[f].chunkID != id) continue;
+                        ::LoadString(ck, this->*infoFields[f].member); // function from helper.h
+                        break;
+                    }
+                }
             }
         }
     }
@@ -297,16 +500,6 @@ namespace DLS {
         pFixedStringLengths = lengths;
     }
 
-    /** @brief Load given INFO field.
-     *
-     * Load INFO field from INFO chunk with chunk ID \a ChunkID from INFO
-     * list chunk \a lstINFO and save value to \a s.
-     */
-    void Info::LoadString(uint32_t ChunkID, RIFF::List* lstINFO, String& s) {
-        RIFF::Chunk* ck = lstINFO->GetSubChunk(ChunkID);
-        ::LoadString(ck, s); // function from helper.h
-    }
-
     /** @brief Apply given INFO field to the respective chunk.
      *
      * Apply given info value to info chunk with ID \a ChunkID, which is a
@@ -713,6 +906,8 @@ namespace DLS {
      */
     Sample::Sample(File* pFile, RIFF::List* waveList, file_offset_t WavePoolOffset) : Resource(pFile, waveList) {
         pWaveList = waveList;
+        pHeadCache = NULL;
+        HeadCacheSamples = 0;
         ullWavePoolOffset = WavePoolOffset - LIST_HEADER_SIZE(waveList->GetFile()->GetFileOffsetSize());
         pCkFormat = waveList->GetSubChunk(CHUNK_ID_FMT);
         pCkData   = waveList->GetSubChunk(CHUNK_ID_DATA);
@@ -751,8 +946,13 @@ namespace DLS {
      * memory occupied by this sample.
      */
     Sample::~Sample() {
-        RIFF::List* pParent = pWaveList->GetParent();
-        pParent->DeleteSubChunk(pWaveList);
+        ReleaseSampleHead();
+        // (pWaveList is NULL if the sample's chunks shall be kept, i.e. the
+        // sample object is just freed, not deleted from the file)
+        if (pWaveList) {
+            RIFF::List* pParent = pWaveList->GetParent();
+            pParent->DeleteSubChunk(pWaveList);
+        }
     }
     
     /**
@@ -893,6 +1093,7 @@ namespace DLS {
         if (NewSize < 1) throw Exception("Sample size must be at least one sample point");
         if ((NewSize >> 48) != 0)
             throw Exception("Unrealistic high DLS sample size detected");
+        ReleaseSampleHead();
         const file_offset_t sizeInBytes = NewSize * FrameSize;
         pCkData = pWaveList->GetSubChunk(CHUNK_ID_DATA);
         if (pCkData) pCkData->Resize(sizeInBytes);
@@ -956,9 +1157,135 @@ namespace DLS {
     file_offset_t Sample::Write(void* pBuffer, file_offset_t SampleCount) {
         if (FormatTag != DLS_WAVE_FORMAT_PCM) return 0; // failed: wave data not PCM format
         if (GetSize() < SampleCount) throw Exception("Could not write sample data, current sample size to small");
+        ReleaseSampleHead();
         return pCkData->Write(pBuffer, SampleCount, FrameSize); // FIXME: channel inversion due to endian correction?
     }
 
+    /** @brief Read sample wave data from an arbitrary position.
+     *
+     * Reads \a SampleCount number of sample points, starting at sample
+     * point \a SamplePos, into the buffer pointed by \a pBuffer. In
+     * contrast to SetPos() and Read() this method neither uses nor modifies
+     * the current position within the sample (it uses
+     * RIFF::Chunk::ReadAt()), so it may be called concurrently by several
+     * threads (i.e. disk streaming voices) on the same Sample object, as
+     * long as the sample is not modified at the same time. The part of the
+     * requested range covered by a head previously loaded with
+     * LoadSampleHead() is served from RAM, only the remainder is read from
+     * disk. Hence this allows to stream sample data of large DLS files
+     * without loading the whole sample into RAM with LoadSampleData().
+     *
+     * Also note: only DLS_WAVE_FORMAT_PCM is currently supported.
+     *
+     * @param SamplePos   - position (in sample points) to start reading from
+     * @param pBuffer     - destination buffer
+     * @param SampleCount - number of sample points to read
+     * @returns number of sample points actually read, 0 if end of sample
+     *          was reached, if no data chunk exists (yet) or if
+     *          FormatTag != DLS_WAVE_FORMAT_PCM
+     * @see LoadSampleHead()
+     */
+    file_offset_t Sample::ReadAt(file_offset_t SamplePos, void* pBuffer, file_offset_t SampleCount) const {
+        if (FormatTag != DLS_WAVE_FORMAT_PCM || !FrameSize) return 0; // failed: wave data not PCM format
+        if (!pCkData) return 0;
+        file_offset_t read = 0;
+        if (SamplePos < HeadCacheSamples) {
+            read = HeadCacheSamples - SamplePos;
+            if (read > SampleCount) read = SampleCount;
+            memcpy(pBuffer, &pHeadCache[SamplePos * FrameSize], read * FrameSize);
+            if (read == SampleCount) return read;
+        }
+        return read + pCkData->ReadAt(
+            (SamplePos + read) * FrameSize, (uint8_t*) pBuffer + read * FrameSize,
+            SampleCount - read, FrameSize
+        ); // FIXME: channel inversion due to endian correction? (same as Read())
+    }
+
+    /** @brief Preload the head of the sample wave data into RAM.
+     *
+     * Loads the first \a SampleCount sample points of this sample into RAM
+     * (also known as "preloading"), so that a sampler can start playing
+     * the sample immediately from RAM, while it streams the rest of the
+     * sample from disk with ReadAt(). This is the DLS level equivalent of
+     * gig::Sample::LoadSampleData(file_offset_t). A previously loaded head
+     * is replaced. The head is released automatically whenever the sample
+     * data is altered by Resize() or Write().
+     *
+     * @param SampleCount - amount of sample points to preload (will be
+     *                      truncated to the sample's size)
+     * @returns pointer to the head in RAM, NULL if no sample data could be
+     *          loaded (i.e. no data chunk exists yet or
+     *          FormatTag != DLS_WAVE_FORMAT_PCM)
+     * @see ReadAt(), ReleaseSampleHead(), GetSampleHead()
+     */
+    const void* Sample::LoadSampleHead(file_offset_t SampleCount) {
+        ReleaseSampleHead();
+        const file_offset_t size = GetSize();
+        if (SampleCount > size) SampleCount = size;
+        if (!SampleCount) return NULL;
+        pHeadCache = new uint8_t[SampleCount * FrameSize];
+        HeadCacheSamples = pCkData->ReadAt(0, pHeadCache, SampleCount, FrameSize);
+        if (!HeadCacheSamples) ReleaseSampleHead();
+        return pHeadCache;
+    }
+
+    /** @brief Free the head of the sample wave data from RAM.
+     *
+     * Frees the sample head previously loaded by LoadSampleHead(), if any.
+     */
+    void Sample::ReleaseSampleHead() {
+        if (pHeadCache) delete[] pHeadCache;
+        pHeadCache = NULL;
+        HeadCacheSamples = 0;
+    }
+
+    /**
+     * Returns the format and length of this sample as stream (see
+     * SampleStream::Source). Only PCM samples can be streamed, for all
+     * other formats an empty stream is returned.
+     */
+    SampleStream::info_t Sample::GetStreamInfo() {
+        SampleStream::info_t info;
+        if (FormatTag != DLS_WAVE_FORMAT_PCM || !FrameSize) return info;
+        info.Channels    = Channels;
+        info.BitDepth    = BitDepth;
+        info.FrameSize   = FrameSize;
+        info.SampleRate  = SamplesPerSecond;
+        info.SampleCount = GetSize();
+        return info;
+    }
+
+    /**
+     * Reads sample points from any position like ReadAt() (i.e. also from
+     * the head loaded by LoadSampleHead()), in the given output format (see
+     * SampleStream::Source::ReadStream()). Like ReadAt(), this may be
+     * called by several threads concurrently.
+     */
+    SampleStream::pos_t Sample::ReadStream(SampleStream::pos_t Pos, void* pBuffer, SampleStream::pos_t SampleCount, SampleStream::format_t Format) {
+        if (Format == SampleStream::format_native || (Format == SampleStream::format_int16 && BitDepth == 16))
+            return ReadAt(Pos, pBuffer, SampleCount);
+        return ReadStreamConverted(GetStreamInfo(), Pos, pBuffer, SampleCount, Format);
+    }
+
+    /**
+     * DLS defines loops by the regions of instruments only, so a DLS sample
+     * stream never has a loop of its own.
+     */
+    bool Sample::GetStreamLoop(SampleStream::loop_t& Loop) {
+        Loop = SampleStream::loop_t();
+        return false;
+    }
+
+    /**
+     * Returns the head of this sample loaded by LoadSampleHead() (if any).
+     */
+    SampleStream::head_t Sample::GetStreamHead() {
+        SampleStream::head_t head;
+        head.pData       = pHeadCache;
+        head.SampleCount = (pHeadCache) ? HeadCacheSamples : 0;
+        return head;
+    }
+
     /**
      * Apply sample and its settings to the respective RIFF chunks. You have
      * to call File::Save() to make changes persistent.
@@ -1042,20 +1369,22 @@ namespace DLS {
      * Removes RIFF chunks associated with this Region.
      */
     Region::~Region() {
-        RIFF::List* pParent = pCkRegion->GetParent();
-        pParent->DeleteSubChunk(pCkRegion);
+        // (pCkRegion is NULL if the region's chunks shall be kept, i.e. the
+        // region object is just freed, not deleted from the instrument)
+        if (pCkRegion) {
+            RIFF::List* pParent = pCkRegion->GetParent();
+            pParent->DeleteSubChunk(pCkRegion);
+        }
     }
 
     Sample* Region::GetSample() {
         if (pSample) return pSample;
         File* file = (File*) GetParent()->GetParent();
+        if (WavePoolTableIndex >= file->WavePoolCount) return NULL;
         uint64_t soughtoffset = file->pWavePoolTable[WavePoolTableIndex];
-        Sample* sample = file->GetFirstSample();
-        while (sample) {
-            if (sample->ullWavePoolOffset == soughtoffset) return (pSample = sample);
-            sample = file->GetNextSample();
-        }
-        return NULL;
+        if (file->b64BitWavePoolOffsets)
+            soughtoffset |= uint64_t(file->pWavePoolTableHi[WavePoolTableIndex]) << 32;
+        return (pSample = file->__getSampleByWavePoolOffset(soughtoffset));
     }
 
     /**
@@ -1240,19 +1569,51 @@ namespace DLS {
         MIDIBank       = MIDI_BANK_MERGE(MIDIBankCoarse, MIDIBankFine);
 
         pRegions = NULL;
+        RegionsIndex = 0;
     }
 
     Region* Instrument::GetFirstRegion() {
         if (!pRegions) LoadRegions();
         if (!pRegions) return NULL;
-        RegionsIterator = pRegions->begin();
-        return (RegionsIterator != pRegions->end()) ? *RegionsIterator : NULL;
+        RegionsIndex = 0;
+        return (RegionsIndex < pRegions->size()) ? (*pRegions)[RegionsIndex] : NULL;
     }
 
     Region* Instrument::GetNextRegion() {
         if (!pRegions) return NULL;
-        RegionsIterator++;
-        return (RegionsIterator != pRegions->end()) ? *RegionsIterator : NULL;
+        RegionsIndex++;
+        return (RegionsIndex < pRegions->size()) ? (*pRegions)[RegionsIndex] : NULL;
+    }
+
+    /**
+     * Returns the Region at the given position of this instrument. In
+     * contrast to GetFirstRegion() and GetNextRegion() this method does not
+     * hold any iteration state in the Instrument object, so the regions of
+     * the same instrument may be traversed by several (nested) loops or
+     * threads at the same time, once they were loaded. The regions are
+     * stored contiguously, so this is a constant time operation, and the
+     * position of a region only changes by adding, moving or deleting
+     * regions.
+     *
+     * @param pos - position of the region (0 .. CountRegions() - 1)
+     * @returns region or NULL if @a pos is out of bounds
+     * @see CountRegions()
+     */
+    Region* Instrument::GetRegionAt(size_t pos) {
+        if (!pRegions) LoadRegions();
+        if (!pRegions) return NULL;
+        return (pos < pRegions->size()) ? (*pRegions)[pos] : NULL;
+    }
+
+    /**
+     * Returns the amount of regions of this instrument, i.e. the valid
+     * positions for GetRegionAt().
+     *
+     * @returns amount of regions
+     */
+    size_t Instrument::CountRegions() {
+        if (!pRegions) LoadRegions();
+        return (pRegions) ? pRegions->size() : 0;
     }
 
     void Instrument::LoadRegions() {
@@ -1285,7 +1646,7 @@ namespace DLS {
         RIFF::List* lrgn = pCkInstrument->GetSubList(LIST_TYPE_LRGN);
         lrgn->MoveSubChunk(pSrc->pCkRegion, (RIFF::Chunk*) (pDst ? pDst->pCkRegion : 0));
 
-        pRegions->remove(pSrc);
+        pRegions->erase(find(pRegions->begin(), pRegions->end(), pSrc));
         RegionList::iterator iter = find(pRegions->begin(), pRegions->end(), pDst);
         pRegions->insert(iter, pSrc);
     }
@@ -1423,6 +1784,44 @@ namespace DLS {
         pInstruments = NULL;
 
         b64BitWavePoolOffsets = false;
+        bSampleOffsetIndexValid = false;
+    }
+
+    /** @brief Load an existing DLS file without throwing exceptions.
+     *
+     * Like the constructor taking a RIFF::File, but failures are reported
+     * by returning NULL and by @a pResult instead of by an exception. The
+     * RIFF form type is checked first, so files of another type are sorted
+     * out without any exception being thrown (see RIFF::File::TryOpen()
+     * and RIFF::File::Probe() for checking the file itself that way).
+     *
+     * @param pRIFF - RIFF file to be loaded as DLS file (must stay
+     *                valid as long as the returned object exists)
+     * @param pResult - (optional) receives the reason of a failure
+     * @returns new File object (to be deleted by the caller), NULL on
+     *          failure
+     */
+    File* File::TryOpen(RIFF::File* pRIFF, RIFF::probe_result_t* pResult) {
+        RIFF::probe_status_t status = RIFF::probe_wrong_type;
+        const char* detail = "Not a DLS file";
+        if (pRIFF && pRIFF->GetListType() == RIFF_TYPE_DLS) {
+            try {
+                File* pFile = new File(pRIFF);
+                if (pResult) {
+                    pResult->Status = RIFF::probe_ok;
+                    pResult->Detail = "OK";
+                }
+                return pFile;
+            } catch (...) {
+                status = RIFF::probe_invalid;
+                detail = "Invalid DLS file";
+            }
+        }
+        if (pResult) {
+            pResult->Status = status;
+            pResult->Detail = detail;
+        }
+        return NULL;
     }
 
     /** @brief Constructor.
@@ -1481,6 +1880,7 @@ namespace DLS {
 
         pSamples     = NULL;
         pInstruments = NULL;
+        bSampleOffsetIndexValid = false;
     }
 
     File::~File() {
@@ -1526,6 +1926,7 @@ namespace DLS {
 
     void File::LoadSamples() {
         if (!pSamples) pSamples = new SampleList;
+        bSampleOffsetIndexValid = false;
         RIFF::List* wvpl = pRIFF->GetSubList(LIST_TYPE_WVPL);
         if (wvpl) {
             file_offset_t wvplFileOffset = wvpl->GetFilePos();
@@ -1569,6 +1970,7 @@ namespace DLS {
        RIFF::List* wave = wvpl->AddSubList(LIST_TYPE_WAVE);
        Sample* pSample = new Sample(this, wave, 0 /*arbitrary value, we update offsets when we save*/);
        pSamples->push_back(pSample);
+       bSampleOffsetIndexValid = false;
        return pSample;
     }
 
@@ -1584,9 +1986,43 @@ namespace DLS {
         SampleList::iterator iter = find(pSamples->begin(), pSamples->end(), pSample);
         if (iter == pSamples->end()) return;
         pSamples->erase(iter);
+        bSampleOffsetIndexValid = false;
         delete pSample;
     }
 
+    static bool __compareSampleOffsets(const std::pair<uint64_t,Sample*>& a, const std::pair<uint64_t,Sample*>& b) {
+        return a.first < b.first;
+    }
+
+    /**
+     * Returns the sample stored at the given offset within the wave pool.
+     * Instead of scanning the whole sample list for each lookup, an index
+     * of all samples sorted by their wave pool offset is built on first
+     * use and then searched by bisection. The index is invalidated whenever
+     * samples are added, deleted or their wave pool offsets change.
+     *
+     * @param Offset - offset of the sample's 'wave' list chunk relative to
+     *                 the wave pool's body (as stored in the 'ptbl' chunk)
+     * @returns sample at that offset or NULL if there is none
+     */
+    Sample* File::__getSampleByWavePoolOffset(uint64_t Offset) {
+        if (!pSamples) LoadSamples();
+        if (!pSamples) return NULL;
+        if (!bSampleOffsetIndexValid) {
+            SampleOffsetIndex.clear();
+            SampleOffsetIndex.reserve(pSamples->size());
+            for (SampleList::iterator it = pSamples->begin(); it != pSamples->end(); ++it)
+                SampleOffsetIndex.push_back(std::make_pair((*it)->ullWavePoolOffset, *it));
+            // stable, so the first sample of the list wins on duplicate offsets
+            std::stable_sort(SampleOffsetIndex.begin(), SampleOffsetIndex.end(), __compareSampleOffsets);
+            bSampleOffsetIndexValid = true;
+        }
+        std::vector< std::pair<uint64_t,Sample*> >::const_iterator it =
+            std::lower_bound(SampleOffsetIndex.begin(), SampleOffsetIndex.end(),
+                             std::make_pair(Offset, (Sample*) NULL), __compareSampleOffsets);
+        return (it != SampleOffsetIndex.end() && it->first == Offset) ? it->second : NULL;
+    }
+
     Instrument* File::GetFirstInstrument() {
         if (!pInstruments) LoadInstruments();
         if (!pInstruments) return NULL;
@@ -1687,6 +2123,25 @@ namespace DLS {
         pRIFF->SetFileName(name);
     }
 
+    /**
+     * Selects the NUMA node on which the sample data of this file shall be
+     * placed when it is loaded into RAM (see RIFF::File::SetNumaNode()).
+     * This also applies to samples stored in extension files.
+     *
+     * @param Node - node number, RIFF::numa_node_interleave or
+     *               RIFF::numa_node_default (default)
+     */
+    void File::SetNumaNode(int Node) {
+        pRIFF->SetNumaNode(Node);
+    }
+
+    /**
+     * Returns the NUMA placement of sample data selected by SetNumaNode().
+     */
+    int File::GetNumaNode() const {
+        return pRIFF->GetNumaNode();
+    }
+
     /**
      * Apply all the DLS file's current instruments, samples and settings to
      * the respective RIFF chunks. You have to call Save() to make changes
@@ -1750,6 +2205,17 @@ namespace DLS {
         // we actually update the sample offsets in the pool table when we Save()
         memset(&pData[WavePoolHeaderSize], 0, iPtblSize - WavePoolHeaderSize);
 
+        // reserve slack space in front of the wave pool (if requested), so
+        // later saves can keep the sample data where it is
+        const file_offset_t ullSlackSize = pRIFF->GetSlackSize();
+        if (ullSlackSize && !pRIFF->GetSubChunk(CHUNK_ID_JUNK)) {
+            RIFF::Chunk* junk = pRIFF->AddSubChunk(CHUNK_ID_JUNK, ullSlackSize + ullSlackSize % 2);
+            pData = (uint8_t*) junk->LoadChunkData();
+            if (pData) memset(pData, 0, junk->GetNewSize());
+            RIFF::List* wvpl = pRIFF->GetSubList(LIST_TYPE_WVPL);
+            if (wvpl) pRIFF->MoveSubChunk(junk, (RIFF::Chunk*) wvpl);
+        }
+
         // update sample's chunks
         if (pSamples) {
             // divide local progress into subprogress
@@ -1799,6 +2265,8 @@ namespace DLS {
      *
      * @param Path - path and file name where everything should be written to
      * @param pProgress - optional: callback function for progress notification
+     * @throws RIFF::CancelException if progress_t::cancel was set by the
+     *         progress callback before writing started (nothing is written)
      */
     void File::Save(const String& Path, progress_t* pProgress) {
         {
@@ -1806,9 +2274,12 @@ namespace DLS {
             progress_t subprogress;
             __divide_progress(pProgress, &subprogress, 2.f, 0.f); // arbitrarily subdivided into 50% of total progress
             // do the actual work
+            trace_scope_t trace(pRIFF->GetTracer(), RIFF::trace_save_begin, pRIFF, 0, 0, "update chunks");
             UpdateChunks(&subprogress);
             
         }
+        // writing can not be cancelled anymore once it started
+        if (__cancel_requested(pProgress)) throw RIFF::CancelException();
         {
             // divide local progress into subprogress
             progress_t subprogress;
@@ -1829,6 +2300,8 @@ namespace DLS {
      * @param pProgress - optional: callback function for progress notification
      * @throws RIFF::Exception if any kind of IO error occurred
      * @throws DLS::Exception  if any kind of DLS specific error occurred
+     * @throws RIFF::CancelException if progress_t::cancel was set by the
+     *         progress callback before writing started (nothing is written)
      */
     void File::Save(progress_t* pProgress) {
         {
@@ -1836,8 +2309,11 @@ namespace DLS {
             progress_t subprogress;
             __divide_progress(pProgress, &subprogress, 2.f, 0.f); // arbitrarily subdivided into 50% of total progress
             // do the actual work
+            trace_scope_t trace(pRIFF->GetTracer(), RIFF::trace_save_begin, pRIFF, 0, 0, "update chunks");
             UpdateChunks(&subprogress);
         }
+        // writing can not be cancelled anymore once it started
+        if (__cancel_requested(pProgress)) throw RIFF::CancelException();
         {
             // divide local progress into subprogress
             progress_t subprogress;
@@ -1939,6 +2415,7 @@ namespace DLS {
         if (pWavePoolTableHi) delete[] pWavePoolTableHi;
         pWavePoolTable   = new uint32_t[WavePoolCount];
         pWavePoolTableHi = new uint32_t[WavePoolCount];
+        bSampleOffsetIndexValid = false;
         if (!pSamples) return;
         // update offsets int wave pool table
         RIFF::List* wvpl = pRIFF->GetSubList(LIST_TYPE_WVPL);
@@ -1963,6 +2440,65 @@ namespace DLS {
         }
     }
 
+    /**
+     * Updates the wave pool table and the 'ptbl' chunk's data in RAM with
+     * offsets to all currently available samples, calculated from the
+     * chunk sizes the file is going to be saved with, instead of the
+     * positions the chunks are currently stored at. This allows to write
+     * the 'ptbl' chunk before the wave pool when saving sequentially (see
+     * RIFF::File::SaveSequential()). <b>Caution:</b> this method assumes
+     * the 'ptbl' chunk and the 'wvpl' list chunk to exist already with
+     * their final size, so usually this is called after UpdateChunks().
+     *
+     * @param fileOffsetSize - RIFF file offset size (in bytes) the file is
+     *                         going to be saved with
+     * @throws Exception - if 'ptbl' chunk is too small (should only occur
+     *                     if there's a bug)
+     */
+    void File::__UpdateWavePoolTableChunkInRAM(int fileOffsetSize) {
+        WavePoolCount = (pSamples) ? uint32_t(pSamples->size()) : 0;
+        // resize wave pool table arrays
+        if (pWavePoolTable)   delete[] pWavePoolTable;
+        if (pWavePoolTableHi) delete[] pWavePoolTableHi;
+        pWavePoolTable   = new uint32_t[WavePoolCount];
+        pWavePoolTableHi = new uint32_t[WavePoolCount];
+        bSampleOffsetIndexValid = false;
+
+        RIFF::Chunk* ptbl = pRIFF->GetSubChunk(CHUNK_ID_PTBL);
+        const int iOffsetSize = (b64BitWavePoolOffsets) ? 8 : 4;
+        const file_offset_t ulRequiredSize = WavePoolHeaderSize + iOffsetSize * WavePoolCount;
+        if (!ptbl || ptbl->GetNewSize() < ulRequiredSize) throw Exception("Fatal error, 'ptbl' chunk too small");
+        uint8_t* pData = (uint8_t*) ptbl->LoadChunkData();
+        if (!pData) throw Exception("Could not load 'ptbl' chunk into RAM");
+        store32(&pData[0], WavePoolHeaderSize);
+        store32(&pData[4], WavePoolCount);
+        if (!pSamples) return;
+
+        // offsets of all wave list chunks relative to the wave pool's body
+        std::map<RIFF::Chunk*,uint64_t> offsets;
+        RIFF::List* wvpl = pRIFF->GetSubList(LIST_TYPE_WVPL);
+        uint64_t offset = 0;
+        for (RIFF::Chunk* ck = wvpl->GetFirstSubChunk(); ck; ck = wvpl->GetNextSubChunk()) {
+            offsets[ck] = offset;
+            offset += ck->RequiredPhysicalSize(fileOffsetSize);
+        }
+
+        SampleList::iterator iter = pSamples->begin();
+        SampleList::iterator end  = pSamples->end();
+        for (int i = 0 ; iter != end ; ++iter, i++) {
+            const uint64_t _64BitOffset = offsets[(*iter)->pWaveList];
+            (*iter)->ullWavePoolOffset = _64BitOffset;
+            pWavePoolTableHi[i] = (uint32_t) (_64BitOffset >> 32);
+            pWavePoolTable[i]   = (uint32_t) _64BitOffset;
+            if (b64BitWavePoolOffsets) {
+                store32(&pData[WavePoolHeaderSize + i * 8],     pWavePoolTableHi[i]);
+                store32(&pData[WavePoolHeaderSize + i * 8 + 4], pWavePoolTable[i]);
+            } else {
+                store32(&pData[WavePoolHeaderSize + i * 4], pWavePoolTable[i]);
+            }
+        }
+    }
+
 
 
 // *************** Exception ***************
@@ -25,6 +25,7 @@
 #define __DLS_H__
 
 #include "RIFF.h"
+#include "SampleStream.h"
 
 #if WORDS_BIGENDIAN
 # define RIFF_TYPE_DLS	0x444C5320
@@ -202,6 +203,33 @@ namespace DLS {
         conn_trn_switch  = 0x0003
     };
 
+    /**
+     * Transform function of a connection's source or control (see
+     * GetConnectionTransform()): maps the normalized input value (0.0 ..
+     * 1.0) to the transformed value (0.0 .. 1.0, or -1.0 .. 1.0 if bipolar).
+     */
+    typedef float (*conn_transform_func_t)(float Value);
+
+    /** @brief Precompiled form of a Connection (see Articulation::GetCompiledConnections()). */
+    struct compiled_connection_t {
+        conn_src_t            Source;           ///< Source of the connection (conn_src_none means constant 1.0).
+        conn_src_t            Control;          ///< Control of the connection (conn_src_none means constant 1.0).
+        conn_transform_func_t SourceTransform;  ///< Curve, inversion and polarity of the source resolved to a function.
+        conn_transform_func_t ControlTransform; ///< Curve, inversion and polarity of the control resolved to a function.
+        conn_trn_t            DestinationTransform; ///< Output transform of the connection (not applied by Articulation::Evaluate()).
+        float                 Scale;            ///< Signed scale of the connection in destination units (i.e. the 16.16 fixed point scale of the connection block converted to float).
+    };
+
+    /** @brief All connections of an Articulation affecting one destination (see Articulation::GetDestinations()). */
+    struct compiled_destination_t {
+        conn_dst_t Destination;     ///< Destination affected by the connections.
+        uint32_t   FirstConnection; ///< Index of the first of these connections in Articulation::GetCompiledConnections().
+        uint32_t   Connections;     ///< Amount of connections affecting this destination.
+    };
+
+    /// Returns the current value (0.0 .. 1.0) of the given source for Articulation::Evaluate().
+    typedef float (*conn_source_value_func_t)(conn_src_t Source, void* pUserData);
+
     /** Lower and upper limit of a range. */
     struct range_t {
         uint16_t low;  ///< Low value of range.
@@ -279,9 +307,16 @@ namespace DLS {
             Articulation(RIFF::Chunk* artl);
             virtual ~Articulation();
             virtual void UpdateChunks(progress_t* pProgress);
+            void Compile();
+            const compiled_destination_t* GetDestinations(size_t& Count) const;
+            const compiled_destination_t* GetDestination(conn_dst_t Destination) const;
+            const compiled_connection_t*  GetCompiledConnections(size_t& Count) const;
+            float Evaluate(const compiled_destination_t* pDestination, conn_source_value_func_t SourceValue, void* pUserData) const;
         protected:
             RIFF::Chunk* pArticulationCk;
             uint32_t     HeaderSize;
+            std::vector<compiled_connection_t>  CompiledConnections;  ///< Connections grouped by destination (see Compile()).
+            std::vector<compiled_destination_t> CompiledDestinations; ///< Sorted by destination.
     };
 
     /** Abstract base class for classes that provide articulation information (thus for <i>Instrument</i> and <i>Region</i> class). */
@@ -338,7 +373,6 @@ namespace DLS {
             RIFF::List*            pResourceListChunk;
             const string_length_t* pFixedStringLengths; ///< List of IDs and string lengths for strings that should be stored in a fixed length format. This is used for gig files, not for ordinary DLS files.
 
-            static void LoadString(uint32_t ChunkID, RIFF::List* lstINFO, String& s);
             void SaveString(uint32_t ChunkID, RIFF::List* lstINFO, const String& s, const String& sDefault);
     };
 
@@ -393,7 +427,7 @@ namespace DLS {
      * Resize() with the desired sample size. The latter will create
      * the mandatory RIFF chunk which will hold the sample wave data.
      */
-    class Sample : public Resource {
+    class Sample : public Resource, public SampleStream::Source {
         public:
             uint16_t      FormatTag;             ///< Format ID of the waveform data (should be DLS_WAVE_FORMAT_PCM for DLS1 compliant files, this is also the default value if Sample was created with Instrument::AddSample()).
             uint16_t      Channels;              ///< Number of channels represented in the waveform data, e.g. 1 for mono, 2 for stereo (defaults to 1=mono if Sample was created with Instrument::AddSample() previously).
@@ -411,14 +445,26 @@ namespace DLS {
             file_offset_t SetPos(file_offset_t SampleCount, RIFF::stream_whence_t Whence = RIFF::stream_start);
             file_offset_t Read(void* pBuffer, file_offset_t SampleCount);
             file_offset_t Write(void* pBuffer, file_offset_t SampleCount);
+            file_offset_t ReadAt(file_offset_t SamplePos, void* pBuffer, file_offset_t SampleCount) const;
+            const void*   LoadSampleHead(file_offset_t SampleCount);
+            const void*   GetSampleHead() const { return pHeadCache; } ///< Returns the RAM cache of the sample's head loaded by LoadSampleHead(), or NULL if none is loaded.
+            file_offset_t GetSampleHeadSize() const { return HeadCacheSamples; } ///< Returns the amount of sample points currently cached by LoadSampleHead().
+            void          ReleaseSampleHead();
             virtual void  UpdateChunks(progress_t* pProgress);
             virtual void  CopyAssign(const Sample* orig);
+            // implementation of SampleStream::Source
+            virtual SampleStream::info_t GetStreamInfo();
+            virtual SampleStream::pos_t  ReadStream(SampleStream::pos_t Pos, void* pBuffer, SampleStream::pos_t SampleCount, SampleStream::format_t Format = SampleStream::format_native);
+            virtual bool                 GetStreamLoop(SampleStream::loop_t& Loop);
+            virtual SampleStream::head_t GetStreamHead();
 
         protected:
             RIFF::List*   pWaveList;
             RIFF::Chunk*  pCkData;
             RIFF::Chunk*  pCkFormat;
             file_offset_t ullWavePoolOffset;  // needed for comparison with the wave pool link table, thus the link to instruments
+            uint8_t*      pHeadCache;         ///< Preloaded head of the sample wave data (see LoadSampleHead()), NULL if none.
+            file_offset_t HeadCacheSamples;   ///< Amount of sample points in pHeadCache.
 
             Sample(File* pFile, RIFF::List* waveList, file_offset_t WavePoolOffset);
             virtual ~Sample();
@@ -469,12 +515,14 @@ namespace DLS {
 
             Region*  GetFirstRegion();
             Region*  GetNextRegion();
+            Region*  GetRegionAt(size_t pos);
+            size_t   CountRegions();
             Region*  AddRegion();
             void     DeleteRegion(Region* pRegion);
             virtual void UpdateChunks(progress_t* pProgress);
             virtual void CopyAssign(const Instrument* orig);
         protected:
-            typedef std::list<Region*> RegionList;
+            typedef std::vector<Region*> RegionList;
             struct midi_locale_t {
                 uint32_t bank;
                 uint32_t instrument;
@@ -482,7 +530,7 @@ namespace DLS {
 
             RIFF::List*          pCkInstrument;
             RegionList*          pRegions;
-            RegionList::iterator RegionsIterator;
+            size_t               RegionsIndex; ///< Position of GetNextRegion() within pRegions.
 
             Instrument(File* pFile, RIFF::List* insList);
             void CopyAssignCore(const Instrument* orig);
@@ -502,6 +550,7 @@ namespace DLS {
 
             File();
             File(RIFF::File* pRIFF);
+            static File* TryOpen(RIFF::File* pRIFF, RIFF::probe_result_t* pResult = NULL);
             String      GetFileName();
             void        SetFileName(const String& name);
             Sample*     GetFirstSample();     ///< Returns a pointer to the first <i>Sample</i> object of the file, <i>NULL</i> otherwise.
@@ -513,6 +562,8 @@ namespace DLS {
             Instrument* AddInstrument();
             void        DeleteInstrument(Instrument* pInstrument);
             RIFF::File* GetExtensionFile(int index);
+            void        SetNumaNode(int Node);
+            int         GetNumaNode() const;
             virtual void UpdateChunks(progress_t* pProgress);
             virtual void Save(const String& Path, progress_t* pProgress = NULL);
             virtual void Save(progress_t* pProgress = NULL);
@@ -532,11 +583,15 @@ namespace DLS {
             uint32_t*                pWavePoolTable;
             uint32_t*                pWavePoolTableHi;
             bool                     b64BitWavePoolOffsets;
+            std::vector< std::pair<uint64_t,Sample*> > SampleOffsetIndex; ///< All samples sorted by their wave pool offset (lazily built by __getSampleByWavePoolOffset()).
+            bool                     bSampleOffsetIndexValid;
 
             virtual void LoadSamples();
             virtual void LoadInstruments();
             virtual void UpdateFileOffsets();
             void __ensureMandatoryChunksExist();
+            void __UpdateWavePoolTableChunkInRAM(int fileOffsetSize);
+            Sample* __getSampleByWavePoolOffset(uint64_t Offset);
             friend class Region; // Region has to look in the wave pool table to get its sample
         private:
             void __UpdateWavePoolTableChunk();
@@ -561,6 +616,7 @@ namespace DLS {
 
     String libraryName();
     String libraryVersion();
+    conn_transform_func_t GetConnectionTransform(conn_trn_t Transform, bool Invert, bool Bipolar);
 
 } // namespace DLS
 
@@ -0,0 +1,711 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this library; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#include "HTTPDevice.h"
+
+#include "helper.h"
+
+#if HAVE_LIBCURL
+
+#include <list>
+#include <map>
+#include <vector>
+#include <stdio.h>
+#include <curl/curl.h>
+
+#if POSIX
+# include <errno.h>
+# include <fcntl.h>
+# include <sys/file.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+/// Size of the blocks in which the file is requested from the server and kept in the block cache.
+#define HTTP_BLOCK_SIZE             (32 * 1024)
+
+/// Default amount of bytes requested beyond the end of isolated (i.e. non sequential) reads, like reading chunk headers while the file is loaded.
+#define HTTP_HEADER_READ_AHEAD      (32 * 1024)
+
+/// Initial amount of bytes requested ahead of sequential reads, doubled with every further sequential read up to the stream read ahead size.
+#define HTTP_STREAM_READ_AHEAD_MIN  (256 * 1024)
+
+/// Default max. amount of bytes requested ahead of sequential reads (see HTTPDevice::SetReadAhead()).
+#define HTTP_STREAM_READ_AHEAD      (4 * 1024 * 1024)
+
+/// Default max. size of the block cache in RAM (see HTTPDevice::SetMemoryCacheLimit()).
+#define HTTP_MEMORY_CACHE_LIMIT     (32 * 1024 * 1024)
+
+/// Amount of blocks added to the persistent cache after which its index file is updated.
+#define HTTP_INDEX_FLUSH_INTERVAL   256
+
+/// Max. amount of ranges remembered as being read sequentially (see advice_sequential).
+#define HTTP_MAX_SEQUENTIAL_RANGES  256
+
+/// Identifies the index files of the persistent block cache.
+#define HTTP_CACHE_INDEX_MAGIC      "libgig-http-cache-1"
+
+namespace RIFF {
+
+// *************** http_device_t ***************
+// *
+
+    static mutex_t curlGlobalMutex;
+    static bool bCurlGlobalInitialized = false;
+
+    /// Private data of a HTTPDevice object.
+    struct http_device_t {
+        String  URL;
+        CURL*   pCurl;
+        mutable mutex_t mutex; ///< Protects all members below (and serializes the requests).
+
+        file_offset_t Size;
+        String        Validator; ///< ETag or Last-Modified header of the file (empty if the server sends neither).
+        http_statistics_t Statistics;
+
+        // read ahead
+        file_offset_t HeaderReadAhead;
+        file_offset_t StreamReadAhead;
+        file_offset_t StreamWindow; ///< Current read ahead of the sequential reads, 0 if the last read was not sequential.
+        file_offset_t LastEnd;      ///< End position of the last read.
+        std::list< std::pair<file_offset_t,file_offset_t> > SequentialRanges; ///< Ranges advised as sequential (start, end).
+
+        // block cache in RAM (if there is no persistent cache)
+        struct block_t {
+            std::vector<uint8_t> data;
+            std::list<uint64_t>::iterator lruPos;
+        };
+        std::map<uint64_t,block_t> Blocks;
+        std::list<uint64_t> LRU; ///< Most recently used block first.
+        file_offset_t MemoryUsed;
+        file_offset_t MemoryLimit;
+
+        // persistent block cache
+        bool   bPersistent;
+        #if POSIX
+        int    hData;  ///< Cached blocks, at their position in the file (sparse).
+        int    hIndex; ///< Header and bitmap of the cached blocks, locked exclusively while in use.
+        #endif
+        std::vector<uint8_t> Bitmap;
+        int    DirtyBlocks; ///< Amount of blocks cached since the index was written.
+
+        // current response
+        std::vector<uint8_t>* pBody;
+        String  ContentRange;
+        String  ETag;
+        String  LastModified;
+
+        http_device_t() : pCurl(NULL), Size(0), HeaderReadAhead(HTTP_HEADER_READ_AHEAD),
+            StreamReadAhead(HTTP_STREAM_READ_AHEAD), StreamWindow(0), LastEnd(0),
+            MemoryUsed(0), MemoryLimit(HTTP_MEMORY_CACHE_LIMIT), bPersistent(false),
+            #if POSIX
+            hData(-1), hIndex(-1),
+            #endif
+            DirtyBlocks(0), pBody(NULL)
+        {
+            memset(&Statistics, 0, sizeof(Statistics));
+        }
+
+        uint64_t blockCount() const {
+            return (Size + HTTP_BLOCK_SIZE - 1) / HTTP_BLOCK_SIZE;
+        }
+
+        file_offset_t blockSize(uint64_t block) const {
+            const file_offset_t start = block * HTTP_BLOCK_SIZE;
+            return (Size - start < HTTP_BLOCK_SIZE) ? Size - start : HTTP_BLOCK_SIZE;
+        }
+
+        // HTTP requests
+
+        static size_t writeCallback(char* ptr, size_t size, size_t nmemb, void* userdata) {
+            http_device_t* d = (http_device_t*) userdata;
+            d->pBody->insert(d->pBody->end(), (uint8_t*) ptr, (uint8_t*) ptr + size * nmemb);
+            return size * nmemb;
+        }
+
+        static size_t headerCallback(char* buffer, size_t size, size_t nitems, void* userdata) {
+            http_device_t* d = (http_device_t*) userdata;
+            String line(buffer, size * nitems);
+            while (!line.empty() && (line[line.size() - 1] == '\n' || line[line.size() - 1] == '\r'))
+                line.erase(line.size() - 1);
+            const String::size_type colon = line.find(':');
+            if (colon == String::npos) {
+                // status line of a (further) response, i.e. after a redirect
+                if (line.compare(0, 5, "HTTP/") == 0) {
+                    d->ContentRange = d->ETag = d->LastModified = "";
+                    d->pBody->clear();
+                }
+                return size * nitems;
+            }
+            String name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            String value = line.substr(colon + 1);
+            while (!value.empty() && value[0] == ' ') value.erase(0, 1);
+            if (name == "content-range") d->ContentRange = value;
+            else if (name == "etag") d->ETag = value;
+            else if (name == "last-modified") d->LastModified = value;
+            return size * nitems;
+        }
+
+        /**
+         * Requests the bytes @a First to @a Last (inclusive) of the file
+         * into @a body and returns the HTTP status code (206 or 200).
+         */
+        long request(file_offset_t First, file_offset_t Last, std::vector<uint8_t>& body) {
+            const String range = ToString(First) + "-" + ToString(Last);
+            CURLcode res = CURLE_OK;
+            long status = 0;
+            for (int attempt = 0; attempt < 2; ++attempt) {
+                body.clear();
+                pBody = &body;
+                ContentRange = ETag = LastModified = "";
+                curl_easy_setopt(pCurl, CURLOPT_RANGE, range.c_str());
+                res = curl_easy_perform(pCurl);
+                pBody = NULL;
+                Statistics.Requests++;
+                Statistics.BytesDownloaded += body.size();
+                if (res == CURLE_OK) break;
+            }
+            if (res != CURLE_OK)
+                throw Exception("HTTP request of '" + URL + "' failed: " + curl_easy_strerror(res));
+            curl_easy_getinfo(pCurl, CURLINFO_RESPONSE_CODE, &status);
+            if (status != 206 && status != 200)
+                throw Exception("HTTP request of '" + URL + "' failed: status " + ToString(status));
+            if (status == 200 && (First != 0 || (Size && body.size() != Size)))
+                throw Exception("HTTP server of '" + URL + "' does not support range requests");
+            return status;
+        }
+
+        /// Returns the file size given by the Content-Range header of the last response.
+        file_offset_t totalSize() const {
+            const String::size_type slash = ContentRange.rfind('/');
+            if (ContentRange.compare(0, 6, "bytes ") != 0 || slash == String::npos ||
+                ContentRange.compare(slash + 1, String::npos, "*") == 0)
+                throw Exception("HTTP server of '" + URL + "' sent an invalid Content-Range header");
+            return strtoull(ContentRange.c_str() + slash + 1, NULL, 10);
+        }
+
+        String validator() const {
+            return (!ETag.empty()) ? "ETag: " + ETag :
+                   (!LastModified.empty()) ? "Last-Modified: " + LastModified : "";
+        }
+
+        /// Requests the first block and determines the file's size and identity.
+        void open(std::vector<uint8_t>& firstBlock) {
+            const long status = request(0, HTTP_BLOCK_SIZE - 1, firstBlock);
+            if (status == 200 && firstBlock.size() > HTTP_BLOCK_SIZE)
+                throw Exception("HTTP server of '" + URL + "' does not support range requests");
+            Size = (status == 206) ? totalSize() : firstBlock.size();
+            Validator = validator();
+            if (firstBlock.size() != ((Size < HTTP_BLOCK_SIZE) ? Size : HTTP_BLOCK_SIZE))
+                throw Exception("HTTP server of '" + URL + "' sent an incomplete response");
+        }
+
+        /// Downloads @a Count blocks starting with block @a First into @a body and adds them to the cache.
+        void fetch(uint64_t First, uint64_t Count, std::vector<uint8_t>& body) {
+            const file_offset_t start = First * HTTP_BLOCK_SIZE;
+            file_offset_t end = (First + Count) * HTTP_BLOCK_SIZE;
+            if (end > Size) end = Size;
+            const long status = request(start, end - 1, body);
+            if (body.size() != end - start || (status == 206 && totalSize() != Size))
+                throw Exception("HTTP server of '" + URL + "' sent an incomplete response");
+            const String v = validator();
+            if (!v.empty() && !Validator.empty() && v != Validator)
+                throw Exception("File '" + URL + "' changed on the HTTP server while being read");
+            for (uint64_t i = 0; i < Count; ++i)
+                store(First + i, &body[i * HTTP_BLOCK_SIZE]);
+        }
+
+        // block cache
+
+        bool has(uint64_t block) const {
+            if (bPersistent)
+                return Bitmap[block / 8] & (1 << (block % 8));
+            return Blocks.count(block);
+        }
+
+        /// Copies @a n bytes from position @a offset of the cached @a block.
+        void copyFrom(uint64_t block, file_offset_t offset, uint8_t* pDst, file_offset_t n) {
+            #if POSIX
+            if (bPersistent) {
+                const file_offset_t pos = block * HTTP_BLOCK_SIZE + offset;
+                for (file_offset_t done = 0; done < n; ) {
+                    ssize_t r = pread(hData, pDst + done, n - done, pos + done);
+                    if (r < 0 && errno == EINTR) continue;
+                    if (r <= 0) throw Exception("Could not read HTTP block cache of '" + URL + "'");
+                    done += r;
+                }
+                return;
+            }
+            #endif
+            block_t& b = Blocks[block];
+            LRU.splice(LRU.begin(), LRU, b.lruPos);
+            memcpy(pDst, &b.data[offset], n);
+        }
+
+        void store(uint64_t block, const uint8_t* pData) {
+            if (has(block)) return;
+            const file_offset_t n = blockSize(block);
+            #if POSIX
+            if (bPersistent) {
+                const file_offset_t pos = block * HTTP_BLOCK_SIZE;
+                for (file_offset_t done = 0; done < n; ) {
+                    ssize_t r = pwrite(hData, pData + done, n - done, pos + done);
+                    if (r < 0 && errno == EINTR) continue;
+                    if (r <= 0) return; // i.e. disk full, the block is just not cached then
+                    done += r;
+                }
+                Bitmap[block / 8] |= (1 << (block % 8));
+                if (++DirtyBlocks >= HTTP_INDEX_FLUSH_INTERVAL) flushIndex();
+                return;
+            }
+            #endif
+            block_t& b = Blocks[block];
+            b.data.assign(pData, pData + n);
+            LRU.push_front(block);
+            b.lruPos = LRU.begin();
+            MemoryUsed += n;
+            while (MemoryUsed > MemoryLimit && LRU.size() > 1) evict(LRU.back());
+        }
+
+        void evict(uint64_t block) {
+            std::map<uint64_t,block_t>::iterator it = Blocks.find(block);
+            if (it == Blocks.end()) return;
+            MemoryUsed -= it->second.data.size();
+            LRU.erase(it->second.lruPos);
+            Blocks.erase(it);
+        }
+
+        // persistent block cache
+
+        #if POSIX
+        String indexHeader() const {
+            return String(HTTP_CACHE_INDEX_MAGIC) + "\n" + URL + "\n" + ToString(Size) + "\n" +
+                   ToString(HTTP_BLOCK_SIZE) + "\n" + Validator + "\n";
+        }
+
+        /**
+         * Opens (or creates) the cache files of the URL in @a Dir. The
+         * blocks cached already are only reused if the file on the server
+         * has still the same size and validator. If the cache files can't
+         * be used (i.e. because they are locked by another process) the
+         * RAM is used for the block cache instead.
+         */
+        void openCache(const String& Dir) {
+            if (Validator.empty()) return; // changes of the file could not be detected
+            // FNV-1a hash of the URL as file name
+            uint64_t hash = 14695981039346656037ULL;
+            for (size_t i = 0; i < URL.size(); ++i) {
+                hash ^= (uint8_t) URL[i];
+                hash *= 1099511628211ULL;
+            }
+            char name[17];
+            snprintf(name, sizeof(name), "%016llx", (unsigned long long) hash);
+            String path = Dir;
+            if (!path.empty() && path[path.size() - 1] != '/') path += '/';
+            path += name;
+
+            hIndex = ::open((path + ".index").c_str(), O_RDWR | O_CREAT, 0644);
+            if (hIndex < 0) return;
+            if (flock(hIndex, LOCK_EX | LOCK_NB) < 0) {
+                ::close(hIndex);
+                hIndex = -1;
+                return;
+            }
+            hData = ::open((path + ".cache").c_str(), O_RDWR | O_CREAT, 0644);
+            if (hData < 0) {
+                ::close(hIndex);
+                hIndex = -1;
+                return;
+            }
+            Bitmap.assign((blockCount() + 7) / 8, 0);
+            const String header = indexHeader();
+            struct stat st;
+            bool bValid = fstat(hIndex, &st) == 0 && st.st_size == off_t(header.size() + Bitmap.size());
+            if (bValid) {
+                std::vector<char> buf(header.size() + Bitmap.size());
+                bValid = pread(hIndex, &buf[0], buf.size(), 0) == ssize_t(buf.size()) &&
+                         memcmp(&buf[0], header.c_str(), header.size()) == 0;
+                if (bValid) memcpy(&Bitmap[0], &buf[header.size()], Bitmap.size());
+            }
+            if (!bValid) { // cache of another version of the file (or none yet)
+                if (ftruncate(hData, 0) < 0 || ftruncate(hIndex, 0) < 0) {}
+                Bitmap.assign(Bitmap.size(), 0);
+            }
+            if (ftruncate(hData, Size) < 0) {
+                closeCache();
+                return;
+            }
+            bPersistent = true;
+            DirtyBlocks = bValid ? 0 : 1; // write the header right away
+            if (!bValid) flushIndex();
+            // blocks cached in RAM before
+            for (std::map<uint64_t,block_t>::iterator it = Blocks.begin(); it != Blocks.end(); ++it)
+                store(it->first, &it->second.data[0]);
+            Blocks.clear();
+            LRU.clear();
+            MemoryUsed = 0;
+        }
+
+        void flushIndex() {
+            if (!bPersistent || !DirtyBlocks) return;
+            String buf = indexHeader();
+            buf.append((const char*) &Bitmap[0], Bitmap.size());
+            if (pwrite(hIndex, buf.c_str(), buf.size(), 0) == ssize_t(buf.size()))
+                DirtyBlocks = 0;
+        }
+
+        void closeCache() {
+            flushIndex();
+            if (hData >= 0) ::close(hData);
+            if (hIndex >= 0) ::close(hIndex); // releases the lock as well
+            hData = hIndex = -1;
+            bPersistent = false;
+        }
+        #endif // POSIX
+
+        // read ahead
+
+        bool isSequential(file_offset_t Offset) const {
+            if (Offset == LastEnd && Offset) return true;
+            for (std::list< std::pair<file_offset_t,file_offset_t> >::const_iterator it = SequentialRanges.begin();
+                 it != SequentialRanges.end(); ++it)
+            {
+                if (Offset >= it->first && Offset < it->second) return true;
+            }
+            return false;
+        }
+
+        /// End of the range advised as sequential containing @a Offset, or the file's end.
+        file_offset_t sequentialEnd(file_offset_t Offset) const {
+            for (std::list< std::pair<file_offset_t,file_offset_t> >::const_iterator it = SequentialRanges.begin();
+                 it != SequentialRanges.end(); ++it)
+            {
+                if (Offset >= it->first && Offset < it->second) return it->second;
+            }
+            return Size;
+        }
+
+        void removeRanges(file_offset_t Offset, file_offset_t End) {
+            for (std::list< std::pair<file_offset_t,file_offset_t> >::iterator it = SequentialRanges.begin();
+                 it != SequentialRanges.end(); )
+            {
+                if (it->first < End && Offset < it->second) it = SequentialRanges.erase(it);
+                else ++it;
+            }
+        }
+
+        /**
+         * Reads the range [@a Offset, @a Offset + @a Size) (which must be
+         * within the file) from the cache, downloading the blocks not
+         * cached yet together with the blocks not cached yet in the
+         * following @a ReadAhead bytes.
+         */
+        void read(file_offset_t Offset, uint8_t* pData, file_offset_t Size, file_offset_t ReadAhead) {
+            const file_offset_t end = Offset + Size;
+            file_offset_t aheadEnd = end + ReadAhead;
+            if (aheadEnd > this->Size) aheadEnd = this->Size;
+            const uint64_t lastBlock = (aheadEnd - 1) / HTTP_BLOCK_SIZE;
+            std::vector<uint8_t> body;
+            for (file_offset_t pos = Offset; pos < end; ) {
+                const uint64_t block = pos / HTTP_BLOCK_SIZE;
+                const file_offset_t blockStart = block * HTTP_BLOCK_SIZE;
+                if (has(block)) {
+                    file_offset_t n = blockStart + blockSize(block) - pos;
+                    if (n > end - pos) n = end - pos;
+                    copyFrom(block, pos - blockStart, pData + (pos - Offset), n);
+                    Statistics.BytesFromCache += n;
+                    pos += n;
+                    continue;
+                }
+                // download all following blocks not cached yet at once
+                uint64_t count = 1;
+                while (block + count <= lastBlock && !has(block + count)) ++count;
+                fetch(block, count, body);
+                file_offset_t n = blockStart + body.size() - pos;
+                if (n > end - pos) n = end - pos;
+                memcpy(pData + (pos - Offset), &body[pos - blockStart], n);
+                pos += n;
+            }
+        }
+    };
+
+// *************** HTTPDevice ***************
+// *
+
+    /** @brief Open a file on a HTTP(S) server.
+     *
+     * Determines the size of the file at @a URL by requesting its first
+     * block. If @a CacheDir is given, the blocks of the file are cached in
+     * that directory (which must exist already) and blocks cached there by
+     * earlier HTTPDevice objects of the same URL are reused, provided the
+     * file did not change on the server meanwhile. Otherwise, or if the
+     * cache files are in use by another process, the blocks are cached in
+     * RAM. Persistent caching is not supported on Windows yet.
+     *
+     * @param URL - HTTP or HTTPS URL of the file (any other URL supported
+     *              by libcurl supporting range requests works as well)
+     * @param CacheDir - (optional) directory of the persistent block cache
+     * @throws RIFF::Exception if the file could not be requested, if the
+     *         server does not support range requests or if libgig was
+     *         built without libcurl
+     */
+    HTTPDevice::HTTPDevice(const String& URL, const String& CacheDir) : p(new http_device_t) {
+        p->URL = URL;
+        {
+            mutex_lock_t lock(curlGlobalMutex);
+            if (!bCurlGlobalInitialized) {
+                if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+                    delete p;
+                    throw Exception("Could not initialize libcurl");
+                }
+                bCurlGlobalInitialized = true;
+            }
+        }
+        p->pCurl = curl_easy_init();
+        if (!p->pCurl) {
+            delete p;
+            throw Exception("Could not initialize libcurl");
+        }
+        curl_easy_setopt(p->pCurl, CURLOPT_URL, URL.c_str());
+        curl_easy_setopt(p->pCurl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(p->pCurl, CURLOPT_MAXREDIRS, 10L);
+        curl_easy_setopt(p->pCurl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(p->pCurl, CURLOPT_CONNECTTIMEOUT, 30L);
+        curl_easy_setopt(p->pCurl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(p->pCurl, CURLOPT_LOW_SPEED_TIME, 30L);
+        curl_easy_setopt(p->pCurl, CURLOPT_FAILONERROR, 0L);
+        curl_easy_setopt(p->pCurl, CURLOPT_USERAGENT, ("libgig/" + libraryVersion()).c_str());
+        curl_easy_setopt(p->pCurl, CURLOPT_WRITEFUNCTION, http_device_t::writeCallback);
+        curl_easy_setopt(p->pCurl, CURLOPT_WRITEDATA, p);
+        curl_easy_setopt(p->pCurl, CURLOPT_HEADERFUNCTION, http_device_t::headerCallback);
+        curl_easy_setopt(p->pCurl, CURLOPT_HEADERDATA, p);
+        try {
+            std::vector<uint8_t> firstBlock;
+            p->open(firstBlock);
+            if (p->Size) p->store(0, &firstBlock[0]);
+            #if POSIX
+            if (!CacheDir.empty() && p->Size) p->openCache(CacheDir);
+            #endif
+        } catch (...) {
+            curl_easy_cleanup(p->pCurl);
+            delete p;
+            throw;
+        }
+    }
+
+    HTTPDevice::~HTTPDevice() {
+        #if POSIX
+        p->closeCache();
+        #endif
+        curl_easy_cleanup(p->pCurl);
+        delete p;
+    }
+
+    /// Returns the URL given to the constructor.
+    String HTTPDevice::GetURL() const {
+        return p->URL;
+    }
+
+    /**
+     * Sets the max. amount of RAM used for caching blocks of the file, if
+     * there is no persistent cache (default: 32 MB). The least recently
+     * used blocks are dropped when the limit is exceeded.
+     */
+    void HTTPDevice::SetMemoryCacheLimit(file_offset_t Limit) {
+        mutex_lock_t lock(p->mutex);
+        p->MemoryLimit = Limit;
+        while (p->MemoryUsed > p->MemoryLimit && !p->LRU.empty()) p->evict(p->LRU.back());
+    }
+
+    /// Returns the max. amount of RAM used for caching blocks (see SetMemoryCacheLimit()).
+    file_offset_t HTTPDevice::GetMemoryCacheLimit() const {
+        mutex_lock_t lock(p->mutex);
+        return p->MemoryLimit;
+    }
+
+    /**
+     * Sets how many bytes are requested beyond the data actually read.
+     * Isolated reads (i.e. chunk headers while the file is loaded) are
+     * extended by @a HeaderReadAhead bytes (default: 32 kB). Sequential
+     * reads, and reads within ranges advised as sequential or as being
+     * needed soon, start with a read ahead of 256 kB, which is doubled with
+     * every further sequential read up to @a StreamReadAhead bytes
+     * (default: 4 MB).
+     */
+    void HTTPDevice::SetReadAhead(file_offset_t HeaderReadAhead, file_offset_t StreamReadAhead) {
+        mutex_lock_t lock(p->mutex);
+        p->HeaderReadAhead = HeaderReadAhead;
+        p->StreamReadAhead = StreamReadAhead;
+    }
+
+    /// Returns the amount of requests and bytes transferred so far.
+    http_statistics_t HTTPDevice::GetStatistics() const {
+        mutex_lock_t lock(p->mutex);
+        return p->Statistics;
+    }
+
+    /**
+     * Writes the index of the persistent block cache, so that the blocks
+     * cached so far are available to other processes right away (which is
+     * done automatically when the device is destroyed).
+     */
+    void HTTPDevice::Flush() {
+        #if POSIX
+        mutex_lock_t lock(p->mutex);
+        p->flushIndex();
+        #endif
+    }
+
+    /// Returns whether libgig was built with HTTP support (libcurl).
+    bool HTTPDevice::IsSupported() {
+        return true;
+    }
+
+    file_offset_t HTTPDevice::ReadAt(file_offset_t Offset, void* pData, file_offset_t Size) {
+        mutex_lock_t lock(p->mutex);
+        if (Offset >= p->Size || !Size) return 0;
+        if (Size > p->Size - Offset) Size = p->Size - Offset;
+        file_offset_t readAhead;
+        if (p->isSequential(Offset)) {
+            p->StreamWindow = (!p->StreamWindow) ? HTTP_STREAM_READ_AHEAD_MIN : p->StreamWindow * 2;
+            if (p->StreamWindow > p->StreamReadAhead) p->StreamWindow = p->StreamReadAhead;
+            readAhead = p->StreamWindow;
+            // don't read ahead beyond the end of an advised range
+            const file_offset_t end = p->sequentialEnd(Offset);
+            if (end >= Offset + Size && Offset + Size + readAhead > end)
+                readAhead = end - (Offset + Size);
+        } else {
+            p->StreamWindow = 0;
+            readAhead = p->HeaderReadAhead;
+        }
+        try {
+            p->read(Offset, (uint8_t*) pData, Size, readAhead);
+        } catch (...) {
+            p->LastEnd = 0;
+            p->StreamWindow = 0;
+            return 0;
+        }
+        p->LastEnd = Offset + Size;
+        return Size;
+    }
+
+    /// The device is read-only, so this returns always 0.
+    file_offset_t HTTPDevice::WriteAt(file_offset_t /*Offset*/, const void* /*pData*/, file_offset_t /*Size*/) {
+        return 0;
+    }
+
+    file_offset_t HTTPDevice::GetSize() const {
+        mutex_lock_t lock(p->mutex);
+        return p->Size;
+    }
+
+    /// The device is read-only, so this always throws a RIFF::Exception.
+    void HTTPDevice::Resize(file_offset_t /*NewSize*/) {
+        throw Exception("Cannot resize '" + p->URL + "': HTTP files are read-only");
+    }
+
+    /// Throws a RIFF::Exception for stream_mode_read_write, since the device is read-only.
+    void HTTPDevice::SetMode(stream_mode_t NewMode) {
+        if (NewMode == stream_mode_read_write)
+            throw Exception("Cannot open '" + p->URL + "' in read/write mode: HTTP files are read-only");
+    }
+
+    /// Downloads the blocks of the given range not cached yet (up to the stream read ahead size).
+    void HTTPDevice::Advise(file_offset_t Offset, file_offset_t Size) {
+        Advise(Offset, Size, advice_willneed);
+    }
+
+    /**
+     * Ranges advised as sequential are read with the stream read ahead
+     * right from their first read. Ranges advised as needed soon are
+     * downloaded right away (up to the stream read ahead size), and blocks
+     * in ranges advised as not needed anymore are dropped from the RAM
+     * cache.
+     */
+    void HTTPDevice::Advise(file_offset_t Offset, file_offset_t Size, advice_t Advice) {
+        mutex_lock_t lock(p->mutex);
+        if (Offset >= p->Size || !Size) return;
+        if (Size > p->Size - Offset) Size = p->Size - Offset;
+        const file_offset_t end = Offset + Size;
+        switch (Advice) {
+            case advice_sequential:
+                p->removeRanges(Offset, end);
+                p->SequentialRanges.push_front(std::make_pair(Offset, end));
+                if (p->SequentialRanges.size() > HTTP_MAX_SEQUENTIAL_RANGES)
+                    p->SequentialRanges.pop_back();
+                break;
+            case advice_willneed: {
+                file_offset_t n = (Size < p->StreamReadAhead) ? Size : p->StreamReadAhead;
+                std::vector<uint8_t> buf(n);
+                try {
+                    p->read(Offset, &buf[0], n, 0);
+                } catch (...) {}
+                break;
+            }
+            case advice_dontneed:
+                p->removeRanges(Offset, end);
+                // only blocks completely within the range
+                for (uint64_t block = (Offset + HTTP_BLOCK_SIZE - 1) / HTTP_BLOCK_SIZE;
+                     block < p->blockCount() && block * HTTP_BLOCK_SIZE + p->blockSize(block) <= end; ++block)
+                {
+                    p->evict(block);
+                }
+                break;
+            default:
+                p->removeRanges(Offset, end);
+                break;
+        }
+    }
+
+} // namespace RIFF
+
+#else // !HAVE_LIBCURL
+
+namespace RIFF {
+
+    struct http_device_t {};
+
+    HTTPDevice::HTTPDevice(const String& URL, const String& /*CacheDir*/) : p(NULL) {
+        throw Exception("Cannot open '" + URL + "': libgig was built without HTTP support (libcurl)");
+    }
+
+    HTTPDevice::~HTTPDevice() {}
+    String HTTPDevice::GetURL() const { return ""; }
+    void HTTPDevice::SetMemoryCacheLimit(file_offset_t /*Limit*/) {}
+    file_offset_t HTTPDevice::GetMemoryCacheLimit() const { return 0; }
+    void HTTPDevice::SetReadAhead(file_offset_t /*HeaderReadAhead*/, file_offset_t /*StreamReadAhead*/) {}
+    http_statistics_t HTTPDevice::GetStatistics() const { http_statistics_t s = {}; return s; }
+    void HTTPDevice::Flush() {}
+    bool HTTPDevice::IsSupported() { return false; }
+    file_offset_t HTTPDevice::ReadAt(file_offset_t /*Offset*/, void* /*pData*/, file_offset_t /*Size*/) { return 0; }
+    file_offset_t HTTPDevice::WriteAt(file_offset_t /*Offset*/, const void* /*pData*/, file_offset_t /*Size*/) { return 0; }
+    file_offset_t HTTPDevice::GetSize() const { return 0; }
+    void HTTPDevice::Resize(file_offset_t /*NewSize*/) {}
+    void HTTPDevice::SetMode(stream_mode_t /*NewMode*/) {}
+    void HTTPDevice::Advise(file_offset_t /*Offset*/, file_offset_t /*Size*/) {}
+    void HTTPDevice::Advise(file_offset_t /*Offset*/, file_offset_t /*Size*/, advice_t /*Advice*/) {}
+
+} // namespace RIFF
+
+#endif // HAVE_LIBCURL
@@ -0,0 +1,104 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this library; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#ifndef __RIFF_HTTPDEVICE_H__
+#define __RIFF_HTTPDEVICE_H__
+
+#include "RIFF.h"
+
+namespace RIFF {
+
+    struct http_device_t;
+
+    /** @brief Traffic of an HTTPDevice (see HTTPDevice::GetStatistics()). */
+    struct http_statistics_t {
+        uint64_t Requests;        ///< Amount of HTTP requests sent to the server.
+        uint64_t BytesDownloaded; ///< Amount of bytes received from the server.
+        uint64_t BytesFromCache;  ///< Amount of bytes of ReadAt() calls served by the local block cache.
+    };
+
+    /** @brief Read-only I/O device for files on HTTP(S) servers.
+     *
+     * Allows to open RIFF files (i.e. .gig files) directly on a web server
+     * or object store, without copying them to the local file system
+     * first:
+     * @code
+     * RIFF::File riff(new RIFF::HTTPDevice("https://example.com/piano.gig", "/var/cache/gig"));
+     * gig::File gig(&riff);
+     * @endcode
+     * The file is read in blocks by HTTP range requests, so the server must
+     * support those (which virtually all web servers and object stores do).
+     * All blocks received are kept in a local block cache: either in a
+     * cache directory, in which case they are reused by all later
+     * HTTPDevice objects of the same URL (also by other processes, as long
+     * as the file on the server did not change, which is detected by its
+     * size and its ETag or Last-Modified header), or otherwise in RAM with
+     * a memory limit (see SetMemoryCacheLimit()).
+     *
+     * How much is requested ahead of the data actually read depends on the
+     * access pattern: isolated small reads (like reading chunk headers when
+     * the file is opened) only fetch the few blocks containing them,
+     * whereas sequential reads and ranges advised as sequential (i.e.
+     * streamed sample data, see RIFF::File::Advise()) fetch increasingly
+     * large runs of blocks at once, up to the stream read ahead size (see
+     * SetReadAhead()).
+     *
+     * The device is read-only: files opened with it can't be saved in
+     * place, but can still be saved to another (local) file. gig extension
+     * files (.gx01, .gx02, ...) are not supported. All methods may be
+     * called by several threads at the same time, network requests are
+     * performed one by one though.
+     *
+     * This device is only available if libgig was built with libcurl (see
+     * IsSupported()), otherwise its constructor throws an exception.
+     */
+    class HTTPDevice : public IODevice {
+        public:
+            HTTPDevice(const String& URL, const String& CacheDir = "");
+            virtual ~HTTPDevice();
+            String            GetURL() const;
+            void              SetMemoryCacheLimit(file_offset_t Limit);
+            file_offset_t     GetMemoryCacheLimit() const;
+            void              SetReadAhead(file_offset_t HeaderReadAhead, file_offset_t StreamReadAhead);
+            http_statistics_t GetStatistics() const;
+            void              Flush();
+            static bool       IsSupported();
+
+            // implementation of IODevice
+            virtual file_offset_t ReadAt(file_offset_t Offset, void* pData, file_offset_t Size);
+            virtual file_offset_t WriteAt(file_offset_t Offset, const void* pData, file_offset_t Size);
+            virtual file_offset_t GetSize() const;
+            virtual void          Resize(file_offset_t NewSize);
+            virtual void          SetMode(stream_mode_t NewMode);
+            virtual void          Advise(file_offset_t Offset, file_offset_t Size);
+            virtual void          Advise(file_offset_t Offset, file_offset_t Size, advice_t Advice);
+        private:
+            http_device_t* p;
+
+            HTTPDevice(const HTTPDevice&);            // not copyable
+            HTTPDevice& operator=(const HTTPDevice&); // not copyable
+    };
+
+} // namespace RIFF
+
+#endif // __RIFF_HTTPDEVICE_H__
@@ -22,8 +22,23 @@
  ***************************************************************************/
 
 #include "Korg.h"
+#include "helper.h"
 
 #include <string.h> // for memset()
+#include <list>
+
+// SIMD kernels for converting the big endian sample data: on x86 they are
+// compiled for particular instruction set extensions and selected at
+// runtime, on ARM the NEON kernels are selected at compile time (same as in
+// gig.cpp).
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define KORG_SIMD_X86 1
+# include <immintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__ARM_BIG_ENDIAN)
+# define KORG_SIMD_NEON 1
+# include <arm_neon.h>
+#endif
 
 #if WORDS_BIGENDIAN
 # define CHUNK_ID_MSP1  0x4d535031
@@ -41,6 +56,11 @@
 
 #define SMD1_CHUNK_HEADER_SZ    12
 
+#define DEFAULT_MAX_OPEN_KSF_FILES  32
+
+/// Size of the block read from the .KSF file at once by Read16() and ReadFloat().
+#define KSF_CONVERSION_BLOCK_SIZE   8192
+
 namespace Korg {
 
     #if defined(WIN32)
@@ -84,18 +104,180 @@ namespace Korg {
         return filename.substr(0, pos);
     }
 
+    namespace {
+
+        // All kernels convert n values of the raw .KSF sample data, that is
+        // signed 8 bit respectively signed 16 bit big endian, to native
+        // 16 bit (8 bit values are shifted to the upper byte) or to float
+        // (scale already includes the normalization to -1.0 .. +1.0).
+
+        void Widen8Scalar(const uint8_t* pSrc, int16_t* pDst, unsigned long n) {
+            for (unsigned long i = 0; i < n; ++i)
+                pDst[i] = int16_t(uint16_t(pSrc[i]) << 8);
+        }
+
+        void Swap16Scalar(const uint8_t* pSrc, int16_t* pDst, unsigned long n) {
+            for (unsigned long i = 0; i < n; ++i)
+                pDst[i] = int16_t(uint16_t(pSrc[2*i]) << 8 | pSrc[2*i + 1]);
+        }
+
+        void Float8Scalar(const uint8_t* pSrc, float* pDst, unsigned long n, float scale) {
+            for (unsigned long i = 0; i < n; ++i)
+                pDst[i] = int8_t(pSrc[i]) * scale;
+        }
+
+        void Float16Scalar(const uint8_t* pSrc, float* pDst, unsigned long n, float scale) {
+            for (unsigned long i = 0; i < n; ++i)
+                pDst[i] = int16_t(uint16_t(pSrc[2*i]) << 8 | pSrc[2*i + 1]) * scale;
+        }
+
+#if KORG_SIMD_X86
+
+        __attribute__((target("sse2")))
+        void Widen8SSE2(const uint8_t* pSrc, int16_t* pDst, unsigned long n) {
+            const __m128i zero = _mm_setzero_si128();
+            for (; n >= 16; n -= 16, pSrc += 16, pDst += 16) {
+                const __m128i v = _mm_loadu_si128((const __m128i*) pSrc);
+                _mm_storeu_si128((__m128i*) pDst,       _mm_unpacklo_epi8(zero, v));
+                _mm_storeu_si128((__m128i*) (pDst + 8), _mm_unpackhi_epi8(zero, v));
+            }
+            Widen8Scalar(pSrc, pDst, n);
+        }
+
+        __attribute__((target("sse2")))
+        void Swap16SSE2(const uint8_t* pSrc, int16_t* pDst, unsigned long n) {
+            for (; n >= 8; n -= 8, pSrc += 16, pDst += 8) {
+                const __m128i v = _mm_loadu_si128((const __m128i*) pSrc);
+                _mm_storeu_si128((__m128i*) pDst, _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+            }
+            Swap16Scalar(pSrc, pDst, n);
+        }
+
+        // (the values end up in the upper bits of the 32 bit lanes, which
+        // is compensated by the scale factor)
+        __attribute__((target("sse2")))
+        void Float8SSE2(const uint8_t* pSrc, float* pDst, unsigned long n, float scale) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128  s    = _mm_set1_ps(scale / 16777216.f);
+            for (; n >= 8; n -= 8, pSrc += 8, pDst += 8) {
+                const __m128i v = _mm_unpacklo_epi8(zero, _mm_loadl_epi64((const __m128i*) pSrc));
+                _mm_storeu_ps(pDst,     _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, v)), s));
+                _mm_storeu_ps(pDst + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, v)), s));
+            }
+            Float8Scalar(pSrc, pDst, n, scale);
+        }
+
+        __attribute__((target("sse2")))
+        void Float16SSE2(const uint8_t* pSrc, float* pDst, unsigned long n, float scale) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128  s    = _mm_set1_ps(scale / 65536.f);
+            for (; n >= 8; n -= 8, pSrc += 16, pDst += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i*) pSrc);
+                v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+                _mm_storeu_ps(pDst,     _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, v)), s));
+                _mm_storeu_ps(pDst + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, v)), s));
+            }
+            Float16Scalar(pSrc, pDst, n, scale);
+        }
+
+#elif KORG_SIMD_NEON
+
+        void Widen8NEON(const uint8_t* pSrc, int16_t* pDst, unsigned long n) {
+            for (; n >= 8; n -= 8, pSrc += 8, pDst += 8)
+                vst1q_s16(pDst, vshll_n_s8(vreinterpret_s8_u8(vld1_u8(pSrc)), 8));
+            Widen8Scalar(pSrc, pDst, n);
+        }
+
+        void Swap16NEON(const uint8_t* pSrc, int16_t* pDst, unsigned long n) {
+            for (; n >= 8; n -= 8, pSrc += 16, pDst += 8)
+                vst1q_s16(pDst, vreinterpretq_s16_u8(vrev16q_u8(vld1q_u8(pSrc))));
+            Swap16Scalar(pSrc, pDst, n);
+        }
+
+        void Float8NEON(const uint8_t* pSrc, float* pDst, unsigned long n, float scale) {
+            for (; n >= 8; n -= 8, pSrc += 8, pDst += 8) {
+                const int16x8_t v = vmovl_s8(vreinterpret_s8_u8(vld1_u8(pSrc)));
+                vst1q_f32(pDst,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+                vst1q_f32(pDst + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+            }
+            Float8Scalar(pSrc, pDst, n, scale);
+        }
+
+        void Float16NEON(const uint8_t* pSrc, float* pDst, unsigned long n, float scale) {
+            for (; n >= 8; n -= 8, pSrc += 16, pDst += 8) {
+                const int16x8_t v = vreinterpretq_s16_u8(vrev16q_u8(vld1q_u8(pSrc)));
+                vst1q_f32(pDst,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+                vst1q_f32(pDst + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+            }
+            Float16Scalar(pSrc, pDst, n, scale);
+        }
+
+#endif // KORG_SIMD_NEON
+
+        typedef void (*widen_fn_t)(const uint8_t* pSrc, int16_t* pDst, unsigned long n);
+        typedef void (*to_float_fn_t)(const uint8_t* pSrc, float* pDst, unsigned long n, float scale);
+
+        struct sample_kernels_t {
+            widen_fn_t    Widen8;
+            widen_fn_t    Swap16;
+            to_float_fn_t Float8;
+            to_float_fn_t Float16;
+        };
+
+        // picks the best kernels for the CPU we are running on
+        sample_kernels_t selectSampleKernels() {
+            sample_kernels_t k;
+            k.Widen8  = Widen8Scalar;
+            k.Swap16  = Swap16Scalar;
+            k.Float8  = Float8Scalar;
+            k.Float16 = Float16Scalar;
+#if KORG_SIMD_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("sse2")) {
+                k.Widen8  = Widen8SSE2;
+                k.Swap16  = Swap16SSE2;
+                k.Float8  = Float8SSE2;
+                k.Float16 = Float16SSE2;
+            }
+#elif KORG_SIMD_NEON
+            k.Widen8  = Widen8NEON;
+            k.Swap16  = Swap16NEON;
+            k.Float8  = Float8NEON;
+            k.Float16 = Float16NEON;
+#endif
+            return k;
+        }
+
+        // KSF sample conversion routines, chosen for this CPU before main()
+        const sample_kernels_t kernels = selectSampleKernels();
+
+    } // anonymous namespace
+
 // *************** KSFSample ***************
 // *
 
-    KSFSample::KSFSample(const String& filename) {
+    // .KSF files currently open, most recently used first
+    static std::list<KSFSample*> openKSFSamples;
+    static unsigned int maxOpenKSFFiles = DEFAULT_MAX_OPEN_KSF_FILES;
+    static bool ksfMemoryMapping = false;
+    static mutex_t openKSFSamplesMutex; // protects the three variables above and the file handles of all KSFSample objects
+
+    KSFSample::KSFSample(const String& filename) : riff(NULL), filename(filename), pos(0), ramCacheMapped(false) {
         RAMCache.Size              = 0;
         RAMCache.pStart            = NULL;
         RAMCache.NullExtensionSize = 0;
 
-        riff = new RIFF::File(
-            filename, CHUNK_ID_SMP1, RIFF::endian_big, RIFF::layout_flat
-        );
-        
+        mutex_lock_t lock(openKSFSamplesMutex);
+        try {
+            AcquireFile();
+            ReadHeader();
+        } catch (...) {
+            CloseFile();
+            throw;
+        }
+    }
+
+    void KSFSample::ReadHeader() {
         // read 'SMP1' chunk
         RIFF::Chunk* smp1 = riff->GetSubChunk(CHUNK_ID_SMP1);
         if (!smp1)
@@ -124,8 +306,125 @@ namespace Korg {
     }
 
     KSFSample::~KSFSample() {
-        if (RAMCache.pStart) delete[] (int8_t*) RAMCache.pStart;
-        if (riff) delete riff;
+        ReleaseSampleData();
+        mutex_lock_t lock(openKSFSamplesMutex);
+        CloseFile();
+    }
+
+    /**
+     * Returns the opened file of this sample, (re)opening it if required.
+     * If this exceeds the maximum amount of open .KSF files, the least
+     * recently used one is closed. Caller must hold openKSFSamplesMutex.
+     */
+    RIFF::File* KSFSample::AcquireFile() {
+        if (riff) {
+            if (openKSFSamples.front() != this) {
+                openKSFSamples.remove(this);
+                openKSFSamples.push_front(this);
+            }
+            return riff;
+        }
+        while (maxOpenKSFFiles && openKSFSamples.size() >= maxOpenKSFFiles)
+            if (!CloseLeastRecentlyUsedFile()) break;
+        riff = new RIFF::File(
+            filename, CHUNK_ID_SMP1, RIFF::endian_big, RIFF::layout_flat
+        );
+        if (ksfMemoryMapping) riff->SetIOBackend(RIFF::io_backend_mmap);
+        openKSFSamples.push_front(this);
+        return riff;
+    }
+
+    /**
+     * Closes the least recently used open .KSF file whose memory-mapped
+     * view is not in use by a RAM cache. Returns false if there is no such
+     * file. Caller must hold openKSFSamplesMutex.
+     */
+    bool KSFSample::CloseLeastRecentlyUsedFile() {
+        for (std::list<KSFSample*>::reverse_iterator it = openKSFSamples.rbegin();
+             it != openKSFSamples.rend(); ++it)
+        {
+            if ((*it)->ramCacheMapped) continue;
+            (*it)->CloseFile();
+            return true;
+        }
+        return false;
+    }
+
+    /// Closes the file of this sample. Caller must hold openKSFSamplesMutex.
+    void KSFSample::CloseFile() {
+        if (!riff) return;
+        openKSFSamples.remove(this);
+        delete riff;
+        riff = NULL;
+    }
+
+    /**
+     * Sets the maximum amount of .KSF files being kept open at the same time
+     * by all KSFSample objects. If more samples are accessed, the least
+     * recently used files are closed and automatically reopened when they
+     * are accessed again. By default up to 32 files are kept open.
+     *
+     * @param count - maximum amount of open files, 0 for no limit
+     */
+    void KSFSample::SetMaxOpenFiles(unsigned int count) {
+        mutex_lock_t lock(openKSFSamplesMutex);
+        maxOpenKSFFiles = count;
+        while (maxOpenKSFFiles && openKSFSamples.size() > maxOpenKSFFiles)
+            if (!CloseLeastRecentlyUsedFile()) break;
+    }
+
+    /**
+     * Returns the maximum amount of .KSF files being kept open at the same
+     * time (0 = unlimited).
+     *
+     * @see SetMaxOpenFiles()
+     */
+    unsigned int KSFSample::GetMaxOpenFiles() {
+        mutex_lock_t lock(openKSFSamplesMutex);
+        return maxOpenKSFFiles;
+    }
+
+    /**
+     * Enables or disables memory mapping of the .KSF files opened from now
+     * on by all KSFSample objects (files already open keep their current
+     * I/O method until they are closed). With memory mapping, Read() copies
+     * the sample data from a read-only memory-mapped view of the file
+     * (see RIFF::io_backend_mmap) and LoadSampleData() and friends return
+     * a pointer directly into that view instead of loading the sample into
+     * a RAM buffer, so playing a multi sample directly costs neither the
+     * memory nor the time for copying all its samples in the first place.
+     * The latter is only possible if the sample data does not require byte
+     * order conversion, i.e. for 8 bit samples (the 16 bit samples of the
+     * big endian .KSF format are still copied on little endian systems).
+     * The file of a sample whose RAM cache is mapped stays open until
+     * ReleaseSampleData() is called, even if this exceeds the maximum
+     * amount of open files (see SetMaxOpenFiles()). Disabled by default.
+     *
+     * @param enable - whether to memory-map .KSF files
+     * @see IsCacheMapped()
+     */
+    void KSFSample::SetMemoryMapping(bool enable) {
+        mutex_lock_t lock(openKSFSamplesMutex);
+        ksfMemoryMapping = enable;
+    }
+
+    /**
+     * Returns whether .KSF files are memory-mapped.
+     *
+     * @see SetMemoryMapping()
+     */
+    bool KSFSample::GetMemoryMapping() {
+        mutex_lock_t lock(openKSFSamplesMutex);
+        return ksfMemoryMapping;
+    }
+
+    /**
+     * Returns true if the RAM cache returned by GetCache() points directly
+     * into the memory-mapped .KSF file (see SetMemoryMapping()), in which
+     * case the cached sample data is read-only.
+     */
+    bool KSFSample::IsCacheMapped() const {
+        return ramCacheMapped;
     }
 
     /**
@@ -196,10 +495,28 @@ namespace Korg {
      */
     buffer_t KSFSample::LoadSampleDataWithNullSamplesExtension(unsigned long SampleCount, uint NullSamplesCount) {
         if (SampleCount > this->SamplePoints) SampleCount = this->SamplePoints;
-        if (RAMCache.pStart) delete[] (int8_t*) RAMCache.pStart;
+        ReleaseSampleData();
+        // zero-copy: directly use the memory-mapped file if possible
+        {
+            mutex_lock_t lock(openKSFSamplesMutex);
+            RIFF::Chunk* smd1 = AcquireFile()->GetSubChunk(CHUNK_ID_SMD1);
+            const uint8_t* pMapped = (const uint8_t*) smd1->GetMappedData(FrameSize());
+            if (pMapped && SMD1_CHUNK_HEADER_SZ + SampleCount * FrameSize() <= smd1->GetSize()) {
+                RAMCache.pStart            = (void*) (pMapped + SMD1_CHUNK_HEADER_SZ);
+                RAMCache.Size              = SampleCount * FrameSize();
+                RAMCache.NullExtensionSize = NullSamplesCount * FrameSize();
+                if (RAMCache.NullExtensionSize) {
+                    RAMCache.pNullExtension = RIFF::AllocateSampleBuffer(RAMCache.NullExtensionSize);
+                    memset(RAMCache.pNullExtension, 0, RAMCache.NullExtensionSize);
+                }
+                ramCacheMapped = true;
+                pos = SampleCount; // same read position as if the data was read
+                return GetCache();
+            }
+        }
         unsigned long allocationsize = (SampleCount + NullSamplesCount) * FrameSize();
         SetPos(0); // reset read position to beginning of sample
-        RAMCache.pStart            = new int8_t[allocationsize];
+        RAMCache.pStart            = RIFF::AllocateSampleBuffer(allocationsize);
         RAMCache.Size              = Read(RAMCache.pStart, SampleCount) * FrameSize();
         RAMCache.NullExtensionSize = allocationsize - RAMCache.Size;
         // fill the remaining buffer space with silence samples
@@ -222,6 +539,7 @@ namespace Korg {
         result.Size              = this->RAMCache.Size;
         result.pStart            = this->RAMCache.pStart;
         result.NullExtensionSize = this->RAMCache.NullExtensionSize;
+        result.pNullExtension    = this->RAMCache.pNullExtension;
         return result;
     }
 
@@ -232,10 +550,17 @@ namespace Korg {
      * @see  LoadSampleData();
      */
     void KSFSample::ReleaseSampleData() {
-        if (RAMCache.pStart) delete[] (int8_t*) RAMCache.pStart;
+        if (ramCacheMapped) {
+            if (RAMCache.pNullExtension)
+                RIFF::FreeSampleBuffer(RAMCache.pNullExtension, RAMCache.NullExtensionSize);
+            ramCacheMapped = false;
+        } else {
+            RIFF::FreeSampleBuffer(RAMCache.pStart, RAMCache.Size + RAMCache.NullExtensionSize);
+        }
         RAMCache.pStart = NULL;
         RAMCache.Size   = 0;
         RAMCache.NullExtensionSize = 0;
+        RAMCache.pNullExtension    = NULL;
     }
 
     /**
@@ -267,18 +592,15 @@ namespace Korg {
                 break;
         }
         if (samplePos > this->SamplePoints) samplePos = this->SamplePoints;
-        unsigned long bytes = samplePos * FrameSize();
-        RIFF::Chunk* smd1 = riff->GetSubChunk(CHUNK_ID_SMD1);
-        unsigned long result = smd1->SetPos(SMD1_CHUNK_HEADER_SZ + bytes);
-        return (result - SMD1_CHUNK_HEADER_SZ) / FrameSize();
+        pos = samplePos;
+        return pos;
     }
 
     /**
      * Returns the current position in the sample (in sample points).
      */
     unsigned long KSFSample::GetPos() const {
-        RIFF::Chunk* smd1 = riff->GetSubChunk(CHUNK_ID_SMD1);
-        return (smd1->GetPos() - SMD1_CHUNK_HEADER_SZ) / FrameSize();
+        return pos;
     }
 
     /**
@@ -298,19 +620,169 @@ namespace Korg {
      * @see                SetPos()
      */
     unsigned long KSFSample::Read(void* pBuffer, unsigned long SampleCount) {
-        RIFF::Chunk* smd1 = riff->GetSubChunk(CHUNK_ID_SMD1);
+        mutex_lock_t lock(openKSFSamplesMutex);
+        RIFF::Chunk* smd1 = AcquireFile()->GetSubChunk(CHUNK_ID_SMD1);
+        smd1->SetPos(SMD1_CHUNK_HEADER_SZ + pos * FrameSize());
 
         unsigned long samplestoread = SampleCount, totalreadsamples = 0, readsamples;
 
         if (samplestoread) do {
-            readsamples       = smd1->Read(pBuffer, SampleCount, FrameSize()); // FIXME: channel inversion due to endian correction?
+            readsamples       = smd1->Read((uint8_t*)pBuffer + totalreadsamples * FrameSize(), samplestoread, FrameSize()); // FIXME: channel inversion due to endian correction?
             samplestoread    -= readsamples;
             totalreadsamples += readsamples;
         } while (readsamples && samplestoread);
 
+        pos += totalreadsamples;
         return totalreadsamples;
     }
 
+    /**
+     * Reads \a SampleCount number of sample points from the current
+     * position like Read(), but without any byte order conversion, i.e. in
+     * the raw (big endian) format of the .KSF file.
+     */
+    unsigned long KSFSample::ReadRaw(uint8_t* pBuffer, unsigned long SampleCount) {
+        mutex_lock_t lock(openKSFSamplesMutex);
+        RIFF::Chunk* smd1 = AcquireFile()->GetSubChunk(CHUNK_ID_SMD1);
+        smd1->SetPos(SMD1_CHUNK_HEADER_SZ + pos * FrameSize());
+        const unsigned long n = (unsigned long) smd1->Read(pBuffer, SampleCount * FrameSize(), 1) / FrameSize();
+        pos += n;
+        return n;
+    }
+
+    /**
+     * Same as Read(), but always outputs signed 16 bit sample points in
+     * native byte order, regardless of the bit depth of this sample: 8 bit
+     * sample data is widened to 16 bit. The conversion is performed block
+     * by block with SIMD instructions if available, so this is considerably
+     * faster than reading by Read() and converting afterwards.
+     *
+     * @param pBuffer      destination buffer (\a SampleCount * Channels values)
+     * @param SampleCount  number of sample points to read
+     * @returns            number of successfully read sample points
+     * @see                ReadFloat(), SetPos()
+     */
+    unsigned long KSFSample::Read16(int16_t* pBuffer, unsigned long SampleCount) {
+        if ((BitDepth != 8 && BitDepth != 16) || !Channels)
+            throw Exception("Unsupported .KSF sample format");
+        uint8_t raw[KSF_CONVERSION_BLOCK_SIZE];
+        const unsigned long blockSize = KSF_CONVERSION_BLOCK_SIZE / FrameSize();
+        unsigned long done = 0;
+        while (done < SampleCount) {
+            unsigned long n = SampleCount - done;
+            if (n > blockSize) n = blockSize;
+            const unsigned long got = ReadRaw(raw, n);
+            int16_t* pDst = pBuffer + done * Channels;
+            if (BitDepth == 8) kernels.Widen8(raw, pDst, got * Channels);
+            else               kernels.Swap16(raw, pDst, got * Channels);
+            done += got;
+            if (got < n) break;
+        }
+        return done;
+    }
+
+    /**
+     * Same as Read(), but converts the sample points directly to 32 bit
+     * floating point numbers in the range of -1.0 to +1.0 (multiplied by
+     * \a Gain), for 8 bit as well as for 16 bit samples. Like Read16() the
+     * conversion is performed block by block with SIMD instructions if
+     * available.
+     *
+     * @param pBuffer      destination buffer (\a SampleCount * Channels values)
+     * @param SampleCount  number of sample points to read
+     * @param Gain         (optional) gain factor to be applied
+     * @returns            number of successfully read sample points
+     * @see                Read16(), SetPos()
+     */
+    unsigned long KSFSample::ReadFloat(float* pBuffer, unsigned long SampleCount, float Gain) {
+        if ((BitDepth != 8 && BitDepth != 16) || !Channels)
+            throw Exception("Unsupported .KSF sample format");
+        const float scale = Gain / ((BitDepth == 8) ? 128.f : 32768.f);
+        uint8_t raw[KSF_CONVERSION_BLOCK_SIZE];
+        const unsigned long blockSize = KSF_CONVERSION_BLOCK_SIZE / FrameSize();
+        unsigned long done = 0;
+        while (done < SampleCount) {
+            unsigned long n = SampleCount - done;
+            if (n > blockSize) n = blockSize;
+            const unsigned long got = ReadRaw(raw, n);
+            float* pDst = pBuffer + done * Channels;
+            if (BitDepth == 8) kernels.Float8(raw, pDst, got * Channels, scale);
+            else               kernels.Float16(raw, pDst, got * Channels, scale);
+            done += got;
+            if (got < n) break;
+        }
+        return done;
+    }
+
+    /**
+     * Returns the format and length of this sample as stream (see
+     * SampleStream::Source).
+     */
+    SampleStream::info_t KSFSample::GetStreamInfo() {
+        SampleStream::info_t info;
+        info.Channels    = Channels;
+        info.BitDepth    = BitDepth;
+        info.FrameSize   = FrameSize();
+        info.SampleRate  = SampleRate;
+        info.SampleCount = SamplePoints;
+        return info;
+    }
+
+    /**
+     * Reads sample points from any position in the given output format by
+     * Read(), Read16() or ReadFloat() (see SampleStream::Source). The read
+     * position of SetPos() is restored afterwards, so like Read() this must
+     * not be called by several threads for the same sample at the same time.
+     */
+    SampleStream::pos_t KSFSample::ReadStream(SampleStream::pos_t Pos, void* pBuffer, SampleStream::pos_t SampleCount, SampleStream::format_t Format) {
+        if (Pos >= SamplePoints) return 0;
+        if (SampleCount > SamplePoints - Pos) SampleCount = SamplePoints - Pos;
+        const unsigned long oldPos = pos;
+        pos = (unsigned long) Pos;
+        unsigned long n;
+        try {
+            switch (Format) {
+                case SampleStream::format_int16:
+                    n = Read16((int16_t*) pBuffer, (unsigned long) SampleCount);
+                    break;
+                case SampleStream::format_float:
+                    n = ReadFloat((float*) pBuffer, (unsigned long) SampleCount);
+                    break;
+                default:
+                    n = Read(pBuffer, (unsigned long) SampleCount);
+            }
+        } catch (...) {
+            pos = oldPos;
+            throw;
+        }
+        pos = oldPos;
+        return n;
+    }
+
+    /**
+     * Returns the loop of this sample (if any). @c LoopEnd is interpreted as
+     * the sample point after the loop, like the KMP to gig converter does.
+     */
+    bool KSFSample::GetStreamLoop(SampleStream::loop_t& Loop) {
+        Loop = SampleStream::loop_t();
+        if (!LoopEnd || LoopStart >= LoopEnd || LoopStart >= SamplePoints) return false;
+        Loop.Start = LoopStart;
+        Loop.End   = (LoopEnd < SamplePoints) ? LoopEnd : SamplePoints;
+        return true;
+    }
+
+    /**
+     * Returns the head of this sample cached in RAM by LoadSampleData() (if
+     * any).
+     */
+    SampleStream::head_t KSFSample::GetStreamHead() {
+        SampleStream::head_t head;
+        if (!RAMCache.pStart || !FrameSize()) return head;
+        head.pData       = RAMCache.pStart;
+        head.SampleCount = RAMCache.Size / FrameSize();
+        return head;
+    }
+
     /**
      * Returns the size of one sample point of this sample in bytes.
      */
@@ -331,7 +803,7 @@ namespace Korg {
     }
 
     String KSFSample::FileName() const {
-        return riff->GetFileName();
+        return filename;
     }
 
 // *************** KMPRegion ***************
@@ -397,6 +869,16 @@ namespace Korg {
             KMPRegion* region = new KMPRegion(this, rlp1);
             regions.push_back(region);
         }
+
+        // map the keys to the regions (each one starts after the previous
+        // region's TopKey)
+        int key = 0;
+        for (size_t i = 0; i < regions.size(); ++i)
+
+            for (; key <= regions[i]->TopKey; ++key)
+                keyRegions[key] = regions[i];
+        for (; key < 128; ++key)
+            keyRegions[key] = NULL;
     }
 
     KMPInstrument::~KMPInstrument() {
@@ -415,6 +897,18 @@ namespace Korg {
         return (int) regions.size();
     }
 
+    /**
+     * Returns the region mapped to the given MIDI key, NULL if there is
+     * none. Other than searching the regions with GetRegion(), this is a
+     * simple table lookup.
+     *
+     * @param key - MIDI key number (0..127)
+     */
+    KMPRegion* KMPInstrument::GetRegionOfKey(int key) const {
+        if (key < 0 || key > 127) return NULL;
+        return keyRegions[key];
+    }
+
     bool KMPInstrument::Use2ndStart() const {
         return !(Attributes & 1);
     }
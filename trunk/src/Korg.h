@@ -26,6 +26,7 @@
 
 #include "RIFF.h"
 #include "gig.h" // for struct buffer_t
+#include "SampleStream.h"
 #include <vector>
 
 /**
@@ -86,8 +87,19 @@ namespace Korg {
      * Implements access to KORG audio sample files with ".KSF" file name
      * extension. As of to date, there are only mono samples in .KSF format.
      * If you ever encounter a stereo sample, please report it!
+     *
+     * To avoid running out of file descriptors with large multi sample
+     * folders, only a limited amount of .KSF files are kept open at the same
+     * time (see SetMaxOpenFiles()). Files are transparently reopened when
+     * their sample data is accessed again.
+     *
+     * With memory mapping enabled (see SetMemoryMapping()), the sample data
+     * of the .KSF files is accessed through a read-only memory-mapped view
+     * of each file instead, and LoadSampleData() returns a pointer into
+     * that view instead of copying the whole sample into RAM, whenever the
+     * sample data does not require byte order conversion.
      */
-    class KSFSample {
+    class KSFSample : public SampleStream::Source {
     public:
         String Name; ///< Sample name for drums (since this name is always stored with 16 bytes, this name must never be longer than 16 characters).
         uint8_t DefaultBank; ///< 0..3
@@ -118,9 +130,33 @@ namespace Korg {
         unsigned long SetPos(unsigned long SampleCount, RIFF::stream_whence_t Whence = RIFF::stream_start);
         unsigned long GetPos() const;
         unsigned long Read(void* pBuffer, unsigned long SampleCount);
+        unsigned long Read16(int16_t* pBuffer, unsigned long SampleCount);
+        unsigned long ReadFloat(float* pBuffer, unsigned long SampleCount, float Gain = 1.0f);
+
+        bool IsCacheMapped() const;
+
+        // implementation of SampleStream::Source
+        virtual SampleStream::info_t GetStreamInfo();
+        virtual SampleStream::pos_t  ReadStream(SampleStream::pos_t Pos, void* pBuffer, SampleStream::pos_t SampleCount, SampleStream::format_t Format = SampleStream::format_native);
+        virtual bool                 GetStreamLoop(SampleStream::loop_t& Loop);
+        virtual SampleStream::head_t GetStreamHead();
+
+        static void SetMaxOpenFiles(unsigned int count);
+        static unsigned int GetMaxOpenFiles();
+        static void SetMemoryMapping(bool enable);
+        static bool GetMemoryMapping();
     private:
-        RIFF::File* riff;
+        RIFF::File* riff; ///< NULL while the file is closed (see SetMaxOpenFiles()).
+        String filename;
+        unsigned long pos; ///< Current read position (in sample points).
         buffer_t RAMCache; ///< Buffers sample data in RAM.
+        bool ramCacheMapped; ///< True if RAMCache points into the memory-mapped file, which is kept open then (see SetMemoryMapping()).
+
+        void ReadHeader();
+        unsigned long ReadRaw(uint8_t* pBuffer, unsigned long SampleCount);
+        RIFF::File* AcquireFile();
+        void CloseFile();
+        static bool CloseLeastRecentlyUsedFile();
     };
 
     /**
@@ -178,12 +214,14 @@ namespace Korg {
         virtual ~KMPInstrument();
         KMPRegion* GetRegion(int index);
         int GetRegionCount() const;
+        KMPRegion* GetRegionOfKey(int key) const;
         bool Use2ndStart() const;
         String FileName() const;
         String Name() const;
     private:
         RIFF::File* riff;
         std::vector<KMPRegion*> regions;
+        KMPRegion* keyRegions[128]; ///< Region mapped to each MIDI key (NULL if none), for fast lookup by GetRegionOfKey().
     };
 
     /**
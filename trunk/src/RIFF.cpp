@@ -22,7 +22,9 @@
  ***************************************************************************/
 
 #include <algorithm>
+#include <new>
 #include <set>
+#include <stdlib.h>
 #include <string.h>
 
 #include "RIFF.h"
@@ -31,27 +33,1725 @@
 
 #if POSIX
 # include <errno.h>
+# include <sys/mman.h>
 #endif
+#if defined(__linux__)
+# include <linux/fs.h> // FICLONERANGE
+# include <linux/mempolicy.h> // MPOL_PREFERRED, MPOL_INTERLEAVE
+# include <sys/syscall.h>
+# include <sys/ioctl.h>
+# include <sys/sendfile.h>
+#endif
+
+// SIMD kernels for byte swapping of bulk reads and writes (see
+// __swapWords()): on x86 they are compiled for SSSE3 and selected at
+// runtime, on ARM the NEON kernels are selected at compile time.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define RIFF_SIMD_X86 1
+# include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define RIFF_SIMD_NEON 1
+# include <arm_neon.h>
+#endif
+
+#if HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+# include <sys/syscall.h>
+# include <sys/uio.h>
+# if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#  define HAVE_IO_URING 1
+# endif
+#endif
+
+/// Max. size of chunk bodies which are read at once by Chunk::Read() for small reads (see Chunk::__loadReadAhead()).
+#define CHUNK_READ_AHEAD_SIZE   4096
+
+/// Size of the blocks in which List::LoadSubChunks() reads the headers of consecutive small sub chunks.
+#define LIST_SCAN_BLOCK_SIZE    16384
+
+/// Size of the blocks of the block cache (see RIFF::SetBlockCacheSize()).
+#define BLOCK_CACHE_BLOCK_SIZE  (64 * 1024)
+
+/// ID of the 'data' chunks holding the sample data of DLS and gig files (same as in DLS.h).
+#if WORDS_BIGENDIAN
+# define CHUNK_ID_SAMPLE_DATA   0x64617461
+#else
+# define CHUNK_ID_SAMPLE_DATA   0x61746164
+#endif
+
+/// Alignment of file positions, sizes and buffers for unbuffered reads (see File::SetUnbuffered()), the logical block size of all common storage devices.
+#define UNBUFFERED_IO_ALIGNMENT 4096
+
+/// Max. size of the intermediate buffer for unbuffered reads into unaligned buffers (see File::__readBounced()).
+#define UNBUFFERED_BOUNCE_SIZE  (256 * 1024)
+
+/// Max. amount of bytes read by one ReadFile() call on Windows (ReadFile() is limited to 32 bit sizes).
+#define WIN32_MAX_READ_SIZE     0x40000000
+
+/// Size of each asynchronous read File::Prefetch() issues on Windows (see FileIODevice::__prefetchIOCP()).
+#define IOCP_PREFETCH_SIZE      (256 * 1024)
+
+/// Max. amount of asynchronous prefetch reads in flight per file on Windows.
+#define IOCP_PREFETCH_DEPTH     16
+
+/// Min. size of sample buffers placed on NUMA nodes by the default allocator, smaller ones are allocated by new[] (see AllocateSampleBuffer()).
+#define NUMA_MIN_PLACED_SIZE    (64 * 1024)
+
+/// Max. amount of NUMA nodes supported by the default allocator.
+#define NUMA_MAX_NODES          1024
+
+/// Size of the stripes interleaved across the NUMA nodes on Windows (see numa_node_interleave).
+#define NUMA_INTERLEAVE_STRIPE  (64 * 1024)
+
+/// Size of each of the two buffers used by File::Save() for moving chunk data (see File::__deviceMove()).
+#define SAVE_COPY_BUFFER_SIZE   (4 * 1024 * 1024)
+
+/// Max. amount of chunk data File::Save() may load into RAM for moving chunks towards the end of the file (see Chunk::__planWrite()).
+#define SAVE_RAM_BUDGET         (64 * 1024 * 1024)
+
+namespace RIFF {
+
+    /// Layout decisions made by File::Save() before the RIFF tree is written (see Chunk::__planWrite()).
+    struct save_plan_t {
+        file_offset_t        ullShift;     ///< Amount of bytes the current file data has to be moved towards the end of the file before writing.
+        file_offset_t        ullRAMBudget; ///< Remaining amount of bytes which may still be loaded into RAM.
+        std::vector<Chunk*>  Loaded;       ///< Chunks whose data was loaded into RAM just for saving.
+    };
+
+    /// New chunk positions collected by File::Save() with save_mode_replace, applied once the new file is complete (see Chunk::__setWritten()).
+    struct save_commit_t {
+        struct entry_t {
+            Chunk*        pChunk;
+            file_offset_t ullStartPos; ///< New position of the chunk's body within the new file.
+            file_offset_t ullSize;     ///< New size of the chunk's body.
+        };
+        std::vector<entry_t> Entries;
+    };
+
+// *************** Internal functions **************
+// *
+
+    /// Returns a human readable path of the given chunk.
+    static String __resolveChunkPath(Chunk* pCk) {
+        String sPath;
+        for (Chunk* pChunk = pCk; pChunk; pChunk = pChunk->GetParent()) {
+            if (pChunk->GetChunkID() == CHUNK_ID_LIST) {
+                List* pList = (List*) pChunk;
+                sPath = "->'" + pList->GetListTypeString() + "'" + sPath;
+            } else {
+                sPath = "->'" + pChunk->GetChunkIDString() + "'" + sPath;
+            }
+        }
+        return sPath;
+    }
+
+    /// Hash used for detecting whether chunk data in RAM differs from the data stored in the file.
+    static uint64_t __hashChunkData(const uint8_t* pData, file_offset_t ullSize) {
+        uint64_t h = 0xcbf29ce484222325ULL ^ ullSize;
+        file_offset_t i = 0;
+        for (; i + 8 <= ullSize; i += 8) {
+            uint64_t w;
+            memcpy(&w, &pData[i], 8);
+            h = (h ^ w) * 0x100000001b3ULL;
+            h ^= h >> 29;
+        }
+        for (; i < ullSize; ++i)
+            h = (h ^ pData[i]) * 0x100000001b3ULL;
+        return h;
+    }
+
+    namespace {
+
+    void Swap16Scalar(uint8_t* p, file_offset_t n) {
+        for (; n; --n, p += 2) swapBytes_16(p);
+    }
+
+    void Swap32Scalar(uint8_t* p, file_offset_t n) {
+        for (; n; --n, p += 4) swapBytes_32(p);
+    }
+
+    void Swap64Scalar(uint8_t* p, file_offset_t n) {
+        for (; n; --n, p += 8) swapBytes_64(p);
+    }
+
+#if RIFF_SIMD_X86
+
+    __attribute__((target("ssse3")))
+    void SwapSSSE3(uint8_t* p, file_offset_t nBytes, __m128i mask) {
+        for (; nBytes >= 64; nBytes -= 64, p += 64) {
+            __m128i v0 = _mm_loadu_si128((const __m128i*) p);
+            __m128i v1 = _mm_loadu_si128((const __m128i*) (p + 16));
+            __m128i v2 = _mm_loadu_si128((const __m128i*) (p + 32));
+            __m128i v3 = _mm_loadu_si128((const __m128i*) (p + 48));
+            _mm_storeu_si128((__m128i*) p,        _mm_shuffle_epi8(v0, mask));
+            _mm_storeu_si128((__m128i*) (p + 16), _mm_shuffle_epi8(v1, mask));
+            _mm_storeu_si128((__m128i*) (p + 32), _mm_shuffle_epi8(v2, mask));
+            _mm_storeu_si128((__m128i*) (p + 48), _mm_shuffle_epi8(v3, mask));
+        }
+        for (; nBytes >= 16; nBytes -= 16, p += 16)
+            _mm_storeu_si128((__m128i*) p, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) p), mask));
+    }
+
+    __attribute__((target("ssse3")))
+    void Swap16SSSE3(uint8_t* p, file_offset_t n) {
+        const file_offset_t nVec = n & ~file_offset_t(7);
+        SwapSSSE3(p, nVec * 2, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+        Swap16Scalar(p + nVec * 2, n - nVec);
+    }
+
+    __attribute__((target("ssse3")))
+    void Swap32SSSE3(uint8_t* p, file_offset_t n) {
+        const file_offset_t nVec = n & ~file_offset_t(3);
+        SwapSSSE3(p, nVec * 4, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+        Swap32Scalar(p + nVec * 4, n - nVec);
+    }
+
+    __attribute__((target("ssse3")))
+    void Swap64SSSE3(uint8_t* p, file_offset_t n) {
+        const file_offset_t nVec = n & ~file_offset_t(1);
+        SwapSSSE3(p, nVec * 8, _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+        Swap64Scalar(p + nVec * 8, n - nVec);
+    }
+
+#elif RIFF_SIMD_NEON
+
+    void Swap16NEON(uint8_t* p, file_offset_t n) {
+        for (; n >= 8; n -= 8, p += 16) vst1q_u8(p, vrev16q_u8(vld1q_u8(p)));
+        Swap16Scalar(p, n);
+    }
+
+    void Swap32NEON(uint8_t* p, file_offset_t n) {
+        for (; n >= 4; n -= 4, p += 16) vst1q_u8(p, vrev32q_u8(vld1q_u8(p)));
+        Swap32Scalar(p, n);
+    }
+
+    void Swap64NEON(uint8_t* p, file_offset_t n) {
+        for (; n >= 2; n -= 2, p += 16) vst1q_u8(p, vrev64q_u8(vld1q_u8(p)));
+        Swap64Scalar(p, n);
+    }
+
+#endif // RIFF_SIMD_NEON
+
+    typedef void (*swap_fn_t)(uint8_t* p, file_offset_t n);
+
+    struct swap_kernels_t {
+        swap_fn_t Swap16;
+        swap_fn_t Swap32;
+        swap_fn_t Swap64;
+    };
+
+    // picks the best kernels for the CPU we are running on
+    swap_kernels_t selectSwapKernels() {
+        swap_kernels_t k;
+        k.Swap16 = Swap16Scalar;
+        k.Swap32 = Swap32Scalar;
+        k.Swap64 = Swap64Scalar;
+#if RIFF_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("ssse3")) {
+            k.Swap16 = Swap16SSSE3;
+            k.Swap32 = Swap32SSSE3;
+            k.Swap64 = Swap64SSSE3;
+        }
+#elif RIFF_SIMD_NEON
+        k.Swap16 = Swap16NEON;
+        k.Swap32 = Swap32NEON;
+        k.Swap64 = Swap64NEON;
+#endif
+        return k;
+    }
+
+    // byte swapping routines for the CPU we are running on (constant after
+    // static initialization, hence safe to be used by any thread)
+    const swap_kernels_t swapKernels = selectSwapKernels();
+
+    } // anonymous namespace
+
+    /// Swaps the byte order of each of the given data words (if WordSize > 1).
+    static void __swapWords(void* pData, file_offset_t WordCount, file_offset_t WordSize) {
+        switch (WordSize) {
+            case 1:
+                break;
+            case 2:
+                swapKernels.Swap16((uint8_t*) pData, WordCount);
+                break;
+            case 4:
+                swapKernels.Swap32((uint8_t*) pData, WordCount);
+                break;
+            case 8:
+                swapKernels.Swap64((uint8_t*) pData, WordCount);
+                break;
+            default:
+                for (file_offset_t iWord = 0; iWord < WordCount; iWord++)
+                    swapBytes((uint8_t*) pData + iWord * WordSize, WordSize);
+                break;
+        }
+    }
+
+
+// *************** FileIODevice ***************
+// *
+
+    #if HAVE_IO_URING
+
+    /// Minimalistic io_uring instance (without liburing dependency).
+    struct uring_t {
+        int            fd;
+        bool           failed;      ///< true if io_uring is not available on this system
+        unsigned       entries;
+        void*          pSQRing;
+        size_t         sqRingSize;
+        void*          pCQRing;
+        size_t         cqRingSize;
+        io_uring_sqe*  sqes;
+        size_t         sqesSize;
+        unsigned*      sqTail;
+        unsigned*      sqMask;
+        unsigned*      sqArray;
+        unsigned*      cqHead;
+        unsigned*      cqTail;
+        unsigned*      cqMask;
+        io_uring_cqe*  cqes;
+        mutex_t        mutex;
+
+        uring_t() : fd(-1), failed(false), pSQRing(MAP_FAILED), pCQRing(MAP_FAILED), sqes((io_uring_sqe*) MAP_FAILED) {}
+
+        ~uring_t() {
+            reset();
+        }
+
+        // releases the ring, the kernel cancels requests still in flight
+        void reset() {
+            if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+            if (pCQRing != MAP_FAILED) munmap(pCQRing, cqRingSize);
+            if (pSQRing != MAP_FAILED) munmap(pSQRing, sqRingSize);
+            if (fd >= 0) close(fd);
+            sqes    = (io_uring_sqe*) MAP_FAILED;
+            pCQRing = pSQRing = MAP_FAILED;
+            fd      = -1;
+        }
+
+        bool setup(unsigned depth) {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            fd = (int) syscall(__NR_io_uring_setup, depth, &params);
+            if (fd < 0) return false;
+            entries    = params.sq_entries;
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            sqesSize   = params.sq_entries * sizeof(io_uring_sqe);
+            pSQRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            pCQRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            sqes = (io_uring_sqe*) mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if (pSQRing == MAP_FAILED || pCQRing == MAP_FAILED || sqes == MAP_FAILED) return false;
+            uint8_t* sq = (uint8_t*) pSQRing;
+            uint8_t* cq = (uint8_t*) pCQRing;
+            sqTail  = (unsigned*) (sq + params.sq_off.tail);
+            sqMask  = (unsigned*) (sq + params.sq_off.ring_mask);
+            sqArray = (unsigned*) (sq + params.sq_off.array);
+            cqHead  = (unsigned*) (cq + params.cq_off.head);
+            cqTail  = (unsigned*) (cq + params.cq_off.tail);
+            cqMask  = (unsigned*) (cq + params.cq_off.ring_mask);
+            cqes    = (io_uring_cqe*) (cq + params.cq_off.cqes);
+            return true;
+        }
+
+        // queues a readv request (caller must not exceed 'entries' pending requests)
+        void queue(int hFile, const iovec* iov, file_offset_t offset, uint64_t userData) {
+            const unsigned tail  = *sqTail;
+            const unsigned index = tail & *sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode    = IORING_OP_READV;
+            sqe.fd        = hFile;
+            sqe.off       = offset;
+            sqe.addr      = (uint64_t) (uintptr_t) iov;
+            sqe.len       = 1;
+            sqe.user_data = userData;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        }
+
+        // submits 'submit' queued requests and waits for at least 'wait'
+        // completions, 'submit' is left with the amount of requests still
+        // queued (not consumed by the kernel yet)
+        bool enter(unsigned& submit, unsigned wait) {
+            while (true) {
+                const int res = (int) syscall(__NR_io_uring_enter, fd, submit, wait, IORING_ENTER_GETEVENTS, NULL, 0);
+                if (res >= 0) {
+                    submit -= std::min(submit, unsigned(res));
+                    return true;
+                }
+                if (errno != EINTR) return false;
+                submit = 0; // (requests were consumed even if interrupted)
+            }
+        }
+
+        // fetches one completion if available
+        bool reap(uint64_t& userData, int& res) {
+            const unsigned head = *cqHead;
+            if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            userData = cqe.user_data;
+            res      = cqe.res;
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+    };
+
+    #endif // HAVE_IO_URING
+
+    #if defined(WIN32)
+
+    /**
+     * Positional read from a Windows file handle, split into ReadFile()
+     * calls of at most WIN32_MAX_READ_SIZE bytes. Handles opened with
+     * FILE_FLAG_OVERLAPPED are read by waiting for the respective overlapped
+     * operation, so that several threads may read from the same handle
+     * concurrently instead of being serialized by the handle's file
+     * position.
+     *
+     * @param hFile       - file handle
+     * @param bOverlapped - whether @a hFile was opened with FILE_FLAG_OVERLAPPED
+     * @param Offset      - absolute position in the file
+     * @param pData       - destination buffer
+     * @param Size        - amount of bytes to read
+     * @returns amount of bytes read
+     */
+    static file_offset_t __readFileAt(HANDLE hFile, bool bOverlapped, file_offset_t Offset, void* pData, file_offset_t Size) {
+        HANDLE hEvent = NULL;
+        if (bOverlapped) {
+            hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+            if (!hEvent) return 0;
+        }
+        file_offset_t ullRead = 0;
+        while (ullRead < Size) {
+            const DWORD size = (DWORD) std::min(Size - ullRead, (file_offset_t) WIN32_MAX_READ_SIZE);
+            OVERLAPPED ov;
+            memset(&ov, 0, sizeof(ov));
+            ov.Offset     = DWORD((Offset + ullRead) & 0xffffffff);
+            ov.OffsetHigh = DWORD((Offset + ullRead) >> 32);
+            // setting the event's low order bit prevents the completion from
+            // being queued to the I/O completion port the handle may be
+            // associated with (see iocp_t)
+            ov.hEvent = (hEvent) ? (HANDLE) ((ULONG_PTR) hEvent | 1) : NULL;
+            DWORD readBytes = 0;
+            BOOL ok = ReadFile(hFile, (uint8_t*) pData + ullRead, size, &readBytes, &ov);
+            if (bOverlapped && (ok || GetLastError() == ERROR_IO_PENDING))
+                ok = GetOverlappedResult(hFile, &ov, &readBytes, TRUE);
+            if (!ok || !readBytes) break; // error or end of file
+            ullRead += readBytes;
+            if (readBytes < size) break;
+        }
+        if (hEvent) CloseHandle(hEvent);
+        return ullRead;
+    }
+
+    /**
+     * I/O completion port of a file opened in read-only mode, which File::
+     * ReadBatch() (with io_backend_uring selected) and File::Prefetch() use
+     * for reading asynchronously on Windows. Prefetch reads are issued into
+     * a scratch buffer without waiting for them, just to get the data into
+     * the system's file cache; their completions are collected whenever the
+     * port is used next and before the file handle gets closed.
+     */
+    struct iocp_t {
+        HANDLE     port;
+        HANDLE     hAttached;   ///< File handle currently associated with the port (a new handle has to be associated after reopening the file).
+        bool       failed;      ///< true if the port could not be created
+        OVERLAPPED prefetch[IOCP_PREFETCH_DEPTH];
+        bool       busy[IOCP_PREFETCH_DEPTH]; ///< Whether the respective prefetch read is in flight.
+        size_t     pending;     ///< Amount of prefetch reads in flight.
+        uint8_t*   pScratch;    ///< Destination of all prefetch reads (IOCP_PREFETCH_SIZE bytes, its content is never used).
+        mutex_t    mutex;
+
+        iocp_t() : port(NULL), hAttached(INVALID_HANDLE_VALUE), failed(false), pending(0), pScratch(NULL) {
+            for (int i = 0; i < IOCP_PREFETCH_DEPTH; ++i) busy[i] = false;
+        }
+
+        ~iocp_t() {
+            if (pScratch) VirtualFree(pScratch, 0, MEM_RELEASE);
+            if (port) CloseHandle(port);
+        }
+
+        /// Associates @a hFile with the port, creating the port on first use (mutex must be locked).
+        bool attach(HANDLE hFile) {
+            if (failed) return false;
+            if (hAttached == hFile) return true;
+            HANDLE h = CreateIoCompletionPort(hFile, port, 0, 0);
+            if (!h) {
+                if (!port) failed = true;
+                return false;
+            }
+            port      = h;
+            hAttached = hFile;
+            return true;
+        }
+
+        /// Retires the completion of @a pOv if it is a prefetch read, returns false otherwise (mutex must be locked).
+        bool retire(LPOVERLAPPED pOv) {
+            if (pOv < prefetch || pOv >= prefetch + IOCP_PREFETCH_DEPTH) return false;
+            busy[pOv - prefetch] = false;
+            --pending;
+            return true;
+        }
+
+        /// Collects the completions of all prefetch reads finished so far, without blocking (mutex must be locked).
+        void poll() {
+            while (pending) {
+                DWORD size; ULONG_PTR key; LPOVERLAPPED pOv = NULL;
+                GetQueuedCompletionStatus(port, &size, &key, &pOv, 0);
+                if (!pOv || !retire(pOv)) break;
+            }
+        }
+
+        /// Cancels all prefetch reads in flight on @a hFile and waits for them, before the handle may be closed (mutex must be locked).
+        void drain(HANDLE hFile) {
+            hAttached = INVALID_HANDLE_VALUE; // (the handle value may be reused by the system)
+            if (!pending) return;
+            #if _WIN32_WINNT >= 0x0600
+            CancelIoEx(hFile, NULL);
+            #endif
+            while (pending) {
+                DWORD size; ULONG_PTR key; LPOVERLAPPED pOv = NULL;
+                GetQueuedCompletionStatus(port, &size, &key, &pOv, INFINITE);
+                if (!pOv) break;
+                retire(pOv);
+            }
+            for (int i = 0; i < IOCP_PREFETCH_DEPTH; ++i) busy[i] = false;
+            pending = 0;
+        }
+    };
+
+    #endif // WIN32
+
+    namespace {
+
+    class FileIODevice;
+
+    /// Maximum amount of file handles held open by FileIODevice objects (see SetFileHandleLimit()), 0: unlimited.
+    static size_t fileHandleLimit = 0;
+    /// Guards fileHandleLimit, openFileHandles and the handle cache state of all FileIODevice objects.
+    static mutex_t fileHandleMutex;
+    /// FileIODevice objects subject to the handle limit whose handle is currently open, most recently used first.
+    static std::list<FileIODevice*> openFileHandles;
+    /// Amount of entries in openFileHandles (std::list::size() is not constant time in C++98).
+    static size_t openFileHandleCount = 0;
+
+    /**
+     * Default IODevice implementation: a regular file of the file system,
+     * accessed by POSIX, Windows or standard C file functions.
+     *
+     * If a file handle limit was set by SetFileHandleLimit() when the file
+     * was opened in read-only mode, the device is subject to the process
+     * wide handle cache: whenever the limit is exceeded, the handles of the
+     * least recently used idle read-only devices are closed, and each of
+     * them transparently reopens its file on its next access.
+     */
+    class FileIODevice : public IODevice {
+    public:
+        FileIODevice(const String& path) : path(path), pMapped(NULL), ullMappedSize(0), pOutput(NULL), ullOutputSize(0), bUnbuffered(false), bCached(false), bEvicted(false), bListed(false), users(0) {
+            #if POSIX
+            hFile = -1;
+            hDirect = -1;
+            #elif defined(WIN32)
+            hFile = INVALID_HANDLE_VALUE;
+            hDirect = INVALID_HANDLE_VALUE;
+            hFileMapping = NULL;
+            bOverlapped = false;
+            pIocp = new iocp_t; // (the port itself is created on first use)
+            #else
+            hFile = NULL;
+            #endif
+            #if HAVE_IO_URING
+            pUring = new uring_t; // (the ring itself is set up on first use)
+            #endif
+        }
+
+        virtual ~FileIODevice() {
+            Unmap();
+            UnmapOutput();
+            close();
+            #if HAVE_IO_URING
+            if (pUring) delete pUring;
+            #endif
+            #if defined(WIN32)
+            if (pIocp) delete pIocp;
+            #endif
+        }
+
+        /// Opens the existing file in read-only mode for the first time.
+        void Open() {
+            if (!openReadOnly()) {
+                #if POSIX
+                String sError = strerror(errno);
+                throw RIFF::Exception("Can't open \"" + path + "\": " + sError);
+                #else
+                throw RIFF::Exception("Can't open \"" + path + "\"");
+                #endif
+            }
+            registerHandle();
+        }
+
+        /// Renames the file to @a newPath, replacing an existing file of that name.
+        bool Rename(const String& newPath) {
+            #if POSIX
+            if (::rename(path.c_str(), newPath.c_str())) return false;
+            #elif defined(WIN32)
+            close(); // (an open file can't be renamed, reopened by SetMode())
+            if (!MoveFileEx(path.c_str(), newPath.c_str(), MOVEFILE_REPLACE_EXISTING)) return false;
+            #else
+            close();
+            remove(newPath.c_str()); // rename() does not necessarily replace existing files
+            if (::rename(path.c_str(), newPath.c_str())) return false;
+            #endif
+            path = newPath;
+            return true;
+        }
+
+        /// Opens the file for writing, creating it if it does not exist yet.
+        /// If @a bTruncate is true, an existing file is truncated to zero
+        /// length (ignored for pipes and other special files).
+        void Create(bool bTruncate = false) {
+            close();
+            #if POSIX
+            hFile = open(path.c_str(), O_RDWR | O_CREAT | (bTruncate ? O_TRUNC : 0), S_IRUSR | S_IWUSR | S_IRGRP);
+            if (hFile == -1) {
+                String sError = strerror(errno);
+                throw Exception("Could not open file \"" + path + "\" for writing: " + sError);
+            }
+            #elif defined(WIN32)
+            // (read access is required for mapping the file, see MapOutput())
+            hFile = CreateFile(
+                        path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                        NULL, (bTruncate) ? CREATE_ALWAYS : OPEN_ALWAYS,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL
+                    );
+            if (hFile == INVALID_HANDLE_VALUE)
+                throw Exception("Could not open file \"" + path + "\" for writing");
+            bOverlapped = false;
+            #else
+            hFile = fopen(path.c_str(), "w+b");
+            if (!hFile) throw Exception("Could not open file \"" + path + "\" for writing");
+            #endif // POSIX
+        }
+
+        virtual void SetMode(stream_mode_t NewMode) {
+            switch (NewMode) {
+                case stream_mode_read:
+                    close();
+                    if (!openReadOnly()) {
+                        #if POSIX
+                        String sError = strerror(errno);
+                        throw Exception("Could not (re)open file \"" + path + "\" in read mode: " + sError);
+                        #else
+                        throw Exception("Could not (re)open file \"" + path + "\" in read mode");
+                        #endif
+                    }
+                    registerHandle();
+                    break;
+                case stream_mode_read_write:
+                    close();
+                    #if POSIX
+                    hFile = open(path.c_str(), O_RDWR | O_NONBLOCK);
+                    if (hFile == -1) {
+                        String sError = strerror(errno);
+                        if (openReadOnly()) registerHandle();
+                        throw Exception("Could not open file \"" + path + "\" in read+write mode: " + sError);
+                    }
+                    #elif defined(WIN32)
+                    hFile = CreateFile(
+                                path.c_str(),
+                                GENERIC_READ | GENERIC_WRITE,
+                                FILE_SHARE_READ,
+                                NULL, OPEN_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL |
+                                FILE_FLAG_RANDOM_ACCESS,
+                                NULL
+                            );
+                    if (hFile == INVALID_HANDLE_VALUE) {
+                        if (openReadOnly()) registerHandle();
+                        throw Exception("Could not (re)open file \"" + path + "\" in read+write mode");
+                    }
+                    bOverlapped = false;
+                    #else
+                    hFile = fopen(path.c_str(), "r+b");
+                    if (!hFile) {
+                        if (openReadOnly()) registerHandle();
+                        throw Exception("Could not open file \"" + path + "\" in read+write mode");
+                    }
+                    #endif
+                    break;
+                case stream_mode_closed:
+                    close();
+                    break;
+                default:
+                    break;
+            }
+            // close() also closed the unbuffered handle
+            if (bUnbuffered) openDirect();
+        }
+
+        virtual bool IsOpen() const {
+            // a handle closed by the handle cache counts as open
+            return bEvicted || isHandleOpen();
+        }
+
+        virtual file_offset_t ReadAt(file_offset_t Offset, void* pData, file_offset_t Size) {
+            if (!Size) return 0;
+            handle_use_t use(this);
+            if (!isHandleOpen()) return 0;
+            #if POSIX
+            ssize_t readBytes = pread(hFile, pData, Size, Offset);
+            if (readBytes < 1) {
+                #if DEBUG_RIFF
+                std::cerr << "POSIX pread() failed: " << strerror(errno) << std::endl << std::flush;
+                #endif // DEBUG_RIFF
+                return 0;
+            }
+            return readBytes;
+            #elif defined(WIN32)
+            return __readFileAt(hFile, bOverlapped, Offset, pData, Size);
+            #else // standard C functions
+            if (fseeko(hFile, Offset, SEEK_SET)) return 0;
+            return fread(pData, 1, Size, hFile);
+            #endif // POSIX
+        }
+
+        virtual file_offset_t WriteAt(file_offset_t Offset, const void* pData, file_offset_t Size) {
+            if (!Size || !isHandleOpen()) return 0;
+            if (pOutput && Offset + Size <= ullOutputSize) {
+                memcpy(pOutput + Offset, pData, (size_t) Size);
+                return Size;
+            }
+            #if POSIX
+            ssize_t writtenBytes = pwrite(hFile, pData, Size, Offset);
+            if (writtenBytes == -1 && errno == ESPIPE) {
+                // pipe or socket: only strictly sequential writing is
+                // possible (see File::SaveSequential())
+                file_offset_t ullWritten = 0;
+                for (ssize_t n; ullWritten < Size; ullWritten += n) {
+                    n = write(hFile, (const uint8_t*) pData + ullWritten, Size - ullWritten);
+                    if (n < 1) break;
+                }
+                return ullWritten;
+            }
+            return (writtenBytes < 1) ? 0 : writtenBytes;
+            #elif defined(WIN32)
+            OVERLAPPED ov;
+            memset(&ov, 0, sizeof(ov));
+            ov.Offset     = DWORD(Offset & 0xffffffff);
+            ov.OffsetHigh = DWORD(Offset >> 32);
+            DWORD writtenBytes = 0;
+            if (!WriteFile(hFile, pData, Size, &writtenBytes, &ov)) //FIXME: does not work for writing buffers larger than 2GB (even though this should rarely be the case in practice)
+                return 0;
+            return writtenBytes;
+            #else // standard C functions
+            if (fseeko(hFile, Offset, SEEK_SET)) return 0;
+            return fwrite(pData, 1, Size, hFile);
+            #endif // POSIX
+        }
+
+        virtual file_offset_t GetSize() const {
+            handle_use_t use(this);
+            if (!isHandleOpen()) return 0;
+            #if POSIX
+            struct stat filestat;
+            if (fstat(hFile, &filestat) == -1)
+                throw Exception("POSIX FS error: could not determine file size");
+            return filestat.st_size;
+            #elif defined(WIN32)
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(hFile, &size))
+                throw Exception("Windows FS error: could not determine file size");
+            return size.QuadPart;
+            #else // standard C functions
+            off_t curpos = ftello(hFile);
+            if (fseeko(hFile, 0, SEEK_END) == -1)
+                throw Exception("FS error: could not determine file size");
+            off_t size = ftello(hFile);
+            fseeko(hFile, curpos, SEEK_SET);
+            return size;
+            #endif
+        }
+
+        virtual void Resize(file_offset_t NewSize) {
+            #if POSIX
+            if (ftruncate(hFile, NewSize) < 0)
+                throw Exception("Could not resize file \"" + path + "\"");
+            #elif defined(WIN32)
+            LARGE_INTEGER liFilePos;
+            liFilePos.QuadPart = NewSize;
+            if (
+                !SetFilePointerEx(hFile, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN) ||
+                !SetEndOfFile(hFile)
+            ) throw Exception("Could not resize file \"" + path + "\"");
+            #else
+            # error Sorry, this version of libgig only supports POSIX and Windows systems yet.
+            # error Reason: portable implementation of RIFF::FileIODevice::Resize() is missing (yet)!
+            #endif
+        }
+
+        virtual void Reserve(file_offset_t Size, file_offset_t Headroom) {
+            if (!isHandleOpen()) return;
+            #if POSIX
+            # if HAVE_FALLOCATE && defined(FALLOC_FL_KEEP_SIZE)
+            // allocates all holes up to the given size (plus headroom),
+            // without changing the file size
+            if (fallocate(hFile, FALLOC_FL_KEEP_SIZE, 0, (off_t) (Size + Headroom)) == 0)
+                return;
+            # endif
+            # if HAVE_POSIX_FALLOCATE
+            // (cannot reserve any headroom, as it would change the file size)
+            if (Size) posix_fallocate(hFile, 0, (off_t) Size);
+            # endif
+            #elif defined(WIN32)
+            # if _WIN32_WINNT >= 0x0600
+            FILE_ALLOCATION_INFO info;
+            info.AllocationSize.QuadPart = Size + Headroom;
+            SetFileInformationByHandle(hFile, FileAllocationInfo, &info, sizeof(info));
+            # endif
+            // spares NTFS zero filling the enlarged area before writing
+            // behind it, requires the SE_MANAGE_VOLUME_NAME privilege (this
+            // is safe because File::Save() overwrites the whole area anyway)
+            # if _WIN32_WINNT >= 0x0501
+            LARGE_INTEGER size;
+            if (GetFileSizeEx(hFile, &size) && size.QuadPart >= (LONGLONG) Size)
+                SetFileValidData(hFile, (LONGLONG) Size);
+            # endif
+            #endif
+        }
+
+        virtual void Advise(file_offset_t Offset, file_offset_t Size) {
+            Advise(Offset, Size, advice_willneed);
+        }
+
+        virtual void Advise(file_offset_t Offset, file_offset_t Size, advice_t Advice) {
+            #if POSIX
+            if (pMapped) {
+                if (Offset >= ullMappedSize) return;
+                if (Offset + Size > ullMappedSize) Size = ullMappedSize - Offset;
+                const file_offset_t pageSize = (file_offset_t) sysconf(_SC_PAGESIZE);
+                const file_offset_t start = Offset - Offset % pageSize; // must be page aligned
+                int advice;
+                switch (Advice) {
+                    case advice_willneed:   advice = MADV_WILLNEED;   break;
+                    case advice_sequential: advice = MADV_SEQUENTIAL; break;
+                    case advice_random:     advice = MADV_RANDOM;     break;
+                    case advice_dontneed:   advice = MADV_DONTNEED;   break; // (only drops the mapping of a shared read-only view)
+                    default:                advice = MADV_NORMAL;     break;
+                }
+                madvise((void*) (pMapped + start), (size_t) (Offset + Size - start), advice);
+                if (Advice == advice_willneed) return;
+            }
+            # if defined(POSIX_FADV_WILLNEED)
+            // (also for a mapped file: read-ahead and page cache are per file)
+            handle_use_t use(this);
+            if (isHandleOpen()) {
+                int advice;
+                switch (Advice) {
+                    case advice_willneed:   advice = POSIX_FADV_WILLNEED;   break;
+                    case advice_sequential: advice = POSIX_FADV_SEQUENTIAL; break;
+                    case advice_random:     advice = POSIX_FADV_RANDOM;     break;
+                    case advice_dontneed:   advice = POSIX_FADV_DONTNEED;   break;
+                    default:                advice = POSIX_FADV_NORMAL;     break;
+                }
+                posix_fadvise(hFile, (off_t) Offset, (off_t) Size, advice);
+            }
+            # endif
+            #elif defined(WIN32)
+            # if _WIN32_WINNT >= 0x0602
+            // Windows only supports reading ahead mapped ranges, the access
+            // pattern of the file handle is fixed on opening it
+            if (pMapped && Advice == advice_willneed && Offset < ullMappedSize) {
+                if (Offset + Size > ullMappedSize) Size = ullMappedSize - Offset;
+                WIN32_MEMORY_RANGE_ENTRY range;
+                range.VirtualAddress = (PVOID) (pMapped + Offset);
+                range.NumberOfBytes  = (SIZE_T) Size;
+                PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+                return;
+            }
+            # endif
+            // without a mapping, the file cache is filled by asynchronous reads
+            if (!pMapped && Advice == advice_willneed) __prefetchIOCP(Offset, Size);
+            #endif // POSIX
+        }
+
+        virtual size_t EnableUnbuffered(bool bEnable) {
+            handle_use_t use(this);
+            closeDirect();
+            bUnbuffered = bEnable && openDirect();
+            return (bUnbuffered) ? UNBUFFERED_IO_ALIGNMENT : 0;
+        }
+
+        virtual file_offset_t ReadUnbufferedAt(file_offset_t Offset, void* pData, file_offset_t Size) {
+            if (!Size) return 0;
+            handle_use_t use(this);
+            if (!isHandleOpen()) return 0;
+            if (!isDirectOpen()) return ReadAt(Offset, pData, Size);
+            #if POSIX
+            ssize_t readBytes = pread(hDirect, pData, Size, Offset);
+            if (readBytes < 0 && errno == EINVAL) // i.e. alignment not supported after all
+                return ReadAt(Offset, pData, Size);
+            return (readBytes < 1) ? 0 : readBytes;
+            #elif defined(WIN32)
+            return __readFileAt(hDirect, true, Offset, pData, Size);
+            #else
+            return ReadAt(Offset, pData, Size);
+            #endif
+        }
+
+        virtual const uint8_t* Map(file_offset_t& Size) {
+            // (the mapping stays valid if the handle gets closed by the handle cache)
+            handle_use_t use(this);
+            if (!pMapped && isHandleOpen()) {
+                file_offset_t ullFileSize = GetSize();
+                if (!ullFileSize || ullFileSize != (file_offset_t)(size_t) ullFileSize) return NULL;
+                #if POSIX
+                void* p = mmap(NULL, (size_t) ullFileSize, PROT_READ, MAP_SHARED, hFile, 0);
+                if (p == MAP_FAILED) return NULL;
+                pMapped = (const uint8_t*) p;
+                #elif defined(WIN32)
+                hFileMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+                if (!hFileMapping) return NULL;
+                pMapped = (const uint8_t*) MapViewOfFile(hFileMapping, FILE_MAP_READ, 0, 0, 0);
+                if (!pMapped) {
+                    CloseHandle(hFileMapping);
+                    hFileMapping = NULL;
+                    return NULL;
+                }
+                #else
+                return NULL; // no memory mapping support with standard C functions
+                #endif
+                ullMappedSize = ullFileSize;
+            }
+            Size = ullMappedSize;
+            return pMapped;
+        }
+
+        virtual void Unmap() {
+            if (!pMapped) return;
+            #if POSIX
+            munmap((void*) pMapped, (size_t) ullMappedSize);
+            #elif defined(WIN32)
+            UnmapViewOfFile(pMapped);
+            CloseHandle(hFileMapping);
+            hFileMapping = NULL;
+            #endif
+            pMapped       = NULL;
+            ullMappedSize = 0;
+        }
+
+        /**
+         * Sets the size of the file opened by Create() to @a Size bytes,
+         * allocates its disk space and maps it writable into memory. Until
+         * UnmapOutput() is called, WriteAt() and CopyRangeFrom() copy the
+         * data directly into the mapped view instead of issuing system
+         * calls (writes beyond @a Size still go through the file handle).
+         *
+         * The disk space is allocated before mapping, because running out
+         * of disk space while storing to the mapped view would raise a bus
+         * error instead of letting WriteAt() fail.
+         *
+         * @returns false if the file could not be mapped, in which case
+         *          nothing changed
+         */
+        bool MapOutput(file_offset_t Size) {
+            if (pOutput || !Size || !isHandleOpen() || Size != (file_offset_t)(size_t) Size)
+                return false;
+            #if POSIX
+            # if HAVE_FALLOCATE
+            if (fallocate(hFile, 0, 0, (off_t) Size) != 0) return false;
+            # elif HAVE_POSIX_FALLOCATE
+            if (posix_fallocate(hFile, 0, (off_t) Size) != 0) return false;
+            # else
+            return false; // (disk space could not be guaranteed)
+            # endif
+            if (ftruncate(hFile, (off_t) Size) < 0) return false; // (if the file was larger)
+            void* p = mmap(NULL, (size_t) Size, PROT_READ | PROT_WRITE, MAP_SHARED, hFile, 0);
+            if (p == MAP_FAILED) return false;
+            madvise(p, (size_t) Size, MADV_SEQUENTIAL);
+            pOutput = (uint8_t*) p;
+            #elif defined(WIN32)
+            // (the mapping itself sets the file size and allocates the space)
+            Resize(0);
+            HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READWRITE, DWORD(Size >> 32), DWORD(Size & 0xffffffff), NULL);
+            if (!hMapping) return false;
+            pOutput = (uint8_t*) MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, (SIZE_T) Size);
+            CloseHandle(hMapping); // (the view keeps the mapping alive)
+            if (!pOutput) return false;
+            #else
+            return false; // no memory mapping support with standard C functions
+            #endif
+            ullOutputSize = Size;
+            return true;
+        }
+
+        /**
+         * Flushes and releases the mapped view established by MapOutput().
+         *
+         * @returns false if flushing the mapped data to the file failed
+         */
+        bool UnmapOutput() {
+            if (!pOutput) return true;
+            bool bOK = true;
+            #if POSIX
+            bOK = msync(pOutput, (size_t) ullOutputSize, MS_SYNC) == 0;
+            munmap(pOutput, (size_t) ullOutputSize);
+            #elif defined(WIN32)
+            bOK = FlushViewOfFile(pOutput, 0) != 0;
+            UnmapViewOfFile(pOutput);
+            #endif
+            pOutput       = NULL;
+            ullOutputSize = 0;
+            return bOK;
+        }
+
+        #if HAVE_IO_URING
+        virtual void ReadBatch(io_request_t* pRequests, size_t Count) {
+            if (!__readBatchUring(pRequests, Count))
+                IODevice::ReadBatch(pRequests, Count);
+        }
+        #elif defined(WIN32)
+        virtual void ReadBatch(io_request_t* pRequests, size_t Count) {
+            if (!__readBatchIOCP(pRequests, Count))
+                IODevice::ReadBatch(pRequests, Count);
+        }
+        #endif
+
+        virtual file_offset_t CopyRangeFrom(IODevice* pSource, file_offset_t SourceOffset, file_offset_t Offset, file_offset_t Size) {
+            // mapped output: read the source data straight into the mapping
+            if (pOutput && Offset + Size <= ullOutputSize)
+                return __copyToOutput(pSource, SourceOffset, Offset, Size);
+            #if defined(__linux__)
+            FileIODevice* pSrc = dynamic_cast<FileIODevice*>(pSource);
+            if (!pSrc) return 0;
+            handle_use_t useSrc(pSrc), use(this);
+            if (!pSrc->isHandleOpen() || !isHandleOpen()) return 0;
+            file_offset_t ullCopied = 0;
+            #if defined(FICLONERANGE)
+            // on copy-on-write file systems (Btrfs, XFS) the file system
+            // blocks can simply be shared, if source and destination have
+            // the same offset within a block
+            struct stat st;
+            const file_offset_t ullBlockSize = (fstat(hFile, &st) == 0 && st.st_blksize > 0) ? st.st_blksize : 4096;
+            if (SourceOffset % ullBlockSize == Offset % ullBlockSize) {
+                const file_offset_t ullHead = (ullBlockSize - SourceOffset % ullBlockSize) % ullBlockSize;
+                const file_offset_t ullBlocks = (Size > ullHead) ? (Size - ullHead) / ullBlockSize * ullBlockSize : 0;
+                if (ullBlocks && __copyRange(pSrc, SourceOffset, Offset, ullHead) == ullHead) {
+                    struct file_clone_range range;
+                    range.src_fd      = pSrc->hFile;
+                    range.src_offset  = SourceOffset + ullHead;
+                    range.src_length  = ullBlocks;
+                    range.dest_offset = Offset + ullHead;
+                    ullCopied = ullHead;
+                    if (ioctl(hFile, FICLONERANGE, &range) == 0) ullCopied += ullBlocks;
+                }
+            }
+            #endif
+            return ullCopied + __copyRange(pSrc, SourceOffset + ullCopied, Offset + ullCopied, Size - ullCopied);
+            #else
+            return 0;
+            #endif
+        }
+
+
+    private:
+        String         path;
+        #if POSIX
+        int            hFile;
+        int            hDirect;       ///< Additional read-only handle bypassing the page cache (see EnableUnbuffered()), -1 if not opened.
+        #elif defined(WIN32)
+        HANDLE         hFile;
+        HANDLE         hDirect;       ///< Additional read-only handle bypassing the page cache (see EnableUnbuffered()), INVALID_HANDLE_VALUE if not opened.
+        HANDLE         hFileMapping;
+        bool           bOverlapped;   ///< Whether hFile was opened with FILE_FLAG_OVERLAPPED (read-only mode).
+        iocp_t*        pIocp;         ///< I/O completion port used by ReadBatch() and Advise() (the port is created on demand).
+        #else
+        FILE*          hFile;
+        #endif
+        const uint8_t* pMapped;       ///< Memory-mapped view of the whole file (NULL if not mapped).
+        file_offset_t  ullMappedSize; ///< Size of the memory-mapped view in bytes.
+        uint8_t*       pOutput;       ///< Writable memory-mapped view of the file being written (see MapOutput(), NULL if not mapped).
+        file_offset_t  ullOutputSize; ///< Size of the writable memory-mapped view in bytes.
+        bool           bUnbuffered;   ///< Whether unbuffered reading was enabled by EnableUnbuffered().
+        #if HAVE_IO_URING
+        uring_t*       pUring;        ///< io_uring instance used by ReadBatch() (the ring is set up on demand).
+        #endif
+        bool           bCached;       ///< Whether the (read-only) handle is subject to the handle limit (see SetFileHandleLimit()).
+        bool           bEvicted;      ///< Whether the handle was closed by the handle cache, to be reopened on next access.
+        bool           bListed;       ///< Whether this device is currently listed in openFileHandles.
+        int            users;         ///< Amount of accesses currently in progress, the handle is not closed by the handle cache meanwhile.
+        std::list<FileIODevice*>::iterator lruPos; ///< Position in openFileHandles (only valid if bListed).
+
+        /**
+         * Keeps the handle of a device open while in scope, reopening it
+         * first if it was closed by the handle cache. Does nothing for
+         * devices which are not subject to the handle limit.
+         */
+        class handle_use_t {
+        public:
+            handle_use_t(const FileIODevice* pDevice) : pDevice(const_cast<FileIODevice*>(pDevice)) {
+                if (this->pDevice->bCached) this->pDevice->beginUse();
+            }
+            ~handle_use_t() {
+                if (pDevice->bCached) pDevice->endUse();
+            }
+        private:
+            FileIODevice* pDevice;
+        };
+        friend class handle_use_t;
+
+        bool isHandleOpen() const {
+            #if POSIX
+            return hFile != -1;
+            #elif defined(WIN32)
+            return hFile != INVALID_HANDLE_VALUE;
+            #else
+            return hFile != NULL;
+            #endif
+        }
+
+        /// Copies from @a pSource directly into the mapped output view (from the source's mapped view if available), returns the amount of bytes copied.
+        file_offset_t __copyToOutput(IODevice* pSource, file_offset_t SourceOffset, file_offset_t Offset, file_offset_t Size) {
+            FileIODevice* pSrc = dynamic_cast<FileIODevice*>(pSource);
+            if (pSrc && pSrc->pMapped && SourceOffset + Size <= pSrc->ullMappedSize) {
+                memcpy(pOutput + Offset, pSrc->pMapped + SourceOffset, (size_t) Size);
+                return Size;
+            }
+            file_offset_t ullCopied = 0;
+            while (ullCopied < Size) {
+                const file_offset_t n = pSource->ReadAt(SourceOffset + ullCopied, pOutput + Offset + ullCopied, Size - ullCopied);
+                if (!n) break;
+                ullCopied += n;
+            }
+            return ullCopied;
+        }
+
+        #if defined(__linux__)
+        /// Copies in-kernel by copy_file_range() or sendfile(), returns the amount of bytes copied.
+        file_offset_t __copyRange(FileIODevice* pSrc, file_offset_t SourceOffset, file_offset_t Offset, file_offset_t Size) {
+            file_offset_t ullCopied = 0;
+            #if HAVE_COPY_FILE_RANGE
+            // the kernel may copy in-kernel or even share the file system
+            // blocks (reflink), it refuses e.g. across file systems on
+            // older kernels, in which case sendfile() is tried
+            loff_t offIn  = (loff_t) SourceOffset;
+            loff_t offOut = (loff_t) Offset;
+            while (ullCopied < Size) {
+                const ssize_t n = copy_file_range(pSrc->hFile, &offIn, hFile, &offOut, (size_t) (Size - ullCopied), 0);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 1) break;
+                ullCopied += n;
+            }
+            #endif
+            if (ullCopied < Size && lseek(hFile, off_t(Offset + ullCopied), SEEK_SET) >= 0) {
+                off_t offIn = off_t(SourceOffset + ullCopied);
+                while (ullCopied < Size) {
+                    const ssize_t n = sendfile(hFile, pSrc->hFile, &offIn, (size_t) std::min(Size - ullCopied, (file_offset_t) 0x40000000));
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n < 1) break;
+                    ullCopied += n;
+                }
+            }
+            return ullCopied;
+        }
+        #endif
+
+        /// Opens the existing file (again) in read-only mode, returns false on error.
+        bool openReadOnly() {
+            #if POSIX
+            hFile = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+            #elif defined(WIN32)
+            // overlapped, so concurrent reads are not serialized by the handle
+            hFile = CreateFile(
+                        path.c_str(), GENERIC_READ,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE,
+                        NULL, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL |
+                        FILE_FLAG_RANDOM_ACCESS |
+                        FILE_FLAG_OVERLAPPED, NULL
+                    );
+            bOverlapped = true;
+            #else
+            hFile = fopen(path.c_str(), "rb");
+            #endif
+            return isHandleOpen();
+        }
+
+        /// Inserts this device as most recently used one into openFileHandles (fileHandleMutex must be locked).
+        void listHandle() {
+            openFileHandles.push_front(this);
+            lruPos = openFileHandles.begin();
+            bListed = true;
+            ++openFileHandleCount;
+        }
+
+        /// Removes this device from openFileHandles (fileHandleMutex must be locked).
+        void unlistHandle() {
+            if (!bListed) return;
+            openFileHandles.erase(lruPos);
+            bListed = false;
+            --openFileHandleCount;
+        }
+
+        /**
+         * Subjects the handle just opened in read-only mode to the handle
+         * limit, if one is currently set. Only read-only handles are ever
+         * closed by the handle cache.
+         */
+        void registerHandle() {
+            mutex_lock_t lock(fileHandleMutex);
+            bCached = fileHandleLimit > 0;
+            if (!bCached) return;
+            listHandle();
+            evictHandles(this);
+        }
+
+    public:
+        /**
+         * Closes the handles of the least recently used devices currently
+         * not being accessed, as long as more handles than the limit are
+         * open (fileHandleMutex must be locked).
+         *
+         * @param pKeep - device whose handle must not be closed (or NULL)
+         */
+        static void evictHandles(FileIODevice* pKeep) {
+            if (!fileHandleLimit) return;
+            std::list<FileIODevice*>::iterator it = openFileHandles.end();
+            while (openFileHandleCount > fileHandleLimit && it != openFileHandles.begin()) {
+                --it;
+                FileIODevice* pDevice = *it;
+                if (pDevice == pKeep || pDevice->users) continue;
+                it = openFileHandles.erase(it);
+                pDevice->bListed = false;
+                --openFileHandleCount;
+                pDevice->closeHandles();
+                pDevice->bEvicted = true;
+            }
+        }
+
+    private:
+        /// Called when an access begins, reopens the file if its handle was closed by the handle cache.
+        void beginUse() {
+            mutex_lock_t lock(fileHandleMutex);
+            if (bEvicted) {
+                // on error the handle stays closed and the respective
+                // access fails, the next access tries again
+                if (openReadOnly()) {
+                    bEvicted = false;
+                    if (bUnbuffered) openDirect();
+                    listHandle();
+                    evictHandles(this);
+                }
+            } else if (bListed && lruPos != openFileHandles.begin()) {
+                openFileHandles.splice(openFileHandles.begin(), openFileHandles, lruPos);
+            }
+            ++users;
+        }
+
+        /// Called when an access ends.
+        void endUse() {
+            mutex_lock_t lock(fileHandleMutex);
+            --users;
+        }
+
+        /// Opens the additional unbuffered handle, returns false if not supported.
+        bool openDirect() {
+            if (!isHandleOpen()) return false;
+            #if POSIX
+            # if defined(O_DIRECT)
+            hDirect = open(path.c_str(), O_RDONLY | O_DIRECT);
+            # elif defined(F_NOCACHE)
+            hDirect = open(path.c_str(), O_RDONLY);
+            if (hDirect != -1 && fcntl(hDirect, F_NOCACHE, 1) == -1) {
+                ::close(hDirect);
+                hDirect = -1;
+            }
+            # endif
+            #elif defined(WIN32)
+            hDirect = CreateFile(
+                          path.c_str(), GENERIC_READ,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE,
+                          NULL, OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL |
+                          FILE_FLAG_NO_BUFFERING |
+                          FILE_FLAG_OVERLAPPED, NULL
+                      );
+            #endif
+            return isDirectOpen();
+        }
+
+        bool isDirectOpen() const {
+            #if POSIX
+            return hDirect != -1;
+            #elif defined(WIN32)
+            return hDirect != INVALID_HANDLE_VALUE;
+            #else
+            return false;
+            #endif
+        }
+
+        void closeDirect() {
+            #if POSIX
+            if (hDirect != -1) ::close(hDirect);
+            hDirect = -1;
+            #elif defined(WIN32)
+            if (hDirect != INVALID_HANDLE_VALUE) CloseHandle(hDirect);
+            hDirect = INVALID_HANDLE_VALUE;
+            #endif
+        }
+
+        void close() {
+            if (bCached) {
+                mutex_lock_t lock(fileHandleMutex);
+                unlistHandle();
+                bCached = bEvicted = false;
+            }
+            closeHandles();
+        }
+
+        /// Closes the file handle and the unbuffered handle (if any).
+        void closeHandles() {
+            closeDirect();
+            #if POSIX
+            if (hFile != -1) ::close(hFile);
+            hFile = -1;
+            #elif defined(WIN32)
+            if (pIocp && hFile != INVALID_HANDLE_VALUE) {
+                mutex_lock_t lock(pIocp->mutex);
+                pIocp->drain(hFile);
+            }
+            if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+            hFile = INVALID_HANDLE_VALUE;
+            #else
+            if (hFile) fclose(hFile);
+            hFile = NULL;
+            #endif
+        }
+
+        #if HAVE_IO_URING
+        /**
+         * Performs the given batch of read requests by io_uring, setting
+         * up the ring on first use.
+         *
+         * @returns false if io_uring is not available, in which case the
+         *          caller has to perform the read requests by itself
+         */
+        bool __readBatchUring(io_request_t* pRequests, size_t Count) {
+            handle_use_t use(this);
+            if (!isHandleOpen()) return false;
+            mutex_lock_t lock(pUring->mutex);
+            if (pUring->failed) return false;
+            if (pUring->fd < 0 && !pUring->setup(64)) {
+                pUring->failed = true;
+                return false;
+            }
+            for (size_t i = 0; i < Count; ++i) pRequests[i].Result = 0;
+            const unsigned depth = pUring->entries;
+            std::vector<iovec> iov(std::min(Count, (size_t) depth));
+            std::vector<size_t> slotRequest(iov.size()); // request index of each slot
+            std::vector<size_t> freeSlots;
+            for (size_t i = iov.size(); i > 0; --i) freeSlots.push_back(i - 1);
+            size_t next = 0, inFlight = 0;
+            unsigned queued = 0;
+            while (next < Count || inFlight) {
+                // queue as many requests as there are free slots
+                for (; next < Count && !freeSlots.empty(); ++next) {
+                    io_request_t& req = pRequests[next];
+                    if (!req.Size) continue;
+                    const size_t slot = freeSlots.back();
+                    freeSlots.pop_back();
+                    iov[slot].iov_base = req.pData;
+                    iov[slot].iov_len  = (size_t) req.Size;
+                    slotRequest[slot] = next;
+                    pUring->queue(hFile, &iov[slot], req.Offset, slot);
+                    ++queued;
+                    ++inFlight;
+                }
+                if (!inFlight) break;
+                uint64_t slot;
+                int res;
+                if (!pUring->enter(queued, 1)) {
+                    // the requests submitted already still read into their
+                    // buffers, so wait for them before giving up on io_uring
+                    // (the ring still holding the unsubmitted ones is reset,
+                    // they are read synchronously below)
+                    size_t submitted = inFlight - queued;
+                    unsigned none = 0;
+                    while (submitted) {
+                        while (submitted && pUring->reap(slot, res)) {
+                            pRequests[slotRequest[slot]].Result = (res > 0) ? file_offset_t(res) : 0;
+                            --submitted;
+                        }
+                        if (submitted && !pUring->enter(none, 1)) break;
+                    }
+                    pUring->reset();
+                    pUring->failed = true;
+                    break;
+                }
+                while (pUring->reap(slot, res)) {
+                    pRequests[slotRequest[slot]].Result = (res > 0) ? file_offset_t(res) : 0;
+                    freeSlots.push_back(size_t(slot));
+                    --inFlight;
+                }
+            }
+            // complete short or failed reads synchronously
+            for (size_t i = 0; i < Count; ++i) {
+                io_request_t& req = pRequests[i];
+                if (req.Result < req.Size)
+                    req.Result += ReadAt(req.Offset + req.Result, (uint8_t*) req.pData + req.Result, req.Size - req.Result);
+            }
+            return true;
+        }
+        #endif
+
+        #if defined(WIN32)
+        /**
+         * Performs the given batch of read requests by overlapped reads
+         * collected from the file's I/O completion port, creating the port
+         * on first use. All requests are issued before waiting for any of
+         * them, so the storage device may process them concurrently.
+         *
+         * @returns false if the file is not opened in read-only mode or the
+         *          port is not available, in which case the caller has to
+         *          perform the read requests by itself
+         */
+        bool __readBatchIOCP(io_request_t* pRequests, size_t Count) {
+            handle_use_t use(this);
+            if (!isHandleOpen() || !bOverlapped) return false;
+            mutex_lock_t lock(pIocp->mutex);
+            if (!pIocp->attach(hFile)) return false;
+            pIocp->poll();
+            std::vector<OVERLAPPED> ov(Count);
+            size_t inFlight = 0;
+            for (size_t i = 0; i < Count; ++i) {
+                io_request_t& req = pRequests[i];
+                req.Result = 0;
+                if (!req.Size || req.Size > WIN32_MAX_READ_SIZE) continue; // (huge reads are done synchronously below)
+                memset(&ov[i], 0, sizeof(OVERLAPPED));
+                ov[i].Offset     = DWORD(req.Offset & 0xffffffff);
+                ov[i].OffsetHigh = DWORD(req.Offset >> 32);
+                // (also completions of reads finishing immediately are queued to the port)
+                if (ReadFile(hFile, req.pData, DWORD(req.Size), NULL, &ov[i]) || GetLastError() == ERROR_IO_PENDING)
+                    ++inFlight;
+            }
+            while (inFlight) {
+                DWORD size = 0; ULONG_PTR key; LPOVERLAPPED pOv = NULL;
+                const BOOL ok = GetQueuedCompletionStatus(pIocp->port, &size, &key, &pOv, INFINITE);
+                if (!pOv) { // port failed, pending reads cannot be collected anymore
+                    pIocp->failed = true;
+                    break;
+                }
+                if (pIocp->retire(pOv)) continue;
+                pRequests[pOv - &ov[0]].Result = (ok) ? size : 0;
+                --inFlight;
+            }
+            // complete short or failed reads synchronously
+            for (size_t i = 0; i < Count; ++i) {
+                io_request_t& req = pRequests[i];
+                if (req.Result < req.Size)
+                    req.Result += ReadAt(req.Offset + req.Result, (uint8_t*) req.pData + req.Result, req.Size - req.Result);
+            }
+            return true;
+        }
+
+        /**
+         * Issues asynchronous reads of the given range (in blocks of
+         * IOCP_PREFETCH_SIZE) for getting it into the system's file cache,
+         * without waiting for them. At most IOCP_PREFETCH_DEPTH reads are
+         * in flight per file, the rest of the range is skipped (this is
+         * only a hint).
+         */
+        void __prefetchIOCP(file_offset_t Offset, file_offset_t Size) {
+            handle_use_t use(this);
+            if (!isHandleOpen() || !bOverlapped) return;
+            mutex_lock_t lock(pIocp->mutex);
+            if (!pIocp->attach(hFile)) return;
+            if (!pIocp->pScratch) {
+                pIocp->pScratch = (uint8_t*) VirtualAlloc(NULL, IOCP_PREFETCH_SIZE, MEM_COMMIT, PAGE_READWRITE);
+                if (!pIocp->pScratch) return;
+            }
+            pIocp->poll();
+            for (int i = 0; i < IOCP_PREFETCH_DEPTH && Size; ++i) {
+                if (pIocp->busy[i]) continue;
+                const DWORD size = (DWORD) std::min(Size, (file_offset_t) IOCP_PREFETCH_SIZE);
+                OVERLAPPED& ov = pIocp->prefetch[i];
+                memset(&ov, 0, sizeof(OVERLAPPED));
+                ov.Offset     = DWORD(Offset & 0xffffffff);
+                ov.OffsetHigh = DWORD(Offset >> 32);
+                if (!ReadFile(hFile, pIocp->pScratch, size, NULL, &ov) && GetLastError() != ERROR_IO_PENDING)
+                    return; // i.e. end of file
+                pIocp->busy[i] = true;
+                ++pIocp->pending;
+                Offset += size;
+                Size   -= size;
+            }
+        }
+        #endif
+    };
+
+    /**
+     * IODevice implementation for RIFF files held in RAM. The device either
+     * reads directly from a memory region owned by the caller (read-only),
+     * or from a private copy of it, which can also be modified and resized.
+     */
+    class MemoryIODevice : public IODevice {
+    public:
+        MemoryIODevice(const void* pData, file_offset_t Size, bool bCopy) : pData((const uint8_t*) pData), ullSize(Size) {
+            if (bCopy) {
+                buffer.assign(this->pData, this->pData + Size);
+                this->pData = (buffer.empty()) ? NULL : &buffer[0];
+            }
+            bReadOnly = !bCopy;
+        }
+
+        virtual void SetMode(stream_mode_t NewMode) {
+            if (NewMode == stream_mode_read_write && bReadOnly)
+                throw Exception("Could not open memory buffer in read+write mode: buffer is read-only (not copied)");
+        }
+
+        virtual file_offset_t ReadAt(file_offset_t Offset, void* pDst, file_offset_t Size) {
+            if (Offset >= ullSize) return 0;
+            if (Size > ullSize - Offset) Size = ullSize - Offset;
+            memcpy(pDst, pData + Offset, Size);
+            return Size;
+        }
+
+        virtual file_offset_t WriteAt(file_offset_t Offset, const void* pSrc, file_offset_t Size) {
+            if (bReadOnly || !Size) return 0;
+            if (Offset + Size > ullSize) Resize(Offset + Size);
+            memcpy(&buffer[Offset], pSrc, Size);
+            return Size;
+        }
+
+        virtual file_offset_t GetSize() const {
+            return ullSize;
+        }
+
+        virtual void Resize(file_offset_t NewSize) {
+            if (bReadOnly) throw Exception("Could not resize memory buffer: buffer is read-only (not copied)");
+            if (NewSize != (file_offset_t)(size_t) NewSize)
+                throw Exception("Could not resize memory buffer: size exceeds address space");
+            buffer.resize((size_t) NewSize);
+            pData   = (buffer.empty()) ? NULL : &buffer[0];
+            ullSize = NewSize;
+        }
+
+        virtual const uint8_t* Map(file_offset_t& Size) {
+            Size = ullSize;
+            return pData;
+        }
+
+    private:
+        const uint8_t*       pData;
+        file_offset_t        ullSize;
+        bool                 bReadOnly;
+        std::vector<uint8_t> buffer; ///< Private copy of the data (only if the data was copied).
+    };
+
+    } // anonymous namespace
+
+
+
+// *************** chunk_arena_t ***************
+// *
+
+    /**
+     * Slab allocator for the Chunk and List objects of one RIFF File. Large
+     * gig files consist of tens of thousands of small chunks, so instead of
+     * one heap allocation per chunk object, chunk objects are placed
+     * consecutively into a few large slabs, which also keeps sibling chunks
+     * close to each other in memory. Released chunk objects are recycled by
+     * a free list per object size. All slabs are freed at once when the
+     * file is closed.
+     */
+    struct chunk_arena_t {
+        std::vector<uint8_t*> slabs;
+        size_t slabSize; ///< size of the most recently allocated slab (in bytes)
+        size_t slabUsed; ///< amount of bytes already used of the most recent slab
+        std::vector< std::pair<size_t, void*> > freeLists; ///< object size -> singly linked list of released objects
+
+        chunk_arena_t() : slabSize(0), slabUsed(0) {}
+
+        ~chunk_arena_t() {
+            for (size_t i = 0; i < slabs.size(); ++i) delete[] slabs[i];
+        }
+
+        void* allocate(size_t size) {
+            for (size_t i = 0; i < freeLists.size(); ++i) {
+                if (freeLists[i].first != size || !freeLists[i].second) continue;
+                void* p = freeLists[i].second;
+                freeLists[i].second = *(void**)p;
+                return p;
+            }
+            if (slabs.empty() || slabUsed + size > slabSize) {
+                // start with small slabs for small files, grow up to 1 MB
+                slabSize = slabs.empty() ? 16384 : std::min(slabSize * 2, size_t(1048576));
+                if (size > slabSize) slabSize = size;
+                slabs.push_back(new uint8_t[slabSize]);
+                slabUsed = 0;
+            }
+            void* p = slabs.back() + slabUsed;
+            slabUsed += size;
+            return p;
+        }
 
-namespace RIFF {
+        void release(void* p, size_t size) {
+            for (size_t i = 0; i < freeLists.size(); ++i) {
+                if (freeLists[i].first != size) continue;
+                *(void**)p = freeLists[i].second;
+                freeLists[i].second = p;
+                return;
+            }
+            *(void**)p = NULL;
+            freeLists.push_back(std::make_pair(size, p));
+        }
+    };
 
-// *************** Internal functions **************
+    /**
+     * Header in front of each chunk object, so the object can be returned to
+     * the arena it came from (if any) when it is deleted. Its size keeps the
+     * chunk objects aligned for any type.
+     */
+    union chunk_alloc_header_t {
+        struct {
+            chunk_arena_t* pArena;
+            size_t         size;
+        } info;
+        long double alignment;
+        uint64_t    alignment2[2];
+    };
+
+
+
+// *************** Block cache ***************
 // *
 
-    /// Returns a human readable path of the given chunk.
-    static String __resolveChunkPath(Chunk* pCk) {
-        String sPath;
-        for (Chunk* pChunk = pCk; pChunk; pChunk = pChunk->GetParent()) {
-            if (pChunk->GetChunkID() == CHUNK_ID_LIST) {
-                List* pList = (List*) pChunk;
-                sPath = "->'" + pList->GetListTypeString() + "'" + sPath;
-            } else {
-                sPath = "->'" + pChunk->GetChunkIDString() + "'" + sPath;
+    namespace {
+
+    /**
+     * Process wide cache of fixed size blocks of the files read by all
+     * RIFF::File objects (see SetBlockCacheSize()). Each class of data has
+     * its own least recently used list and size limit, so streaming sample
+     * data can't push the metadata out of the cache.
+     */
+    struct block_cache_t {
+        struct key_t {
+            uint64_t file;  ///< File::CacheID of the file the block belongs to.
+            uint64_t block; ///< File position of the block divided by BLOCK_CACHE_BLOCK_SIZE.
+            bool operator<(const key_t& other) const {
+                return (file != other.file) ? file < other.file : block < other.block;
+            }
+        };
+        struct entry_t {
+            std::vector<uint8_t> data; ///< Shorter than a block only at the end of the file.
+            cache_class_t cls;
+            std::list<key_t>::iterator lruPos;
+        };
+
+        volatile long enabled[2]; ///< Non zero if the respective class is cached (capacity not 0), read without locking the mutex.
+        mutex_t mutex; ///< Guards all members below.
+        std::map<key_t,entry_t> blocks;
+        std::list<key_t> lru[2]; ///< Blocks of each class, most recently used first.
+        size_t         capacity[2];
+        size_t         used[2];
+        cache_policy_t policy[2];
+        block_cache_statistics_t stats[2];
+        uint64_t       nextFileID;
+
+        block_cache_t() : nextFileID(1) {
+            for (int i = 0; i < 2; ++i) {
+                enabled[i]  = 0;
+                capacity[i] = used[i] = 0;
+                memset(&stats[i], 0, sizeof(stats[i]));
             }
+            policy[cache_class_metadata]    = cache_policy_all;
+            policy[cache_class_sample_data] = cache_policy_small_reads;
         }
-        return sPath;
+
+        /// Whether a read of @a Size bytes of class @a cls goes through the cache (caller must lock).
+        bool uses(cache_class_t cls, file_offset_t Size) const {
+            if (!capacity[cls]) return false;
+            switch (policy[cls]) {
+                case cache_policy_all:         return true;
+                case cache_policy_small_reads: return Size < BLOCK_CACHE_BLOCK_SIZE;
+                default:                       return false;
+            }
+        }
+
+        /**
+         * Copies @a Size bytes from position @a Offset of the cached block
+         * (caller must lock).
+         *
+         * @returns amount of bytes copied (less than @a Size at the end of
+         *          the file), -1 if the block is not cached
+         */
+        int64_t get(const key_t& key, file_offset_t Offset, uint8_t* pDst, file_offset_t Size) {
+            std::map<key_t,entry_t>::iterator it = blocks.find(key);
+            if (it == blocks.end()) return -1;
+            entry_t& e = it->second;
+            lru[e.cls].splice(lru[e.cls].begin(), lru[e.cls], e.lruPos);
+            stats[e.cls].Hits++;
+            if (Offset >= e.data.size()) return 0;
+            if (Size > e.data.size() - Offset) Size = e.data.size() - Offset;
+            memcpy(pDst, &e.data[Offset], Size);
+            return Size;
+        }
+
+        /// Adds a block to the cache, evicting least recently used blocks of the same class if necessary (caller must lock).
+        void put(const key_t& key, cache_class_t cls, const uint8_t* pData, size_t Size) {
+            if (Size > capacity[cls] || blocks.count(key)) return;
+            while (used[cls] + Size > capacity[cls]) {
+                erase(lru[cls].back());
+                stats[cls].Evictions++;
+            }
+            entry_t& e = blocks[key];
+            e.data.assign(pData, pData + Size);
+            e.cls = cls;
+            lru[cls].push_front(key);
+            e.lruPos = lru[cls].begin();
+            used[cls] += Size;
+        }
+
+        void erase(const key_t& key) {
+            std::map<key_t,entry_t>::iterator it = blocks.find(key);
+            if (it == blocks.end()) return;
+            used[it->second.cls] -= it->second.data.size();
+            lru[it->second.cls].erase(it->second.lruPos);
+            blocks.erase(it);
+        }
+
+        /// Drops all blocks of the given file (caller must lock).
+        void drop(uint64_t file) {
+            const key_t first = { file, 0 };
+            std::map<key_t,entry_t>::iterator it = blocks.lower_bound(first);
+            while (it != blocks.end() && it->first.file == file) {
+                used[it->second.cls] -= it->second.data.size();
+                lru[it->second.cls].erase(it->second.lruPos);
+                blocks.erase(it++);
+            }
+        }
+
+        void shrink(cache_class_t cls) {
+            while (used[cls] > capacity[cls]) {
+                erase(lru[cls].back());
+                stats[cls].Evictions++;
+            }
+        }
+    };
+
+    static block_cache_t blockCache;
+
+    /// Returns a new, unique File::CacheID.
+    static uint64_t newBlockCacheID() {
+        mutex_lock_t lock(blockCache.mutex);
+        return blockCache.nextFileID++;
     }
 
+    } // anonymous namespace
+
 
 
 // *************** progress_t ***************
@@ -59,9 +1759,30 @@ namespace RIFF {
 
     progress_t::progress_t() {
         callback    = NULL;
+        factor      = 0.0f;
         custom      = NULL;
+        cancel      = false;
         __range_min = 0.0f;
         __range_max = 1.0f;
+        __parent    = NULL;
+    }
+
+    tracer_t::tracer_t() {
+        callback = NULL;
+        custom   = NULL;
+    }
+
+    allocator_t::allocator_t() {
+        allocate         = NULL;
+        deallocate       = NULL;
+        allocate_on_node = NULL;
+        custom           = NULL;
+    }
+
+    executor_t::executor_t() {
+        execute     = NULL;
+        concurrency = NULL;
+        custom      = NULL;
     }
 
 
@@ -76,9 +1797,13 @@ namespace RIFF {
         ullPos     = 0;
         pParent    = NULL;
         pChunkData = NULL;
+        pReadAhead = NULL;
         ullCurrentChunkSize = 0;
         ullNewChunkSize = 0;
         ullChunkDataSize = 0;
+        ullStoredHash = 0;
+        bHashValid = false;
+        bModified  = false;
         ChunkID    = CHUNK_ID_RIFF;
         this->pFile = pFile;
     }
@@ -92,9 +1817,13 @@ namespace RIFF {
         pParent       = Parent;
         ullPos        = 0;
         pChunkData    = NULL;
+        pReadAhead    = NULL;
         ullCurrentChunkSize = 0;
         ullNewChunkSize = 0;
         ullChunkDataSize = 0;
+        ullStoredHash = 0;
+        bHashValid    = false;
+        bModified     = false;
         ReadHeader(StartPos);
     }
 
@@ -104,14 +1833,19 @@ namespace RIFF {
         this->pParent    = pParent;
         ullPos           = 0;
         pChunkData       = NULL;
+        pReadAhead       = NULL;
         ChunkID          = uiChunkID;
         ullChunkDataSize = 0;
         ullCurrentChunkSize = 0;
         ullNewChunkSize  = ullBodySize;
+        ullStoredHash    = 0;
+        bHashValid       = false;
+        bModified        = true; // not stored in the file yet
     }
 
     Chunk::~Chunk() {
         if (pChunkData) delete[] pChunkData;
+        if (pReadAhead) delete[] pReadAhead;
     }
 
     void Chunk::ReadHeader(file_offset_t filePos) {
@@ -120,22 +1854,11 @@ namespace RIFF {
         #endif // DEBUG_RIFF
         ChunkID = 0;
         ullNewChunkSize = ullCurrentChunkSize = 0;
-        #if POSIX
-        if (lseek(pFile->hFileRead, filePos, SEEK_SET) != -1) {
-            read(pFile->hFileRead, &ChunkID, 4);
-            read(pFile->hFileRead, &ullCurrentChunkSize, pFile->FileOffsetSize);
-        #elif defined(WIN32)
-        LARGE_INTEGER liFilePos;
-        liFilePos.QuadPart = filePos;
-        if (SetFilePointerEx(pFile->hFileRead, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN)) {
-            DWORD dwBytesRead;
-            ReadFile(pFile->hFileRead, &ChunkID, 4, &dwBytesRead, NULL);
-            ReadFile(pFile->hFileRead, &ullCurrentChunkSize, pFile->FileOffsetSize, &dwBytesRead, NULL);
-        #else
-        if (!fseeko(pFile->hFileRead, filePos, SEEK_SET)) {
-            fread(&ChunkID, 4, 1, pFile->hFileRead);
-            fread(&ullCurrentChunkSize, pFile->FileOffsetSize, 1, pFile->hFileRead);
-        #endif // POSIX
+        uint8_t header[CHUNK_HEADER_SIZE(8)];
+        const file_offset_t headerSize = CHUNK_HEADER_SIZE(pFile->FileOffsetSize);
+        if (pFile->__readHeaderData(filePos, header, headerSize) == headerSize) {
+            memcpy(&ChunkID, &header[0], 4);
+            memcpy(&ullCurrentChunkSize, &header[4], pFile->FileOffsetSize);
             #if WORDS_BIGENDIAN
             if (ChunkID == CHUNK_ID_RIFF) {
                 pFile->bEndianNative = false;
@@ -180,25 +1903,8 @@ namespace RIFF {
                 swapBytes_64(&ullNewChunkSize);
         }
 
-        #if POSIX
-        if (lseek(pFile->hFileWrite, filePos, SEEK_SET) != -1) {
-            write(pFile->hFileWrite, &uiNewChunkID, 4);
-            write(pFile->hFileWrite, &ullNewChunkSize, pFile->FileOffsetSize);
-        }
-        #elif defined(WIN32)
-        LARGE_INTEGER liFilePos;
-        liFilePos.QuadPart = filePos;
-        if (SetFilePointerEx(pFile->hFileWrite, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN)) {
-            DWORD dwBytesWritten;
-            WriteFile(pFile->hFileWrite, &uiNewChunkID, 4, &dwBytesWritten, NULL);
-            WriteFile(pFile->hFileWrite, &ullNewChunkSize, pFile->FileOffsetSize, &dwBytesWritten, NULL);
-        }
-        #else
-        if (!fseeko(pFile->hFileWrite, filePos, SEEK_SET)) {
-            fwrite(&uiNewChunkID, 4, 1, pFile->hFileWrite);
-            fwrite(&ullNewChunkSize, pFile->FileOffsetSize, 1, pFile->hFileWrite);
-        }
-        #endif // POSIX
+        pFile->__deviceWrite(filePos, &uiNewChunkID, 4);
+        pFile->__deviceWrite(filePos + 4, &ullNewChunkSize, pFile->FileOffsetSize);
     }
 
     /**
@@ -240,6 +1946,10 @@ namespace RIFF {
                 break;
         }
         if (ullPos > ullCurrentChunkSize) ullPos = ullCurrentChunkSize;
+        if (Whence != stream_curpos) {
+            STATISTICS_ADD(pFile->Statistics.SeekCalls, 1);
+            if (pFile->pTracer) __trace(pFile->pTracer, trace_seek, this, ullPos);
+        }
         return ullPos;
     }
 
@@ -288,14 +1998,7 @@ namespace RIFF {
         #if DEBUG_RIFF
         std::cout << "Chunk::GetState()" << std::endl;
         #endif // DEBUG_RIFF
-        #if POSIX
-        if (pFile->hFileRead == 0) return stream_closed;
-        #elif defined (WIN32)
-        if (pFile->hFileRead == INVALID_HANDLE_VALUE)
-            return stream_closed;
-        #else
-        if (pFile->hFileRead == NULL) return stream_closed;
-        #endif // POSIX
+        if (!pFile->pDevice->IsOpen()) return stream_closed;
         if (ullPos < ullCurrentChunkSize) return stream_ready;
         else                              return stream_end_reached;
     }
@@ -309,6 +2012,11 @@ namespace RIFF {
      *  a system). The position within the chunk will automatically be
      *  incremented.
      *
+     *  The data is read by ReadAt(), so reading from different Chunk
+     *  objects concurrently by different threads is safe. Each Chunk object
+     *  has its own read position though, so the same Chunk object must not
+     *  be read by this method concurrently.
+     *
      *  @param pData      destination buffer
      *  @param WordCount  number of data words to read
      *  @param WordSize   size of each data word to read
@@ -320,55 +2028,189 @@ namespace RIFF {
         std::cout << "Chunk::Read(void*,file_offset_t,file_offset_t)" << std::endl;
         #endif // DEBUG_RIFF
         //if (ulStartPos == 0) return 0; // is only 0 if this is a new chunk, so nothing to read (yet)
-        if (ullPos >= ullCurrentChunkSize) return 0;
-        if (ullPos + WordCount * WordSize >= ullCurrentChunkSize) WordCount = (ullCurrentChunkSize - ullPos) / WordSize;
-        #if POSIX
-        if (lseek(pFile->hFileRead, ullStartPos + ullPos, SEEK_SET) < 0) return 0;
-        ssize_t readWords = read(pFile->hFileRead, pData, WordCount * WordSize);
-        if (readWords < 1) {
-            #if DEBUG_RIFF
-            std::cerr << "POSIX read() failed: " << strerror(errno) << std::endl << std::flush;
-            #endif // DEBUG_RIFF
-            return 0;
-        }
-        readWords /= WordSize;
-        #elif defined(WIN32)
-        LARGE_INTEGER liFilePos;
-        liFilePos.QuadPart = ullStartPos + ullPos;
-        if (!SetFilePointerEx(pFile->hFileRead, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN))
-            return 0;
-        DWORD readWords;
-        ReadFile(pFile->hFileRead, pData, WordCount * WordSize, &readWords, NULL); //FIXME: does not work for reading buffers larger than 2GB (even though this should rarely be the case in practice)
-        if (readWords < 1) return 0;
-        readWords /= WordSize;
-        #else // standard C functions
-        if (fseeko(pFile->hFileRead, ullStartPos + ullPos, SEEK_SET)) return 0;
-        file_offset_t readWords = fread(pData, WordSize, WordCount, pFile->hFileRead);
-        #endif // POSIX
-        if (!pFile->bEndianNative && WordSize != 1) {
-            switch (WordSize) {
-                case 2:
-                    for (file_offset_t iWord = 0; iWord < readWords; iWord++)
-                        swapBytes_16((uint16_t*) pData + iWord);
-                    break;
-                case 4:
-                    for (file_offset_t iWord = 0; iWord < readWords; iWord++)
-                        swapBytes_32((uint32_t*) pData + iWord);
-                    break;
-                case 8:
-                    for (file_offset_t iWord = 0; iWord < readWords; iWord++)
-                        swapBytes_64((uint64_t*) pData + iWord);
-                    break;
-                default:
-                    for (file_offset_t iWord = 0; iWord < readWords; iWord++)
-                        swapBytes((uint8_t*) pData + iWord * WordSize, WordSize);
-                    break;
-            }
+        if (ullPos >= ullCurrentChunkSize || !WordSize) return 0;
+        file_offset_t readWords;
+        const bool bBuffered = pReadAhead;
+        if (WordCount * WordSize < ullCurrentChunkSize && __loadReadAhead()) {
+            // small read from a small chunk: serve from the chunk's read-ahead buffer
+            if (bBuffered) STATISTICS_ADD(pFile->Statistics.CacheHits, 1);
+            else           STATISTICS_ADD(pFile->Statistics.CacheMisses, 1);
+            if (ullPos + WordCount * WordSize > ullCurrentChunkSize)
+                WordCount = (ullCurrentChunkSize - ullPos) / WordSize;
+            memcpy(pData, &pReadAhead[ullPos], WordCount * WordSize);
+            if (!pFile->bEndianNative && WordSize != 1)
+                __swapWords(pData, WordCount, WordSize);
+            readWords = WordCount;
+        } else {
+            readWords = ReadAt(ullPos, pData, WordCount, WordSize);
         }
         SetPos(readWords * WordSize, stream_curpos);
+        if (ullPos >= ullCurrentChunkSize) __releaseReadAhead(); // chunk completely parsed
+        return readWords;
+    }
+
+    /**
+     * Reads the whole body of this chunk by one single I/O operation into
+     * the chunk's read-ahead buffer, if the chunk is small enough. Chunks
+     * like 3ewa, rgnh or insh are parsed field by field with ReadInt32()
+     * and friends, which would otherwise cost one I/O operation per field.
+     * Files served from memory (memory-mapped) do not need this.
+     *
+     * @param bAnySize - load the chunk regardless of its size (see
+     *                   PrepareSequentialRead())
+     * @returns true if the read-ahead buffer is available
+     */
+    bool Chunk::__loadReadAhead(bool bAnySize) {
+        if (pReadAhead) return true;
+        if (pFile->pMappedData || !ullCurrentChunkSize) return false;
+        if (ullCurrentChunkSize > CHUNK_READ_AHEAD_SIZE && !bAnySize) return false;
+        if (!pFile->pDevice->IsOpen()) return false;
+        uint8_t* pBuffer = new uint8_t[ullCurrentChunkSize];
+        const bool bGuarded = pFile->__beginRead();
+        file_offset_t n;
+        try {
+            n = pFile->__cachedRead(ullStartPos, pBuffer, ullCurrentChunkSize, __cacheClass());
+        } catch (...) {
+            if (bGuarded) pFile->__endRead();
+            delete[] pBuffer;
+            throw;
+        }
+        if (bGuarded) pFile->__endRead();
+        if (n != ullCurrentChunkSize) {
+            delete[] pBuffer;
+            return false;
+        }
+        pReadAhead = pBuffer;
+        return true;
+    }
+
+    /**
+     * Announces that the chunk's body is going to be parsed field by field
+     * up to its end by small Read() calls (e.g. ReadInt16()). The whole
+     * body is then read by one single I/O operation into the chunk's
+     * read-ahead buffer (which is done automatically for small chunks
+     * only), so that those calls are served from memory. The buffer is
+     * freed as soon as the chunk's end has been read.
+     *
+     * @returns true if the chunk's body is now buffered (false if that is
+     *          not needed, e.g. because the file is memory-mapped, or
+     *          could not be done)
+     */
+    bool Chunk::PrepareSequentialRead() {
+        if (ullPos >= ullCurrentChunkSize) return false;
+        return __loadReadAhead(true);
+    }
+
+    /// Frees the chunk's read-ahead buffer (if any).
+    void Chunk::__releaseReadAhead() {
+        if (pReadAhead) {
+            delete[] pReadAhead;
+            pReadAhead = NULL;
+        }
+    }
+
+    /**
+     *  Reads \a WordCount number of data words with given \a WordSize from
+     *  the chunk body position \a Pos and copies it into a buffer pointed
+     *  by \a pData. In contrast to Read() this method neither uses nor
+     *  modifies the chunk's current read position (see GetPos()), nor the
+     *  file position of the underlying file handle, as it uses pread() on
+     *  POSIX systems and ReadFile() with an explicit OVERLAPPED file offset
+     *  on Windows systems. Therefore this method may safely be called
+     *  concurrently by multiple threads, even on the same Chunk object, as
+     *  long as the file is not modified and its access mode is not changed
+     *  at the same time. Endian correction is applied like with Read().
+     *
+     *  Note: when libgig is compiled with standard C file functions only
+     *  (neither POSIX nor Windows), this method is not thread safe.
+     *
+     *  @param Pos        position within the chunk body (in bytes) where
+     *                    reading shall start from
+     *  @param pData      destination buffer
+     *  @param WordCount  number of data words to read
+     *  @param WordSize   size of each data word to read
+     *  @returns          number of successfully read data words or 0 if end
+     *                    of chunk reached or error occurred
+     */
+    file_offset_t Chunk::ReadAt(file_offset_t Pos, void* pData, file_offset_t WordCount, file_offset_t WordSize) const {
+        #if DEBUG_RIFF
+        std::cout << "Chunk::ReadAt(file_offset_t,void*,file_offset_t,file_offset_t)" << std::endl;
+        #endif // DEBUG_RIFF
+        return __readAt(Pos, pData, WordCount, WordSize, false);
+    }
+
+    /**
+     *  Same as ReadAt(), but the data is read without the operating
+     *  system's page cache if that was enabled for the file by
+     *  File::SetUnbuffered(). This is meant for streaming large amounts of
+     *  data (i.e. sample data) into buffers managed by the application
+     *  itself, which would otherwise occupy the same amount of memory once
+     *  more in the page cache. The alignment required by the operating
+     *  system for unbuffered I/O is handled internally, so \a Pos,
+     *  \a pData and \a WordCount may be arbitrary; the data is read
+     *  directly into \a pData if it happens to be suitably aligned for
+     *  the requested file position, otherwise through an intermediate
+     *  aligned buffer. If unbuffered reading is not enabled (or the file
+     *  is memory-mapped), this method behaves exactly like ReadAt().
+     *
+     *  @param Pos        position within the chunk body (in bytes) where
+     *                    reading shall start from
+     *  @param pData      destination buffer
+     *  @param WordCount  number of data words to read
+     *  @param WordSize   size of each data word to read
+     *  @returns          number of successfully read data words or 0 if end
+     *                    of chunk reached or error occurred
+     *  @see File::SetUnbuffered()
+     */
+    file_offset_t Chunk::ReadUnbufferedAt(file_offset_t Pos, void* pData, file_offset_t WordCount, file_offset_t WordSize) const {
+        return __readAt(Pos, pData, WordCount, WordSize, pFile->UnbufferedAlignment);
+    }
+
+    /// Reads from the file like __readAt(), but without endian correction (caller must use File::__beginRead()).
+    file_offset_t Chunk::__readRaw(file_offset_t Pos, void* pData, file_offset_t WordCount, file_offset_t WordSize, bool bUnbuffered) const {
+        if (Pos >= ullCurrentChunkSize || !WordSize) return 0;
+        if (Pos + WordCount * WordSize >= ullCurrentChunkSize) WordCount = (ullCurrentChunkSize - Pos) / WordSize;
+        if (!WordCount) return 0;
+        const file_offset_t ullFilePos = ullStartPos + Pos;
+        if (pFile->pMappedData) { // serve directly from the memory-mapped file
+            if (ullFilePos >= pFile->ullMappedSize) return 0;
+            file_offset_t ullBytes = WordCount * WordSize;
+            if (ullFilePos + ullBytes > pFile->ullMappedSize)
+                ullBytes = pFile->ullMappedSize - ullFilePos;
+            memcpy(pData, &pFile->pMappedData[ullFilePos], ullBytes);
+            STATISTICS_ADD(pFile->Statistics.BytesMapped, ullBytes);
+            return ullBytes / WordSize;
+        } else if (bUnbuffered) {
+            return pFile->__deviceReadUnbuffered(ullFilePos, pData, WordCount * WordSize) / WordSize;
+        } else {
+            return pFile->__cachedRead(ullFilePos, pData, WordCount * WordSize, __cacheClass()) / WordSize;
+        }
+    }
+
+    /// Common implementation of ReadAt() and ReadUnbufferedAt().
+    file_offset_t Chunk::__readAt(file_offset_t Pos, void* pData, file_offset_t WordCount, file_offset_t WordSize, bool bUnbuffered) const {
+        // (position, size and device must be consistent while being used,
+        // even if the file is saved concurrently, see File::SetSaveMode())
+        const bool bGuarded = pFile->__beginRead();
+        file_offset_t readWords;
+        try {
+            readWords = __readRaw(Pos, pData, WordCount, WordSize, bUnbuffered);
+        } catch (...) {
+            if (bGuarded) pFile->__endRead();
+            throw;
+        }
+        if (bGuarded) pFile->__endRead();
+        if (!pFile->bEndianNative && WordSize != 1)
+            __swapWords(pData, readWords, WordSize);
         return readWords;
     }
 
+    /// Returns the class of this chunk's body data for the block cache.
+    cache_class_t Chunk::__cacheClass() const {
+        return (ChunkID == CHUNK_ID_SAMPLE_DATA || ChunkID == CHUNK_ID_SMPL) ?
+                cache_class_sample_data : cache_class_metadata;
+    }
+
     /**
      *  Writes \a WordCount number of data words with given \a WordSize from
      *  the buffer pointed by \a pData. Be sure to provide the correct
@@ -390,52 +2232,13 @@ namespace RIFF {
             throw Exception("Cannot write data to chunk, file has to be opened in read+write mode first");
         if (ullPos >= ullCurrentChunkSize || ullPos + WordCount * WordSize > ullCurrentChunkSize)
             throw Exception("End of chunk reached while trying to write data");
-        if (!pFile->bEndianNative && WordSize != 1) {
-            switch (WordSize) {
-                case 2:
-                    for (file_offset_t iWord = 0; iWord < WordCount; iWord++)
-                        swapBytes_16((uint16_t*) pData + iWord);
-                    break;
-                case 4:
-                    for (file_offset_t iWord = 0; iWord < WordCount; iWord++)
-                        swapBytes_32((uint32_t*) pData + iWord);
-                    break;
-                case 8:
-                    for (file_offset_t iWord = 0; iWord < WordCount; iWord++)
-                        swapBytes_64((uint64_t*) pData + iWord);
-                    break;
-                default:
-                    for (file_offset_t iWord = 0; iWord < WordCount; iWord++)
-                        swapBytes((uint8_t*) pData + iWord * WordSize, WordSize);
-                    break;
-            }
-        }
-        #if POSIX
-        if (lseek(pFile->hFileWrite, ullStartPos + ullPos, SEEK_SET) < 0) {
-            throw Exception("Could not seek to position " + ToString(ullPos) +
-                            " in chunk (" + ToString(ullStartPos + ullPos) + " in file)");
-        }
-        ssize_t writtenWords = write(pFile->hFileWrite, pData, WordCount * WordSize);
-        if (writtenWords < 1) throw Exception("POSIX IO Error while trying to write chunk data");
-        writtenWords /= WordSize;
-        #elif defined(WIN32)
-        LARGE_INTEGER liFilePos;
-        liFilePos.QuadPart = ullStartPos + ullPos;
-        if (!SetFilePointerEx(pFile->hFileWrite, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN)) {
-            throw Exception("Could not seek to position " + ToString(ullPos) +
-                            " in chunk (" + ToString(ullStartPos + ullPos) + " in file)");
-        }
-        DWORD writtenWords;
-        WriteFile(pFile->hFileWrite, pData, WordCount * WordSize, &writtenWords, NULL); //FIXME: does not work for writing buffers larger than 2GB (even though this should rarely be the case in practice)
-        if (writtenWords < 1) throw Exception("Windows IO Error while trying to write chunk data");
-        writtenWords /= WordSize;
-        #else // standard C functions
-        if (fseeko(pFile->hFileWrite, ullStartPos + ullPos, SEEK_SET)) {
-            throw Exception("Could not seek to position " + ToString(ullPos) +
-                            " in chunk (" + ToString(ullStartPos + ullPos) + " in file)");
-        }
-        file_offset_t writtenWords = fwrite(pData, WordSize, WordCount, pFile->hFileWrite);
-        #endif // POSIX
+        __releaseReadAhead();
+        bModified = true;
+        if (!pFile->bEndianNative && WordSize != 1)
+            __swapWords(pData, WordCount, WordSize);
+        const file_offset_t writtenBytes = pFile->__deviceWrite(ullStartPos + ullPos, pData, WordCount * WordSize);
+        if (writtenBytes < 1) throw Exception("IO Error while trying to write chunk data");
+        const file_offset_t writtenWords = writtenBytes / WordSize;
         SetPos(writtenWords * WordSize, stream_curpos);
         return writtenWords;
     }
@@ -807,33 +2610,29 @@ namespace RIFF {
      * @see ReleaseChunkData()
      */
     void* Chunk::LoadChunkData() {
-        if (!pChunkData && pFile->Filename != "" /*&& ulStartPos != 0*/) {
-            #if POSIX
-            if (lseek(pFile->hFileRead, ullStartPos, SEEK_SET) == -1) return NULL;
-            #elif defined(WIN32)
-            LARGE_INTEGER liFilePos;
-            liFilePos.QuadPart = ullStartPos;
-            if (!SetFilePointerEx(pFile->hFileRead, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN)) return NULL;
-            #else
-            if (fseeko(pFile->hFileRead, ullStartPos, SEEK_SET)) return NULL;
-            #endif // POSIX
+        if (!pChunkData && pFile->pDevice->IsOpen() /*&& ulStartPos != 0*/) {
             file_offset_t ullBufferSize = (ullCurrentChunkSize > ullNewChunkSize) ? ullCurrentChunkSize : ullNewChunkSize;
             pChunkData = new uint8_t[ullBufferSize];
             if (!pChunkData) return NULL;
             memset(pChunkData, 0, ullBufferSize);
-            #if POSIX
-            file_offset_t readWords = read(pFile->hFileRead, pChunkData, GetSize());
-            #elif defined(WIN32)
-            DWORD readWords;
-            ReadFile(pFile->hFileRead, pChunkData, GetSize(), &readWords, NULL); //FIXME: won't load chunks larger than 2GB !
-            #else
-            file_offset_t readWords = fread(pChunkData, 1, GetSize(), pFile->hFileRead);
-            #endif // POSIX
+            file_offset_t readWords = 0;
+            if (pFile->pMappedData) { // copy directly from the memory-mapped file
+                if (ullStartPos + GetSize() <= pFile->ullMappedSize) {
+                    memcpy(pChunkData, &pFile->pMappedData[ullStartPos], GetSize());
+                    STATISTICS_ADD(pFile->Statistics.BytesMapped, GetSize());
+                    readWords = GetSize();
+                }
+            } else {
+                readWords = pFile->__cachedRead(ullStartPos, pChunkData, GetSize(), __cacheClass());
+            }
             if (readWords != GetSize()) {
                 delete[] pChunkData;
                 return (pChunkData = NULL);
             }
             ullChunkDataSize = ullBufferSize;
+            // remember the data as stored, to be able to skip rewriting it on Save()
+            ullStoredHash = __hashChunkData(pChunkData, GetSize());
+            bHashValid    = true;
         } else if (ullNewChunkSize > ullChunkDataSize) {
             uint8_t* pNewBuffer = new uint8_t[ullNewChunkSize];
             if (!pNewBuffer) throw Exception("Could not enlarge chunk data buffer to " + ToString(ullNewChunkSize) + " bytes");
@@ -846,6 +2645,49 @@ namespace RIFF {
         return pChunkData;
     }
 
+    /** @brief Direct access to chunk body in memory-mapped file.
+     *
+     * If the file is currently memory-mapped (see File::SetIOBackend()),
+     * this method returns a pointer to the beginning of this chunk's body
+     * within the mapped view of the file, without allocating or copying
+     * anything. The returned data is read-only and reflects the raw data
+     * as it is currently stored in the file, so it is only valid as long as
+     * the file stays memory-mapped, that is until the file is closed or
+     * switched to read/write mode (i.e. by File::Save()).
+     *
+     * Since no endian correction can be applied to the mapped data, NULL is
+     * returned if the data shall be interpreted as words larger than one
+     * byte, but the file's byte order differs from the native byte order of
+     * this system.
+     *
+     * @param WordSize - size of each data word the caller is going to
+     *                   interpret the data as (in bytes)
+     * @returns pointer to the mapped chunk body or NULL if the file is not
+     *          memory-mapped (or chunk data would require endian correction)
+     */
+    const void* Chunk::GetMappedData(file_offset_t WordSize) const {
+        if (!pFile->pMappedData || !ullCurrentChunkSize) return NULL;
+        if (WordSize > 1 && !pFile->bEndianNative) return NULL;
+        if (ullStartPos + ullCurrentChunkSize > pFile->ullMappedSize) return NULL;
+        return &pFile->pMappedData[ullStartPos];
+    }
+
+    /** @brief Hint about the access pattern of a range of the chunk body.
+     *
+     * Same as File::Advise(), but for the given range of this chunk's
+     * body (clipped to the chunk's size).
+     *
+     * @param Pos    - position within the chunk body (in bytes)
+     * @param Size   - size of the range (in bytes), 0 for the rest of the
+     *                 chunk body
+     * @param Advice - expected access pattern of the range
+     */
+    void Chunk::Advise(file_offset_t Pos, file_offset_t Size, advice_t Advice) const {
+        if (Pos >= ullCurrentChunkSize) return;
+        if (!Size || Size > ullCurrentChunkSize - Pos) Size = ullCurrentChunkSize - Pos;
+        pFile->Advise(ullStartPos + Pos, Size, Advice);
+    }
+
     /** @brief Free loaded chunk body from RAM.
      *
      * Frees loaded chunk body data from memory (RAM). You should call
@@ -857,6 +2699,27 @@ namespace RIFF {
             delete[] pChunkData;
             pChunkData = NULL;
         }
+        bHashValid = false;
+    }
+
+    /**
+     * Returns the amount of heap memory (in bytes) occupied by this chunk
+     * object and by its chunk data currently held in RAM (i.e. loaded by
+     * LoadChunkData() or buffered for small reads). List chunks include
+     * all their sub chunks loaded so far.
+     *
+     * @see File::GetMemoryUsage()
+     */
+    size_t Chunk::GetMemoryUsage() const {
+        return sizeof(Chunk) + __bufferMemoryUsage();
+    }
+
+    /// Returns the size of the chunk data buffers currently allocated by this chunk.
+    size_t Chunk::__bufferMemoryUsage() const {
+        size_t size = 0;
+        if (pChunkData) size += (size_t) ullChunkDataSize;
+        if (pReadAhead) size += (size_t) ullCurrentChunkSize;
+        return size;
     }
 
     /** @brief Resize chunk.
@@ -884,114 +2747,302 @@ namespace RIFF {
             throw Exception("Unrealistic high chunk size detected: " + __resolveChunkPath(this));
         if (ullNewChunkSize == NewSize) return;
         ullNewChunkSize = NewSize;
+        bModified = true;
+        if (pParent) pParent->__invalidateRequiredSize();
+    }
+
+    /** @brief Copy the data body of another chunk to this chunk.
+     *
+     * Overwrites the beginning of this chunk's data body directly in the
+     * "physical" file by the data body of chunk @a pSource, which may as
+     * well be a chunk of another (open) file. The data is copied verbatim,
+     * that is without any endian correction. This is intended for copying
+     * large chunks (i.e. sample data) from one file to another: on Linux
+     * the data is copied by copy_file_range() if possible, which lets the
+     * kernel copy (or even share) the file system blocks without passing
+     * the data through user space, otherwise the data is copied in large
+     * blocks by position independent reads and writes. Neither this
+     * chunk's nor @a pSource's current position (see GetPos()) is modified.
+     *
+     * If the data of @a pSource was loaded into RAM with LoadChunkData(),
+     * the data in RAM (with its new size) is copied instead.
+     *
+     * Like Write(), this method requires this chunk to be large enough
+     * already, so call Resize() and File::Save() before if necessary.
+     *
+     * @param pSource   - chunk whose data body shall be copied
+     * @param pProgress - optional: callback function for progress notification
+     * @returns amount of bytes copied
+     * @throws RIFF::Exception if this file is not opened in read+write
+     *                         mode, this chunk is too small or any IO error
+     *                         occurred
+     * @see Write(), Resize()
+     */
+    file_offset_t Chunk::CopyDataFrom(const Chunk* pSource, progress_t* pProgress) {
+        if (pFile->Mode != stream_mode_read_write)
+            throw Exception("Cannot copy data to chunk, file has to be opened in read+write mode first");
+        if (pSource == this) return ullCurrentChunkSize;
+        const file_offset_t ullSize = (pSource->pChunkData) ? pSource->ullNewChunkSize
+                                                            : pSource->ullCurrentChunkSize;
+        if (ullSize > ullCurrentChunkSize)
+            throw Exception("Cannot copy data to chunk, chunk is too small");
+        __releaseReadAhead();
+        bModified = true;
+        file_offset_t ullCopied = 0;
+        if (pSource->pChunkData) {
+            ullCopied = pFile->__deviceWrite(ullStartPos, pSource->pChunkData, ullSize);
+            if (ullCopied != ullSize) throw Exception("IO Error while trying to copy chunk data");
+        } else if (ullSize) {
+            ullCopied = pFile->__deviceCopy(pSource->pFile, pSource->ullStartPos, ullStartPos, ullSize);
+            if (ullCopied < ullSize) { // copy the rest through a buffer
+                const file_offset_t ullBufferSize =
+                    (ullSize - ullCopied < SAVE_COPY_BUFFER_SIZE) ? ullSize - ullCopied : SAVE_COPY_BUFFER_SIZE;
+                std::vector<uint8_t> buf((size_t) ullBufferSize);
+                while (ullCopied < ullSize) {
+                    const file_offset_t n = (ullSize - ullCopied < ullBufferSize) ? ullSize - ullCopied : ullBufferSize;
+                    if (pSource->ReadAt(ullCopied, &buf[0], n, 1) != n)
+                        throw Exception("Could not read chunk data to be copied");
+                    if (pFile->__deviceWrite(ullStartPos + ullCopied, &buf[0], n) != n)
+                        throw Exception("IO Error while trying to copy chunk data");
+                    ullCopied += n;
+                    __notify_progress(pProgress, float(ullCopied) / float(ullSize));
+                }
+            }
+        }
+        __notify_progress(pProgress, 1.0); // notify done
+        return ullCopied;
+    }
+
+    /** @brief Write chunk persistently e.g. to disk.
+     *
+     * Stores the chunk persistently to its actual "physical" file.
+     *
+     * @param ullWritePos - position within the "physical" file where this
+     *                     chunk should be written to
+     * @param ullCurrentDataOffset - offset of current (old) data within
+     *                              the file
+     * @param pProgress - optional: callback function for progress notification
+     * @returns new write position in the "physical" file, that is
+     *          \a ullWritePos incremented by this chunk's new size
+     *          (including its header size of course)
+     */
+    file_offset_t Chunk::WriteChunk(file_offset_t ullWritePos, file_offset_t ullCurrentDataOffset, progress_t* pProgress) {
+        const file_offset_t ullOriginalPos = ullWritePos;
+        ullWritePos += CHUNK_HEADER_SIZE(pFile->FileOffsetSize);
+
+        if (pFile->Mode != stream_mode_read_write)
+            throw Exception("Cannot write list chunk, file has to be opened in read+write mode");
+
+        // neither moved, resized nor modified: nothing to write at all
+        if (__isUnchanged(ullWritePos, ullCurrentDataOffset) &&
+            (!pChunkData || (bHashValid && __hashChunkData(pChunkData, ullNewChunkSize) == ullStoredHash)))
+        {
+            __notify_progress(pProgress, 1.0); // notify done
+            ullPos = 0;
+            if ((ullStartPos + ullNewChunkSize) % 2 != 0)
+                return ullStartPos + ullNewChunkSize + 1; // pad byte
+            return ullStartPos + ullNewChunkSize;
+        }
+
+        // chunk is going to be moved (unless still read from the old file)
+        if (!pFile->pSaveCommit) __releaseReadAhead();
+
+        // if the whole chunk body was loaded into RAM
+        if (pChunkData) {
+            // make sure chunk data buffer in RAM is at least as large as the new chunk size
+            LoadChunkData();
+            // write chunk data from RAM persistently to the file
+            if (pFile->__deviceWrite(ullWritePos, pChunkData, ullNewChunkSize) != ullNewChunkSize) {
+                throw Exception("Writing Chunk data (from RAM) failed");
+            }
+            ullStoredHash = __hashChunkData(pChunkData, ullNewChunkSize);
+            bHashValid    = true;
+        } else if (pFile->pWriteDevice == pFile->pDevice &&
+                   ullWritePos == ullStartPos + ullCurrentDataOffset)
+        {
+            // chunk data is already at the right position
+        } else {
+            // move chunk data from the end of the file to the appropriate
+            // position (or to the new file), letting the OS copy or share
+            // the unchanged data blocks directly where possible
+            file_offset_t ullToMove = (ullNewChunkSize < ullCurrentChunkSize) ? ullNewChunkSize : ullCurrentChunkSize;
+            const file_offset_t ullCloned = pFile->__deviceCopy(pFile, ullStartPos + ullCurrentDataOffset, ullWritePos, ullToMove);
+            ullCurrentDataOffset += ullCloned;
+            ullWritePos += ullCloned;
+            ullToMove -= ullCloned;
+            if (!pFile->__deviceMove(ullStartPos + ullCurrentDataOffset, ullWritePos, ullToMove, false, false, NULL))
+                throw Exception("Writing Chunk data (from file) failed");
+        }
+
+        // update this chunk's header
+        WriteHeader(ullOriginalPos);
+
+        __notify_progress(pProgress, 1.0); // notify done
+
+        // update chunk's position pointers
+        const file_offset_t ullNewStartPos = ullOriginalPos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize);
+        __setWritten(ullNewStartPos);
+        if (!pFile->pSaveCommit) ullPos = 0;
+
+        // add pad byte if needed
+        if ((ullNewStartPos + ullNewChunkSize) % 2 != 0) {
+            const char cPadByte = 0;
+            pFile->__deviceWrite(ullNewStartPos + ullNewChunkSize, &cPadByte, 1);
+            return ullNewStartPos + ullNewChunkSize + 1;
+        }
+
+        return ullNewStartPos + ullNewChunkSize;
+    }
+
+    /**
+     * Called by WriteChunk() once this chunk was written: updates the
+     * chunk's position and size to the ones just written and marks it as
+     * unmodified. While File::Save() writes a new file which replaces the
+     * original file at the end (see File::SetSaveMode()), the chunk is
+     * still read from the original file by other threads meanwhile, so the
+     * update is just recorded and applied by File::Save() after switching
+     * to the new file.
+     *
+     * @param ullNewStartPos - new position of the chunk's body in the file
+     */
+    void Chunk::__setWritten(file_offset_t ullNewStartPos) {
+        if (pFile->pSaveCommit) {
+            save_commit_t::entry_t e = { this, ullNewStartPos, ullNewChunkSize };
+            pFile->pSaveCommit->Entries.push_back(e);
+            return;
+        }
+        ullStartPos         = ullNewStartPos;
+        ullCurrentChunkSize = ullNewChunkSize;
+        bModified           = false;
+    }
+
+    /**
+     * Returns @c true if this chunk would be written by WriteChunk() with
+     * the same header to the same position of the same file it is already
+     * stored at, and if it was not modified by Write(), Resize() or (in case
+     * of a list) by adding, removing or moving sub chunks since then. The
+     * chunk's data in RAM (if any) is not considered by this method.
+     *
+     * @param ullDataPos           - position the chunk's body would be written to
+     * @param ullCurrentDataOffset - offset by which all file data was moved by File::Save()
+     */
+    bool Chunk::__isUnchanged(file_offset_t ullDataPos, file_offset_t ullCurrentDataOffset) const {
+        return !bModified && !pFile->bRewriteAll && !ullCurrentDataOffset &&
+               pFile->pWriteDevice == pFile->pDevice &&
+               ullStartPos && ullStartPos == ullDataPos &&
+               ullNewChunkSize == ullCurrentChunkSize;
+    }
+
+    /**
+     * Prepares this chunk for being written to @a ullWritePos by
+     * WriteChunk() and returns the write position following this chunk.
+     * Since WriteChunk() copies the data of chunks not loaded into RAM from
+     * their old to their new position in ascending file order, the old
+     * data of a chunk must not be located before its new position. If it
+     * would be, the chunk's data is either loaded into RAM (if still
+     * possible within the RAM budget of @a plan) or the amount of bytes
+     * all file data has to be moved towards the end of the file before
+     * writing is raised accordingly.
+     *
+     * @param ullWritePos - position the chunk will be written to
+     * @param plan        - layout decisions being collected by File::Save()
+     */
+    file_offset_t Chunk::__planWrite(file_offset_t ullWritePos, save_plan_t& plan) {
+        const file_offset_t ullDataPos = ullWritePos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize);
+        const file_offset_t ullToMove  = (ullNewChunkSize < ullCurrentChunkSize) ? ullNewChunkSize : ullCurrentChunkSize;
+        if (!pChunkData && ullToMove && ullDataPos > ullStartPos + plan.ullShift) {
+            const file_offset_t ullBufferSize = (ullCurrentChunkSize > ullNewChunkSize) ? ullCurrentChunkSize : ullNewChunkSize;
+            if (ullBufferSize <= plan.ullRAMBudget && LoadChunkData()) {
+                plan.ullRAMBudget -= ullBufferSize;
+                plan.Loaded.push_back(this);
+            } else {
+                plan.ullShift = ullDataPos - ullStartPos;
+            }
+        }
+        const file_offset_t ullEnd = ullDataPos + ullNewChunkSize;
+        return ullEnd + ullEnd % 2; // optional pad byte
     }
 
-    /** @brief Write chunk persistently e.g. to disk.
-     *
-     * Stores the chunk persistently to its actual "physical" file.
+    /**
+     * Writes this chunk strictly sequentially to @a ullWritePos of the
+     * write device: first the header, then the chunk data and finally the
+     * optional pad byte (see File::SaveSequential()). Chunk data which is
+     * neither loaded into RAM nor stored in the file yet is requested from
+     * @a Source (if any), otherwise it is filled with zeros.
      *
-     * @param ullWritePos - position within the "physical" file where this
-     *                     chunk should be written to
-     * @param ullCurrentDataOffset - offset of current (old) data within
-     *                              the file
-     * @param pProgress - optional: callback function for progress notification
-     * @returns new write position in the "physical" file, that is
-     *          \a ullWritePos incremented by this chunk's new size
-     *          (including its header size of course)
+     * @param ullWritePos - position the chunk is written to
+     * @param Source      - optional: source of new chunk data
+     * @param pUserData   - passed to @a Source
+     * @param pProgress   - optional: callback function for progress notification
+     * @returns the write position following this chunk
      */
-    file_offset_t Chunk::WriteChunk(file_offset_t ullWritePos, file_offset_t ullCurrentDataOffset, progress_t* pProgress) {
+    file_offset_t Chunk::__writeSequential(file_offset_t ullWritePos, chunk_source_t Source, void* pUserData, progress_t* pProgress) {
         const file_offset_t ullOriginalPos = ullWritePos;
         ullWritePos += CHUNK_HEADER_SIZE(pFile->FileOffsetSize);
 
-        if (pFile->Mode != stream_mode_read_write)
-            throw Exception("Cannot write list chunk, file has to be opened in read+write mode");
+        __releaseReadAhead(); // chunk is going to be moved
+        WriteHeader(ullOriginalPos);
 
-        // if the whole chunk body was loaded into RAM
         if (pChunkData) {
             // make sure chunk data buffer in RAM is at least as large as the new chunk size
             LoadChunkData();
-            // write chunk data from RAM persistently to the file
-            #if POSIX
-            lseek(pFile->hFileWrite, ullWritePos, SEEK_SET);
-            if (write(pFile->hFileWrite, pChunkData, ullNewChunkSize) != ullNewChunkSize) {
-                throw Exception("Writing Chunk data (from RAM) failed");
-            }
-            #elif defined(WIN32)
-            LARGE_INTEGER liFilePos;
-            liFilePos.QuadPart = ullWritePos;
-            SetFilePointerEx(pFile->hFileWrite, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN);
-            DWORD dwBytesWritten;
-            WriteFile(pFile->hFileWrite, pChunkData, ullNewChunkSize, &dwBytesWritten, NULL); //FIXME: won't save chunks larger than 2GB !
-            if (dwBytesWritten != ullNewChunkSize) {
-                throw Exception("Writing Chunk data (from RAM) failed");
-            }
-            #else
-            fseeko(pFile->hFileWrite, ullWritePos, SEEK_SET);
-            if (fwrite(pChunkData, 1, ullNewChunkSize, pFile->hFileWrite) != ullNewChunkSize) {
+            if (pFile->__deviceWrite(ullWritePos, pChunkData, ullNewChunkSize) != ullNewChunkSize)
                 throw Exception("Writing Chunk data (from RAM) failed");
+            ullStoredHash = __hashChunkData(pChunkData, ullNewChunkSize);
+            bHashValid    = true;
+        } else if (ullNewChunkSize) {
+            const file_offset_t ullStored = (ullNewChunkSize < ullCurrentChunkSize) ? ullNewChunkSize : ullCurrentChunkSize;
+            const file_offset_t ullBufferSize = (ullNewChunkSize < SAVE_COPY_BUFFER_SIZE) ? ullNewChunkSize : SAVE_COPY_BUFFER_SIZE;
+            // (freed as well if the chunk source throws)
+            std::vector<uint8_t> copyBuffer(ullBufferSize);
+            uint8_t* pCopyBuffer = &copyBuffer[0];
+            bool bZeroFill = !Source;
+            String sError;
+            // let the OS copy or share the data blocks already stored in the
+            // original file directly, if it can
+            const file_offset_t ullCloned = pFile->__deviceCopy(pFile, ullStartPos, ullWritePos, ullStored);
+            for (file_offset_t ullOffset = ullCloned, n; ullOffset < ullNewChunkSize; ullOffset += n) {
+                n = ullNewChunkSize - ullOffset;
+                if (n > ullBufferSize) n = ullBufferSize;
+                if (ullOffset < ullStored) { // data already stored in the (original) file
+                    if (n > ullStored - ullOffset) n = ullStored - ullOffset;
+                    if (pFile->__deviceRead(ullStartPos + ullOffset, pCopyBuffer, n) != n) {
+                        sError = "Reading Chunk data (from file) failed";
+                        break;
+                    }
+                } else if (bZeroFill) {
+                    memset(pCopyBuffer, 0, n);
+                } else { // new data
+                    const file_offset_t ullDelivered = Source(this, pCopyBuffer, n, pUserData);
+                    if (!ullDelivered) {
+                        bZeroFill = true;
+                        memset(pCopyBuffer, 0, n);
+                    } else if (ullDelivered < n) {
+                        n = ullDelivered;
+                    }
+                }
+                if (pFile->__deviceWrite(ullWritePos + ullOffset, pCopyBuffer, n) != n) {
+                    sError = "Writing Chunk data (sequentially) failed";
+                    break;
+                }
+                __notify_progress(pProgress, float(ullOffset + n) / float(ullNewChunkSize));
             }
-            #endif // POSIX
-        } else {
-            // move chunk data from the end of the file to the appropriate position
-            int8_t* pCopyBuffer = new int8_t[4096];
-            file_offset_t ullToMove = (ullNewChunkSize < ullCurrentChunkSize) ? ullNewChunkSize : ullCurrentChunkSize;
-            #if defined(WIN32)
-            DWORD iBytesMoved = 1; // we have to pass it via pointer to the Windows API, thus the correct size must be ensured
-            #else
-            int iBytesMoved = 1;
-            #endif
-            for (file_offset_t ullOffset = 0; ullToMove > 0 && iBytesMoved > 0; ullOffset += iBytesMoved, ullToMove -= iBytesMoved) {
-                iBytesMoved = (ullToMove < 4096) ? int(ullToMove) : 4096;
-                #if POSIX
-                lseek(pFile->hFileRead, ullStartPos + ullCurrentDataOffset + ullOffset, SEEK_SET);
-                iBytesMoved = (int) read(pFile->hFileRead, pCopyBuffer, (size_t) iBytesMoved);
-                lseek(pFile->hFileWrite, ullWritePos + ullOffset, SEEK_SET);
-                iBytesMoved = (int) write(pFile->hFileWrite, pCopyBuffer, (size_t) iBytesMoved);
-                #elif defined(WIN32)
-                LARGE_INTEGER liFilePos;
-                liFilePos.QuadPart = ullStartPos + ullCurrentDataOffset + ullOffset;
-                SetFilePointerEx(pFile->hFileRead, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN);
-                ReadFile(pFile->hFileRead, pCopyBuffer, iBytesMoved, &iBytesMoved, NULL);
-                liFilePos.QuadPart = ullWritePos + ullOffset;
-                SetFilePointerEx(pFile->hFileWrite, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN);
-                WriteFile(pFile->hFileWrite, pCopyBuffer, iBytesMoved, &iBytesMoved, NULL);
-                #else
-                fseeko(pFile->hFileRead, ullStartPos + ullCurrentDataOffset + ullOffset, SEEK_SET);
-                iBytesMoved = fread(pCopyBuffer, 1, iBytesMoved, pFile->hFileRead);
-                fseeko(pFile->hFileWrite, ullWritePos + ullOffset, SEEK_SET);
-                iBytesMoved = fwrite(pCopyBuffer, 1, iBytesMoved, pFile->hFileWrite);
-                #endif
-            }
-            delete[] pCopyBuffer;
-            if (iBytesMoved < 0) throw Exception("Writing Chunk data (from file) failed");
+            if (!sError.empty()) throw Exception(sError);
         }
 
-        // update this chunk's header
+        // update chunk's position pointers
         ullCurrentChunkSize = ullNewChunkSize;
-        WriteHeader(ullOriginalPos);
+        ullStartPos = ullWritePos;
+        ullPos      = 0;
+        bModified   = false;
 
         __notify_progress(pProgress, 1.0); // notify done
 
-        // update chunk's position pointers
-        ullStartPos = ullOriginalPos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize);
-        ullPos      = 0;
-
         // add pad byte if needed
         if ((ullStartPos + ullNewChunkSize) % 2 != 0) {
             const char cPadByte = 0;
-            #if POSIX
-            lseek(pFile->hFileWrite, ullStartPos + ullNewChunkSize, SEEK_SET);
-            write(pFile->hFileWrite, &cPadByte, 1);
-            #elif defined(WIN32)
-            LARGE_INTEGER liFilePos;
-            liFilePos.QuadPart = ullStartPos + ullNewChunkSize;
-            SetFilePointerEx(pFile->hFileWrite, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN);
-            DWORD dwBytesWritten;
-            WriteFile(pFile->hFileWrite, &cPadByte, 1, &dwBytesWritten, NULL);
-            #else
-            fseeko(pFile->hFileWrite, ullStartPos + ullNewChunkSize, SEEK_SET);
-            fwrite(&cPadByte, 1, 1, pFile->hFileWrite);
-            #endif
+            if (pFile->__deviceWrite(ullStartPos + ullNewChunkSize, &cPadByte, 1) != 1)
+                throw Exception("Writing Chunk pad byte failed");
             return ullStartPos + ullNewChunkSize + 1;
         }
 
@@ -1000,6 +3051,51 @@ namespace RIFF {
 
     void Chunk::__resetPos() {
         ullPos = 0;
+        __releaseReadAhead();
+    }
+
+
+
+    /**
+     * Allocates the chunk object from the heap. Kept out of line on GCC,
+     * since inlining the malloc() call into callers makes -O2 report the
+     * matching Chunk::operator delete() as mismatched.
+     */
+#if defined(__GNUC__)
+    __attribute__((noinline))
+#endif
+    void* Chunk::operator new(size_t size) {
+        chunk_alloc_header_t* h
+ = (chunk_alloc_header_t*) malloc(sizeof(chunk_alloc_header_t) + size);
+        if (!h) throw std::bad_alloc();
+        h->info.pArena = NULL;
+        h->info.size   = size;
+        return h + 1;
+    }
+
+    /**
+     * Allocates the chunk object from the slab allocator of the given file.
+     * Used for all chunks created by the chunk tree itself.
+     */
+    void* Chunk::operator new(size_t size, File* pFile) {
+        if (!pFile->pChunkArena) pFile->pChunkArena = new chunk_arena_t;
+        const size_t n = sizeof(chunk_alloc_header_t) +
+            (size + sizeof(chunk_alloc_header_t) - 1) / sizeof(chunk_alloc_header_t) * sizeof(chunk_alloc_header_t);
+        chunk_alloc_header_t* h = (chunk_alloc_header_t*) pFile->pChunkArena->allocate(n);
+        h->info.pArena = pFile->pChunkArena;
+        h->info.size   = n;
+        return h + 1;
+    }
+
+    void Chunk::operator delete(void* p) {
+        if (!p) return;
+        chunk_alloc_header_t* h = (chunk_alloc_header_t*) p - 1;
+        if (h->info.pArena) h->info.pArena->release(h, h->info.size);
+        else free(h);
+    }
+
+    void Chunk::operator delete(void* p, File* /*pFile*/) {
+        Chunk::operator delete(p);
     }
 
 
@@ -1011,8 +3107,9 @@ namespace RIFF {
         #if DEBUG_RIFF
         std::cout << "List::List(File* pFile)" << std::endl;
         #endif // DEBUG_RIFF
-        pSubChunks    = NULL;
-        pSubChunksMap = NULL;
+        bSubChunksLoaded = false;
+        ullRequiredSize[0] = ullRequiredSize[1] = 0;
+        ChunksIterator   = ListIterator = 0;
     }
 
     List::List(File* pFile, file_offset_t StartPos, List* Parent)
@@ -1020,16 +3117,18 @@ namespace RIFF {
         #if DEBUG_RIFF
         std::cout << "List::List(File*,file_offset_t,List*)" << std::endl;
         #endif // DEBUG_RIFF
-        pSubChunks    = NULL;
-        pSubChunksMap = NULL;
+        bSubChunksLoaded = false;
+        ullRequiredSize[0] = ullRequiredSize[1] = 0;
+        ChunksIterator   = ListIterator = 0;
         ReadHeader(StartPos);
         ullStartPos = StartPos + LIST_HEADER_SIZE(pFile->FileOffsetSize);
     }
 
     List::List(File* pFile, List* pParent, uint32_t uiListID)
       : Chunk(pFile, pParent, CHUNK_ID_LIST, 0) {
-        pSubChunks    = NULL;
-        pSubChunksMap = NULL;
+        bSubChunksLoaded = false;
+        ullRequiredSize[0] = ullRequiredSize[1] = 0;
+        ChunksIterator   = ListIterator = 0;
         ListType      = uiListID;
     }
 
@@ -1041,20 +3140,106 @@ namespace RIFF {
     }
 
     void List::DeleteChunkList() {
-        if (pSubChunks) {
-            ChunkList::iterator iter = pSubChunks->begin();
-            ChunkList::iterator end  = pSubChunks->end();
-            while (iter != end) {
-                delete *iter;
-                iter++;
-            }
-            delete pSubChunks;
-            pSubChunks = NULL;
+        for (size_t i = 0; i < SubChunks.size(); ++i)
+            delete SubChunks[i];
+        ChunkList().swap(SubChunks);
+        ChunkMap().swap(SubChunksMap);
+        ChunkMap().swap(SubListsMap);
+        bSubChunksLoaded = false;
+        ullRequiredSize[0] = ullRequiredSize[1] = 0;
+    }
+
+    bool List::__compareChunkMapEntry(const std::pair<uint32_t, chunk_index_t>& a, uint32_t ID) {
+        return a.first < ID;
+    }
+
+    /// Returns the index entry of the given chunk ID / list type, NULL if there is none.
+    List::chunk_index_t* List::__findIndex(ChunkMap& map, uint32_t ID) {
+        ChunkMap::iterator it = std::lower_bound(map.begin(), map.end(), ID, __compareChunkMapEntry);
+        return (it != map.end() && it->first == ID) ? &it->second : NULL;
+    }
+
+    /// Returns the index entry of the given chunk ID / list type, adding an empty one if required.
+    List::chunk_index_t& List::__makeIndex(ChunkMap& map, uint32_t ID) {
+        ChunkMap::iterator it = std::lower_bound(map.begin(), map.end(), ID, __compareChunkMapEntry);
+        if (it == map.end() || it->first != ID) {
+            chunk_index_t entry;
+            entry.pMapped = NULL;
+            it = map.insert(it, std::make_pair(ID, entry));
+        }
+        return it->second;
+    }
+
+    /// Removes @a pCk from the index entry of the given chunk ID / list type.
+    void List::__removeFromIndex(ChunkMap& map, uint32_t ID, Chunk* pCk) {
+        ChunkMap::iterator it = std::lower_bound(map.begin(), map.end(), ID, __compareChunkMapEntry);
+        if (it == map.end() || it->first != ID) return;
+        ChunkList& chunks = it->second.Chunks;
+        ChunkList::iterator iter = std::find(chunks.begin(), chunks.end(), pCk);
+        if (iter == chunks.end()) return;
+        chunks.erase(iter);
+        if (chunks.empty()) {
+            map.erase(it);
+            return;
         }
-        if (pSubChunksMap) {
-            delete pSubChunksMap;
-            pSubChunksMap = NULL;
+        // map another chunk of the same chunk ID for GetSubChunk()
+        if (it->second.pMapped == pCk) it->second.pMapped = chunks.front();
+    }
+
+    /**
+     * Appends @a pCk, which must have been appended to SubChunks before, to
+     * the index by chunk ID (and by list type if it is a list).
+     *
+     * @param pCk  - sub chunk to be indexed
+     * @param bMap - whether @a pCk shall become the chunk returned by
+     *               GetSubChunk() for its chunk ID, otherwise this is only
+     *               the case if there was no other chunk of that ID yet
+     */
+    void List::__indexChunk(Chunk* pCk, bool bMap) {
+        const uint32_t id = pCk->GetChunkID();
+        chunk_index_t& index = __makeIndex(SubChunksMap, id);
+        index.Chunks.push_back(pCk);
+        if (bMap || !index.pMapped) index.pMapped = pCk;
+        if (id == CHUNK_ID_LIST)
+            __makeIndex(SubListsMap, ((List*) pCk)->GetListType()).Chunks.push_back(pCk);
+    }
+
+    /// Removes @a pCk from the indexes, another chunk with the same ID is mapped if @a pCk is the one currently returned by GetSubChunk().
+    void List::__unindexChunk(Chunk* pCk) {
+        const uint32_t id = pCk->GetChunkID();
+        __removeFromIndex(SubChunksMap, id, pCk);
+        if (id == CHUNK_ID_LIST)
+            __removeFromIndex(SubListsMap, ((List*) pCk)->GetListType(), pCk);
+    }
+
+    /// Restores the order of @a pCk's index entries after @a pCk was moved within SubChunks.
+    void List::__reorderIndex(Chunk* pCk) {
+        const uint32_t id = pCk->GetChunkID();
+        chunk_index_t* pIndex = __findIndex(SubChunksMap, id);
+        if (pIndex) {
+            pIndex->Chunks.clear();
+            for (size_t i = 0; i < SubChunks.size(); ++i)
+                if (SubChunks[i]->GetChunkID() == id) pIndex->Chunks.push_back(SubChunks[i]);
         }
+        if (id != CHUNK_ID_LIST) return;
+        const uint32_t type = ((List*) pCk)->GetListType();
+        pIndex = __findIndex(SubListsMap, type);
+        if (!pIndex) return;
+        pIndex->Chunks.clear();
+        for (size_t i = 0; i < SubChunks.size(); ++i)
+            if (SubChunks[i]->GetChunkID() == CHUNK_ID_LIST && ((List*) SubChunks[i])->GetListType() == type)
+                pIndex->Chunks.push_back(SubChunks[i]);
+    }
+
+    /// Removes @a pCk from the list of sub chunks (without deleting it).
+    void List::__removeChunk(Chunk* pCk) {
+        ChunkList::iterator it = std::find(SubChunks.begin(), SubChunks.end(), pCk);
+        if (it == SubChunks.end()) return;
+        const size_t i = it - SubChunks.begin();
+        SubChunks.erase(it);
+        // keep GetNextSubChunk() / GetNextSubList() on the following chunk
+        if (ChunksIterator > i) ChunksIterator--;
+        if (ListIterator > i) ListIterator--;
     }
 
     /**
@@ -1072,8 +3257,9 @@ namespace RIFF {
         #if DEBUG_RIFF
         std::cout << "List::GetSubChunk(uint32_t)" << std::endl;
         #endif // DEBUG_RIFF
-        if (!pSubChunksMap) LoadSubChunks();
-        return (*pSubChunksMap)[ChunkID];
+        if (!bSubChunksLoaded) LoadSubChunks();
+        const chunk_index_t* pIndex = __findIndex(SubChunksMap, ChunkID);
+        return (pIndex) ? pIndex->pMapped : NULL;
     }
 
     /**
@@ -1091,17 +3277,7 @@ namespace RIFF {
         #if DEBUG_RIFF
         std::cout << "List::GetSubList(uint32_t)" << std::endl;
         #endif // DEBUG_RIFF
-        if (!pSubChunks) LoadSubChunks();
-        ChunkList::iterator iter = pSubChunks->begin();
-        ChunkList::iterator end  = pSubChunks->end();
-        while (iter != end) {
-            if ((*iter)->GetChunkID() == CHUNK_ID_LIST) {
-                List* l = (List*) *iter;
-                if (l->GetListType() == ListType) return l;
-            }
-            iter++;
-        }
-        return NULL;
+        return GetSubListAt(ListType, 0);
     }
 
     /**
@@ -1117,9 +3293,9 @@ namespace RIFF {
         #if DEBUG_RIFF
         std::cout << "List::GetFirstSubChunk()" << std::endl;
         #endif // DEBUG_RIFF
-        if (!pSubChunks) LoadSubChunks();
-        ChunksIterator = pSubChunks->begin();
-        return (ChunksIterator != pSubChunks->end()) ? *ChunksIterator : NULL;
+        if (!bSubChunksLoaded) LoadSubChunks();
+        ChunksIterator = 0;
+        return (ChunksIterator < SubChunks.size()) ? SubChunks[ChunksIterator] : NULL;
     }
 
     /**
@@ -1134,9 +3310,73 @@ namespace RIFF {
         #if DEBUG_RIFF
         std::cout << "List::GetNextSubChunk()" << std::endl;
         #endif // DEBUG_RIFF
-        if (!pSubChunks) return NULL;
+        if (ChunksIterator >= SubChunks.size()) return NULL;
         ChunksIterator++;
-        return (ChunksIterator != pSubChunks->end()) ? *ChunksIterator : NULL;
+        return (ChunksIterator < SubChunks.size()) ? SubChunks[ChunksIterator] : NULL;
+    }
+
+    /**
+     *  Returns the subchunk at the given position within the list (which may
+     *  be an ordinary chunk as well as a list chunk). In contrast to
+     *  GetFirstSubChunk() and GetNextSubChunk() this method does not hold any
+     *  iteration state in the List object, so the same list may be traversed
+     *  by several (nested) loops or threads at the same time, once its
+     *  subchunks were loaded (which happens on the first access).
+     *
+     *  @param pos - position of the subchunk (0 .. CountSubChunks() - 1)
+     *  @returns pointer to the subchunk or NULL if @a pos is out of bounds
+     */
+    Chunk* List::GetSubChunkAt(size_t pos) {
+        if (!bSubChunksLoaded) LoadSubChunks();
+        return (pos < SubChunks.size()) ? SubChunks[pos] : NULL;
+    }
+
+    /**
+     *  Returns the sublist (that is a subchunk with chunk ID "LIST") at the
+     *  given position among all sublists within the list. Like
+     *  GetSubChunkAt() this method does not hold any iteration state in the
+     *  List object.
+     *
+     *  @param pos - position of the sublist (0 .. CountSubLists() - 1)
+     *  @returns pointer to the sublist or NULL if @a pos is out of bounds
+     */
+    List* List::GetSubListAt(size_t pos) {
+        return (List*) GetSubChunkAt(CHUNK_ID_LIST, pos);
+    }
+
+    /**
+     *  Returns the subchunk at the given position among all subchunks with
+     *  chunk ID <i>\a ChunkID</i> within the list, in the order they appear
+     *  in the list. Like GetSubChunkAt(size_t) this method does not hold any
+     *  iteration state in the List object and it takes constant time, so
+     *  it is the preferred way to traverse subchunks of one chunk ID.
+     *
+     *  @param ChunkID - chunk ID of the sought subchunk
+     *  @param pos     - position among the subchunks of that chunk ID
+     *                   (0 .. CountSubChunks(ChunkID) - 1)
+     *  @returns pointer to the subchunk or NULL if @a pos is out of bounds
+     */
+    Chunk* List::GetSubChunkAt(uint32_t ChunkID, size_t pos) {
+        if (!bSubChunksLoaded) LoadSubChunks();
+        const chunk_index_t* pIndex = __findIndex(SubChunksMap, ChunkID);
+        return (pIndex && pos < pIndex->Chunks.size()) ? pIndex->Chunks[pos] : NULL;
+    }
+
+    /**
+     *  Returns the sublist at the given position among all sublists with
+     *  list type <i>\a ListType</i> within the list, in the order they
+     *  appear in the list. Like GetSubChunkAt(uint32_t, size_t) this method
+     *  takes constant time and does not hold any iteration state.
+     *
+     *  @param ListType - list type of the sought sublist
+     *  @param pos      - position among the sublists of that list type
+     *                    (0 .. CountSubLists(ListType) - 1)
+     *  @returns pointer to the sublist or NULL if @a pos is out of bounds
+     */
+    List* List::GetSubListAt(uint32_t ListType, size_t pos) {
+        if (!bSubChunksLoaded) LoadSubChunks();
+        const chunk_index_t* pIndex = __findIndex(SubListsMap, ListType);
+        return (pIndex && pos < pIndex->Chunks.size()) ? (List*) pIndex->Chunks[pos] : NULL;
     }
 
     /**
@@ -1152,13 +3392,9 @@ namespace RIFF {
         #if DEBUG_RIFF
         std::cout << "List::GetFirstSubList()" << std::endl;
         #endif // DEBUG_RIFF
-        if (!pSubChunks) LoadSubChunks();
-        ListIterator            = pSubChunks->begin();
-        ChunkList::iterator end = pSubChunks->end();
-        while (ListIterator != end) {
-            if ((*ListIterator)->GetChunkID() == CHUNK_ID_LIST) return (List*) *ListIterator;
-            ListIterator++;
-        }
+        if (!bSubChunksLoaded) LoadSubChunks();
+        for (ListIterator = 0; ListIterator < SubChunks.size(); ++ListIterator)
+            if (SubChunks[ListIterator]->GetChunkID() == CHUNK_ID_LIST) return (List*) SubChunks[ListIterator];
         return NULL;
     }
 
@@ -1174,14 +3410,9 @@ namespace RIFF {
         #if DEBUG_RIFF
         std::cout << "List::GetNextSubList()" << std::endl;
         #endif // DEBUG_RIFF
-        if (!pSubChunks) return NULL;
-        if (ListIterator == pSubChunks->end()) return NULL;
-        ListIterator++;
-        ChunkList::iterator end = pSubChunks->end();
-        while (ListIterator != end) {
-            if ((*ListIterator)->GetChunkID() == CHUNK_ID_LIST) return (List*) *ListIterator;
-            ListIterator++;
-        }
+        if (ListIterator >= SubChunks.size()) return NULL;
+        for (++ListIterator; ListIterator < SubChunks.size(); ++ListIterator)
+            if (SubChunks[ListIterator]->GetChunkID() == CHUNK_ID_LIST) return (List*) SubChunks[ListIterator];
         return NULL;
     }
 
@@ -1189,8 +3420,8 @@ namespace RIFF {
      *  Returns number of subchunks within the list (including list chunks).
      */
     size_t List::CountSubChunks() {
-        if (!pSubChunks) LoadSubChunks();
-        return pSubChunks->size();
+        if (!bSubChunksLoaded) LoadSubChunks();
+        return SubChunks.size();
     }
 
     /**
@@ -1198,17 +3429,9 @@ namespace RIFF {
      *  <i>\a ChunkId</i>.
      */
     size_t List::CountSubChunks(uint32_t ChunkID) {
-        size_t result = 0;
-        if (!pSubChunks) LoadSubChunks();
-        ChunkList::iterator iter = pSubChunks->begin();
-        ChunkList::iterator end  = pSubChunks->end();
-        while (iter != end) {
-            if ((*iter)->GetChunkID() == ChunkID) {
-                result++;
-            }
-            iter++;
-        }
-        return result;
+        if (!bSubChunksLoaded) LoadSubChunks();
+        const chunk_index_t* pIndex = __findIndex(SubChunksMap, ChunkID);
+        return (pIndex) ? pIndex->Chunks.size() : 0;
     }
 
     /**
@@ -1223,18 +3446,9 @@ namespace RIFF {
      *  <i>\a ListType</i>
      */
     size_t List::CountSubLists(uint32_t ListType) {
-        size_t result = 0;
-        if (!pSubChunks) LoadSubChunks();
-        ChunkList::iterator iter = pSubChunks->begin();
-        ChunkList::iterator end  = pSubChunks->end();
-        while (iter != end) {
-            if ((*iter)->GetChunkID() == CHUNK_ID_LIST) {
-                List* l = (List*) *iter;
-                if (l->GetListType() == ListType) result++;
-            }
-            iter++;
-        }
-        return result;
+        if (!bSubChunksLoaded) LoadSubChunks();
+        const chunk_index_t* pIndex = __findIndex(SubListsMap, ListType);
+        return (pIndex) ? pIndex->Chunks.size() : 0;
     }
 
     /** @brief Creates a new sub chunk.
@@ -1252,12 +3466,14 @@ namespace RIFF {
      */
     Chunk* List::AddSubChunk(uint32_t uiChunkID, file_offset_t ullBodySize) {
         if (ullBodySize == 0) throw Exception("Chunk body size must be at least 1 byte");
-        if (!pSubChunks) LoadSubChunks();
-        Chunk* pNewChunk = new Chunk(pFile, this, uiChunkID, 0);
-        pSubChunks->push_back(pNewChunk);
-        (*pSubChunksMap)[uiChunkID] = pNewChunk;
+        if (!bSubChunksLoaded) LoadSubChunks();
+        Chunk* pNewChunk = new (pFile) Chunk(pFile, this, uiChunkID, 0);
+        SubChunks.push_back(pNewChunk);
+        __indexChunk(pNewChunk);
         pNewChunk->Resize(ullBodySize);
         ullNewChunkSize += CHUNK_HEADER_SIZE(pFile->FileOffsetSize);
+        bModified = true;
+        __invalidateRequiredSize();
         return pNewChunk;
     }
 
@@ -1273,10 +3489,12 @@ namespace RIFF {
      *               last in list.
      */
     void List::MoveSubChunk(Chunk* pSrc, Chunk* pDst) {
-        if (!pSubChunks) LoadSubChunks();
-        pSubChunks->remove(pSrc);
-        ChunkList::iterator iter = find(pSubChunks->begin(), pSubChunks->end(), pDst);
-        pSubChunks->insert(iter, pSrc);
+        if (!bSubChunksLoaded) LoadSubChunks();
+        __removeChunk(pSrc);
+        ChunkList::iterator iter = std::find(SubChunks.begin(), SubChunks.end(), pDst);
+        SubChunks.insert(iter, pSrc);
+        __reorderIndex(pSrc);
+        bModified = true;
     }
 
     /** @brief Moves a sub chunk from this list to another list.
@@ -1289,26 +3507,18 @@ namespace RIFF {
      */
     void List::MoveSubChunk(Chunk* pSrc, List* pNewParent) {
         if (pNewParent == this || !pNewParent) return;
-        if (!pSubChunks) LoadSubChunks();
-        if (!pNewParent->pSubChunks) pNewParent->LoadSubChunks();
-        pSubChunks->remove(pSrc);
-        pNewParent->pSubChunks->push_back(pSrc);
-        // update chunk id map of this List
-        if ((*pSubChunksMap)[pSrc->GetChunkID()] == pSrc) {
-            pSubChunksMap->erase(pSrc->GetChunkID());
-            // try to find another chunk of the same chunk ID
-            ChunkList::iterator iter = pSubChunks->begin();
-            ChunkList::iterator end  = pSubChunks->end();
-            for (; iter != end; ++iter) {
-                if ((*iter)->GetChunkID() == pSrc->GetChunkID()) {
-                    (*pSubChunksMap)[pSrc->GetChunkID()] = *iter;
-                    break; // we're done, stop search
-                }
-            }
-        }
-        // update chunk id map of other list
-        if (!(*pNewParent->pSubChunksMap)[pSrc->GetChunkID()])
-            (*pNewParent->pSubChunksMap)[pSrc->GetChunkID()] = pSrc;
+        if (!bSubChunksLoaded) LoadSubChunks();
+        if (!pNewParent->bSubChunksLoaded) pNewParent->LoadSubChunks();
+        __removeChunk(pSrc);
+        pNewParent->SubChunks.push_back(pSrc);
+        pSrc->pParent = pNewParent;
+        bModified = pNewParent->bModified = true;
+        __invalidateRequiredSize();
+        pNewParent->__invalidateRequiredSize();
+        // update chunk indexes of both lists, the chunk returned by the
+        // other list's GetSubChunk() remains the same if there is one already
+        __unindexChunk(pSrc);
+        pNewParent->__indexChunk(pSrc, false);
     }
 
     /** @brief Creates a new list sub chunk.
@@ -1321,11 +3531,13 @@ namespace RIFF {
      * @param uiListType - list ID of the new list chunk
      */
     List* List::AddSubList(uint32_t uiListType) {
-        if (!pSubChunks) LoadSubChunks();
-        List* pNewListChunk = new List(pFile, this, uiListType);
-        pSubChunks->push_back(pNewListChunk);
-        (*pSubChunksMap)[CHUNK_ID_LIST] = pNewListChunk;
+        if (!bSubChunksLoaded) LoadSubChunks();
+        List* pNewListChunk = new (pFile) List(pFile, this, uiListType);
+        SubChunks.push_back(pNewListChunk);
+        __indexChunk(pNewListChunk);
         ullNewChunkSize += LIST_HEADER_SIZE(pFile->FileOffsetSize);
+        bModified = true;
+        __invalidateRequiredSize();
         return pNewListChunk;
     }
 
@@ -1340,21 +3552,12 @@ namespace RIFF {
      * @param pSubChunk - sub chunk or sub list chunk to be removed
      */
     void List::DeleteSubChunk(Chunk* pSubChunk) {
-        if (!pSubChunks) LoadSubChunks();
-        pSubChunks->remove(pSubChunk);
-        if ((*pSubChunksMap)[pSubChunk->GetChunkID()] == pSubChunk) {
-            pSubChunksMap->erase(pSubChunk->GetChunkID());
-            // try to find another chunk of the same chunk ID
-            ChunkList::iterator iter = pSubChunks->begin();
-            ChunkList::iterator end  = pSubChunks->end();
-            for (; iter != end; ++iter) {
-                if ((*iter)->GetChunkID() == pSubChunk->GetChunkID()) {
-                    (*pSubChunksMap)[pSubChunk->GetChunkID()] = *iter;
-                    break; // we're done, stop search
-                }
-            }
-        }
+        if (!bSubChunksLoaded) LoadSubChunks();
+        __removeChunk(pSubChunk);
+        __unindexChunk(pSubChunk);
         delete pSubChunk;
+        bModified = true;
+        __invalidateRequiredSize();
     }
 
     /**
@@ -1365,15 +3568,46 @@ namespace RIFF {
      *                          being saved to a file
      */
     file_offset_t List::RequiredPhysicalSize(int fileOffsetSize) {
-        if (!pSubChunks) LoadSubChunks();
+        file_offset_t& cached = ullRequiredSize[fileOffsetSize > 4];
+        if (cached) return cached;
+        if (!bSubChunksLoaded) LoadSubChunks();
         file_offset_t size = LIST_HEADER_SIZE(fileOffsetSize);
-        ChunkList::iterator iter = pSubChunks->begin();
-        ChunkList::iterator end  = pSubChunks->end();
-        for (; iter != end; ++iter)
-            size += (*iter)->RequiredPhysicalSize(fileOffsetSize);
+        for (size_t i = 0; i < SubChunks.size(); ++i)
+            size += SubChunks[i]->RequiredPhysicalSize(fileOffsetSize);
+        cached = size;
+        return size;
+    }
+
+    size_t List::GetMemoryUsage() const {
+        return sizeof(List) + __bufferMemoryUsage() + __subChunksMemoryUsage();
+    }
+
+    /// Returns the memory occupied by the sub chunks loaded so far (and by the containers referencing them).
+    size_t List::__subChunksMemoryUsage() const {
+        size_t size = SubChunks.capacity() * sizeof(ChunkList::value_type) +
+                      SubChunksMap.capacity() * sizeof(ChunkMap::value_type) +
+                      SubListsMap.capacity() * sizeof(ChunkMap::value_type);
+        for (size_t i = 0; i < SubChunksMap.size(); ++i)
+            size += SubChunksMap[i].second.Chunks.capacity() * sizeof(ChunkList::value_type);
+        for (size_t i = 0; i < SubListsMap.size(); ++i)
+            size += SubListsMap[i].second.Chunks.capacity() * sizeof(ChunkList::value_type);
+        for (size_t i = 0; i < SubChunks.size(); ++i)
+            size += SubChunks[i]->GetMemoryUsage();
         return size;
     }
 
+    /**
+     * Discards the cached required sizes (see RequiredPhysicalSize()) of
+     * this list and of all its parent lists. Must be called whenever the
+     * size of a sub chunk changes or sub chunks are added or removed, so
+     * the required size of any list only has to be recalculated along the
+     * path of the modified chunk.
+     */
+    void List::__invalidateRequiredSize() {
+        for (List* pList = this; pList; pList = pList->pParent)
+            pList->ullRequiredSize[0] = pList->ullRequiredSize[1] = 0;
+    }
+
     void List::ReadHeader(file_offset_t filePos) {
         #if DEBUG_RIFF
         std::cout << "List::Readheader(file_offset_t) ";
@@ -1381,19 +3615,7 @@ namespace RIFF {
         Chunk::ReadHeader(filePos);
         if (ullCurrentChunkSize < 4) return;
         ullNewChunkSize = ullCurrentChunkSize -= 4;
-        #if POSIX
-        lseek(pFile->hFileRead, filePos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize), SEEK_SET);
-        read(pFile->hFileRead, &ListType, 4);
-        #elif defined(WIN32)
-        LARGE_INTEGER liFilePos;
-        liFilePos.QuadPart = filePos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize);
-        SetFilePointerEx(pFile->hFileRead, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN);
-        DWORD dwBytesRead;
-        ReadFile(pFile->hFileRead, &ListType, 4, &dwBytesRead, NULL);
-        #else
-        fseeko(pFile->hFileRead, filePos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize), SEEK_SET);
-        fread(&ListType, 4, 1, pFile->hFileRead);
-        #endif // POSIX
+        pFile->__readHeaderData(filePos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize), &ListType, 4);
         #if DEBUG_RIFF
         std::cout << "listType=" << convertToString(ListType) << std::endl;
         #endif // DEBUG_RIFF
@@ -1407,54 +3629,56 @@ namespace RIFF {
         ullNewChunkSize += 4;
         Chunk::WriteHeader(filePos);
         ullNewChunkSize -= 4; // just revert the +4 incrementation
-        #if POSIX
-        lseek(pFile->hFileWrite, filePos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize), SEEK_SET);
-        write(pFile->hFileWrite, &ListType, 4);
-        #elif defined(WIN32)
-        LARGE_INTEGER liFilePos;
-        liFilePos.QuadPart = filePos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize);
-        SetFilePointerEx(pFile->hFileWrite, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN);
-        DWORD dwBytesWritten;
-        WriteFile(pFile->hFileWrite, &ListType, 4, &dwBytesWritten, NULL);
-        #else
-        fseeko(pFile->hFileWrite, filePos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize), SEEK_SET);
-        fwrite(&ListType, 4, 1, pFile->hFileWrite);
-        #endif // POSIX
+        pFile->__deviceWrite(filePos + CHUNK_HEADER_SIZE(pFile->FileOffsetSize), &ListType, 4);
     }
 
     void List::LoadSubChunks(progress_t* pProgress) {
         #if DEBUG_RIFF
         std::cout << "List::LoadSubChunks()";
         #endif // DEBUG_RIFF
-        if (!pSubChunks) {
-            pSubChunks    = new ChunkList();
-            pSubChunksMap = new ChunkMap();
-            #if defined(WIN32)
-            if (pFile->hFileRead == INVALID_HANDLE_VALUE) return;
-            #else
-            if (!pFile->hFileRead) return;
-            #endif
+        if (!bSubChunksLoaded) {
+            bSubChunksLoaded = true;
+            if (!pFile->pDevice->IsOpen()) return;
             file_offset_t ullOriginalPos = GetPos();
             SetPos(0); // jump to beginning of list chunk body
-            while (RemainingBytes() >= CHUNK_HEADER_SIZE(pFile->FileOffsetSize)) {
-                Chunk* ck;
-                uint32_t ckid;
-                Read(&ckid, 4, 1);
-                #if DEBUG_RIFF
-                std::cout << " ckid=" << convertToString(ckid) << std::endl;
-                #endif // DEBUG_RIFF
-                if (ckid == CHUNK_ID_LIST) {
-                    ck = new RIFF::List(pFile, ullStartPos + ullPos - 4, this);
-                    SetPos(ck->GetSize() + LIST_HEADER_SIZE(pFile->FileOffsetSize) - 4, RIFF::stream_curpos);
-                }
-                else { // simple chunk
-                    ck = new RIFF::Chunk(pFile, ullStartPos + ullPos - 4, this);
-                    SetPos(ck->GetSize() + CHUNK_HEADER_SIZE(pFile->FileOffsetSize) - 4, RIFF::stream_curpos);
+            // sub chunk headers are parsed from blocks of the list body, as
+            // long as the sub chunks are small, otherwise (e.g. 'wave' lists
+            // containing sample data) only each header is read individually
+            const file_offset_t ullEnd = ullStartPos + ullCurrentChunkSize;
+            bool bSmallChunks = true;
+            try {
+                while (RemainingBytes() >= file_offset_t(CHUNK_HEADER_SIZE(pFile->FileOffsetSize))) {
+
+                    Chunk* ck;
+                    uint32_t ckid = 0;
+                    const file_offset_t ullHeaderPos = ullStartPos + ullPos;
+                    pFile->__scanBlock(
+                        ullHeaderPos,
+                        (bSmallChunks) ? LIST_SCAN_BLOCK_SIZE : LIST_HEADER_SIZE(pFile->FileOffsetSize),
+                        ullEnd
+                    );
+                    pFile->__readHeaderData(ullHeaderPos, &ckid, 4);
+                    #if DEBUG_RIFF
+                    std::cout << " ckid=" << convertToString(ckid) << std::endl;
+                    #endif // DEBUG_RIFF
+                    if (ckid == CHUNK_ID_LIST) {
+                        ck = new (pFile) RIFF::List(pFile, ullHeaderPos, this);
+                        SetPos(ck->GetSize() + LIST_HEADER_SIZE(pFile->FileOffsetSize), RIFF::stream_curpos);
+                    }
+                    else { // simple chunk
+                        ck = new (pFile) RIFF::Chunk(pFile, ullHeaderPos, this);
+                        SetPos(ck->GetSize() + CHUNK_HEADER_SIZE(pFile->FileOffsetSize), RIFF::stream_curpos);
+                    }
+                    SubChunks.push_back(ck);
+                    __indexChunk(ck);
+                    if (GetPos() % 2 != 0) SetPos(1, RIFF::stream_curpos); // jump over pad byte
+                    bSmallChunks = ck->GetSize() < LIST_SCAN_BLOCK_SIZE / 4;
                 }
-                pSubChunks->push_back(ck);
-                (*pSubChunksMap)[ckid] = ck;
-                if (GetPos() % 2 != 0) SetPos(1, RIFF::stream_curpos); // jump over pad byte
+            } catch (...) {
+                pFile->ScanBuffer.clear();
+                throw;
             }
+            pFile->ScanBuffer.clear();
             SetPos(ullOriginalPos); // restore position before this call
         }
         __notify_progress(pProgress, 1.0); // notify done
@@ -1496,37 +3720,78 @@ namespace RIFF {
             throw Exception("Cannot write list chunk, file has to be opened in read+write mode");
 
         // write all subchunks (including sub list chunks) recursively
-        if (pSubChunks) {
-            size_t i = 0;
-            const size_t n = pSubChunks->size();
-            for (ChunkList::iterator iter = pSubChunks->begin(), end = pSubChunks->end(); iter != end; ++iter, ++i) {
-                // divide local progress into subprogress for loading current Instrument
-                progress_t subprogress;
-                __divide_progress(pProgress, &subprogress, n, i);
-                // do the actual work
-                ullWritePos = (*iter)->WriteChunk(ullWritePos, ullCurrentDataOffset, &subprogress);
-            }
+        const size_t n = SubChunks.size();
+        for (size_t i = 0; i < n; ++i) {
+            // divide local progress into subprogress for loading current Instrument
+            progress_t subprogress;
+            __divide_progress(pProgress, &subprogress, n, i);
+            // do the actual work
+            ullWritePos = SubChunks[i]->WriteChunk(ullWritePos, ullCurrentDataOffset, &subprogress);
         }
 
-        // update this list chunk's header
-        ullCurrentChunkSize = ullNewChunkSize = ullWritePos - ullOriginalPos - LIST_HEADER_SIZE(pFile->FileOffsetSize);
-        WriteHeader(ullOriginalPos);
+        // update this list chunk's header (if it changed at all)
+        ullNewChunkSize = ullWritePos - ullOriginalPos - LIST_HEADER_SIZE(pFile->FileOffsetSize);
+        if (!__isUnchanged(ullOriginalPos + LIST_HEADER_SIZE(pFile->FileOffsetSize), ullCurrentDataOffset))
+            WriteHeader(ullOriginalPos);
 
         // offset of this list chunk in new written file may have changed
-        ullStartPos = ullOriginalPos + LIST_HEADER_SIZE(pFile->FileOffsetSize);
+        __setWritten(ullOriginalPos + LIST_HEADER_SIZE(pFile->FileOffsetSize));
 
          __notify_progress(pProgress, 1.0); // notify done
 
         return ullWritePos;
     }
 
+    /**
+     * Prepares all sub chunks of this list for being written to
+     * @a ullWritePos by WriteChunk() (see Chunk::__planWrite()).
+     *
+     * @param ullWritePos - position the list chunk will be written to
+     * @param plan        - layout decisions being collected by File::Save()
+     */
+    file_offset_t List::__planWrite(file_offset_t ullWritePos, save_plan_t& plan) {
+        if (!bSubChunksLoaded) LoadSubChunks();
+        ullWritePos += LIST_HEADER_SIZE(pFile->FileOffsetSize);
+        for (size_t i = 0; i < SubChunks.size(); ++i)
+            ullWritePos = SubChunks[i]->__planWrite(ullWritePos, plan);
+        return ullWritePos;
+    }
+
+    /**
+     * Writes this list chunk strictly sequentially to @a ullWritePos of
+     * the write device: the list header first (with the list size being
+     * calculated in advance), followed by all sub chunks (see
+     * Chunk::__writeSequential()).
+     */
+    file_offset_t List::__writeSequential(file_offset_t ullWritePos, chunk_source_t Source, void* pUserData, progress_t* pProgress) {
+        const file_offset_t ullOriginalPos = ullWritePos;
+        ullNewChunkSize = RequiredPhysicalSize(pFile->FileOffsetSize) - LIST_HEADER_SIZE(pFile->FileOffsetSize);
+        WriteHeader(ullOriginalPos);
+        ullWritePos += LIST_HEADER_SIZE(pFile->FileOffsetSize);
+
+        // write all subchunks (including sub list chunks) recursively
+        const size_t n = SubChunks.size();
+        for (size_t i = 0; i < n; ++i) {
+            // divide local progress into subprogress for current sub chunk
+            progress_t subprogress;
+            __divide_progress(pProgress, &subprogress, n, i);
+            // do the actual work
+            ullWritePos = SubChunks[i]->__writeSequential(ullWritePos, Source, pUserData, &subprogress);
+        }
+
+        ullCurrentChunkSize = ullNewChunkSize;
+        ullStartPos = ullOriginalPos + LIST_HEADER_SIZE(pFile->FileOffsetSize);
+        bModified   = false;
+
+        __notify_progress(pProgress, 1.0); // notify done
+
+        return ullWritePos;
+    }
+
     void List::__resetPos() {
         Chunk::__resetPos();
-        if (pSubChunks) {
-            for (ChunkList::iterator iter = pSubChunks->begin(), end = pSubChunks->end(); iter != end; ++iter) {
-                (*iter)->__resetPos();
-            }
-        }
+        for (size_t i = 0; i < SubChunks.size(); ++i)
+            SubChunks[i]->__resetPos();
     }
 
     /**
@@ -1557,13 +3822,27 @@ namespace RIFF {
      */
     File::File(uint32_t FileType)
         : List(this), bIsNewFile(true), Layout(layout_standard),
-          FileOffsetPreference(offset_size_auto)
+          FileOffsetPreference(offset_size_auto),
+          IOBackend(io_backend_file),
+          pMappedData(NULL),
+          ullMappedSize(0),
+          pChunkArena(NULL),
+          ullSlackSize(0),
+          bRewriteAll(false),
+          AllocPolicy(alloc_policy_sparse),
+          ullAllocHeadroom(0),
+          Statistics(),
+          pTracer(NULL),
+          UnbufferedAlignment(0),
+          NumaNode(numa_node_default),
+          SaveMode(save_mode_in_place),
+          WriteBackend(write_backend_file),
+          SaveReaders(0),
+          SaveCommitting(0),
+          pSaveCommit(NULL),
+          CacheID(newBlockCacheID())
     {
-        #if defined(WIN32)
-        hFileRead = hFileWrite = INVALID_HANDLE_VALUE;
-        #else
-        hFileRead = hFileWrite = 0;
-        #endif
+        pDevice = pWriteDevice = new FileIODevice("");
         Mode = stream_mode_closed;
         bEndianNative = true;
         ListType = FileType;
@@ -1580,8 +3859,26 @@ namespace RIFF {
      *                         given RIFF file
      */
     File::File(const String& path)
-        : List(this), Filename(path), bIsNewFile(false), Layout(layout_standard),
-          FileOffsetPreference(offset_size_auto)
+        : List(this), pDevice(NULL), pWriteDevice(NULL), Filename(path), bIsNewFile(false), Layout(layout_standard),
+          FileOffsetPreference(offset_size_auto),
+          IOBackend(io_backend_file),
+          pMappedData(NULL),
+          ullMappedSize(0),
+          pChunkArena(NULL),
+          ullSlackSize(0),
+          bRewriteAll(false),
+          AllocPolicy(alloc_policy_sparse),
+          ullAllocHeadroom(0),
+          Statistics(),
+          pTracer(NULL),
+          UnbufferedAlignment(0),
+          NumaNode(numa_node_default),
+          SaveMode(save_mode_in_place),
+          WriteBackend(write_backend_file),
+          SaveReaders(0),
+          SaveCommitting(0),
+          pSaveCommit(NULL),
+          CacheID(newBlockCacheID())
     {
         #if DEBUG_RIFF
         std::cout << "File::File("<<path<<")" << std::endl;
@@ -1589,7 +3886,132 @@ namespace RIFF {
         bEndianNative = true;
         FileOffsetSize = 4;
         try {
-            __openExistingFile(path);
+            __openExistingFile(path);
+            if (ChunkID != CHUNK_ID_RIFF && ChunkID != CHUNK_ID_RIFX) {
+                throw RIFF::Exception("Not a RIFF file");
+            }
+        }
+        catch (...) {
+            Cleanup();
+            throw;
+        }
+    }
+
+    /** @brief Load existing RIFF-like file.
+     *
+     * Loads an existing file, which is not a "real" RIFF file, but similar to
+     * an ordinary RIFF file.
+     *
+     * A "real" RIFF file contains at top level a List chunk either with chunk
+     * ID "RIFF" or "RIFX". The simple constructor above expects this to be
+     * case, and if it finds the toplevel List chunk to have another chunk ID
+     * than one of those two expected ones, it would throw an Exception and
+     * would refuse to load the file accordingly.
+     *
+     * Since there are however a lot of file formats which use the same simple
+     * principles of the RIFF format, with another toplevel List chunk ID
+     * though, you can use this alternative constructor here to be able to load
+     * and handle those files in the same way as you would do with "real" RIFF
+     * files.
+     *
+     * @param path - path and file name of the RIFF-alike file to be opened
+     * @param FileType - expected toplevel List chunk ID (this is the very
+     *                   first chunk found in the file)
+     * @param Endian - whether the file uses little endian or big endian layout
+     * @param layout - general file structure type
+     * @param fileOffsetSize - (optional) preference how to deal with large files
+     * @throws RIFF::Exception if error occurred while trying to load the
+     *                         given RIFF-alike file
+     */
+    File::File(const String& path, uint32_t FileType, endian_t Endian, layout_t layout, offset_size_t fileOffsetSize)
+        : List(this), pDevice(NULL), pWriteDevice(NULL), Filename(path), bIsNewFile(false), Layout(layout),
+          FileOffsetPreference(fileOffsetSize),
+          IOBackend(io_backend_file),
+          pMappedData(NULL),
+          ullMappedSize(0),
+          pChunkArena(NULL),
+          ullSlackSize(0),
+          bRewriteAll(false),
+          AllocPolicy(alloc_policy_sparse),
+          ullAllocHeadroom(0),
+          Statistics(),
+          pTracer(NULL),
+          UnbufferedAlignment(0),
+          NumaNode(numa_node_default),
+          SaveMode(save_mode_in_place),
+          WriteBackend(write_backend_file),
+          SaveReaders(0),
+          SaveCommitting(0),
+          pSaveCommit(NULL),
+          CacheID(newBlockCacheID())
+    {
+        SetByteOrder(Endian);
+        if (fileOffsetSize < offset_size_auto || fileOffsetSize > offset_size_64bit)
+            throw Exception("Invalid RIFF::offset_size_t");
+        FileOffsetSize = 4;
+        try {
+            __openExistingFile(path, &FileType);
+        }
+        catch (...) {
+            Cleanup();
+            throw;
+        }
+    }
+
+    /** @brief Load existing RIFF file from memory.
+     *
+     * Loads an existing RIFF file with all its chunks from the memory region
+     * given by @a pData and @a Size, without any file I/O. This allows for
+     * example to load instruments embedded into an application binary or
+     * received over network. To load a DLS, gig or SoundFont file from
+     * memory, pass the resulting RIFF::File object to the constructor of
+     * DLS::File, gig::File or sf2::File respectively.
+     *
+     * By default the memory region is borrowed: it is accessed directly
+     * and must remain valid and unchanged as long as this File object
+     * exists; the file is read-only in this case, so Save() fails, whereas
+     * Save(const String&) may still be used to write the (modified) file to
+     * disk. If @a bCopy is @c true, a private copy of the data is made
+     * instead, which is also modified by Save().
+     *
+     * The I/O backend io_backend_mmap is selected by default, so chunk data
+     * is served directly from the memory region (see Chunk::GetMappedData()).
+     *
+     * @param pData - start of the RIFF file's data in memory
+     * @param Size - size of the RIFF file's data (in bytes)
+     * @param bCopy - (optional) whether a private copy of the data shall be
+     *                made (default: @c false)
+     * @throws RIFF::Exception if error occurred while trying to load the
+     *                         RIFF file from the given memory region
+     */
+    File::File(const void* pData, file_offset_t Size, bool bCopy)
+        : List(this), pDevice(new MemoryIODevice(pData, Size, bCopy)), Filename(""), bIsNewFile(false), Layout(layout_standard),
+          FileOffsetPreference(offset_size_auto),
+          IOBackend(io_backend_mmap),
+          pMappedData(NULL),
+          ullMappedSize(0),
+          pChunkArena(NULL),
+          ullSlackSize(0),
+          bRewriteAll(false),
+          AllocPolicy(alloc_policy_sparse),
+          ullAllocHeadroom(0),
+          Statistics(),
+          pTracer(NULL),
+          UnbufferedAlignment(0),
+          NumaNode(numa_node_default),
+          SaveMode(save_mode_in_place),
+          WriteBackend(write_backend_file),
+          SaveReaders(0),
+          SaveCommitting(0),
+          pSaveCommit(NULL),
+          CacheID(newBlockCacheID())
+    {
+        pWriteDevice = pDevice;
+        bEndianNative = true;
+        FileOffsetSize = 4;
+        try {
+            Mode = stream_mode_read;
+            __loadTree(NULL);
             if (ChunkID != CHUNK_ID_RIFF && ChunkID != CHUNK_ID_RIFX) {
                 throw RIFF::Exception("Not a RIFF file");
             }
@@ -1600,42 +4022,55 @@ namespace RIFF {
         }
     }
 
-    /** @brief Load existing RIFF-like file.
-     *
-     * Loads an existing file, which is not a "real" RIFF file, but similar to
-     * an ordinary RIFF file.
+    /** @brief Load existing RIFF file from a custom I/O device.
      *
-     * A "real" RIFF file contains at top level a List chunk either with chunk
-     * ID "RIFF" or "RIFX". The simple constructor above expects this to be
-     * case, and if it finds the toplevel List chunk to have another chunk ID
-     * than one of those two expected ones, it would throw an Exception and
-     * would refuse to load the file accordingly.
+     * Loads an existing RIFF file with all its chunks, like the constructor
+     * taking a path, but performs all I/O through the given @a pDevice
+     * instead of a regular file. This allows to read (and write) RIFF files
+     * for example from archives, network streams or memory buffers.
      *
-     * Since there are however a lot of file formats which use the same simple
-     * principles of the RIFF format, with another toplevel List chunk ID
-     * though, you can use this alternative constructor here to be able to load
-     * and handle those files in the same way as you would do with "real" RIFF
-     * files.
+     * The File object takes ownership of the device, which is deleted when
+     * the File object is destroyed. Saving with Save() writes back to the
+     * same device (which has to support WriteAt() and Resize() for that
+     * purpose), whereas Save(const String&) writes to a regular file
+     * and continues to use that file afterwards.
      *
-     * @param path - path and file name of the RIFF-alike file to be opened
-     * @param FileType - expected toplevel List chunk ID (this is the very
-     *                   first chunk found in the file)
-     * @param Endian - whether the file uses little endian or big endian layout
-     * @param layout - general file structure type
-     * @param fileOffsetSize - (optional) preference how to deal with large files
+     * @param pDevice - I/O device providing the RIFF file's data
      * @throws RIFF::Exception if error occurred while trying to load the
-     *                         given RIFF-alike file
+     *                         RIFF file from the given device
      */
-    File::File(const String& path, uint32_t FileType, endian_t Endian, layout_t layout, offset_size_t fileOffsetSize)
-        : List(this), Filename(path), bIsNewFile(false), Layout(layout),
-          FileOffsetPreference(fileOffsetSize)
+    File::File(IODevice* pDevice)
+        : List(this), pDevice(pDevice), pWriteDevice(pDevice), Filename(""), bIsNewFile(false), Layout(layout_standard),
+          FileOffsetPreference(offset_size_auto),
+          IOBackend(io_backend_file),
+          pMappedData(NULL),
+          ullMappedSize(0),
+          pChunkArena(NULL),
+          ullSlackSize(0),
+          bRewriteAll(false),
+          AllocPolicy(alloc_policy_sparse),
+          ullAllocHeadroom(0),
+          Statistics(),
+          pTracer(NULL),
+          UnbufferedAlignment(0),
+          NumaNode(numa_node_default),
+          SaveMode(save_mode_in_place),
+          WriteBackend(write_backend_file),
+          SaveReaders(0),
+          SaveCommitting(0),
+          pSaveCommit(NULL),
+          CacheID(newBlockCacheID())
     {
-        SetByteOrder(Endian);
-        if (fileOffsetSize < offset_size_auto || fileOffsetSize > offset_size_64bit)
-            throw Exception("Invalid RIFF::offset_size_t");
+        if (!pDevice) throw Exception("No I/O device given");
+        bEndianNative = true;
         FileOffsetSize = 4;
         try {
-            __openExistingFile(path, &FileType);
+            pDevice->SetMode(stream_mode_read);
+            Mode = stream_mode_read;
+            __loadTree(NULL);
+            if (ChunkID != CHUNK_ID_RIFF && ChunkID != CHUNK_ID_RIFX) {
+                throw RIFF::Exception("Not a RIFF file");
+            }
         }
         catch (...) {
             Cleanup();
@@ -1643,6 +4078,115 @@ namespace RIFF {
         }
     }
 
+    namespace {
+        inline probe_status_t _probeStatus(probe_result_t* pResult, probe_status_t Status, const char* Detail) {
+            if (pResult) {
+                pResult->Status = Status;
+                pResult->Detail = Detail;
+            }
+            return Status;
+        }
+    }
+
+    /** @brief Check whether a file is a RIFF file without loading it.
+     *
+     * Only reads the RIFF header at the beginning of the file and checks
+     * its chunk ID and (optionally) its form type. No exception is thrown
+     * and no message string is formatted if the file is not a RIFF file
+     * (of the expected type), which makes this method suitable for quickly
+     * sorting out foreign files when scanning large directory trees.
+     *
+     * @param path - path and file name of the file to be checked
+     * @param FileType - (optional) expected form type of the RIFF file
+     *                   (i.e. RIFF_TYPE_DLS), 0 for accepting any type
+     * @param pResult - (optional) receives the details about the file
+     * @returns probe_ok if the file is a RIFF file of the expected type
+     */
+    probe_status_t File::Probe(const String& path, uint32_t FileType, probe_result_t* pResult) {
+        if (pResult) *pResult = probe_result_t();
+        uint8_t header[RIFF_HEADER_SIZE(8)];
+        file_offset_t fileSize = 0, headerSize = 0;
+        #if POSIX
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return _probeStatus(pResult, probe_open_error, "Could not open file");
+        struct stat st;
+        if (fstat(fd, &st) == 0) fileSize = st.st_size;
+        const ssize_t n = pread(fd, header, sizeof(header), 0);
+        close(fd);
+        if (n < 0) return _probeStatus(pResult, probe_open_error, "Could not read file");
+        headerSize = n;
+        #elif defined(WIN32)
+        HANDLE hFile = CreateFile(
+            path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+        );
+        if (hFile == INVALID_HANDLE_VALUE) return _probeStatus(pResult, probe_open_error, "Could not open file");
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(hFile, &size)) fileSize = size.QuadPart;
+        DWORD n = 0;
+        const BOOL ok = ReadFile(hFile, header, sizeof(header), &n, NULL);
+        CloseHandle(hFile);
+        if (!ok) return _probeStatus(pResult, probe_open_error, "Could not read file");
+        headerSize = n;
+        #else // standard C functions
+        FILE* hFile = fopen(path.c_str(), "rb");
+        if (!hFile) return _probeStatus(pResult, probe_open_error, "Could not open file");
+        if (fseeko(hFile, 0, SEEK_END) == 0) fileSize = ftello(hFile);
+        fseeko(hFile, 0, SEEK_SET);
+        headerSize = fread(header, 1, sizeof(header), hFile);
+        const bool ok = !ferror(hFile);
+        fclose(hFile);
+        if (!ok) return _probeStatus(pResult, probe_open_error, "Could not read file");
+        #endif // POSIX
+        if (pResult) pResult->FileSize = fileSize;
+        // same offset size File::__loadTree() decides for (by default)
+        const int offsetSize = (fileSize >> 32) ? 8 : 4;
+        if (headerSize < file_offset_t(RIFF_HEADER_SIZE(offsetSize)))
+
+            return _probeStatus(pResult, probe_truncated, "File too short for a RIFF header");
+        uint32_t ckid, type;
+        memcpy(&ckid, &header[0], 4);
+        memcpy(&type, &header[CHUNK_HEADER_SIZE(offsetSize)], 4);
+        if (ckid != CHUNK_ID_RIFF && ckid != CHUNK_ID_RIFX)
+            return _probeStatus(pResult, probe_not_riff, "Not a RIFF file");
+        if (pResult) {
+            pResult->FileType       = type;
+            pResult->FileOffsetSize = offsetSize;
+            #if WORDS_BIGENDIAN
+            pResult->Endian = (ckid == CHUNK_ID_RIFF) ? endian_little : endian_big;
+            #else
+            pResult->Endian = (ckid == CHUNK_ID_RIFX) ? endian_big : endian_little;
+            #endif
+        }
+        if (FileType && type != FileType)
+            return _probeStatus(pResult, probe_wrong_type, "Unexpected RIFF form type");
+        return _probeStatus(pResult, probe_ok, "OK");
+    }
+
+    /** @brief Load an existing RIFF file without throwing exceptions.
+     *
+     * Checks the file with Probe() first and only loads it if it is a
+     * RIFF file of the expected type. In contrast to the constructor
+     * taking a path, this method never throws: failures are reported by
+     * returning NULL and by @a pResult instead.
+     *
+     * @param path - path and file name of the RIFF file to be loaded
+     * @param FileType - (optional) expected form type of the RIFF file
+     *                   (i.e. RIFF_TYPE_DLS), 0 for accepting any type
+     * @param pResult - (optional) receives the reason of a failure
+     * @returns new File object (to be deleted by the caller), NULL on
+     *          failure
+     */
+    File* File::TryOpen(const String& path, uint32_t FileType, probe_result_t* pResult) {
+        if (Probe(path, FileType, pResult) != probe_ok) return NULL;
+        try {
+            return new File(path);
+        } catch (...) {
+            _probeStatus(pResult, probe_invalid, "Invalid RIFF chunk tree");
+            return NULL;
+        }
+    }
+
     /**
      * Opens an already existing RIFF file or RIFF-alike file. This method
      * shall only be called once (in a File class constructor).
@@ -1654,30 +4198,22 @@ namespace RIFF {
      *                         given RIFF file or RIFF-alike file
      */
     void File::__openExistingFile(const String& path, uint32_t* FileType) {
-        #if POSIX
-        hFileRead = hFileWrite = open(path.c_str(), O_RDONLY | O_NONBLOCK);
-        if (hFileRead == -1) {
-            hFileRead = hFileWrite = 0;
-            String sError = strerror(errno);
-            throw RIFF::Exception("Can't open \"" + path + "\": " + sError);
-        }
-        #elif defined(WIN32)
-        hFileRead = hFileWrite = CreateFile(
-                                     path.c_str(), GENERIC_READ,
-                                     FILE_SHARE_READ | FILE_SHARE_WRITE,
-                                     NULL, OPEN_EXISTING,
-                                     FILE_ATTRIBUTE_NORMAL |
-                                     FILE_FLAG_RANDOM_ACCESS, NULL
-                                 );
-        if (hFileRead == INVALID_HANDLE_VALUE) {
-            hFileRead = hFileWrite = INVALID_HANDLE_VALUE;
-            throw RIFF::Exception("Can't open \"" + path + "\"");
-        }
-        #else
-        hFileRead = hFileWrite = fopen(path.c_str(), "rb");
-        if (!hFileRead) throw RIFF::Exception("Can't open \"" + path + "\"");
-        #endif // POSIX
+        FileIODevice* pFileDevice = new FileIODevice(path);
+        pDevice = pWriteDevice = pFileDevice;
+        pFileDevice->Open();
         Mode = stream_mode_read;
+        __loadTree(FileType);
+    }
+
+    /**
+     * Loads the chunk tree of the RIFF file (or RIFF-alike file) from the
+     * I/O device, which must already be opened in read mode.
+     *
+     * @param FileType - (optional) expected chunk ID of first chunk in file
+     * @throws RIFF::Exception if the file's content is invalid
+     */
+    void File::__loadTree(uint32_t* FileType) {
+        __mapFile();
 
         // determine RIFF file offset size to be used (in RIFF chunk headers)
         // according to the current file offset preference
@@ -1736,92 +4272,20 @@ namespace RIFF {
      */
     bool File::SetMode(stream_mode_t NewMode) {
         if (NewMode != Mode) {
+            __unmapFile();
             switch (NewMode) {
                 case stream_mode_read:
-                    #if POSIX
-                    if (hFileRead) close(hFileRead);
-                    hFileRead = hFileWrite = open(Filename.c_str(), O_RDONLY | O_NONBLOCK);
-                    if (hFileRead == -1) {
-                        hFileRead = hFileWrite = 0;
-                        String sError = strerror(errno);
-                        throw Exception("Could not (re)open file \"" + Filename + "\" in read mode: " + sError);
-                    }
-                    #elif defined(WIN32)
-                    if (hFileRead != INVALID_HANDLE_VALUE) CloseHandle(hFileRead);
-                    hFileRead = hFileWrite = CreateFile(
-                                                 Filename.c_str(), GENERIC_READ,
-                                                 FILE_SHARE_READ | FILE_SHARE_WRITE,
-                                                 NULL, OPEN_EXISTING,
-                                                 FILE_ATTRIBUTE_NORMAL |
-                                                 FILE_FLAG_RANDOM_ACCESS,
-                                                 NULL
-                                             );
-                    if (hFileRead == INVALID_HANDLE_VALUE) {
-                        hFileRead = hFileWrite = INVALID_HANDLE_VALUE;
-                        throw Exception("Could not (re)open file \"" + Filename + "\" in read mode");
-                    }
-                    #else
-                    if (hFileRead) fclose(hFileRead);
-                    hFileRead = hFileWrite = fopen(Filename.c_str(), "rb");
-                    if (!hFileRead) throw Exception("Could not (re)open file \"" + Filename + "\" in read mode");
-                    #endif
+                    pDevice->SetMode(NewMode);
                     __resetPos(); // reset read/write position of ALL 'Chunk' objects
+                    Mode = NewMode;
+                    __mapFile();
                     break;
                 case stream_mode_read_write:
-                    #if POSIX
-                    if (hFileRead) close(hFileRead);
-                    hFileRead = hFileWrite = open(Filename.c_str(), O_RDWR | O_NONBLOCK);
-                    if (hFileRead == -1) {
-                        hFileRead = hFileWrite = open(Filename.c_str(), O_RDONLY | O_NONBLOCK);
-                        String sError = strerror(errno);
-                        throw Exception("Could not open file \"" + Filename + "\" in read+write mode: " + sError);
-                    }
-                    #elif defined(WIN32)
-                    if (hFileRead != INVALID_HANDLE_VALUE) CloseHandle(hFileRead);
-                    hFileRead = hFileWrite = CreateFile(
-                                                 Filename.c_str(),
-                                                 GENERIC_READ | GENERIC_WRITE,
-                                                 FILE_SHARE_READ,
-                                                 NULL, OPEN_ALWAYS,
-                                                 FILE_ATTRIBUTE_NORMAL |
-                                                 FILE_FLAG_RANDOM_ACCESS,
-                                                 NULL
-                                             );
-                    if (hFileRead == INVALID_HANDLE_VALUE) {
-                        hFileRead = hFileWrite = CreateFile(
-                                                     Filename.c_str(), GENERIC_READ,
-                                                     FILE_SHARE_READ | FILE_SHARE_WRITE,
-                                                     NULL, OPEN_EXISTING,
-                                                     FILE_ATTRIBUTE_NORMAL |
-                                                     FILE_FLAG_RANDOM_ACCESS,
-                                                     NULL
-                                                 );
-                        throw Exception("Could not (re)open file \"" + Filename + "\" in read+write mode");
-                    }
-                    #else
-                    if (hFileRead) fclose(hFileRead);
-                    hFileRead = hFileWrite = fopen(Filename.c_str(), "r+b");
-                    if (!hFileRead) {
-                        hFileRead = hFileWrite = fopen(Filename.c_str(), "rb");
-                        throw Exception("Could not open file \"" + Filename + "\" in read+write mode");
-                    }
-                    #endif
+                    pDevice->SetMode(NewMode);
                     __resetPos(); // reset read/write position of ALL 'Chunk' objects
                     break;
                 case stream_mode_closed:
-                    #if POSIX
-                    if (hFileRead)  close(hFileRead);
-                    if (hFileWrite) close(hFileWrite);
-                    hFileRead = hFileWrite = 0;
-                    #elif defined(WIN32)
-                    if (hFileRead  != INVALID_HANDLE_VALUE) CloseHandle(hFileRead);
-                    if (hFileWrite != INVALID_HANDLE_VALUE) CloseHandle(hFileWrite);
-                    hFileRead = hFileWrite = INVALID_HANDLE_VALUE;
-                    #else
-                    if (hFileRead)  fclose(hFileRead);
-                    if (hFileWrite) fclose(hFileWrite);
-                    hFileRead = hFileWrite = NULL;
-                    #endif
+                    pDevice->SetMode(NewMode);
                     break;
                 default:
                     throw Exception("Unknown file access mode");
@@ -1852,19 +4316,31 @@ namespace RIFF {
     /** @brief Save changes to same file.
      *
      * Make all changes of all chunks persistent by writing them to the
-     * actual (same) file.
+     * actual (same) file. With save_mode_replace (see SetSaveMode()) the
+     * file is written to a new file which replaces the original file at
+     * the end, so chunks may be read by other threads while saving.
      *
      * @param pProgress - optional: callback function for progress notification
      * @throws RIFF::Exception if there is an empty chunk or empty list
      *                         chunk or any kind of IO error occurred
+     * @throws CancelException if progress_t::cancel was set by the progress
+     *                         callback before writing started
      */
     void File::Save(progress_t* pProgress) {
         //TODO: implementation for the case where first chunk is not a global container (List chunk) is not implemented yet (i.e. Korg files)
         if (Layout == layout_flat)
             throw Exception("Saving a RIFF file with layout_flat is not implemented yet");
 
+        if (SaveMode == save_mode_replace && !bIsNewFile) {
+            if (Filename.empty() || !dynamic_cast<FileIODevice*>(pDevice))
+                throw Exception("Saving with save_mode_replace requires a regular file");
+            __saveTo(Filename + ".tmp", Filename, pProgress);
+            return;
+        }
+
         // make sure the RIFF tree is built (from the original file)
         {
+            trace_scope_t trace(pTracer, trace_save_begin, this, 0, 0, "load chunks");
             // divide progress into subprogress
             progress_t subprogress;
             __divide_progress(pProgress, &subprogress, 3.f, 0.f); // arbitrarily subdivided into 1/3 of total progress
@@ -1873,6 +4349,8 @@ namespace RIFF {
             // notify subprogress done
             __notify_progress(&subprogress, 1.f);
         }
+        // writing can not be cancelled anymore once it started
+        if (__cancel_requested(pProgress)) throw CancelException();
 
         // reopen file in write mode
         SetMode(stream_mode_read_write);
@@ -1881,66 +4359,53 @@ namespace RIFF {
         const file_offset_t workingFileSize = GetCurrentFileSize();
 
         // get the overall file size required to save this file
-        const file_offset_t newFileSize = GetRequiredFileSize(FileOffsetPreference);
+        file_offset_t newFileSize = GetRequiredFileSize(FileOffsetPreference);
 
         // determine whether this file will yield in a large file (>=4GB) and
         // the RIFF file offset size to be used accordingly for all chunks
+        const int iOldFileOffsetSize = FileOffsetSize;
         FileOffsetSize = FileOffsetSizeFor(newFileSize);
 
+        // let the slack chunk (if any) absorb the size changes in front of it
+        if (ullSlackSize) {
+            __adjustSlack();
+            newFileSize = GetRequiredFileSize(FileOffsetPreference);
+            FileOffsetSize = FileOffsetSizeFor(newFileSize);
+        }
+
         // to be able to save the whole file without loading everything into
         // RAM and without having to store the data in a temporary file, we
-        // enlarge the file with the overall positive file size change,
-        // then move current data towards the end of the file by the calculated
-        // positive file size difference and finally update / rewrite the file
-        // by copying the old data back to the right position at the beginning
-        // of the file
+        // enlarge the file if required, then move current data towards the
+        // end of the file by the amount of bytes any chunk would move towards
+        // the end of the file and finally update / rewrite the file by
+        // copying the old data back to the right position at the beginning
+        // of the file; chunks which could be moved without shifting the
+        // whole file are loaded into RAM instead
+        save_plan_t plan;
+        plan.ullShift     = 0;
+        plan.ullRAMBudget = SAVE_RAM_BUDGET;
+        __planWrite(0, plan);
+
+        // all chunk headers have to be rewritten if their format changed
+        bRewriteAll = (FileOffsetSize != iOldFileOffsetSize);
 
         // if there are positive size changes...
-        file_offset_t positiveSizeDiff = 0;
-        if (newFileSize > workingFileSize) {
-            positiveSizeDiff = newFileSize - workingFileSize;
-
+        const file_offset_t positiveSizeDiff = plan.ullShift;
+        const file_offset_t requiredFileSize =
+            (newFileSize > workingFileSize + positiveSizeDiff) ? newFileSize : workingFileSize + positiveSizeDiff;
+        if (requiredFileSize > workingFileSize) {
+            // ... we enlarge this file first ...
+            ResizeFile(requiredFileSize);
+        }
+        if (positiveSizeDiff) {
+            trace_scope_t trace(pTracer, trace_save_begin, this, 0, positiveSizeDiff, "move data");
             // divide progress into subprogress
             progress_t subprogress;
             __divide_progress(pProgress, &subprogress, 3.f, 1.f); // arbitrarily subdivided into 1/3 of total progress
 
-            // ... we enlarge this file first ...
-            ResizeFile(newFileSize);
-
-            // ... and move current data by the same amount towards end of file.
-            int8_t* pCopyBuffer = new int8_t[4096];
-            #if defined(WIN32)
-            DWORD iBytesMoved = 1; // we have to pass it via pointer to the Windows API, thus the correct size must be ensured
-            #else
-            ssize_t iBytesMoved = 1;
-            #endif
-            for (file_offset_t ullPos = workingFileSize, iNotif = 0; iBytesMoved > 0; ++iNotif) {
-                iBytesMoved = (ullPos < 4096) ? ullPos : 4096;
-                ullPos -= iBytesMoved;
-                #if POSIX
-                lseek(hFileRead, ullPos, SEEK_SET);
-                iBytesMoved = read(hFileRead, pCopyBuffer, iBytesMoved);
-                lseek(hFileWrite, ullPos + positiveSizeDiff, SEEK_SET);
-                iBytesMoved = write(hFileWrite, pCopyBuffer, iBytesMoved);
-                #elif defined(WIN32)
-                LARGE_INTEGER liFilePos;
-                liFilePos.QuadPart = ullPos;
-                SetFilePointerEx(hFileRead, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN);
-                ReadFile(hFileRead, pCopyBuffer, iBytesMoved, &iBytesMoved, NULL);
-                liFilePos.QuadPart = ullPos + positiveSizeDiff;
-                SetFilePointerEx(hFileWrite, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN);
-                WriteFile(hFileWrite, pCopyBuffer, iBytesMoved, &iBytesMoved, NULL);
-                #else
-                fseeko(hFileRead, ullPos, SEEK_SET);
-                iBytesMoved = fread(pCopyBuffer, 1, iBytesMoved, hFileRead);
-                fseeko(hFileWrite, ullPos + positiveSizeDiff, SEEK_SET);
-                iBytesMoved = fwrite(pCopyBuffer, 1, iBytesMoved, hFileWrite);
-                #endif
-                if (!(iNotif % 8) && iBytesMoved > 0)
-                    __notify_progress(&subprogress, float(workingFileSize - ullPos) / float(workingFileSize));
-            }
-            delete[] pCopyBuffer;
-            if (iBytesMoved < 0) throw Exception("Could not modify file while trying to enlarge it");
+            // ... and move current data by the required amount towards end of file.
+            if (!__deviceMove(0, positiveSizeDiff, workingFileSize, true, true, &subprogress))
+                throw Exception("Could not modify file while trying to enlarge it");
 
             __notify_progress(&subprogress, 1.f); // notify subprogress done
         }
@@ -1951,133 +4416,582 @@ namespace RIFF {
         progress_t subprogress;
         __divide_progress(pProgress, &subprogress, 3.f, 2.f); // arbitrarily subdivided into 1/3 of total progress
         // do the actual work
-        const file_offset_t finalSize = WriteChunk(0, positiveSizeDiff, &subprogress);
-        const file_offset_t finalActualSize = __GetFileSize(hFileWrite);
+        file_offset_t finalSize;
+        {
+            trace_scope_t trace(pTracer, trace_save_begin, this, 0, 0, "write chunks");
+            finalSize = WriteChunk(0, positiveSizeDiff, &subprogress);
+            trace.SetResult(finalSize);
+        }
+        const file_offset_t finalActualSize = pWriteDevice->GetSize();
         // notify subprogress done
         __notify_progress(&subprogress, 1.f);
 
+        // free chunk data which was only loaded into RAM for saving
+        for (size_t i = 0; i < plan.Loaded.size(); ++i)
+            plan.Loaded[i]->ReleaseChunkData();
+
         // resize file to the final size
         if (finalSize < finalActualSize) ResizeFile(finalSize);
 
-        __notify_progress(pProgress, 1.0); // notify done
+        __notify_progress(pProgress, 1.0); // notify done
+    }
+
+    /** @brief Save changes to another file.
+     *
+     * Make all changes of all chunks persistent by writing them to another
+     * file. <b>Caution:</b> this method is optimized for writing to
+     * <b>another</b> file, do not use it to save the changes to the same
+     * file! Use File::Save() in that case instead! Ignoring this might
+     * result in a corrupted file, especially in case chunks were resized!
+     *
+     * After calling this method, this File object will be associated with
+     * the new file (given by \a path) afterwards.
+     *
+     * @param path - path and file name where everything should be written to
+     * @param pProgress - optional: callback function for progress notification
+     * @throws CancelException if progress_t::cancel was set by the progress
+     *                         callback before writing started
+     */
+    void File::Save(const String& path, progress_t* pProgress) {
+        // with save_mode_replace saving to the file itself is safe as well
+        if (SaveMode == save_mode_replace && !bIsNewFile && path == Filename) {
+            File::Save(pProgress);
+            return;
+        }
+        __saveTo(path, String(), pProgress);
+    }
+
+    /**
+     * Common implementation of Save(const String&) and Save() with
+     * save_mode_replace: writes the whole file to @a path and associates
+     * this File object with it afterwards.
+     *
+     * With save_mode_replace the new chunk positions are not applied
+     * before the new file was completely written (so chunks can still be
+     * read from the original file by other threads meanwhile), then
+     * concurrent chunk reads are blocked for the short time of switching
+     * to the new file, and the new file is renamed to @a finalPath, if
+     * given, replacing the original file.
+     *
+     * @param path      - file to be written
+     * @param finalPath - new name of the written file (empty: @a path)
+     * @param pProgress - optional: callback function for progress notification
+     */
+    void File::__saveTo(const String& path, const String& finalPath, progress_t* pProgress) {
+        //TODO: we should make a check here if somebody tries to write to the same file and automatically call the other Save() method in that case
+
+        //TODO: implementation for the case where first chunk is not a global container (List chunk) is not implemented yet (i.e. Korg files)
+        if (Layout == layout_flat)
+            throw Exception("Saving a RIFF file with layout_flat is not implemented yet");
+
+        // make sure the RIFF tree is built (from the original file)
+        {
+            trace_scope_t trace(pTracer, trace_save_begin, this, 0, 0, "load chunks");
+            // divide progress into subprogress
+            progress_t subprogress;
+            __divide_progress(pProgress, &subprogress, 2.f, 0.f); // arbitrarily subdivided into 1/2 of total progress
+            // do the actual work
+            LoadSubChunksRecursively(&subprogress);
+            // notify subprogress done
+            __notify_progress(&subprogress, 1.f);
+        }
+        // writing can not be cancelled anymore once it started
+        if (__cancel_requested(pProgress)) throw CancelException();
+
+        // (readers keep using the original file's handles while the new
+        // file is written with save_mode_replace)
+        const bool bDefer = (SaveMode == save_mode_replace);
+        const stream_mode_t oldMode = Mode;
+        if (!bIsNewFile && !bDefer) SetMode(stream_mode_read);
+        // open the other (new) file for writing
+        FileIODevice* pFileDevice = new FileIODevice(path);
+        try {
+            pFileDevice->Create();
+        } catch (...) {
+            delete pFileDevice;
+            throw;
+        }
+        pWriteDevice = pFileDevice;
+        Mode = stream_mode_read_write;
+
+        save_commit_t commit;
+        file_offset_t ullTotalSize;
+        // (restored if writing fails with save_mode_replace)
+        const int iOldFileOffsetSize = FileOffsetSize;
+        Chunk* pSlack = (ullSlackSize) ? GetSubChunk(CHUNK_ID_JUNK) : NULL;
+        const file_offset_t ullOldSlackSize = (pSlack) ? pSlack->ullNewChunkSize : 0;
+        const bool bOldSlackModified = (pSlack) ? pSlack->bModified : false;
+        try {
+            if (bDefer) pSaveCommit = &commit;
+
+            // the new file gets the full slack size again
+            if (pSlack && pSlack->GetNewSize() < ullSlackSize)
+                pSlack->Resize(ullSlackSize + ullSlackSize % 2);
+
+            // get the overall file size required to save this file
+            const file_offset_t newFileSize = GetRequiredFileSize(FileOffsetPreference);
+
+            // determine whether this file will yield in a large file (>=4GB) and
+            // the RIFF file offset size to be used accordingly for all chunks
+            FileOffsetSize = FileOffsetSizeFor(newFileSize);
+
+            // write complete RIFF tree to the other (new) file
+            __reserveSpace(newFileSize);
+            const bool bMapped = (WriteBackend == write_backend_mmap) &&
+                                 pFileDevice->MapOutput(newFileSize);
+            {
+                trace_scope_t trace(pTracer, trace_save_begin, this, 0, 0, "write chunks");
+                // divide progress into subprogress
+                progress_t subprogress;
+                __divide_progress(pProgress, &subprogress, 2.f, 1.f); // arbitrarily subdivided into 1/2 of total progress
+                // do the actual work
+                ullTotalSize = WriteChunk(0, 0, &subprogress);
+                trace.SetResult(ullTotalSize);
+                // notify subprogress done
+                __notify_progress(&subprogress, 1.f);
+            }
+            if (bMapped && !pFileDevice->UnmapOutput())
+                throw Exception("Could not write file \"" + path + "\": flushing the mapped file failed");
+            file_offset_t ullActualSize = pWriteDevice->GetSize();
+
+            // resize file to the final size (if the file was originally larger)
+            if (ullActualSize > ullTotalSize) ResizeFile(ullTotalSize);
+        } catch (...) {
+            pSaveCommit = NULL;
+            pFileDevice->UnmapOutput();
+            if (bDefer) { // the original file is still untouched
+                pWriteDevice = pDevice;
+                Mode = oldMode;
+                delete pFileDevice;
+                remove(path.c_str());
+                // ... and so shall be the tree describing it
+                FileOffsetSize = iOldFileOffsetSize;
+                if (pSlack && pSlack->ullNewChunkSize != ullOldSlackSize) {
+                    pSlack->ullNewChunkSize = ullOldSlackSize;
+                    pSlack->bModified = bOldSlackModified;
+                    __invalidateRequiredSize();
+                }
+            }
+            throw;
+        }
+        pSaveCommit = NULL;
+
+        // block concurrent chunk reads while switching to the new file (and
+        // wait for the ones in progress)
+        if (bDefer) {
+            __atomicCompareExchange(SaveCommitting, 0L, 1L);
+            while (__atomicLoadAcquire(SaveReaders)) __yieldThread();
+        }
+
+        bool bRenamed = true;
+        try {
+            // drop the device of the original file
+            __unmapFile();
+            delete pDevice;
+            pDevice = pWriteDevice;
+            __invalidateCache();
+
+            // apply the deferred chunk positions
+            for (size_t i = 0; i < commit.Entries.size(); ++i) {
+                const save_commit_t::entry_t& e = commit.Entries[i];
+                Chunk* pCk = e.pChunk;
+                pCk->ullStartPos         = e.ullStartPos;
+                pCk->ullCurrentChunkSize = e.ullSize;
+                pCk->bModified           = false;
+                if (pCk->ullPos > e.ullSize) pCk->ullPos = e.ullSize;
+                pCk->__releaseReadAhead();
+            }
+
+            // replace the original file by the new one
+            if (!finalPath.empty()) bRenamed = pFileDevice->Rename(finalPath);
+
+            // associate new file with this File object from now on
+            Filename = (bRenamed && !finalPath.empty()) ? finalPath : path;
+            bIsNewFile = false;
+            if (bDefer) {
+                // just reopen the handles, the chunks' read positions are kept
+                pDevice->SetMode(stream_mode_read_write);
+                Mode = stream_mode_read_write;
+            } else {
+                Mode = (stream_mode_t) -1;       // Just set it to an undefined mode ...
+                SetMode(stream_mode_read_write); // ... so SetMode() has to reopen the file handles.
+            }
+            if (UnbufferedAlignment) SetUnbuffered(true); // (for the new device)
+        } catch (...) {
+            if (bDefer) __atomicStoreRelease(SaveCommitting, 0L);
+            throw;
+        }
+        if (bDefer) __atomicStoreRelease(SaveCommitting, 0L);
+
+        if (!bRenamed)
+            throw Exception("Could not replace \"" + finalPath + "\", the file was saved as \"" + path + "\" instead");
+
+        __notify_progress(pProgress, 1.0); // notify done
+    }
+
+    /** @brief Reserve space for in-place saving.
+     *
+     * If @a Size is not zero, a 'JUNK' chunk of (at least) that size is kept
+     * in the root list chunk of the file. File formats built on top of this
+     * class (e.g. DLS::File) create that chunk in front of their bulk data
+     * (i.e. the wave pool), so that subsequent calls of Save() can absorb
+     * modest size changes of the chunks in front of it (e.g. editing an
+     * instrument's articulation or name) by shrinking or enlarging the
+     * 'JUNK' chunk, instead of moving all sample data within the file.
+     *
+     * By default this feature is disabled (@a Size being zero), which
+     * yields in exactly the same file layout as before.
+     *
+     * @param Size - size (in bytes) of the 'JUNK' chunk to be reserved
+     * @see GetSlackSize()
+     */
+    void File::SetSlackSize(file_offset_t Size) {
+        ullSlackSize = Size;
+    }
+
+    /**
+     * Returns the size of the 'JUNK' chunk reserved for in-place saving.
+     *
+     * @see SetSlackSize()
+     */
+    file_offset_t File::GetSlackSize() const {
+        return ullSlackSize;
+    }
+
+    /** @brief Set how disk space is allocated when the file is enlarged.
+     *
+     * By default (@c alloc_policy_sparse) the file is enlarged by just
+     * setting its new size, so the file system allocates the disk space not
+     * before the data is actually written. As Save() writes the enlarged
+     * file piecemeal (and from its end towards its beginning when moving
+     * data), large files may end up heavily fragmented that way, which hurts
+     * their streaming throughput.
+     *
+     * With @c alloc_policy_reserve the disk space of the whole file is
+     * reserved before any data is written to the enlarged file by Save(),
+     * Save(const String&) and SaveSequential(). On Linux the space is
+     * reserved by fallocate(), which additionally reserves @a Headroom
+     * bytes beyond the end of the file (without changing the file size), so
+     * that subsequent saves may enlarge the file without fragmenting it. On
+     * other POSIX systems posix_fallocate() is used, which does not support
+     * any headroom. On Windows the file's allocation size is set (including
+     * the headroom) and, if the process has the SE_MANAGE_VOLUME_NAME
+     * privilege, the valid data length as well, which avoids zero filling
+     * the enlarged area before the data is written. If the file system does
+     * not support any of this, the file is enlarged as with
+     * @c alloc_policy_sparse.
+     *
+     * @param Policy   - allocation policy to be used from now on
+     * @param Headroom - additional space (in bytes) to be reserved beyond
+     *                   the end of the file (@c alloc_policy_reserve only)
+     * @see GetAllocationPolicy(), GetAllocationHeadroom()
+     */
+    void File::SetAllocationPolicy(alloc_policy_t Policy, file_offset_t Headroom) {
+        AllocPolicy      = Policy;
+        ullAllocHeadroom = Headroom;
+    }
+
+    /**
+     * Returns how disk space is allocated when the file is enlarged.
+     *
+     * @see SetAllocationPolicy()
+     */
+    alloc_policy_t File::GetAllocationPolicy() const {
+        return AllocPolicy;
+    }
+
+    /**
+     * Returns the additional disk space (in bytes) reserved beyond the end of
+     * the file with @c alloc_policy_reserve.
+     *
+     * @see SetAllocationPolicy()
+     */
+    file_offset_t File::GetAllocationHeadroom() const {
+        return ullAllocHeadroom;
+    }
+
+    /** @brief Set how Save() writes the file.
+     *
+     * By default (@c save_mode_in_place) Save() rewrites the file in place,
+     * moving chunk data within the file as required. While doing so the
+     * positions of the chunks change and the file's handles are reopened,
+     * so no chunk of the file may be read by any other thread (i.e. by
+     * voices still streaming samples) until Save() returned.
+     *
+     * With @c save_mode_replace Save() writes the complete file to a new
+     * temporary file next to the original one (with ".tmp" appended to the
+     * file name) instead and replaces the original file by it at the end.
+     * The positions of the chunks are not updated before the new file was
+     * completely written, so meanwhile all chunks can still be read by
+     * other threads, from the original file, with Chunk::ReadAt(),
+     * Chunk::ReadUnbufferedAt() and ReadBatch() (and thus by
+     * gig::SampleReader objects for example). Such reads are only blocked
+     * for the short time it takes to switch to the new file. The chunks'
+     * read positions are kept as well. Save(const String&) behaves the same
+     * way in this mode, and may also be used with the file's own path. If
+     * saving fails before the new file was written completely, the
+     * original file is left untouched. This mode requires twice the disk
+     * space of the file while saving, and may only be used for regular
+     * files of the file system.
+     *
+     * Note that only the chunk data read from the file is consistent while
+     * saving this way, the chunk tree itself must not be modified by other
+     * threads while saving, and memory-mapped chunk data (see
+     * Chunk::GetMappedData()) becomes invalid once the file was saved.
+     *
+     * @param Mode - how Save() shall write the file from now on
+     * @see GetSaveMode()
+     */
+    void File::SetSaveMode(save_mode_t Mode) {
+        SaveMode = Mode;
+    }
+
+    /**
+     * Returns how Save() writes the file.
+     *
+     * @see SetSaveMode()
+     */
+    save_mode_t File::GetSaveMode() const {
+        return SaveMode;
+    }
+
+    /** @brief Select method used for writing a new file.
+     *
+     * By default Save(const String&) (and Save() with save_mode_replace)
+     * writes all chunks by the file handle of the new file, i.e. each chunk
+     * header and each chunk body (or each block of it copied from the
+     * original file) costs a system call and usually a copy through a
+     * buffer in user space.
+     *
+     * With write_backend_mmap the new file is sized once to the final size
+     * (see GetRequiredFileSize()), its disk space is allocated and the file
+     * is mapped writable into memory. The chunks loaded into RAM are then
+     * copied directly into the mapped view, and the data still stored in
+     * the original file is read straight into it (or copied from the
+     * original file's mapped view, see SetIOBackend()). At the end the
+     * mapped view is flushed to disk by msync() (FlushViewOfFile() on
+     * Windows), so that all I/O errors are still reported by Save().
+     *
+     * Saving in place (Save() with save_mode_in_place) and
+     * SaveSequential() are not affected. If the new file cannot be mapped
+     * (i.e. its disk space cannot be allocated, or the file is too large
+     * for the address space on 32 bit systems), this silently falls back
+     * to write_backend_file behavior. Note that blocks shared by the file
+     * system between the original and the new file (reflinks, see
+     * Chunk::CopyDataFrom()) are not used with write_backend_mmap.
+     *
+     * @param backend - new write backend to be used
+     * @see GetWriteBackend()
+     */
+    void File::SetWriteBackend(write_backend_t backend) {
+        WriteBackend = backend;
+    }
+
+    /**
+     * Returns the method used for writing a new file.
+     *
+     * @see SetWriteBackend()
+     */
+    write_backend_t File::GetWriteBackend() const {
+        return WriteBackend;
+    }
+
+    /**
+     * Called before the position and size of a chunk are used for reading
+     * it from the file's device. With save_mode_replace this registers the
+     * read, waiting while Save() is switching to the new file, and has to
+     * be followed by __endRead() once the read completed.
+     *
+     * @returns true if __endRead() has to be called
+     */
+    bool File::__beginRead() const {
+        if (SaveMode != save_mode_replace) return false;
+        while (true) {
+            while (__atomicLoadAcquire(SaveCommitting)) __yieldThread();
+            __atomicIncrement(SaveReaders);
+            if (!__atomicLoadAcquire(SaveCommitting)) return true;
+            __atomicDecrement(SaveReaders); // (let Save() switch first)
+        }
+    }
+
+    /// Unregisters a read registered by __beginRead().
+    void File::__endRead() const {
+        __atomicDecrement(SaveReaders);
+    }
+
+    /** @brief Position a chunk will have in the file.
+     *
+     * Returns the position of @a pChunk's header within the file, as it is
+     * going to be stored by the next call of SaveSequential() (or Save() if
+     * no size changes are absorbed by the slack chunk, see SetSlackSize()).
+     * This allows to store file offsets within the file's data before it
+     * is written sequentially.
+     *
+     * @param pChunk         - chunk of this file
+     * @param fileOffsetSize - RIFF file offset size (in bytes) the file is
+     *                         going to be saved with (see
+     *                         GetRequiredFileOffsetSize())
+     */
+    file_offset_t File::GetRequiredFilePos(Chunk* pChunk, int fileOffsetSize) {
+        file_offset_t ullPos = 0;
+        for (Chunk* pCk = pChunk; pCk->pParent; pCk = pCk->pParent) {
+            List* pList = pCk->pParent;
+            if (!pList->bSubChunksLoaded) pList->LoadSubChunks();
+            ullPos += LIST_HEADER_SIZE(fileOffsetSize);
+            for (size_t i = 0; i < pList->SubChunks.size() && pList->SubChunks[i] != pCk; ++i)
+                ullPos += pList->SubChunks[i]->RequiredPhysicalSize(fileOffsetSize);
+        }
+        return ullPos;
+    }
+
+    /**
+     * Resizes the 'JUNK' chunk in the root list chunk (if already stored in
+     * the file) such that all chunks following it remain at their current
+     * position in the file. If that is not possible, because the chunks in
+     * front of it grew by more than the available slack (or shrank by a
+     * lot), the 'JUNK' chunk is reset to the slack size instead.
+     */
+    void File::__adjustSlack() {
+        if (!bSubChunksLoaded) LoadSubChunks();
+        file_offset_t ullDataPos = LIST_HEADER_SIZE(FileOffsetSize);
+        for (size_t i = 0; i < SubChunks.size(); ++i) {
+            Chunk* pCk = SubChunks[i];
+            if (pCk->GetChunkID() != CHUNK_ID_JUNK) {
+                ullDataPos += pCk->RequiredPhysicalSize(FileOffsetSize);
+                continue;
+            }
+            const file_offset_t ullMinSize = ullSlackSize + ullSlackSize % 2;
+            if (!pCk->ullStartPos) { // not yet stored in the file
+                if (pCk->ullNewChunkSize < ullMinSize) pCk->Resize(ullMinSize);
+                return;
+            }
+            ullDataPos += CHUNK_HEADER_SIZE(FileOffsetSize);
+            const file_offset_t ullOldEnd = pCk->ullStartPos + pCk->ullCurrentChunkSize + pCk->ullCurrentChunkSize % 2;
+            if (ullOldEnd >= ullDataPos + 2 && ullOldEnd - ullDataPos <= 16 * ullMinSize)
+                pCk->Resize(ullOldEnd - ullDataPos);
+            else
+                pCk->Resize(ullMinSize);
+            return;
+        }
+    }
+
+    /** @brief Save to another file by strictly sequential writing.
+     *
+     * Same as SaveSequential(IODevice*, chunk_source_t, void*, progress_t*),
+     * writing to the file given by @a path. Pipes (e.g. "/dev/stdout") are
+     * supported as well. An existing file at @a path is truncated first,
+     * since the sink is never resized afterwards.
+     *
+     * @param path      - path and file name where everything should be written to
+     * @param Source    - optional: source of the data of new chunks
+     * @param pUserData - optional: passed to @a Source
+     * @param pProgress - optional: callback function for progress notification
+     * @throws RIFF::Exception on errors
+     */
+    void File::SaveSequential(const String& path, chunk_source_t Source, void* pUserData, progress_t* pProgress) {
+        FileIODevice* pFileDevice = new FileIODevice(path);
+        try {
+            pFileDevice->Create(true);
+        } catch (...) {
+            delete pFileDevice;
+            throw;
+        }
+        SaveSequential(pFileDevice, Source, pUserData, pProgress);
+        Filename = path;
     }
 
-    /** @brief Save changes to another file.
+    /** @brief Save to another device by strictly sequential writing.
      *
-     * Make all changes of all chunks persistent by writing them to another
-     * file. <b>Caution:</b> this method is optimized for writing to
-     * <b>another</b> file, do not use it to save the changes to the same
-     * file! Use File::Save() in that case instead! Ignoring this might
-     * result in a corrupted file, especially in case chunks were resized!
+     * Writes the complete RIFF tree to @a pSink in one pass, in ascending
+     * file order and without ever reading from, seeking on or resizing the
+     * sink, so that files of arbitrary size can be written with constant
+     * memory consumption, even to pipes or network sinks (whose
+     * IODevice::WriteAt() implementation may simply append the data).
+     * Unlike Save(), all chunk headers are written before their data,
+     * so all chunk sizes must be final already, which is the case after
+     * all Resize() calls were made.
      *
-     * After calling this method, this File object will be associated with
-     * the new file (given by \a path) afterwards.
+     * The data of new chunks, which is neither loaded into RAM nor stored
+     * in the file yet (e.g. the wave data of new samples), is requested
+     * from @a Source while writing (or filled with zeros if no source is
+     * given). File offsets stored within the file's data can be
+     * calculated in advance with GetRequiredFilePos(), as the chunk
+     * layout is written exactly as it is.
      *
-     * @param path - path and file name where everything should be written to
+     * This File object takes ownership of @a pSink in any case and is
+     * associated with it after this call. If the sink cannot be read from
+     * (pipes, sockets), this object must not be used for reading chunk
+     * data which is not loaded into RAM anymore.
+     *
+     * @param pSink     - empty device where everything should be written to
+     * @param Source    - optional: source of the data of new chunks
+     * @param pUserData - optional: passed to @a Source
      * @param pProgress - optional: callback function for progress notification
+     * @throws RIFF::Exception on errors
      */
-    void File::Save(const String& path, progress_t* pProgress) {
-        //TODO: we should make a check here if somebody tries to write to the same file and automatically call the other Save() method in that case
-
-        //TODO: implementation for the case where first chunk is not a global container (List chunk) is not implemented yet (i.e. Korg files)
-        if (Layout == layout_flat)
+    void File::SaveSequential(IODevice* pSink, chunk_source_t Source, void* pUserData, progress_t* pProgress) {
+        if (Layout == layout_flat) {
+            delete pSink;
             throw Exception("Saving a RIFF file with layout_flat is not implemented yet");
-
-        // make sure the RIFF tree is built (from the original file)
-        {
-            // divide progress into subprogress
-            progress_t subprogress;
-            __divide_progress(pProgress, &subprogress, 2.f, 0.f); // arbitrarily subdivided into 1/2 of total progress
-            // do the actual work
-            LoadSubChunksRecursively(&subprogress);
-            // notify subprogress done
-            __notify_progress(&subprogress, 1.f);
         }
 
-        if (!bIsNewFile) SetMode(stream_mode_read);
-        // open the other (new) file for writing and truncate it to zero size
-        #if POSIX
-        hFileWrite = open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP);
-        if (hFileWrite == -1) {
-            hFileWrite = hFileRead;
-            String sError = strerror(errno);
-            throw Exception("Could not open file \"" + path + "\" for writing: " + sError);
-        }
-        #elif defined(WIN32)
-        hFileWrite = CreateFile(
-                         path.c_str(), GENERIC_WRITE, FILE_SHARE_READ,
-                         NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL |
-                         FILE_FLAG_RANDOM_ACCESS, NULL
-                     );
-        if (hFileWrite == INVALID_HANDLE_VALUE) {
-            hFileWrite = hFileRead;
-            throw Exception("Could not open file \"" + path + "\" for writing");
-        }
-        #else
-        hFileWrite = fopen(path.c_str(), "w+b");
-        if (!hFileWrite) {
-            hFileWrite = hFileRead;
-            throw Exception("Could not open file \"" + path + "\" for writing");
-        }
-        #endif // POSIX
-        Mode = stream_mode_read_write;
+        try {
+            // make sure the RIFF tree is built (from the original file)
+            {
+                trace_scope_t trace(pTracer, trace_save_begin, this, 0, 0, "load chunks");
+                // divide progress into subprogress
+                progress_t subprogress;
+                __divide_progress(pProgress, &subprogress, 2.f, 0.f); // arbitrarily subdivided into 1/2 of total progress
+                // do the actual work
+                LoadSubChunksRecursively(&subprogress);
+                // notify subprogress done
+                __notify_progress(&subprogress, 1.f);
+            }
 
-        // get the overall file size required to save this file
-        const file_offset_t newFileSize = GetRequiredFileSize(FileOffsetPreference);
+            if (!bIsNewFile) SetMode(stream_mode_read);
+            pWriteDevice = pSink;
+            Mode = stream_mode_read_write;
 
-        // determine whether this file will yield in a large file (>=4GB) and
-        // the RIFF file offset size to be used accordingly for all chunks
-        FileOffsetSize = FileOffsetSizeFor(newFileSize);
+            // determine the RIFF file offset size to be used for all chunks
+            const file_offset_t ullNewFileSize = GetRequiredFileSize(FileOffsetPreference);
+            FileOffsetSize = FileOffsetSizeFor(ullNewFileSize);
+            __reserveSpace(ullNewFileSize);
 
-        // write complete RIFF tree to the other (new) file
-        file_offset_t ullTotalSize;
-        {
-            // divide progress into subprogress
+            // write complete RIFF tree to the sink in one pass
+            trace_scope_t trace(pTracer, trace_save_begin, this, 0, ullNewFileSize, "write chunks");
             progress_t subprogress;
             __divide_progress(pProgress, &subprogress, 2.f, 1.f); // arbitrarily subdivided into 1/2 of total progress
-            // do the actual work
-            ullTotalSize = WriteChunk(0, 0, &subprogress);
-            // notify subprogress done
+            __writeSequential(0, Source, pUserData, &subprogress);
             __notify_progress(&subprogress, 1.f);
+        } catch (...) {
+            pWriteDevice = pDevice;
+            delete pSink;
+            throw;
         }
-        file_offset_t ullActualSize = __GetFileSize(hFileWrite);
-
-        // resize file to the final size (if the file was originally larger)
-        if (ullActualSize > ullTotalSize) ResizeFile(ullTotalSize);
-
-        #if POSIX
-        if (hFileWrite) close(hFileWrite);
-        #elif defined(WIN32)
-        if (hFileWrite != INVALID_HANDLE_VALUE) CloseHandle(hFileWrite);
-        #else
-        if (hFileWrite) fclose(hFileWrite);
-        #endif
-        hFileWrite = hFileRead;
 
-        // associate new file with this File object from now on
-        Filename = path;
+        // drop the device of the original file
+        __unmapFile();
+        delete pDevice;
+        pDevice = pWriteDevice = pSink;
+        __invalidateCache();
         bIsNewFile = false;
-        Mode = (stream_mode_t) -1;       // Just set it to an undefined mode ...
-        SetMode(stream_mode_read_write); // ... so SetMode() has to reopen the file handles.
+        if (UnbufferedAlignment) SetUnbuffered(true); // (for the new device)
 
         __notify_progress(pProgress, 1.0); // notify done
     }
 
     void File::ResizeFile(file_offset_t ullNewSize) {
-        #if POSIX
-        if (ftruncate(hFileWrite, ullNewSize) < 0)
-            throw Exception("Could not resize file \"" + Filename + "\"");
-        #elif defined(WIN32)
-        LARGE_INTEGER liFilePos;
-        liFilePos.QuadPart = ullNewSize;
-        if (
-            !SetFilePointerEx(hFileWrite, liFilePos, NULL/*new pos pointer*/, FILE_BEGIN) ||
-            !SetEndOfFile(hFileWrite)
-        ) throw Exception("Could not resize file \"" + Filename + "\"");
-        #else
-        # error Sorry, this version of libgig only supports POSIX and Windows systems yet.
-        # error Reason: portable implementation of RIFF::File::ResizeFile() is missing (yet)!
-        #endif
+        if (pWriteDevice == pDevice) __invalidateCache();
+        pWriteDevice->Resize(ullNewSize);
+        if (pWriteDevice == pDevice) __invalidateCache();
+        __reserveSpace(ullNewSize);
+    }
+
+    /// Reserves the disk space for a file of @a ullSize bytes according to
+    /// the allocation policy (see SetAllocationPolicy()).
+    void File::__reserveSpace(file_offset_t ullSize) {
+        if (AllocPolicy == alloc_policy_reserve)
+            pWriteDevice->Reserve(ullSize, ullAllocHeadroom);
     }
 
     File::~File() {
@@ -2096,14 +5010,19 @@ namespace RIFF {
     }
 
     void File::Cleanup() {
-        #if POSIX
-        if (hFileRead) close(hFileRead);
-        #elif defined(WIN32)
-        if (hFileRead != INVALID_HANDLE_VALUE) CloseHandle(hFileRead);
-        #else
-        if (hFileRead) fclose(hFileRead);
-        #endif // POSIX
+        {
+            mutex_lock_t lock(blockCache.mutex);
+            blockCache.drop(CacheID);
+        }
+        __unmapFile();
+        if (pWriteDevice && pWriteDevice != pDevice) delete pWriteDevice;
+        if (pDevice) delete pDevice;
+        pDevice = pWriteDevice = NULL;
         DeleteChunkList();
+        if (pChunkArena) {
+            delete pChunkArena;
+            pChunkArena = NULL;
+        }
         pFile = NULL;
     }
 
@@ -2116,7 +5035,7 @@ namespace RIFF {
     file_offset_t File::GetCurrentFileSize() const {
         file_offset_t size = 0;
         try {
-            size = __GetFileSize(hFileRead);
+            size = (pDevice) ? pDevice->GetSize() : 0;
         } catch (...) {
             size = 0;
         }
@@ -2139,40 +5058,720 @@ namespace RIFF {
      * You may also use the overridden method below to get the file size for
      * an arbitrary other file offset size instead.
      *
-     * @see offset_size_t
-     * @see GetFileOffsetSize()
+     * @see offset_size_t
+     * @see GetFileOffsetSize()
+     */
+    file_offset_t File::GetRequiredFileSize() {
+        return GetRequiredFileSize(FileOffsetPreference);
+    }
+
+    /**
+     * Returns the rquired size (in bytes) for this RIFF file to be saved to
+     * disk, assuming the passed @a fileOffsestSize would be used for the
+     * Save() operation.
+     *
+     * This overridden method essentialy behaves like the above method, with
+     * the difference that you must provide a specific RIFF @a fileOffsetSize
+     * for calculating the theoretical final file size.
+     *
+     * @see GetFileOffsetSize()
+     */
+    file_offset_t File::GetRequiredFileSize(offset_size_t fileOffsetSize) {
+        switch (fileOffsetSize) {
+            case offset_size_auto: {
+                file_offset_t fileSize = GetRequiredFileSize(offset_size_32bit);
+                if (fileSize >> 32)
+                    return GetRequiredFileSize(offset_size_64bit);
+                else
+                    return fileSize;
+            }
+            case offset_size_32bit: break;
+            case offset_size_64bit: break;
+            default: throw Exception("Internal error: Invalid RIFF::offset_size_t");
+        }
+        return RequiredPhysicalSize(FileOffsetSize);
+    }
+
+    /** @brief Select method used for reading from the file.
+     *
+     * By default all read operations seek and read on the file handle
+     * (io_backend_file). When selecting io_backend_mmap instead, the whole
+     * file is mapped into the virtual address space of the process as long
+     * as the file is opened in read-only mode, and all Chunk::Read(),
+     * Chunk::LoadChunkData() and chunk header reads are served directly
+     * from that mapped view without any system call. This drastically
+     * reduces the time required for scanning the RIFF tree of large files.
+     *
+     * While the file is in read/write mode (i.e. during Save()) the mapping
+     * is released and the regular file handle is used. If the file cannot
+     * be mapped (e.g. on 32 bit systems with very large files), this
+     * silently falls back to io_backend_file behavior.
+     *
+     * <b>Caution:</b> the file must not be truncated by another process
+     * while it is memory-mapped, otherwise accessing the respective pages
+     * causes a bus error.
+     *
+     * With io_backend_uring, individual reads behave like with
+     * io_backend_file, but ReadBatch() submits all reads of a batch to the
+     * kernel at once by Linux io_uring (respectively by overlapped reads
+     * collected from an I/O completion port on Windows), so the storage
+     * device may process them concurrently. If neither is available (other
+     * systems, old kernels, files opened in read+write mode or if it is
+     * disabled), this silently falls back to io_backend_file behavior.
+     *
+     * @param backend - new I/O backend to be used
+     * @see GetIOBackend()
+     */
+    void File::SetIOBackend(io_backend_t backend) {
+        if (backend == IOBackend) return;
+        IOBackend = backend;
+        if (IOBackend == io_backend_mmap)
+            __mapFile();
+        else
+            __unmapFile();
+    }
+
+    /**
+     * Enables or disables unbuffered reading of bulk data. When enabled,
+     * Chunk::ReadUnbufferedAt() reads directly from the storage device,
+     * bypassing the operating system's page cache (by O_DIRECT on Linux,
+     * F_NOCACHE on macOS and FILE_FLAG_NO_BUFFERING on Windows). This is
+     * meant for applications streaming sample data into their own ring
+     * buffers, for which going through the page cache would occupy the
+     * same amount of memory twice and evict more useful pages. libgig
+     * itself uses unbuffered reads for streaming sample data only (i.e.
+     * Sample::Read(), Sample::ReadAndLoop(), SampleReader and friends);
+     * chunk headers, all other chunks and sample data loaded into RAM
+     * (e.g. by Sample::LoadSampleData() or Instrument::Preload()) are
+     * still read through the page cache as before.
+     *
+     * Unbuffered reading is not available for all files (e.g. for files
+     * held in RAM, custom I/O devices or on file systems not supporting
+     * it), in which case all reads continue to go through the page cache.
+     * It also has no effect as long as the file is memory-mapped (see
+     * SetIOBackend()), as all reads are served from the mapping then.
+     *
+     * @param bUnbuffered - whether to enable unbuffered reading
+     * @returns true if unbuffered reading is enabled now
+     * @see GetUnbufferedAlignment()
+     */
+    bool File::SetUnbuffered(bool bUnbuffered) {
+        UnbufferedAlignment = (pDevice) ? pDevice->EnableUnbuffered(bUnbuffered) : 0;
+        return UnbufferedAlignment;
+    }
+
+    /**
+     * Returns the alignment (in bytes) of file positions, sizes and buffer
+     * addresses required by the operating system for unbuffered reading,
+     * or 0 if unbuffered reading is not enabled (see SetUnbuffered()).
+     * Reads into buffers sharing the alignment of the file position (that
+     * is, the buffer address modulo this value equals the file position
+     * modulo this value) avoid an additional copy.
+     */
+    size_t File::GetUnbufferedAlignment() const {
+        return UnbufferedAlignment;
+    }
+
+    /**
+     * Returns the I/O method currently selected for reading from the file.
+     *
+     * @see SetIOBackend()
+     */
+    io_backend_t File::GetIOBackend() const {
+        return IOBackend;
+    }
+
+    /**
+     * Selects the NUMA node on which sample data of this file shall be
+     * placed from now on when it is loaded into RAM (i.e. by the
+     * LoadSampleData() methods of gig, SoundFont and KORG samples), so on
+     * systems with several NUMA nodes (i.e. multi-socket machines) the data
+     * can reside in the memory local to the CPUs of the audio threads
+     * reading it, instead of on the node of whichever thread loaded it.
+     * Data already in RAM is not moved. GetCurrentNumaNode() tells the node
+     * of the calling thread.
+     *
+     * With the default allocator, buffers of at least 64 kB are allocated
+     * directly from the operating system and bound to the node (by mbind()
+     * on Linux and VirtualAllocExNuma() on Windows), other systems and
+     * smaller buffers ignore the placement. An allocator installed by
+     * SetSampleAllocator() receives the node by its @c allocate_on_node
+     * callback.
+     *
+     * @param Node - node number (0 .. amount of nodes - 1), numa_node_interleave
+     *               for spreading the data across all nodes, or
+     *               numa_node_default (default) for no particular placement
+     * @see gig::Sample::SetNumaNode(), gig::Instrument::SetNumaNode()
+     */
+    void File::SetNumaNode(int Node) {
+        NumaNode = (Node < 0 && Node != numa_node_interleave) ? numa_node_default : Node;
+    }
+
+    /**
+     * Returns the NUMA placement of sample data selected by SetNumaNode().
+     */
+    int File::GetNumaNode() const {
+        return NumaNode;
+    }
+
+    /**
+     * Hints the operating system that the given byte range of the file is
+     * going to be read soon, so it can read it ahead asynchronously in one
+     * sequential pass (e.g. before several chunks located in that range
+     * are read one after another). This is only a hint: it neither blocks
+     * nor reports errors, and does nothing on systems without support for
+     * it.
+     *
+     * @param Offset - absolute position (in bytes) within the file
+     * @param Size   - size of the range (in bytes)
+     */
+    void File::Prefetch(file_offset_t Offset, file_offset_t Size) const {
+        Advise(Offset, Size, advice_willneed);
+    }
+
+    /**
+     * Hints the operating system about the expected access pattern of the
+     * given byte range of the file, which allows it to adjust its read-ahead
+     * and page cache behavior accordingly: e.g. advice_sequential for sample
+     * data being streamed, advice_dontneed for data which was loaded into
+     * RAM and won't be read from the file again. On POSIX systems this maps
+     * to posix_fadvise() (and madvise() for a memory-mapped file), on
+     * Windows only advice_willneed is supported, by PrefetchVirtualMemory()
+     * for memory-mapped files and by asynchronous reads into the file cache
+     * otherwise (files opened in read-only mode only). Like Prefetch() this is only a hint: it
+     * neither blocks nor reports errors, and does nothing on systems without
+     * support for it.
+     *
+     * @param Offset - absolute position (in bytes) within the file
+     * @param Size   - size of the range (in bytes)
+     * @param Advice - expected access pattern of the range
+     * @see Chunk::Advise()
+     */
+    void File::Advise(file_offset_t Offset, file_offset_t Size, advice_t Advice) const {
+        if (!Size || !pDevice) return;
+        pDevice->Advise(Offset, Size, Advice);
+    }
+
+    /**
+     * Reads several (arbitrary) ranges of chunks of this file at once. The
+     * result is equivalent to calling Chunk::ReadAt() with a word size of 1
+     * for each operation (i.e. no endian correction is applied and the
+     * chunks' read positions are not changed), and the amount of bytes
+     * actually read is stored to each operation's @c Result member.
+     *
+     * With io_backend_uring selected all reads are submitted to the kernel
+     * by few system calls (by Linux io_uring, respectively by overlapped
+     * reads and an I/O completion port on Windows) and performed concurrently, which allows a single
+     * thread to keep a fast storage device busy. With the other backends
+     * the reads are performed one after another.
+     *
+     * This method is thread safe in the same way as Chunk::ReadAt().
+     *
+     * @param pOps  - read operations (all chunks must belong to this file)
+     * @param Count - amount of read operations
+     * @see SetIOBackend()
+     */
+    void File::ReadBatch(read_op_t* pOps, size_t Count) {
+        if (!Count) return;
+        for (size_t i = 0; i < Count; ++i) {
+            read_op_t& op = pOps[i];
+            const file_offset_t size = op.pChunk->ullCurrentChunkSize;
+            op.Result = 0;
+            if (op.Pos >= size) op.Size = 0;
+            else if (op.Pos + op.Size > size) op.Size = size - op.Pos;
+        }
+        if (IOBackend == io_backend_uring && !pMappedData) {
+            std::vector<io_request_t> requests(Count);
+            const bool bGuarded = __beginRead();
+            for (size_t i = 0; i < Count; ++i) {
+                requests[i].Offset = pOps[i].pChunk->ullStartPos + pOps[i].Pos;
+                requests[i].pData  = pOps[i].pData;
+                requests[i].Size   = pOps[i].Size;
+                requests[i].Result = 0;
+            }
+            try {
+                pDevice->ReadBatch(&requests[0], Count);
+            } catch (...) {
+                if (bGuarded) __endRead();
+                throw;
+            }
+            if (bGuarded) __endRead();
+            for (size_t i = 0; i < Count; ++i) {
+                pOps[i].Result = requests[i].Result;
+                STATISTICS_ADD(Statistics.BytesRead, requests[i].Result);
+            }
+            STATISTICS_ADD(Statistics.ReadCalls, Count);
+            return;
+        }
+        for (size_t i = 0; i < Count; ++i)
+            if (pOps[i].Size)
+                pOps[i].Result = pOps[i].pChunk->ReadAt(pOps[i].Pos, pOps[i].pData, pOps[i].Size, 1);
+    }
+
+    /**
+     * Maps the whole file into memory if io_backend_mmap is selected and
+     * the file is currently opened in read-only mode. Failure to map the
+     * file is not considered an error; reads are performed on the file
+     * handle instead in that case.
+     */
+    void File::__mapFile() {
+        if (pMappedData || IOBackend != io_backend_mmap) return;
+        if (Mode != stream_mode_read) return;
+        file_offset_t ullFileSize = GetCurrentFileSize();
+        if (!ullFileSize) return;
+        pMappedData = (uint8_t*) pDevice->Map(ullMappedSize);
+        if (!pMappedData) ullMappedSize = 0;
+    }
+
+    /**
+     * Reads a block of the file into the scan buffer, which is used by
+     * List::LoadSubChunks() to parse the headers of several sub chunks
+     * from memory instead of reading each header field from the file. Does
+     * nothing if the scan buffer already contains the (list) chunk header
+     * at @a Pos, or if the file is memory-mapped anyway.
+     *
+     * @param Pos  - file position of the next chunk header
+     * @param Size - amount of bytes to be read into the scan buffer
+     * @param End  - file position where the scanned list ends
+     */
+    void File::__scanBlock(file_offset_t Pos, file_offset_t Size, file_offset_t End) {
+        if (pMappedData || Pos >= End) return;
+        const file_offset_t ullHeaderEnd = std::min(Pos + LIST_HEADER_SIZE(FileOffsetSize), End);
+        if (!ScanBuffer.empty() && Pos >= ullScanPos && ullHeaderEnd <= ullScanPos + ScanBuffer.size())
+            return;
+        if (Size > End - Pos) Size = End - Pos;
+        ScanBuffer.resize((size_t) Size);
+        ScanBuffer.resize((size_t) __cachedRead(Pos, &ScanBuffer[0], Size, cache_class_metadata));
+        ullScanPos = Pos;
+    }
+
+    /**
+     * Reads raw chunk header data from the file, either from the
+     * memory-mapped view, from the scan buffer (see __scanBlock()) or from
+     * the I/O device.
+     *
+     * @returns amount of bytes read
+     */
+    file_offset_t File::__readHeaderData(file_offset_t Pos, void* pData, file_offset_t Size) {
+        if (pMappedData) {
+            if (Pos + Size > ullMappedSize) return 0;
+            memcpy(pData, &pMappedData[Pos], Size);
+            STATISTICS_ADD(Statistics.BytesMapped, Size);
+            return Size;
+        }
+        if (!ScanBuffer.empty() && Pos >= ullScanPos && Pos + Size <= ullScanPos + ScanBuffer.size()) {
+            memcpy(pData, &ScanBuffer[Pos - ullScanPos], Size);
+            STATISTICS_ADD(Statistics.CacheHits, 1);
+            return Size;
+        }
+        STATISTICS_ADD(Statistics.CacheMisses, 1);
+        return __cachedRead(Pos, pData, Size, cache_class_metadata);
+    }
+
+    /// Reads from the I/O device and updates the statistics accordingly.
+    file_offset_t File::__deviceRead(file_offset_t Pos, void* pData, file_offset_t Size) {
+        const uint64_t t0 = (pTracer) ? __monotonicNanoseconds() : 0;
+        const file_offset_t n = pDevice->ReadAt(Pos, pData, Size);
+        STATISTICS_ADD(Statistics.ReadCalls, 1);
+        STATISTICS_ADD(Statistics.BytesRead, n);
+        if (pTracer) __trace(pTracer, trace_read, this, Pos, n, __monotonicNanoseconds() - t0);
+        return n;
+    }
+
+    /**
+     * Reads through the process wide block cache (see SetBlockCacheSize())
+     * if enabled for the given class of data and this size of read,
+     * otherwise directly from the I/O device. Consecutive blocks missing
+     * in the cache are read from the I/O device at once. Blocks read while
+     * the file is written concurrently are not added to the cache.
+     *
+     * @returns amount of bytes read
+     */
+    file_offset_t File::__cachedRead(file_offset_t Pos, void* pData, file_offset_t Size, cache_class_t Class) {
+        // (no locking at all while the cache is disabled, i.e. by default)
+        if (!__atomicLoadAcquire(blockCache.enabled[Class])) return __deviceRead(Pos, pData, Size);
+        bool bCached;
+        uint64_t cacheID;
+        {
+            mutex_lock_t lock(blockCache.mutex);
+            bCached = blockCache.uses(Class, Size);
+            cacheID = CacheID;
+        }
+        if (!bCached) return __deviceRead(Pos, pData, Size);
+        const file_offset_t bs = BLOCK_CACHE_BLOCK_SIZE;
+        uint8_t* pDst = (uint8_t*) pData;
+        const file_offset_t end = Pos + Size;
+        file_offset_t pos = Pos;
+        std::vector<uint8_t> buffer;
+        while (pos < end) {
+            block_cache_t::key_t key = { cacheID, pos / bs };
+            const file_offset_t offset = pos % bs;
+            const file_offset_t n = std::min(bs - offset, end - pos);
+            uint64_t count = 1; // amount of consecutive blocks not cached
+            {
+                mutex_lock_t lock(blockCache.mutex);
+                const int64_t got = blockCache.get(key, offset, pDst + (pos - Pos), n);
+                if (got >= 0) {
+                    pos += got;
+                    if (file_offset_t(got) < n) break; // end of file
+                    continue;
+                }
+                const uint64_t lastBlock = (end - 1) / bs;
+                for (block_cache_t::key_t k = key; ++k.block <= lastBlock && !blockCache.blocks.count(k); )
+                    ++count;
+                blockCache.stats[Class].Misses += count;
+            }
+            buffer.resize((size_t) (count * bs));
+            const file_offset_t blockStart = key.block * bs;
+            const file_offset_t got = __deviceRead(blockStart, &buffer[0], count * bs);
+            {
+                mutex_lock_t lock(blockCache.mutex);
+                // (the blocks may be outdated if the file was written meanwhile)
+                for (file_offset_t i = 0; i * bs < got && cacheID == CacheID; ++i, ++key.block)
+                    blockCache.put(key, Class, &buffer[(size_t) (i * bs)], (size_t) std::min(bs, got - i * bs));
+            }
+            if (got <= offset) break;
+            const file_offset_t copy = std::min(got - offset, end - pos);
+            memcpy(pDst + (pos - Pos), &buffer[(size_t) offset], (size_t) copy);
+            pos += copy;
+            if (got < count * bs) break; // end of file
+        }
+        return pos - Pos;
+    }
+
+    /**
+     * Drops all blocks of this file from the block cache and assigns the
+     * file a new cache ID, which must be done whenever the file's data
+     * changes or may have changed (i.e. it was written or replaced by
+     * another file). Writes invalidate both before and after writing, as
+     * concurrent reads may cache the old data while the write is in
+     * progress.
+     */
+    void File::__invalidateCache() {
+        mutex_lock_t lock(blockCache.mutex);
+        blockCache.drop(CacheID);
+        CacheID = blockCache.nextFileID++;
+    }
+
+    /**
+     * Reads from the I/O device without the page cache (see
+     * SetUnbuffered()), taking care of the alignment required for that,
+     * and updates the statistics accordingly. The aligned middle part is
+     * read directly into @a pData if the destination address has the same
+     * alignment as the file position, otherwise everything is read through
+     * an aligned intermediate buffer (see __readBounced()).
+     *
+     * @returns amount of bytes read
+     */
+    file_offset_t File::__deviceReadUnbuffered(file_offset_t Pos, void* pData, file_offset_t Size) {
+        const file_offset_t align = UnbufferedAlignment;
+        if (!align) return __deviceRead(Pos, pData, Size);
+        const uint64_t t0 = (pTracer) ? __monotonicNanoseconds() : 0;
+        uint8_t* pDst = (uint8_t*) pData;
+        const file_offset_t end   = Pos + Size;
+        const file_offset_t first = (Pos + align - 1) / align * align; // first aligned position
+        const file_offset_t last  = end / align * align;               // last aligned position
+        file_offset_t n;
+        if (first < last && (size_t(pDst) + size_t(first - Pos)) % align == 0) {
+            n = (first > Pos) ? __readBounced(Pos, pDst, first - Pos) : 0;
+            if (n == first - Pos) {
+                const file_offset_t m = pDevice->ReadUnbufferedAt(first, pDst + n, last - first);
+                STATISTICS_ADD(Statistics.ReadCalls, 1);
+                n += m;
+                if (m == last - first && end > last)
+                    n += __readBounced(last, pDst + n, end - last);
+            }
+        } else {
+            n = __readBounced(Pos, pDst, Size);
+        }
+        STATISTICS_ADD(Statistics.BytesRead, n);
+        if (pTracer) __trace(pTracer, trace_read, this, Pos, n, __monotonicNanoseconds() - t0);
+        return n;
+    }
+
+    /**
+     * Reads the given (arbitrarily aligned) range without the page cache
+     * through an aligned intermediate buffer, in blocks of at most
+     * UNBUFFERED_BOUNCE_SIZE bytes.
+     *
+     * @returns amount of bytes read
+     */
+    file_offset_t File::__readBounced(file_offset_t Pos, uint8_t* pData, file_offset_t Size) {
+        const file_offset_t align = UnbufferedAlignment;
+        const file_offset_t blockSize = std::min(
+            (file_offset_t) UNBUFFERED_BOUNCE_SIZE,
+            ((Pos % align) + Size + align - 1) / align * align
+        );
+        std::vector<uint8_t> buffer((size_t) (blockSize + align));
+        uint8_t* pBounce = &buffer[0] + (align - size_t(&buffer[0]) % align) % align;
+        file_offset_t n = 0;
+        while (n < Size) {
+            const file_offset_t pos   = Pos + n;
+            const file_offset_t start = pos - pos % align;
+            const file_offset_t skip  = pos - start;
+            const file_offset_t len   = std::min(blockSize, (skip + Size - n + align - 1) / align * align);
+            const file_offset_t got   = pDevice->ReadUnbufferedAt(start, pBounce, len);
+            STATISTICS_ADD(Statistics.ReadCalls, 1);
+            if (got <= skip) break;
+            const file_offset_t copy = std::min(got - skip, Size - n);
+            memcpy(pData + n, pBounce + skip, copy);
+            n += copy;
+            if (got < len) break; // end of file
+        }
+        return n;
+    }
+
+    /// Writes to the I/O device and updates the statistics accordingly.
+    file_offset_t File::__deviceWrite(file_offset_t Pos, const void* pData, file_offset_t Size) {
+        if (pWriteDevice == pDevice) __invalidateCache();
+        const uint64_t t0 = (pTracer) ? __monotonicNanoseconds() : 0;
+        const file_offset_t n = pWriteDevice->WriteAt(Pos, pData, Size);
+        if (pWriteDevice == pDevice) __invalidateCache();
+        STATISTICS_ADD(Statistics.WriteCalls, 1);
+        STATISTICS_ADD(Statistics.BytesWritten, n);
+        if (pTracer) __trace(pTracer, trace_write, this, Pos, n, __monotonicNanoseconds() - t0);
+        return n;
+    }
+
+    /**
+     * Copies @a Size bytes from position @a SourcePos of @a pSourceFile's
+     * (read) device directly to position @a Pos of this file's write
+     * device, without passing the data through user space (see
+     * IODevice::CopyRangeFrom()). Overlapping ranges within the same
+     * device are never copied this way.
+     *
+     * @returns amount of bytes copied from the beginning of the range,
+     *          the caller has to copy the rest by itself
+     */
+    file_offset_t File::__deviceCopy(File* pSourceFile, file_offset_t SourcePos, file_offset_t Pos, file_offset_t Size) {
+        if (!Size) return 0;
+        if (pSourceFile->pDevice == pWriteDevice &&
+            SourcePos < Pos + Size && Pos < SourcePos + Size) return 0;
+        if (pWriteDevice == pDevice) __invalidateCache();
+        const uint64_t t0 = (pTracer) ? __monotonicNanoseconds() : 0;
+        const file_offset_t n = pWriteDevice->CopyRangeFrom(pSourceFile->pDevice, SourcePos, Pos, Size);
+        if (pWriteDevice == pDevice) __invalidateCache();
+        if (!n) return 0;
+        STATISTICS_ADD(pSourceFile->Statistics.ReadCalls, 1);
+        STATISTICS_ADD(pSourceFile->Statistics.BytesRead, n);
+        STATISTICS_ADD(Statistics.WriteCalls, 1);
+        STATISTICS_ADD(Statistics.BytesWritten, n);
+        if (pTracer) __trace(pTracer, trace_write, this, Pos, n, __monotonicNanoseconds() - t0);
+        return n;
+    }
+
+    /// State of one pipelined File::__deviceMove() call, shared by the reading and the writing thread.
+    struct move_pipeline_t {
+        File*         pFile;
+        file_offset_t ullSourcePos;
+        file_offset_t ullSize;
+        file_offset_t ullBufferSize;
+        bool          bBackward;
+        uint8_t*      pBuffer[2];
+        file_offset_t ullFilled[2];   ///< Amount of bytes read into each buffer, valid if bFull is set.
+        bool          bFull[2];
+        bool          bStop;          ///< Set by the writing thread if the reading thread shall return early.
+        mutex_t       mutex;
+        condition_t   changed;        ///< Signalled whenever a buffer was filled or emptied.
+    };
+
+    /**
+     * Moves @a Size bytes from position @a SourcePos of the (read) device to
+     * position @a Pos of the write device, either starting with the first
+     * block (forward), or with the last block (@a bBackward) which is
+     * required e.g. for shifting data towards the end of the same file.
+     * Large moves between file devices are pipelined: a helper thread reads
+     * the next block while the calling thread writes the current one, so
+     * reading and writing overlap. The helper thread always stays behind
+     * the blocks already written, so the result is the same as of moving
+     * block by block sequentially. Progress is reported by the calling
+     * thread.
+     *
+     * @param bExact - if true, the source range has to be read completely,
+     *                 otherwise moving just stops at the end of the device
+     * @returns false if reading (with @a bExact) or writing failed
+     */
+    bool File::__deviceMove(file_offset_t SourcePos, file_offset_t Pos, file_offset_t Size, bool bBackward, bool bExact, progress_t* pProgress) {
+        if (!Size) return true;
+        __invalidateCache();
+        move_pipeline_t pipe;
+        pipe.pFile         = this;
+        pipe.ullSourcePos  = SourcePos;
+        pipe.ullSize       = Size;
+        pipe.ullBufferSize = (Size < SAVE_COPY_BUFFER_SIZE) ? Size : SAVE_COPY_BUFFER_SIZE;
+        pipe.bBackward     = bBackward;
+        pipe.bStop         = false;
+        for (int i = 0; i < 2; ++i) {
+            pipe.pBuffer[i] = NULL;
+            pipe.bFull[i]   = false;
+        }
+        // only file devices are known to allow concurrent positional reads
+        // and writes, and small moves are not worth a thread (overlapping
+        // forward moves towards the end are broken anyway)
+        bool bPipelined = Size > pipe.ullBufferSize &&
+                          dynamic_cast<FileIODevice*>(pDevice) &&
+                          dynamic_cast<FileIODevice*>(pWriteDevice) &&
+                          (bBackward || pDevice != pWriteDevice || Pos <= SourcePos);
+        pipe.pBuffer[0] = new uint8_t[pipe.ullBufferSize];
+        if (bPipelined) pipe.pBuffer[1] = new uint8_t[pipe.ullBufferSize];
+        task_t reader;
+        if (bPipelined && !__start_task(reader, __moveReadJob, &pipe, true)) {
+            bPipelined = false;
+            delete[] pipe.pBuffer[1];
+            pipe.pBuffer[1] = NULL;
+        }
+
+        bool bFailed = false;
+        size_t iBuffer = 0;
+        for (file_offset_t ullDone = 0; ullDone < Size; iBuffer ^= (bPipelined) ? 1 : 0) {
+            const file_offset_t ullBlock = (Size - ullDone < pipe.ullBufferSize) ? Size - ullDone : pipe.ullBufferSize;
+            const file_offset_t ullOffset = (bBackward) ? Size - ullDone - ullBlock : ullDone;
+            file_offset_t n;
+            if (bPipelined) {
+                mutex_lock_t lock(pipe.mutex);
+                while (!pipe.bFull[iBuffer]) pipe.changed.wait(pipe.mutex);
+                n = pipe.ullFilled[iBuffer];
+            } else {
+                n = __deviceRead(SourcePos + ullOffset, pipe.pBuffer[0], ullBlock);
+            }
+            if (n != ullBlock && (bExact || bBackward || !n)) {
+                bFailed = bExact;
+                break;
+            }
+            if (__deviceWrite(Pos + ullOffset, pipe.pBuffer[iBuffer], n) != n) {
+                bFailed = true;
+                break;
+            }
+            ullDone += n;
+            if (bPipelined) {
+                mutex_lock_t lock(pipe.mutex);
+                pipe.bFull[iBuffer] = false;
+                pipe.changed.signal();
+            }
+            if (n != ullBlock) break; // end of device
+            __notify_progress(pProgress, float(ullDone) / float(Size));
+        }
+
+        if (bPipelined) {
+            {
+                mutex_lock_t lock(pipe.mutex);
+                pipe.bStop = true;
+                pipe.changed.signal();
+            }
+            __wait_task(reader);
+        }
+        delete[] pipe.pBuffer[0];
+        if (pipe.pBuffer[1]) delete[] pipe.pBuffer[1];
+        return !bFailed;
+    }
+
+    /// Reading thread of a pipelined __deviceMove(), fills the buffers alternately in the same block order as they are written.
+    void File::__moveReadJob(void* arg) {
+        move_pipeline_t* p = static_cast<move_pipeline_t*>(arg);
+        size_t iBuffer = 0;
+        for (file_offset_t ullDone = 0; ullDone < p->ullSize; iBuffer ^= 1) {
+            {
+                mutex_lock_t lock(p->mutex);
+                while (p->bFull[iBuffer] && !p->bStop) p->changed.wait(p->mutex);
+                if (p->bStop) return;
+            }
+            const file_offset_t ullBlock = (p->ullSize - ullDone < p->ullBufferSize) ? p->ullSize - ullDone : p->ullBufferSize;
+            const file_offset_t ullOffset = (p->bBackward) ? p->ullSize - ullDone - ullBlock : ullDone;
+            const file_offset_t n = p->pFile->__deviceRead(p->ullSourcePos + ullOffset, p->pBuffer[iBuffer], ullBlock);
+            {
+                mutex_lock_t lock(p->mutex);
+                p->ullFilled[iBuffer] = n;
+                p->bFull[iBuffer] = true;
+                p->changed.signal();
+            }
+            if (n != ullBlock) return; // end of device or error
+            ullDone += n;
+        }
+    }
+
+    /**
+     * Returns a snapshot of the I/O statistics of this file, that is how
+     * much data was read from and written to the file by how many I/O
+     * operations so far. The counters are accumulated since this File
+     * object was created or since the last ResetStatistics() call.
+     *
+     * This method may be called while other threads are reading from the
+     * file; each counter is consistent on its own then, but the counters
+     * are not captured all at the same instant.
+     *
+     * If libgig was compiled with statistics disabled (configure
+     * --disable-statistics), all counters are always zero.
+     *
+     * @see ResetStatistics()
+     */
+    io_statistics_t File::GetStatistics() const {
+        io_statistics_t stats;
+        stats.BytesRead    = __atomicGet(Statistics.BytesRead);
+        stats.BytesWritten = __atomicGet(Statistics.BytesWritten);
+        stats.BytesMapped  = __atomicGet(Statistics.BytesMapped);
+        stats.ReadCalls    = __atomicGet(Statistics.ReadCalls);
+        stats.WriteCalls   = __atomicGet(Statistics.WriteCalls);
+        stats.SeekCalls    = __atomicGet(Statistics.SeekCalls);
+        stats.CacheHits    = __atomicGet(Statistics.CacheHits);
+        stats.CacheMisses  = __atomicGet(Statistics.CacheMisses);
+        return stats;
+    }
+
+    /**
+     * Resets all I/O statistics counters of this file to zero.
+     *
+     * @see GetStatistics()
      */
-    file_offset_t File::GetRequiredFileSize() {
-        return GetRequiredFileSize(FileOffsetPreference);
+    void File::ResetStatistics() {
+        memset(&Statistics, 0, sizeof(Statistics));
     }
 
     /**
-     * Returns the rquired size (in bytes) for this RIFF file to be saved to
-     * disk, assuming the passed @a fileOffsestSize would be used for the
-     * Save() operation.
+     * Returns the amount of heap memory (in bytes) occupied by this file's
+     * RIFF chunk tree, that is by all chunk objects created so far and by
+     * all chunk data currently held in RAM. A memory-mapped view of the
+     * file (see io_backend_mmap) is not included, as it does not occupy
+     * heap memory.
+     */
+    size_t File::GetMemoryUsage() const {
+        return sizeof(File) + __bufferMemoryUsage() + __subChunksMemoryUsage() + ScanBuffer.capacity();
+    }
+
+    /**
+     * Installs a tracer which receives an event for each read from and
+     * write to the I/O device, for each chunk seek and for each phase of
+     * saving this file (see trace_event_type_t). File formats built on top
+     * of this class may report additional events to the tracer (e.g.
+     * gig::File reports sample reads and instrument loading).
      *
-     * This overridden method essentialy behaves like the above method, with
-     * the difference that you must provide a specific RIFF @a fileOffsetSize
-     * for calculating the theoretical final file size.
+     * The tracer is not owned by this File object, it has to stay valid
+     * until it is uninstalled or this File object is destroyed.
      *
-     * @see GetFileOffsetSize()
+     * @param pTracer - tracer to be installed, NULL to disable tracing
+     *                  (default)
+     * @see GetTracer()
      */
-    file_offset_t File::GetRequiredFileSize(offset_size_t fileOffsetSize) {
-        switch (fileOffsetSize) {
-            case offset_size_auto: {
-                file_offset_t fileSize = GetRequiredFileSize(offset_size_32bit);
-                if (fileSize >> 32)
-                    return GetRequiredFileSize(offset_size_64bit);
-                else
-                    return fileSize;
-            }
-            case offset_size_32bit: break;
-            case offset_size_64bit: break;
-            default: throw Exception("Internal error: Invalid RIFF::offset_size_t");
-        }
-        return RequiredPhysicalSize(FileOffsetSize);
+    void File::SetTracer(tracer_t* pTracer) {
+        this->pTracer = pTracer;
+    }
+
+    /**
+     * Returns the tracer installed by SetTracer(), NULL if none.
+     */
+    tracer_t* File::GetTracer() const {
+        return pTracer;
+    }
+
+    /// Releases the memory-mapped view of the file (if any).
+    void File::__unmapFile() {
+        if (!pMappedData) return;
+        pDevice->Unmap();
+        pMappedData   = NULL;
+        ullMappedSize = 0;
     }
 
+
+
     int File::FileOffsetSizeFor(file_offset_t fileSize) const {
         switch (FileOffsetPreference) {
             case offset_size_auto:
@@ -2224,31 +5823,383 @@ namespace RIFF {
         return FileOffsetSizeFor(GetCurrentFileSize());
     }
 
-    #if POSIX
-    file_offset_t File::__GetFileSize(int hFile) const {
-        struct stat filestat;
-        if (fstat(hFile, &filestat) == -1)
-            throw Exception("POSIX FS error: could not determine file size");
-        return filestat.st_size;
+
+
+// *************** Scanner ***************
+// *
+
+    /// Chunk headers read from the device in blocks by one thread of Scanner::Scan().
+    struct scan_cursor_t {
+        std::vector<uint8_t> buffer;
+        file_offset_t        ullPos;  ///< File position of buffer[0].
+        file_offset_t        ullSize; ///< Amount of valid bytes in buffer.
+
+        scan_cursor_t() : buffer(LIST_SCAN_BLOCK_SIZE), ullPos(0), ullSize(0) {}
+    };
+
+    /// State shared by all threads of one Scanner::Scan() call.
+    struct scan_state_t {
+        const Scanner*  pScanner;
+        scan_callback_t callback;
+        void*           pUserData;
+        uint64_t        stopped; ///< Non zero once scanning shall stop (accessed by __atomicAdd() / __atomicGet()).
+        file_offset_t   ullEnd;  ///< File position after the root chunk's body.
+        std::vector<scan_entry_t> lists; ///< Parallel scan only: top level lists to be scanned by the worker threads.
+    };
+
+    /** @brief Constructor.
+     *
+     * Opens the RIFF file (or RIFF-alike file) with the given path for
+     * being scanned.
+     *
+     * @param path           - path and file name of the file to be scanned
+     * @param Layout         - general structure of the file: whether it
+     *                         starts with a "RIFF" (or "RIFX") list chunk
+     *                         containing all other chunks (default), or
+     *                         whether it consists of a flat sequence of
+     *                         chunks (see File::File() for details)
+     * @param FileOffsetSize - size of all file offsets in the chunk headers
+     *                         (see File::GetFileOffsetSize())
+     * @throws RIFF::Exception if the file cannot be opened, or if it does
+     *         not start with a RIFF (or RIFX) header (layout_standard only)
+     */
+    Scanner::Scanner(const String& path, layout_t Layout, offset_size_t FileOffsetSize) {
+        FileIODevice* pFileDevice = new FileIODevice(path);
+        try {
+            pFileDevice->Open();
+        } catch (...) {
+            delete pFileDevice;
+            throw;
+        }
+        pDevice    = pFileDevice;
+        bOwnDevice = true;
+        this->Layout = Layout;
+        try {
+            __init(FileOffsetSize);
+        } catch (...) {
+            delete pDevice;
+            throw;
+        }
+    }
+
+    /** @brief Constructor.
+     *
+     * Scans the RIFF file (or RIFF-alike file) stored on the given device,
+     * which must be open for reading and must exist as long as this object
+     * exists. The device is not deleted by this object.
+     *
+     * @param pDevice        - device the RIFF file is read from
+     * @param Layout         - general structure of the file (see above)
+     * @param FileOffsetSize - size of all file offsets in the chunk headers
+     * @throws RIFF::Exception if the device does not start with a RIFF (or
+     *         RIFX) header (layout_standard only)
+     */
+    Scanner::Scanner(IODevice* pDevice, layout_t Layout, offset_size_t FileOffsetSize) {
+        this->pDevice = pDevice;
+        bOwnDevice    = false;
+        this->Layout  = Layout;
+        __init(FileOffsetSize);
     }
-    #elif defined(WIN32)
-    file_offset_t File::__GetFileSize(HANDLE hFile) const {
-        LARGE_INTEGER size;
-        if (!GetFileSizeEx(hFile, &size))
-            throw Exception("Windows FS error: could not determine file size");
-        return size.QuadPart;
-    }
-    #else // standard C functions
-    file_offset_t File::__GetFileSize(FILE* hFile) const {
-        off_t curpos = ftello(hFile);
-        if (fseeko(hFile, 0, SEEK_END) == -1)
-            throw Exception("FS error: could not determine file size");
-        off_t size = ftello(hFile);
-        fseeko(hFile, curpos, SEEK_SET);
-        return size;
+
+    Scanner::~Scanner() {
+        if (bOwnDevice) delete pDevice;
+    }
+
+    void Scanner::__init(offset_size_t FileOffsetSize) {
+        const file_offset_t ullFileSize = pDevice->GetSize();
+        switch (FileOffsetSize) {
+            case offset_size_auto:
+                this->FileOffsetSize = (ullFileSize >> 32) ? 8 : 4;
+                break;
+            case offset_size_32bit:
+                this->FileOffsetSize = 4;
+                break;
+            case offset_size_64bit:
+                this->FileOffsetSize = 8;
+                break;
+            default:
+                throw Exception("Internal error: Invalid RIFF::offset_size_t");
+        }
+        bEndianNative = true;
+        FileType      = 0;
+        if (Layout == layout_flat) {
+            ullRootSize = ullFileSize;
+            return;
+        }
+
+        uint8_t header[LIST_HEADER_SIZE(8)];
+        const file_offset_t headerSize = LIST_HEADER_SIZE(this->FileOffsetSize);
+        if (pDevice->ReadAt(0, header, headerSize) != headerSize)
+            throw Exception("Invalid RIFF file header (premature end of file)");
+        uint32_t ckid;
+        memcpy(&ckid, &header[0], 4);
+        #if WORDS_BIGENDIAN
+        if (ckid == CHUNK_ID_RIFF) bEndianNative = false;
+        else if (ckid != CHUNK_ID_RIFX)
+        #else // little endian
+        if (ckid == CHUNK_ID_RIFX) bEndianNative = false;
+        else if (ckid != CHUNK_ID_RIFF)
+        #endif // WORDS_BIGENDIAN
+            throw Exception("Invalid file container ID");
+        uint64_t ullSize = 0;
+        memcpy(&ullSize, &header[4], this->FileOffsetSize);
+        if (!bEndianNative) {
+            if (this->FileOffsetSize == 4)
+                swapBytes_32(&ullSize);
+            else
+                swapBytes_64(&ullSize);
+        }
+        ullRootSize = (ullSize < 4) ? 0 : ullSize - 4;
+        memcpy(&FileType, &header[CHUNK_HEADER_SIZE(this->FileOffsetSize)], 4);
+    }
+
+    /**
+     * Only visit ordinary chunks with the given chunk ID (may be called
+     * several times to visit chunks with different IDs). By default all
+     * chunks are visited. If any filter was set, only chunks matching one
+     * of the filters are passed to the callback of Scan(): ordinary chunks
+     * with a chunk ID added by this method or list chunks with a list type
+     * added by AddListTypeFilter(). The sub chunks of all list chunks are
+     * scanned nevertheless.
+     */
+    void Scanner::AddChunkIDFilter(uint32_t ChunkID) {
+        ChunkIDFilter.push_back(ChunkID);
+    }
+
+    /**
+     * Only visit list chunks with the given list type (may be called
+     * several times to visit lists of different types), see
+     * AddChunkIDFilter() for details. The root chunk is visited if the
+     * file type was added.
+     */
+    void Scanner::AddListTypeFilter(uint32_t ListType) {
+        ListTypeFilter.push_back(ListType);
+    }
+
+    /// Removes all filters, so that all chunks are visited again.
+    void Scanner::ClearFilters() {
+        ChunkIDFilter.clear();
+        ListTypeFilter.clear();
+    }
+
+    /** @brief Walks over all chunk headers of the file.
+     *
+     * Calls @a Callback for each chunk of the file (restricted by the
+     * filters, if any), the root chunk included. Only the chunk headers are
+     * read, and no objects are created for the visited chunks. The callback
+     * decides by its return value whether the sub chunks of a visited list
+     * chunk shall be scanned (scan_continue), skipped (scan_skip) or whether
+     * scanning shall stop (scan_stop).
+     *
+     * With @a ThreadCount other than 1, the top level chunks (the sub
+     * chunks of the root chunk) are visited by the calling thread first,
+     * afterwards the sub chunks of the top level lists are scanned by
+     * several threads. In that case the callback is called by the worker
+     * threads concurrently, so it must be thread safe and must not throw,
+     * and the chunks below the top level are not visited in file order.
+     * Otherwise all chunks are visited by the calling thread, in file order.
+     *
+     * @param Callback    - function called for each visited chunk
+     * @param pUserData   - (optional) passed to @a Callback
+     * @param ThreadCount - (optional) amount of threads scanning the top
+     *                      level lists, <= 0 for one per CPU core
+     *                      (default: 1)
+     * @returns false if scanning was stopped by the callback, true otherwise
+     */
+    bool Scanner::Scan(scan_callback_t Callback, void* pUserData, int ThreadCount) {
+        scan_state_t state;
+        state.pScanner  = this;
+        state.callback  = Callback;
+        state.pUserData = pUserData;
+        state.stopped   = 0;
+
+        const file_offset_t ullFileSize = pDevice->GetSize();
+        file_offset_t ullStart = 0;
+        int level = 0;
+        if (Layout == layout_standard) {
+            scan_entry_t root;
+            root.ChunkID        = CHUNK_ID_RIFF;
+            root.ListType       = FileType;
+            root.IsList         = true;
+            root.Level          = 0;
+            root.ParentListType = 0;
+            root.Offset         = 0;
+            root.DataOffset     = LIST_HEADER_SIZE(FileOffsetSize);
+            root.Size           = ullRootSize;
+            scan_action_t action;
+            if (!__visit(state, root, action)) return false;
+            if (action != scan_continue) return true;
+            ullStart = root.DataOffset;
+            level = 1;
+        }
+        state.ullEnd = ullStart + ullRootSize;
+        if (state.ullEnd > ullFileSize) state.ullEnd = ullFileSize;
+
+        scan_cursor_t cursor;
+        if (ThreadCount == 1)
+            return __scanList(state, cursor, ullStart, state.ullEnd, level, FileType, NULL);
+
+        if (!__scanList(state, cursor, ullStart, state.ullEnd, level, FileType, &state.lists))
+            return false;
+        __parallel_for(state.lists.size(), ThreadCount, __scanJob, &state);
+        return !__atomicGet(state.stopped);
+    }
+
+    void Scanner::__scanJob(void* arg, size_t index) {
+        scan_state_t* pState = (scan_state_t*) arg;
+        const scan_entry_t& list = pState->lists[index];
+        file_offset_t ullEnd = list.DataOffset + list.Size;
+        if (ullEnd > pState->ullEnd) ullEnd = pState->ullEnd;
+        scan_cursor_t cursor;
+        try {
+            pState->pScanner->__scanList(*pState, cursor, list.DataOffset, ullEnd, list.Level + 1, list.ListType, NULL);
+        } catch (...) {
+            __atomicAdd(pState->stopped, 1);
+        }
+    }
+
+    /**
+     * Scans the chunks from file position @a Pos to @a End, which are
+     * located on the given nesting @a Level within a list of type
+     * @a ListType. List chunks to be descended into are either scanned
+     * recursively, or if @a pDeferredLists is not NULL, they are appended
+     * to @a pDeferredLists instead.
+     *
+     * @returns false if scanning shall stop
+     */
+    bool Scanner::__scanList(scan_state_t& state, scan_cursor_t& cursor, file_offset_t Pos, file_offset_t End, int Level, uint32_t ListType, std::vector<scan_entry_t>* pDeferredLists) const {
+        const file_offset_t ullListStart = Pos;
+        // like List::LoadSubChunks(), read headers in blocks as long as the
+        // chunks are small, otherwise (e.g. sample data) just each header
+        bool bSmallChunks = true;
+        while (Pos + CHUNK_HEADER_SIZE(FileOffsetSize) <= End) {
+            if (__atomicGet(state.stopped)) return false;
+            scan_entry_t entry;
+            const file_offset_t readSize = (bSmallChunks) ? LIST_SCAN_BLOCK_SIZE : LIST_HEADER_SIZE(FileOffsetSize);
+            if (!__readHeader(cursor, Pos, End, readSize, entry)) break;
+            entry.Level          = Level;
+            entry.ParentListType = ListType;
+            scan_action_t action;
+            if (!__visit(state, entry, action)) return false;
+            if (entry.IsList && action == scan_continue) {
+                if (pDeferredLists) {
+                    pDeferredLists->push_back(entry);
+                } else {
+                    file_offset_t ullEnd = entry.DataOffset + entry.Size;
+                    if (ullEnd > End) ullEnd = End;
+                    if (!__scanList(state, cursor, entry.DataOffset, ullEnd, Level + 1, entry.ListType, NULL))
+                        return false;
+                }
+            }
+            Pos = entry.DataOffset + entry.Size;
+            if ((Pos - ullListStart) % 2 != 0) Pos++; // jump over pad byte
+            bSmallChunks = entry.Size < LIST_SCAN_BLOCK_SIZE / 4;
+        }
+        return true;
+    }
+
+    /**
+     * Parses the header of the chunk at file position @a Pos (with the
+     * list type, if it is a list chunk), which must end before @a End.
+     * If the header is not within the cursor's buffer yet, the buffer is
+     * refilled from @a Pos on with up to @a ReadSize bytes.
+     *
+     * @returns false if there is no complete header at @a Pos
+     */
+    bool Scanner::__readHeader(scan_cursor_t& cursor, file_offset_t Pos, file_offset_t End, file_offset_t ReadSize, scan_entry_t& entry) const {
+        const file_offset_t headerSize = CHUNK_HEADER_SIZE(FileOffsetSize);
+        const file_offset_t listHeaderSize = LIST_HEADER_SIZE(FileOffsetSize);
+        const file_offset_t maxSize = (End - Pos < listHeaderSize) ? End - Pos : listHeaderSize;
+
+        if (Pos < cursor.ullPos || Pos + maxSize > cursor.ullPos + cursor.ullSize) {
+            if (ReadSize > End - Pos) ReadSize = End - Pos;
+            if (ReadSize > cursor.buffer.size()) ReadSize = cursor.buffer.size();
+            cursor.ullPos  = Pos;
+            cursor.ullSize = pDevice->ReadAt(Pos, &cursor.buffer[0], ReadSize);
+        }
+        const file_offset_t available = cursor.ullPos + cursor.ullSize - Pos;
+        if (available < headerSize) return false;
+        const uint8_t* pHeader = &cursor.buffer[Pos - cursor.ullPos];
+
+        uint64_t ullSize = 0;
+        memcpy(&entry.ChunkID, &pHeader[0], 4);
+        memcpy(&ullSize, &pHeader[4], FileOffsetSize);
+        if (!bEndianNative) {
+            if (FileOffsetSize == 4)
+                swapBytes_32(&ullSize);
+            else
+                swapBytes_64(&ullSize);
+        }
+        entry.Offset = Pos;
+        if (entry.ChunkID == CHUNK_ID_LIST) {
+            if (available < headerSize + 4) return false;
+            entry.IsList     = true;
+            memcpy(&entry.ListType, &pHeader[headerSize], 4);
+            entry.DataOffset = Pos + headerSize + 4;
+            entry.Size       = (ullSize < 4) ? 0 : ullSize - 4;
+        } else {
+            entry.IsList     = false;
+            entry.ListType   = 0;
+            entry.DataOffset = Pos + headerSize;
+            entry.Size       = ullSize;
+        }
+        return true;
+    }
+
+    /**
+     * Passes @a entry to the callback, unless it is rejected by the
+     * filters (in which case @a action is scan_continue).
+     *
+     * @returns false if scanning shall stop
+     */
+    bool Scanner::__visit(scan_state_t& state, const scan_entry_t& entry, scan_action_t& action) const {
+        action = scan_continue;
+        if (!ChunkIDFilter.empty() || !ListTypeFilter.empty()) {
+            const std::vector<uint32_t>& filter = (entry.IsList) ? ListTypeFilter : ChunkIDFilter;
+            const uint32_t id = (entry.IsList) ? entry.ListType : entry.ChunkID;
+            if (std::find(filter.begin(), filter.end(), id) == filter.end())
+                return true;
+        }
+        action = state.callback(entry, state.pUserData);
+        if (action == scan_stop) {
+            __atomicAdd(state.stopped, 1);
+            return false;
+        }
+        return true;
     }
-    #endif
 
+    /**
+     * Reads @a Size bytes from the absolute file position @a Offset, i.e.
+     * the data of a visited chunk from scan_entry_t::DataOffset on. No
+     * endian correction is applied (see IsEndianNative()). This method may
+     * be called concurrently by several threads, also from within the
+     * callback of Scan().
+     *
+     * @returns amount of bytes actually read
+     */
+    file_offset_t Scanner::ReadAt(file_offset_t Offset, void* pData, file_offset_t Size) const {
+        return pDevice->ReadAt(Offset, pData, Size);
+    }
+
+    /// Returns the list type of the root chunk (e.g. "DLS "), 0 with layout_flat.
+    uint32_t Scanner::GetFileType() const {
+        return FileType;
+    }
+
+    /// Returns false if the file's byte order differs from the machine's byte order (i.e. a RIFX file on a little endian machine).
+    bool Scanner::IsEndianNative() const {
+        return bEndianNative;
+    }
+
+    /// Returns the size (in bytes) of the file offsets in the chunk headers of the file (4 or 8).
+    int Scanner::GetFileOffsetSize() const {
+        return FileOffsetSize;
+    }
+
+    /// Returns the current size of the file in bytes.
+    file_offset_t Scanner::GetFileSize() const {
+        return pDevice->GetSize();
+    }
 
 // *************** Exception ***************
 // *
@@ -2280,6 +6231,18 @@ namespace RIFF {
     }
 
 
+
+// *************** CancelException ***************
+// *
+
+    CancelException::CancelException() : Exception("Operation cancelled") {
+    }
+
+    void CancelException::PrintMessage() {
+        std::cout << "RIFF::CancelException: " << Message << std::endl;
+    }
+
+
 // *************** functions ***************
 // *
 
@@ -2300,4 +6263,343 @@ namespace RIFF {
         return VERSION;
     }
 
+    static allocator_t* pSampleAllocator = NULL;
+
+    /**
+     * Installs an allocator which shall be used for all sample data cached
+     * in RAM and for all decompression buffers of gig samples from now on,
+     * or restores the default (new[] and delete[]) if NULL is passed. The
+     * allocator applies to all files of all formats (except Akai, which has
+     * its own allocator hook, see AkaiSetSampleAllocator()).
+     *
+     * Buffers are always freed by the allocator which was installed when
+     * they are freed, so the allocator should be installed once at startup
+     * before any file is opened, and it must not be changed as long as any
+     * sample data is cached or any decompression buffer exists. The
+     * allocator object must stay valid for that time as well.
+     *
+     * @param pAllocator - allocator to be used, or NULL for the default one
+     */
+    void SetSampleAllocator(allocator_t* pAllocator) {
+        pSampleAllocator = pAllocator;
+    }
+
+    /**
+     * Returns the allocator installed by SetSampleAllocator(), NULL if the
+     * default one is used.
+     */
+    allocator_t* GetSampleAllocator() {
+        return pSampleAllocator;
+    }
+
+    static executor_t* pInstalledExecutor = NULL;
+
+    /**
+     * Installs the executor running all work libgig does in parallel (see
+     * executor_t). The executor should be installed once at startup before
+     * any file is opened, it must not be replaced while any libgig
+     * operation or any object with worker threads (i.e.
+     * gig::SampleReadQueue, gig::StreamEngine) is still running. The
+     * executor object must stay valid for that time as well.
+     *
+     * @param pExecutor - executor to be used, or NULL for libgig's own
+     *                    thread pool
+     */
+    void SetExecutor(executor_t* pExecutor) {
+        pInstalledExecutor = pExecutor;
+    }
+
+    /**
+     * Returns the executor installed by SetExecutor(), NULL if libgig's
+     * own thread pool is used.
+     */
+    executor_t* GetExecutor() {
+        return pInstalledExecutor;
+    }
+
+    /// Buffers which the default allocator placed on NUMA nodes (instead of allocating them by new[]), guarded by placedBuffersMutex.
+    static std::set<void*> placedBuffers;
+    static mutex_t placedBuffersMutex;
+    /// Amount of entries in placedBuffers, for skipping the lookup as long as there are none.
+    static volatile long placedBufferCount = 0;
+
+    /**
+     * Allocates memory directly from the operating system, placed on the
+     * given NUMA node or interleaved across all nodes. Placement is only a
+     * preference: if the node runs out of memory, other nodes are used.
+     *
+     * @returns new buffer or NULL if not supported on this system
+     */
+    static void* __allocatePlaced(size_t Size, int Node) {
+        #if defined(__linux__) && defined(__NR_mbind)
+        void* p = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return NULL;
+        const size_t bits = 8 * sizeof(unsigned long);
+        unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+        int mode;
+        if (Node == numa_node_interleave) {
+            memset(mask, 0xff, sizeof(mask)); // (restricted to the allowed nodes by the kernel)
+            mode = MPOL_INTERLEAVE;
+        } else {
+            if (Node >= NUMA_MAX_NODES) return p;
+            memset(mask, 0, sizeof(mask));
+            mask[Node / bits] |= 1UL << (Node % bits);
+            mode = MPOL_PREFERRED;
+        }
+        // the pages are not touched yet, so they are allocated on the node
+        // on first access (fails silently without NUMA support)
+        syscall(__NR_mbind, p, Size, mode, mask, (unsigned long) (8 * sizeof(mask) + 1), 0);
+        return p;
+        #elif defined(WIN32) && _WIN32_WINNT >= 0x0600
+        if (Node >= 0)
+            return VirtualAllocExNuma(GetCurrentProcess(), NULL, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, (DWORD) Node);
+        ULONG highest = 0;
+        if (!GetNumaHighestNodeNumber(&highest) || !highest)
+            return VirtualAlloc(NULL, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        uint8_t* p = (uint8_t*) VirtualAlloc(NULL, Size, MEM_RESERVE, PAGE_READWRITE);
+        if (!p) return NULL;
+        for (size_t offset = 0, i = 0; offset < Size; offset += NUMA_INTERLEAVE_STRIPE, ++i) {
+            const size_t size = std::min(Size - offset, (size_t) NUMA_INTERLEAVE_STRIPE);
+            if (!VirtualAllocExNuma(GetCurrentProcess(), p + offset, size, MEM_COMMIT, PAGE_READWRITE, DWORD(i % (highest + 1)))) {
+                VirtualFree(p, 0, MEM_RELEASE);
+                return NULL;
+            }
+        }
+        return p;
+        #else
+        return NULL;
+        #endif
+    }
+
+    /// Frees a buffer allocated by __allocatePlaced().
+    static void __freePlaced(void* pData, size_t Size) {
+        #if defined(__linux__) && defined(__NR_mbind)
+        munmap(pData, Size);
+        #elif defined(WIN32) && _WIN32_WINNT >= 0x0600
+        VirtualFree(pData, 0, MEM_RELEASE);
+        #endif
+    }
+
+    /**
+     * Allocates a buffer of @a Size bytes for sample data or decompression
+     * with the allocator installed by SetSampleAllocator() (by new[] if
+     * none was installed). The buffer must be freed by FreeSampleBuffer()
+     * with the same @a Size.
+     *
+     * @param Size - size of the buffer (in bytes)
+     * @returns new buffer (never NULL)
+     * @throws std::bad_alloc if the allocator is out of memory
+     */
+    void* AllocateSampleBuffer(size_t Size) {
+        return AllocateSampleBuffer(Size, numa_node_default);
+    }
+
+    /**
+     * Allocates a buffer of @a Size bytes like AllocateSampleBuffer(size_t),
+     * placed on the given NUMA node (see File::SetNumaNode()).
+     *
+     * @param Size - size of the buffer (in bytes)
+     * @param Node - NUMA node number, numa_node_interleave or numa_node_default
+     * @returns new buffer (never NULL)
+     * @throws std::bad_alloc if the allocator is out of memory
+     */
+    void* AllocateSampleBuffer(size_t Size, int Node) {
+        if (!pSampleAllocator || !pSampleAllocator->allocate) {
+            if (Node != numa_node_default && Size >= NUMA_MIN_PLACED_SIZE) {
+                void* p = __allocatePlaced(Size, Node);
+                if (p) {
+                    mutex_lock_t lock(placedBuffersMutex);
+                    placedBuffers.insert(p);
+                    __atomicStoreRelease(placedBufferCount, placedBufferCount + 1);
+                    return p;
+                }
+            }
+            return new int8_t[Size];
+        }
+        void* p = (Node != numa_node_default && pSampleAllocator->allocate_on_node) ?
+            pSampleAllocator->allocate_on_node(pSampleAllocator, Size, Node) :
+            pSampleAllocator->allocate(pSampleAllocator, Size);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+
+    /**
+     * Frees a buffer previously allocated by AllocateSampleBuffer().
+     *
+     * @param pData - buffer to be freed (NULL is ignored)
+     * @param Size  - size of the buffer (in bytes) as passed to AllocateSampleBuffer()
+     */
+    void FreeSampleBuffer(void* pData, size_t Size) {
+        if (!pData) return;
+        if (pSampleAllocator && pSampleAllocator->deallocate) {
+            pSampleAllocator->deallocate(pSampleAllocator, pData, Size);
+            return;
+        }
+        if (__atomicLoadAcquire(placedBufferCount)) {
+            mutex_lock_t lock(placedBuffersMutex);
+            std::set<void*>::iterator it = placedBuffers.find(pData);
+            if (it != placedBuffers.end()) {
+                placedBuffers.erase(it);
+                __atomicStoreRelease(placedBufferCount, placedBufferCount - 1);
+                __freePlaced(pData, Size);
+                return;
+            }
+        }
+        delete[] (int8_t*) pData;
+    }
+
+    /**
+     * Returns the NUMA node of the CPU the calling thread is currently
+     * running on, i.e. for placing sample data near an audio thread pinned
+     * to that node (see File::SetNumaNode()).
+     *
+     * @returns node number, or numa_node_default if unknown on this system
+     */
+    int GetCurrentNumaNode() {
+        #if defined(__linux__) && defined(__NR_getcpu)
+        unsigned cpu = 0, node = 0;
+        if (syscall(__NR_getcpu, &cpu, &node, NULL) == 0) return (int) node;
+        #elif defined(WIN32) && _WIN32_WINNT >= 0x0600
+        UCHAR node = 0;
+        if (GetNumaProcessorNode((UCHAR) GetCurrentProcessorNumber(), &node)) return node;
+        #endif
+        return numa_node_default;
+    }
+
+    /**
+     * Limits the amount of file handles held open by all RIFF::File objects
+     * of this process, which is useful when dealing with a very large
+     * amount of files (e.g. a sample library consisting of thousands of gig
+     * files, or of gig files split into many .gx extension files, or
+     * thousands of Korg sample files), which might otherwise exceed the
+     * operating system's maximum amount of open file descriptors per
+     * process.
+     *
+     * All files opened in read-only mode while a limit is set are subject
+     * to it: whenever more handles than the limit are open, the handles of
+     * the least recently accessed files which are currently not being read
+     * are closed, and such a file is transparently reopened on its next
+     * access. Files being written or modified, files opened before the
+     * limit was set, and files read from memory are never closed. So the
+     * limit should be set at startup before any file is opened. Files
+     * which are accessed concurrently by different threads may exceed the
+     * limit temporarily.
+     *
+     * Reopening a file costs a system call, so the limit should be chosen
+     * considerably larger than the amount of files accessed in turn, e.g.
+     * the amount of files a sampler streams from at the same time. By
+     * default there is no limit.
+     *
+     * @param Limit - maximum amount of open file handles, 0 for no limit
+     */
+    void SetFileHandleLimit(size_t Limit) {
+        mutex_lock_t lock(fileHandleMutex);
+        fileHandleLimit = Limit;
+        FileIODevice::evictHandles(NULL);
+    }
+
+    /**
+     * Returns the limit set by SetFileHandleLimit(), 0 if there is no limit.
+     */
+    size_t GetFileHandleLimit() {
+        mutex_lock_t lock(fileHandleMutex);
+        return fileHandleLimit;
+    }
+
+    /**
+     * Returns the amount of file handles currently held open by those files
+     * which are subject to the limit set by SetFileHandleLimit().
+     */
+    size_t CountOpenFileHandles() {
+        mutex_lock_t lock(fileHandleMutex);
+        return openFileHandleCount;
+    }
+
+    /**
+     * Sets the size of the process wide block cache for the given class of
+     * data. The block cache holds blocks of 64 kB of the files read by all
+     * RIFF::File objects (and thus also by all DLS::File, gig::File and
+     * sf2::File objects), replacing the least recently used blocks of the
+     * same class when it is full. So reads of data already read before are
+     * served from memory without any system call, which gives predictable
+     * behavior where the operating system's page cache is weak, i.e. on
+     * network file systems. By default the block cache is disabled (size
+     * 0) for both classes.
+     *
+     * Metadata (chunk headers and all chunk bodies except sample data) and
+     * sample data have separate sizes, so that streaming sample data
+     * can't push the metadata out of the cache, and separate policies (see
+     * SetBlockCachePolicy()).
+     *
+     * Reads bypassing the page cache (see File::SetUnbuffered()), reads of
+     * memory-mapped files (see io_backend_mmap) and batched reads (see
+     * File::ReadBatch()) never go through the block cache. The cached
+     * blocks of a file are dropped when the file is written or closed, but
+     * changes of the file by other processes are not detected.
+     *
+     * @param Class - class of data
+     * @param Size - max. size of the cached blocks of that class (in
+     *               bytes), 0 to disable caching of that class
+     */
+    void SetBlockCacheSize(cache_class_t Class, size_t Size) {
+        mutex_lock_t lock(blockCache.mutex);
+        blockCache.capacity[Class] = Size;
+        __atomicStoreRelease(blockCache.enabled[Class], long(Size != 0));
+        blockCache.shrink(Class);
+    }
+
+    /**
+     * Returns the size of the block cache for the given class of data (see
+     * SetBlockCacheSize()).
+     */
+    size_t GetBlockCacheSize(cache_class_t Class) {
+        mutex_lock_t lock(blockCache.mutex);
+        return blockCache.capacity[Class];
+    }
+
+    /**
+     * Sets which reads of the given class of data go through the block
+     * cache (see SetBlockCacheSize()). By default all reads of metadata
+     * are cached (cache_policy_all), but only small reads of sample data
+     * (cache_policy_small_reads), since streaming engines read sample data
+     * in large blocks anyway and copying them through the cache would just
+     * waste memory bandwidth.
+     */
+    void SetBlockCachePolicy(cache_class_t Class, cache_policy_t Policy) {
+        mutex_lock_t lock(blockCache.mutex);
+        blockCache.policy[Class] = Policy;
+    }
+
+    /**
+     * Returns the policy of the block cache for the given class of data
+     * (see SetBlockCachePolicy()).
+     */
+    cache_policy_t GetBlockCachePolicy(cache_class_t Class) {
+        mutex_lock_t lock(blockCache.mutex);
+        return blockCache.policy[Class];
+    }
+
+    /**
+     * Returns the counters of the block cache for the given class of data
+     * since the process started.
+     */
+    block_cache_statistics_t GetBlockCacheStatistics(cache_class_t Class) {
+        mutex_lock_t lock(blockCache.mutex);
+        block_cache_statistics_t stats = blockCache.stats[Class];
+        stats.BytesCached = blockCache.used[Class];
+        return stats;
+    }
+
+    /**
+     * Drops all blocks from the block cache (see SetBlockCacheSize()).
+     */
+    void ClearBlockCache() {
+        mutex_lock_t lock(blockCache.mutex);
+        blockCache.blocks.clear();
+        for (int i = 0; i < 2; ++i) {
+            blockCache.lru[i].clear();
+            blockCache.used[i] = 0;
+        }
+    }
+
 } // namespace RIFF
@@ -40,6 +40,7 @@
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
 #include <iostream>
 #include <stdarg.h>
 
@@ -82,6 +83,7 @@ typedef unsigned __int64 uint64_t;
 # define CHUNK_ID_RIFF	0x52494646
 # define CHUNK_ID_RIFX	0x52494658
 # define CHUNK_ID_LIST	0x4C495354
+# define CHUNK_ID_JUNK	0x4A554E4B
 
 # define LIST_TYPE_INFO	0x494E464F
 # define CHUNK_ID_ICMT	0x49434D54
@@ -98,6 +100,7 @@ typedef unsigned __int64 uint64_t;
 # define CHUNK_ID_RIFF	0x46464952
 # define CHUNK_ID_RIFX	0x58464952
 # define CHUNK_ID_LIST	0x5453494C
+# define CHUNK_ID_JUNK	0x4B4E554A
 
 # define LIST_TYPE_INFO	0x4F464E49
 # define CHUNK_ID_ICMT	0x544D4349
@@ -141,6 +144,13 @@ namespace RIFF {
     class Chunk;
     class List;
     class File;
+    struct save_plan_t;
+    struct move_pipeline_t;
+    struct save_commit_t;
+    class IODevice;
+    struct chunk_arena_t;
+    struct scan_state_t;
+    struct scan_cursor_t;
 
     typedef std::string String;
 
@@ -189,6 +199,233 @@ namespace RIFF {
         offset_size_64bit = 8  ///< Always use 64 bit offsets (even for files smaller than 4 GB).
     };
 
+    /** Method used for reading from a RIFF file. @see File::SetIOBackend() */
+    enum io_backend_t {
+        io_backend_file = 0, ///< Read by seeking and reading the file handle (default).
+        io_backend_mmap = 1, ///< Read from a memory-mapped view of the whole file while the file is opened in read-only mode.
+        io_backend_uring = 2 ///< Like io_backend_file, but File::ReadBatch() submits all reads of a batch at once by the I/O device (i.e. by Linux io_uring respectively Windows I/O completion ports for regular files, falls back to io_backend_file if not available).
+    };
+
+    /** Special NUMA node numbers for the placement of sample data in RAM (node numbers >= 0 select the respective node). @see File::SetNumaNode() */
+    enum numa_node_t {
+        numa_node_default    = -1, ///< No particular placement: memory is allocated on the node of the thread first touching it (default behavior of the operating system).
+        numa_node_interleave = -2  ///< The memory pages are interleaved round-robin across all NUMA nodes.
+    };
+
+    /** Method used for writing a new file by File::Save(const String&). @see File::SetWriteBackend() */
+    enum write_backend_t {
+        write_backend_file = 0, ///< Write by the file handle (default).
+        write_backend_mmap = 1  ///< Size the new file once, map it and copy the chunk data directly into the mapped view (falls back to write_backend_file if the file cannot be mapped).
+    };
+
+    /** Expected access pattern of a range of a RIFF file. @see File::Advise() */
+    enum advice_t {
+        advice_normal     = 0, ///< No particular access pattern (default behavior of the operating system).
+        advice_willneed   = 1, ///< The range is going to be read soon, so it should be read ahead asynchronously (see File::Prefetch()).
+        advice_sequential = 2, ///< The range is going to be read sequentially (i.e. streamed), so aggressive read-ahead pays off.
+        advice_random     = 3, ///< The range is going to be read in random order, so read-ahead would be wasted.
+        advice_dontneed   = 4  ///< The range is not going to be read again soon, so its pages may be evicted from the page cache.
+    };
+
+    /** How disk space is allocated when a RIFF file is enlarged. @see File::SetAllocationPolicy() */
+    enum alloc_policy_t {
+        alloc_policy_sparse  = 0, ///< Just set the new file size (default), the file system allocates the space not before the data is actually written.
+        alloc_policy_reserve = 1  ///< Reserve the disk space for the whole file before writing (by fallocate() or posix_fallocate() on POSIX systems, by the allocation size and, if permitted, the valid data length on Windows).
+    };
+
+    /** How File::Save() writes a file to the same file. @see File::SetSaveMode() */
+    enum save_mode_t {
+        save_mode_in_place = 0, ///< Rewrite the file in place (default), moving data within the file as required; chunks must not be read by other threads while saving.
+        save_mode_replace  = 1  ///< Write a new temporary file next to the original one and replace the original file by it at the end; chunks may be read by other threads while saving.
+    };
+
+    /** One read operation of a batch (see File::ReadBatch()). */
+    struct read_op_t {
+        const Chunk*  pChunk; ///< Chunk to be read from.
+        file_offset_t Pos;    ///< Position (in bytes) within the chunk's data body to start reading from.
+        void*         pData;  ///< Destination buffer.
+        file_offset_t Size;   ///< Amount of bytes to be read.
+        file_offset_t Result; ///< (out) Amount of bytes actually read.
+    };
+
+    /** One read request of a batch (see IODevice::ReadBatch()). */
+    struct io_request_t {
+        file_offset_t Offset; ///< Absolute position (in bytes) within the device to start reading from.
+        void*         pData;  ///< Destination buffer.
+        file_offset_t Size;   ///< Amount of bytes to be read.
+        file_offset_t Result; ///< (out) Amount of bytes actually read.
+    };
+
+    /**
+     * @brief I/O statistics of a RIFF file.
+     *
+     * Snapshot of the counters a File object accumulates while its data is
+     * read and written (see File::GetStatistics()). All counters start at
+     * zero when the File object is created and can be reset at any time by
+     * File::ResetStatistics(). They are always zero if libgig was compiled
+     * with statistics disabled (configure --disable-statistics).
+     */
+    struct io_statistics_t {
+        uint64_t BytesRead;    ///< Amount of bytes read from the I/O device.
+        uint64_t BytesWritten; ///< Amount of bytes written to the I/O device.
+        uint64_t BytesMapped;  ///< Amount of bytes copied from the memory-mapped view of the file instead of being read from the I/O device (see io_backend_mmap).
+        uint64_t ReadCalls;    ///< Amount of read operations performed on the I/O device.
+        uint64_t WriteCalls;   ///< Amount of write operations performed on the I/O device.
+        uint64_t SeekCalls;    ///< Amount of Chunk::SetPos() calls repositioning a chunk's read position other than relative to its current position.
+        uint64_t CacheHits;    ///< Amount of small reads served from data which was already buffered in memory (chunk read-ahead and chunk header scan buffers).
+        uint64_t CacheMisses;  ///< Amount of small reads which had to (re)load such a buffer from the I/O device first.
+    };
+
+    /** Outcome of File::Probe() and of the TryOpen() methods of the file formats. */
+    enum probe_status_t {
+        probe_ok         = 0, ///< The file is of the expected type (and could be loaded by TryOpen()).
+        probe_open_error = 1, ///< The file could not be opened or read (i.e. it does not exist or is not readable).
+        probe_truncated  = 2, ///< The file is too short for a RIFF file header.
+        probe_not_riff   = 3, ///< The file has neither a 'RIFF' nor a 'RIFX' header.
+        probe_wrong_type = 4, ///< The file is a RIFF file, but of another form type than expected.
+        probe_invalid    = 5  ///< The file's header is fine, but loading its content failed.
+    };
+
+    /**
+     * @brief Result of probing a file without exceptions.
+     *
+     * Filled by File::Probe() and by the TryOpen() methods of the file
+     * formats (i.e. gig::File::TryOpen()), which report failures this way
+     * instead of throwing an exception with a formatted message. That's
+     * much cheaper when crawling directories with many files which turn
+     * out not to be instrument files.
+     */
+    struct probe_result_t {
+        probe_status_t Status;         ///< Whether the file is of the expected type.
+        const char*    Detail;         ///< Static text describing Status (never NULL, must not be freed).
+        uint32_t       FileType;       ///< Form type of the RIFF file (i.e. RIFF_TYPE_DLS), 0 if not determined.
+        endian_t       Endian;         ///< Byte order of the file (endian_little for 'RIFF', endian_big for 'RIFX' files).
+        int            FileOffsetSize; ///< Size of the file offsets in the RIFF chunk headers (4 or 8), 0 if not determined.
+        file_offset_t  FileSize;       ///< Size of the file (in bytes), 0 if not determined.
+
+        probe_result_t() : Status(probe_ok), Detail(""), FileType(0), Endian(endian_little), FileOffsetSize(0), FileSize(0) {}
+    };
+
+    /** Kind of data, each cached with its own size and policy by the block cache (see SetBlockCacheSize()). */
+    enum cache_class_t {
+        cache_class_metadata    = 0, ///< Chunk headers and the bodies of all chunks except sample data chunks.
+        cache_class_sample_data = 1  ///< Bodies of 'data' and 'smpl' chunks, i.e. the sample data of gig, DLS and SoundFont files.
+    };
+
+    /** Which reads of a class of data go through the block cache (see SetBlockCachePolicy()). */
+    enum cache_policy_t {
+        cache_policy_none        = 0, ///< No reads are cached.
+        cache_policy_all         = 1, ///< All reads are cached.
+        cache_policy_small_reads = 2  ///< Only reads smaller than a cache block are cached, larger reads (i.e. streaming) go directly to the I/O device.
+    };
+
+    /** Counters of the block cache for one class of data (see GetBlockCacheStatistics()). */
+    struct block_cache_statistics_t {
+        uint64_t Hits;        ///< Amount of blocks read from the cache.
+        uint64_t Misses;      ///< Amount of blocks which had to be read from the I/O device.
+        uint64_t Evictions;   ///< Amount of blocks dropped from the cache to make room for others.
+        uint64_t BytesCached; ///< Amount of bytes currently held by the cache.
+    };
+
+    /**
+     * Types of events reported to a tracer (see tracer_t). Events ending
+     * with @c _begin and @c _end are reported in pairs (the @c _end event
+     * also if the operation failed by an exception), the others once after
+     * the operation completed.
+     */
+    enum trace_event_type_t {
+        trace_read                  = 0,  ///< Data was read from the I/O device (@c pObject: File, @c Offset: file position, @c Size: bytes read, @c Duration).
+        trace_write                 = 1,  ///< Data was written to the I/O device (@c pObject: File, @c Offset: file position, @c Size: bytes written, @c Duration).
+        trace_seek                  = 2,  ///< A chunk's read position was set by Chunk::SetPos() other than relative to its current position (@c pObject: Chunk, @c Offset: new position within the chunk body).
+        trace_sample_read_begin     = 3,  ///< gig only: reading sample data starts (@c pObject: gig::Sample, @c Offset: sample position, @c Size: sample points requested).
+        trace_sample_read_end       = 4,  ///< gig only: reading sample data ended (@c Size: sample points read, @c Duration).
+        trace_sample_loop_begin     = 5,  ///< gig only: reading sample data with loop handling (ReadAndLoop() and friends) starts, encloses one sample read per loop cycle (like trace_sample_read_begin).
+        trace_sample_loop_end       = 6,  ///< gig only: reading sample data with loop handling ended (like trace_sample_read_end).
+        trace_instrument_load_begin = 7,  ///< gig only: loading an instrument starts (@c pObject: its 'ins ' List, @c Offset: instrument index, @c Size: list size).
+        trace_instrument_load_end   = 8,  ///< gig only: loading an instrument ended (@c pObject: gig::Instrument or NULL on failure, @c Name: instrument name, @c Duration).
+        trace_save_begin            = 9,  ///< A phase of saving the file starts (@c pObject: File, @c Name: phase, i.e. "update chunks", "load chunks", "move data", "write chunks").
+        trace_save_end              = 10  ///< A phase of saving the file ended (@c Name: phase, @c Duration).
+    };
+
+    /** One event reported to a tracer (see tracer_t). */
+    struct trace_event_t {
+        trace_event_type_t Type;     ///< What happened.
+        const void*        pObject;  ///< Object concerned (see trace_event_type_t).
+        file_offset_t      Offset;   ///< Position or index (see trace_event_type_t), 0 if not applicable.
+        file_offset_t      Size;     ///< Amount of bytes or sample points (see trace_event_type_t), 0 if not applicable.
+        uint64_t           Duration; ///< Duration of the operation in nanoseconds (0 for @c _begin events and seeks).
+        const char*        Name;     ///< Name of the operation or object (only valid during the callback), NULL if not applicable.
+    };
+
+    /**
+     * @brief Receives events for tracing I/O and parsing (see File::SetTracer()).
+     *
+     * Allows to find out which operations take how long, e.g. by
+     * forwarding the events to perf, LTTng or Tracy. The callback is called
+     * synchronously by the thread performing the operation, so it must be
+     * thread safe if the file is read by several threads, and it should
+     * return quickly. If no tracer is installed (the default), tracing just
+     * costs one pointer comparison per operation.
+     */
+    struct tracer_t {
+        void (*callback)(tracer_t* pTracer, const trace_event_t* pEvent); ///< Callback function pointer which has to be assigned to a function receiving the events.
+        void* custom; ///< This pointer can be used for arbitrary data.
+        tracer_t();
+    };
+
+    /**
+     * @brief Allocator for sample data and decompression buffers (see SetSampleAllocator()).
+     *
+     * Allows applications to provide their own memory for the sample data
+     * cached in RAM (i.e. by the LoadSampleData() methods of gig, SoundFont
+     * and KORG samples) and for the decompression buffers of gig samples,
+     * for example memory locked by mlock() to avoid page faults on a
+     * real-time audio thread, huge page backed, NUMA local or pooled
+     * memory. The callbacks may be called by any thread, so they must be
+     * thread safe if samples are loaded by several threads.
+     */
+    struct allocator_t {
+        void* (*allocate)(allocator_t* pAllocator, size_t Size); ///< Must return a buffer of at least @a Size bytes suitably aligned for any type, or NULL if out of memory (std::bad_alloc is thrown by libgig then).
+        void  (*deallocate)(allocator_t* pAllocator, void* pData, size_t Size); ///< Frees a buffer previously returned by @a allocate or @a allocate_on_node, @a Size is the same value that was passed to it.
+        void* (*allocate_on_node)(allocator_t* pAllocator, size_t Size, int Node); ///< Optional: like @a allocate, but for a buffer to be placed on NUMA node @a Node (or interleaved, see numa_node_t), called instead of @a allocate whenever a placement was requested (see File::SetNumaNode()); if NULL, placement requests are ignored.
+        void* custom; ///< This pointer can be used for arbitrary data.
+        allocator_t();
+    };
+
+    /**
+     * @brief Runs the library's internal parallel work on threads of the application.
+     *
+     * All work libgig does on other threads than the calling one (i.e.
+     * parallel loading, scanning and checksum verification of files, the
+     * workers of gig::SampleReadQueue and gig::StreamEngine) is handed to
+     * the executor installed by SetExecutor(), so applications can run it
+     * on their own thread pool, respecting their core affinities and
+     * priorities (for example to keep cores free for their audio
+     * threads). Without an executor, libgig uses its own process wide
+     * thread pool with one thread per CPU core.
+     *
+     * Tasks are always independent of each other: libgig never waits for a
+     * task that was not started yet, except for @a Dedicated ones. The
+     * callbacks may be called by any thread, so they must be thread safe.
+     */
+    struct executor_t {
+        bool (*execute)(executor_t* pExecutor, void (*task)(void* arg), void* arg, bool Dedicated); ///< Must run @a task with argument @a arg asynchronously on any thread and return true, or return false if it can't (libgig then does the work with less threads). @a Dedicated tasks run for a long time or wait for other threads, so they must start right away on a thread of their own instead of waiting in a queue behind other tasks.
+        int   (*concurrency)(executor_t* pExecutor); ///< Optional: returns how many tasks may run in parallel (i.e. the amount of threads of the pool); if NULL the amount of CPU cores is assumed.
+        void* custom; ///< This pointer can be used for arbitrary data.
+        executor_t();
+    };
+
+    /**
+     * @brief Source of chunk data written by File::SaveSequential().
+     *
+     * Called for chunks whose data is neither loaded into RAM nor stored in
+     * the file yet, in the order the chunks are written to the file. The
+     * function should copy up to @a Size bytes of the next portion of
+     * @a pChunk's data to @a pBuffer and return the amount of bytes copied.
+     * Returning 0 causes the rest of the chunk to be filled with zeros.
+     */
+    typedef file_offset_t (*chunk_source_t)(Chunk* pChunk, void* pBuffer, file_offset_t Size, void* pUserData);
+
     /**
      * @brief Used for indicating the progress of a certain task.
      *
@@ -200,13 +437,19 @@ namespace RIFF {
      * reflect the current progress as value between 0.0 and 1.0. You might
      * want to use the custom field for data needed in your callback
      * function.
+     *
+     * Long running operations can be cancelled by setting the cancel field
+     * to true in the callback function. The operation then stops at its
+     * next safe point and throws a CancelException.
      */
     struct progress_t {
         void (*callback)(progress_t*); ///< Callback function pointer which has to be assigned to a function for progress notification.
         float factor;                  ///< Reflects current progress as value between 0.0 and 1.0.
         void* custom;                  ///< This pointer can be used for arbitrary data.
+        bool  cancel;                  ///< Set this to true in the callback function to cancel the operation (see CancelException).
         float __range_min;             ///< Only for internal usage, do not modify!
         float __range_max;             ///< Only for internal usage, do not modify!
+        progress_t* __parent;          ///< Only for internal usage, do not modify!
         progress_t();
     };
 
@@ -230,6 +473,8 @@ namespace RIFF {
             file_offset_t  RemainingBytes() const;
             stream_state_t GetState() const;
             file_offset_t  Read(void* pData, file_offset_t WordCount, file_offset_t WordSize);
+            file_offset_t  ReadAt(file_offset_t Pos, void* pData, file_offset_t WordCount, file_offset_t WordSize) const;
+            file_offset_t  ReadUnbufferedAt(file_offset_t Pos, void* pData, file_offset_t WordCount, file_offset_t WordSize) const;
             file_offset_t  ReadInt8(int8_t* pData,     file_offset_t WordCount = 1);
             file_offset_t  ReadUint8(uint8_t* pData,   file_offset_t WordCount = 1);
             file_offset_t  ReadInt16(int16_t* pData,   file_offset_t WordCount = 1);
@@ -251,9 +496,19 @@ namespace RIFF {
             file_offset_t  WriteInt32(int32_t* pData,   file_offset_t WordCount = 1);
             file_offset_t  WriteUint32(uint32_t* pData, file_offset_t WordCount = 1);
             void*          LoadChunkData();
+            bool           PrepareSequentialRead();
+            const void*    GetMappedData(file_offset_t WordSize = 1) const;
+            void           Advise(file_offset_t Pos, file_offset_t Size, advice_t Advice) const;
             void           ReleaseChunkData();
             void           Resize(file_offset_t NewSize);
+            file_offset_t  CopyDataFrom(const Chunk* pSource, progress_t* pProgress = NULL);
+            virtual file_offset_t RequiredPhysicalSize(int fileOffsetSize);
+            virtual size_t GetMemoryUsage() const;
             virtual ~Chunk();
+            static void*   operator new(size_t size);
+            static void*   operator new(size_t size, File* pFile);
+            static void    operator delete(void* p);
+            static void    operator delete(void* p, File* pFile);
         protected:
             uint32_t      ChunkID;
             file_offset_t ullCurrentChunkSize;		/* in bytes */
@@ -264,6 +519,10 @@ namespace RIFF {
             file_offset_t ullPos;       /* # of bytes from ulStartPos */
             uint8_t*      pChunkData;
             file_offset_t ullChunkDataSize;
+            uint8_t*      pReadAhead;   /* whole chunk body read at once for small reads (see Read()) */
+            uint64_t      ullStoredHash; /* hash of the chunk data in RAM as it is currently stored in the file (only if bHashValid) */
+            bool          bHashValid;
+            bool          bModified;    /* chunk was written, resized, added or its sub chunks were modified since last Save() */
 
             Chunk(File* pFile);
             Chunk(File* pFile, List* pParent, uint32_t uiChunkID, file_offset_t ullBodySize);
@@ -279,11 +538,21 @@ namespace RIFF {
                 }
                 return result;
             }
-            virtual file_offset_t RequiredPhysicalSize(int fileOffsetSize);
             virtual file_offset_t WriteChunk(file_offset_t ullWritePos, file_offset_t ullCurrentDataOffset, progress_t* pProgress = NULL);
+            virtual file_offset_t __planWrite(file_offset_t ullWritePos, save_plan_t& plan);
+            virtual file_offset_t __writeSequential(file_offset_t ullWritePos, chunk_source_t Source, void* pUserData, progress_t* pProgress);
             virtual void __resetPos(); ///< Sets Chunk's read/write position to zero.
+            bool __loadReadAhead(bool bAnySize = false);
+            void __releaseReadAhead();
+            file_offset_t __readAt(file_offset_t Pos, void* pData, file_offset_t WordCount, file_offset_t WordSize, bool bUnbuffered) const;
+            file_offset_t __readRaw(file_offset_t Pos, void* pData, file_offset_t WordCount, file_offset_t WordSize, bool bUnbuffered) const;
+            cache_class_t __cacheClass() const;
+            bool __isUnchanged(file_offset_t ullDataPos, file_offset_t ullCurrentDataOffset) const;
+            void __setWritten(file_offset_t ullNewStartPos);
+            size_t __bufferMemoryUsage() const;
 
             friend class List;
+            friend class File; // for File::ReadBatch() and File::__adjustSlack()
     };
 
     /** @brief RIFF List Chunk
@@ -302,6 +571,10 @@ namespace RIFF {
             Chunk*       GetNextSubChunk();
             List*        GetFirstSubList();
             List*        GetNextSubList();
+            Chunk*       GetSubChunkAt(size_t pos);
+            List*        GetSubListAt(size_t pos);
+            Chunk*       GetSubChunkAt(uint32_t ChunkID, size_t pos);
+            List*        GetSubListAt(uint32_t ListType, size_t pos);
             size_t       CountSubChunks();
             size_t       CountSubChunks(uint32_t ChunkID);
             size_t       CountSubLists();
@@ -311,17 +584,27 @@ namespace RIFF {
             void         DeleteSubChunk(Chunk* pSubChunk);
             void         MoveSubChunk(Chunk* pSrc, Chunk* pDst); // read API doc comments !!!
             void         MoveSubChunk(Chunk* pSrc, List* pNewParent);
+            virtual file_offset_t RequiredPhysicalSize(int fileOffsetSize);
+            virtual size_t GetMemoryUsage() const;
             virtual ~List();
         protected:
-            typedef std::map<uint32_t, RIFF::Chunk*>  ChunkMap;
-            typedef std::list<Chunk*>                 ChunkList;
+            typedef std::vector<Chunk*>               ChunkList;
             typedef std::set<Chunk*>                  ChunkSet;
+            /// All sub chunks with the same chunk ID (respectively list type).
+            struct chunk_index_t {
+                Chunk*    pMapped; ///< Sub chunk returned by GetSubChunk() (not used for list types).
+                ChunkList Chunks;  ///< In the same order as in SubChunks.
+            };
+            typedef std::vector< std::pair<uint32_t, chunk_index_t> > ChunkMap; ///< Sorted by chunk ID (respectively list type).
 
             uint32_t   ListType;
-            ChunkList* pSubChunks;
-            ChunkMap*  pSubChunksMap;
-            ChunkList::iterator ChunksIterator;
-            ChunkList::iterator ListIterator;
+            bool       bSubChunksLoaded;
+            ChunkList  SubChunks;
+            ChunkMap   SubChunksMap; ///< Index of all sub chunks by chunk ID.
+            ChunkMap   SubListsMap;  ///< Index of all sub lists by list type.
+            size_t     ChunksIterator;
+            size_t     ListIterator;
+            file_offset_t ullRequiredSize[2]; ///< Cached results of RequiredPhysicalSize() for 32 and 64 bit file offsets (0 if not calculated yet).
 
             List(File* pFile);
             List(File* pFile, List* pParent, uint32_t uiListID);
@@ -329,10 +612,174 @@ namespace RIFF {
             void WriteHeader(file_offset_t filePos);
             void LoadSubChunks(progress_t* pProgress = NULL);
             void LoadSubChunksRecursively(progress_t* pProgress = NULL);
-            virtual file_offset_t RequiredPhysicalSize(int fileOffsetSize);
             virtual file_offset_t WriteChunk(file_offset_t ullWritePos, file_offset_t ullCurrentDataOffset, progress_t* pProgress = NULL);
+            virtual file_offset_t __planWrite(file_offset_t ullWritePos, save_plan_t& plan);
+            virtual file_offset_t __writeSequential(file_offset_t ullWritePos, chunk_source_t Source, void* pUserData, progress_t* pProgress);
             virtual void __resetPos(); ///< Sets List Chunk's read/write position to zero and causes all sub chunks to do the same.
             void DeleteChunkList();
+            void __indexChunk(Chunk* pCk, bool bMap = true);
+            void __unindexChunk(Chunk* pCk);
+            void __reorderIndex(Chunk* pCk);
+            static bool __compareChunkMapEntry(const std::pair<uint32_t, chunk_index_t>& a, uint32_t ID);
+            static chunk_index_t* __findIndex(ChunkMap& map, uint32_t ID);
+            static chunk_index_t& __makeIndex(ChunkMap& map, uint32_t ID);
+            static void __removeFromIndex(ChunkMap& map, uint32_t ID, Chunk* pCk);
+            void __removeChunk(Chunk* pCk);
+            void __invalidateRequiredSize();
+            size_t __subChunksMemoryUsage() const;
+
+            friend class Chunk; // for invalidating the cached required size of parent lists
+            friend class File; // for File::GetRequiredFilePos()
+    };
+
+    /** @brief Abstract storage a RIFF File is read from and written to.
+     *
+     * All accesses of a RIFF::File to its underlying storage are performed
+     * through this interface. By default, RIFF files are stored in regular
+     * files of the file system (using POSIX, Windows or standard C file
+     * functions, depending on the system). By implementing this interface
+     * and passing an instance to the respective RIFF::File constructor, an
+     * application may provide its own storage instead (e.g. in memory
+     * images, encrypted containers or remote files).
+     *
+     * All offsets are absolute byte positions within the device. ReadAt()
+     * and WriteAt() must not depend on a shared file position, so that
+     * different chunks may be read concurrently by several threads.
+     */
+    class IODevice {
+        public:
+            virtual ~IODevice() {}
+
+            /**
+             * Reads up to @a Size bytes from position @a Offset.
+             *
+             * @returns amount of bytes actually read, 0 at the end of the
+             *          device or on error
+             */
+            virtual file_offset_t ReadAt(file_offset_t Offset, void* pData, file_offset_t Size) = 0;
+
+            /**
+             * Writes @a Size bytes to position @a Offset, enlarging the
+             * device if the data does not fit.
+             *
+             * @returns amount of bytes actually written, 0 on error
+             */
+            virtual file_offset_t WriteAt(file_offset_t Offset, const void* pData, file_offset_t Size) = 0;
+
+            /// Returns the current size of the device in bytes.
+            virtual file_offset_t GetSize() const = 0;
+
+            /**
+             * Truncates or enlarges the device to @a NewSize bytes.
+             *
+             * @throws RIFF::Exception on error
+             */
+            virtual void Resize(file_offset_t NewSize) = 0;
+
+            /**
+             * Opens the device in the requested access mode (and closes it
+             * with stream_mode_closed). RIFF::File calls this method when
+             * its access mode is changed (see File::SetMode()). The default
+             * implementation does nothing, i.e. the device is considered to
+             * be always readable and writable.
+             *
+             * @throws RIFF::Exception if the requested access mode is not
+             *         supported by the device
+             */
+            virtual void SetMode(stream_mode_t /*NewMode*/) {}
+
+            /// Returns whether the device is currently open for reading.
+            virtual bool IsOpen() const { return true; }
+
+            /**
+             * Hints the device that the given range is going to be read
+             * soon (see File::Prefetch()). The default implementation does
+             * nothing.
+             */
+            virtual void Advise(file_offset_t /*Offset*/, file_offset_t /*Size*/) {}
+
+            /**
+             * Hints the device about the expected access pattern of the
+             * given range (see File::Advise()). The default implementation
+             * calls Advise(Offset, Size) for advice_willneed and ignores
+             * all other hints.
+             */
+            virtual void Advise(file_offset_t Offset, file_offset_t Size, advice_t Advice) {
+                if (Advice == advice_willneed) Advise(Offset, Size);
+            }
+
+            /**
+             * Enables (or disables) reading by ReadUnbufferedAt() without
+             * the operating system's page cache (see File::SetUnbuffered()).
+             * The default implementation does not support this.
+             *
+             * @returns alignment (in bytes) required for the offset, size
+             *          and buffer address of ReadUnbufferedAt(), or 0 if
+             *          unbuffered reading is not available (anymore)
+             */
+            virtual size_t EnableUnbuffered(bool /*bEnable*/) { return 0; }
+
+
+            /**
+             * Like ReadAt(), but bypasses the operating system's page cache
+             * if enabled by EnableUnbuffered(). @a Offset, @a Size and the
+             * address @a pData must be multiples of the alignment returned
+             * by EnableUnbuffered() then. The default implementation calls
+             * ReadAt().
+             */
+            virtual file_offset_t ReadUnbufferedAt(file_offset_t Offset, void* pData, file_offset_t Size) {
+                return ReadAt(Offset, pData, Size);
+            }
+
+            /**
+             * Returns a read-only view of the whole device's content in
+             * memory (see io_backend_mmap), or NULL if the device does not
+             * support this (default). The view must stay valid until
+             * Unmap() is called.
+             *
+             * @param Size - (out) size of the view in bytes
+             */
+            virtual const uint8_t* Map(file_offset_t& /*Size*/) { return NULL; }
+
+
+            /// Releases the view returned by Map().
+            virtual void Unmap() {}
+
+            /**
+             * Performs a whole batch of read requests (see
+             * File::ReadBatch()). The default implementation simply calls
+             * ReadAt() for each request.
+             */
+            virtual void ReadBatch(io_request_t* pRequests, size_t Count) {
+                for (size_t i = 0; i < Count; ++i)
+                    pRequests[i].Result = ReadAt(pRequests[i].Offset, pRequests[i].pData, pRequests[i].Size);
+            }
+
+            /**
+             * Reserves storage for the first @a Size bytes of the device
+             * (i.e. its new size), plus @a Headroom bytes beyond its end if
+             * supported, without changing the device's size or content (see
+             * File::SetAllocationPolicy()). The default implementation does
+             * nothing.
+             */
+            virtual void Reserve(file_offset_t /*Size*/, file_offset_t /*Headroom*/) {}
+
+
+            /**
+             * Copies @a Size bytes from position @a SourceOffset of device
+             * @a pSource to position @a Offset of this device without
+             * passing the data through a user space buffer (see
+             * Chunk::CopyDataFrom() and File::Save()). On Linux, file
+             * devices share the data blocks with the source (reflink) on
+             * file systems supporting that, and copy in-kernel otherwise.
+             * The default implementation does nothing, in which case the
+             * caller copies the remaining bytes by ReadAt() and WriteAt()
+             * instead.
+             *
+             * @returns amount of bytes actually copied
+             */
+            virtual file_offset_t CopyRangeFrom(IODevice* /*pSource*/, file_offset_t /*SourceOffset*/, file_offset_t /*Offset*/, file_offset_t /*Size*/) { return 0; }
+
     };
 
     /** @brief RIFF File
@@ -346,6 +793,10 @@ namespace RIFF {
             File(uint32_t FileType);
             File(const String& path);
             File(const String& path, uint32_t FileType, endian_t Endian, layout_t layout, offset_size_t fileOffsetSize = offset_size_auto);
+            File(IODevice* pDevice);
+            File(const void* pData, file_offset_t Size, bool bCopy = false);
+            static probe_status_t Probe(const String& path, uint32_t FileType = 0, probe_result_t* pResult = NULL);
+            static File* TryOpen(const String& path, uint32_t FileType = 0, probe_result_t* pResult = NULL);
             stream_mode_t GetMode() const;
             bool          SetMode(stream_mode_t NewMode);
             void SetByteOrder(endian_t Endian);
@@ -358,21 +809,39 @@ namespace RIFF {
             file_offset_t GetRequiredFileSize(offset_size_t fileOffsetSize);
             int GetFileOffsetSize() const;
             int GetRequiredFileOffsetSize();
+            void SetIOBackend(io_backend_t backend);
+            io_backend_t GetIOBackend() const;
+            void SetNumaNode(int Node);
+            int GetNumaNode() const;
+            void Prefetch(file_offset_t Offset, file_offset_t Size) const;
+            void Advise(file_offset_t Offset, file_offset_t Size, advice_t Advice) const;
+            bool SetUnbuffered(bool bUnbuffered);
+            size_t GetUnbufferedAlignment() const;
+            void ReadBatch(read_op_t* pOps, size_t Count);
+            void SetSlackSize(file_offset_t Size);
+            file_offset_t GetSlackSize() const;
+            void SetAllocationPolicy(alloc_policy_t Policy, file_offset_t Headroom = 0);
+            alloc_policy_t GetAllocationPolicy() const;
+            file_offset_t GetAllocationHeadroom() const;
+            void SetSaveMode(save_mode_t Mode);
+            save_mode_t GetSaveMode() const;
+            void SetWriteBackend(write_backend_t backend);
+            write_backend_t GetWriteBackend() const;
+            file_offset_t GetRequiredFilePos(Chunk* pChunk, int fileOffsetSize);
+            virtual size_t GetMemoryUsage() const;
+            io_statistics_t GetStatistics() const;
+            void SetTracer(tracer_t* pTracer);
+            tracer_t* GetTracer() const;
+            void ResetStatistics();
 
             virtual void Save(progress_t* pProgress = NULL);
             virtual void Save(const String& path, progress_t* pProgress = NULL);
+            void SaveSequential(const String& path, chunk_source_t Source = NULL, void* pUserData = NULL, progress_t* pProgress = NULL);
+            void SaveSequential(IODevice* pSink, chunk_source_t Source = NULL, void* pUserData = NULL, progress_t* pProgress = NULL);
             virtual ~File();
         protected:
-            #if POSIX
-            int    hFileRead;  ///< handle / descriptor for reading from file
-            int    hFileWrite; ///< handle / descriptor for writing to (some) file
-            #elif defined(WIN32)
-            HANDLE hFileRead;  ///< handle / descriptor for reading from file
-            HANDLE hFileWrite; ///< handle / descriptor for writing to (some) file
-            #else
-            FILE*  hFileRead;  ///< handle / descriptor for reading from file
-            FILE*  hFileWrite; ///< handle / descriptor for writing to (some) file
-            #endif // POSIX
+            IODevice* pDevice;      ///< device for reading from file (owned by this File object)
+            IODevice* pWriteDevice; ///< device for writing to (some) file, usually the same as pDevice (except while saving to another file)
             String Filename;
             bool   bEndianNative;
             bool   bIsNewFile;
@@ -384,20 +853,123 @@ namespace RIFF {
             friend class List;
         private:
             stream_mode_t  Mode;
+            io_backend_t   IOBackend;
+            uint8_t*       pMappedData;   ///< Memory-mapped view of the whole file (only with io_backend_mmap in read-only mode, NULL otherwise).
+            file_offset_t  ullMappedSize; ///< Size of the memory-mapped view in bytes.
+            chunk_arena_t* pChunkArena;   ///< Slab allocator for all chunk objects of this file's chunk tree.
+            std::vector<uint8_t> ScanBuffer; ///< Block of chunk headers read at once while List::LoadSubChunks() is scanning a list (empty otherwise).
+            file_offset_t  ullScanPos;    ///< File position of the first byte in ScanBuffer.
+            file_offset_t  ullSlackSize;  ///< Size of the 'JUNK' chunk reserved for absorbing size changes in place on Save() (see SetSlackSize()).
+            bool           bRewriteAll;   ///< Set by Save() if unmodified chunks at their old position must be written nevertheless (i.e. file offset size changed).
+            alloc_policy_t AllocPolicy;   ///< How disk space is allocated when the file is enlarged (see SetAllocationPolicy()).
+            file_offset_t  ullAllocHeadroom; ///< Additional disk space reserved beyond the end of the file with alloc_policy_reserve.
+            io_statistics_t Statistics;   ///< I/O counters (updated atomically, as chunks may be read concurrently).
+            tracer_t*      pTracer;       ///< Receives trace events (NULL if tracing is disabled, see SetTracer()).
+            size_t         UnbufferedAlignment; ///< Alignment required for reads bypassing the page cache (0 if not enabled, see SetUnbuffered()).
+            int            NumaNode;      ///< NUMA placement of sample data cached in RAM (see SetNumaNode()).
+            save_mode_t    SaveMode;      ///< How Save() writes the file (see SetSaveMode()).
+            write_backend_t WriteBackend; ///< How Save(const String&) writes the new file (see SetWriteBackend()).
+            mutable volatile long SaveReaders; ///< save_mode_replace only: amount of chunk reads currently in progress (see __beginRead()).
+            volatile long  SaveCommitting; ///< save_mode_replace only: non zero while Save() switches to the new file, which blocks new chunk reads.
+            save_commit_t* pSaveCommit;   ///< New chunk positions collected while saving with deferred positions, applied at the end of Save() (NULL otherwise).
+            uint64_t       CacheID;       ///< Identifies the blocks of this file in the block cache, replaced whenever the file's data changes (see SetBlockCacheSize(), accessed with the block cache locked).
 
             void __openExistingFile(const String& path, uint32_t* FileType = NULL);
+            void __loadTree(uint32_t* FileType);
+            void __mapFile();
+            void __unmapFile();
+            void __scanBlock(file_offset_t Pos, file_offset_t Size, file_offset_t End);
+            file_offset_t __readHeaderData(file_offset_t Pos, void* pData, file_offset_t Size);
+            file_offset_t __deviceRead(file_offset_t Pos, void* pData, file_offset_t Size);
+            file_offset_t __cachedRead(file_offset_t Pos, void* pData, file_offset_t Size, cache_class_t Class);
+            void __invalidateCache();
+            bool __beginRead() const;
+            void __endRead() const;
+            void __saveTo(const String& path, const String& finalPath, progress_t* pProgress);
+            file_offset_t __deviceReadUnbuffered(file_offset_t Pos, void* pData, file_offset_t Size);
+            file_offset_t __readBounced(file_offset_t Pos, uint8_t* pData, file_offset_t Size);
+            file_offset_t __deviceWrite(file_offset_t Pos, const void* pData, file_offset_t Size);
+            file_offset_t __deviceCopy(File* pSourceFile, file_offset_t SourcePos, file_offset_t Pos, file_offset_t Size);
+            bool __deviceMove(file_offset_t SourcePos, file_offset_t Pos, file_offset_t Size, bool bBackward, bool bExact, progress_t* pProgress);
+            static void __moveReadJob(void* arg);
+            void __adjustSlack();
             void ResizeFile(file_offset_t ullNewSize);
-            #if POSIX
-            file_offset_t __GetFileSize(int hFile) const;
-            #elif defined(WIN32)
-            file_offset_t __GetFileSize(HANDLE hFile) const;
-            #else
-            file_offset_t __GetFileSize(FILE* hFile) const;
-            #endif
+            void __reserveSpace(file_offset_t ullSize);
             int FileOffsetSizeFor(file_offset_t fileSize) const;
             void Cleanup();
     };
 
+    /** What Scanner::Scan() shall do after its callback visited a chunk. */
+    enum scan_action_t {
+        scan_continue = 0, ///< Continue scanning, with the sub chunks of the visited list chunk (if it is one).
+        scan_skip     = 1, ///< Continue scanning, but skip the sub chunks of the visited list chunk.
+        scan_stop     = 2  ///< Stop scanning.
+    };
+
+    /** Chunk header passed to the callback of Scanner::Scan(). */
+    struct scan_entry_t {
+        uint32_t      ChunkID;        ///< Chunk ID (CHUNK_ID_LIST for list chunks, CHUNK_ID_RIFF for the root chunk, also of RIFX files).
+        uint32_t      ListType;       ///< List type of list chunks (for the root chunk the file type), 0 for ordinary chunks.
+        bool          IsList;         ///< Whether this is a list chunk (or the root chunk).
+        int           Level;          ///< Nesting depth: 0 for the root chunk (for the top level chunks of layout_flat files), 1 for its sub chunks and so on.
+        uint32_t      ParentListType; ///< List type of the list chunk containing this chunk (0 for level 0 chunks).
+        file_offset_t Offset;         ///< Absolute file position of the chunk's header.
+        file_offset_t DataOffset;     ///< Absolute file position of the chunk's body (i.e. of the list's first sub chunk), as Chunk::GetFilePos().
+        file_offset_t Size;           ///< Size of the chunk's body in bytes (without header and list type), as Chunk::GetSize().
+    };
+
+    /// Callback of Scanner::Scan(), called once for each visited chunk.
+    typedef scan_action_t (*scan_callback_t)(const scan_entry_t& Entry, void* pUserData);
+
+    /** @brief Lightweight read-only walk over the chunk headers of a RIFF file.
+     *
+     * Class File loads the whole RIFF tree, which allocates one Chunk or
+     * List object (and the containers of each list) per chunk. Tools which
+     * just need to find a few chunks of a file can use a Scanner instead:
+     * Scan() reads the chunk headers of the file in blocks and passes each
+     * chunk's ID, list type, position and size to a callback function,
+     * without allocating anything per chunk. The chunk data can then be
+     * read by ReadAt(), if required.
+     *
+     * The visited chunks may be restricted by AddChunkIDFilter() and
+     * AddListTypeFilter(), and the top level lists of the file may be
+     * scanned in parallel by several threads.
+     */
+    class Scanner {
+        public:
+            Scanner(const String& path, layout_t Layout = layout_standard, offset_size_t FileOffsetSize = offset_size_auto);
+            Scanner(IODevice* pDevice, layout_t Layout = layout_standard, offset_size_t FileOffsetSize = offset_size_auto);
+            virtual ~Scanner();
+            void AddChunkIDFilter(uint32_t ChunkID);
+            void AddListTypeFilter(uint32_t ListType);
+            void ClearFilters();
+            bool Scan(scan_callback_t Callback, void* pUserData = NULL, int ThreadCount = 1);
+            file_offset_t ReadAt(file_offset_t Offset, void* pData, file_offset_t Size) const;
+            uint32_t GetFileType() const;
+            bool IsEndianNative() const;
+            int GetFileOffsetSize() const;
+            file_offset_t GetFileSize() const;
+        private:
+            IODevice*     pDevice;
+            bool          bOwnDevice;     ///< Whether pDevice was created (and has to be deleted) by this Scanner.
+            layout_t      Layout;
+            int           FileOffsetSize;
+            bool          bEndianNative;
+            uint32_t      FileType;       ///< List type of the root chunk (0 with layout_flat).
+            file_offset_t ullRootSize;    ///< Size of the root chunk's body as stored in its header (the file size with layout_flat).
+            std::vector<uint32_t> ChunkIDFilter;
+            std::vector<uint32_t> ListTypeFilter;
+
+            void __init(offset_size_t FileOffsetSize);
+            bool __readHeader(scan_cursor_t& cursor, file_offset_t Pos, file_offset_t End, file_offset_t ReadSize, scan_entry_t& entry) const;
+            bool __visit(scan_state_t& state, const scan_entry_t& entry, scan_action_t& action) const;
+            bool __scanList(scan_state_t& state, scan_cursor_t& cursor, file_offset_t Pos, file_offset_t End, int Level, uint32_t ListType, std::vector<scan_entry_t>* pDeferredLists) const;
+            static void __scanJob(void* arg, size_t index);
+
+            Scanner(const Scanner&);            // not copyable
+            Scanner& operator=(const Scanner&); // not copyable
+    };
+
     /**
      * Will be thrown whenever an error occurs while handling a RIFF file.
      */
@@ -415,8 +987,43 @@ namespace RIFF {
             static String assemble(String format, va_list arg);
     };
 
+    /**
+     * Will be thrown by an operation which was cancelled by its progress
+     * callback (see progress_t::cancel). Operations are only cancelled at
+     * points where the object they were called on is left in a consistent
+     * state: either as before the operation, or with the work done so far
+     * being kept and reused when the operation is called again, see the
+     * respective method's documentation.
+     */
+    class CancelException : public Exception {
+        public:
+            CancelException();
+            void PrintMessage();
+    };
+
     String libraryName();
     String libraryVersion();
 
+    void         SetSampleAllocator(allocator_t* pAllocator);
+    allocator_t* GetSampleAllocator();
+    void*        AllocateSampleBuffer(size_t Size);
+    void*        AllocateSampleBuffer(size_t Size, int Node);
+    void         FreeSampleBuffer(void* pData, size_t Size);
+    int          GetCurrentNumaNode();
+
+    void         SetExecutor(executor_t* pExecutor);
+    executor_t*  GetExecutor();
+
+    void         SetFileHandleLimit(size_t Limit);
+    size_t       GetFileHandleLimit();
+    size_t       CountOpenFileHandles();
+
+    void           SetBlockCacheSize(cache_class_t Class, size_t Size);
+    size_t         GetBlockCacheSize(cache_class_t Class);
+    void           SetBlockCachePolicy(cache_class_t Class, cache_policy_t Policy);
+    cache_policy_t GetBlockCachePolicy(cache_class_t Class);
+    block_cache_statistics_t GetBlockCacheStatistics(cache_class_t Class);
+    void           ClearBlockCache();
+
 } // namespace RIFF
 #endif // __RIFF_H__
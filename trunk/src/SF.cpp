@@ -27,6 +27,19 @@
 
 #include "helper.h"
 #include <math.h>
+#include <string.h>
+
+// SIMD kernels for merging 24 bit sample data: on x86 they are compiled for
+// particular instruction set extensions and selected at runtime, on ARM the
+// NEON kernels are selected at compile time (same as in gig.cpp).
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define SF2_SIMD_X86 1
+# include <immintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__ARM_BIG_ENDIAN)
+# define SF2_SIMD_NEON 1
+# include <arm_neon.h>
+#endif
 
 #define _1200TH_ROOT_OF_2 1.000577789506555
 #define _200TH_ROOT_OF_10 1.011579454259899
@@ -57,6 +70,14 @@ namespace sf2 {
         return ck;
     }
 
+    // returns one of the pdta tables, which are parsed field by field, with
+    // its whole body already buffered (by one read instead of one per field)
+    RIFF::Chunk* GetTableChunk(RIFF::List* list, uint32_t chunkId) {
+        RIFF::Chunk* ck = GetMandatoryChunk(list, chunkId);
+        ck->PrepareSequentialRead();
+        return ck;
+    }
+
     void LoadString(RIFF::Chunk* ck, std::string& s, int strLength) {
         if(ck == NULL) return;
         char* buf = new char[strLength];
@@ -92,9 +113,13 @@ namespace sf2 {
 
     ModulatorItem::ModulatorItem(ModList& mod) :
         ModSrcOper(Modulator(mod.ModSrcOper)),
-        ModAmtSrcOper(Modulator(mod.ModAmtSrcOper))
+        ModDestOper(mod.ModDestOper),
+        ModAmount(mod.ModAmount),
+        ModAmtSrcOper(Modulator(mod.ModAmtSrcOper)),
+        ModTransOper(mod.ModTransOper),
+        Source(mod.ModSrcOper),
+        AmountSource(mod.ModAmtSrcOper)
     {
-
     }
 
     Version::Version(RIFF::Chunk* ck) {
@@ -183,6 +208,14 @@ namespace sf2 {
         RAMCache.Size              = 0;
         RAMCache.pStart            = NULL;
         RAMCache.NullExtensionSize = 0;
+        RAMCache.pNullExtension    = NULL;
+        RAMCacheMapped             = false;
+
+        pLinkedSample = NULL;
+    }
+
+    Sample::~Sample() {
+        ReleaseSampleData();
     }
 
     int Sample::GetChannelCount() {
@@ -263,6 +296,7 @@ namespace sf2 {
         pSample = NULL;
         pInstrument = NULL;
         pParentInstrument = NULL;
+        pGlobalZone = NULL;
         loKey = hiKey = NONE;
         minVel = maxVel = NONE;
         startAddrsOffset = startAddrsCoarseOffset = endAddrsOffset = endAddrsCoarseOffset = 0;
@@ -291,6 +325,10 @@ namespace sf2 {
         initialFilterQ = 0;
     }
 
+    Region::~Region() {
+        ClearResolved();
+    }
+
     int Region::GetUnityNote() {
         return overridingRootKey != -1 ? overridingRootKey : pSample->OriginalPitch;
     }
@@ -721,9 +759,416 @@ namespace sf2 {
         return CheckRange("GetInitialFilterQ()", 0, 960, val);
     }
 
+    /// Guards the Region::resolved caches (Resolve() may be called from several voices at once).
+    static mutex_t resolvedRegionsMutex;
+
+    /**
+     * Returns all synthesis parameters of this instrument zone combined
+     * with the given preset zone, already converted to engine units (see
+     * ResolvedRegion). The values are calculated on the first call for a
+     * preset zone and cached, so subsequent calls for the same pair are
+     * just a lookup instead of dozens of getter calls with their timecent
+     * conversions. The returned reference stays valid until this region
+     * is destroyed or ClearResolved() is called.
+     *
+     * @param pPresetRegion - preset zone referencing this instrument zone's
+     *                        instrument, or NULL for the instrument zone's
+     *                        values alone
+     */
+    const ResolvedRegion& Region::Resolve(Region* pPresetRegion) {
+        mutex_lock_t lock(resolvedRegionsMutex);
+        std::map<Region*,ResolvedRegion*>::iterator iter = resolved.find(pPresetRegion);
+        if (iter != resolved.end()) return *iter->second;
+
+        ResolvedRegion* r = new ResolvedRegion;
+        r->pPresetRegion     = pPresetRegion;
+        r->pInstrumentRegion = this;
+
+        r->Pan               = GetPan(pPresetRegion);
+        r->FineTune          = GetFineTune(pPresetRegion);
+        r->CoarseTune        = GetCoarseTune(pPresetRegion);
+        r->EG1PreAttackDelay = GetEG1PreAttackDelay(pPresetRegion);
+        r->EG1Attack         = GetEG1Attack(pPresetRegion);
+        r->EG1Hold           = GetEG1Hold(pPresetRegion);
+        r->EG1Decay          = GetEG1Decay(pPresetRegion);
+        r->EG1Sustain        = GetEG1Sustain(pPresetRegion);
+        r->EG1Release        = GetEG1Release(pPresetRegion);
+
+        r->EG2PreAttackDelay = GetEG2PreAttackDelay(pPresetRegion);
+        r->EG2Attack         = GetEG2Attack(pPresetRegion);
+        r->EG2Hold           = GetEG2Hold(pPresetRegion);
+        r->EG2Decay          = GetEG2Decay(pPresetRegion);
+        r->EG2Sustain        = GetEG2Sustain(pPresetRegion);
+        r->EG2Release        = GetEG2Release(pPresetRegion);
+
+        r->ModEnvToPitch     = GetModEnvToPitch(pPresetRegion);
+        r->ModLfoToPitch     = GetModLfoToPitch(pPresetRegion);
+        r->ModEnvToFilterFc  = GetModEnvToFilterFc(pPresetRegion);
+        r->ModLfoToFilterFc  = GetModLfoToFilterFc(pPresetRegion);
+        r->ModLfoToVolume    = GetModLfoToVolume(pPresetRegion);
+        r->FreqModLfo        = GetFreqModLfo(pPresetRegion);
+        r->DelayModLfo       = GetDelayModLfo(pPresetRegion);
+        r->VibLfoToPitch     = GetVibLfoToPitch(pPresetRegion);
+        r->FreqVibLfo        = GetFreqVibLfo(pPresetRegion);
+        r->DelayVibLfo       = GetDelayVibLfo(pPresetRegion);
+        r->InitialFilterFc   = GetInitialFilterFc(pPresetRegion);
+        r->InitialFilterQ    = GetInitialFilterQ(pPresetRegion);
+
+        resolved[pPresetRegion] = r;
+        return *r;
+    }
+
+    /**
+     * Discards all values cached by Resolve(). Call this after modifying
+     * generator values of this zone or of a preset zone referencing it,
+     * and before deleting such a preset zone. References previously
+     * returned by Resolve() become invalid.
+     */
+    void Region::ClearResolved() {
+        mutex_lock_t lock(resolvedRegionsMutex);
+        for (std::map<Region*,ResolvedRegion*>::iterator iter = resolved.begin();
+             iter != resolved.end(); ++iter)
+        {
+            delete iter->second;
+        }
+        resolved.clear();
+        for (std::map<Region*,ModulatorMatrix*>::iterator iter = matrices.begin();
+             iter != matrices.end(); ++iter)
+        {
+            delete iter->second;
+        }
+        matrices.clear();
+    }
+
+    /**
+     * Returns the modulators of this instrument zone played through the
+     * given preset zone, compiled into a ModulatorMatrix. The matrix is
+     * compiled on the first call for a preset zone and cached like the
+     * values of Resolve(), the returned reference stays valid until this
+     * region is destroyed or ClearResolved() is called.
+     *
+     * @param pPresetRegion - preset zone referencing this instrument zone's
+     *                        instrument, or NULL for the instrument level
+     *                        modulators alone
+     */
+    const ModulatorMatrix& Region::GetModulatorMatrix(Region* pPresetRegion) {
+        mutex_lock_t lock(resolvedRegionsMutex);
+        std::map<Region*,ModulatorMatrix*>::iterator iter = matrices.find(pPresetRegion);
+        if (iter != matrices.end()) return *iter->second;
+        ModulatorMatrix* pMatrix = new ModulatorMatrix(this, pPresetRegion);
+        matrices[pPresetRegion] = pMatrix;
+        return *pMatrix;
+    }
+
+
+
+    // *************** ModulatorMatrix ***************
+    // *
+
+    // concave (or convex) curve of SoundFont 2.04 section 8.2.1 for x in [0,1]
+    static float __modulatorCurve(float x, bool bConvex) {
+        if (bConvex) x = 1.f - x;
+        const float y = (x >= 1.f) ? 1.f : (x <= 0.f) ? 0.f : float(-40.0 / 96.0 * log10(1.0 - x));
+        const float c = (y > 1.f) ? 1.f : y;
+        return (bConvex) ? 1.f - c : c;
+    }
+
+    /// The default modulators of SoundFont 2.04 (section 8.4), the pitch wheel one modulating FINE_TUNE.
+    static const ModList defaultModulators[] = {
+        { 0x0502, INITIAL_ATTENUATION,   960, 0x0000, 0 }, // velocity to attenuation
+        { 0x0102, INITIAL_FILTER_FC,   uint16_t(-2400), 0x0000, 0 }, // velocity to filter cutoff
+        { 0x000D, VIB_LFO_TO_PITCH,       50, 0x0000, 0 }, // channel pressure to vibrato depth
+        { 0x0081, VIB_LFO_TO_PITCH,       50, 0x0000, 0 }, // CC1 (modulation wheel) to vibrato depth
+        { 0x0587, INITIAL_ATTENUATION,   960, 0x0000, 0 }, // CC7 (volume) to attenuation
+        { 0x028A, PAN,                  1000, 0x0000, 0 }, // CC10 (pan) to pan
+        { 0x058B, INITIAL_ATTENUATION,   960, 0x0000, 0 }, // CC11 (expression) to attenuation
+        { 0x00DB, REVERB_EFFECTS_SEND,   200, 0x0000, 0 }, // CC91 to reverb send
+        { 0x00DD, CHORUS_EFFECTS_SEND,   200, 0x0000, 0 }, // CC93 to chorus send
+        { 0x020E, FINE_TUNE,           12700, 0x0010, 0 }  // pitch wheel (scaled by its sensitivity) to pitch
+    };
+
+    // whether both modulators are identical in the sense of SoundFont 2.04
+    // section 9.5.1 (so the more specific one overrides the other)
+    static bool isIdenticalModulator(const CompiledModulator& a, const ModList& b) {
+        return a.Source == b.ModSrcOper && a.Destination == b.ModDestOper &&
+               a.AmountSource == b.ModAmtSrcOper && a.Transform == b.ModTransOper;
+    }
+
+    // adds the modulators of one zone to @a list: modulators identical to
+    // one in @a list[first, end) replace it, modulators identical to an
+    // earlier one of the same zone are ignored
+    static void mergeModulators(std::vector<CompiledModulator>& list, size_t first,
+                                const std::vector<ModList>& zone)
+    {
+        const size_t zoneStart = list.size();
+        for (size_t i = 0; i < zone.size(); ++i) {
+            const ModList& m = zone[i];
+            // linked modulators and invalid destinations are not supported
+            if (m.ModDestOper >= END_OPER || ModulatorMatrix::ControllerOf(m.ModSrcOper) == -2 ||
+                ModulatorMatrix::ControllerOf(m.ModAmtSrcOper) == -2) continue;
+            CompiledModulator mod;
+            mod.Source       = m.ModSrcOper;
+            mod.AmountSource = m.ModAmtSrcOper;
+            mod.Destination  = m.ModDestOper;
+            mod.Amount       = int16_t(m.ModAmount);
+            mod.Transform    = m.ModTransOper;
+            mod.SourceController       = ModulatorMatrix::ControllerOf(m.ModSrcOper);
+            mod.AmountSourceController = ModulatorMatrix::ControllerOf(m.ModAmtSrcOper);
+            bool bDuplicate = false;
+            for (size_t k = zoneStart; k < list.size() && !bDuplicate; ++k)
+                bDuplicate = isIdenticalModulator(list[k], m);
+            if (bDuplicate) continue;
+            bool bReplaced = false;
+            for (size_t k = first; k < zoneStart && !bReplaced; ++k) {
+                if (isIdenticalModulator(list[k], m)) {
+                    list[k] = mod;
+                    bReplaced = true;
+                }
+            }
+            if (!bReplaced) list.push_back(mod);
+        }
+    }
+
+    static std::vector<ModList> zoneModulators(Region* pZone) {
+        std::vector<ModList> mods;
+        if (!pZone) return mods;
+        for (size_t i = 0; i < pZone->modulators.size(); ++i) {
+            const ModulatorItem& item = pZone->modulators[i];
+            ModList m;
+            m.ModSrcOper    = item.Source;
+            m.ModDestOper   = item.ModDestOper;
+            m.ModAmount     = item.ModAmount;
+            m.ModAmtSrcOper = item.AmountSource;
+            m.ModTransOper  = item.ModTransOper;
+            mods.push_back(m);
+        }
+        return mods;
+    }
+
+    /**
+     * Compiles the modulators of the given instrument zone played through
+     * the given preset zone (see ModulatorMatrix).
+     *
+     * @param pInstrumentRegion - instrument zone
+     * @param pPresetRegion     - preset zone referencing the instrument
+     *                            zone's instrument, or NULL for the
+     *                            instrument level modulators alone
+     */
+    ModulatorMatrix::ModulatorMatrix(Region* pInstrumentRegion, Region* pPresetRegion) {
+        // instrument level: defaults < global zone < zone
+        const std::vector<ModList> defaults(defaultModulators,
+            defaultModulators + sizeof(defaultModulators) / sizeof(ModList));
+        mergeModulators(modulators, 0, defaults);
+        mergeModulators(modulators, 0, zoneModulators(pInstrumentRegion->pGlobalZone));
+        mergeModulators(modulators, 0, zoneModulators(pInstrumentRegion));
+        // preset level (added): global zone < zone
+        if (pPresetRegion) {
+            const size_t presetStart = modulators.size();
+            mergeModulators(modulators, presetStart, zoneModulators(pPresetRegion->pGlobalZone));
+            mergeModulators(modulators, presetStart, zoneModulators(pPresetRegion));
+        }
+
+        // index by controller and by destination
+        std::vector< std::vector<uint16_t> > byController(CONTROLLER_COUNT);
+        std::vector< std::vector<uint16_t> > byDestination(END_OPER);
+        for (size_t i = 0; i < modulators.size(); ++i) {
+            const CompiledModulator& mod = modulators[i];
+            if (mod.SourceController >= 0)
+                byController[mod.SourceController].push_back(uint16_t(i));
+            if (mod.AmountSourceController >= 0 && mod.AmountSourceController != mod.SourceController)
+                byController[mod.AmountSourceController].push_back(uint16_t(i));
+            byDestination[mod.Destination].push_back(uint16_t(i));
+        }
+        for (int c = 0; c < CONTROLLER_COUNT; ++c) {
+            controllerModulatorStart[c]   = int(controllerModulators.size());
+            controllerDestinationStart[c] = int(controllerDestinations.size());
+            bool bAffected[END_OPER] = { false };
+            for (size_t i = 0; i < byController[c].size(); ++i) {
+                const int index = byController[c][i];
+                controllerModulators.push_back(uint16_t(index));
+                const int dest = modulators[index].Destination;
+                if (!bAffected[dest]) {
+                    bAffected[dest] = true;
+                    controllerDestinations.push_back(uint8_t(dest));
+                }
+            }
+        }
+        controllerModulatorStart[CONTROLLER_COUNT]   = int(controllerModulators.size());
+        controllerDestinationStart[CONTROLLER_COUNT] = int(controllerDestinations.size());
+        for (int d = 0; d < END_OPER; ++d) {
+            destinationModulatorStart[d] = int(destinationModulators.size());
+            destinationModulators.insert(destinationModulators.end(), byDestination[d].begin(), byDestination[d].end());
+        }
+        destinationModulatorStart[END_OPER] = int(destinationModulators.size());
+    }
+
+    /// Returns the amount of modulators of this matrix.
+    int ModulatorMatrix::GetModulatorCount() const {
+        return int(modulators.size());
+    }
+
+    /// Returns the modulator with the given index (0 - GetModulatorCount() - 1).
+    const CompiledModulator& ModulatorMatrix::GetModulator(int Index) const {
+        return modulators[Index];
+    }
+
+    /**
+     * Returns the indices of all modulators depending on the given
+     * controller (as primary or as amount source).
+     *
+     * @param Controller - controller index (see ModulatorMatrix)
+     * @param Count      - (out) amount of returned indices
+     */
+    const uint16_t* ModulatorMatrix::GetModulatorsOf(int Controller, int& Count) const {
+        if (Controller < 0 || Controller >= CONTROLLER_COUNT) {
+            Count = 0;
+            return NULL;
+        }
+        Count = controllerModulatorStart[Controller + 1] - controllerModulatorStart[Controller];
+        return (Count) ? &controllerModulators[controllerModulatorStart[Controller]] : NULL;
+    }
+
+    /**
+     * Returns all destinations (generators) modulated depending on the
+     * given controller, i.e. the synthesis parameters an engine has to
+     * update after a change of that controller.
+     *
+     * @param Controller - controller index (see ModulatorMatrix)
+     * @param Count      - (out) amount of returned destinations
+     */
+    const uint8_t* ModulatorMatrix::GetDestinationsOf(int Controller, int& Count) const {
+        if (Controller < 0 || Controller >= CONTROLLER_COUNT) {
+            Count = 0;
+            return NULL;
+        }
+        Count = controllerDestinationStart[Controller + 1] - controllerDestinationStart[Controller];
+        return (Count) ? &controllerDestinations[controllerDestinationStart[Controller]] : NULL;
+    }
+
+    /// Returns true if any modulator of this matrix modulates the given generator.
+    bool ModulatorMatrix::IsModulated(SFGenerator Destination) const {
+        return Destination < END_OPER &&
+               destinationModulatorStart[Destination + 1] > destinationModulatorStart[Destination];
+    }
+
+    /**
+     * Evaluates all modulators, i.e. when a voice starts.
+     *
+     * @param pControllers  - CONTROLLER_COUNT current controller values,
+     *                        normalized by NormalizeController()
+     * @param pOutputs      - (out) GetModulatorCount() values: the current
+     *                        output of each modulator, to be passed to
+     *                        UpdateController() later on
+     * @param pDestinations - (out) END_OPER values: the sum of all
+     *                        modulator outputs per generator, to be added
+     *                        to the generator values of the zones
+     */
+    void ModulatorMatrix::Evaluate(const float* pControllers, float* pOutputs, float* pDestinations) const {
+        for (size_t i = 0; i < modulators.size(); ++i)
+            pOutputs[i] = __output(modulators[i], pControllers);
+        for (int d = 0; d < END_OPER; ++d)
+            __sumDestination(d, pOutputs, pDestinations);
+    }
+
+    /**
+     * Updates the outputs of the modulators depending on the given
+     * controller after it changed, and the destinations affected by them
+     * (see GetDestinationsOf()). All other values stay untouched. Never
+     * allocates memory, so it can be called on a real-time thread.
+     *
+     * @param Controller    - index of the changed controller
+     * @param pControllers  - current controller values (see Evaluate())
+     * @param pOutputs      - modulator outputs, as returned by Evaluate()
+     * @param pDestinations - modulation per generator, as returned by
+     *                        Evaluate()
+     */
+    void ModulatorMatrix::UpdateController(int Controller, const float* pControllers, float* pOutputs, float* pDestinations) const {
+        if (Controller < 0 || Controller >= CONTROLLER_COUNT) return;
+        for (int i = controllerModulatorStart[Controller]; i < controllerModulatorStart[Controller + 1]; ++i) {
+            const int index = controllerModulators[i];
+            pOutputs[index] = __output(modulators[index], pControllers);
+        }
+        for (int i = controllerDestinationStart[Controller]; i < controllerDestinationStart[Controller + 1]; ++i)
+            __sumDestination(controllerDestinations[i], pOutputs, pDestinations);
+    }
+
+    float ModulatorMatrix::__output(const CompiledModulator& mod, const float* pControllers) const {
+        // "no controller" sources count as 1
+        const float source = (mod.SourceController < 0) ? 1.f :
+            TransformSource(mod.Source, pControllers[mod.SourceController]);
+        const float amount = (mod.AmountSourceController < 0) ? 1.f :
+            TransformSource(mod.AmountSource, pControllers[mod.AmountSourceController]);
+        const float output = float(mod.Amount) * source * amount;
+        return (mod.Transform == 2 && output < 0) ? -output : output;
+    }
+
+    void ModulatorMatrix::__sumDestination(int Destination, const float* pOutputs, float* pDestinations) const {
+        float sum = 0;
+        for (int i = destinationModulatorStart[Destination]; i < destinationModulatorStart[Destination + 1]; ++i)
+            sum += pOutputs[destinationModulators[i]];
+        pDestinations[Destination] = sum;
+    }
+
+    /**
+     * Returns the controller index (see ModulatorMatrix) of the given
+     * modulator source, -1 if the source is "no controller" and -2 for
+     * linked sources.
+     */
+    int ModulatorMatrix::ControllerOf(SFModulator Source) {
+        const Modulator mod(Source);
+        if (mod.MidiPalete) return mod.Index;
+        if (mod.Index == Modulator::NO_CONTROLLER) return -1;
+        if (mod.Index == Modulator::LINK) return -2;
+        return 128 + mod.Index;
+    }
+
+    /**
+     * Converts a controller value as received by MIDI to the normalized
+     * value expected by Evaluate() and UpdateController(): 0 - 16383 for
+     * the pitch wheel (128 + Modulator::PITCH_WHEEL), 0 - 127 for all other
+     * controllers (i.e. semitones for the pitch wheel sensitivity).
+     */
+    float ModulatorMatrix::NormalizeController(int Controller, int Value) {
+        return (Controller == 128 + Modulator::PITCH_WHEEL) ? float(Value) / 16384.f : float(Value) / 128.f;
+    }
+
+    /**
+     * Applies the mapping of the given modulator source (direction,
+     * polarity and curve type, see SoundFont 2.04 section 8.2) to a
+     * normalized controller value (see NormalizeController()).
+     *
+     * @returns value between 0 and 1 for unipolar, between -1 and 1 for
+     *          bipolar sources
+     */
+    float ModulatorMatrix::TransformSource(SFModulator Source, float Value) {
+        const Modulator mod(Source);
+        const int controller = ControllerOf(Source);
+        // largest normalized value of the controller
+        const float max = (controller == 128 + Modulator::PITCH_WHEEL) ? 16383.f / 16384.f : 127.f / 128.f;
+        float x = (mod.Direction) ? max - Value : Value;
+        if (x < 0) x = 0;
+        if (x > max) x = max;
+        if (mod.Type == Modulator::LINEAR)
+            return (mod.Polarity) ? 2.f * x - 1.f : x;
+        if (mod.Type == Modulator::SWITCH)
+            return (x >= 0.5f) ? 1.f : (mod.Polarity) ? -1.f : 0.f;
+        // concave and convex curves span the full controller range
+        x /= max;
+        const bool bConvex = (mod.Type == Modulator::CONVEX);
+        if (!mod.Polarity) return __modulatorCurve(x, bConvex);
+        return (x > 0.5f) ? __modulatorCurve(2.f * x - 1.f, bConvex)
+                          : -__modulatorCurve(1.f - 2.f * x, bConvex);
+    }
+
+    /// Guards loading the deferred regions of all presets and instruments (see InstrumentBase::EnsureRegionsLoaded()).
+    static mutex_t deferredRegionsMutex;
+
     InstrumentBase::InstrumentBase(sf2::File* pFile) {
         this->pFile = pFile;
         pGlobalRegion = NULL;
+        keyIndexValid = false;
+        deferredBagIdx1 = deferredBagIdx2 = 0;
+        regionsLoaded = true; // until LoadRegions() defers some
     }
 
     InstrumentBase::~InstrumentBase() {
@@ -734,6 +1179,7 @@ namespace sf2 {
     }
 
     int InstrumentBase::GetRegionCount() {
+        EnsureRegionsLoaded();
         return (int) regions.size();
     }
 
@@ -745,15 +1191,76 @@ namespace sf2 {
         return regions[idx];
     }
 
+    /**
+     * Loads the regions whose construction has been deferred by
+     * LoadRegions(), if not done yet. Opening a file thus only parses the
+     * bag tables, the regions of a preset or instrument are constructed on
+     * the first GetRegionCount() / GetRegion() call or Query on it. If the
+     * file turns out to be broken at that point, the exception is thrown
+     * by that access (and the regions loaded up to then are kept).
+     * Concurrent first accesses (e.g. Query objects of several voices)
+     * wait until the regions are loaded completely.
+     */
+    void InstrumentBase::EnsureRegionsLoaded() {
+        if (__atomicLoadAcquire(regionsLoaded)) return;
+        mutex_lock_t lock(deferredRegionsMutex);
+        if (regionsLoaded) return;
+        try {
+            LoadDeferredRegions();
+        } catch (...) {
+            __atomicStoreRelease(regionsLoaded, true); // (not retried)
+            throw;
+        }
+        __atomicStoreRelease(regionsLoaded, true);
+    }
+
+    /**
+     * Builds the index of the regions matching each MIDI key, which allows
+     * Query to only test the regions of the requested key instead of all
+     * regions. This is done automatically after the regions were loaded or
+     * a region was deleted; an application which modifies the key range
+     * (@c loKey, @c hiKey) of regions has to call this method afterwards.
+     */
+    void InstrumentBase::UpdateKeyIndex() {
+        keyIndex.clear();
+        for (int key = 0; key < 128; ++key) {
+            keyIndexStart[key] = (int) keyIndex.size();
+            for (int i = 0; i < (int) regions.size(); ++i) {
+                Region* r = regions[i];
+                if (!r) continue; // deleted region
+                if ((r->loKey == NONE && r->hiKey == NONE) || (key >= r->loKey && key <= r->hiKey))
+                    keyIndex.push_back(i);
+            }
+        }
+        keyIndexStart[128] = (int) keyIndex.size();
+        keyIndexValid = true;
+    }
+
     Query::Query(InstrumentBase& instrument) : instrument(instrument) {
         i = 0;
+        instrument.EnsureRegionsLoaded();
+    }
+
+    bool Query::matchesVelocity(Region* r, uint8_t vel) {
+        return (r->minVel == NONE && r->maxVel == NONE) || (vel >= r->minVel && vel <= r->maxVel);
     }
 
     Region* Query::next() {
+        // only walk the regions of the requested key (in region order)
+        if (instrument.keyIndexValid && key >= 0 && key < 128) {
+            const int start = instrument.keyIndexStart[key];
+            const int count = instrument.keyIndexStart[key + 1] - start;
+            while (i < count) {
+                Region* r = instrument.regions[instrument.keyIndex[start + i++]];
+                if (r && matchesVelocity(r, vel)) return r;
+            }
+            return 0;
+        }
         while (i < instrument.GetRegionCount()) {
             Region* r = instrument.GetRegion(i++);
+            if (!r) continue; // deleted region
             if (((r->loKey  == NONE && r->hiKey  == NONE) || (key >= r->loKey && key <= r->hiKey)) &&
-                ((r->minVel == NONE && r->maxVel == NONE) || (vel >= r->minVel && vel <= r->maxVel))) {
+                matchesVelocity(r, vel)) {
                 return r;
             }
         }
@@ -772,6 +1279,7 @@ namespace sf2 {
     Region* Instrument::CreateRegion() {
         Region* r = new Region;
         r->pParentInstrument = this;
+        r->pGlobalZone = pGlobalRegion;
 
         if (pGlobalRegion != NULL) {
             r->loKey       = pGlobalRegion->loKey;
@@ -829,10 +1337,12 @@ namespace sf2 {
     }
 
     void Instrument::DeleteRegion(Region* pRegion) {
+        EnsureRegionsLoaded();
         for (int i = 0; i < regions.size(); i++) {
             if (regions[i] == pRegion) {
                 delete pRegion;
                 regions[i] = NULL;
+                UpdateKeyIndex();
                 return;
             }
         }
@@ -841,43 +1351,71 @@ namespace sf2 {
     }
 
     void Instrument::LoadRegions(int idx1, int idx2) {
-        for (int i = idx1; i < idx2; i++) {
-            int gIdx1 = pFile->InstBags[i].InstGenNdx;
-            int gIdx2 = pFile->InstBags[i + 1].InstGenNdx;
-
-            if (gIdx1 < 0 || gIdx2 < 0 || gIdx1 > gIdx2 || gIdx2 >= pFile->InstGenLists.size()) {
-                throw Exception("Broken SF2 file (invalid InstGenNdx)");
+        // the global zone (if any) has to be loaded now, since other
+        // regions inherit from it and pGlobalRegion is accessed directly
+        if (idx1 < idx2) {
+            Region* reg = LoadRegion(idx1);
+            if (reg->pSample == NULL) {
+                if (idx2 - idx1 > 1) {
+                    pGlobalRegion = reg;  // global zone
+                } else {
+                    std::cerr << "Ignoring instrument's region without sample" << std::endl;
+                    delete reg;
+                }
+                idx1++;
+            } else {
+                delete reg; // loaded again along with the other regions
             }
+        }
+        deferredBagIdx1 = idx1;
+        deferredBagIdx2 = idx2;
+        regionsLoaded   = false;
+    }
 
-            int mIdx1 = pFile->InstBags[i].InstModNdx;
-            int mIdx2 = pFile->InstBags[i + 1].InstModNdx;
+    /**
+     * Creates the region of instrument bag (zone) @a idx from its generators
+     * and modulators.
+     */
+    Region* Instrument::LoadRegion(int idx) {
+        int gIdx1 = pFile->InstBags[idx].InstGenNdx;
+        int gIdx2 = pFile->InstBags[idx + 1].InstGenNdx;
 
-            if (mIdx1 < 0 || mIdx2 < 0 || mIdx1 > mIdx2 || mIdx2 >= pFile->InstModLists.size()) {
-                throw Exception("Broken SF2 file (invalid InstModNdx)");
-            }
+        if (gIdx1 < 0 || gIdx2 < 0 || gIdx1 > gIdx2 || gIdx2 >= (int) pFile->InstGenLists.size()) {
+            throw Exception("Broken SF2 file (invalid InstGenNdx)");
+        }
 
-            Region* reg = CreateRegion();
+        int mIdx1 = pFile->InstBags[idx].InstModNdx;
+        int mIdx2 = pFile->InstBags[idx + 1].InstModNdx;
 
-            for (int j = gIdx1; j < gIdx2; j++) {
-                reg->SetGenerator(pFile, pFile->InstGenLists[j]);
-                // TODO: ignore generators following a sampleID generator
-            }
+        if (mIdx1 < 0 || mIdx2 < 0 || mIdx1 > mIdx2 || mIdx2 >= (int) pFile->InstModLists.size()) {
+            throw Exception("Broken SF2 file (invalid InstModNdx)");
+        }
 
-            for (int j = mIdx1; j < mIdx2; j++) {
-                reg->SetModulator(pFile, pFile->InstModLists[j]);
-            }
+        Region* reg = CreateRegion();
+
+        for (int j = gIdx1; j < gIdx2; j++) {
+            reg->SetGenerator(pFile, pFile->InstGenLists[j]);
+            // TODO: ignore generators following a sampleID generator
+        }
 
+        for (int j = mIdx1; j < mIdx2; j++) {
+            reg->SetModulator(pFile, pFile->InstModLists[j]);
+        }
+
+        return reg;
+    }
+
+    void Instrument::LoadDeferredRegions() {
+        for (int i = deferredBagIdx1; i < deferredBagIdx2; i++) {
+            Region* reg = LoadRegion(i);
             if (reg->pSample == NULL) {
-                if (i == idx1 && idx2 - idx1 > 1) {
-                    pGlobalRegion = reg;  // global zone
-                } else {
-                    std::cerr << "Ignoring instrument's region without sample" << std::endl;
-                    delete reg;
-                }
+                std::cerr << "Ignoring instrument's region without sample" << std::endl;
+                delete reg;
             } else {
                 regions.push_back(reg);
             }
         }
+        UpdateKeyIndex();
     }
 
     Preset::Preset(sf2::File* pFile, RIFF::Chunk* ck): InstrumentBase(pFile) {
@@ -896,6 +1434,7 @@ namespace sf2 {
 
     Region* Preset::CreateRegion() {
         Region* r = new Region;
+        r->pGlobalZone = pGlobalRegion;
 
         r->EG1PreAttackDelay = r->EG1Attack = r->EG1Hold = r->EG1Decay = r->EG1Sustain = r->EG1Release = NONE;
         r->EG2PreAttackDelay = r->EG2Attack = r->EG2Hold = r->EG2Decay = r->EG2Sustain = r->EG2Release = NONE;
@@ -939,30 +1478,109 @@ namespace sf2 {
     }
 
     void Preset::LoadRegions(int idx1, int idx2) {
-        for (int i = idx1; i < idx2; i++) {
-            int gIdx1 = pFile->PresetBags[i].GenNdx;
-            int gIdx2 = pFile->PresetBags[i + 1].GenNdx;
-
-            if (gIdx1 < 0 || gIdx2 < 0 || gIdx1 > gIdx2 || gIdx2 >= pFile->PresetGenLists.size()) {
-                throw Exception("Broken SF2 file (invalid PresetGenNdx)");
-            }
-
-            Region* reg = CreateRegion();
-
-            for (int j = gIdx1; j < gIdx2; j++) {
-                reg->SetGenerator(pFile, pFile->PresetGenLists[j]);
-            }
+        // the global zone (if any) has to be loaded now, since other
+        // regions inherit from it and pGlobalRegion is accessed directly
+        if (idx1 < idx2) {
+            Region* reg = LoadRegion(idx1);
             if (reg->pInstrument == NULL) {
-                if (i == idx1 && idx2 - idx1 > 1) {
+                if (idx2 - idx1 > 1) {
                     pGlobalRegion = reg;  // global zone
                 } else {
                     std::cerr << "Ignoring preset's region without instrument" << std::endl;
                     delete reg;
                 }
+                idx1++;
+            } else {
+                delete reg; // loaded again along with the other regions
+            }
+        }
+        deferredBagIdx1 = idx1;
+        deferredBagIdx2 = idx2;
+        regionsLoaded   = false;
+    }
+
+    /**
+     * Creates the region of preset bag (zone) @a idx from its generators
+     * and modulators.
+     */
+    Region* Preset::LoadRegion(int idx) {
+        int gIdx1 = pFile->PresetBags[idx].GenNdx;
+        int gIdx2 = pFile->PresetBags[idx + 1].GenNdx;
+
+        if (gIdx1 < 0 || gIdx2 < 0 || gIdx1 > gIdx2 || gIdx2 >= (int) pFile->PresetGenLists.size()) {
+
+            throw Exception("Broken SF2 file (invalid PresetGenNdx)");
+        }
+
+        int mIdx1 = pFile->PresetBags[idx].ModNdx;
+        int mIdx2 = pFile->PresetBags[idx + 1].ModNdx;
+
+        if (mIdx1 < 0 || mIdx2 < 0 || mIdx1 > mIdx2 || mIdx2 >= (int) pFile->PresetModLists.size()) {
+
+            throw Exception("Broken SF2 file (invalid PresetModNdx)");
+        }
+
+        Region* reg = CreateRegion();
+
+        for (int j = gIdx1; j < gIdx2; j++) {
+            reg->SetGenerator(pFile, pFile->PresetGenLists[j]);
+        }
+
+        for (int j = mIdx1; j < mIdx2; j++) {
+            reg->SetModulator(pFile, pFile->PresetModLists[j]);
+        }
+
+        return reg;
+    }
+
+    void Preset::LoadDeferredRegions() {
+        for (int i = deferredBagIdx1; i < deferredBagIdx2; i++) {
+            Region* reg = LoadRegion(i);
+            if (reg->pInstrument == NULL) {
+                std::cerr << "Ignoring preset's region without instrument" << std::endl;
+                delete reg;
             } else {
                 regions.push_back(reg);
             }
         }
+        UpdateKeyIndex();
+    }
+
+    /** @brief Load an existing SF2 file without throwing exceptions.
+     *
+     * Like the constructor taking a RIFF::File, but failures are reported
+     * by returning NULL and by @a pResult instead of by an exception. The
+     * RIFF form type is checked first, so files of another type are sorted
+     * out without any exception being thrown (see RIFF::File::TryOpen()
+     * and RIFF::File::Probe() for checking the file itself that way).
+     *
+     * @param pRIFF - RIFF file to be loaded as SF2 file (must stay
+     *                valid as long as the returned object exists)
+     * @param pResult - (optional) receives the reason of a failure
+     * @returns new File object (to be deleted by the caller), NULL on
+     *          failure
+     */
+    File* File::TryOpen(RIFF::File* pRIFF, RIFF::probe_result_t* pResult) {
+        RIFF::probe_status_t status = RIFF::probe_wrong_type;
+        const char* detail = "Not a SF2 file";
+        if (pRIFF && pRIFF->GetListType() == RIFF_TYPE_SF2) {
+            try {
+                File* pFile = new File(pRIFF);
+                if (pResult) {
+                    pResult->Status = RIFF::probe_ok;
+                    pResult->Detail = "OK";
+                }
+                return pFile;
+            } catch (...) {
+                status = RIFF::probe_invalid;
+                detail = "Invalid SF2 file";
+            }
+        }
+        if (pResult) {
+            pResult->Status = status;
+            pResult->Detail = detail;
+        }
+        return NULL;
     }
 
     /** @brief Constructor.
@@ -1007,7 +1625,7 @@ namespace sf2 {
             throw Exception("Broken SF2 file (missing pdta)");
         }
 
-        RIFF::Chunk* ck = lstPDTA->GetSubChunk(CHUNK_ID_PHDR);
+        RIFF::Chunk* ck = GetTableChunk(lstPDTA, CHUNK_ID_PHDR);
         if (ck->GetSize() < 38) {
             throw Exception("Broken SF2 file (broken phdr)");
         }
@@ -1017,7 +1635,7 @@ namespace sf2 {
             Presets.push_back(new Preset(this, ck));
         }
 
-        ck = GetMandatoryChunk(lstPDTA, CHUNK_ID_PBAG);
+        ck = GetTableChunk(lstPDTA, CHUNK_ID_PBAG);
         if (ck->GetSize() < 4 || (ck->GetSize() % 4)) {
             throw Exception("Broken SF2 file (broken pbag)");
         }
@@ -1031,7 +1649,7 @@ namespace sf2 {
         }
         //std::cout << "Preset bags: " << PresetBags.size() << std::endl;
 
-        ck = GetMandatoryChunk(lstPDTA, CHUNK_ID_PMOD);
+        ck = GetTableChunk(lstPDTA, CHUNK_ID_PMOD);
         if (ck->GetSize() % 10) {
             throw Exception("Broken SF2 file (broken pmod)");
         }
@@ -1048,7 +1666,7 @@ namespace sf2 {
         }
         //std::cout << "Preset mod lists: " << PresetModLists.size() << std::endl;
 
-        ck = GetMandatoryChunk(lstPDTA, CHUNK_ID_PGEN);
+        ck = GetTableChunk(lstPDTA, CHUNK_ID_PGEN);
         if (ck->GetSize() < 4 || (ck->GetSize() % 4)) {
             throw Exception("Broken SF2 file (broken pgen)");
         }
@@ -1062,7 +1680,7 @@ namespace sf2 {
         }
         //std::cout << "Preset gen lists: " << PresetGenLists.size() << std::endl;
 
-        ck = GetMandatoryChunk(lstPDTA, CHUNK_ID_INST);
+        ck = GetTableChunk(lstPDTA, CHUNK_ID_INST);
         if (ck->GetSize() < (22 * 2) || (ck->GetSize() % 22)) {
             throw Exception("Broken SF2 file (broken inst)");
         }
@@ -1071,7 +1689,7 @@ namespace sf2 {
             Instruments.push_back(new Instrument(this, ck));
         }
 
-        ck = GetMandatoryChunk(lstPDTA, CHUNK_ID_IBAG);
+        ck = GetTableChunk(lstPDTA, CHUNK_ID_IBAG);
         if (ck->GetSize() < 4 || (ck->GetSize() % 4)) {
             throw Exception("Broken SF2 file (broken ibag)");
         }
@@ -1085,7 +1703,7 @@ namespace sf2 {
         }
         //std::cout << "Instrument bags: " << InstBags.size() << std::endl;
 
-        ck = GetMandatoryChunk(lstPDTA, CHUNK_ID_IMOD);
+        ck = GetTableChunk(lstPDTA, CHUNK_ID_IMOD);
         if (ck->GetSize() % 10) {
             throw Exception("Broken SF2 file (broken imod)");
         }
@@ -1102,7 +1720,7 @@ namespace sf2 {
         }
         //std::cout << "Instrument mod lists: " << InstModLists.size() << std::endl;
 
-        ck = GetMandatoryChunk(lstPDTA, CHUNK_ID_IGEN);
+        ck = GetTableChunk(lstPDTA, CHUNK_ID_IGEN);
         if (ck->GetSize() < 4 || (ck->GetSize() % 4)) {
             throw Exception("Broken SF2 file (broken igen)");
         }
@@ -1116,7 +1734,7 @@ namespace sf2 {
         }
         //std::cout << "Instrument gen lists: " << InstGenLists.size() << std::endl;
 
-        ck = GetMandatoryChunk(lstPDTA, CHUNK_ID_SHDR);
+        ck = GetTableChunk(lstPDTA, CHUNK_ID_SHDR);
         if ((ck->GetSize() % 46)) {
             throw Exception("Broken SF2 file (broken shdr)");
         }
@@ -1125,6 +1743,22 @@ namespace sf2 {
             Samples.push_back(new Sample(ck, pCkSmpl, pCkSm24));
         }
 
+        // Resolving stereo sample pairs (only accepted if the sample
+        // headers of both halves reference each other consistently)
+        for (size_t i = 0; i < Samples.size(); i++) {
+            Sample* pSample = Samples[i];
+            if (pSample->ChannelCount != 2 || pSample->SampleLink >= Samples.size()) continue;
+            Sample* pOther = Samples[pSample->SampleLink];
+            const bool isLeft =
+                pSample->SampleType == Sample::LEFT_SAMPLE || pSample->SampleType == Sample::ROM_LEFT_SAMPLE;
+            const bool isOtherRight =
+                pOther->SampleType == Sample::RIGHT_SAMPLE || pOther->SampleType == Sample::ROM_RIGHT_SAMPLE;
+            if (!isLeft || !isOtherRight || pOther->SampleLink != i) continue;
+            if (pSample->GetTotalFrameCount() != pOther->GetTotalFrameCount()) continue;
+            pSample->pLinkedSample = pOther;
+            pOther->pLinkedSample  = pSample;
+        }
+
         // Loading instrument regions
         for (int i = 0; i < Instruments.size() - 1; i++) {
             Instrument* instr = Instruments[i];
@@ -1330,6 +1964,19 @@ namespace sf2 {
      * (resampling/interpolation would be an important example) and avoids
      * memory access faults in such cases.
      *
+     * If the SoundFont file is memory-mapped (see RIFF::File::SetIOBackend())
+     * and this is a mono 16 bit sample, no RAM will be allocated and no data
+     * will be copied at all. Instead the returned buffer's @c pStart member
+     * points directly into the (read-only) mapped sample pool of the file.
+     * The zero sample points the SoundFont format demands after each sample
+     * serve as silence samples in that case; only if they are not present
+     * (in the requested amount) the silence samples are provided in a
+     * separate, small buffer pointed to by @c pNullExtension. So you must
+     * not write to a buffer whose @c pStart points into the mapped file, and
+     * if @c pNullExtension is not NULL you must not access the silence
+     * samples directly after the actual sample data. Such a buffer is only
+     * valid as long as the file stays mapped.
+     *
      * @param SampleCount      - number of sample points to load into RAM
      * @param NullSamplesCount - number of silence samples the buffer should
      *                           be extended past it's data end
@@ -1339,10 +1986,35 @@ namespace sf2 {
      */
     Sample::buffer_t Sample::LoadSampleDataWithNullSamplesExtension(unsigned long SampleCount, uint NullSamplesCount) {
         if (SampleCount > GetTotalFrameCount()) SampleCount = GetTotalFrameCount();
-        if (RAMCache.pStart) delete[] (int8_t*) RAMCache.pStart;
+        ReleaseSampleData();
+        // zero-copy: directly use the memory-mapped sample pool if possible
+        // (only for mono 16 bit samples, since all other formats have to
+        // be converted by Read())
+        const bool isMono = SampleType == MONO_SAMPLE || SampleType == ROM_MONO_SAMPLE;
+        const uint8_t* pMapped = (!isMono || pCkSm24) ? NULL :
+            (const uint8_t*) pCkSmpl->GetMappedData(2);
+        if (pMapped) {
+            const uint8_t* pData = pMapped + Start * 2;
+            RAMCache.pStart            = (void*) pData;
+            RAMCache.Size              = SampleCount * 2;
+            RAMCache.NullExtensionSize = NullSamplesCount * 2;
+            // the SoundFont spec requires (at least 46) zero sample points
+            // after each sample, which serve as NULL extension if present
+            const unsigned long tail = (Start + SampleCount) * 2;
+            bool tailIsSilent = tail + RAMCache.NullExtensionSize <= pCkSmpl->GetSize();
+            for (unsigned long i = 0; tailIsSilent && i < RAMCache.NullExtensionSize; ++i)
+                if (pMapped[tail + i]) tailIsSilent = false;
+            if (RAMCache.NullExtensionSize && !tailIsSilent) {
+                RAMCache.pNullExtension = RIFF::AllocateSampleBuffer(RAMCache.NullExtensionSize);
+                memset(RAMCache.pNullExtension, 0, RAMCache.NullExtensionSize);
+            }
+            RAMCacheMapped = true;
+            SetPos(SampleCount); // same read position as if the data was read
+            return GetCache();
+        }
         unsigned long allocationsize = (SampleCount + NullSamplesCount) * GetFrameSize();
         SetPos(0); // reset read position to begin of sample
-        RAMCache.pStart            = new int8_t[allocationsize];
+        RAMCache.pStart            = RIFF::AllocateSampleBuffer(allocationsize, pCkSmpl->GetFile()->GetNumaNode());
         RAMCache.Size              = Read(RAMCache.pStart, SampleCount) * GetFrameSize();
         RAMCache.NullExtensionSize = allocationsize - RAMCache.Size;
         // fill the remaining buffer space with silence samples
@@ -1366,6 +2038,7 @@ namespace sf2 {
         result.Size              = this->RAMCache.Size;
         result.pStart            = this->RAMCache.pStart;
         result.NullExtensionSize = this->RAMCache.NullExtensionSize;
+        result.pNullExtension    = this->RAMCache.pNullExtension;
         return result;
     }
 
@@ -1376,10 +2049,14 @@ namespace sf2 {
      * @see  LoadSampleData();
      */
     void Sample::ReleaseSampleData() {
-        if (RAMCache.pStart) delete[] (int8_t*) RAMCache.pStart;
+        if (RAMCache.pStart && !RAMCacheMapped)
+            RIFF::FreeSampleBuffer(RAMCache.pStart, RAMCache.Size + RAMCache.NullExtensionSize);
+        RIFF::FreeSampleBuffer(RAMCache.pNullExtension, RAMCache.NullExtensionSize);
         RAMCache.pStart = NULL;
         RAMCache.Size   = 0;
         RAMCache.NullExtensionSize = 0;
+        RAMCache.pNullExtension    = NULL;
+        RAMCacheMapped  = false;
     }
 
     /**
@@ -1404,76 +2081,334 @@ namespace sf2 {
         return (pCkSmpl->GetPos() - (Start * 2)) / 2;
     }
 
-    // Actual implementation of Sample::Read*() code. Wrapped into a template for a) runtime effeciency and b) code redundancy reasons.
+// *************** 24 bit sample data kernels ***************
+// *
+//
+// 24 bit SoundFont samples are split into the upper 16 bits (little endian,
+// in the smpl chunk) and the lower 8 bits (in the sm24 chunk) of each sample
+// point. The kernels below merge both parts, either to packed 24 bit little
+// endian sample points or directly to float.
+
+    namespace {
+
+        // merges n sample points to packed 24 bit little endian
+        void Merge24Scalar(const uint8_t* pHi, const uint8_t* pLo,
+                           uint8_t* pDst, unsigned long n)
+        {
+            for (; n; --n, pHi += 2, ++pLo, pDst += 3) {
+                pDst[0] = *pLo;
+                pDst[1] = pHi[0];
+                pDst[2] = pHi[1];
+            }
+        }
+
+        // converts n sample points to float, pLo being NULL for 16 bit
+        // sample data (scale already includes the 1 / 2^31 normalization)
+        void ToFloatScalar(const uint8_t* pHi, const uint8_t* pLo,
+                           float* pDst, unsigned long n, float scale)
+        {
+            for (unsigned long i = 0; i < n; ++i) {
+                const uint32_t v = uint32_t(pHi[2*i] | (pHi[2*i + 1] << 8)) << 16 |
+                                   ((pLo) ? uint32_t(pLo[i]) << 8 : 0);
+                pDst[i] = int32_t(v) * scale;
+            }
+        }
+
+#if SF2_SIMD_X86
+
+        __attribute__((target("ssse3")))
+        void Merge24SSSE3(const uint8_t* pHi, const uint8_t* pLo,
+                          uint8_t* pDst, unsigned long n)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            // bytes 1..3 of each 32 bit lane (lo, hi16)
+            const __m128i pack = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10,
+                                               11, 13, 14, 15, -1, -1, -1, -1);
+            // 16 byte stores of 12 valid bytes, so at least 10 sample
+            // points must be left
+            for (; n >= 10; n -= 8, pHi += 16, pLo += 8, pDst += 24) {
+                const __m128i h = _mm_loadu_si128((const __m128i*) pHi);
+                const __m128i l = _mm_unpacklo_epi8(zero, _mm_loadl_epi64((const __m128i*) pLo));
+                _mm_storeu_si128((__m128i*) pDst,
+                                 _mm_shuffle_epi8(_mm_unpacklo_epi16(l, h), pack));
+                _mm_storeu_si128((__m128i*) (pDst + 12),
+                                 _mm_shuffle_epi8(_mm_unpackhi_epi16(l, h), pack));
+            }
+            Merge24Scalar(pHi, pLo, pDst, n);
+        }
+
+        __attribute__((target("sse2")))
+        void ToFloatSSE2(const uint8_t* pHi, const uint8_t* pLo,
+                         float* pDst, unsigned long n, float scale)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128  s    = _mm_set1_ps(scale);
+            for (; n >= 8; n -= 8, pHi += 16, pDst += 8) {
+                const __m128i h = _mm_loadu_si128((const __m128i*) pHi);
+                __m128i l = zero;
+                if (pLo) {
+                    l = _mm_unpacklo_epi8(zero, _mm_loadl_epi64((const __m128i*) pLo));
+                    pLo += 8;
+                }
+                _mm_storeu_ps(pDst,     _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(l, h)), s));
+                _mm_storeu_ps(pDst + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(l, h)), s));
+            }
+            ToFloatScalar(pHi, pLo, pDst, n, scale);
+        }
+
+#elif SF2_SIMD_NEON
+
+        void Merge24NEON(const uint8_t* pHi, const uint8_t* pLo,
+                         uint8_t* pDst, unsigned long n)
+        {
+            for (; n >= 16; n -= 16, pHi += 32, pLo += 16, pDst += 48) {
+                const uint8x16x2_t h = vld2q_u8(pHi);
+                uint8x16x3_t out;
+                out.val[0] = vld1q_u8(pLo);
+                out.val[1] = h.val[0];
+                out.val[2] = h.val[1];
+                vst3q_u8(pDst, out);
+            }
+            Merge24Scalar(pHi, pLo, pDst, n);
+        }
+
+        void ToFloatNEON(const uint8_t* pHi, const uint8_t* pLo,
+                         float* pDst, unsigned long n, float scale)
+        {
+            for (; n >= 8; n -= 8, pHi += 16, pDst += 8) {
+                const int16x8_t h = vreinterpretq_s16_u8(vld1q_u8(pHi));
+                int32x4_t a = vshlq_n_s32(vmovl_s16(vget_low_s16(h)), 16);
+                int32x4_t b = vshlq_n_s32(vmovl_s16(vget_high_s16(h)), 16);
+                if (pLo) {
+                    const uint16x8_t l = vmovl_u8(vld1_u8(pLo));
+                    a = vorrq_s32(a, vreinterpretq_s32_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(l)), 8)));
+                    b = vorrq_s32(b, vreinterpretq_s32_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(l)), 8)));
+                    pLo += 8;
+                }
+                vst1q_f32(pDst,     vmulq_n_f32(vcvtq_f32_s32(a), scale));
+                vst1q_f32(pDst + 4, vmulq_n_f32(vcvtq_f32_s32(b), scale));
+            }
+            ToFloatScalar(pHi, pLo, pDst, n, scale);
+        }
+
+#endif // SF2_SIMD_NEON
+
+        typedef void (*merge24_fn_t)(const uint8_t* pHi, const uint8_t* pLo,
+                                     uint8_t* pDst, unsigned long n);
+        typedef void (*to_float_fn_t)(const uint8_t* pHi, const uint8_t* pLo,
+                                      float* pDst, unsigned long n, float scale);
+
+        struct sample_kernels_t {
+            merge24_fn_t  Merge24;
+            to_float_fn_t ToFloat;
+        };
+
+        // picks the best kernels for the CPU we are running on
+        sample_kernels_t selectSampleKernels() {
+            sample_kernels_t k;
+            k.Merge24 = Merge24Scalar;
+            k.ToFloat = ToFloatScalar;
+#if SF2_SIMD_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("ssse3")) k.Merge24 = Merge24SSSE3;
+            if (__builtin_cpu_supports("sse2"))  k.ToFloat = ToFloatSSE2;
+#elif SF2_SIMD_NEON
+            k.Merge24 = Merge24NEON;
+            k.ToFloat = ToFloatNEON;
+#endif
+            return k;
+        }
+
+        // 24 bit merging and float conversion routines for this CPU
+        const sample_kernels_t kernels = selectSampleKernels();
+
+        /// Amount of sample points fetched from disk at once by ReadSample() and Sample::ReadFloat().
+        const unsigned long SAMPLE_BLOCK_SIZE = 1024;
+
+        // Reads n sample points starting at sample point Pos of each of the
+        // Count (1 or 2) given samples, from the smpl and (if ppLo is not
+        // NULL) the sm24 chunk, as raw little endian bytes by one batched
+        // request. The read positions of the chunks are not changed, so
+        // this may be called by several threads at the same time. Returns
+        // the amount of sample points actually read for all samples.
+        unsigned long FetchBlocks(Sample* const* ppSamples, int Count, unsigned long Pos,
+                                  uint8_t* const* ppHi, uint8_t* const* ppLo, unsigned long n)
+        {
+            RIFF::read_op_t ops[4];
+            int nOps = 0;
+            for (int i = 0; i < Count; ++i) {
+                Sample* pSample = ppSamples[i];
+                ops[nOps].pChunk = pSample->pCkSmpl;
+                ops[nOps].Pos    = (RIFF::file_offset_t(pSample->Start) + Pos) * 2;
+                ops[nOps].pData  = ppHi[i];
+                ops[nOps].Size   = n * 2;
+                nOps++;
+                if (!ppLo) continue;
+                ops[nOps].pChunk = pSample->pCkSm24;
+                ops[nOps].Pos    = RIFF::file_offset_t(pSample->Start) + Pos;
+                ops[nOps].pData  = ppLo[i];
+                ops[nOps].Size   = n;
+                nOps++;
+            }
+            ppSamples[0]->pCkSmpl->GetFile()->ReadBatch(ops, nOps);
+            unsigned long got = n;
+            for (int i = 0; i < nOps; ++i) {
+                const RIFF::file_offset_t bytesPerPoint = (ops[i].pChunk == ppSamples[0]->pCkSmpl) ? 2 : 1;
+                if (ops[i].Result / bytesPerPoint < got)
+                    got = (unsigned long) (ops[i].Result / bytesPerPoint);
+            }
+            return got;
+        }
+
+        // same as FetchBlocks() for one sample from its current read
+        // position on, which is advanced behind the read portion afterwards
+        unsigned long FetchBlock(Sample* pSample, uint8_t* pHi, uint8_t* pLo, unsigned long n) {
+            const unsigned long pos = pSample->GetPos();
+            const unsigned long got = FetchBlocks(&pSample, 1, pos, &pHi, (pLo) ? &pLo : NULL, n);
+            pSample->SetPos(pos + got);
+            return got;
+        }
+
+        // Reads FrameCount interleaved stereo frames (left channel first)
+        // of a linked sample pair from sample point Pos on, in the sample
+        // format of the pair, by one batched request per block. Returns
+        // the amount of frames actually read.
+        unsigned long ReadPair(Sample* pLeft, Sample* pRight, unsigned long Pos,
+                               uint8_t* pDst, unsigned long FrameCount)
+        {
+            const bool is24Bit = pLeft->pCkSm24 != NULL;
+            Sample* samples[2] = { pLeft, pRight };
+            uint8_t hi[2][SAMPLE_BLOCK_SIZE * 2];
+            uint8_t lo[2][SAMPLE_BLOCK_SIZE];
+            uint8_t merged[2][SAMPLE_BLOCK_SIZE * 3];
+            uint8_t* ppHi[2] = { hi[0], hi[1] };
+            uint8_t* ppLo[2] = { lo[0], lo[1] };
+            unsigned long done = 0;
+            while (done < FrameCount) {
+                unsigned long n = FrameCount - done;
+                if (n > SAMPLE_BLOCK_SIZE) n = SAMPLE_BLOCK_SIZE;
+                const unsigned long got = FetchBlocks(samples, 2, Pos + done, ppHi, (is24Bit) ? ppLo : NULL, n);
+                if (is24Bit) {
+                    kernels.Merge24(hi[0], lo[0], merged[0], got);
+                    kernels.Merge24(hi[1], lo[1], merged[1], got);
+                    uint8_t* p = pDst + done * 6;
+                    for (unsigned long i = 0; i < got; ++i, p += 6) {
+                        memcpy(p,     merged[0] + i * 3, 3);
+                        memcpy(p + 3, merged[1] + i * 3, 3);
+                    }
+                } else {
+                    int16_t* p = (int16_t*) pDst + done * 2;
+                    for (unsigned long i = 0; i < got; ++i, p += 2) {
+                        p[0] = int16_t(hi[0][i*2] | (hi[0][i*2 + 1] << 8));
+                        p[1] = int16_t(hi[1][i*2] | (hi[1][i*2 + 1] << 8));
+                    }
+                }
+                done += got;
+                if (got < n) break;
+            }
+            return done;
+        }
+
+    } // anonymous namespace
+
+    // Actual implementation of Sample::Read*() code, reading from sample point
+    // Pos on without touching the read position. Wrapped into a template for a) runtime effeciency and b) code redundancy reasons.
     template<bool CLEAR>
-    inline unsigned long ReadSample(Sample* pSample, void* pBuffer, unsigned long SampleCount, Sample::buffer_t* tempBuffer = NULL) {
+    inline unsigned long ReadSampleAt(Sample* pSample, unsigned long Pos, void* pBuffer, unsigned long SampleCount) {
         // TODO: startAddrsCoarseOffset, endAddrsCoarseOffset
         if (SampleCount == 0) return 0;
-        long pos = pSample->GetPos();
+        const long pos = Pos;
+        if (pos >= pSample->GetTotalFrameCount()) return 0;
         if (pos + SampleCount > pSample->GetTotalFrameCount())
             SampleCount = pSample->GetTotalFrameCount() - pos;
-        if (!CLEAR) {
-            if (tempBuffer->Size < SampleCount * pSample->GetFrameSize()) {
-                std::cerr << "sf2::Sample error: tempBuffer too small. This is a BUG!" << std::endl;
-                return 0;
-            }
-        }
 
         if (pSample->GetFrameSize() / pSample->GetChannelCount() == 3 /* 24 bit */) {
-            uint8_t* const pTmpBuf = (uint8_t*) ((CLEAR) ? pBuffer : tempBuffer->pStart);
-            uint8_t* const pBuf    = (uint8_t*)pBuffer;
+            // both chunks are fetched block wise into a local buffer (by one
+            // batched request per block) and merged from there
+            uint8_t* pBuf = (uint8_t*) pBuffer;
+            int step;
             if (pSample->SampleType == Sample::MONO_SAMPLE || pSample->SampleType == Sample::ROM_MONO_SAMPLE) {
-                pSample->pCkSmpl->Read(pTmpBuf, SampleCount, 2);
-                pSample->pCkSm24->Read(pTmpBuf + SampleCount * 2, SampleCount, 1);
-                for (long i = SampleCount - 1; i >= 0; i--) {
-                    pBuf[i*3]     = pTmpBuf[(SampleCount * 2) + i];
-                    pBuf[i*3 + 2] = pTmpBuf[i*2 + 1];
-                    pBuf[i*3 + 1] = pTmpBuf[i*2];
-                }
+                step = 3;
             } else if (pSample->SampleType == Sample::LEFT_SAMPLE || pSample->SampleType == Sample::ROM_LEFT_SAMPLE) {
-                pSample->pCkSmpl->Read(pTmpBuf, SampleCount, 2);
-                pSample->pCkSm24->Read(pTmpBuf + SampleCount * 2, SampleCount, 1);
-                for (long i = SampleCount - 1; i >= 0; i--) {
-                    pBuf[i*6]     = pTmpBuf[(SampleCount * 2) + i];
-                    pBuf[i*6 + 2] = pTmpBuf[i*2 + 1];
-                    pBuf[i*6 + 1] = pTmpBuf[i*2];
-                    if (CLEAR)
-                        pBuf[i*6 + 3] = pBuf[i*6 + 4] = pBuf[i*6 + 5] = 0;
-                }
+                step = 6;
             } else if (pSample->SampleType == Sample::RIGHT_SAMPLE || pSample->SampleType == Sample::ROM_RIGHT_SAMPLE) {
-                pSample->pCkSmpl->Read(pTmpBuf, SampleCount, 2);
-                pSample->pCkSm24->Read(pTmpBuf + SampleCount * 2, SampleCount, 1);
-                for (long i = SampleCount - 1; i >= 0; i--) {
-                    pBuf[i*6 + 3] = pTmpBuf[(SampleCount * 2) + i];
-                    pBuf[i*6 + 5] = pTmpBuf[i*2 + 1];
-                    pBuf[i*6 + 4] = pTmpBuf[i*2];
-                    if (CLEAR)
-                        pBuf[i*6] = pBuf[i*6 + 1] = pBuf[i*6 + 2] = 0;
+                step = 6;
+                pBuf += 3;
+            } else {
+                return SampleCount;
+            }
+            uint8_t hi[SAMPLE_BLOCK_SIZE * 2];
+            uint8_t lo[SAMPLE_BLOCK_SIZE];
+            uint8_t merged[SAMPLE_BLOCK_SIZE * 3];
+            uint8_t* ppHi[1] = { hi };
+            uint8_t* ppLo[1] = { lo };
+            unsigned long done = 0;
+            while (done < SampleCount) {
+                unsigned long n = SampleCount - done;
+                if (n > SAMPLE_BLOCK_SIZE) n = SAMPLE_BLOCK_SIZE;
+                const unsigned long got = FetchBlocks(&pSample, 1, Pos + done, ppHi, ppLo, n);
+                if (step == 3) {
+                    kernels.Merge24(hi, lo, pBuf + done * 3, got);
+                } else {
+                    kernels.Merge24(hi, lo, merged, got);
+                    uint8_t* pDst = pBuf + done * 6;
+                    // the other channel starts 3 bytes after (left) or
+                    // before (right) this channel's sample point
+                    const int other = (pBuf == pBuffer) ? 3 : -3;
+                    for (unsigned long i = 0; i < got; ++i, pDst += 6) {
+                        memcpy(pDst, merged + i * 3, 3);
+                        if (CLEAR) pDst[other] = pDst[other + 1] = pDst[other + 2] = 0;
+                    }
                 }
+                done += got;
+                if (got < n) break;
             }
+            SampleCount = done;
         } else {
             if (pSample->SampleType == Sample::MONO_SAMPLE || pSample->SampleType == Sample::ROM_MONO_SAMPLE) {
-                return pSample->pCkSmpl->Read(pBuffer, SampleCount, 2);
+                return (unsigned long) pSample->pCkSmpl->ReadAt(
+                    (RIFF::file_offset_t(pSample->Start) + Pos) * 2, pBuffer, SampleCount, 2
+                );
             }
 
-            int16_t* const pTmpBuf = (int16_t*) ((CLEAR) ? pBuffer : tempBuffer->pStart);
-            int16_t* const pBuf    = (int16_t*) pBuffer;
-            if (pSample->SampleType == Sample::LEFT_SAMPLE || pSample->SampleType == Sample::ROM_LEFT_SAMPLE) {
-                pSample->pCkSmpl->Read(pTmpBuf, SampleCount, 2);
-                for (long i = SampleCount - 1; i >= 0; i--) {
-                    pBuf[i*2] = pTmpBuf[i];
-                    if (CLEAR)
-                        pBuf[i*2 + 1] = 0;
-                }
-            } else if (pSample->SampleType == Sample::RIGHT_SAMPLE || pSample->SampleType == Sample::ROM_RIGHT_SAMPLE) {
-                pSample->pCkSmpl->Read(pTmpBuf, SampleCount, 2);
-                for (long i = SampleCount - 1; i >= 0; i--) {
-                    if (CLEAR)
-                        pBuf[i*2] = 0;
-                    pBuf[i*2 + 1] = pTmpBuf[i];
+            // stereo halves are fetched block wise into a local buffer as
+            // well, so no tempBuffer is needed (and nothing is allocated)
+            int16_t* pBuf = (int16_t*) pBuffer;
+            if (pSample->SampleType == Sample::RIGHT_SAMPLE || pSample->SampleType == Sample::ROM_RIGHT_SAMPLE) {
+                pBuf++;
+            } else if (pSample->SampleType != Sample::LEFT_SAMPLE && pSample->SampleType != Sample::ROM_LEFT_SAMPLE) {
+                return SampleCount;
+            }
+            // the other channel is located directly after (left) or before
+            // (right) this channel's sample point
+            const int other = (pBuf == pBuffer) ? 1 : -1;
+            uint8_t hi[SAMPLE_BLOCK_SIZE * 2];
+            uint8_t* ppHi[1] = { hi };
+            unsigned long done = 0;
+            while (done < SampleCount) {
+                unsigned long n = SampleCount - done;
+                if (n > SAMPLE_BLOCK_SIZE) n = SAMPLE_BLOCK_SIZE;
+                const unsigned long got = FetchBlocks(&pSample, 1, Pos + done, ppHi, NULL, n);
+                int16_t* pDst = pBuf + done * 2;
+                for (unsigned long i = 0; i < got; ++i, pDst += 2) {
+                    *pDst = int16_t(hi[i*2] | (hi[i*2 + 1] << 8));
+                    if (CLEAR) pDst[other] = 0;
                 }
+                done += got;
+                if (got < n) break;
             }
+            SampleCount = done;
         }
+        return SampleCount;
+    }
+
+    // same as ReadSampleAt(), but from the sample's current read position on,
+    // which is advanced behind the read portion
+    template<bool CLEAR>
+    inline unsigned long ReadSample(Sample* pSample, void* pBuffer, unsigned long SampleCount) {
+        const unsigned long pos = pSample->GetPos();
+        SampleCount = ReadSampleAt<CLEAR>(pSample, pos, pBuffer, SampleCount);
+        pSample->SetPos(pos + SampleCount);
 
         if (pSample->pCkSmpl->GetPos() > (pSample->End * 2)) {
             std::cerr << "Read after the sample end. This is a BUG!" << std::endl;
@@ -1527,21 +2462,283 @@ namespace sf2 {
      * sample will be filled. The other audio channel
      * of @a pBuffer will remain untouched. So you might pass the same
      * @a pBuffer to the other, linked sample to actually get the interleaved
-     * stereo audio stream. To avoid destroying the other audio channel's data
-     * you must pass an external, tempoary working buffer @a tempBuffer, which
-     * should already be allocated to the size required to decode the requested
-     * length of sample data. That @a tempBuffer is only used by ReadNoClear()
-     * to fulfill its work, it does not contain any useful data after this
-     * method returned.
+     * stereo audio stream (or just use ReadStereo() instead).
+     *
+     * No temporary work buffer is required: the sample data is fetched in
+     * blocks of limited size into a buffer on the stack, so this method
+     * neither allocates memory nor depends on the size of the requested
+     * read, which makes it suitable for real-time threads.
      *
      * @param pBuffer      destination buffer
      * @param SampleCount  number of sample points to read
-     * @param tempBuffer   temporary work buffer (must be pre-allocated large enough)
      * @returns            number of successfully read sample points
      * @see                SetPos(), Read()
      */
-    unsigned long Sample::ReadNoClear(void* pBuffer, unsigned long SampleCount, buffer_t& tempBuffer) {
-        return ReadSample<false>(this, pBuffer, SampleCount, &tempBuffer);
+    unsigned long Sample::ReadNoClear(void* pBuffer, unsigned long SampleCount) {
+        return ReadSample<false>(this, pBuffer, SampleCount);
+    }
+
+    /**
+     * Same as ReadNoClear(void*, unsigned long). The external temporary
+     * work buffer this method used to require is not used anymore, this
+     * overload only remains for compatibility.
+     *
+     * @param pBuffer      destination buffer
+     * @param SampleCount  number of sample points to read
+     * @param tempBuffer   ignored
+     * @returns            number of successfully read sample points
+     * @deprecated         Use ReadNoClear(void*, unsigned long) instead.
+     */
+    unsigned long Sample::ReadNoClear(void* pBuffer, unsigned long SampleCount, buffer_t& /*tempBuffer*/) {
+        return ReadSample<false>(this, pBuffer, SampleCount);
+    }
+
+    /**
+     * Same as ReadNoClear(), but reads from sample point \a Pos on, without
+     * using or changing the current read position of this sample.
+     *
+     * The read position used by SetPos(), Read() and ReadNoClear() is
+     * stored in the RIFF chunk shared by all samples of the file, so those
+     * methods must not be used by several threads at the same time, not
+     * even for different samples. This method in contrast may be called by
+     * any amount of threads concurrently, for the same or for different
+     * samples, as long as the file is not modified meanwhile.
+     *
+     * @param Pos          sample point to start reading from
+     * @param pBuffer      destination buffer (a stereo buffer for the left
+     *                     and right sample of a stereo pair, see ReadNoClear())
+     * @param SampleCount  number of sample points to read
+     * @returns            number of successfully read sample points
+     * @see                ReadNoClear()
+     */
+    unsigned long Sample::ReadAt(unsigned long Pos, void* pBuffer, unsigned long SampleCount) {
+        return ReadSampleAt<false>(this, Pos, pBuffer, SampleCount);
+    }
+
+    /**
+     * Same as ReadNoClear(), but converts the sample points directly to 32
+     * bit floating point numbers in the range of -1.0 to +1.0 (multiplied
+     * by @a Gain), for 16 bit as well as for 24 bit samples. No temporary
+     * work buffer is required.
+     *
+     * For mono samples @a pBuffer receives @a SampleCount floats. For the
+     * left and right sample of a stereo pair, @a pBuffer is expected to be
+     * an interleaved stereo buffer (@a SampleCount * 2 floats) and only
+     * this sample's channel is written; just call this method for both
+     * linked samples with the same @a pBuffer to get the stereo stream.
+     *
+     * @param pBuffer      destination buffer
+     * @param SampleCount  number of sample points to read
+     * @param Gain         (optional) gain factor to be applied
+     * @returns            number of successfully read sample points
+     * @see                SetPos(), ReadNoClear()
+     */
+    unsigned long Sample::ReadFloat(float* pBuffer, unsigned long SampleCount, float Gain) {
+        if (SampleCount == 0) return 0;
+        long pos = GetPos();
+        if (pos + SampleCount > (unsigned long) GetTotalFrameCount())
+
+            SampleCount = GetTotalFrameCount() - pos;
+
+        const bool is24Bit = GetFrameSize() / GetChannelCount() == 3;
+        int step;
+        if (SampleType == MONO_SAMPLE || SampleType == ROM_MONO_SAMPLE) {
+            step = 1;
+        } else if (SampleType == LEFT_SAMPLE || SampleType == ROM_LEFT_SAMPLE) {
+            step = 2;
+        } else if (SampleType == RIGHT_SAMPLE || SampleType == ROM_RIGHT_SAMPLE) {
+            step = 2;
+            pBuffer++;
+        } else {
+            return 0;
+        }
+        const float scale = Gain / 2147483648.f;
+        uint8_t hi[SAMPLE_BLOCK_SIZE * 2];
+        uint8_t lo[SAMPLE_BLOCK_SIZE];
+        float   converted[SAMPLE_BLOCK_SIZE];
+        unsigned long done = 0;
+        while (done < SampleCount) {
+            unsigned long n = SampleCount - done;
+            if (n > SAMPLE_BLOCK_SIZE) n = SAMPLE_BLOCK_SIZE;
+            const unsigned long got = FetchBlock(this, hi, (is24Bit) ? lo : NULL, n);
+            if (step == 1) {
+                kernels.ToFloat(hi, (is24Bit) ? lo : NULL, pBuffer + done, got, scale);
+            } else {
+                kernels.ToFloat(hi, (is24Bit) ? lo : NULL, converted, got, scale);
+                float* pDst = pBuffer + done * 2;
+                for (unsigned long i = 0; i < got; ++i, pDst += 2)
+                    *pDst = converted[i];
+            }
+            done += got;
+            if (got < n) break;
+        }
+        return done;
+    }
+
+    /**
+     * Returns the format and length of this sample as stream (see
+     * SampleStream::Source). In contrast to Read(), the stream of the left
+     * or right sample of a stereo pair is always mono, i.e. it only
+     * consists of the audio channel stored by this sample; use ReadStereo()
+     * for the interleaved stereo stream of a pair.
+     */
+    SampleStream::info_t Sample::GetStreamInfo() {
+        SampleStream::info_t info;
+        const bool is24Bit = pCkSm24 != NULL;
+        info.Channels    = 1;
+        info.BitDepth    = (is24Bit) ? 24 : 16;
+        info.FrameSize   = (is24Bit) ? 3 : 2;
+        info.SampleRate  = SampleRate;
+        info.SampleCount = GetTotalFrameCount();
+        return info;
+    }
+
+    /**
+     * Reads sample points of this sample's audio channel from any position
+     * in the given output format, without using or changing the read
+     * position of SetPos() and Read() (see SampleStream::Source). The data
+     * is fetched block wise by batched requests like ReadAt() and converted
+     * by the same kernels as ReadFloat(), so this may be called by several
+     * threads at the same time as well. For 24 bit samples only the smpl
+     * chunk is read with SampleStream::format_int16.
+     */
+    SampleStream::pos_t Sample::ReadStream(SampleStream::pos_t Pos, void* pBuffer, SampleStream::pos_t SampleCount, SampleStream::format_t Format) {
+        const SampleStream::pos_t total = GetTotalFrameCount();
+        if (Pos >= total || !SampleCount) return 0;
+        if (SampleCount > total - Pos) SampleCount = total - Pos;
+        if (SampleType != MONO_SAMPLE  && SampleType != ROM_MONO_SAMPLE  &&
+            SampleType != LEFT_SAMPLE  && SampleType != ROM_LEFT_SAMPLE  &&
+            SampleType != RIGHT_SAMPLE && SampleType != ROM_RIGHT_SAMPLE) return 0;
+        const bool is24Bit = pCkSm24 != NULL;
+        const bool bMerge  = is24Bit && Format == SampleStream::format_native;
+        const bool bLo     = is24Bit && Format != SampleStream::format_int16;
+        const float scale  = 1.f / 2147483648.f;
+        uint8_t hi[SAMPLE_BLOCK_SIZE * 2];
+        uint8_t lo[SAMPLE_BLOCK_SIZE];
+        uint8_t* ppHi[1] = { hi };
+        uint8_t* ppLo[1] = { lo };
+        Sample* pSample = this;
+        SampleStream::pos_t done = 0;
+        while (done < SampleCount) {
+            unsigned long n = SAMPLE_BLOCK_SIZE;
+            if (n > SampleCount - done) n = (unsigned long) (SampleCount - done);
+            const unsigned long got = FetchBlocks(&pSample, 1, (unsigned long) (Pos + done), ppHi, (bLo) ? ppLo : NULL, n);
+            if (Format == SampleStream::format_float) {
+                kernels.ToFloat(hi, (bLo) ? lo : NULL, (float*) pBuffer + done, got, scale);
+            } else if (bMerge) {
+                kernels.Merge24(hi, lo, (uint8_t*) pBuffer + done * 3, got);
+            } else {
+                int16_t* pDst = (int16_t*) pBuffer + done;
+                for (unsigned long i = 0; i < got; ++i)
+                    pDst[i] = int16_t(hi[i*2] | (hi[i*2 + 1] << 8));
+            }
+            done += got;
+            if (got < n) break;
+        }
+        return done;
+    }
+
+    /**
+     * Returns the loop points stored with this sample (if any), relative to
+     * the sample start. Whether the loop is actually used for playback is
+     * defined by the zones using this sample (see Region::HasLoop).
+     */
+    bool Sample::GetStreamLoop(SampleStream::loop_t& Loop) {
+        Loop = SampleStream::loop_t();
+        if (!HasLoops() || StartLoop < Start || EndLoop <= StartLoop || EndLoop > End) return false;
+        Loop.Start = StartLoop - Start;
+        Loop.End   = EndLoop - Start;
+        return true;
+    }
+
+    /**
+     * Returns the head of this sample cached in RAM by LoadSampleData() (if
+     * any). Only the RAM cache of mono samples is returned: the one of the
+     * left or right sample of a stereo pair is a stereo buffer (see
+     * Read()), which is not in the format of this sample's stream.
+     */
+    SampleStream::head_t Sample::GetStreamHead() {
+        SampleStream::head_t head;
+        if (!RAMCache.pStart || (SampleType != MONO_SAMPLE && SampleType != ROM_MONO_SAMPLE)) return head;
+        head.pData       = RAMCache.pStart;
+        head.SampleCount = RAMCache.Size / GetFrameSize();
+        return head;
+    }
+
+    /**
+     * Reads \a FrameCount number of stereo frames from the current position
+     * of both this sample and its linked sample (see GetLinkedSample()) into
+     * the buffer pointed by \a pBuffer, interleaved with the left channel
+     * first (regardless of whether this sample is the left or right half),
+     * and increments the position within the sample. Both halves are read
+     * by one batched request, so this replaces the two ReadNoClear() calls
+     * otherwise needed for a stereo pair (and requires no temporary work
+     * buffer).
+     *
+     * The buffer layout is the same as with Read(): int16_t (native
+     * endianness) for 16 bit samples, three bytes per sample point,
+     * little-endian for 24 bit samples.
+     *
+     * @param pBuffer     destination buffer (\a FrameCount * GetFrameSize() bytes)
+     * @param FrameCount  number of stereo frames to read
+     * @returns           number of successfully read stereo frames, 0 if
+     *                    this sample is not part of a linked stereo pair
+     * @see               ReadStereoAndLoop(), SetPos()
+     */
+    unsigned long Sample::ReadStereo(void* pBuffer, unsigned long FrameCount) {
+        if (!pLinkedSample || FrameCount == 0) return 0;
+        const unsigned long pos = GetPos();
+        if (pos + FrameCount > (unsigned long) GetTotalFrameCount())
+            FrameCount = GetTotalFrameCount() - pos;
+        const bool isLeft = SampleType == LEFT_SAMPLE || SampleType == ROM_LEFT_SAMPLE;
+        Sample* pLeft  = (isLeft) ? this : pLinkedSample;
+        Sample* pRight = (isLeft) ? pLinkedSample : this;
+        const unsigned long done = ReadPair(pLeft, pRight, pos, (uint8_t*) pBuffer, FrameCount);
+        SetPos(pos + done);
+        return done;
+    }
+
+    /**
+     * Same as ReadAndLoop(), but reads interleaved stereo frames of this
+     * sample and its linked sample like ReadStereo(), sharing the playback
+     * state (and thus the loop) between both channels.
+     *
+     * @param pBuffer          destination buffer (\a FrameCount * GetFrameSize() bytes)
+     * @param FrameCount       number of stereo frames to read
+     * @param pPlaybackState   will be used to store and reload the playback
+     *                         state for the next ReadStereoAndLoop() call
+     * @param pRegion          region providing the loop points
+     * @returns                number of successfully read stereo frames, 0
+     *                         if this sample is not part of a linked stereo pair
+     * @see                    ReadStereo(), ReadAndLoop()
+     */
+    unsigned long Sample::ReadStereoAndLoop (
+        void*           pBuffer,
+        unsigned long   FrameCount,
+        PlaybackState*  pPlaybackState,
+        Region*         pRegion
+    ) {
+        if (!pLinkedSample) return 0;
+        unsigned long samplestoread = FrameCount, totalreadsamples = 0, readsamples, samplestoloopend;
+        uint8_t* pDst = (uint8_t*) pBuffer;
+        SetPos(pPlaybackState->position);
+        if (pRegion->HasLoop) {
+            do {
+                samplestoloopend  = pRegion->LoopEnd - GetPos();
+                readsamples       = ReadStereo(&pDst[totalreadsamples * GetFrameSize()], Min(samplestoread, samplestoloopend));
+                samplestoread    -= readsamples;
+                totalreadsamples += readsamples;
+                if (readsamples == samplestoloopend) {
+                    SetPos(pRegion->LoopStart);
+                }
+            } while (samplestoread && readsamples);
+        } else {
+            totalreadsamples = ReadStereo(pBuffer, FrameCount);
+        }
+
+        pPlaybackState->position = GetPos();
+
+        return totalreadsamples;
     }
 
 
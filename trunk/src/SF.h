@@ -24,8 +24,10 @@
 #define __SF2_SF_H__
 
 #include "RIFF.h"
+#include "SampleStream.h"
 
 #include <vector>
+#include <map>
 
 
 #define RIFF_ID(x) (*((uint32_t*) x))
@@ -61,7 +63,7 @@
 /** SoundFont specific classes and definitions */
 namespace sf2 {
 
-    static uint NONE = 0x1ffffff;
+    static const uint NONE = 0x1ffffff;
 
     double ToSeconds(int Timecents);
     double ToRatio(int Centibels);
@@ -218,6 +220,8 @@ namespace sf2 {
             uint16_t     ModAmount;
             Modulator    ModAmtSrcOper;
             SFTransform  ModTransOper;
+            SFModulator  Source;       ///< Primary source as stored in the file (decoded in @c ModSrcOper).
+            SFModulator  AmountSource; ///< Amount source as stored in the file (decoded in @c ModAmtSrcOper).
 
             ModulatorItem(ModList& mod);
     };
@@ -259,7 +263,7 @@ namespace sf2 {
 
     class Region;
 
-    class Sample {
+    class Sample : public SampleStream::Source {
         public:
 
             typedef enum {
@@ -286,16 +290,19 @@ namespace sf2 {
                 void*         pStart;            ///< Points to the beginning of the buffer.
                 unsigned long Size;              ///< Size of the actual data in the buffer in bytes.
                 unsigned long NullExtensionSize; ///< The buffer might be bigger than the actual data, if that's the case that unused space at the end of the buffer is filled with NULLs and NullExtensionSize reflects that unused buffer space in bytes. Those NULL extensions are mandatory for differential algorithms that have to take the following data words into account, thus have to access past the buffer's boundary. If you don't know what I'm talking about, just forget this variable. :)
+                void*         pNullExtension;    ///< Usually NULL, which means the NULL extension (if any) directly follows the actual data. If not NULL, @a pStart points directly into a memory-mapped file (zero-copy, read-only) and the NullExtensionSize bytes of silence are located in this separate buffer instead (see Sample::LoadSampleDataWithNullSamplesExtension()).
                 buffer_t() {
                     pStart            = NULL;
                     Size              = 0;
                     NullExtensionSize = 0;
+                    pNullExtension    = NULL;
                 }
             };
 
             String Name;
 
             Sample(RIFF::Chunk* ck, RIFF::Chunk* pCkSmpl, RIFF::Chunk* pCkSm24);
+            ~Sample();
 
             String  GetName() { return Name; }
             int     GetChannelCount();
@@ -313,7 +320,10 @@ namespace sf2 {
             unsigned long SetPos(unsigned long SampleCount);
             unsigned long GetPos();
             unsigned long Read(void* pBuffer, unsigned long SampleCount);
+            unsigned long ReadNoClear(void* pBuffer, unsigned long SampleCount);
             unsigned long ReadNoClear(void* pBuffer, unsigned long SampleCount, buffer_t& tempBuffer);
+            unsigned long ReadAt(unsigned long Pos, void* pBuffer, unsigned long SampleCount);
+            unsigned long ReadFloat(float* pBuffer, unsigned long SampleCount, float Gain = 1.0f);
 
             unsigned long ReadAndLoop (
                 void*           pBuffer,
@@ -322,8 +332,30 @@ namespace sf2 {
                 Region*         pRegion
             );
 
+            /**
+             * @returns The other half of the stereo pair this left or right
+             * sample belongs to, or NULL if this is not a (validly linked)
+             * stereo sample.
+             */
+            Sample* GetLinkedSample() { return pLinkedSample; }
+
+            // implementation of SampleStream::Source
+            virtual SampleStream::info_t GetStreamInfo();
+            virtual SampleStream::pos_t  ReadStream(SampleStream::pos_t Pos, void* pBuffer, SampleStream::pos_t SampleCount, SampleStream::format_t Format = SampleStream::format_native);
+            virtual bool                 GetStreamLoop(SampleStream::loop_t& Loop);
+            virtual SampleStream::head_t GetStreamHead();
+            unsigned long ReadStereo(void* pBuffer, unsigned long FrameCount);
+
+            unsigned long ReadStereoAndLoop (
+                void*           pBuffer,
+                unsigned long   FrameCount,
+                PlaybackState*  pPlaybackState,
+                Region*         pRegion
+            );
+
         //protected:
             buffer_t      RAMCache;   ///< Buffers samples (already uncompressed) in RAM.
+            bool          RAMCacheMapped; ///< Whether RAMCache.pStart points directly into the memory-mapped file (zero-copy) instead of a buffer allocated by us.
             RIFF::Chunk*  pCkSmpl;
             RIFF::Chunk*  pCkSm24;
 
@@ -341,11 +373,123 @@ namespace sf2 {
                                   * sample header index of the associated right or left stereo
                                   * sample respectively; zero otherwise. */
             uint16_t SampleType;
+            Sample*  pLinkedSample; // other half of a stereo pair (resolved from SampleLink), NULL otherwise
     };
 
     class File;
     class Instrument;
 
+    /**
+     * Synthesis parameters of an instrument zone, already combined with
+     * the preset zone referencing it and converted to engine units. Returned
+     * by Region::Resolve(); each member holds exactly what the
+     * corresponding Region getter (e.g. Region::GetEG1Attack() for
+     * @c EG1Attack) returns for the same preset zone.
+     */
+    struct ResolvedRegion {
+        Region* pPresetRegion;     ///< Preset zone the values were combined with (may be NULL).
+        Region* pInstrumentRegion; ///< Instrument zone the values were resolved for.
+
+        int    Pan;                ///< -64 - +63
+        int    FineTune;           ///< -99 - +99
+        int    CoarseTune;         ///< -120 - +120
+        double EG1PreAttackDelay;  ///< in seconds
+        double EG1Attack;          ///< in seconds
+        double EG1Hold;            ///< in seconds
+        double EG1Decay;           ///< in seconds
+        int    EG1Sustain;         ///< decrease in level, in centibels
+        double EG1Release;         ///< in seconds
+
+        double EG2PreAttackDelay;  ///< in seconds
+        double EG2Attack;          ///< in seconds
+        double EG2Hold;            ///< in seconds
+        double EG2Decay;           ///< in seconds
+        int    EG2Sustain;         ///< in permilles
+        double EG2Release;         ///< in seconds
+
+        int    ModEnvToPitch;      ///< in cents
+        int    ModLfoToPitch;      ///< in cents
+        int    ModEnvToFilterFc;   ///< in cents
+        int    ModLfoToFilterFc;   ///< in cents
+        double ModLfoToVolume;     ///< in centibels
+        double FreqModLfo;         ///< in Hz
+        double DelayModLfo;        ///< in seconds
+        int    VibLfoToPitch;      ///< in cents
+        double FreqVibLfo;         ///< in Hz
+        double DelayVibLfo;        ///< in seconds
+        int    InitialFilterFc;    ///< in absolute cents
+        int    InitialFilterQ;     ///< in centibels
+    };
+
+    /**
+     * Modulator of a ModulatorMatrix, i.e. one of the default modulators or
+     * a custom modulator of an instrument or preset zone, which was not
+     * overridden by an identical modulator (same sources, destination and
+     * transform) on a more specific level.
+     */
+    struct CompiledModulator {
+        SFModulator Source;                 ///< Primary source (as stored in the file).
+        SFModulator AmountSource;           ///< Amount source (as stored in the file).
+        SFGenerator Destination;            ///< Modulated generator (see SFGeneratorType).
+        int         Amount;                 ///< Output of the modulator at full scale sources, in the destination generator's unit.
+        SFTransform Transform;              ///< 0: linear, 2: absolute value.
+        int         SourceController;       ///< Controller of the primary source (see ModulatorMatrix::ControllerOf()), -1 if none.
+        int         AmountSourceController; ///< Controller of the amount source, -1 if none.
+    };
+
+    /**
+     * All modulators affecting the voices of an instrument zone played
+     * through a certain preset zone, compiled according to the SoundFont
+     * 2.04 rules: the default modulators, overridden by identical
+     * modulators of the instrument's global zone and then of the
+     * instrument zone itself, plus the modulators of the preset's global
+     * zone and the preset zone (overriding each other the same way), which
+     * add to the instrument level. Linked modulators are not supported and
+     * ignored.
+     *
+     * The modulators are indexed by source controller and by destination,
+     * so a controller change only re-evaluates the modulators depending on
+     * that controller and only touches their destinations, see
+     * UpdateController(). Controllers are identified by an index between 0
+     * and CONTROLLER_COUNT - 1: 0 - 127 for MIDI CCs and 128 + the general
+     * controller index (i.e. 128 + Modulator::NOTE_ON_VELOCITY) for the
+     * general controllers.
+     *
+     * Get the (cached) matrix of a zone pair by Region::GetModulatorMatrix().
+     */
+    class ModulatorMatrix {
+        public:
+            /// Amount of controller indices (see ModulatorMatrix).
+            enum { CONTROLLER_COUNT = 256 };
+
+            ModulatorMatrix(Region* pInstrumentRegion, Region* pPresetRegion = NULL);
+
+            int   GetModulatorCount() const;
+            const CompiledModulator& GetModulator(int Index) const;
+            const uint16_t* GetModulatorsOf(int Controller, int& Count) const;
+            const uint8_t*  GetDestinationsOf(int Controller, int& Count) const;
+            bool  IsModulated(SFGenerator Destination) const;
+
+            void  Evaluate(const float* pControllers, float* pOutputs, float* pDestinations) const;
+            void  UpdateController(int Controller, const float* pControllers, float* pOutputs, float* pDestinations) const;
+
+            static int   ControllerOf(SFModulator Source);
+            static float NormalizeController(int Controller, int Value);
+            static float TransformSource(SFModulator Source, float Value);
+
+        private:
+            std::vector<CompiledModulator> modulators;
+            std::vector<uint16_t> controllerModulators;  ///< Indices of the modulators depending on each controller, concatenated for all controllers.
+            int                   controllerModulatorStart[CONTROLLER_COUNT + 1]; ///< Position of each controller's first entry in @c controllerModulators.
+            std::vector<uint8_t>  controllerDestinations; ///< Destinations affected by each controller, concatenated for all controllers.
+            int                   controllerDestinationStart[CONTROLLER_COUNT + 1]; ///< Position of each controller's first entry in @c controllerDestinations.
+            std::vector<uint16_t> destinationModulators; ///< Indices of the modulators of each destination, concatenated for all destinations.
+            int                   destinationModulatorStart[END_OPER + 1]; ///< Position of each destination's first entry in @c destinationModulators.
+
+            float __output(const CompiledModulator& mod, const float* pControllers) const;
+            void  __sumDestination(int Destination, const float* pOutputs, float* pDestinations) const;
+    };
+
     /**
      * Instrument zone
      */
@@ -376,6 +520,7 @@ namespace sf2 {
             Instrument* pInstrument; // used when the region belongs to preset
 
             Region();
+            ~Region();
             Sample* GetSample() { return pSample; }
             Region* GetParent() { return this; }
 
@@ -421,8 +566,13 @@ namespace sf2 {
             int    GetInitialFilterFc(Region* pPresetRegion); // in absolute cents
             int    GetInitialFilterQ(Region* pPresetRegion); // in centibels
 
+            const ResolvedRegion& Resolve(Region* pPresetRegion = NULL);
+            const ModulatorMatrix& GetModulatorMatrix(Region* pPresetRegion = NULL);
+            void ClearResolved();
+
             friend class Instrument;
             friend class Preset;
+            friend class ModulatorMatrix;
 
         private:
             int EG1PreAttackDelay; // in timecents
@@ -440,6 +590,9 @@ namespace sf2 {
             int EG2Release; // in timecents
 
             Instrument* pParentInstrument;
+            Region*     pGlobalZone; ///< Global zone of the instrument or preset this zone inherited its generators from (NULL if none).
+            std::map<Region*,ResolvedRegion*> resolved; ///< Cache of Resolve(), key is the preset zone.
+            std::map<Region*,ModulatorMatrix*> matrices; ///< Cache of GetModulatorMatrix(), key is the preset zone.
 
             void SetGenerator(sf2::File* pFile, GenList& Gen);
             void SetModulator(sf2::File* pFile, ModList& Mod);
@@ -458,10 +611,22 @@ namespace sf2 {
 
             int      GetRegionCount();
             Region*  GetRegion(int idx);
+            void     UpdateKeyIndex();
 
         protected:
             std::vector<Region*> regions;
             sf2::File* pFile;
+            std::vector<int> keyIndex;      ///< Indices (in @c regions) of the regions matching each MIDI key, concatenated for all 128 keys in ascending region order.
+            int              keyIndexStart[129]; ///< Position of the first entry of each MIDI key in @c keyIndex (@c keyIndexStart[128] is the end of the last key's entries).
+            bool             keyIndexValid; ///< Whether @c keyIndex reflects the current regions (i.e. has been built by UpdateKeyIndex()).
+            int              deferredBagIdx1; ///< First bag (zone) of the regions which are loaded on first access (see LoadDeferredRegions()).
+            int              deferredBagIdx2; ///< End of the bag range of the regions which are loaded on first access.
+            volatile bool    regionsLoaded; ///< Whether the regions of the deferred bag range have already been loaded (set once loading finished).
+
+            void EnsureRegionsLoaded();
+            virtual void LoadDeferredRegions() = 0;
+
+            friend class Query;
     };
 
     class Query {
@@ -475,6 +640,8 @@ namespace sf2 {
         private:
             InstrumentBase& instrument;
             int i;
+
+            static bool matchesVelocity(Region* r, uint8_t vel);
     };
 
     class Instrument : public InstrumentBase {
@@ -487,11 +654,15 @@ namespace sf2 {
             uint16_t InstBagNdx;
 
             /**
-             * Load all regions (zones, bags) in the range idx1 - idx2
+             * Load the global zone among the regions (zones, bags) in the
+             * range idx1 - idx2 immediately, and all other regions of that
+             * range on first access (see LoadDeferredRegions()).
              */
             void LoadRegions(int idx1, int idx2);
 
             Region* CreateRegion();
+            Region* LoadRegion(int idx);
+            virtual void LoadDeferredRegions();
     };
 
     class Preset : public InstrumentBase {
@@ -510,11 +681,15 @@ namespace sf2 {
             uint16_t    PresetBagNdx;
 
             /**
-             * Load all regions (zones, bags) in the range idx1 - idx2
+             * Load the global zone among the regions (zones, bags) in the
+             * range idx1 - idx2 immediately, and all other regions of that
+             * range on first access (see LoadDeferredRegions()).
              */
             void LoadRegions(int idx1, int idx2);
 
             Region* CreateRegion();
+            Region* LoadRegion(int idx);
+            virtual void LoadDeferredRegions();
     };
 
     class File {
@@ -523,6 +698,7 @@ namespace sf2 {
 
             File(RIFF::File* pRIFF);
             ~File();
+            static File* TryOpen(RIFF::File* pRIFF, RIFF::probe_result_t* pResult = NULL);
 
             int          GetPresetCount();
             Preset*      GetPreset(int idx);
@@ -0,0 +1,250 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this library; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#ifndef __SAMPLESTREAM_H__
+#define __SAMPLESTREAM_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/** @brief Common streaming interface of the samples of all formats.
+ *
+ * The sample classes of the individual formats (gig::Sample, DLS::Sample,
+ * sf2::Sample, Korg::KSFSample and AkaiSample) each have their own
+ * streaming methods, with different position types and different
+ * semantics of their read buffers. All of them also implement the
+ * SampleStream::Source interface declared here, so one streaming pipeline
+ * (e.g. the disk streaming of a sampler engine) can serve all formats with
+ * the same code:
+ *
+ * - Source::ReadStream() reads from any position, without using or
+ *   changing the sample's own read position (SetPos() / Read()).
+ * - The output format is selected by the caller (format_t): the sample's
+ *   native format, 16 bit integer or 32 bit float, always interleaved.
+ *   Formats with optimized conversion kernels use them, the others are
+ *   converted block by block.
+ * - Source::ReadStreamAndLoop() reads honoring the sample's own loop
+ *   (see Source::GetStreamLoop()).
+ * - Source::GetStreamHead() gives direct access to the head of the sample
+ *   which is already in RAM (e.g. loaded by the format's LoadSampleData()),
+ *   so the start of a note can be served without any I/O.
+ *
+ * This header does not depend on any other header of libgig, so it is
+ * shared by libgig and libakai.
+ */
+namespace SampleStream {
+
+    typedef uint64_t pos_t; ///< Position or amount in sample points (frames).
+
+    /** @brief Output format of ReadStream(). */
+    enum format_t {
+        format_native, ///< As read by the sample class' own Read() method (see info_t::BitDepth and info_t::FrameSize), no conversion at all.
+        format_int16,  ///< Signed 16 bit integer in native byte order (24 bit sample points are truncated).
+        format_float   ///< 32 bit floating point in the range of -1.0 to +1.0.
+    };
+
+    /** @brief Format and length of a sample stream (see Source::GetStreamInfo()). */
+    struct info_t {
+        uint32_t Channels;        ///< Amount of interleaved audio channels of the stream.
+        uint32_t BitDepth;        ///< Bits per sample point and channel of the native format.
+        uint32_t FrameSize;       ///< Bytes per sample point (all channels) of the native format.
+        uint32_t SampleRate;      ///< Sample rate in Hz.
+        pos_t    SampleCount;     ///< Length of the stream in sample points.
+        pos_t    ReadGranularity; ///< Sample points decoded as a unit: reads should start and end at multiples of this for best performance (e.g. the frame size of compressed gig samples), 1 if any position is equally fast.
+        info_t() : Channels(0), BitDepth(0), FrameSize(0), SampleRate(0), SampleCount(0), ReadGranularity(1) {}
+    };
+
+    /** @brief Loop defined by the sample itself (see Source::GetStreamLoop()). */
+    struct loop_t {
+        pos_t    Start;     ///< First sample point of the loop.
+        pos_t    End;       ///< Sample point after the last one of the loop.
+        uint32_t PlayCount; ///< How many times the loop is played, 0 for infinite.
+        loop_t() : Start(0), End(0), PlayCount(0) {}
+    };
+
+    /** @brief Head of a sample already in RAM (see Source::GetStreamHead()). */
+    struct head_t {
+        const void* pData;       ///< First sample point in native format, NULL if none is in RAM.
+        pos_t       SampleCount; ///< Amount of sample points at @a pData.
+        head_t() : pData(NULL), SampleCount(0) {}
+    };
+
+    /** @brief Playback position for Source::ReadStreamAndLoop(). */
+    struct playback_t {
+        pos_t    Position;   ///< Current position in sample points.
+        uint32_t LoopCycles; ///< How many times the loop was played so far.
+        playback_t(pos_t Pos = 0) : Position(Pos), LoopCycles(0) {}
+    };
+
+    /** @brief Streaming interface implemented by the samples of all formats.
+     *
+     * Positions and amounts are always in sample points (all channels of one
+     * point in time), buffers always receive interleaved sample points of
+     * the size OutputFrameSize() returns for the selected format. The
+     * methods are as thread safe as the respective sample class' own Read()
+     * method (see the documentation of each format).
+     */
+    class Source {
+        public:
+            virtual ~Source() {}
+
+            /// Returns the format and length of this sample stream.
+            virtual info_t GetStreamInfo() = 0;
+
+            /**
+             * Reads @a SampleCount sample points from position @a Pos on in
+             * the given format, without using or changing the sample's own
+             * read position.
+             *
+             * @param Pos         - first sample point to read
+             * @param pBuffer     - destination buffer (at least @a SampleCount
+             *                      * OutputFrameSize() bytes)
+             * @param SampleCount - amount of sample points to read
+             * @param Format      - output format
+             * @returns amount of sample points actually read
+             */
+            virtual pos_t ReadStream(pos_t Pos, void* pBuffer, pos_t SampleCount, format_t Format = format_native) = 0;
+
+            /**
+             * Returns the loop defined by the sample itself (if any). Loops
+             * defined by instruments / regions instead are not reflected.
+             *
+             * @param Loop - (out) loop of the sample
+             * @returns false if the sample has no loop
+             */
+            virtual bool GetStreamLoop(loop_t& Loop) = 0;
+
+            /// Returns the head of the sample which is already in RAM in
+            /// native format (if any), without loading anything.
+            virtual head_t GetStreamHead() = 0;
+
+            /**
+             * Reads @a SampleCount sample points from the position of @a
+             * State on like ReadStream(), honoring the loop of the sample
+             * (see GetStreamLoop()): the loop is played PlayCount times (or
+             * infinitely), then reading continues up to the end of the
+             * sample. @a State is advanced accordingly.
+             *
+             * @param State       - playback position, advanced by this call
+             * @param pBuffer     - destination buffer
+             * @param SampleCount - amount of sample points to read
+             * @param Format      - output format
+             * @returns amount of sample points actually read, less than @a
+             *          SampleCount only at the end of the sample
+             */
+            pos_t ReadStreamAndLoop(playback_t& State, void* pBuffer, pos_t SampleCount, format_t Format = format_native) {
+                const info_t info = GetStreamInfo();
+                const pos_t frameSize = OutputFrameSize(info, Format);
+                loop_t loop;
+                const bool bLoop = GetStreamLoop(loop) && loop.Start < loop.End && loop.End <= info.SampleCount;
+                uint8_t* pDst = (uint8_t*) pBuffer;
+                pos_t done = 0;
+                while (done < SampleCount) {
+                    const bool bInLoop = bLoop && State.Position < loop.End &&
+                                         (!loop.PlayCount || State.LoopCycles < loop.PlayCount);
+                    const pos_t end = (bInLoop) ? loop.End : info.SampleCount;
+                    if (State.Position >= end) break;
+                    pos_t n = SampleCount - done;
+                    if (n > end - State.Position) n = end - State.Position;
+                    n = ReadStream(State.Position, pDst + done * frameSize, n, Format);
+                    if (!n) break;
+                    State.Position += n;
+                    done += n;
+                    if (bInLoop && State.Position == loop.End) {
+                        State.Position = loop.Start;
+                        State.LoopCycles++;
+                    }
+                }
+                return done;
+            }
+
+            /// Returns the size (in bytes) of one sample point of the given
+            /// stream in the given output format.
+            static pos_t OutputFrameSize(const info_t& Info, format_t Format) {
+                switch (Format) {
+                    case format_int16: return 2 * Info.Channels;
+                    case format_float: return 4 * Info.Channels;
+                    default:           return Info.FrameSize;
+                }
+            }
+
+        protected:
+            /**
+             * Converts @a Values sample values (all channels) from the
+             * native integer formats used by the RIFF based formats (8 bit
+             * unsigned, 16 or 32 bit signed in native byte order, 24 bit
+             * signed packed little endian) to the given output format.
+             */
+            static void ConvertPCM(const void* pSrc, uint32_t BitDepth, format_t Format, void* pDst, pos_t Values) {
+                const uint8_t* p = (const uint8_t*) pSrc;
+                if (Format == format_int16) {
+                    int16_t* q = (int16_t*) pDst;
+                    switch (BitDepth) {
+                        case 8:  for (pos_t i = 0; i < Values; ++i) q[i] = int16_t((p[i] - 128) << 8); break;
+                        case 16: memcpy(q, p, size_t(Values * 2)); break;
+                        case 24: for (pos_t i = 0; i < Values; ++i) q[i] = int16_t(p[i * 3 + 1] | p[i * 3 + 2] << 8); break;
+                        case 32: for (pos_t i = 0; i < Values; ++i) q[i] = int16_t(((const int32_t*) p)[i] >> 16); break;
+                    }
+                } else if (Format == format_float) {
+                    float* q = (float*) pDst;
+                    switch (BitDepth) {
+                        case 8:  for (pos_t i = 0; i < Values; ++i) q[i] = float(int(p[i]) - 128) * (1.f / 128.f); break;
+                        case 16: for (pos_t i = 0; i < Values; ++i) q[i] = float(((const int16_t*) p)[i]) * (1.f / 32768.f); break;
+                        case 24: for (pos_t i = 0; i < Values; ++i) q[i] = float(int32_t(uint32_t(p[i * 3] << 8 | p[i * 3 + 1] << 16 | p[i * 3 + 2] << 24)) >> 8) * (1.f / 8388608.f); break;
+                        case 32: for (pos_t i = 0; i < Values; ++i) q[i] = float(((const int32_t*) p)[i]) * (1.f / 2147483648.f); break;
+                    }
+                } else {
+                    memcpy(pDst, p, size_t(Values * BitDepth / 8));
+                }
+            }
+
+            /**
+             * ReadStream() for formats without own conversion: reads the
+             * native format by calling ReadStream() with format_native block
+             * by block into a buffer on the stack and converts it with
+             * ConvertPCM().
+             */
+            pos_t ReadStreamConverted(const info_t& Info, pos_t Pos, void* pBuffer, pos_t SampleCount, format_t Format) {
+                if (Format == format_native) return ReadStream(Pos, pBuffer, SampleCount, format_native);
+                if (!Info.FrameSize) return 0;
+                uint8_t block[16384];
+                const pos_t blockSize = sizeof(block) / Info.FrameSize;
+                if (!blockSize) return 0;
+                const pos_t outFrameSize = OutputFrameSize(Info, Format);
+                uint8_t* pDst = (uint8_t*) pBuffer;
+                pos_t done = 0;
+                while (done < SampleCount) {
+                    pos_t n = SampleCount - done;
+                    if (n > blockSize) n = blockSize;
+                    const pos_t got = ReadStream(Pos + done, block, n, format_native);
+                    ConvertPCM(block, Info.BitDepth, Format, pDst + done * outFrameSize, got * Info.Channels);
+                    done += got;
+                    if (got < n) break;
+                }
+                return done;
+            }
+    };
+
+} // namespace SampleStream
+
+#endif // __SAMPLESTREAM_H__
@@ -290,11 +290,11 @@ namespace Serialization {
     bool DataType::operator<(const DataType& other) const {
         return m_baseTypeName  < other.m_baseTypeName ||
               (m_baseTypeName == other.m_baseTypeName &&
-               m_customTypeName  < other.m_customTypeName ||
+              (m_customTypeName  < other.m_customTypeName ||
               (m_customTypeName == other.m_customTypeName &&
-               m_size  < other.m_size ||
+              (m_size  < other.m_size ||
               (m_size == other.m_size &&
-               m_isPointer < other.m_isPointer)));
+               m_isPointer < other.m_isPointer)))));
     }
 
     /** @brief Greater than comparison.
@@ -577,11 +577,11 @@ namespace Serialization {
     bool Member::operator<(const Member& other) const {
         return m_uid  < other.m_uid ||
               (m_uid == other.m_uid &&
-               m_offset  < other.m_offset ||
+              (m_offset  < other.m_offset ||
               (m_offset == other.m_offset &&
-               m_name  < other.m_name ||
+              (m_name  < other.m_name ||
               (m_name == other.m_name &&
-               m_type < other.m_type)));
+               m_type < other.m_type)))));
     }
 
     /** @brief Greater than comparison.
@@ -1045,6 +1045,9 @@ namespace Serialization {
         m_root = NO_UID;
         m_isModified = false;
         m_timeCreated = m_timeModified = LIBGIG_EPOCH_TIME;
+        m_encoding = ENCODING_TEXT;
+        m_pExternalData = NULL;
+        m_externalDataSize = 0;
     }
 
     /** @brief Create and fill the archive with the given serialized raw data.
@@ -1067,7 +1070,10 @@ namespace Serialization {
         m_root = NO_UID;
         m_isModified = false;
         m_timeCreated = m_timeModified = LIBGIG_EPOCH_TIME;
-        decode(m_rawData);
+        m_encoding = ENCODING_TEXT;
+        m_pExternalData = NULL;
+        m_externalDataSize = 0;
+        decode(data);
     }
 
     /** @brief Create and fill the archive with the given serialized raw C-buffer data.
@@ -1095,6 +1101,9 @@ namespace Serialization {
         m_root = NO_UID;
         m_isModified = false;
         m_timeCreated = m_timeModified = LIBGIG_EPOCH_TIME;
+        m_encoding = ENCODING_TEXT;
+        m_pExternalData = NULL;
+        m_externalDataSize = 0;
         decode(data, size);
     }
 
@@ -1287,6 +1296,9 @@ namespace Serialization {
     }
 
     #define MAGIC_START "Srx1v"
+    #define MAGIC_START_BINARY "Srx1b"
+    #define ENCODING_SINK_BLOCK_SIZE  65536
+    #define DECODING_SOURCE_BLOCK_SIZE 65536
     #define ENCODING_FORMAT_MINOR_VERSION 0
 
     String Archive::_encodeRootBlob() {
@@ -1301,15 +1313,250 @@ namespace Serialization {
         return _encodeBlob(s);
     }
 
-    void Archive::encode() {
-        m_rawData.clear();
-        String s = MAGIC_START;
+    // *************** binary encoding ***************
+    // *
+    //
+    // All unsigned integers are encoded as variable length integers with 7
+    // bits per byte (least significant group first, MSB set on all bytes but
+    // the last one), signed integers are zig-zag mapped to unsigned ones
+    // first. Floating point values are stored as raw little endian IEEE 754
+    // values. All type names and member names are stored once in a string
+    // table at the beginning of the stream and referenced by index. Likewise
+    // each distinct DataType is stored only once in a type table following
+    // the string table, and objects and members just refer to their type by
+    // index into that type table.
+    //
+    // The stream consists of a header (format version, string table and type
+    // table), the root object's UID, the amount of objects, each object, and a
+    // trailer (name, comment and time stamps). Header, each object and trailer
+    // are prefixed by their size in bytes, so a decoder reading the stream
+    // piece by piece knows in advance how much data it needs for each part.
+
+    static void _encodeVarUInt(String& s, uint64_t value) {
+        while (value >= 0x80) {
+            s += char((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        s += char(value);
+    }
+
+    static void _encodeVarInt(String& s, int64_t value) {
+        _encodeVarUInt(s, (uint64_t(value) << 1) ^ uint64_t(value >> 63));
+    }
+
+    static void _encodeFixed(String& s, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i, value >>= 8)
+            s += char(value & 0xff);
+    }
+
+    static void _encodeStringBinary(String& s, const String& string) {
+        _encodeVarUInt(s, string.length());
+        s += string;
+    }
+
+    // strings being stored only once in the encoded binary stream
+    class _StringTable {
+    public:
+        uint64_t indexOf(const String& s) {
+            std::map<String,uint64_t>::const_iterator it = m_index.find(s);
+            if (it != m_index.end()) return it->second;
+            const uint64_t index = m_strings.size();
+            m_index[s] = index;
+            m_strings.push_back(s);
+            return index;
+        }
+
+        void encode(String& s) const {
+            _encodeVarUInt(s, m_strings.size());
+            for (size_t i = 0; i < m_strings.size(); ++i)
+                _encodeStringBinary(s, m_strings[i]);
+        }
+    private:
+        std::map<String,uint64_t> m_index;
+        std::vector<String> m_strings;
+    };
+
+    static void _encodeBinary(String& s, const UID& uid) {
+        _encodeVarUInt(s, uint64_t(size_t(uid.id)));
+        _encodeVarUInt(s, uid.size);
+    }
+
+    static void _encodeBinary(String& s, const DataType& type, _StringTable& strings) {
+        _encodeVarUInt(s, strings.indexOf(type.baseTypeName()));
+        _encodeVarUInt(s, strings.indexOf(type.customTypeName()));
+        _encodeVarUInt(s, type.size());
+        s += char(type.isPointer() ? 1 : 0);
+    }
+
+    // data types being stored only once in the encoded binary stream
+    class _TypeTable {
+    public:
+        _TypeTable() : m_lastIndex(0) {}
+
+        uint64_t indexOf(const DataType& type) {
+            // shortcut for the common case of consecutive members of same type
+            // (DataType::operator==() ignores the size of classes, which must
+            // be restored by the decoder though)
+            if (m_lastIndex < m_types.size() &&
+                m_types[m_lastIndex].size() == type.size() &&
+                m_types[m_lastIndex] == type)
+                return m_lastIndex;
+            std::map<DataType,uint64_t>::const_iterator it = m_index.find(type);
+            if (it != m_index.end())
+                return m_lastIndex = it->second;
+            m_lastIndex = m_types.size();
+            m_index[type] = m_lastIndex;
+            m_types.push_back(type);
+            return m_lastIndex;
+        }
+
+        void encode(String& s, _StringTable& strings) const {
+            _encodeVarUInt(s, m_types.size());
+            for (size_t i = 0; i < m_types.size(); ++i)
+                _encodeBinary(s, m_types[i], strings);
+        }
+    private:
+        std::map<DataType,uint64_t> m_index;
+        std::vector<DataType> m_types;
+        uint64_t m_lastIndex;
+    };
+
+    static void _encodeBinary(String& s, const Member& member, _StringTable& strings, _TypeTable& types) {
+        _encodeBinary(s, member.uid());
+        _encodeVarUInt(s, member.offset());
+        _encodeVarUInt(s, strings.indexOf(member.name()));
+        _encodeVarUInt(s, types.indexOf(member.type()));
+    }
+
+    static void _encodePrimitiveValueBinary(String& s, const Object& obj) {
+        const DataType& type = obj.type();
+        if (!type.isPrimitive() || type.isPointer()) return;
+        if (type.isInteger() || type.isEnum()) {
+            if (type.isSigned())
+                _encodeVarInt(s, _primitiveObjectValueToNumber<int64_t>(obj));
+            else
+                _encodeVarUInt(s, _primitiveObjectValueToNumber<uint64_t>(obj));
+        } else if (type.isReal()) {
+            if (type.size() == sizeof(float)) {
+                const float f = _primitiveObjectValueToNumber<float>(obj);
+                uint32_t bits;
+                memcpy(&bits, &f, sizeof(bits));
+                _encodeFixed(s, bits, 4);
+            } else if (type.size() == sizeof(double)) {
+                const double d = _primitiveObjectValueToNumber<double>(obj);
+                uint64_t bits;
+                memcpy(&bits, &d, sizeof(bits));
+                _encodeFixed(s, bits, 8);
+            } else
+                assert(false /* unknown floating point type */);
+        } else if (type.isBool()) {
+            s += char(_primitiveObjectValueToNumber<uint8_t>(obj) ? 1 : 0);
+        } else {
+            assert(false /* unknown primitive type */);
+        }
+    }
+
+    static void _encodeBinary(String& s, const Object& obj, _StringTable& strings, _TypeTable& types) {
+        _encodeVarUInt(s, types.indexOf(obj.type()));
+        _encodeVarUInt(s, obj.version());
+        _encodeVarUInt(s, obj.minVersion());
+        const UIDChain& chain = obj.uidChain();
+        _encodeVarUInt(s, chain.size());
+        for (size_t i = 0; i < chain.size(); ++i)
+            _encodeBinary(s, chain[i]);
+        const std::vector<Member>& members = obj.members();
+        _encodeVarUInt(s, members.size());
+        for (size_t i = 0; i < members.size(); ++i)
+            _encodeBinary(s, members[i], strings, types);
+        _encodePrimitiveValueBinary(s, obj);
+    }
+
+    static void _encodePart(String& s, const String& part) {
+        _encodeVarUInt(s, part.size());
+        s += part;
+    }
+
+    static void _flush(String& s, encoding_sink_t sink, void* pUserData) {
+        const uint8_t* data = (const uint8_t*) s.data();
+        for (size_t i = 0; i < s.size(); i += ENCODING_SINK_BLOCK_SIZE)
+            sink(data + i, std::min(s.size() - i, (size_t)ENCODING_SINK_BLOCK_SIZE), pUserData);
+        s.clear();
+    }
+
+    /**
+     * Appends the binary encoded archive content to @a s. If a @a sink is
+     * supplied, then @a s is handed out to the sink and cleared whenever it
+     * grew beyond ENCODING_SINK_BLOCK_SIZE, and finally at the end.
+     */
+    void Archive::_encodeRootBinary(String& s, encoding_sink_t sink, void* pUserData) {
+        // the tables must precede the objects, so collect all strings and
+        // types in advance
+        _StringTable strings;
+        _TypeTable types;
+        for (ObjectPool::const_iterator itObject = m_allObjects.begin();
+             itObject != m_allObjects.end(); ++itObject)
+        {
+            const Object& obj = itObject->second;
+            types.indexOf(obj.type());
+            const std::vector<Member>& members = obj.members();
+            for (size_t i = 0; i < members.size(); ++i) {
+                strings.indexOf(members[i].name());
+                types.indexOf(members[i].type());
+            }
+        }
+        String typeTable;
+        types.encode(typeTable, strings);
+
+        String header;
+        _encodeVarUInt(header, ENCODING_FORMAT_MINOR_VERSION);
+        strings.encode(header);
+        header += typeTable;
+        _encodePart(s, header);
+
+        _encodeBinary(s, m_root);
+        _encodeVarUInt(s, m_allObjects.size());
+        String part;
+        for (ObjectPool::const_iterator itObject = m_allObjects.begin();
+             itObject != m_allObjects.end(); ++itObject)
+        {
+            part.clear();
+            _encodeBinary(part, itObject->second, strings, types);
+            _encodePart(s, part);
+            if (sink && s.size() >= ENCODING_SINK_BLOCK_SIZE)
+                _flush(s, sink, pUserData);
+        }
+
+        part.clear();
+        _encodeStringBinary(part, m_name);
+        _encodeStringBinary(part, m_comment);
+        _encodeVarInt(part, m_timeCreated);
+        _encodeVarInt(part, m_timeModified);
+        _encodePart(s, part);
+        if (sink) _flush(s, sink, pUserData);
+    }
+
+    void Archive::_updateTimeStamps() {
         m_timeModified = time(NULL);
         if (m_timeCreated == LIBGIG_EPOCH_TIME)
             m_timeCreated = m_timeModified;
-        s += _encodeRootBlob();
-        m_rawData.resize(s.length() + 1);
-        memcpy(&m_rawData[0], &s[0], s.length() + 1);
+    }
+
+    void Archive::encode() {
+        m_rawData.clear();
+        m_pExternalData = NULL;
+        m_externalDataSize = 0;
+        _updateTimeStamps();
+        if (m_encoding == ENCODING_BINARY) {
+            String s = MAGIC_START_BINARY;
+            _encodeRootBinary(s, NULL, NULL);
+            m_rawData.resize(s.length());
+            memcpy(&m_rawData[0], &s[0], s.length());
+        } else {
+            String s = MAGIC_START;
+            s += _encodeRootBlob();
+            m_rawData.resize(s.length() + 1);
+            memcpy(&m_rawData[0], &s[0], s.length() + 1);
+        }
         m_isModified = false;
     }
 
@@ -1602,6 +1849,315 @@ namespace Serialization {
         m_timeModified = _popTimeBlob(p, end);
     }
 
+    // *************** binary decoding ***************
+    // *
+
+    static uint64_t _popVarUInt(const char*& p, const char* end) {
+        uint64_t value = 0;
+        for (int shift = 0; true; shift += 7, ++p) {
+            if (p >= end)
+                throw Exception("Decode Error: Premature end of binary integer");
+            if (shift > 63)
+                throw Exception("Decode Error: Binary integer too large");
+            const uint8_t c = *p;
+            value |= uint64_t(c & 0x7f) << shift;
+            if (!(c & 0x80)) break;
+        }
+        ++p;
+        return value;
+    }
+
+    static int64_t _popVarInt(const char*& p, const char* end) {
+        const uint64_t u = _popVarUInt(p, end);
+        return int64_t(u >> 1) ^ -int64_t(u & 1);
+    }
+
+    static uint64_t _popFixed(const char*& p, const char* end, int bytes) {
+        if (end - p < bytes)
+            throw Exception("Decode Error: Premature end of binary value");
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i)
+            value |= uint64_t(uint8_t(p[i])) << (8 * i);
+        p += bytes;
+        return value;
+    }
+
+    static String _popStringBinary(const char*& p, const char* end) {
+        const uint64_t sz = _popVarUInt(p, end);
+        if (uint64_t(end - p) < sz)
+            throw Exception("Decode Error: Premature end of binary string");
+        String s(p, size_t(sz));
+        p += sz;
+        return s;
+    }
+
+    static const String& _popStringRef(const char*& p, const char* end, const std::vector<String>& strings) {
+        const uint64_t index = _popVarUInt(p, end);
+        if (index >= strings.size())
+            throw Exception("Decode Error: Invalid string table index");
+        return strings[index];
+    }
+
+    static UID _popUIDBinary(const char*& p, const char* end) {
+        const ID id = (ID) size_t(_popVarUInt(p, end));
+        const size_t size = (size_t) _popVarUInt(p, end);
+        const UID uid = { id, size };
+        return uid;
+    }
+
+    static DataType _popDataTypeBinary(const char*& p, const char* end, const std::vector<String>& strings) {
+        DataType type;
+        type.m_baseTypeName   = _popStringRef(p, end, strings);
+        type.m_customTypeName = _popStringRef(p, end, strings);
+        type.m_size           = (int) _popVarUInt(p, end);
+        type.m_isPointer      = _popFixed(p, end, 1);
+        return type;
+    }
+
+    static const DataType& _popDataTypeRef(const char*& p, const char* end, const std::vector<DataType>& types) {
+        const uint64_t index = _popVarUInt(p, end);
+        if (index >= types.size())
+            throw Exception("Decode Error: Invalid type table index");
+        return types[index];
+    }
+
+    static Member _popMemberBinary(const char*& p, const char* end, const std::vector<String>& strings, const std::vector<DataType>& types) {
+        Member m;
+        m.m_uid    = _popUIDBinary(p, end);
+        m.m_offset = (size_t) _popVarUInt(p, end);
+        m.m_name   = _popStringRef(p, end, strings);
+        m.m_type   = _popDataTypeRef(p, end, types);
+        if (!m.type() || m.name().empty() || !m.uid().isValid())
+            throw Exception("Decode Error: Invalid member");
+        return m;
+    }
+
+    template<typename T>
+    static void _storePrimitiveValue(RawData& data, T value) {
+        memcpy(&data[0], &value, sizeof(T));
+    }
+
+    static void _popPrimitiveValueBinary(const char*& p, const char* end, const DataType& type, RawData& data) {
+        if (!type.isPrimitive() || type.isPointer()) return;
+        data.resize(type.size());
+        if (type.isInteger() || type.isEnum()) {
+            if (type.isSigned()) {
+                const int64_t i = _popVarInt(p, end);
+                if (type.size() == 1)
+                    _storePrimitiveValue<int8_t>(data, i);
+                else if (type.size() == 2)
+                    _storePrimitiveValue<int16_t>(data, i);
+                else if (type.size() == 4)
+                    _storePrimitiveValue<int32_t>(data, i);
+                else if (type.size() == 8)
+                    _storePrimitiveValue<int64_t>(data, i);
+                else
+                    throw Exception("Decode Error: Unknown signed int type size");
+            } else {
+                const uint64_t i = _popVarUInt(p, end);
+                if (type.size() == 1)
+                    _storePrimitiveValue<uint8_t>(data, i);
+                else if (type.size() == 2)
+                    _storePrimitiveValue<uint16_t>(data, i);
+                else if (type.size() == 4)
+                    _storePrimitiveValue<uint32_t>(data, i);
+                else if (type.size() == 8)
+                    _storePrimitiveValue<uint64_t>(data, i);
+                else
+                    throw Exception("Decode Error: Unknown unsigned int type size");
+            }
+        } else if (type.isReal()) {
+            if (type.size() == sizeof(float)) {
+                const uint32_t bits = (uint32_t) _popFixed(p, end, 4);
+                float f;
+                memcpy(&f, &bits, sizeof(f));
+                _storePrimitiveValue<float>(data, f);
+            } else if (type.size() == sizeof(double)) {
+                const uint64_t bits = _popFixed(p, end, 8);
+                double d;
+                memcpy(&d, &bits, sizeof(d));
+                _storePrimitiveValue<double>(data, d);
+            } else
+                throw Exception("Decode Error: Unknown floating point type");
+        } else if (type.isBool()) {
+            _storePrimitiveValue<bool>(data, _popFixed(p, end, 1) != 0);
+        } else {
+            throw Exception("Decode Error: Unknown primitive type");
+        }
+    }
+
+    static Object _popObjectBinary(const char*& p, const char* end, const std::vector<String>& strings, const std::vector<DataType>& types) {
+        Object obj;
+        obj.m_type       = _popDataTypeRef(p, end, types);
+        obj.m_version    = (Version) _popVarUInt(p, end);
+        obj.m_minVersion = (Version) _popVarUInt(p, end);
+        const uint64_t nUIDs = _popVarUInt(p, end);
+        if (!nUIDs || nUIDs > uint64_t(end - p))
+            throw Exception("Decode Error: Invalid UID chain");
+        obj.m_uid.reserve(nUIDs);
+        for (uint64_t i = 0; i < nUIDs; ++i)
+            obj.m_uid.push_back(_popUIDBinary(p, end));
+        const uint64_t nMembers = _popVarUInt(p, end);
+        if (nMembers > uint64_t(end - p))
+            throw Exception("Decode Error: Invalid amount of members");
+        obj.m_members.reserve(nMembers);
+        for (uint64_t i = 0; i < nMembers; ++i)
+            obj.m_members.push_back(_popMemberBinary(p, end, strings, types));
+        _popPrimitiveValueBinary(p, end, obj.m_type, obj.m_data);
+        return obj;
+    }
+
+    /**
+     * Provides the parts of a binary encoded raw data stream, either from one
+     * contiguous block of memory, or read piece by piece from a
+     * decoding_source_t callback into an internal buffer which only grows as
+     * large as the largest part of the stream.
+     */
+    class _BinaryReader {
+    public:
+        _BinaryReader(const char* p, const char* end)
+            : m_source(NULL), m_pUserData(NULL), m_p(p), m_end(end) {}
+
+        _BinaryReader(decoding_source_t source, void* pUserData)
+            : m_source(source), m_pUserData(pUserData), m_p(NULL), m_end(NULL) {}
+
+        uint64_t popVarUInt() {
+            uint64_t value = 0;
+            for (int shift = 0; true; shift += 7) {
+                if (shift > 63)
+                    throw Exception("Decode Error: Binary integer too large");
+                const uint8_t c = *pop(1);
+                value |= uint64_t(c & 0x7f) << shift;
+                if (!(c & 0x80)) break;
+            }
+            return value;
+        }
+
+        // returns the next n bytes of the stream as one contiguous block
+        const char* pop(size_t n) {
+            if (size_t(m_end - m_p) < n) fill(n);
+            const char* p = m_p;
+            m_p += n;
+            return p;
+        }
+
+        // the next part of the stream, which is prefixed by its size
+        _Blob popPart() {
+            const uint64_t sz = popVarUInt();
+            const char* p = pop(size_t(sz));
+            const _Blob blob = { p, p + size_t(sz) };
+            return blob;
+        }
+
+        // moves all data already read from the source, but not popped yet
+        void popBuffered(RawData& data) {
+            data.insert(data.end(), m_p, m_end);
+            m_p = m_end;
+        }
+    private:
+        void fill(size_t n) {
+            if (!m_source)
+                throw Exception("Decode Error: Premature end of binary stream");
+            // move the data not popped yet to the front first, since m_p
+            // points into the buffer which might be reallocated below
+            const size_t remaining = m_end - m_p;
+            if (remaining) memmove(&m_buffer[0], m_p, remaining);
+            if (m_buffer.size() < n || m_buffer.size() < DECODING_SOURCE_BLOCK_SIZE)
+                m_buffer.resize(std::max(n, (size_t)DECODING_SOURCE_BLOCK_SIZE));
+            size_t size = remaining;
+            while (size < n) {
+                const size_t got = m_source((uint8_t*) &m_buffer[size], m_buffer.size() - size, m_pUserData);
+                if (!got)
+                    throw Exception("Decode Error: Premature end of binary stream");
+                size += got;
+            }
+            m_p   = &m_buffer[0];
+            m_end = m_p + size;
+        }
+
+        decoding_source_t m_source;
+        void* m_pUserData;
+        std::vector<char> m_buffer;
+        const char* m_p;
+        const char* m_end;
+    };
+
+    void Archive::_popRootBinary(_BinaryReader& reader) {
+        _Blob blob = reader.popPart();
+        const char* p   = blob.p;
+        const char* end = blob.end;
+
+        // just in case this encoding format will be extended in future
+        // (currently not used, so its value is just skipped)
+        _popVarUInt(p, end);
+
+        const uint64_t nStrings = _popVarUInt(p, end);
+        if (nStrings > uint64_t(end - p))
+            throw Exception("Decode Error: Invalid string table size");
+        std::vector<String> strings;
+        strings.reserve(nStrings);
+        for (uint64_t i = 0; i < nStrings; ++i)
+            strings.push_back(_popStringBinary(p, end));
+
+        const uint64_t nTypes = _popVarUInt(p, end);
+        if (nTypes > uint64_t(end - p))
+            throw Exception("Decode Error: Invalid type table size");
+        std::vector<DataType> types;
+        types.reserve(nTypes);
+        for (uint64_t i = 0; i < nTypes; ++i)
+            types.push_back(_popDataTypeBinary(p, end, strings));
+
+        const ID id = (ID) size_t(reader.popVarUInt());
+        const size_t size = (size_t) reader.popVarUInt();
+        const UID root = { id, size };
+        m_root = root;
+        if (!m_root)
+            throw Exception("Decode Error: No root object");
+
+        const uint64_t nObjects = reader.popVarUInt();
+        for (uint64_t i = 0; i < nObjects; ++i) {
+            blob = reader.popPart();
+            p   = blob.p;
+            end = blob.end;
+            const Object obj = _popObjectBinary(p, end, strings, types);
+            m_allObjects[obj.uid()] = obj;
+        }
+        if (!m_allObjects[m_root])
+            throw Exception("Decode Error: Missing declared root object");
+
+        blob = reader.popPart();
+        p   = blob.p;
+        end = blob.end;
+        m_name = _popStringBinary(p, end);
+        m_comment = _popStringBinary(p, end);
+        m_timeCreated = (time_t) _popVarInt(p, end);
+        m_timeModified = (time_t) _popVarInt(p, end);
+    }
+
+    void Archive::_decode(const uint8_t* data, size_t size) {
+        m_allObjects.clear();
+        m_isModified = false;
+        m_timeCreated = m_timeModified = LIBGIG_EPOCH_TIME;
+        if (!size)
+            throw Exception("Decode Error: Magic start missing!");
+        const char* p   = (const char*) data;
+        const char* end = p + size;
+        if (size >= strlen(MAGIC_START_BINARY) &&
+            !memcmp(p, MAGIC_START_BINARY, strlen(MAGIC_START_BINARY)))
+        {
+            m_encoding = ENCODING_BINARY;
+            p += strlen(MAGIC_START_BINARY);
+            _BinaryReader reader(p, end);
+            _popRootBinary(reader);
+            return;
+        }
+        if (memcmp(p, MAGIC_START, std::min(strlen(MAGIC_START), size)))
+            throw Exception("Decode Error: Magic start missing!");
+        m_encoding = ENCODING_TEXT;
+        p += strlen(MAGIC_START);
+        _popRootBlob(p, end);
+    }
+
     /** @brief Fill this archive with the given serialized raw data.
      *
      * Calling this method will decode the given raw @a data and constructs a
@@ -1619,15 +2175,9 @@ namespace Serialization {
      */
     void Archive::decode(const RawData& data) {
         m_rawData = data;
-        m_allObjects.clear();
-        m_isModified = false;
-        m_timeCreated = m_timeModified = LIBGIG_EPOCH_TIME;
-        const char* p   = (const char*) &data[0];
-        const char* end = p + data.size();
-        if (memcmp(p, MAGIC_START, std::min(strlen(MAGIC_START), data.size())))
-            throw Exception("Decode Error: Magic start missing!");
-        p += strlen(MAGIC_START);
-        _popRootBlob(p, end);
+        m_pExternalData = NULL;
+        m_externalDataSize = 0;
+        _decode(m_rawData.empty() ? NULL : &m_rawData[0], m_rawData.size());
     }
 
     /** @brief Fill this archive with the given serialized raw C-buffer data.
@@ -1651,10 +2201,276 @@ namespace Serialization {
      *         incompatible or corrupt data stream or format.
      */
     void Archive::decode(const uint8_t* data, size_t size) {
-        RawData rawData;
-        rawData.resize(size);
-        memcpy(&rawData[0], data, size);
-        decode(rawData);
+        m_rawData.assign(data, data + size);
+        m_pExternalData = NULL;
+        m_externalDataSize = 0;
+        _decode(m_rawData.empty() ? NULL : &m_rawData[0], m_rawData.size());
+    }
+
+    /** @brief Fill this archive with the given serialized raw data, without copying it.
+     *
+     * This method works like decode(), but it decodes the given raw @a data
+     * directly from the caller's buffer instead of copying the entire raw
+     * data stream into this Archive object first. This avoids duplicating a
+     * potentially large serialized data stream in memory, for example when
+     * decoding a memory mapped preset file.
+     *
+     * All content decoded by this method is completely owned by this Archive
+     * object. The only reason for this Archive object to access the caller's
+     * buffer after this method returned, is a subsequent call to rawData()
+     * while this archive has not been modified in the meantime; in that case
+     * the raw data stream is copied from the caller's buffer on that first
+     * rawData() call. So the caller must keep @a data valid and unaltered
+     * until either rawData() was called, the archive was modified, cleared,
+     * decoded again or destroyed.
+     *
+     * @param data - the previously serialized raw data stream to be decoded
+     * @param size - size of @a data in bytes
+     * @throws Exception if the provided raw @a data uses an invalid, unknown,
+     *         incompatible or corrupt data stream or format.
+     */
+    void Archive::decodeExternal(const uint8_t* data, size_t size) {
+        m_rawData.clear();
+        m_pExternalData = NULL;
+        m_externalDataSize = 0;
+        _decode(data, size);
+        m_pExternalData = data;
+        m_externalDataSize = size;
+    }
+
+    // states of objects while determining the delta of two archives
+    enum _delta_state_t {
+        DELTA_VISITING,
+        DELTA_UNCHANGED,
+        DELTA_CHANGED
+    };
+
+    static bool _hasMember(const Object& obj, const Member& member) {
+        const std::vector<Member>& members = obj.members();
+        for (size_t i = 0; i < members.size(); ++i)
+            if (members[i] == member) return true;
+        return false;
+    }
+
+    /**
+     * Returns @c true if the object with @a uid (which must just have been
+     * serialized from the native C++ objects) differs from the equivalent
+     * object in the @a previous archive. As a side effect all unchanged
+     * members are removed from class objects.
+     */
+    bool Archive::_isChangedObject(const UID& uid, const Archive& previous, std::map<UID,int>& states) {
+        std::map<UID,int>::const_iterator itState = states.find(uid);
+        if (itState != states.end())
+            return itState->second == DELTA_CHANGED; // i.e. cyclic relation
+        states[uid] = DELTA_VISITING;
+
+        Object& obj = m_allObjects[uid];
+        if (!obj) {
+            states[uid] = DELTA_UNCHANGED;
+            return false;
+        }
+        const DataType& type = obj.type();
+
+        ObjectPool::const_iterator itPrev = previous.m_allObjects.find(uid);
+        const Object* prev = (itPrev != previous.m_allObjects.end()) ? &itPrev->second : NULL;
+        bool changed = !prev || prev->type() != type ||
+                       prev->type().size() != type.size() ||
+                       prev->version() != obj.version() ||
+                       prev->minVersion() != obj.minVersion();
+
+        if (type.isPrimitive() && !type.isPointer()) {
+            if (!changed) {
+                const RawData& prevData = prev->rawData();
+                changed = prevData.size() != type.size() ||
+                          memcmp(obj.uid().id, &prevData[0], type.size());
+            }
+        } else if (type.isPointer()) {
+            if (!changed)
+                changed = prev->uidChain().size() < 2 ||
+                          prev->uid(1) != obj.uid(1);
+            if (obj.uidChain().size() >= 2 &&
+                _isChangedObject(obj.uid(1), previous, states))
+                changed = true;
+        } else {
+            std::vector<Member>& members = obj.members();
+            for (size_t i = 0; i < members.size(); ++i) {
+                const Member& member = members[i];
+                bool memberChanged = _isChangedObject(member.uid(), previous, states);
+
+                // also a member which has just been added is a change
+                if (!memberChanged)
+                    memberChanged = !prev || !_hasMember(*prev, member);
+                if (memberChanged) {
+                    changed = true;
+                } else {
+                    members.erase(members.begin() + i);
+                    --i;
+                }
+            }
+        }
+
+        states[uid] = changed ? DELTA_CHANGED : DELTA_UNCHANGED;
+        return changed;
+    }
+
+    /**
+     * Reduces the content of this archive (which must just have been serialized
+     * from native C++ objects) to those objects and members which changed
+     * compared to the @a previous archive. Called by serializeDelta().
+     */
+    void Archive::_removeUnchangedObjects(const Archive& previous) {
+        // objects of an archive just serialized do not store their values
+        // themselves, so decode the previous archive's raw data stream to get
+        // the previous values
+        Archive snapshot;
+        const Archive* pPrevious = &previous;
+        if (!previous.m_isModified) {
+            if (!previous.m_rawData.empty()) {
+                snapshot._decode(&previous.m_rawData[0], previous.m_rawData.size());
+                pPrevious = &snapshot;
+            } else if (previous.m_pExternalData) {
+                snapshot._decode(previous.m_pExternalData, previous.m_externalDataSize);
+                pPrevious = &snapshot;
+            }
+        }
+
+        std::map<UID,int> states;
+        _isChangedObject(m_root, *pPrevious, states);
+
+        // the root object must always be retained for the Syncer
+        states[m_root] = DELTA_CHANGED;
+        for (ObjectPool::iterator it = m_allObjects.begin(); it != m_allObjects.end(); ) {
+            std::map<UID,int>::const_iterator itState = states.find(it->first);
+            if (itState == states.end() || itState->second != DELTA_CHANGED)
+                m_allObjects.erase(it++);
+            else
+                ++it;
+        }
+    }
+
+    /**
+     * Applies the objects and members of the (decoded) @a delta archive to the
+     * objects of this archive, which must store their values themselves (i.e.
+     * a decoded archive). Objects not yet contained by this archive are
+     * added; of class objects only the members contained by @a delta are
+     * replaced or added, all other members are retained. Used by
+     * SnapshotHistory.
+     */
+    void Archive::_mergeDelta(const Archive& delta) {
+        if (!m_root.isValid()) m_root = delta.m_root;
+        for (ObjectPool::const_iterator it = delta.m_allObjects.begin();
+             it != delta.m_allObjects.end(); ++it)
+        {
+            const Object& src = it->second;
+            ObjectPool::iterator itDst = m_allObjects.find(it->first);
+            if (itDst == m_allObjects.end()) {
+                m_allObjects[it->first] = src;
+                continue;
+            }
+            Object& dst = itDst->second;
+            if (!src.type().isClass() || dst.type() != src.type()) {
+                dst = src;
+                continue;
+            }
+            dst.m_version    = src.m_version;
+            dst.m_minVersion = src.m_minVersion;
+            for (size_t i = 0; i < src.m_members.size(); ++i) {
+                const Member& member = src.m_members[i];
+                std::vector<Member>::iterator itMember = dst.m_members.begin();
+                for (; itMember != dst.m_members.end(); ++itMember)
+                    if (itMember->name() == member.name()) break;
+                if (itMember != dst.m_members.end())
+                    *itMember = member;
+                else
+                    dst.m_members.push_back(member);
+            }
+        }
+        m_rawData.clear();
+        m_pExternalData = NULL;
+        m_externalDataSize = 0;
+        m_isModified = true;
+    }
+
+    /** @brief Fill this archive with a serialized raw data stream read piece by piece.
+     *
+     * This method works like decode(), but instead of requiring the entire
+     * raw data stream in memory, it retrieves the raw data stream from the
+     * supplied @a source callback piece by piece. For ENCODING_BINARY streams
+     * only small parts of the stream are held in memory at a time while
+     * decoding, which allows i.e. to decode large archives directly from a
+     * file or socket. Streams in ENCODING_TEXT format are read entirely into
+     * memory first though, since that format has to be decoded as a whole.
+     *
+     * The raw data stream is not retained by this Archive, so a subsequent
+     * call to rawData() encodes the archive again.
+     *
+     * @param source - callback providing the raw data stream
+     * @param pUserData - arbitrary pointer passed to @a source
+     * @throws Exception if the provided raw data uses an invalid, unknown,
+     *         incompatible or corrupt data stream or format.
+     */
+    void Archive::decodeFrom(decoding_source_t source, void* pUserData) {
+        m_rawData.clear();
+        m_pExternalData = NULL;
+        m_externalDataSize = 0;
+        m_allObjects.clear();
+        m_isModified = false;
+        m_timeCreated = m_timeModified = LIBGIG_EPOCH_TIME;
+        _BinaryReader reader(source, pUserData);
+        const size_t magicSize = strlen(MAGIC_START_BINARY);
+        RawData magic;
+        try {
+            const char* p = reader.pop(magicSize);
+            magic.assign(p, p + magicSize);
+        } catch (const Exception& e) {
+            throw Exception("Decode Error: Magic start missing!");
+        }
+        if (!memcmp(&magic[0], MAGIC_START_BINARY, magicSize)) {
+            m_encoding = ENCODING_BINARY;
+            _popRootBinary(reader);
+            return;
+        }
+        // text format: read the entire stream and decode it as a whole
+        RawData data = magic;
+        reader.popBuffered(data);
+        for (size_t size = data.size(); true; size = data.size()) {
+            data.resize(size + DECODING_SOURCE_BLOCK_SIZE);
+            const size_t n = source(&data[size], DECODING_SOURCE_BLOCK_SIZE, pUserData);
+            data.resize(size + n);
+            if (!n) break;
+        }
+        _decode(&data[0], data.size());
+    }
+
+    /** @brief Encode this archive directly to a sink.
+     *
+     * Encodes the current content of this archive and hands out the resulting
+     * raw data stream to the supplied @a sink callback piece by piece. With
+     * ENCODING_BINARY the encoded stream is never entirely held in memory,
+     * but rather passed to the sink in blocks of about 64 kB, which allows
+     * i.e. to write large archives directly to a file, socket or RIFF chunk.
+     * With ENCODING_TEXT the stream is encoded in memory first, since that
+     * format requires the size of each value before the value itself.
+     *
+     * This method neither alters the raw data stream returned by rawData(),
+     * nor the "modified" state of this archive.
+     *
+     * @param sink - callback receiving the raw data stream
+     * @param pUserData - arbitrary pointer passed to @a sink
+     */
+    void Archive::encodeTo(encoding_sink_t sink, void* pUserData) {
+        if (m_encoding == ENCODING_BINARY) {
+            _updateTimeStamps();
+            String s = MAGIC_START_BINARY;
+            _encodeRootBinary(s, sink, pUserData);
+            return;
+        }
+        _updateTimeStamps();
+        String s = MAGIC_START;
+        s += _encodeRootBlob();
+        // including the terminating zero, like encode() does
+        s += '\0';
+        _flush(s, sink, pUserData);
     }
 
     /** @brief Raw data stream of this archive content.
@@ -1673,7 +2489,13 @@ namespace Serialization {
      * @see isModified()
      */
     const RawData& Archive::rawData() {
-        if (m_isModified) encode();
+        if (m_isModified || (m_rawData.empty() && !m_pExternalData && m_root)) {
+            encode();
+        } else if (m_pExternalData) {
+            m_rawData.assign(m_pExternalData, m_pExternalData + m_externalDataSize);
+            m_pExternalData = NULL;
+            m_externalDataSize = 0;
+        }
         return m_rawData;
     }
 
@@ -1683,7 +2505,40 @@ namespace Serialization {
      * serialized raw data streams.
      */
     String Archive::rawDataFormat() const {
-        return MAGIC_START;
+        return (m_encoding == ENCODING_BINARY) ? MAGIC_START_BINARY : MAGIC_START;
+    }
+
+    /** @brief Encoding format used by this archive.
+     *
+     * Returns the format this archive uses to encode its raw data stream. By
+     * default this is ENCODING_TEXT, after calling decode() it reflects the
+     * format of the decoded raw data stream.
+     *
+     * @see setEncoding()
+     */
+    encoding_t Archive::encoding() const {
+        return m_encoding;
+    }
+
+    /** @brief Select the encoding format for the raw data stream.
+     *
+     * Defines the format this archive shall use when its content is encoded
+     * as raw data stream, i.e. by serialize() or rawData(). Use
+     * ENCODING_BINARY for a significantly more compact and faster raw data
+     * stream, as long as the receiving side is using a version of this
+     * framework which already supports that format. Decoding always detects
+     * the format automatically, so this setting is irrelevant for decoding.
+     *
+     * If the archive is not empty and the encoding format was changed, the
+     * "modified" state of this archive will be set to @c true, so that the
+     * next call to rawData() yields the raw data stream in the new format.
+     *
+     * @param encoding - encoding format to be used from now on
+     */
+    void Archive::setEncoding(encoding_t encoding) {
+        if (m_encoding == encoding) return;
+        m_encoding = encoding;
+        if (m_root) m_isModified = true;
     }
 
     /** @brief Whether this archive was modified.
@@ -1714,6 +2569,8 @@ namespace Serialization {
         m_operation = OPERATION_NONE;
         m_root = NO_UID;
         m_rawData.clear();
+        m_pExternalData = NULL;
+        m_externalDataSize = 0;
         m_isModified = false;
         m_timeCreated = m_timeModified = LIBGIG_EPOCH_TIME;
     }
@@ -2202,8 +3059,8 @@ namespace Serialization {
     Archive::Syncer::Syncer(Archive& dst, Archive& src)
        : m_dst(dst), m_src(src)
     {
-        const Object srcRootObj = src.rootObject();
-        const Object dstRootObj = dst.rootObject();
+        const Object& srcRootObj = objectOf(src, src.m_root);
+        const Object& dstRootObj = objectOf(dst, dst.m_root);
         if (!srcRootObj)
             throw Exception("No source root object!");
         if (!dstRootObj)
@@ -2220,13 +3077,16 @@ namespace Serialization {
     void Archive::Syncer::syncPointer(const Object& dstObj, const Object& srcObj) {
         assert(dstObj.type().isPointer());
         assert(dstObj.type() == srcObj.type());
-        const Object& pointedDstObject = m_dst.m_allObjects[dstObj.uid(1)];
-        const Object& pointedSrcObject = m_src.m_allObjects[srcObj.uid(1)];
+        const Object& pointedDstObject = objectOf(m_dst, dstObj.uid(1));
+        const Object& pointedSrcObject = objectOf(m_src, srcObj.uid(1));
         syncObject(pointedDstObject, pointedSrcObject);
     }
 
     void Archive::Syncer::syncObject(const Object& dstObj, const Object& srcObj) {
         if (!dstObj || !srcObj) return; // end of recursion
+        // prevent syncing this object again, and thus also prevent endless
+        // loop on data structures with cyclic relations
+        if (!m_synced.insert(dstObj.uid()).second) return;
         if (!dstObj.isVersionCompatibleTo(srcObj))
             throw Exception("Version incompatible (destination version " +
                             ToString(dstObj.version()) + " [min. version " +
@@ -2238,10 +3098,6 @@ namespace Serialization {
                             dstObj.type().asLongDescr() + " vs. source type " +
                             srcObj.type().asLongDescr() + ")");
 
-        // prevent syncing this object again, and thus also prevent endless
-        // loop on data structures with cyclic relations
-        m_dst.m_allObjects.erase(dstObj.uid());
-
         if (dstObj.type().isPrimitive() && !dstObj.type().isPointer()) {
             syncPrimitive(dstObj, srcObj);
             return; // end of recursion
@@ -2255,14 +3111,24 @@ namespace Serialization {
         assert(dstObj.type().isClass());
         for (int iMember = 0; iMember < srcObj.members().size(); ++iMember) {
             const Member& srcMember = srcObj.members()[iMember];
-            Member dstMember = dstMemberMatching(dstObj, srcObj, srcMember);
+            Member dstMember = dstMemberMatching(dstObj, srcObj, srcMember, iMember);
             if (!dstMember)
                 throw Exception("Expected member missing in destination object");
             syncMember(dstMember, srcMember);
         }
     }
 
-    Member Archive::Syncer::dstMemberMatching(const Object& dstObj, const Object& srcObj, const Member& srcMember) {
+    Member Archive::Syncer::dstMemberMatching(const Object& dstObj, const Object& srcObj, const Member& srcMember, int srcMemberIndex) {
+        // usually both sides serialized their members in the same sequence,
+        // so first try the member at the same position before searching
+        const std::vector<Member>& dstMembers = dstObj.members();
+        if (srcMemberIndex < (int) dstMembers.size() &&
+
+            dstMembers[srcMemberIndex].name() == srcMember.name())
+        {
+            const Member& dstMember = dstMembers[srcMemberIndex];
+            return (dstMember.type() == srcMember.type()) ? dstMember : Member();
+        }
         Member dstMember = dstObj.memberNamed(srcMember.name());
         if (dstMember)
             return (dstMember.type() == srcMember.type()) ? dstMember : Member();
@@ -2287,11 +3153,153 @@ namespace Serialization {
     void Archive::Syncer::syncMember(const Member& dstMember, const Member& srcMember) {
         assert(dstMember && srcMember);
         assert(dstMember.type() == srcMember.type());
-        const Object dstObj = m_dst.m_allObjects[dstMember.uid()];
-        const Object srcObj = m_src.m_allObjects[srcMember.uid()];
+        const Object& dstObj = objectOf(m_dst, dstMember.uid());
+        const Object& srcObj = objectOf(m_src, srcMember.uid());
         syncObject(dstObj, srcObj);
     }
 
+    // Unlike ObjectPool::operator[] this never adds an entry to the pool, and
+    // thus references returned by this method remain valid while syncing.
+    const Object& Archive::Syncer::objectOf(const Archive& archive, const UID& uid) {
+        static const Object invalid;
+        ObjectPool::const_iterator it = archive.m_allObjects.find(uid);
+        return (it != archive.m_allObjects.end()) ? it->second : invalid;
+    }
+
+    // *************** SnapshotHistory ***************
+    // *
+
+    /** @brief Create an empty snapshot history.
+     *
+     * Call capture() to add the first snapshot.
+     */
+    SnapshotHistory::SnapshotHistory() : m_position(0) {
+    }
+
+    SnapshotHistory::~SnapshotHistory() {
+    }
+
+    /** @brief Amount of snapshots.
+     *
+     * Returns the amount of snapshots currently stored with this history.
+     */
+    size_t SnapshotHistory::size() const {
+        return m_steps.size();
+    }
+
+    /** @brief Index of the current snapshot.
+     *
+     * Returns the index of the snapshot which was captured or restored last,
+     * i.e. the state the native C++ objects are currently expected to be in.
+     * Only meaningful if size() is not zero.
+     */
+    size_t SnapshotHistory::position() const {
+        return m_position;
+    }
+
+    /** @brief Size of all stored changes.
+     *
+     * Returns the total size (in bytes) of the encoded changes stored for all
+     * snapshots, that is excluding the entire state of the objects, which is
+     * held only once by this history.
+     */
+    size_t SnapshotHistory::rawDataSize() const {
+        size_t size = 0;
+        for (size_t i = 0; i < m_steps.size(); ++i)
+            size += m_steps[i].redo.size() + m_steps[i].undo.size();
+        return size;
+    }
+
+    /** @brief Remove all snapshots.
+     *
+     * Clears this history entirely, so that the next capture() call adds the
+     * first snapshot again (which also may be of another root object then).
+     */
+    void SnapshotHistory::clear() {
+        m_steps.clear();
+        m_position = 0;
+        m_state.clear();
+    }
+
+    size_t SnapshotHistory::_append(Archive& reflection) {
+        if (m_steps.empty()) {
+            // the first snapshot stores the entire state of the objects
+            reflection.setEncoding(ENCODING_BINARY);
+            reflection.encode();
+            m_state.decode(reflection.m_rawData);
+            m_state.m_rawData.clear();
+            m_state.m_isModified = true;
+            m_steps.push_back(Step());
+            m_position = 0;
+            return 0;
+        }
+        if (reflection.m_root != m_state.m_root)
+            throw Exception("Snapshot of different root object");
+        m_steps.resize(m_position + 1);
+
+        reflection._removeUnchangedObjects(m_state);
+
+        // old values of the changed objects and members, from the entire
+        // state of the previous snapshot
+        Archive undo;
+        undo.setEncoding(ENCODING_BINARY);
+        undo.m_root = reflection.m_root;
+        for (Archive::ObjectPool::const_iterator it = reflection.m_allObjects.begin();
+             it != reflection.m_allObjects.end(); ++it)
+        {
+            Archive::ObjectPool::const_iterator itOld = m_state.m_allObjects.find(it->first);
+            if (itOld == m_state.m_allObjects.end()) continue; // new object
+            Object old = itOld->second;
+            if (old.type().isClass()) {
+                std::vector<Member>& members = old.members();
+                for (size_t i = 0; i < members.size(); ) {
+                    if (it->second.memberNamed(members[i].name()))
+                        ++i;
+                    else
+                        members.erase(members.begin() + i);
+                }
+            }
+            undo.m_allObjects[it->first] = old;
+        }
+        undo.encode();
+
+        reflection.setEncoding(ENCODING_BINARY);
+        reflection.encode();
+        Step step;
+        step.redo = reflection.m_rawData;
+        step.undo = undo.m_rawData;
+        m_steps.push_back(step);
+        m_position = m_steps.size() - 1;
+
+        Archive redo(step.redo);
+        m_state._mergeDelta(redo);
+        return m_position;
+    }
+
+    bool SnapshotHistory::_collectChanges(size_t index, Archive& changes) const {
+        if (index >= m_steps.size())
+            throw Exception("Snapshot index out of bounds");
+        if (index == m_position) return false;
+        // later changes override earlier ones
+        if (index < m_position) {
+            for (size_t i = m_position; i > index; --i) {
+                Archive undo(m_steps[i].undo);
+                changes._mergeDelta(undo);
+            }
+        } else {
+            for (size_t i = m_position + 1; i <= index; ++i) {
+                Archive redo(m_steps[i].redo);
+                changes._mergeDelta(redo);
+            }
+        }
+        return true;
+    }
+
+    void SnapshotHistory::_commit(size_t index, const Archive& changes) {
+        m_state._mergeDelta(changes);
+        m_position = index;
+    }
+
     // *************** Exception ***************
     // *
 
@@ -34,6 +34,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <time.h>
 #include <stdarg.h>
 
@@ -114,6 +115,7 @@ namespace Serialization {
     class Object;
     class Member;
     class Archive;
+    class SnapshotHistory;
     class ObjectPool;
     class Exception;
 
@@ -160,6 +162,42 @@ namespace Serialization {
         UTC_TIME ///< The time stamp relates to "Greenwhich Mean Time" zone, also known as "Coordinated Universal Time". Request time stamp with UTC if you want to compare that time stamp with other time stamps.
     };
 
+    /** @brief Encoding format of serialized raw data streams.
+     *
+     * The constants in this enum type are used to define which format an
+     * Archive uses when encoding its content as raw data stream. Decoding
+     * always automatically detects the format of the supplied data stream.
+     *
+     * @see Archive::setEncoding()
+     */
+    enum encoding_t {
+        ENCODING_TEXT, ///< Human readable, text based encoding with decimal length prefixed values. This is the default format, which is also understood by all older versions of this framework.
+        ENCODING_BINARY ///< Compact binary encoding with variable length integers, raw IEEE floating point values and interned type and member names. Considerably smaller and faster to encode and decode than ENCODING_TEXT, but not understood by older versions of this framework.
+    };
+
+    /** @brief Receiver of an encoded raw data stream.
+     *
+     * Callback function type used by Archive::encodeTo() to hand out the
+     * encoded raw data stream piece by piece.
+     *
+     * @param data - next piece of the raw data stream
+     * @param size - size of @a data in bytes
+     * @param pUserData - arbitrary pointer passed to Archive::encodeTo()
+     */
+    typedef void (*encoding_sink_t)(const uint8_t* data, size_t size, void* pUserData);
+
+    /** @brief Provider of an encoded raw data stream.
+     *
+     * Callback function type used by Archive::decodeFrom() to retrieve the
+     * raw data stream to be decoded piece by piece.
+     *
+     * @param buffer - destination buffer for the next piece of the stream
+     * @param size - size of @a buffer in bytes
+     * @param pUserData - arbitrary pointer passed to Archive::decodeFrom()
+     * @returns amount of bytes written to @a buffer, 0 on end of stream
+     */
+    typedef size_t (*decoding_source_t)(uint8_t* buffer, size_t size, void* pUserData);
+
     /** @brief Check whether data is a C/C++ @c enum type.
      *
      * Returns true if the supplied C++ variable or object is of a C/C++ @c enum
@@ -331,6 +369,10 @@ namespace Serialization {
     static Object _popObjectBlob(const char*& p, const char* end);
     static void _popPrimitiveValue(const char*& p, const char* end, Object& obj);
     static String _primitiveObjectValueToString(const Object& obj);
+    static DataType _popDataTypeBinary(const char*& p, const char* end, const std::vector<String>& strings);
+    static Member _popMemberBinary(const char*& p, const char* end, const std::vector<String>& strings, const std::vector<DataType>& types);
+    static Object _popObjectBinary(const char*& p, const char* end, const std::vector<String>& strings, const std::vector<DataType>& types);
+    class _BinaryReader;
     //  |
     template<typename T>
     static T _primitiveObjectValueToNumber(const Object& obj);
@@ -459,6 +501,7 @@ namespace Serialization {
 
 #if LIBGIG_SERIALIZATION_INTERNAL
         friend DataType _popDataTypeBlob(const char*& p, const char* end);
+        friend DataType _popDataTypeBinary(const char*& p, const char* end, const std::vector<String>& strings);
 #endif
         friend class Archive;
     };
@@ -511,6 +554,7 @@ namespace Serialization {
 
 #if LIBGIG_SERIALIZATION_INTERNAL
         friend Member _popMemberBlob(const char*& p, const char* end);
+        friend Member _popMemberBinary(const char*& p, const char* end, const std::vector<String>& strings, const std::vector<DataType>& types);
 #endif
     };
 
@@ -582,6 +626,7 @@ namespace Serialization {
         friend Object _popObjectBlob(const char*& p, const char* end);
         friend void _popPrimitiveValue(const char*& p, const char* end, Object& obj);
         friend String _primitiveObjectValueToString(const Object& obj);
+        friend Object _popObjectBinary(const char*& p, const char* end, const std::vector<String>& strings, const std::vector<DataType>& types);
         // |
         template<typename T>
         friend T _primitiveObjectValueToNumber(const Object& obj);
@@ -750,6 +795,83 @@ namespace Serialization {
             m_operation = OPERATION_NONE;
         }
 
+        /** @brief Initiate delta serialization.
+         *
+         * Works like serialize(), but only stores those objects and members
+         * with this Archive which changed since the @a previous Archive was
+         * serialized from the same native C++ objects. So the resulting raw
+         * data stream is usually much smaller than a full archive, which is
+         * useful for i.e. synchronizing the state of objects between two
+         * machines at a high rate:
+         * @code
+         * Archive last;
+         * last << myRootObject;
+         * send(last.rawData()); // initial full state
+         * ...
+         * // after some member(s) of myRootObject changed
+         * Archive delta;
+         * delta.serializeDelta(&myRootObject, last);
+         * send(delta.rawData());
+         * last << myRootObject;
+         * @endcode
+         * The receiver side simply applies such a delta archive by calling
+         * deserialize() as usual, which only modifies the native members
+         * contained in the delta archive and leaves all other ones untouched.
+         *
+         * For comparison the values stored with the raw data stream of
+         * @a previous are used. So @a previous must either have been
+         * serialized or decoded before, and it must not have been modified
+         * afterwards (objects which do not have a stored value anymore are
+         * always considered to be changed).
+         *
+         * Note that the previous content of this Archive will first be
+         * cleared.
+         *
+         * @param obj - native C++ root object where serialization shall start
+         * @param previous - archive with the previous state of the same native
+         *                   C++ objects
+         * @see serialize() for more details.
+         */
+        template<typename T>
+        void serializeDelta(const T* obj, const Archive& previous) {
+            m_operation = OPERATION_SERIALIZE;
+            m_allObjects.clear();
+            m_rawData.clear();
+            m_root = UID::from(obj);
+            const_cast<T*>(obj)->serialize(this);
+            _removeUnchangedObjects(previous);
+            encode();
+            m_operation = OPERATION_NONE;
+        }
+
+        /** @brief Initiate serialization directly to a sink.
+         *
+         * Works like serialize(), but instead of encoding the resulting raw
+         * data stream as one contiguous block of memory, the raw data stream
+         * is handed out to the supplied @a sink piece by piece. Use this for
+         * writing large archives i.e. directly to a file or socket, without
+         * having the entire raw data stream in memory.
+         *
+         * Note that the raw data stream is not retained by this Archive. So a
+         * subsequent call to rawData() would encode the archive again, like it
+         * does after the archive was modified.
+         *
+         * @param obj - native C++ root object where serialization shall start
+         * @param sink - callback receiving the raw data stream
+         * @param pUserData - arbitrary pointer passed to @a sink
+         * @see encodeTo() for more details.
+         */
+        template<typename T>
+        void serialize(const T* obj, encoding_sink_t sink, void* pUserData = NULL) {
+            m_operation = OPERATION_SERIALIZE;
+            m_allObjects.clear();
+            m_rawData.clear();
+            m_root = UID::from(obj);
+            const_cast<T*>(obj)->serialize(this);
+            encodeTo(sink, pUserData);
+            m_operation = OPERATION_NONE;
+        }
+
         /** @brief Initiate deserialization.
          *
          * Initiates deserialization of all native C++ objects, which means all
@@ -827,7 +949,10 @@ namespace Serialization {
         }
 
         const RawData& rawData();
+        void encodeTo(encoding_sink_t sink, void* pUserData = NULL);
         virtual String rawDataFormat() const;
+        encoding_t encoding() const;
+        void setEncoding(encoding_t encoding);
 
         /** @brief Serialize a native C/C++ member variable.
          *
@@ -1026,6 +1151,8 @@ namespace Serialization {
 
         virtual void decode(const RawData& data);
         virtual void decode(const uint8_t* data, size_t size);
+        void decodeExternal(const uint8_t* data, size_t size);
+        void decodeFrom(decoding_source_t source, void* pUserData = NULL);
         void clear();
         bool isModified() const;
         void removeMember(Object& parent, const Member& member);
@@ -1139,6 +1266,26 @@ namespace Serialization {
         String _encodeRootBlob();
         void _popRootBlob(const char*& p, const char* end);
         void _popObjectsBlob(const char*& p, const char* end);
+        void _decode(const uint8_t* data, size_t size);
+        void _removeUnchangedObjects(const Archive& previous);
+        bool _isChangedObject(const UID& uid, const Archive& previous, std::map<UID,int>& states);
+        void _mergeDelta(const Archive& delta);
+
+        // reflect the native C++ objects without encoding them
+        template<typename T>
+        void _reflect(const T* obj) {
+            m_operation = OPERATION_SERIALIZE;
+            m_allObjects.clear();
+            m_rawData.clear();
+            m_root = UID::from(obj);
+            const_cast<T*>(obj)->serialize(this);
+            m_operation = OPERATION_NONE;
+        }
+        void _encodeRootBinary(String& s, encoding_sink_t sink, void* pUserData);
+        void _updateTimeStamps();
+#if LIBGIG_SERIALIZATION_INTERNAL
+        void _popRootBinary(_BinaryReader& reader);
+#endif
 
     protected:
         class Syncer {
@@ -1149,10 +1296,12 @@ namespace Serialization {
             void syncPrimitive(const Object& dst, const Object& src);
             void syncPointer(const Object& dst, const Object& src);
             void syncMember(const Member& dstMember, const Member& srcMember);
-            static Member dstMemberMatching(const Object& dstObj, const Object& srcObj, const Member& srcMember);
+            static Member dstMemberMatching(const Object& dstObj, const Object& srcObj, const Member& srcMember, int srcMemberIndex);
+            static const Object& objectOf(const Archive& archive, const UID& uid);
         private:
             Archive& m_dst;
             Archive& m_src;
+            std::set<UID> m_synced; ///< Destination objects already synced.
         };
 
         enum operation_t {
@@ -1167,11 +1316,112 @@ namespace Serialization {
         operation_t m_operation;
         UID m_root;
         RawData m_rawData;
+        const uint8_t* m_pExternalData; ///< Caller's raw data stream passed to decodeExternal(), only valid as long as m_rawData was not assigned yet.
+        size_t m_externalDataSize;
         bool m_isModified;
         String m_name;
         String m_comment;
         time_t m_timeCreated;
         time_t m_timeModified;
+        encoding_t m_encoding;
+
+        friend class SnapshotHistory;
+    };
+
+    /** @brief Sequence of snapshots of native C++ objects, i.e. for undo.
+     *
+     * Captures the state of the same native C++ objects over and over again,
+     * for instance after each editing step of an instrument editor, and
+     * allows to restore any one of those snapshots later on (undo and redo).
+     *
+     * In contrast to serializing a new Archive for each step, the snapshots
+     * share their structure: the full state of the objects is stored only
+     * once, and each further snapshot just stores those members which
+     * changed compared to the previous snapshot (once with their new and
+     * once with their old values). So the memory required for each snapshot
+     * depends on the size of the edit, not on the size of the objects, and
+     * restoring a snapshot only assigns the members which actually differ.
+     * @code
+     * SnapshotHistory history;
+     * history.capture(&myRootObject);
+     * ...
+     * // after each editing step
+     * history.capture(&myRootObject);
+     * ...
+     * // undo
+     * history.restore(&myRootObject, history.position() - 1);
+     * @endcode
+     * Like deserialize(), restore() only assigns the values of the serialized
+     * members, it neither allocates nor frees native C++ objects. Changes of
+     * the native objects made after the last capture() or restore() call are
+     * not known to the history, so capture() them before restoring another
+     * snapshot.
+     */
+    class SnapshotHistory {
+    public:
+        SnapshotHistory();
+        virtual ~SnapshotHistory();
+
+        /** @brief Add a snapshot of the current state.
+         *
+         * Captures the current state of the native C++ objects as new
+         * snapshot following the current position(), which becomes the new
+         * current position. All snapshots after the current position (i.e.
+         * undone ones) are discarded first. Detecting the changed members
+         * still traverses all objects, but only the changed ones are stored.
+         *
+         * @param obj - native C++ root object, must always be the same one
+         * @returns index of the new snapshot
+         * @throws Exception if @a obj is not the root object of the previous
+         *         snapshots
+         */
+        template<typename T>
+        size_t capture(const T* obj) {
+            Archive reflection;
+            reflection._reflect(obj);
+            return _append(reflection);
+        }
+
+        /** @brief Restore the native C++ objects to a snapshot.
+         *
+         * Restores the state of snapshot @a index by applying the changes
+         * between the current position() and that snapshot, which then
+         * becomes the new current position. The native objects must still
+         * be in the state of the current position.
+         *
+         * @param obj - native C++ root object passed to capture() before
+         * @param index - index of the snapshot to restore
+         * @throws Exception if @a index is out of bounds or the native objects
+         *         are incompatible with the snapshot
+         */
+        template<typename T>
+        void restore(T* obj, size_t index) {
+            Archive changes;
+            if (!_collectChanges(index, changes)) return;
+            Archive reflection;
+            reflection._reflect(obj);
+            Archive::Syncer s(reflection, changes);
+            _commit(index, changes);
+        }
+
+        size_t size() const;
+        size_t position() const;
+        size_t rawDataSize() const;
+        void clear();
+
+    protected:
+        struct Step {
+            RawData redo; ///< Changed members with their values of this snapshot.
+            RawData undo; ///< Same members with their values of the previous snapshot.
+        };
+
+        size_t _append(Archive& reflection);
+        bool _collectChanges(size_t index, Archive& changes) const;
+        void _commit(size_t index, const Archive& changes);
+
+        std::vector<Step> m_steps;
+        size_t m_position;
+        Archive m_state; ///< Entire state of the objects at m_position (with stored values).
     };
 
     /**
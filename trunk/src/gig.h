@@ -26,6 +26,7 @@
 
 #include "DLS.h"
 #include <vector>
+#include <set>
 
 #ifndef __has_feature
 # define __has_feature(x) 0
@@ -62,6 +63,9 @@
 # define CHUNK_ID_LSNM  0x4c534e4d // own gig format extension
 # define CHUNK_ID_SCSL  0x5343534c // own gig format extension
 # define CHUNK_ID_LSDE  0x4c534445 // own gig format extension
+# define CHUNK_ID_LSBC  0x4c534243 // own gig format extension
+# define CHUNK_ID_LSFT  0x4c534654 // own gig format extension
+# define CHUNK_ID_LSBK  0x4c53424b // own gig format extension
 #else  // little endian
 # define LIST_TYPE_3PRG	0x67727033
 # define LIST_TYPE_3EWL	0x6C776533
@@ -81,12 +85,26 @@
 # define CHUNK_ID_LSNM  0x4d4e534c // own gig format extension
 # define CHUNK_ID_SCSL  0x4c534353 // own gig format extension
 # define CHUNK_ID_LSDE  0x4544534c // own gig format extension
+# define CHUNK_ID_LSBC  0x4342534c // own gig format extension
+# define CHUNK_ID_LSFT  0x5446534c // own gig format extension
+# define CHUNK_ID_LSBK  0x4b42534c // own gig format extension
 #endif // WORDS_BIGENDIAN
 
 #ifndef GIG_DECLARE_ENUM
 # define GIG_DECLARE_ENUM(type, ...) enum type { __VA_ARGS__ }
 #endif
 
+// size of a CPU cache line, see gig::playback_params_t
+#define GIG_CACHE_LINE_SIZE 64
+
+#if defined(__GNUC__)
+# define GIG_CACHE_LINE_ALIGNED __attribute__((aligned(GIG_CACHE_LINE_SIZE)))
+#elif defined(_MSC_VER)
+# define GIG_CACHE_LINE_ALIGNED __declspec(align(GIG_CACHE_LINE_SIZE))
+#else
+# define GIG_CACHE_LINE_ALIGNED
+#endif
+
 // just symbol prototyping (since Serialization.h not included by default here)
 namespace Serialization { class Archive; }
 
@@ -108,10 +126,12 @@ namespace gig {
         void*         pStart;            ///< Points to the beginning of the buffer.
         file_offset_t Size;              ///< Size of the actual data in the buffer in bytes.
         file_offset_t NullExtensionSize; ///< The buffer might be bigger than the actual data, if that's the case that unused space at the end of the buffer is filled with NULLs and NullExtensionSize reflects that unused buffer space in bytes. Those NULL extensions are mandatory for differential algorithms that have to take the following data words into account, thus have to access past the buffer's boundary. If you don't know what I'm talking about, just forget this variable. :)
+        void*         pNullExtension;    ///< Usually NULL, which means the NULL extension (if any) directly follows the actual data. If not NULL, @a pStart points directly into a memory-mapped file (zero-copy, read-only) and the NullExtensionSize bytes of silence are located in this separate buffer instead (see Sample::LoadSampleDataWithNullSamplesExtension()).
         buffer_t() {
             pStart            = NULL;
             Size              = 0;
             NullExtensionSize = 0;
+            pNullExtension    = NULL;
         }
     };
 
@@ -440,10 +460,331 @@ namespace gig {
     class File;
     class Instrument;
     class Sample;
+    class SampleReader;
+    class StereoPairReader;
+    class SampleCache;
+    class StreamEngine;
     class Region;
+    class DimensionRegion;
     class Group;
     class Script;
     class ScriptGroup;
+    class InstrumentSnapshot;
+    struct dimension_lookup_t;
+    struct snapshot_header_t;
+    struct sample_cache_t;
+    struct sample_read_queue_t;
+    struct stream_engine_t;
+    struct file_loader_t;
+    struct shared_sample_buffer_t;
+    struct sample_buffer_block_t;
+    struct preload_needs_t;
+
+    /** @brief Callback for checksum mismatches detected while streaming (see Sample::SetStreamVerification()).
+     *
+     * @param pSample        - sample whose streamed wave data does not match its stored checksum
+     * @param ActualChecksum - CRC-32 checksum actually calculated from the streamed wave data
+     * @param pUserData      - custom pointer passed to Sample::SetStreamVerification()
+     */
+    typedef void (*stream_verify_callback_t)(Sample* pSample, uint32_t ActualChecksum, void* pUserData);
+
+    /** @brief Source of new samples' wave data (see File::SaveSequential()).
+     *
+     * Called repeatedly for each new sample (in wave pool order) while the
+     * file is written. The function should copy the next (up to)
+     * @a FrameCount sample frames of @a pSample to @a pBuffer, in the same
+     * format as accepted by Sample::Write(), and return the amount of
+     * frames copied. Returning 0 causes the rest of the sample to be
+     * filled with silence.
+     *
+     * @param pSample    - sample whose wave data is requested
+     * @param pBuffer    - destination buffer
+     * @param FrameCount - max. amount of sample frames to copy
+     * @param pUserData  - custom pointer passed to File::SaveSequential()
+     */
+    typedef file_offset_t (*sample_source_t)(Sample* pSample, void* pBuffer, file_offset_t FrameCount, void* pUserData);
+
+    /** @brief Description of a new sample added by File::ImportSamples().
+     *
+     * The wave data of the sample is either given entirely by @a pData, or
+     * requested piece by piece from @a Source (if @a pData is NULL).
+     */
+    struct sample_import_t {
+        String          Name;        ///< Name of the new sample.
+        uint16_t        Channels;    ///< Number of audio channels (1: mono, 2: stereo).
+        uint16_t        BitDepth;    ///< Size of each sample point in bits (16 or 24).
+        uint32_t        SampleRate;  ///< Sample rate in Hz.
+        file_offset_t   SampleCount; ///< Length of the wave data in sample frames.
+        void*           pData;       ///< All @a SampleCount frames in the same format as accepted by Sample::Write(), or NULL for using @a Source instead.
+        sample_source_t Source;      ///< Source of the wave data if @a pData is NULL (only called by the thread calling File::ImportSamples()).
+        void*           pUserData;   ///< Custom pointer passed to @a Source.
+
+        sample_import_t();
+    };
+
+    /** @brief Result of the real-time safe read methods (see Sample::ReadRT() and SampleReader::ReadRT()). */
+    enum read_result_t {
+        read_ok = 0,                 ///< Sample points were read successfully (possibly less than requested if the end of the sample was reached).
+        read_error_not_scanned,      ///< The compressed sample was not scanned yet (see File::SetLazySampleScan() and File::ScanSamples()).
+        read_error_no_buffer,        ///< The compressed sample requires a decompression buffer, but none was given.
+        read_error_buffer_too_small, ///< The decompression buffer is too small for the requested amount of sample points (see Sample::GetDecompressionBufferSize()).
+        read_error_corrupt           ///< The compressed sample data is damaged (unknown compression mode).
+    };
+
+    /** @brief One read of a batch of reads (see Sample::ReadAndLoopBatch()). */
+    struct batch_read_t {
+        // input
+        Sample*           pSample;        ///< Sample to be read.
+        void*             pBuffer;        ///< Destination buffer (like with Sample::Read()).
+        file_offset_t     SampleCount;    ///< Amount of sample points to be read.
+        playback_state_t* pPlaybackState; ///< Optional: if not NULL, the sample is read like with Sample::ReadAndLoop() using this playback state and the loop information of @c pDimRgn, otherwise like with Sample::Read() from the sample's current position.
+        DimensionRegion*  pDimRgn;        ///< Loop information, only used if @c pPlaybackState is not NULL.
+        // output
+        file_offset_t     Result;         ///< Amount of sample points actually read.
+
+        batch_read_t() : pSample(NULL), pBuffer(NULL), SampleCount(0), pPlaybackState(NULL),
+                         pDimRgn(NULL), Result(0) {}
+    };
+
+    /** @brief Content analysis of a sample's wave data (see Sample::Analyze()). */
+    struct sample_analysis_t {
+        bool               Valid;             ///< Whether the sample was analyzed. All other members are undefined otherwise.
+        float              SilenceThreshold;  ///< Level (relative to full scale) up to which a sample point was considered to be silence.
+        file_offset_t      ContentStart;      ///< First sample point exceeding the silence threshold on any channel (SamplesTotal if the sample is silent throughout).
+        file_offset_t      ContentEnd;        ///< Sample point after the last one exceeding the silence threshold on any channel (0 if the sample is silent throughout).
+        file_offset_t      ZeroCrossingStart; ///< Last zero crossing (of the sum of all channels) at or before ContentStart, i.e. a click free start position for skipping the silent head.
+        float              Peak;              ///< Absolute peak level of all channels, relative to full scale (0.0 .. 1.0).
+        uint32_t           EnvelopeBlockSize; ///< Amount of sample points covered by each entry of @a RMSEnvelope.
+        std::vector<float> RMSEnvelope;       ///< RMS level of all channels (relative to full scale) of each consecutive block of EnvelopeBlockSize sample points.
+
+        sample_analysis_t() : Valid(false), SilenceThreshold(0), ContentStart(0), ContentEnd(0),
+                              ZeroCrossingStart(0), Peak(0), EnvelopeBlockSize(0) {}
+    };
+
+    /** @brief Range of sample data within a file (see Instrument::GetPreloadPlan()). */
+    struct preload_range_t {
+        Sample*       pSample; ///< Sample the data belongs to (NULL for runs of coalesced ranges of several samples).
+        RIFF::File*   pFile;   ///< (Extension) file the data is stored in.
+        file_offset_t Offset;  ///< Absolute position (in bytes) of the data within @a pFile.
+        file_offset_t Size;    ///< Size (in bytes) of the data.
+        file_offset_t SampleCount; ///< Amount of sample points of @a pSample to be preloaded (0 means the whole sample), unused for runs.
+    };
+
+    /** @brief Rules for sizing the preloaded part of each sample individually (see Instrument::GetPreloadPlan() and File::GetPreloadPlan()).
+     *
+     * The amount to be preloaded of a sample is derived from all dimension
+     * regions using it: the preload always covers the furthest sample start
+     * offset plus @a SampleCount sample points, short samples and samples
+     * only played on key release are loaded completely, and loops ending
+     * shortly after the preloaded part are included, so that sustained
+     * notes are played entirely from RAM.
+     */
+    struct preload_policy_t {
+        file_offset_t SampleCount;         ///< Amount of sample points to be preloaded beyond the furthest sample start offset of all dimension regions using the sample.
+        file_offset_t WholeSampleLimit;    ///< Samples with up to this many sample points are preloaded completely.
+        file_offset_t ReleaseTriggerLimit; ///< Samples only used by release trigger dimension regions (see dimension_releasetrigger) are preloaded completely if they have up to this many sample points.
+        file_offset_t LoopLimit;           ///< The preload of a looped sample is extended up to the end of its loop if the loop ends within this many sample points.
+        file_offset_t Budget;              ///< Maximum total size (in bytes) of the preloaded sample data (0 means unlimited).
+
+        preload_policy_t() : SampleCount(32768), WholeSampleLimit(65536), ReleaseTriggerLimit(262144),
+                             LoopLimit(131072), Budget(0) {}
+    };
+
+    /** @brief I/O ordered plan for preloading the samples of an instrument (see Instrument::GetPreloadPlan()). */
+    struct preload_plan_t {
+        file_offset_t                SampleCount; ///< Amount of sample points to be preloaded from the beginning of each sample (0 means the whole sample), or 0 if the plan was made by a preload_policy_t (see preload_range_t::SampleCount instead).
+        std::vector<preload_range_t> Samples;     ///< All samples to be preloaded (each only once) with their required data range, sorted by file and file position.
+        std::vector<preload_range_t> Runs;        ///< The data ranges of @a Samples coalesced to contiguous runs to be read in one pass each, in the same order.
+    };
+
+    /** @brief Heap memory occupied by libgig objects (see File::GetMemoryUsage()).
+     *
+     * All values are in bytes. They are computed from the sizes of the
+     * objects, tables, strings and buffers allocated by libgig and do not
+     * include the bookkeeping overhead of the heap allocator, so they are
+     * approximations rather than exact figures.
+     */
+    struct memory_usage_t {
+        size_t Metadata;       ///< Objects and tables describing samples, instruments, regions, dimension regions, groups and scripts.
+        size_t SampleData;     ///< Sample data cached in RAM (see Sample::LoadSampleData(), memory-mapped sample data is not counted).
+        size_t ChunkTree;      ///< RIFF chunk tree of the .gig file and its extension files, including chunk data loaded into RAM.
+        size_t VelocityTables; ///< Velocity tables shared by all DimensionRegions of all files (see DimensionRegion::GetVelocityTablesMemoryUsage()).
+
+        memory_usage_t() {
+            Metadata       = 0;
+            SampleData     = 0;
+            ChunkTree      = 0;
+            VelocityTables = 0;
+        }
+        size_t Total() const { return Metadata + SampleData + ChunkTree + VelocityTables; }
+        memory_usage_t& operator+=(const memory_usage_t& other) {
+            Metadata       += other.Metadata;
+            SampleData     += other.SampleData;
+            ChunkTree      += other.ChunkTree;
+            VelocityTables += other.VelocityTables;
+            return *this;
+        }
+    };
+
+    /** @brief RAM and disk footprint of a set of samples (see Group::GetFootprint()). */
+    struct sample_footprint_t {
+        size_t        Samples;       ///< Amount of samples.
+        size_t        CachedSamples; ///< Amount of those samples with sample data currently cached in RAM.
+        file_offset_t DiskSize;      ///< Size (in bytes) of the samples' wave data in the .gig file and its extension files (compressed size of compressed samples).
+        file_offset_t DecodedSize;   ///< Size (in bytes) of the samples' wave data completely decoded, i.e. the RAM required for loading all of them entirely.
+        size_t        RAMSize;       ///< Sample data currently cached in RAM (see memory_usage_t::SampleData).
+
+        sample_footprint_t() : Samples(0), CachedSamples(0), DiskSize(0), DecodedSize(0), RAMSize(0) {}
+    };
+
+    /** @brief Flags of a sample in a sample_table_t. */
+    enum sample_table_flags_t {
+        sample_table_compressed = 1, ///< The sample's wave data is compressed.
+        sample_table_looped     = 2, ///< The sample has a loop (LoopStart and LoopEnd are valid).
+        sample_table_crc_valid  = 4  ///< CRC is the stored checksum of the sample's wave data.
+    };
+
+    /** @brief Compact metadata table of all samples of a file (see File::GetSampleTable()).
+     *
+     * Holds the metadata most often needed of each sample as struct of
+     * arrays: each member is an array with one entry per sample, in wave
+     * pool order (so entry @c i refers to the same sample as
+     * File::GetSample(i)). Compared to Sample objects, which also carry the
+     * complete DLS::Info, RIFF chunk references and streaming state, a
+     * table entry takes less than 100 bytes (plus the sample's name).
+     */
+    struct sample_table_t {
+        std::vector<file_offset_t> WavePoolOffset;   ///< Offset of the sample in the wave pool, as referenced by the instruments' dimension regions.
+        std::vector<file_offset_t> DataOffset;       ///< Position of the sample's wave data in its file (0 if it was not saved yet).
+        std::vector<file_offset_t> DataSize;         ///< Size (in bytes) of the sample's wave data in the file.
+        std::vector<file_offset_t> SamplesTotal;     ///< Length in sample points, 0 if unknown (compressed samples which were neither scanned nor have a stored frame table, see File::SetFrameTableChunks()).
+        std::vector<uint32_t>      SamplesPerSecond; ///< Sample rate.
+        std::vector<uint32_t>      LoopStart;        ///< Start of the loop (in sample points), if sample_table_looped.
+        std::vector<uint32_t>      LoopEnd;          ///< End of the loop (in sample points), if sample_table_looped.
+        std::vector<uint32_t>      CRC;              ///< CRC-32 checksum of the sample's wave data, if sample_table_crc_valid.
+        std::vector<uint16_t>      Channels;         ///< Amount of audio channels.
+        std::vector<uint16_t>      BitDepth;         ///< Bits per sample point and channel (0 if not PCM).
+        std::vector<uint16_t>      Group;            ///< Index of the sample's group (see File::GetGroup()).
+        std::vector<uint8_t>       FileNo;           ///< Number of the extension file (*.gx01, ...) the sample is stored in, 0 for the .gig file itself.
+        std::vector<uint8_t>       UnityNote;        ///< MIDI note of the sample's original pitch.
+        std::vector<uint8_t>       Flags;            ///< Bits of sample_table_flags_t.
+        std::vector<uint32_t>      NameOffset;       ///< Position of the (NULL terminated) name of the sample in Names.
+        std::vector<char>          Names;            ///< Names of all samples.
+
+        /// Amount of samples in the table.
+        size_t Count() const { return DataSize.size(); }
+        /// Name of the sample with index @a Index.
+        const char* GetName(size_t Index) const { return &Names[NameOffset[Index]]; }
+    };
+
+    /** @brief Compact copy of the DimensionRegion parameters required for starting a voice.
+     *
+     * The articulation parameters of a DimensionRegion are spread over a
+     * large object, mixed with parameters only relevant for editors. This
+     * structure contains the parameters a sampler engine usually needs when
+     * triggering a voice, in compact form (times in seconds and frequencies
+     * in Hz as float, enumerations as uint8_t) and aligned to cache lines:
+     * the first cache line holds the sample, velocity tables, loop, gain,
+     * pan, tuning and filter settings, the second one the envelope
+     * generator and LFO parameters. See DimensionRegion::GetPlaybackParameters().
+     *
+     * The values are derived from the DimensionRegion's members of the same
+     * name, for their meaning refer to the latter.
+     */
+    struct GIG_CACHE_LINE_ALIGNED playback_params_t {
+        // 1st cache line: sample, velocity, mix and filter
+        Sample*      pSample;                        ///< Sample to be played back (NULL for silence).
+        const float* pVelocityAttenuationTable;      ///< 128 entries, same values as returned by DimensionRegion::GetVelocityAttenuation().
+        const float* pVelocityReleaseTable;          ///< 128 entries, same values as returned by DimensionRegion::GetVelocityRelease().
+        const float* pVelocityCutoffTable;           ///< 128 entries, same values as returned by DimensionRegion::GetVelocityCutoff().
+        uint32_t     LoopStart;                      ///< Start of the (first) sample loop in sample points (only if @a Loop is set).
+        uint32_t     LoopEnd;                        ///< End of the (first) sample loop in sample points, that is LoopStart + LoopLength (only if @a Loop is set).
+        float        SampleAttenuation;              ///< Sample volume factor.
+        int16_t      FineTune;                       ///< Fine tuning (in cents).
+        uint16_t     SampleStartOffset;              ///< Number of sample points the sample start should be moved.
+        uint8_t      UnityNote;                      ///< MIDI note the sample plays at its original pitch.
+        int8_t       Pan;                            ///< Panorama (-64..0..63 <-> left..middle..right).
+        uint8_t      LoopType;                       ///< Type of the (first) sample loop (loop_type_t).
+        uint8_t      ChannelOffset;                  ///< Audio output the dimension region should be routed to.
+        uint8_t      ReleaseTriggerDecay;            ///< 0 - 8
+        uint8_t      AttenuationControllerType;      ///< Type of the attenuation controller (leverage_ctrl_t::type_t).
+        uint8_t      AttenuationControllerNumber;    ///< MIDI controller number of the attenuation controller (if it is a control change controller).
+        uint8_t      AttenuationControllerThreshold; ///< 0 - 127
+        uint8_t      VCFType;                        ///< Filter type (vcf_type_t).
+        uint8_t      VCFCutoff;                      ///< Max. cutoff frequency.
+        uint8_t      VCFResonance;                   ///< Firm internal filter resonance weight.
+        uint8_t      VCFCutoffController;            ///< Controller of the filter cutoff frequency (vcf_cutoff_ctrl_t).
+        uint8_t      VCFKeyboardTrackingBreakpoint;  ///< See DimensionRegion::VCFKeyboardTracking.
+        bool         Loop                        : 1; ///< Whether the sample shall be looped (the dimension region defines at least one loop).
+        bool         PitchTrack                  : 1;
+        bool         SelfMask                    : 1;
+        bool         SustainDefeat               : 1;
+        bool         MSDecode                    : 1;
+        bool         InvertAttenuationController : 1;
+        bool         VCFEnabled                  : 1;
+        bool         VCFCutoffControllerInvert   : 1;
+        bool         VCFResonanceDynamic         : 1;
+        bool         VCFKeyboardTracking         : 1;
+        bool         EG1InfiniteSustain          : 1;
+        bool         EG1Hold                     : 1;
+        bool         EG2InfiniteSustain          : 1;
+        // 2nd cache line: envelope generators and LFOs
+        float        EG1Attack;                      ///< Attack time of the sample amplitude EG (seconds).
+        float        EG1Decay1;                      ///< Decay time of the sample amplitude EG (seconds).
+        float        EG1Decay2;                      ///< 2nd decay stage time of the sample amplitude EG (seconds).
+        float        EG1Release;                     ///< Release time of the sample amplitude EG (seconds).
+        float        EG2Attack;                      ///< Attack time of the filter cutoff EG (seconds).
+        float        EG2Decay1;                      ///< Decay time of the filter cutoff EG (seconds).
+        float        EG2Decay2;                      ///< 2nd decay stage time of the filter cutoff EG (seconds).
+        float        EG2Release;                     ///< Release time of the filter cutoff EG (seconds).
+        float        EG3Attack;                      ///< Attack time of the sample pitch EG (seconds).
+        float        LFO1Frequency;                  ///< Frequency of the sample amplitude LFO (Hz).
+        float        LFO2Frequency;                  ///< Frequency of the filter cutoff LFO (Hz).
+        float        LFO3Frequency;                  ///< Frequency of the sample pitch LFO (Hz).
+        uint16_t     EG1PreAttack;                   ///< 0 - 1000 permille
+        uint16_t     EG1Sustain;                     ///< 0 - 1000 permille
+        uint16_t     EG2PreAttack;                   ///< 0 - 1000 permille
+        uint16_t     EG2Sustain;                     ///< 0 - 1000 permille
+        int16_t      EG3Depth;                       ///< -1200 - +1200 cents
+        int16_t      LFO3InternalDepth;              ///< -1200 - +1200 cents
+        uint16_t     LFO1InternalDepth;              ///< 0 - 1200 cents
+        uint16_t     LFO2InternalDepth;              ///< 0 - 1200 cents
+    };
+
+    /** @brief Region of an InstrumentSnapshot.
+     *
+     * Flat copy of a Region's key and velocity range, its dimension
+     * definitions and the precomputed tables for resolving dimension values
+     * to dimension regions. See InstrumentSnapshot::GetDimensionRegionIndexByValue().
+     */
+    struct snapshot_region_t {
+        DLS::range_t    KeyRange;                 ///< Same as DLS::Region::KeyRange.
+        DLS::range_t    VelocityRange;            ///< Same as DLS::Region::VelocityRange.
+        uint16_t        KeyGroup;                 ///< Same as DLS::Region::KeyGroup.
+        uint32_t        Dimensions;               ///< Same as Region::Dimensions.
+        dimension_def_t pDimensionDefinitions[8]; ///< Same as Region::pDimensionDefinitions.
+        uint32_t        DimensionRegions;         ///< Same as Region::DimensionRegions.
+        uint32_t        FirstDimensionRegion;     ///< Index of the region's first dimension region within the snapshot.
+        uint32_t        Layers;                   ///< Same as Region::Layers.
+        int32_t         VelocityDimension;        ///< Index of the velocity dimension, -1 if there is none.
+        uint32_t        VelocityBitPos;           ///< Lowest dimension region index bit of the velocity dimension.
+        uint8_t         VelocityMask;             ///< Limits the velocity zone to the velocity dimension's bits.
+        uint8_t         DimensionBits[8][128];    ///< Dimension region index bits of each dimension by value (always 0 for the velocity dimension).
+        uint8_t         VelocityZones[128];       ///< Velocity zone by velocity, for dimension regions without custom velocity zones.
+    };
+
+    /** @brief Dimension region of an InstrumentSnapshot.
+     *
+     * The playback parameters of a DimensionRegion (see
+     * DimensionRegion::GetPlaybackParameters()), including the pointers to the
+     * sample and the velocity tables, as far as needed to resolve dimension
+     * values. See InstrumentSnapshot::GetDimensionRegion().
+     */
+    struct GIG_CACHE_LINE_ALIGNED snapshot_dimension_region_t {
+        playback_params_t Params;
+        const uint8_t*    pVelocityZones;          ///< Custom velocity zone of each velocity (see DimensionRegion::VelocityUpperLimit), NULL for evenly sized velocity zones.
+        uint8_t           DimensionUpperLimits[8]; ///< Same as DimensionRegion::DimensionUpperLimits.
+    };
 
     /** @brief Encapsulates articulation informations of a dimension region.
      *
@@ -490,7 +831,7 @@ namespace gig {
     class DimensionRegion : protected DLS::Sampler {
         public:
             uint8_t            VelocityUpperLimit;            ///< Defines the upper velocity value limit of a velocity split (only if an user defined limit was set, thus a value not equal to 128/NumberOfSplits, else this value is 0). Only for gig2, for gig3 and above the DimensionUpperLimits are used instead.
-            Sample*            pSample;                       ///< Points to the Sample which is assigned to the dimension region.
+            Sample*            pSample;                       ///< Points to the Sample which is assigned to the dimension region. @deprecated Don't alter directly, use SetSample() instead!
             // Sample Amplitude EG/LFO
             uint16_t           EG1PreAttack;                  ///< Preattack value of the sample amplitude EG (0 - 1000 permille).
             double             EG1Attack;                     ///< Attack time of the sample amplitude EG (0.000 - 60.000s).
@@ -590,6 +931,7 @@ namespace gig {
             double GetVelocityAttenuation(uint8_t MIDIKeyVelocity);
             double GetVelocityRelease(uint8_t MIDIKeyVelocity);
             double GetVelocityCutoff(uint8_t MIDIKeyVelocity);
+            const float* GetCrossfadeTable() const { return pCrossfadeTable; } ///< Returns the crossfade gain for each attenuation controller value 0 - 127 (see UpdatePlaybackParameters()).
             void SetVelocityResponseCurve(curve_type_t curve);
             void SetVelocityResponseDepth(uint8_t depth);
             void SetVelocityResponseCurveScaling(uint8_t scaling);
@@ -599,22 +941,32 @@ namespace gig {
             void SetVCFVelocityCurve(curve_type_t curve);
             void SetVCFVelocityDynamicRange(uint8_t range);
             void SetVCFVelocityScale(uint8_t scaling);
+            void SetSample(Sample* pSample);
             Region* GetParent() const;
-            // derived methods
-            using DLS::Sampler::AddSampleLoop;
-            using DLS::Sampler::DeleteSampleLoop;
+            memory_usage_t GetMemoryUsage() const;
+            static size_t GetVelocityTablesMemoryUsage();
+            const playback_params_t& GetPlaybackParameters() const { return PlaybackParams; } ///< Returns the compact playback parameters of this dimension region (see UpdatePlaybackParameters()).
+            void UpdatePlaybackParameters();
+            void AddSampleLoop(DLS::sample_loop_t* pLoopDef);
+            void DeleteSampleLoop(DLS::sample_loop_t* pLoopDef);
+            static void* operator new(size_t size);
+            static void  operator delete(void* p);
             // overridden methods
             virtual void SetGain(int32_t gain);
             virtual void UpdateChunks(progress_t* pProgress);
             virtual void CopyAssign(const DimensionRegion* orig);
         protected:
+            playback_params_t PlaybackParams; ///< Compact copy of the parameters required for starting a voice (see GetPlaybackParameters()).
             uint8_t* VelocityTable; ///< For velocity dimensions with custom defined zone ranges only: used for fast converting from velocity MIDI value to dimension bit number.
-            DimensionRegion(Region* pParent, RIFF::List* _3ewl);
+            bool     bSharedVelocityTable; ///< True if VelocityTable is owned by the Region and shared with other dimension regions (see File::SetArticulationSharing()).
+            DimensionRegion(Region* pParent, RIFF::List* _3ewl, const DimensionRegion* pArticulation = NULL);
             DimensionRegion(RIFF::List* _3ewl, const DimensionRegion& src);
            ~DimensionRegion();
             void CopyAssign(const DimensionRegion* orig, const std::map<Sample*,Sample*>* mSamples);
             void serialize(Serialization::Archive* archive);
+            void __assignSample(Sample* pNewSample);
             friend class Region;
+            friend class File; // for instrument snapshots and deferred chunk updates
             friend class Serialization::Archive;
         private:
             typedef enum { ///< Used to decode attenuation, EG1 and EG2 controller
@@ -716,21 +1068,74 @@ namespace gig {
                 _lev_ctrl_CC118_EXT         = 0xf6, ///< MIDI Controller 118 [gig format extension]
                 _lev_ctrl_CC119_EXT         = 0xf7  ///< MIDI Controller 119 [gig format extension]
             } _lev_ctrl_t;
-            typedef std::map<uint32_t, double*> VelocityTableMap;
-
-            static size_t            Instances;                  ///< Number of DimensionRegion instances.
-            static VelocityTableMap* pVelocityTables;            ///< Contains the tables corresponding to the various velocity parameters (VelocityResponseCurve and VelocityResponseDepth).
-            double*                  pVelocityAttenuationTable;  ///< Points to the velocity table corresponding to the velocity parameters of this DimensionRegion.
-            double*                  pVelocityReleaseTable;      ///< Points to the velocity table corresponding to the release velocity parameters of this DimensionRegion
-            double*                  pVelocityCutoffTable;       ///< Points to the velocity table corresponding to the filter velocity parameters of this DimensionRegion
+            typedef std::map<uint32_t, float*> VelocityTableMap;
+
+            static size_t            Instances;                  ///< Number of DimensionRegion instances (guarded by the velocity table mutex).
+            static VelocityTableMap* pVelocityTables;            ///< Contains the tables corresponding to the various velocity parameters (VelocityResponseCurve and VelocityResponseDepth), guarded by the velocity table mutex.
+            static VelocityTableMap* pCrossfadeTables;           ///< Contains the crossfade gain tables by their crossfade_t value, guarded by the velocity table mutex.
+            float*                   pVelocityAttenuationTable;  ///< Points to the velocity table corresponding to the velocity parameters of this DimensionRegion.
+            float*                   pVelocityReleaseTable;      ///< Points to the velocity table corresponding to the release velocity parameters of this DimensionRegion
+            float*                   pVelocityCutoffTable;       ///< Points to the velocity table corresponding to the filter velocity parameters of this DimensionRegion
+            float*                   pCrossfadeTable;            ///< Points to the crossfade gain table corresponding to the Crossfade parameters of this DimensionRegion.
             Region*                  pRegion;
 
             leverage_ctrl_t DecodeLeverageController(_lev_ctrl_t EncodedController);
             _lev_ctrl_t     EncodeLeverageController(leverage_ctrl_t DecodedController);
-            double* GetReleaseVelocityTable(curve_type_t releaseVelocityResponseCurve, uint8_t releaseVelocityResponseDepth);
-            double* GetCutoffVelocityTable(curve_type_t vcfVelocityCurve, uint8_t vcfVelocityDynamicRange, uint8_t vcfVelocityScale, vcf_cutoff_ctrl_t vcfCutoffController);
-            double* GetVelocityTable(curve_type_t curveType, uint8_t depth, uint8_t scaling);
-            double* CreateVelocityTable(curve_type_t curveType, uint8_t depth, uint8_t scaling);
+            float* GetReleaseVelocityTable(curve_type_t releaseVelocityResponseCurve, uint8_t releaseVelocityResponseDepth);
+            float* GetCutoffVelocityTable(curve_type_t vcfVelocityCurve, uint8_t vcfVelocityDynamicRange, uint8_t vcfVelocityScale, vcf_cutoff_ctrl_t vcfCutoffController);
+            float* GetVelocityTable(curve_type_t curveType, uint8_t depth, uint8_t scaling);
+            float* CreateVelocityTable(curve_type_t curveType, uint8_t depth, uint8_t scaling);
+            float* GetCrossfadeTable(const crossfade_t& crossfade);
+            float* CreateCrossfadeTable(const crossfade_t& crossfade);
+            void   __adoptArticulation(const DimensionRegion& src);
+            void   __prepareChunks(progress_t* pProgress);
+            void   __storeChunkData();
+    };
+
+    /** @brief Reference counted handle of a sample's RAM cache.
+     *
+     * The buffer_t structure returned by Sample::LoadSampleData() and
+     * Sample::GetCache() is owned by the Sample, so it becomes invalid as
+     * soon as the sample's RAM cache is released (i.e. by
+     * Sample::ReleaseSampleData() or by a SampleCache meeting its memory
+     * budget), even if voices are still reading from it. A SampleBuffer
+     * handle obtained by Sample::AcquireCache() or
+     * SampleCache::AcquireSampleData() in contrast keeps the cached sample
+     * data alive: once the sample's RAM cache is released, its memory is
+     * freed when the last handle referring to it is released (destroyed,
+     * reset or assigned another buffer).
+     *
+     * Copying a handle just adds a reference to the same buffer, the
+     * sample data is never copied. The reference count is maintained
+     * atomically, so copies of a handle may be passed to and released by
+     * other threads (i.e. the loader thread acquires the buffer and hands
+     * it to the audio thread's voice) without any locking. A single handle
+     * object must not be modified by several threads at the same time
+     * though. Note that releasing the last reference frees memory, which
+     * is usually not real-time safe.
+     *
+     * The memory of ordinary and shared RAM caches (see SetSampleSharing())
+     * is kept alive by the handle even after the sample or its file was
+     * destroyed. Zero-copy RAM caches of memory-mapped files (see
+     * Sample::LoadSampleData()) however point directly into the file's
+     * mapping, so their sample data stays only valid as long as the file
+     * remains open and is not saved.
+     */
+    class SampleBuffer {
+        public:
+            SampleBuffer();
+            SampleBuffer(const SampleBuffer& ref);
+           ~SampleBuffer();
+            SampleBuffer& operator=(const SampleBuffer& ref);
+            const buffer_t& GetBuffer() const;
+            bool            IsEmpty() const;
+            long            GetUseCount() const;
+            void            Reset();
+        private:
+            sample_buffer_block_t* pBlock;
+
+            explicit SampleBuffer(sample_buffer_block_t* pBlock);
+            friend class Sample;
     };
 
     /** @brief Encapsulates sample waves of Gigasampler/GigaStudio files used for playback.
@@ -785,45 +1190,125 @@ namespace gig {
             buffer_t      LoadSampleDataWithNullSamplesExtension(uint NullSamplesCount);
             buffer_t      LoadSampleDataWithNullSamplesExtension(file_offset_t SampleCount, uint NullSamplesCount);
             buffer_t      GetCache();
+            SampleBuffer  AcquireCache();
+            uint          GetCacheBitDepth() const;
+            buffer_t      LoadCompressedSampleData(file_offset_t SampleCount = 0);
+            buffer_t      GetCompressedCache();
+            void          Prefetch(file_offset_t SamplePos, file_offset_t SampleCount);
+            void          SetNumaNode(int Node);
+            int           GetNumaNode() const;
+            void          Advise(file_offset_t SamplePos, file_offset_t SampleCount, RIFF::advice_t Advice);
+            file_offset_t GetSamplesPerFrame() const;
+            file_offset_t GetFrameAlignedCount(file_offset_t SamplePos, file_offset_t SampleCount) const;
+            bool          GetDataRange(file_offset_t SamplePos, file_offset_t SampleCount, file_offset_t& Offset, file_offset_t& Size);
+            // implementation of SampleStream::Source
+            virtual SampleStream::info_t GetStreamInfo();
+            virtual SampleStream::pos_t  ReadStream(SampleStream::pos_t Pos, void* pBuffer, SampleStream::pos_t SampleCount, SampleStream::format_t Format = SampleStream::format_native);
+            virtual bool                 GetStreamLoop(SampleStream::loop_t& Loop);
+            virtual SampleStream::head_t GetStreamHead();
             // own static methods
             static buffer_t CreateDecompressionBuffer(file_offset_t MaxReadSize);
             static void     DestroyDecompressionBuffer(buffer_t& DecompressionBuffer);
+            file_offset_t   GetDecompressionBufferSize(file_offset_t SampleCount) const;
             // overridden methods
             void          ReleaseSampleData();
+            void          ReleaseLoopCache();
             void          Resize(file_offset_t NewSize);
             file_offset_t SetPos(file_offset_t SampleCount, RIFF::stream_whence_t Whence = RIFF::stream_start);
             file_offset_t GetPos() const;
             file_offset_t Read(void* pBuffer, file_offset_t SampleCount, buffer_t* pExternalDecompressionBuffer = NULL);
+            file_offset_t ReadFrames(void* pBuffer, file_offset_t MaxSampleCount, buffer_t* pExternalDecompressionBuffer = NULL);
+            read_result_t ReadRT(void* pBuffer, file_offset_t SampleCount, file_offset_t& ReadSamples, buffer_t* pDecompressionBuffer = NULL);
             file_offset_t ReadAndLoop(void* pBuffer, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn, buffer_t* pExternalDecompressionBuffer = NULL);
+            file_offset_t ReadPlanar(void* pLeft, void* pRight, file_offset_t SampleCount, buffer_t* pExternalDecompressionBuffer = NULL);
+            file_offset_t ReadPlanarAndLoop(void* pLeft, void* pRight, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn, buffer_t* pExternalDecompressionBuffer = NULL);
+            static void   ReadAndLoopBatch(batch_read_t* pReads, size_t Count, buffer_t* pExternalDecompressionBuffer = NULL);
+            file_offset_t ReadFloat(float* pBuffer, file_offset_t SampleCount, float Gain = 1.0f, buffer_t* pExternalDecompressionBuffer = NULL);
+            file_offset_t ReadFloatPlanar(float* pLeft, float* pRight, file_offset_t SampleCount, float Gain = 1.0f, buffer_t* pExternalDecompressionBuffer = NULL);
+            file_offset_t ReadFloatAndLoop(float* pBuffer, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn, float Gain = 1.0f, buffer_t* pExternalDecompressionBuffer = NULL);
+            file_offset_t ReadFloatPlanarAndLoop(float* pLeft, float* pRight, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn, float Gain = 1.0f, buffer_t* pExternalDecompressionBuffer = NULL);
             file_offset_t Write(void* pBuffer, file_offset_t SampleCount);
+            void          WriteCompressed(const void* pBuffer, file_offset_t SampleCount, int ThreadCount = 0, progress_t* pProgress = NULL);
             Group*        GetGroup() const;
             virtual void  UpdateChunks(progress_t* pProgress);
             void CopyAssignMeta(const Sample* orig);
             void CopyAssignWave(const Sample* orig);
             uint32_t GetWaveDataCRC32Checksum();
             bool VerifyWaveData(uint32_t* pActually = NULL);
+            void SetStreamVerification(bool bEnable, stream_verify_callback_t pCallback = NULL, void* pUserData = NULL);
+            bool HasStreamChecksumMismatch() const;
+            file_offset_t GetStreamMismatchPos() const;
+            bool HasBlockChecksums() const;
+            bool VerifyWaveDataRange(file_offset_t SampleOffset, file_offset_t SampleCount, file_offset_t* pCorruptOffset = NULL);
+            std::vector<uint8_t> GetFrameIndexData();
+            bool SetFrameIndexData(const std::vector<uint8_t>& data);
+            const sample_analysis_t& Analyze(float SilenceThreshold = 0.001f);
+            const sample_analysis_t& GetAnalysis() const;
+            std::vector<uint8_t> GetAnalysisData() const;
+            bool SetAnalysisData(const std::vector<uint8_t>& data);
+            memory_usage_t GetMemoryUsage() const;
+            std::vector<DimensionRegion*> GetDimensionRegions();
+            std::vector<Instrument*> GetInstruments();
+            size_t CountReferences();
         protected:
             static size_t        Instances;               ///< Number of instances of class Sample.
             static buffer_t      InternalDecompressionBuffer; ///< Buffer used for decompression as well as for truncation of 24 Bit -> 16 Bit samples.
             Group*               pGroup;                  ///< pointer to the Group this sample belongs to (always not-NULL)
             file_offset_t        FrameOffset;             ///< Current offset (sample points) in current sample frame (for decompression only).
-            file_offset_t*       FrameTable;              ///< For positioning within compressed samples only: stores the offset values for each frame.
+            file_offset_t*       FrameTable;              ///< For positioning within compressed samples only: stores the offset values for each frame (for 24 bit samples only for every 8th frame, see FrameTableDelta).
+            uint16_t*            FrameTableDelta;         ///< For positioning within compressed 24 bit samples only: offset of each frame relative to the FrameTable entry of its group of 8 frames.
+            file_offset_t        FrameCount;              ///< For compressed samples only: total number of sample frames.
+            bool                 ScanPending;             ///< For compressed samples only: true if scanning the sample (see File::SetLazySampleScan()) was deferred and not done yet.
             file_offset_t        SamplePos;               ///< For compressed samples only: stores the current position (in sample points).
             file_offset_t        SamplesInLastFrame;      ///< For compressed samples only: length of the last sample frame.
             file_offset_t        WorstCaseFrameSize;      ///< For compressed samples only: size (in bytes) of the largest possible sample frame.
             file_offset_t        SamplesPerFrame;         ///< For compressed samples only: number of samples in a full sample frame.
             buffer_t             RAMCache;                ///< Buffers samples (already uncompressed) in RAM.
+            bool                 RAMCacheMapped;          ///< Whether RAMCache.pStart points directly into the memory-mapped file (zero-copy) instead of a buffer allocated by us.
+            bool                 RAMCacheReduced;         ///< Whether the 24 bit sample points in RAMCache were reduced to 16 bit (see File::SetRAMCacheFormat()).
+            shared_sample_buffer_t* pSharedRAMCache;      ///< Buffer of RAMCache if it is shared with identical samples (see SetSampleSharing()), NULL if RAMCache is owned by this sample.
+            sample_buffer_block_t* pRAMCacheBlock;        ///< Owns the memory of RAMCache (instead of this sample) once a SampleBuffer handle of it was acquired (see AcquireCache()), NULL otherwise.
+            buffer_t             CompressedCache;         ///< For compressed samples only: buffers the raw (still compressed) sample frames of the sample's beginning in RAM (see LoadCompressedSampleData()).
             unsigned long        FileNo;                  ///< File number (> 0 when sample is stored in an extension file, 0 when it's in the gig)
             RIFF::Chunk*         pCk3gix;
             RIFF::Chunk*         pCkSmpl;
+            SampleCache*         pSampleCache;            ///< SampleCache managing the RAM cache of this sample, NULL if the RAM cache is managed by the application.
+            int                  NumaNode;                ///< NUMA placement of this sample's data in RAM, overriding the one of the file unless RIFF::numa_node_default (see SetNumaNode()).
             uint32_t             crc;                     ///< Reflects CRC-32 checksum of the raw sample data at the last time when the sample's raw wave form data has been modified consciously by the user by calling Write().
+            bool                 CRCValid;                ///< Whether crc reflects the current raw sample data (read from the checksum table or calculated by a complete Write()).
+            bool                 StreamVerify;            ///< Whether the checksum of the wave data streamed by Read() is accumulated (see SetStreamVerification()).
+            bool                 StreamVerifyValid;       ///< Whether the current streaming pass read the wave data contiguously from its beginning so far.
+            bool                 StreamVerifyMismatch;    ///< Whether a completed streaming pass did not match the stored checksum.
+            uint32_t             StreamCRC;               ///< CRC-32 accumulated by the current streaming pass.
+            file_offset_t        StreamVerifyPos;         ///< Position (in sample points) up to which the current streaming pass accumulated StreamCRC.
+            stream_verify_callback_t StreamVerifyCallback; ///< Called when a completed streaming pass did not match the stored checksum.
+            bool                 StreamBlockValid;        ///< Whether StreamBlockCRC covers the current checksum block from its beginning up to StreamBlockPos.
+            uint32_t             StreamBlockCRC;          ///< CRC-32 accumulated for the current checksum block by streaming verification.
+            file_offset_t        StreamBlockPos;          ///< Position (in sample points) up to which StreamBlockCRC was accumulated.
+            file_offset_t        StreamMismatchPos;       ///< First sample point of the first corrupt checksum block detected by streaming verification, SamplesTotal if unknown.
+            std::vector<uint32_t> BlockChecksums;         ///< CRC-32 checksum of each block of BlockChecksumFrames sample points (see File::SetBlockChecksums()), empty if not available.
+            uint32_t             BlockChecksumsCRC;       ///< Checksum of the whole wave data (crc) at the time BlockChecksums were calculated.
+            file_offset_t        BlockChecksumFrames;     ///< Amount of sample points covered by each entry of BlockChecksums.
+            void*                StreamVerifyUserData;    ///< Custom pointer passed to StreamVerifyCallback.
+            struct loop_cache_t {
+                Sample*       pSample; ///< Sample the loop body belongs to.
+                file_offset_t Start;   ///< First sample point of the cached loop body.
+                file_offset_t End;     ///< Sample point after the cached loop body.
+                uint8_t*      pData;   ///< Decoded loop body (like Read() output, FrameSize bytes per sample point), NULL while it is still being decoded.
+                size_t        Users;   ///< Amount of readers currently serving from pData, the loop body is not evicted meanwhile.
+                std::list<loop_cache_t*>::iterator LRUPos; ///< Position in File::LoopCacheLRU (only valid if pData is set).
+            };
+            std::vector<loop_cache_t*> LoopCaches;        ///< Decoded loop bodies kept in RAM (see File::SetLoopCacheLimit()), guarded by the loop cache mutex.
+            loop_cache_t*        pLastLoopCache;          ///< Entry of LoopCaches used last, looked up first (NULL if none), guarded by the loop cache mutex.
+            sample_analysis_t    Analysis;                ///< Result of the last Analyze() call (see GetAnalysis()).
+            std::vector<DimensionRegion*> References;     ///< Loaded dimension regions using this sample, only valid while File::bSampleReferencesValid is true (see GetDimensionRegions()).
 
             Sample(File* pFile, RIFF::List* waveList, file_offset_t WavePoolOffset, unsigned long fileNo = 0, int index = -1);
            ~Sample();
             uint32_t CalculateWaveDataChecksum();
 
             // Guess size (in bytes) of a compressed sample
-            inline file_offset_t GuessSize(file_offset_t samples) {
+            inline file_offset_t GuessSize(file_offset_t samples) const {
                 // 16 bit: assume all frames are compressed - 1 byte
                 // per sample and 5 bytes header per 2048 samples
 
@@ -845,9 +1330,391 @@ namespace gig {
             }
         private:
             void ScanCompressedSample();
+            void __unmapRAMCache();
+            void __adoptReaderState(const SampleReader& reader);
+            void __updateStreamCRC(file_offset_t Pos, const void* pBuffer, file_offset_t SampleCount);
+            void __updateStreamBlockCRC(file_offset_t Pos, const void* pBuffer, file_offset_t SampleCount);
+            bool __loadBlockChecksumChunk();
+            void __updateBlockChecksumChunk();
+            bool __calculateBlockChecksums();
+            void __ensureScanned() { if (ScanPending) ScanCompressedSample(); }
+            bool __loadFrameTableChunk();
+            void __updateFrameTableChunk();
+            void __buildFrameTable(const std::vector<file_offset_t>& frameOffsets);
+            file_offset_t __frameOffset(file_offset_t frame) const;
+            file_offset_t __dataSize(file_offset_t SampleCount);
+            file_offset_t __compressedReadSize(file_offset_t ChunkPos, file_offset_t EndPos, file_offset_t SampleCount);
+            file_offset_t __ramCacheSize() const;
+            bool          __isCacheReferenced() const;
+            bool          __isDuplicateOf(Sample* pOther);
+            loop_cache_t* __getLoopCache(file_offset_t Start, file_offset_t End);
+            void          __releaseLoopCache(loop_cache_t* pCache);
+            void          __freeRAMCache();
+            void          __addReference(DimensionRegion* pDimRgn);
+            void          __removeReference(DimensionRegion* pDimRgn);
+            file_offset_t __read(void* pBuffer, file_offset_t SampleCount, buffer_t* pExternalDecompressionBuffer, bool bBuffered);
+            file_offset_t __readReduced(int16_t* pBuffer, file_offset_t SampleCount, bool bDither);
+            uint          __cacheFrameSize() const;
             friend class File;
             friend class Region;
             friend class Group; // allow to modify protected member pGroup
+            friend class SampleReader;
+            friend class Instrument; // for preload plans
+            friend class SampleCache;
+            friend class DimensionRegion; // for maintaining References
+            friend class FileLoader; // for serving preloaded heads
+    };
+
+    /** @brief Independent read cursor for streaming a gig Sample.
+     *
+     * The streaming methods of class Sample (Sample::Read(),
+     * Sample::ReadAndLoop(), Sample::SetPos()) store the current read
+     * position within the Sample object itself, so one Sample can only be
+     * streamed by one voice / thread at a time. A SampleReader in contrast
+     * owns its own read position, frame offset and decompression buffer,
+     * so an arbitrary amount of SampleReader objects may be used to stream
+     * the same Sample concurrently by different threads, without cloning
+     * Sample objects and without locking. Reading is performed with
+     * RIFF::Chunk::ReadAt(), so it does not touch the read position of the
+     * Sample or of its RIFF chunk either.
+     *
+     * The Sample object must not be modified or deleted while it is being
+     * read by a SampleReader.
+     */
+    class SampleReader {
+        public:
+            SampleReader(Sample* pSample, file_offset_t MaxReadSize = 0);
+           ~SampleReader();
+            Sample*       GetSample() const { return pSample; } ///< Returns the Sample this reader reads from.
+            file_offset_t SetPos(file_offset_t SampleCount, RIFF::stream_whence_t Whence = RIFF::stream_start);
+            file_offset_t GetPos() const;
+            file_offset_t Read(void* pBuffer, file_offset_t SampleCount);
+            file_offset_t ReadFrames(void* pBuffer, file_offset_t MaxSampleCount);
+            read_result_t ReadRT(void* pBuffer, file_offset_t SampleCount, file_offset_t& ReadSamples);
+            file_offset_t ReadAndLoop(void* pBuffer, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn);
+            file_offset_t ReadPlanar(void* pLeft, void* pRight, file_offset_t SampleCount);
+            file_offset_t ReadPlanarAndLoop(void* pLeft, void* pRight, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn);
+            file_offset_t ReadFloat(float* pBuffer, file_offset_t SampleCount, float Gain = 1.0f);
+            file_offset_t ReadFloatPlanar(float* pLeft, float* pRight, file_offset_t SampleCount, float Gain = 1.0f);
+            file_offset_t ReadFloatAndLoop(float* pBuffer, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn, float Gain = 1.0f);
+            file_offset_t ReadFloatPlanarAndLoop(float* pLeft, float* pRight, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn, float Gain = 1.0f);
+        protected:
+            /// Destination of a read operation.
+            struct output_t {
+                uint8_t* pNative;      ///< Destination for native output (16 bit or packed 24 bit integer, interleaved or left channel on planar output), NULL on float output.
+                uint8_t* pNativeRight; ///< Native planar output of stereo samples only: destination of the right channel, NULL otherwise.
+                float*   pFloat[2];    ///< Destination of each channel on float output.
+                int      step;         ///< Float output only: distance (in floats) between two sample points of the same channel.
+                float    gain;         ///< Float output only: gain factor applied to the sample points.
+            };
+            /// Decoder specialized for one sample format (see SelectDecoder()).
+            typedef file_offset_t (SampleReader::*decode_fn_t)(output_t& out, file_offset_t SampleCount, read_result_t* pResult);
+
+            Sample*       pSample;
+            file_offset_t SamplePos;            ///< For compressed samples only: current position (in sample points).
+            file_offset_t FrameOffset;          ///< For compressed samples only: current offset (sample points) in current sample frame.
+            file_offset_t ChunkPos;             ///< Current read position (in bytes) within the sample's data chunk.
+            buffer_t      DecompressionBuffer;  ///< Decompression buffer owned by this reader (if any).
+            buffer_t*     pDecompressionBuffer; ///< Decompression buffer actually used for reading (owned or external one).
+            decode_fn_t   pDecode;              ///< Decoder for the sample's format, selected once by the constructors.
+            const uint8_t* pLoopCache;          ///< Decoded loop body served from RAM during ReadAndLoop() (see File::SetLoopCacheLimit()), NULL otherwise.
+            Sample::loop_cache_t* pLoopCacheEntry; ///< Loop cache entry of pLoopCache, released at the end of ReadAndLoop().
+            file_offset_t LoopCacheStart;       ///< First sample point of pLoopCache.
+            file_offset_t LoopCacheEnd;         ///< Sample point after the end of pLoopCache.
+            bool          Buffered;             ///< Read through the page cache even if the file is unbuffered (for reading into RAM caches, see RIFF::File::SetUnbuffered()).
+
+            SampleReader(Sample* pSample, buffer_t* pExternalDecompressionBuffer, file_offset_t SamplePos, file_offset_t FrameOffset, file_offset_t ChunkPos);
+            output_t      NativeOutput(void* pBuffer) const;
+            output_t      NativePlanarOutput(void* pLeft, void* pRight) const;
+            output_t      FloatOutput(float* pBuffer, float Gain) const;
+            output_t      FloatPlanarOutput(float* pLeft, float* pRight, float Gain) const;
+            void          AdvanceOutput(output_t& out, file_offset_t SampleCount) const;
+            void          ReverseOutput(const output_t& out, file_offset_t SampleCount) const;
+            void          CopyNativeTo(output_t& out, const uint8_t* pSrc, file_offset_t SampleCount) const;
+            void          CopyNativeReversedTo(output_t& out, const uint8_t* pSrc, file_offset_t SampleCount) const;
+            file_offset_t ReadReverseTo(output_t& out, file_offset_t Start, file_offset_t SampleCount);
+            file_offset_t ReadTo(output_t& out, file_offset_t SampleCount, read_result_t* pResult = NULL);
+            file_offset_t DecodeTo(output_t& out, file_offset_t SampleCount, read_result_t* pResult);
+            void          SelectDecoder();
+            template<int BITDEPTH, int CHANNELS>
+            file_offset_t DecodeUncompressedTo(output_t& out, file_offset_t SampleCount, read_result_t* pResult);
+            template<int BITDEPTH, int CHANNELS>
+            file_offset_t DecodeCompressedTo(output_t& out, file_offset_t SampleCount, read_result_t* pResult);
+            const unsigned char* ReadRaw(file_offset_t Size, file_offset_t& ReadBytes);
+            file_offset_t ReadChunk(file_offset_t Pos, void* pData, file_offset_t WordCount, file_offset_t WordSize) const;
+            file_offset_t ReadAndLoopTo(output_t& out, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn);
+            void          __releaseLoopCache();
+        private:
+            SampleReader(const SampleReader&);            // not copyable
+            SampleReader& operator=(const SampleReader&); // not copyable
+            friend class Sample;
+            friend class StereoPairReader;
+    };
+
+    /** @brief Streams a pair of mono samples as one stereo sample.
+     *
+     * Many (especially older) Gigasampler libraries store stereo sounds as
+     * two mono samples, assigned to the left and right dimension region of
+     * a dimension_samplechannel dimension (see
+     * Region::GetMonoSamplePair()). Instead of streaming both samples
+     * separately, a StereoPairReader reads both of them with one call and
+     * emits interleaved stereo sample frames, like a SampleReader of a
+     * stereo sample does. Both channels share the same playback state. The
+     * loop points are taken from the dimension region passed to
+     * ReadAndLoop() (usually the left one). If the right sample is shorter
+     * than the left one, the missing part of the right channel is silence.
+     *
+     * Like with SampleReader, an arbitrary amount of StereoPairReader
+     * objects (and SampleReader objects) may read the same samples
+     * concurrently. The read methods do not allocate memory, as long as
+     * native reads do not exceed the @a MaxReadSize passed to the
+     * constructor.
+     */
+    class StereoPairReader {
+        public:
+            StereoPairReader(Sample* pLeft, Sample* pRight, file_offset_t MaxReadSize = 0);
+            Sample*       GetLeftSample() const { return Left.GetSample(); }   ///< Returns the Sample of the left channel.
+            Sample*       GetRightSample() const { return Right.GetSample(); } ///< Returns the Sample of the right channel.
+            file_offset_t SetPos(file_offset_t SampleCount, RIFF::stream_whence_t Whence = RIFF::stream_start);
+            file_offset_t GetPos() const;
+            file_offset_t Read(void* pBuffer, file_offset_t SampleCount);
+            file_offset_t ReadAndLoop(void* pBuffer, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn);
+            file_offset_t ReadFloat(float* pBuffer, file_offset_t SampleCount, float Gain = 1.0f);
+            file_offset_t ReadFloatAndLoop(float* pBuffer, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn, float Gain = 1.0f);
+        protected:
+            SampleReader         Left;
+            SampleReader         Right;
+            std::vector<uint8_t> Buffer; ///< Holds both channels before they are interleaved (native output only).
+
+            file_offset_t ReadNative(void* pBuffer, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn);
+            file_offset_t ReadFloatTo(float* pBuffer, file_offset_t SampleCount, playback_state_t* pPlaybackState, DimensionRegion* pDimRgn, float Gain);
+        private:
+            StereoPairReader(const StereoPairReader&);            // not copyable
+            StereoPairReader& operator=(const StereoPairReader&); // not copyable
+    };
+
+    /** @brief RAM cache for sample data shared by many samples, with a memory budget.
+     *
+     * Instead of managing the RAM cache of each Sample individually with
+     * Sample::LoadSampleData() and Sample::ReleaseSampleData(), samples may
+     * be loaded through a SampleCache, which keeps track of the memory
+     * occupied by all of them. Whenever the total size of the cached sample
+     * data exceeds the cache's memory budget, the least recently used
+     * samples are released automatically, except those which are currently
+     * pinned (i.e. being played back by a voice). One SampleCache may be
+     * shared by samples of any amount of files (e.g. one process wide
+     * cache), and all methods may be called by several threads at the same
+     * time, as long as the same Sample is not loaded by several threads at
+     * once.
+     *
+     * Instead of pinning samples, voices may also hold SampleBuffer handles
+     * obtained by AcquireSampleData(): samples whose RAM cache is still
+     * referenced by such a handle are not released by the cache either,
+     * and even if the RAM cache is released explicitly (i.e. by
+     * ReleaseSampleData() or Clear()), its memory remains valid until the
+     * last handle was released.
+     *
+     * Note that zero-copy RAM caches of memory-mapped files (see
+     * Sample::LoadSampleData()) only occupy the size of their silence
+     * extension.
+     */
+    class SampleCache {
+        public:
+            SampleCache(file_offset_t Budget);
+           ~SampleCache();
+            buffer_t      LoadSampleData(Sample* pSample, file_offset_t SampleCount = 0, uint NullSamplesCount = 0);
+            SampleBuffer  AcquireSampleData(Sample* pSample, file_offset_t SampleCount = 0, uint NullSamplesCount = 0);
+            void          ReleaseSampleData(Sample* pSample);
+            bool          Pin(Sample* pSample);
+            void          Unpin(Sample* pSample);
+            void          Clear();
+            void          SetBudget(file_offset_t Budget);
+            file_offset_t GetBudget() const;
+            file_offset_t GetUsage() const;
+        private:
+            sample_cache_t* p;
+
+            void __evict();
+            void __forget(Sample* pSample);
+            void __update(Sample* pSample);
+            SampleCache(const SampleCache&);            // not copyable
+            SampleCache& operator=(const SampleCache&); // not copyable
+            friend class Sample;
+    };
+
+    /** @brief Priority class of an asynchronous read request (see read_request_t::Priority). */
+    enum io_priority_t {
+        io_priority_streaming  = 0, ///< Refill of a playing voice's stream buffer: performed before all other requests, the one with the lowest fill level first (see read_request_t::FillLevel).
+        io_priority_normal     = 1, ///< Performed after pending streaming requests, in submission order (default).
+        io_priority_background = 2  ///< I.e. instrument preloads: only started while no other requests are pending, with limited concurrency and in slices (see SampleReadQueue::SetBackgroundLimit()), so they can't starve playing voices.
+    };
+
+    /** @brief Asynchronous read request (for SampleReadQueue).
+     *
+     * Describes one read operation to be performed in the background by a
+     * SampleReadQueue. The application fills in the input members, submits
+     * the request with SampleReadQueue::Submit() and must neither modify
+     * nor free the request, its reader or its destination buffer until the
+     * request completed (i.e. its callback was called or
+     * SampleReadQueue::Wait() returned).
+     */
+    struct read_request_t {
+        // input
+        SampleReader*     pReader;        ///< Reader to be used (defines sample and read position), must not be used by anything else while the request is pending.
+        void*             pBuffer;        ///< Destination buffer (like with SampleReader::Read()).
+        file_offset_t     SampleCount;    ///< Amount of sample points to be read.
+        playback_state_t* pPlaybackState; ///< Optional: if not NULL, the sample is read with SampleReader::ReadAndLoop() using this playback state and the loop information of @c pDimRgn, otherwise with SampleReader::Read().
+        DimensionRegion*  pDimRgn;        ///< Loop information, only used if @c pPlaybackState is not NULL.
+        void (*callback)(read_request_t* pRequest); ///< Optional: called by the worker thread once the request completed, it must not throw and should return quickly.
+        void*             custom;         ///< This pointer can be used for arbitrary data.
+        io_priority_t     Priority;       ///< Optional: priority class of the request (default: io_priority_normal).
+        float             FillLevel;      ///< Optional, io_priority_streaming only: current fill level of the stream's ring buffer (0.0 = empty ... 1.0 = full), i.e. how close the voice is to a dropout.
+        // output
+        file_offset_t     Result;         ///< Amount of sample points actually read.
+        std::string       Error;          ///< Error message if reading failed (empty on success).
+
+        read_request_t() : pReader(NULL), pBuffer(NULL), SampleCount(0), pPlaybackState(NULL),
+                           pDimRgn(NULL), callback(NULL), custom(NULL), Priority(io_priority_normal),
+                           FillLevel(0.0f), Result(0) {}
+    };
+
+    /** @brief Performs sample read requests asynchronously on worker threads.
+     *
+     * Allows disk streaming threads to keep many read requests in flight
+     * instead of blocking on one Sample read at a time. Submitted requests
+     * are processed by a pool of worker threads, each request with its own
+     * SampleReader, so requests of the same sample (but different readers)
+     * may be performed concurrently.
+     *
+     * The queue schedules the requests by their priority class (see
+     * io_priority_t), so that preloading instruments (i.e. on a program
+     * change) can't delay the refills of playing voices: pending streaming
+     * requests are always started first, the one whose ring buffer is the
+     * emptiest first; normal requests are started in submission order
+     * after them. Background requests are only started while no other
+     * requests are pending, by at most a limited amount of workers at the
+     * same time, and are performed in slices, so that urgent requests
+     * submitted meanwhile are started before the next slice.
+     *
+     * If threads are not available on this system, Submit() performs the
+     * request synchronously instead.
+     *
+     * @see Sample::Prefetch() for a lightweight alternative which just lets
+     *      the operating system read ahead.
+     */
+    class SampleReadQueue {
+        public:
+            SampleReadQueue(int ThreadCount = 0);
+           ~SampleReadQueue();
+            void   Submit(read_request_t* pRequest);
+            void   Wait();
+            size_t GetPendingCount() const;
+            size_t GetPendingCount(io_priority_t Priority) const;
+            int    GetThreadCount() const;
+            void   SetBackgroundLimit(int MaxThreads, file_offset_t SliceSize);
+        private:
+            sample_read_queue_t* p;
+
+            static void __worker(void* arg);
+            SampleReadQueue(const SampleReadQueue&);            // not copyable
+            SampleReadQueue& operator=(const SampleReadQueue&); // not copyable
+    };
+
+    /** @brief Current state of a DiskStream (see DiskStream::GetState()). */
+    enum disk_stream_state_t {
+        disk_stream_starting = 0, ///< The stream was opened, but its worker did not start reading from disk yet (the preloaded head may already be read though).
+        disk_stream_playing  = 1, ///< The ring buffer is being refilled from disk.
+        disk_stream_end      = 2, ///< The end of the sample was reached by the worker, the rest of the sample is in the ring buffer.
+        disk_stream_error    = 3  ///< Reading from disk failed, no more data will arrive.
+    };
+
+    /** @brief One voice's stream of a StreamEngine.
+     *
+     * Delivers the sample points of a sample in its native format, like
+     * Sample::ReadAndLoop() would, from the sample's preloaded head in RAM
+     * (see Sample::LoadSampleData()) and then from a ring buffer refilled
+     * by the worker threads of the StreamEngine. All methods are meant to
+     * be called by one consumer thread (i.e. the audio thread), they
+     * never lock, block, allocate memory or perform any I/O.
+     *
+     * Streams are obtained by StreamEngine::OpenStream() and given back by
+     * Close(), they are never deleted by the application.
+     */
+    class DiskStream {
+        public:
+            file_offset_t       Read(void* pBuffer, file_offset_t SampleCount);
+            file_offset_t       GetReadSpace() const;
+            disk_stream_state_t GetState() const;
+            bool                IsEndOfStream() const;
+            Sample*             GetSample() const;
+            void                Close();
+        private:
+            // set by the consumer in StreamEngine::OpenStream()
+            volatile long     State;        ///< Slot state, see stream_engine_t.
+            Sample*           pSample;
+            DimensionRegion*  pDimRgn;
+            file_offset_t     StartPos;     ///< Sample point the worker starts reading from disk at.
+            size_t            FrameSize;
+            const uint8_t*    pHead;        ///< Preloaded head of the sample in RAM (NULL if none).
+            file_offset_t     HeadSize;     ///< Size of the preloaded head (in sample points).
+            file_offset_t     HeadPos;      ///< Sample points consumed from the head (consumer only).
+            // ring buffer (single producer: one worker at a time, single consumer)
+            uint8_t*          pRing;
+            size_t            Capacity;     ///< Size of the ring buffer (in sample points).
+            volatile size_t   ReadPos;      ///< Sample points consumed from the ring (only written by the consumer).
+            volatile size_t   WritePos;     ///< Sample points written to the ring (only written by the workers).
+            volatile long     StreamState;  ///< disk_stream_state_t (only written by the workers).
+            // worker side (guarded by the engine's mutex)
+            SampleReader*     pReader;
+            playback_state_t  PlaybackState;
+            bool              bBusy;        ///< A worker is currently refilling or setting up this stream.
+
+            DiskStream();
+            DiskStream(const DiskStream&);            // not copyable
+            DiskStream& operator=(const DiskStream&); // not copyable
+            friend class StreamEngine;
+    };
+
+    /** @brief Disk streaming engine for sampler voices.
+     *
+     * Implements the disk streaming machinery a sampler needs around
+     * Sample::ReadAndLoop(): a fixed pool of streams, each with its own
+     * lock-free single producer / single consumer ring buffer, and worker
+     * threads refilling these ring buffers from disk with the loop state
+     * of each stream, most urgent (emptiest) ring buffer first.
+     *
+     * Typical usage by a sampler: at startup preload the heads of all
+     * samples (see Sample::LoadSampleDataWithNullSamplesExtension()) and
+     * create the engine with the max. amount of voices. On note-on the
+     * audio thread calls OpenStream(), reads the voice's audio each
+     * period by DiskStream::Read() (which starts with the preloaded head
+     * immediately, while the workers begin reading behind the head) and
+     * calls DiskStream::Close() on voice end, making the stream's slot
+     * available again once its worker released its reader.
+     *
+     * All memory of the streams is allocated by the constructor, so the
+     * consumer side (OpenStream() and all DiskStream methods) never
+     * allocates, locks or blocks and is safe for real-time threads. The
+     * sample must neither be modified nor its RAM cache be released while
+     * it has open streams. Workers poll for work every millisecond while
+     * idle.
+     */
+    class StreamEngine {
+        public:
+            StreamEngine(int MaxStreams, file_offset_t RingSize = 131072, int ThreadCount = 1);
+           ~StreamEngine();
+            DiskStream*   OpenStream(Sample* pSample, DimensionRegion* pDimRgn = NULL, file_offset_t StartPos = 0);
+            int           GetMaxStreams() const;
+            int           CountOpenStreams() const;
+            file_offset_t GetRingSize() const;
+            void          SetRefillSize(file_offset_t MinSize, file_offset_t MaxSize);
+        private:
+            stream_engine_t* p;
+
+            bool __service();
+            static void __worker(void* arg);
+            StreamEngine(const StreamEngine&);            // not copyable
+            StreamEngine& operator=(const StreamEngine&); // not copyable
     };
 
     // TODO: <3dnl> list not used yet - not important though (just contains optional descriptions for the dimensions)
@@ -876,20 +1743,32 @@ namespace gig {
             unsigned int            Dimensions;               ///< Number of defined dimensions, do not alter!
             dimension_def_t         pDimensionDefinitions[8]; ///< Defines the five (gig2) or eight (gig3) possible dimensions (the dimension's controller and number of bits/splits). Use AddDimension() and DeleteDimension() to create a new dimension or delete an existing one.
             uint32_t                DimensionRegions;         ///< Total number of DimensionRegions this Region contains, do not alter!
-            DimensionRegion*        pDimensionRegions[256];   ///< Pointer array to the 32 (gig2) or 256 (gig3) possible dimension regions (reflects NULL for dimension regions not in use). Avoid to access the array directly and better use GetDimensionRegionByValue() instead, but of course in some cases it makes sense to use the array (e.g. iterating through all DimensionRegions). Use AddDimension() and DeleteDimension() to create a new dimension or delete an existing one (which will create or delete the respective dimension region(s) automatically).
+            DimensionRegion*        pDimensionRegions[256];   ///< Pointer array to the 32 (gig2) or 256 (gig3) possible dimension regions (reflects NULL for dimension regions not in use). Avoid to access the array directly and better use GetDimensionRegionByValue() instead, but of course in some cases it makes sense to use the array (e.g. iterating through all DimensionRegions). Use AddDimension() and DeleteDimension() to create a new dimension or delete an existing one (which will create or delete the respective dimension region(s) automatically). With File::SetLazyDimensionRegions() enabled, entries of dimension regions not accessed yet are still NULL, use GetDimensionRegionAt() for iterating then.
             unsigned int            Layers;                   ///< Amount of defined layers (1 - 32). A value of 1 actually means no layering, a value > 1 means there is Layer dimension. The same information can of course also be obtained by accessing pDimensionDefinitions. Do not alter this value!
 
             // own methods
             DimensionRegion* GetDimensionRegionByValue(const uint DimValues[8]);
             DimensionRegion* GetDimensionRegionByBit(const uint8_t DimBits[8]);
+            DimensionRegion* GetDimensionRegionAt(uint Index);
+            void             LoadAllDimensionRegions();
             int              GetDimensionRegionIndexByValue(const uint DimValues[8]);
+            void             GetDimensionRegionIndicesByValue(const uint DimValues[][8], int* pIndices, size_t Count);
+            void             GetDimensionRegionsByValue(const uint DimValues[][8], DimensionRegion** pDimRgns, size_t Count);
+            int              GetKeyswitchZone(uint8_t Key);
+            int              GetDimensionRegionIndexByKeyswitch(uint8_t KeyswitchKey, const uint DimValues[8]);
+            DimensionRegion* GetDimensionRegionByKeyswitch(uint8_t KeyswitchKey, const uint DimValues[8]);
             Sample*          GetSample();
+            std::vector<Sample*> GetSamples();
+            bool             GetMonoSamplePair(DimensionRegion* pDimRgn, DimensionRegion*& pLeft, DimensionRegion*& pRight);
             void             AddDimension(dimension_def_t* pDimDef);
             void             DeleteDimension(dimension_def_t* pDimDef);
             dimension_def_t* GetDimensionDefinition(dimension_t type);
             void             DeleteDimensionZone(dimension_t type, int zone);
             void             SplitDimensionZone(dimension_t type, int zone);
             void             SetDimensionType(dimension_t oldType, dimension_t newType);
+            void             BeginDimensionChanges();
+            void             CommitDimensionChanges();
+            memory_usage_t   GetMemoryUsage() const;
             // overridden methods
             virtual void     SetKeyRange(uint16_t Low, uint16_t High);
             virtual void     UpdateChunks(progress_t* pProgress);
@@ -903,6 +1782,37 @@ namespace gig {
             DimensionRegion* GetDimensionRegionByBit(const std::map<dimension_t,int>& DimCase);
            ~Region();
             friend class Instrument;
+            friend class File; // for instrument snapshots
+        private:
+            dimension_lookup_t* pDimensionLookup; ///< Precomputed tables for GetDimensionRegionIndexByValue() (NULL if not available).
+            std::vector<uint8_t*> SharedVelocityTables; ///< Distinct velocity tables referenced by this region's dimension regions if articulation sharing is enabled (see File::SetArticulationSharing()).
+            bool bDimensionsPending; ///< True if the dimensions were not loaded yet, because the region was loaded in browse mode (see File::SetBrowseMode()).
+            int  iDimensionChangeDepth; ///< Nesting depth of BeginDimensionChanges() calls, the lookup and velocity tables are rebuilt by CommitDimensionChanges() if > 0.
+            bool bDimensionChunksUnordered; ///< True if AddDimension() appended 3ewl chunks in a transaction, which are put into order by CommitDimensionChanges().
+            /// A dimension region not constructed yet (see File::SetLazyDimensionRegions()).
+            struct pending_dimension_region_t {
+                RIFF::List* p3ewl;         ///< List chunk of the dimension region, NULL if not pending (anymore).
+                uint32_t    WavePoolIndex; ///< Wave pool index of the dimension region's sample (from the 3lnk chunk).
+            };
+            pending_dimension_region_t* pPendingDimensionRegions; ///< One entry per dimension region chunk while dimension regions of this region are not constructed yet, NULL otherwise.
+            int nPendingDimensionRegions; ///< Size of the pPendingDimensionRegions array.
+            int iPendingDimensionRegions; ///< Amount of entries of pPendingDimensionRegions still pending.
+
+            void __loadDimensions(RIFF::List* rgnList);
+            void __collectDimensionRegions(RIFF::List* rgnList);
+            DimensionRegion* __loadPendingDimensionRegion(int index);
+            void __updateVelocityTable(int i, int veldim, int step, bool bShare);
+            /// Returns dimension region @a index, constructing it first if it is still pending.
+            DimensionRegion* __getDimensionRegion(int index) {
+                return (pPendingDimensionRegions && !pDimensionRegions[index] && index < nPendingDimensionRegions)
+                    ? __loadPendingDimensionRegion(index) : pDimensionRegions[index];
+            }
+            Sample* __getDimensionRegionSample(int index);
+            void __buildKeyswitchLookup();
+            void __buildDimensionLookup();
+            uint8_t* __shareVelocityTable(const uint8_t* pTable);
+            bool __isInVelocityRange(int dimregidx, const range_t& range) const;
+            bool __isReleaseTriggered(int dimregidx) const;
     };
 
     /** @brief Abstract base class for all MIDI rules.
@@ -949,10 +1859,22 @@ namespace gig {
      */
     class MidiRule {
         public:
+            /// Type of a MIDI rule (see GetType()).
+            enum Type_t {
+                TYPE_UNKNOWN      = 0, ///< MIDI rule type not supported by libgig (MidiRuleUnknown).
+                TYPE_CTRL_TRIGGER = 1, ///< MidiRuleCtrlTrigger
+                TYPE_LEGATO       = 2, ///< MidiRuleLegato
+                TYPE_ALTERNATOR   = 3  ///< MidiRuleAlternator
+            };
+
             virtual ~MidiRule() { }
+            Type_t GetType() const { return Type; } ///< Returns the type of this MIDI rule, which allows to cast it to the respective subclass without RTTI.
         protected:
+            MidiRule(Type_t type) : Type(type) { }
             virtual void UpdateChunks(uint8_t* pData) const = 0;
             friend class Instrument;
+        private:
+            Type_t Type;
     };
 
     /** @brief MIDI rule for triggering notes by control change events.
@@ -982,7 +1904,30 @@ namespace gig {
                 bool    OverridePedal;  ///< If a note off should be triggered even if the sustain pedal is down.
             } pTriggers[32];
 
+            void UpdateTriggerTable();
+
+            /**
+             * Returns the triggers fired by the controller ControllerNumber
+             * changing its value from @a PrevValue to @a NewValue, as bit
+             * mask (bit i set means pTriggers[i] fired). An ascending
+             * trigger fires if the value raises from below its
+             * TriggerPoint to at least TriggerPoint, a descending trigger
+             * if the value falls from above its TriggerPoint to at most
+             * TriggerPoint. This is evaluated by two table lookups, without
+             * iterating over the triggers.
+             *
+             * The tables are computed when the rule is loaded; call
+             * UpdateTriggerTable() after altering Triggers or pTriggers.
+             */
+            inline uint32_t GetTriggeredMask(uint8_t PrevValue, uint8_t NewValue) const {
+                return (AscendingTriggers[NewValue & 127] & ~AscendingTriggers[PrevValue & 127]) |
+                       (DescendingTriggers[NewValue & 127] & ~DescendingTriggers[PrevValue & 127]);
+            }
+
         protected:
+            uint32_t AscendingTriggers[128];  ///< Bit i set if pTriggers[i] is ascending and its TriggerPoint is <= the value.
+            uint32_t DescendingTriggers[128]; ///< Bit i set if pTriggers[i] is descending and its TriggerPoint is >= the value.
+
             MidiRuleCtrlTrigger(RIFF::Chunk* _3ewg);
             MidiRuleCtrlTrigger();
             void UpdateChunks(uint8_t* pData) const;
@@ -1074,7 +2019,42 @@ namespace gig {
             bool Polyphonic;           ///< If alternator should step forward only when all notes are off
             bool Chained;              ///< If all patterns should be chained together
 
+            /** @brief Compact playback state of an alternator.
+             *
+             * Everything a sampler engine has to keep per instrument (or
+             * per MIDI channel) to evaluate this rule, see SelectPattern()
+             * and NextArticulation().
+             */
+            struct state_t {
+                uint8_t Pattern; ///< Index of the current pattern.
+                uint8_t Step;    ///< Current step within the current pattern.
+                state_t() : Pattern(0), Step(0) { }
+            };
+
+            void UpdateSelectorTable();
+
+            /**
+             * Selects the pattern chosen by MIDI key @a Key (if Selector is
+             * selector_key_switch) or by controller value @a Key (if
+             * Selector is selector_controller) and restarts it. This is a
+             * single table lookup.
+             *
+             * @returns true if @a State was changed, false if @a Key does
+             *          not select a pattern
+             */
+            inline bool SelectPattern(state_t& State, uint8_t Key) const {
+                const uint8_t pattern = SelectorPattern[Key & 127];
+                if (pattern == 0xff) return false;
+                State.Pattern = pattern;
+                State.Step    = 0;
+                return true;
+            }
+
+            uint8_t NextArticulation(state_t& State) const;
+
         protected:
+            uint8_t SelectorPattern[128]; ///< Pattern selected by each key / controller value, 0xff for none (see UpdateSelectorTable()).
+
             MidiRuleAlternator(RIFF::Chunk* _3ewg);
             MidiRuleAlternator();
             void UpdateChunks(uint8_t* pData) const;
@@ -1096,7 +2076,7 @@ namespace gig {
      */
     class MidiRuleUnknown : public MidiRule {
         protected:
-            MidiRuleUnknown() { }
+            MidiRuleUnknown() : MidiRule(TYPE_UNKNOWN) { }
             void UpdateChunks(uint8_t* pData) const { }
             friend class Instrument;
     };
@@ -1120,6 +2100,10 @@ namespace gig {
      * - <a href="http://doc.linuxsampler.org/Instrument_Scripts/NKSP_Language">Introduction to the NKSP Script Language</a>
      * - <a href="http://doc.linuxsampler.org/Instrument_Scripts/NKSP_Language/Reference/">NKSP Reference Manual</a>
      * - <a href="http://doc.linuxsampler.org/Gigedit/Managing_Scripts">Using Instrument Scripts with Gigedit</a>
+     *
+     * Along with its source code, a script may also store compiled (or
+     * tokenized) forms of itself, created by a sampler engine for faster
+     * loading next time (see SetCompiledCache() and GetCompiledCache()).
      */
     class Script {
         public:
@@ -1127,7 +2111,8 @@ namespace gig {
                 ENCODING_ASCII = 0 ///< Standard 8 bit US ASCII character encoding (default).
             };
             enum Compression_t {
-                COMPRESSION_NONE = 0 ///< Is not compressed at all (default).
+                COMPRESSION_NONE = 0, ///< Is not compressed at all (default).
+                COMPRESSION_LZSS = 1  ///< Script text (and compiled caches) are compressed with a simple, byte oriented LZSS algorithm. Such scripts cannot be read by libgig versions prior to this compression mode.
             };
             enum Language_t {
                 LANGUAGE_NKSP = 0 ///< NKSP stands for "Is Not KSP" (default). Refer to the <a href="http://doc.linuxsampler.org/Instrument_Scripts/NKSP_Language/Reference/">NKSP Reference Manual</a> for details about this script language. 
@@ -1144,6 +2129,9 @@ namespace gig {
             void   SetGroup(ScriptGroup* pGroup);
             ScriptGroup* GetGroup() const;
             void   CopyAssign(const Script* orig);
+            bool   GetCompiledCache(const String& EngineVersion, std::vector<uint8_t>& Data);
+            void   SetCompiledCache(const String& EngineVersion, const std::vector<uint8_t>& Data);
+            void   ClearCompiledCache();
         protected:
             Script(ScriptGroup* group, RIFF::Chunk* ckScri);
             virtual ~Script();
@@ -1151,11 +2139,29 @@ namespace gig {
             void RemoveAllScriptReferences();
             friend class ScriptGroup;
             friend class Instrument;
+            friend class File; // for memory accounting
         private:
+            /// Compiled form of this script for one engine version (stored as 'LSBC' chunk directly behind the 'Scri' chunk).
+            struct compiled_cache_t {
+                String               EngineVersion; ///< Arbitrary engine (version) identifier the compiled data was created by.
+                uint32_t             ScriptCRC;     ///< CRC-32 checksum of the script text the compiled data was created from.
+                uint32_t             Compression;   ///< Compression of @c Data (Compression_t), as it was stored in the file.
+                std::vector<uint8_t> Data;
+                RIFF::Chunk*         pChunk;        ///< 'LSBC' chunk, NULL if not saved yet.
+            };
+
             ScriptGroup*          pGroup;
             RIFF::Chunk*          pChunk; ///< 'Scri' chunk
             std::vector<uint8_t>  data;
+            bool                  bDataLoaded; ///< Whether @c data was read from the 'Scri' chunk already (see __ensureDataLoaded()).
+            uint32_t              dataOffset;  ///< Position of the script text within the 'Scri' chunk.
             uint32_t              crc; ///< CRC-32 checksum of the raw script data
+            std::list<compiled_cache_t> compiledCaches;
+
+            void     __ensureDataLoaded();
+            uint32_t __scriptCRC();
+            void     __loadCompiledCache(RIFF::Chunk* ckLSBC);
+            void     __updateCompiledCacheChunks();
     };
 
     /** @brief Group of instrument scripts (gig format extension).
@@ -1176,6 +2182,7 @@ namespace gig {
             Script*  GetScript(uint index);
             Script*  AddScript();
             void     DeleteScript(Script* pScript);
+            void     SetName(const String& name);
         protected:
             ScriptGroup(File* file, RIFF::List* lstRTIS);
             virtual ~ScriptGroup();
@@ -1230,18 +2237,36 @@ namespace gig {
             // overridden methods
             Region*   GetFirstRegion();
             Region*   GetNextRegion();
+            Region*   GetRegionAt(size_t pos);
+            size_t    CountRegions();
             Region*   AddRegion();
             void      DeleteRegion(Region* pRegion);
             void      MoveTo(Instrument* dst);
             virtual void UpdateChunks(progress_t* pProgress);
             virtual void CopyAssign(const Instrument* orig);
             // own methods
+            void      SetName(const String& name);
             Region*   GetRegion(unsigned int Key);
+            Region* const* GetRegionsOfKey(unsigned int Key, size_t& Count) const;
+            void      GetDimensionRegionsByValue(const uint* pKeys, const uint DimValues[][8], DimensionRegion** pDimRgns, size_t Count);
+            void      PredictNextDimensionRegions(uint Key, const uint DimValues[8], std::vector<DimensionRegion*>& DimRgns, uint Notes = 1, const MidiRuleAlternator::state_t* pAlternatorState = NULL);
+            size_t    PrefetchNextNotes(uint Key, const uint DimValues[8], file_offset_t SampleCount, uint Notes = 1, const MidiRuleAlternator::state_t* pAlternatorState = NULL);
             MidiRule* GetMidiRule(int i);
             MidiRuleCtrlTrigger* AddMidiRuleCtrlTrigger();
             MidiRuleLegato*      AddMidiRuleLegato();
             MidiRuleAlternator*  AddMidiRuleAlternator();
             void      DeleteMidiRule(int i);
+            preload_plan_t GetPreloadPlan(file_offset_t SampleCount, const range_t* pKeyRange = NULL, const range_t* pVelocityRange = NULL);
+            preload_plan_t GetPreloadPlan(const preload_policy_t& Policy, const range_t* pKeyRange = NULL, const range_t* pVelocityRange = NULL);
+            preload_plan_t GetStartupPlan(const preload_policy_t& Policy, uint Key = 60, uint Velocity = 64);
+            void      Preload(const preload_plan_t& Plan, uint NullSamplesCount = 0);
+            void      Unload(bool bReleaseSamples = true);
+            void      Reload(progress_t* pProgress = NULL);
+            bool      IsLoaded() const;
+            void      SetNumaNode(int Node);
+            bool      IsSharingRegions() const;
+            void      UnshareRegions();
+            memory_usage_t GetMemoryUsage() const;
             // real-time instrument script methods
             Script*   GetScriptOfSlot(uint index);
             void      AddScriptSlot(Script* pScript, bool bypass = false);
@@ -1253,6 +2278,8 @@ namespace gig {
             void      SetScriptSlotBypassed(uint index, bool bBypass);
         protected:
             Region*   RegionKeyTable[128]; ///< fast lookup for the corresponding Region of a MIDI key
+            std::vector<Region*> KeyRegions;    ///< All Regions covering MIDI key i are KeyRegions[KeyRegionsOffset[i]] to KeyRegions[KeyRegionsOffset[i+1] - 1] (see GetRegionsOfKey()).
+            uint32_t  KeyRegionsOffset[129];    ///< Start index of each MIDI key's Regions in KeyRegions.
 
             Instrument(File* pFile, RIFF::List* insList, progress_t* pProgress = NULL);
            ~Instrument();
@@ -1260,9 +2287,28 @@ namespace gig {
             void UpdateRegionKeyTable();
             void LoadScripts();
             void UpdateScriptFileOffsets();
+            void __updateScriptFileOffsetsInRAM(int fileOffsetSize);
             friend class File;
             friend class Region; // so Region can call UpdateRegionKeyTable()
         private:
+            bool bUnloaded; ///< True if the regions were freed by Unload().
+            int NumaNode; ///< NUMA placement applied to the samples of this instrument (see SetNumaNode()).
+            std::map<String, DimensionRegion*>* pArticulations; ///< Dimension regions by their raw articulation data, only while the regions are loaded with articulation sharing enabled (see File::SetArticulationSharing()).
+            Instrument* pRegionSource; ///< Instrument whose regions this duplicate shares instead of having own ones, NULL otherwise (see File::AddDuplicateInstrument()).
+            std::vector<Instrument*> RegionSharers; ///< Duplicates sharing the regions of this instrument.
+
+            void __loadRegions(progress_t* pProgress);
+            void __collectPreloadNeeds(preload_needs_t& needs, const range_t* pKeyRange, const range_t* pVelocityRange);
+            static preload_plan_t __planPreload(const preload_needs_t& needs, const preload_policy_t& Policy);
+            void __loadPendingDimensions();
+            void __loadMidiRules();
+            void __copyAttributes(const Instrument* orig);
+            void __copyRegions(const Instrument* orig, const std::map<Sample*,Sample*>* mSamples);
+            void __shareRegionsOf(Instrument* orig);
+            void __detachRegionSource();
+            void __unshareDuplicates();
+            Instrument* __regionOwner() { return (pRegionSource) ? pRegionSource : this; }
+            Region* __regionAt(size_t pos);
             struct _ScriptPooolEntry {
                 uint32_t fileOffset;
                 bool     bypass;
@@ -1272,6 +2318,7 @@ namespace gig {
                 bool     bypass;
             };
             MidiRule** pMidiRules;
+            RIFF::Chunk* pMidiRulesChunk; ///< '3ewg' chunk the MIDI rules are still to be parsed from, NULL if parsed already (see __loadMidiRules()).
             std::vector<_ScriptPooolEntry> scriptPoolFileOffsets;
             std::vector<_ScriptPooolRef>* pScriptRefs;
     };
@@ -1293,16 +2340,57 @@ namespace gig {
 
             Sample* GetFirstSample();
             Sample* GetNextSample();
+            Sample* GetSample(size_t index);
+            size_t  CountSamples();
             void AddSample(Sample* pSample);
+            preload_plan_t GetPreloadPlan(file_offset_t SampleCount);
+            void    Preload(file_offset_t SampleCount, uint NullSamplesCount = 0);
+            void    ReleaseSampleData();
+            sample_footprint_t GetFootprint();
+            void    SetName(const String& name);
         protected:
             Group(File* file, RIFF::Chunk* ck3gnm);
             virtual ~Group();
             virtual void UpdateChunks(progress_t* pProgress);
             void MoveAll();
             friend class File;
+            friend class Sample;
         private:
             File*        pFile;
             RIFF::Chunk* pNameChunk; ///< '3gnm' chunk
+            std::vector<Sample*> Samples; ///< Samples assigned to this group.
+            size_t       SamplesIterator;
+
+            void __removeSample(Sample* pSample);
+    };
+
+    /** @brief I/O and decoding statistics of a gig file.
+     *
+     * Snapshot returned by File::GetStatistics(). The counters are
+     * accumulated since the File object was created or since the last
+     * File::ResetStatistics() call, and they are always zero if libgig was
+     * compiled with statistics disabled (configure --disable-statistics).
+     */
+    struct statistics_t {
+        RIFF::io_statistics_t IO;        ///< I/O statistics of the .gig file and all its extension files (.gx01, .gx02, ...) summed up.
+        uint64_t ReadCalls;              ///< Amount of sample data reads (by Sample::Read(), SampleReader::Read() and friends, the loop variants perform one read per loop cycle).
+        uint64_t ReadNanoseconds;        ///< Total time spent in those sample data reads (in nanoseconds, including I/O and decompression).
+        uint64_t DecompressedBytes[6];   ///< Amount of bytes decoded from compressed samples, for each compression mode (0 and 1 used by 16 bit samples, 2 to 5 by 24 bit samples).
+        uint64_t ScanCalls;              ///< Amount of compressed samples scanned (see File::ScanSamples()).
+        uint64_t ScanNanoseconds;        ///< Total time spent for scanning compressed samples (in nanoseconds).
+    };
+
+    /** @brief Order of the samples in the wave pool when saving (see File::SetWavePoolOrder()). */
+    enum wave_pool_order_t {
+        wave_pool_order_unchanged = 0,  ///< Samples are stored in their current order (default).
+        wave_pool_order_by_instruments  ///< Samples are grouped by the instruments, regions and dimension regions using them.
+    };
+
+    /** @brief Format of the sample points of 24 bit samples in RAM caches (see File::SetRAMCacheFormat()). */
+    enum ram_cache_format_t {
+        ram_cache_format_native = 0,     ///< Sample points are cached as they are (default).
+        ram_cache_format_16bit,          ///< Sample points are rounded to 16 bit.
+        ram_cache_format_16bit_dithered  ///< Sample points are reduced to 16 bit with TPDF dither.
     };
 
     /** @brief Provides convenient access to Gigasampler/GigaStudio .gig files.
@@ -1360,22 +2448,32 @@ namespace gig {
             using DLS::File::Save;
             using DLS::File::GetFileName;
             using DLS::File::SetFileName;
+            using DLS::File::SetNumaNode;
+            using DLS::File::GetNumaNode;
             // overridden  methods
             File();
             File(RIFF::File* pRIFF);
+            static File* TryOpen(RIFF::File* pRIFF, RIFF::probe_result_t* pResult = NULL);
             Sample*     GetFirstSample(progress_t* pProgress = NULL); ///< Returns a pointer to the first <i>Sample</i> object of the file, <i>NULL</i> otherwise.
             Sample*     GetNextSample();      ///< Returns a pointer to the next <i>Sample</i> object of the file, <i>NULL</i> otherwise.
             Sample*     GetSample(uint index);
             Sample*     AddSample();
+            std::vector<Sample*> ImportSamples(const std::vector<sample_import_t>& Imports, int ThreadCount = 0, progress_t* pProgress = NULL);
+            std::vector<Sample*> ImportSamples(const std::vector<sample_import_t>& Imports, const String& Path, int ThreadCount = 0, progress_t* pProgress = NULL);
             size_t      CountSamples();
+            void        GetSampleTable(sample_table_t& Table);
             void        DeleteSample(Sample* pSample);
             Instrument* GetFirstInstrument(); ///< Returns a pointer to the first <i>Instrument</i> object of the file, <i>NULL</i> otherwise.
             Instrument* GetNextInstrument();  ///< Returns a pointer to the next <i>Instrument</i> object of the file, <i>NULL</i> otherwise.
             Instrument* GetInstrument(uint index, progress_t* pProgress = NULL);
+            Instrument* GetInstrument(const String& name, progress_t* pProgress = NULL);
+            Instrument* LoadInstrument(uint index, progress_t* pProgress = NULL);
             Instrument* AddInstrument();
-            Instrument* AddDuplicateInstrument(const Instrument* orig);
+            Instrument* AddDuplicateInstrument(const Instrument* orig, bool bShareRegions = false);
             size_t      CountInstruments();
             void        DeleteInstrument(Instrument* pInstrument);
+            preload_plan_t GetPreloadPlan(const preload_policy_t& Policy, progress_t* pProgress = NULL);
+            void        Preload(const preload_plan_t& Plan, uint NullSamplesCount = 0);
             Group*      GetFirstGroup(); ///< Returns a pointer to the first <i>Group</i> object of the file, <i>NULL</i> otherwise.
             Group*      GetNextGroup();  ///< Returns a pointer to the next <i>Group</i> object of the file, <i>NULL</i> otherwise.
             Group*      GetGroup(uint index);
@@ -1385,7 +2483,46 @@ namespace gig {
             void        DeleteGroupOnly(Group* pGroup);
             void        SetAutoLoad(bool b);
             bool        GetAutoLoad();
-            void        AddContentOf(File* pFile);
+            void        SetLazySampleScan(bool b);
+            bool        GetLazySampleScan() const;
+            void        SetLazyDimensionRegions(bool b);
+            bool        GetLazyDimensionRegions() const;
+            void        SetFrameTableChunks(bool b);
+            bool        GetFrameTableChunks() const;
+            void        SetBlockChecksums(bool b);
+            bool        GetBlockChecksums() const;
+            void        SetArticulationSharing(bool b);
+            bool        GetArticulationSharing() const;
+            void        SetWavePoolOrder(wave_pool_order_t Order);
+            wave_pool_order_t GetWavePoolOrder() const;
+            void        SetRAMCacheFormat(ram_cache_format_t Format);
+            ram_cache_format_t GetRAMCacheFormat() const;
+            void        SetSaveThreadCount(int ThreadCount);
+            int         GetSaveThreadCount() const;
+            void        SetBrowseMode(bool b);
+            bool        GetBrowseMode() const;
+            void        LeaveBrowseMode(progress_t* pProgress = NULL);
+            void        SetLoopCacheLimit(file_offset_t MaxLoopSize);
+            file_offset_t GetLoopCacheLimit() const;
+            void        SetLoopCacheBudget(file_offset_t MaxTotalSize);
+            file_offset_t GetLoopCacheBudget() const;
+            void        ScanSamples(int ThreadCount = 0, progress_t* pProgress = NULL);
+            void        AnalyzeSamples(float SilenceThreshold = 0.001f, int ThreadCount = 0, progress_t* pProgress = NULL);
+            void        LoadAllInstruments(int ThreadCount = 0, progress_t* pProgress = NULL);
+            std::vector<Sample*> VerifySamples(int ThreadCount = 0, progress_t* pProgress = NULL);
+            void        SaveSequential(const String& Path, sample_source_t Source, void* pUserData = NULL, progress_t* pProgress = NULL);
+            void        SaveSequential(RIFF::IODevice* pSink, sample_source_t Source, void* pUserData = NULL, progress_t* pProgress = NULL);
+            bool        LoadIndexCache(const String& CacheFileName);
+            bool        SaveIndexCache(const String& CacheFileName);
+            InstrumentSnapshot* GetInstrumentSnapshot(uint index, const String& SnapshotFileName);
+            void        SaveInstrumentSnapshot(uint index, const String& SnapshotFileName);
+            statistics_t GetStatistics() const;
+            void        ResetStatistics();
+            void        SetTracer(RIFF::tracer_t* pTracer);
+            RIFF::tracer_t* GetTracer() const;
+            memory_usage_t GetMemoryUsage() const;
+            void        AddContentOf(File* pFile, bool bDeduplicateSamples = false);
+            void        ExportInstruments(const std::vector<uint>& Instruments, const String& Path, progress_t* pProgress = NULL);
             ScriptGroup* GetScriptGroup(uint index);
             ScriptGroup* GetScriptGroup(const String& name);
             ScriptGroup* AddScriptGroup();
@@ -1406,18 +2543,287 @@ namespace gig {
             uint32_t GetSampleChecksum(Sample* pSample);
             uint32_t GetSampleChecksumByIndex(int index);
             bool VerifySampleChecksumTable();
-            bool RebuildSampleChecksumTable();
+            bool RebuildSampleChecksumTable(int ThreadCount = 0, progress_t* pProgress = NULL);
             int  GetWaveTableIndexOf(gig::Sample* pSample);
             friend class Region;
+            friend class DimensionRegion; // for deferring its chunk data on save
             friend class Sample;
             friend class Instrument;
             friend class Group; // so Group can access protected member pRIFF
             friend class ScriptGroup; // so ScriptGroup can access protected member pRIFF
+            friend class SampleReader; // for updating the statistics
         private:
             std::list<Group*>*          pGroups;
             std::list<Group*>::iterator GroupsIterator;
             bool                        bAutoLoad;
+            bool                        bBrowseMode;
+            bool                        bLazySampleScan;
+            bool                        bLazyDimensionRegions; ///< Whether the dimension regions of loaded regions are constructed on first access (see SetLazyDimensionRegions()).
+            bool                        bFrameTableChunks; ///< Whether compressed samples' frame tables are stored with the file (see SetFrameTableChunks()).
+            bool                        bBlockChecksums;   ///< Whether missing block checksums of samples are calculated and stored by the next save (see SetBlockChecksums()).
+            bool                        bArticulationSharing;
+            wave_pool_order_t           WavePoolOrder;     ///< Order the samples are stored in by the next save (see SetWavePoolOrder()).
+            file_offset_t               LoopCacheLimit;    ///< Max. size (in bytes) of a decoded loop body kept in RAM, 0 if disabled (see SetLoopCacheLimit()).
+            file_offset_t               LoopCacheBudget;   ///< Max. size (in bytes) of all decoded loop bodies of this file kept in RAM, 0 if unlimited (see SetLoopCacheBudget()), guarded by the loop cache mutex.
+            file_offset_t               LoopCacheUsed;     ///< Size (in bytes) of all decoded loop bodies of this file currently kept in RAM, guarded by the loop cache mutex.
+            std::list<Sample::loop_cache_t*> LoopCacheLRU; ///< Decoded loop bodies of all samples of this file, most recently used first, guarded by the loop cache mutex.
+            ram_cache_format_t          RAMCacheFormat;    ///< Format of 24 bit sample points in RAM caches (see SetRAMCacheFormat()).
             std::list<ScriptGroup*>*    pScriptGroups;
+            std::map<uint32_t, Script*> ScriptOffsetIndex; ///< All scripts by the file offset of their 'Scri' chunk (see __findScriptByFileOffset()).
+            bool                        bScriptOffsetIndexValid;
+            std::vector< std::pair<uint64_t, Sample*> > WavePoolIndex; ///< Samples sorted by wave pool offset (see __findSampleByWavePoolOffset()).
+            bool                        bWavePoolIndexValid;
+            bool                        bWavePoolIndex64;
+            std::vector<SampleList::iterator>     SampleIndex;     ///< Random access to pSamples (see __ensureSampleIndex()).
+            std::vector<InstrumentList::iterator> InstrumentIndex; ///< Random access to pInstruments (see __ensureInstrumentIndex()).
+            bool                        bSampleIndexValid;
+            bool                        bInstrumentIndexValid;
+            std::multimap<uint64_t, Group*>       GroupNameIndex;       ///< Groups by the hash of their names (see GetGroup(String)).
+            std::multimap<uint64_t, ScriptGroup*> ScriptGroupNameIndex; ///< Script groups by the hash of their names (see GetScriptGroup(const String&)).
+            std::multimap<uint64_t, uint>         InstrumentNameIndex;  ///< Instrument indices by the hash of the instruments' names (see GetInstrument(const String&, progress_t*)).
+            bool                        bGroupNameIndexValid;
+            bool                        bScriptGroupNameIndexValid;
+            bool                        bInstrumentNameIndexValid;
+            bool                        bSampleReferencesValid; ///< Whether the References of all samples reflect the currently loaded instruments (see __ensureSampleReferences()).
+            std::vector<RIFF::List*>    InstrumentLists;   ///< Unparsed 'ins ' lists of all instruments while pInstruments is not loaded yet (see LoadInstrument()).
+            std::vector<Instrument*>    SingleInstruments; ///< Instruments loaded individually by LoadInstrument(), same indices as InstrumentLists.
+            statistics_t                Statistics;        ///< Decoding counters (updated atomically, the IO member is not used, see GetStatistics()).
+            std::vector<int>            PendingExtensionFiles; ///< Numbers of the extension files (*.gx01, *.gx02, ...) not opened yet, ascending (see LoadSamples()).
+            int                         SaveThreadCount;   ///< Amount of threads storing the dimension regions' chunk data on save (see SetSaveThreadCount()).
+            bool                        bDeferDimensionRegionData; ///< True while UpdateChunks() collects the dimension regions in DeferredDimensionRegions instead of letting them store their chunk data immediately.
+            std::vector<DimensionRegion*> DeferredDimensionRegions; ///< Dimension regions whose chunk data is stored by the worker threads of UpdateChunks().
+            std::vector< std::pair<Sample*, int> > WavePoolTableIndex; ///< Wave pool table index of each sample sorted by sample, only valid during UpdateChunks() (see __wavePoolTableIndex()).
+
+            static void __scanSampleJob(void* arg, size_t index);
+            static void __loadInstrumentJob(void* arg, size_t index);
+            static void __checksumSampleJob(void* arg, size_t index);
+            static void __analyzeSampleJob(void* arg, size_t index);
+            static void __storeDimensionRegionJob(void* arg, size_t index);
+            static void __importChecksumJob(void* arg, size_t index);
+            std::vector<Sample*> __importSamples(const std::vector<sample_import_t>& Imports, const String* pPath, int ThreadCount, progress_t* pProgress);
+            void        __calculateSampleChecksums(std::vector<uint32_t>& checksums, std::vector<String>& errors, int ThreadCount, progress_t* pProgress);
+            static file_offset_t __sequentialSampleSource(RIFF::Chunk* pChunk, void* pBuffer, file_offset_t Size, void* pUserData);
+            void        __saveSequential(const String* pPath, RIFF::IODevice* pSink, sample_source_t Source, void* pUserData, progress_t* pProgress, const std::map<Sample*,Sample*>* pOriginals = NULL);
+            uint32_t    __indexCacheKey();
+            Sample*     __findSampleByWavePoolOffset(uint64_t Offset, file_offset_t FileNo, bool b64Bit);
+            Script*     __findScriptByFileOffset(uint32_t Offset);
+            void        __ensureSampleIndex();
+            void        __loadExtensionFile(int FileNo);
+            void        __ensureAllSamplesLoaded(progress_t* pProgress = NULL);
+            void        __ensureInstrumentIndex();
+            void        __ensureGroupNameIndex();
+            void        __ensureScriptGroupNameIndex();
+            void        __ensureInstrumentNameIndex();
+            void        __ensureInstrumentLists();
+            Instrument* __takeSingleInstrument(size_t index);
+            void        __keepLoadedInstruments();
+            void        __discardLoadedSamples(const std::vector<Sample*>& samples, bool bDeleteList);
+            Instrument* __loadInstrument(RIFF::List* lstInstr, size_t index, progress_t* pProgress);
+            void        __releaseUnusedSampleData(std::set<Sample*>& samples);
+            void        __ensureSampleReferences();
+            void        __shrinkLoopCaches();
+            void        __orderWavePoolByInstruments();
+            int         __wavePoolTableIndex(Sample* pSample);
+            void        __storeDimensionRegions();
+            void        __buildInstrumentSnapshot(uint index, std::vector<uint8_t>& data);
+            bool        __isValidInstrumentSnapshot(const uint8_t* pData, size_t Size, uint index);
+    };
+
+    /** @brief Flat, memory mapped copy of an instrument's playback data.
+     *
+     * Loading an instrument of a large gig file means parsing thousands of
+     * chunks and creating as many objects. An instrument snapshot stores
+     * everything a sampler engine needs for triggering voices with an
+     * instrument (its regions, their dimension definitions and the playback
+     * parameters of all dimension regions, see playback_params_t) as one
+     * flat binary file, which is just mapped into memory and used directly,
+     * so switching to an instrument takes a fraction of a millisecond. See
+     * File::GetInstrumentSnapshot().
+     *
+     * A snapshot is only valid for the exact gig file it was created from;
+     * the samples are resolved from the File object the snapshot was
+     * opened with, so the snapshot must be deleted before that File object.
+     * All methods are const and none of them allocate memory, so they may
+     * be called from a realtime thread.
+     */
+    class InstrumentSnapshot {
+        public:
+            String   GetName() const;
+            uint     GetInstrumentIndex() const;
+            uint32_t GetMIDIBank() const;
+            uint32_t GetMIDIProgram() const;
+            range_t  GetDimensionKeyRange() const;
+            bool     IsMapped() const;
+            size_t   CountRegions() const;
+            const snapshot_region_t* GetRegion(size_t index) const;
+            const snapshot_region_t* GetRegionByKey(uint8_t Key) const;
+            int      GetDimensionRegionIndexByValue(const snapshot_region_t* pRegion, const uint DimValues[8]) const;
+            const snapshot_dimension_region_t* GetDimensionRegion(const snapshot_region_t* pRegion, uint index) const;
+            const snapshot_dimension_region_t* GetDimensionRegionByValue(const snapshot_region_t* pRegion, const uint DimValues[8]) const;
+            virtual ~InstrumentSnapshot();
+        protected:
+            InstrumentSnapshot(File* pFile, uint8_t* pData, size_t Size, bool bMapped);
+            friend class File;
+        private:
+            uint8_t*                     pData;    ///< The whole snapshot (mapped or allocated aligned to cache lines).
+            size_t                       DataSize;
+            bool                         bMapped;
+            const snapshot_header_t*     pHeader;
+            const snapshot_region_t*     pRegions;
+            snapshot_dimension_region_t* pDimensionRegions;
+
+            InstrumentSnapshot(const InstrumentSnapshot&); // not copyable
+            InstrumentSnapshot& operator=(const InstrumentSnapshot&);
+    };
+
+    /** @brief Stages of loading a gig file in the background (see FileLoader). */
+    enum file_load_stage_t {
+        file_load_pending = 0,        ///< Loading did not start yet.
+        file_load_opened,             ///< The RIFF tree was scanned and the File object was created.
+        file_load_instrument_playable, ///< Startup mode only: the startup instrument was loaded and may be played now (see FileLoader::GetStartupInstrument()), the heads of its samples are being preloaded.
+        file_load_instrument_warm,    ///< Startup mode only: the heads of all samples of the startup instrument are preloaded.
+        file_load_instruments_listed, ///< The names of all instruments are known (see FileLoader::GetInstrumentNames()).
+        file_load_samples_scanned,    ///< All samples were loaded and scanned.
+        file_load_complete,           ///< All instruments were loaded completely, the File may be used now.
+        file_load_failed              ///< Loading failed or was cancelled (see FileLoader::GetError()).
+    };
+
+    /** @brief Startup mode of a FileLoader (see FileLoader::FileLoader(const String&, const file_startup_t&, ...)). */
+    struct file_startup_t {
+        uint             Instrument;       ///< Index of the instrument to be made playable first.
+        uint             Key;              ///< The heads of samples played around this key are preloaded first (default: 60, middle C).
+        uint             Velocity;         ///< The heads of samples played around this velocity are preloaded first (default: 64).
+        preload_policy_t Policy;           ///< Sizes of the preloaded heads (see Instrument::GetStartupPlan()).
+        uint             NullSamplesCount; ///< Amount of silence sample points appended to each preloaded head.
+
+        file_startup_t(uint Instrument = 0) : Instrument(Instrument), Key(60), Velocity(64), NullSamplesCount(0) {}
+    };
+
+    /** @brief Loads a gig file in the background.
+     *
+     * Opening a gig file and loading its instruments may block for a long
+     * time with large files. A FileLoader performs all of this in the
+     * background: it scans the RIFF tree, lists the instruments (by
+     * loading them in browse mode, see File::SetBrowseMode()), loads and
+     * scans all samples and finally loads all instruments completely.
+     * Each reached stage is reported to an optional callback, so e.g. the
+     * instrument list can be shown before the samples were scanned.
+     *
+     * By default the loader uses its own thread. An application with its
+     * own thread pool can pass an executor function instead, which has to
+     * run the given job (exactly once) on any thread of its choice. If
+     * threads are not available on this system and no executor is given,
+     * the file is loaded synchronously by the constructor.
+     *
+     * The File object must not be accessed before the stage
+     * file_load_complete was reached, it is owned by the FileLoader and
+     * deleted along with it.
+     *
+     * In startup mode (see file_startup_t) one instrument is made playable
+     * first: as soon as its regions were loaded (stage
+     * file_load_instrument_playable) it may be played, while the loader
+     * preloads the heads of its samples in order of likely use (keys near
+     * middle C and medium velocities first, see
+     * Instrument::GetStartupPlan()) and then loads the rest of the file as
+     * usual. Until the stage file_load_complete was reached, only these
+     * methods may be used on the startup instrument and its objects:
+     * Instrument::GetRegion(), Instrument::GetRegionsOfKey(),
+     * Region::GetDimensionRegionByValue(), Region::GetDimensionRegionByBit()
+     * and reading with SampleReader objects (each with its own
+     * decompression buffer). ReadStartup() serves the preloaded heads which
+     * are already warm and falls back to reading synchronously for all
+     * others.
+     */
+    class FileLoader {
+        public:
+            /// Called by the loading thread for each reached stage, it must not throw, must not wait for a later stage and must not delete the loader.
+            typedef void (*stage_callback_t)(FileLoader* pLoader, file_load_stage_t Stage, void* pUserData);
+            /// Job function passed to an executor_t.
+            typedef void (*job_t)(void* arg);
+            /// Runs @a job with argument @a arg on any thread (see FileLoader()).
+            typedef void (*executor_t)(job_t job, void* arg, void* pUserData);
+
+            FileLoader(const String& Path, stage_callback_t Callback = NULL, void* pUserData = NULL,
+                       executor_t Executor = NULL, void* pExecutorData = NULL, int ThreadCount = 0);
+            FileLoader(const String& Path, const file_startup_t& Startup, stage_callback_t Callback = NULL, void* pUserData = NULL,
+                       executor_t Executor = NULL, void* pExecutorData = NULL, int ThreadCount = 0);
+           ~FileLoader();
+            file_load_stage_t   GetStage() const;
+            bool                Wait(file_load_stage_t Stage = file_load_complete) const;
+            float               GetProgress() const;
+            String              GetError() const;
+            std::vector<String> GetInstrumentNames() const;
+            File*               GetFile() const;
+            Instrument*         GetStartupInstrument() const;
+            buffer_t            GetStartupHead(Sample* pSample) const;
+            file_offset_t       ReadStartup(SampleReader& Reader, void* pBuffer, file_offset_t SampleCount) const;
+            void                Cancel();
+        private:
+            file_loader_t* p;
+
+            void __init(const String& Path, stage_callback_t Callback, void* pUserData, int ThreadCount);
+            void __start(executor_t Executor, void* pExecutorData);
+            void __loadStartup(progress_t* pProgress);
+            static void __run(void* arg);
+            void __reach(file_load_stage_t Stage);
+            FileLoader(const FileLoader&);            // not copyable
+            FileLoader& operator=(const FileLoader&); // not copyable
+    };
+
+    /** @brief Read-only gig file shared by several consumers.
+     *
+     * A File object is mutable and its traversal methods (e.g.
+     * File::GetFirstInstrument(), Instrument::GetNextRegion()) change
+     * iterator state, so a File must not be used by several threads at the
+     * same time. A SharedFile in contrast is a completely loaded, read-only
+     * snapshot of a gig file which may be used by any amount of threads
+     * (e.g. several sampler engines in one process) at the same time:
+     *
+     * - all instruments, regions, dimension regions and samples are loaded
+     *   and resolved (and compressed samples scanned) by Open(), so none of
+     *   the methods of this class modifies anything
+     * - instruments, regions and samples are accessed by index by the
+     *   methods of this class, Instrument::GetRegion(),
+     *   Instrument::GetRegionsOfKey(), Region::GetDimensionRegionByValue()
+     *   and Region::GetDimensionRegionByBit() may be used as well
+     * - sample data must be read by a separate SampleReader per consumer
+     *   (and voice), which is thread safe, not by the Sample's own Read()
+     *   methods
+     *
+     * The returned objects must not be modified in any way. Open() returns
+     * the same SharedFile for the same path as long as it is in use, so the
+     * file is only parsed (and its metadata only kept in RAM) once. It is
+     * reference counted: each successful Open() call and each Retain() call
+     * has to be balanced by a Release() call.
+     */
+    class SharedFile {
+        public:
+            static SharedFile* Open(const String& Path, int ThreadCount = 0, progress_t* pProgress = NULL);
+            void        Retain();
+            void        Release();
+            size_t      GetRefCount() const;
+            const String& GetPath() const;
+            const DLS::Info* GetInfo() const;
+            size_t      CountInstruments() const;
+            Instrument* GetInstrument(size_t index) const;
+            size_t      CountRegions(size_t InstrumentIndex) const;
+            Region*     GetRegion(size_t InstrumentIndex, size_t RegionIndex) const;
+            size_t      CountSamples() const;
+            Sample*     GetSample(size_t index) const;
+        private:
+            String      Path;
+            RIFF::File* pRiff;
+            File*       pFile;
+            size_t      RefCount; ///< guarded by the registry mutex of Open()
+            std::vector<Instrument*> Instruments;
+            std::vector< std::vector<Region*> > Regions; ///< Regions of each instrument, same indices as Instruments.
+            std::vector<Sample*>     Samples;
+
+            SharedFile(const String& Path);
+           ~SharedFile();
+            void __load(int ThreadCount, progress_t* pProgress);
+            SharedFile(const SharedFile&);            // not copyable
+            SharedFile& operator=(const SharedFile&); // not copyable
     };
 
     /**
@@ -1452,6 +2858,10 @@ namespace gig {
     String libraryName();
     String libraryVersion();
 
+    void          SetSampleSharing(bool Enable, bool Verify = true);
+    bool          GetSampleSharing();
+    file_offset_t GetSharedSampleMemorySaved();
+
 } // namespace gig
 
 #endif // __GIG_H__
@@ -51,3 +51,434 @@ int vasprintf(char** ret, const char* format, va_list arg) {
 }
 
 #endif // !HAVE_VASPRINTF && defined(WIN32)
+
+// *************** Parallel Execution **************
+// *
+
+#include <deque>
+#include <vector>
+
+#if POSIX
+# include <errno.h>
+# include <pthread.h>
+# include <time.h>
+#endif
+
+/**
+ * Returns the amount of CPU cores available on this system, or 1 if it
+ * cannot be determined.
+ */
+int __hardware_concurrency() {
+    #if POSIX
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? int(n) : 1;
+    #elif defined(WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (info.dwNumberOfProcessors > 0) ? int(info.dwNumberOfProcessors) : 1;
+    #else
+    return 1;
+    #endif
+}
+
+namespace {
+
+    // state shared by the calling thread and the helper tasks of one
+    // __parallel_for() call, freed by whoever releases it last (helper
+    // tasks may start after the call returned already)
+    struct parallel_for_t {
+        size_t         count;
+        size_t         next;      // next index to be processed
+        parallel_job_t job;
+        void*          arg;
+        int            refs;      // calling thread + helper tasks which did not return yet
+        int            running;   // helper tasks currently processing jobs
+        bool           closed;    // true once the calling thread returns, helper tasks starting later do nothing
+        mutex_t        mutex;
+        condition_t    idle;      // signalled when the last running helper task finished
+
+        // returns the next index to be processed by the calling thread, or
+        // count if there is no job left
+        size_t fetch() {
+            mutex_lock_t lock(mutex);
+            return (next < count) ? next++ : count;
+        }
+
+        // skips all jobs not started yet
+        void stop() {
+            mutex_lock_t lock(mutex);
+            next = count;
+        }
+
+        void release() {
+            bool bLast;
+            {
+                mutex_lock_t lock(mutex);
+                bLast = !--refs;
+            }
+            if (bLast) delete this;
+        }
+    };
+
+    void parallel_for_task(void* p) {
+        parallel_for_t* state = static_cast<parallel_for_t*>(p);
+        bool bClosed;
+        {
+            mutex_lock_t lock(state->mutex);
+            bClosed = state->closed;
+            if (!bClosed) state->running++;
+        }
+        if (!bClosed) {
+            for (size_t i = state->fetch(); i < state->count; i = state->fetch())
+                state->job(state->arg, i);
+            mutex_lock_t lock(state->mutex);
+            if (!--state->running) state->idle.broadcast();
+        }
+        state->release();
+    }
+
+} // anonymous namespace
+
+/**
+ * Calls @a job for each index between 0 and @a count - 1, distributed over
+ * @a threadCount threads (the calling thread being one of them, the others
+ * being tasks of the library's executor, see RIFF::SetExecutor()). Returns
+ * after all jobs are done. If the executor runs less tasks in parallel or
+ * threads are not available on this system, the jobs are distributed over
+ * less threads, all jobs are simply executed sequentially by the calling
+ * thread in the worst case.
+ *
+ * Progress (if requested) is only notified by the calling thread, so the
+ * progress callback does not have to be thread safe. If the callback
+ * requests cancellation (see RIFF::progress_t::cancel), all jobs not
+ * started yet are skipped, the jobs already running are still finished.
+ *
+ * @param count       - amount of jobs
+ * @param threadCount - amount of threads to use, <= 0 for one thread per
+ *                      CPU core
+ * @param job         - function to be called for each job
+ * @param arg         - user argument passed to @a job
+ * @param pProgress   - optional progress callback
+ * @returns false if jobs were skipped due to cancellation, true otherwise
+ */
+bool __parallel_for(size_t count, int threadCount, parallel_job_t job, void* arg, RIFF::progress_t* pProgress) {
+    if (threadCount <= 0) threadCount = __hardware_concurrency();
+    if (size_t(threadCount) > count) threadCount = int(count);
+    // more helpers than the executor runs in parallel would just queue up
+    if (threadCount - 1 > __executor_concurrency())
+        threadCount = __executor_concurrency() + 1;
+
+    parallel_for_t* state = new parallel_for_t;
+    state->count   = count;
+    state->next    = 0;
+    state->job     = job;
+    state->arg     = arg;
+    state->refs    = 1;
+    state->running = 0;
+    state->closed  = false;
+    for (int i = 1; i < threadCount; ++i) {
+        {
+            mutex_lock_t lock(state->mutex);
+            state->refs++;
+        }
+        if (!__execute(parallel_for_task, state, false)) {
+            mutex_lock_t lock(state->mutex);
+            state->refs--;
+            break;
+        }
+    }
+
+    // the calling thread works, too (and is the only one notifying progress)
+    bool bComplete = true;
+    for (size_t i = state->fetch(); i < count; i = state->fetch()) {
+        __notify_progress(pProgress, float(i) / float(count));
+        if (__cancel_requested(pProgress)) {
+            state->stop();
+            bComplete = false;
+            break;
+        }
+        job(arg, i);
+    }
+
+    // only wait for the helper tasks which are actually running
+    {
+        mutex_lock_t lock(state->mutex);
+        state->closed = true;
+        while (state->running) state->idle.wait(state->mutex);
+    }
+    state->release();
+
+    if (bComplete) __notify_progress(pProgress, 1.0f);
+    return bComplete;
+}
+
+// *************** Threads **************
+// *
+
+namespace {
+
+    struct thread_start_t {
+        thread_func_t func;
+        void*         arg;
+    };
+
+    #if POSIX
+    void* thread_main(void* p) {
+        thread_start_t start = *static_cast<thread_start_t*>(p);
+        delete static_cast<thread_start_t*>(p);
+        start.func(start.arg);
+        return NULL;
+    }
+    #elif defined(WIN32)
+    DWORD WINAPI thread_main(LPVOID p) {
+        thread_start_t start = *static_cast<thread_start_t*>(p);
+        delete static_cast<thread_start_t*>(p);
+        start.func(start.arg);
+        return 0;
+    }
+    #endif
+
+} // anonymous namespace
+
+/**
+ * Starts a new thread which calls @a func with argument @a arg. The thread
+ * must be joined by calling __join_thread() later on.
+ *
+ * @param thread - (out) handle of the new thread
+ * @param func   - function to be executed by the new thread
+ * @param arg    - user argument passed to @a func
+ * @returns true on success, false if the thread could not be created or if
+ *          threads are not available on this system
+ */
+bool __create_thread(thread_t& thread, thread_func_t func, void* arg) {
+    #if POSIX || defined(WIN32)
+    thread_start_t* start = new thread_start_t;
+    start->func = func;
+    start->arg  = arg;
+    #endif
+    #if POSIX
+    if (!pthread_create(&thread, NULL, thread_main, start)) return true;
+    #elif defined(WIN32)
+    thread = CreateThread(NULL, 0, thread_main, start, 0, NULL);
+    if (thread) return true;
+    #endif
+    #if POSIX || defined(WIN32)
+    delete start;
+    #endif
+    return false;
+}
+
+/**
+ * Waits until the given thread (started by __create_thread()) terminated
+ * and releases its resources.
+ */
+void __join_thread(thread_t& thread) {
+    #if POSIX
+    pthread_join(thread, NULL);
+    #elif defined(WIN32)
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    #endif
+}
+
+/**
+ * Suspends the calling thread for (at least) the given amount of
+ * microseconds (with the resolution of the system's scheduler).
+ */
+void __sleep_microseconds(unsigned int microseconds) {
+    #if POSIX
+    struct timespec ts;
+    ts.tv_sec  = microseconds / 1000000;
+    ts.tv_nsec = long(microseconds % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) && errno == EINTR);
+    #elif defined(WIN32)
+    Sleep((microseconds + 999) / 1000);
+    #endif
+}
+
+// *************** Executor **************
+// *
+
+namespace {
+
+    /**
+     * libgig's own thread pool, used if the application did not install an
+     * executor (see RIFF::SetExecutor()). It runs at most one short task
+     * per CPU core in parallel, plus each dedicated task on a thread of its
+     * own. Threads are created on demand and reused, the pool lives for
+     * the lifetime of the process.
+     */
+    class thread_pool_t {
+    public:
+        thread_pool_t() : maxThreads(__hardware_concurrency()), threads(0), busy(0), dedicated(0) {}
+
+        bool execute(thread_func_t func, void* arg, bool bDedicated) {
+            mutex_lock_t lock(mutex);
+            queued_task_t task = { func, arg, bDedicated };
+            queue.push_back(task);
+            if (bDedicated) dedicated++;
+            if (busy + queue.size() > size_t(threads) && threads < maxThreads + dedicated) {
+                thread_t thread;
+                if (__create_thread(thread, worker, this)) {
+                    threads++;
+                } else if (bDedicated || !threads) {
+                    queue.pop_back();
+                    if (bDedicated) dedicated--;
+                    return false;
+                }
+            }
+            wakeup.signal();
+            return true;
+        }
+
+    private:
+        struct queued_task_t {
+            thread_func_t func;
+            void*         arg;
+            bool          dedicated;
+        };
+
+        mutex_t                   mutex;
+        condition_t               wakeup;
+        std::deque<queued_task_t> queue;
+        const int                 maxThreads; ///< max. amount of short tasks running in parallel
+        int                       threads;   ///< amount of threads created
+        int                       busy;      ///< amount of threads currently running a task
+        int                       dedicated; ///< amount of dedicated tasks queued or running
+
+        static void worker(void* arg) {
+            thread_pool_t* pool = static_cast<thread_pool_t*>(arg);
+            mutex_lock_t lock(pool->mutex);
+            while (true) {
+                while (pool->queue.empty()) pool->wakeup.wait(pool->mutex);
+                const queued_task_t task = pool->queue.front();
+                pool->queue.pop_front();
+                pool->busy++;
+                pool->mutex.unlock();
+                task.func(task.arg);
+                pool->mutex.lock();
+                pool->busy--;
+                if (task.dedicated) pool->dedicated--;
+            }
+        }
+    };
+
+    thread_pool_t* pDefaultPool = NULL;
+    mutex_t        defaultPoolMutex;
+
+    thread_pool_t* defaultPool() {
+        mutex_lock_t lock(defaultPoolMutex);
+        if (!pDefaultPool) pDefaultPool = new thread_pool_t;
+        return pDefaultPool;
+    }
+
+    // state of a task started by __start_task()
+    struct task_state_t {
+        thread_func_t func;
+        void*         arg;
+        bool          finished;
+        mutex_t       mutex;
+        condition_t   done;
+    };
+
+    void run_task(void* p) {
+        task_state_t* task = static_cast<task_state_t*>(p);
+        task->func(task->arg);
+        mutex_lock_t lock(task->mutex);
+        task->finished = true;
+        task->done.broadcast();
+    }
+
+} // anonymous namespace
+
+/**
+ * Runs @a func with argument @a arg asynchronously by the executor
+ * installed by RIFF::SetExecutor(), or by libgig's own thread pool.
+ *
+ * @param func       - task to be executed, it must not throw
+ * @param arg        - user argument passed to @a func
+ * @param bDedicated - true if the task runs for a long time or waits for
+ *                     other threads, so it may not wait in a queue
+ * @returns false if the task could not be started (i.e. if threads are not
+ *          available on this system)
+ */
+bool __execute(thread_func_t func, void* arg, bool bDedicated) {
+    RIFF::executor_t* pExecutor = RIFF::GetExecutor();
+    if (pExecutor && pExecutor->execute)
+        return pExecutor->execute(pExecutor, func, arg, bDedicated);
+    #if POSIX || defined(WIN32)
+    return defaultPool()->execute(func, arg, bDedicated);
+    #else
+    return false;
+    #endif
+}
+
+/// Returns how many (short) tasks the executor runs in parallel.
+int __executor_concurrency() {
+    RIFF::executor_t* pExecutor = RIFF::GetExecutor();
+    if (pExecutor && pExecutor->execute && pExecutor->concurrency) {
+        const int n = pExecutor->concurrency(pExecutor);
+        return (n > 0) ? n : 1;
+    }
+    return __hardware_concurrency();
+}
+
+/**
+ * Starts @a func with argument @a arg as a task of the library's executor
+ * (see __execute()), which can be waited for by calling __wait_task(). The
+ * task must be waited for exactly once.
+ *
+ * @param task       - (out) handle of the new task
+ * @param func       - function to be executed, it must not throw
+ * @param arg        - user argument passed to @a func
+ * @param bDedicated - true if the task runs for a long time or waits for
+ *                     other threads (see __execute())
+ * @returns true on success, false if the task could not be started
+ */
+bool __start_task(task_t& task, thread_func_t func, void* arg, bool bDedicated) {
+    task_state_t* state = new task_state_t;
+    state->func     = func;
+    state->arg      = arg;
+    state->finished = false;
+    if (!__execute(run_task, state, bDedicated)) {
+        delete state;
+        return false;
+    }
+    task = state;
+    return true;
+}
+
+/**
+ * Waits until the given task (started by __start_task()) returned and
+ * releases its resources.
+ */
+void __wait_task(task_t& task) {
+    task_state_t* state = static_cast<task_state_t*>(task);
+    {
+        mutex_lock_t lock(state->mutex);
+        while (!state->finished) state->done.wait(state->mutex);
+    }
+    delete state;
+    task = NULL;
+}
+
+// *************** Files **************
+// *
+
+/**
+ * Returns the last modification time of the given file (in a system
+ * specific unit), or 0 if it cannot be determined.
+ */
+uint64_t __fileModificationTime(const std::string& path) {
+    #if POSIX
+    struct stat st;
+    if (stat(path.c_str(), &st)) return 0;
+    return uint64_t(st.st_mtime);
+    #elif defined(WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &attr)) return 0;
+    return uint64_t(attr.ftLastWriteTime.dwHighDateTime) << 32 | attr.ftLastWriteTime.dwLowDateTime;
+    #else
+    return 0;
+    #endif
+}
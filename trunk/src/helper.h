@@ -128,6 +128,16 @@ inline void store32(uint8_t* pData, uint32_t data) {
     pData[3] = data >> 24;
 }
 
+/**
+ * Loads a 16 bit integer in memory using little-endian format.
+ *
+ * @param pData - memory pointer
+ * @returns 16 bit data word
+ */
+inline uint16_t load16(uint8_t* pData) {
+    return uint16_t(pData[0] | pData[1] << 8);
+}
+
 /**
  * Loads a 32 bit integer in memory using little-endian format.
  *
@@ -260,6 +270,10 @@ inline void __notify_progress(RIFF::progress_t* pProgress, float subprogress) {
         const float totalprogress = pProgress->__range_min + subprogress * totalrange;
         pProgress->factor         = totalprogress;
         pProgress->callback(pProgress); // now actually notify about the progress
+        // a cancellation request applies to the whole operation
+        if (pProgress->cancel)
+            for (RIFF::progress_t* p = pProgress->__parent; p; p = p->__parent)
+                p->cancel = true;
     }
 }
 
@@ -271,7 +285,392 @@ inline void __divide_progress(RIFF::progress_t* pParentProgress, RIFF::progress_
         pSubProgress->custom      = pParentProgress->custom;
         pSubProgress->__range_min = pParentProgress->__range_min + totalrange * currentTask / totalTasks;
         pSubProgress->__range_max = pSubProgress->__range_min + totalrange / totalTasks;
+        pSubProgress->__parent    = pParentProgress;
+    }
+}
+
+// private helper function returning whether the progress callback requested
+// to cancel the operation (on the given progress or any of its parents)
+inline bool __cancel_requested(const RIFF::progress_t* pProgress) {
+    for (; pProgress; pProgress = pProgress->__parent)
+        if (pProgress->cancel) return true;
+    return false;
+}
+
+// *************** Parallel Execution **************
+// *
+
+/// Job function for __parallel_for(), it is called once for each index and must not throw.
+typedef void (*parallel_job_t)(void* arg, size_t index);
+
+int  __hardware_concurrency();
+bool __parallel_for(size_t count, int threadCount, parallel_job_t job, void* arg, RIFF::progress_t* pProgress = NULL);
+
+// *************** Mutual Exclusion **************
+// *
+
+#if POSIX
+# include <pthread.h>
+# include <sched.h>
+# include <time.h>
+#endif
+
+/// Simple non recursive mutex (does nothing if threads are not available on this system).
+class mutex_t {
+public:
+    mutex_t() {
+        #if POSIX
+        pthread_mutex_init(&m, NULL);
+        #elif defined(WIN32)
+        InitializeCriticalSection(&m);
+        #endif
+    }
+   ~mutex_t() {
+        #if POSIX
+        pthread_mutex_destroy(&m);
+        #elif defined(WIN32)
+        DeleteCriticalSection(&m);
+        #endif
+    }
+    void lock() {
+        #if POSIX
+        pthread_mutex_lock(&m);
+        #elif defined(WIN32)
+        EnterCriticalSection(&m);
+        #endif
+    }
+    void unlock() {
+        #if POSIX
+        pthread_mutex_unlock(&m);
+        #elif defined(WIN32)
+        LeaveCriticalSection(&m);
+        #endif
+    }
+private:
+    #if POSIX
+    pthread_mutex_t m;
+    #elif defined(WIN32)
+    CRITICAL_SECTION m;
+    #endif
+    mutex_t(const mutex_t&); // not copyable
+    mutex_t& operator=(const mutex_t&);
+    friend class condition_t;
+};
+
+/// Locks the given mutex for the lifetime of this object (scope guard).
+class mutex_lock_t {
+public:
+    mutex_lock_t(mutex_t& mutex) : m(mutex) { m.lock(); }
+   ~mutex_lock_t() { m.unlock(); }
+private:
+    mutex_t& m;
+    mutex_lock_t(const mutex_lock_t&); // not copyable
+    mutex_lock_t& operator=(const mutex_lock_t&);
+};
+
+/**
+ * Condition variable to be used together with mutex_t (does nothing if
+ * threads are not available on this system). signal() and broadcast() must
+ * be called while the associated mutex is locked.
+ */
+class condition_t {
+public:
+    condition_t() {
+        #if POSIX
+        pthread_cond_init(&c, NULL);
+        #elif defined(WIN32)
+        // (no CONDITION_VARIABLE, as it requires Windows Vista)
+        hSemaphore = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+        waiters = 0;
+        #endif
+    }
+   ~condition_t() {
+        #if POSIX
+        pthread_cond_destroy(&c);
+        #elif defined(WIN32)
+        CloseHandle(hSemaphore);
+        #endif
+    }
+    /// Atomically unlocks @a mutex (which must be locked by the caller),
+    /// waits for being signalled and locks @a mutex again.
+    void wait(mutex_t& mutex) {
+        #if POSIX
+        pthread_cond_wait(&c, &mutex.m);
+        #elif defined(WIN32)
+        waiters++;
+        LeaveCriticalSection(&mutex.m);
+        WaitForSingleObject(hSemaphore, INFINITE);
+        EnterCriticalSection(&mutex.m);
+        #endif
+    }
+    /// Wakes up one waiting thread.
+    void signal() {
+        #if POSIX
+        pthread_cond_signal(&c);
+        #elif defined(WIN32)
+        if (waiters) {
+            waiters--;
+            ReleaseSemaphore(hSemaphore, 1, NULL);
+        }
+        #endif
+    }
+    /// Wakes up all waiting threads.
+    void broadcast() {
+        #if POSIX
+        pthread_cond_broadcast(&c);
+        #elif defined(WIN32)
+        if (waiters) {
+            ReleaseSemaphore(hSemaphore, waiters, NULL);
+            waiters = 0;
+        }
+        #endif
+    }
+private:
+    #if POSIX
+    pthread_cond_t c;
+    #elif defined(WIN32)
+    HANDLE hSemaphore;
+    LONG   waiters; ///< amount of threads waiting (guarded by the associated mutex)
+    #endif
+    condition_t(const condition_t&); // not copyable
+    condition_t& operator=(const condition_t&);
+};
+
+// *************** Statistics **************
+// *
+// The I/O and decoding statistics (see RIFF::File::GetStatistics() and
+// gig::File::GetStatistics()) may be updated concurrently by several
+// streaming threads. Unless libgig is configured with --disable-statistics
+// (which defines LIBGIG_NO_STATISTICS), each update is one atomic add.
+
+/// Atomically adds @a n to @a counter.
+inline void __atomicAdd(uint64_t& counter, uint64_t n) {
+    #if defined(__GNUC__)
+    __sync_fetch_and_add(&counter, n);
+    #elif defined(WIN32)
+    InterlockedExchangeAdd64((volatile LONGLONG*) &counter, (LONGLONG) n);
+    #else
+    counter += n;
+    #endif
+}
+
+/// Atomically reads @a counter (which may be updated concurrently by __atomicAdd()).
+inline uint64_t __atomicGet(const uint64_t& counter) {
+    #if defined(__GNUC__)
+    return __sync_fetch_and_add(const_cast<uint64_t*>(&counter), 0);
+    #elif defined(WIN32)
+    return InterlockedCompareExchange64((volatile LONGLONG*) &counter, 0, 0);
+    #else
+    return counter;
+    #endif
+}
+
+// *************** Lock-free structures **************
+// *
+// Used by data structures shared by exactly one producer and one consumer
+// thread (i.e. gig::DiskStream ring buffers), where the consumer must
+// neither lock nor block.
+
+/// Reads @a value with acquire semantics (no later access is reordered before it).
+template<typename T> inline T __atomicLoadAcquire(const volatile T& value) {
+    T v = value;
+    #if defined(__GNUC__)
+    __sync_synchronize();
+    #elif defined(WIN32)
+    MemoryBarrier();
+    #endif
+    return v;
+}
+
+/// Writes @a v to @a value with release semantics (no earlier access is reordered after it).
+template<typename T> inline void __atomicStoreRelease(volatile T& value, T v) {
+    #if defined(__GNUC__)
+    __sync_synchronize();
+    #elif defined(WIN32)
+    MemoryBarrier();
+    #endif
+    value = v;
+}
+
+/// Atomically replaces @a value by @a desired if it equals @a expected, returns whether it was replaced (full barrier).
+inline bool __atomicCompareExchange(volatile long& value, long expected, long desired) {
+    #if defined(__GNUC__)
+    return __sync_bool_compare_and_swap(&value, expected, desired);
+    #elif defined(WIN32)
+    return InterlockedCompareExchange(&value, desired, expected) == expected;
+    #else
+    if (value != expected) return false;
+    value = desired;
+    return true;
+    #endif
+}
+
+/// Atomically increments @a value, returns the new value (full barrier).
+inline long __atomicIncrement(volatile long& value) {
+    #if defined(__GNUC__)
+    return __sync_add_and_fetch(&value, 1L);
+    #elif defined(WIN32)
+    return InterlockedIncrement(&value);
+    #else
+    return ++value;
+    #endif
+}
+
+/// Atomically decrements @a value, returns the new value (full barrier).
+inline long __atomicDecrement(volatile long& value) {
+    #if defined(__GNUC__)
+    return __sync_sub_and_fetch(&value, 1L);
+    #elif defined(WIN32)
+    return InterlockedDecrement(&value);
+    #else
+    return --value;
+    #endif
+}
+
+/// Gives up the rest of the calling thread's time slice (i.e. while waiting for other threads by spinning).
+inline void __yieldThread() {
+    #if POSIX
+    sched_yield();
+    #elif defined(WIN32)
+    Sleep(0);
+    #endif
+}
+
+/// Returns a monotonic time stamp in nanoseconds (for measuring durations only).
+inline uint64_t __monotonicNanoseconds() {
+    #if POSIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+    #elif defined(WIN32)
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return uint64_t(double(t.QuadPart) * 1e9 / double(f.QuadPart));
+    #else
+    return 0;
+    #endif
+}
+
+#if LIBGIG_NO_STATISTICS
+# define STATISTICS_ADD(counter, n)
+# define STATISTICS_TIMESTAMP(var)
+# define STATISTICS_ADD_DURATION(counter, var)
+#else
+/// Adds @a n to the statistics counter @a counter.
+# define STATISTICS_ADD(counter, n)             __atomicAdd(counter, n)
+/// Declares the local time stamp @a var (start of a measured duration).
+# define STATISTICS_TIMESTAMP(var)              const uint64_t var = __monotonicNanoseconds()
+/// Adds the time elapsed since time stamp @a var to the statistics counter @a counter (in nanoseconds).
+# define STATISTICS_ADD_DURATION(counter, var)  __atomicAdd(counter, __monotonicNanoseconds() - var)
+#endif
+
+// *************** Tracing **************
+// *
+
+// private helper function to report one event to a tracer (if any)
+inline void __trace(RIFF::tracer_t* pTracer, RIFF::trace_event_type_t Type, const void* pObject,
+                    RIFF::file_offset_t Offset = 0, RIFF::file_offset_t Size = 0,
+                    uint64_t Duration = 0, const char* pName = NULL)
+{
+    if (pTracer && pTracer->callback) {
+        RIFF::trace_event_t event;
+        event.Type     = Type;
+        event.pObject  = pObject;
+        event.Offset   = Offset;
+        event.Size     = Size;
+        event.Duration = Duration;
+        event.Name     = pName;
+        pTracer->callback(pTracer, &event);
     }
 }
 
+/**
+ * Reports a pair of @c _begin and @c _end trace events for the lifetime of
+ * this object (scope guard), so the @c _end event is reported even if the
+ * traced operation throws. Does nothing if @a pTracer is NULL.
+ */
+class trace_scope_t {
+public:
+    trace_scope_t(RIFF::tracer_t* pTracer, RIFF::trace_event_type_t BeginType, const void* pObject,
+                  RIFF::file_offset_t Offset = 0, RIFF::file_offset_t Size = 0, const char* pName = NULL)
+        : pTracer(pTracer)
+    {
+        if (!pTracer) return;
+        type = RIFF::trace_event_type_t(BeginType + 1);
+        this->pObject = pObject;
+        offset = Offset;
+        size   = Size;
+        name   = pName;
+        __trace(pTracer, BeginType, pObject, Offset, Size, 0, pName);
+        t0 = __monotonicNanoseconds();
+    }
+   ~trace_scope_t() {
+        if (pTracer)
+            __trace(pTracer, type, pObject, offset, size, __monotonicNanoseconds() - t0, name);
+    }
+    /// Sets the object, size and name reported by the @c _end event.
+    void SetResult(const void* pObject, RIFF::file_offset_t Size, const char* pName = NULL) {
+        this->pObject = pObject;
+        size = Size;
+        name = pName;
+    }
+    /// Sets the size reported by the @c _end event.
+    void SetResult(RIFF::file_offset_t Size) {
+        size = Size;
+    }
+private:
+    RIFF::tracer_t* pTracer;
+    RIFF::trace_event_type_t type;
+    const void* pObject;
+    RIFF::file_offset_t offset, size;
+    const char* name;
+    uint64_t t0;
+    trace_scope_t(const trace_scope_t&); // not copyable
+    trace_scope_t& operator=(const trace_scope_t&);
+};
+
+// *************** Threads **************
+// *
+
+#if POSIX
+typedef pthread_t thread_t;
+#elif defined(WIN32)
+typedef HANDLE thread_t;
+#else
+typedef int thread_t;
+#endif
+
+/// Thread function for __create_thread(), it must not throw.
+typedef void (*thread_func_t)(void* arg);
+
+bool __create_thread(thread_t& thread, thread_func_t func, void* arg);
+void __join_thread(thread_t& thread);
+void __sleep_microseconds(unsigned int microseconds);
+
+// *************** Executor **************
+// *
+// All threads of the library itself are tasks of the executor installed by
+// RIFF::SetExecutor() (or of libgig's own thread pool), so applications can
+// control on which threads libgig works.
+
+/// Handle of a task started by __start_task().
+typedef void* task_t;
+
+bool __execute(thread_func_t func, void* arg, bool bDedicated);
+int  __executor_concurrency();
+bool __start_task(task_t& task, thread_func_t func, void* arg, bool bDedicated);
+void __wait_task(task_t& task);
+
+// *************** Files **************
+// *
+
+uint64_t __fileModificationTime(const std::string& path);
+
+// *************** Checksums **************
+// *
+
+/// Continues the CRC-32 @a crc (0 initially) over the given data (same checksum as gig sample CRCs, implemented in gig.cpp).
+uint32_t __crc32(uint32_t crc, const void* pData, size_t size);
+
 #endif // __LIBGIG_HELPER_H__
@@ -0,0 +1,196 @@
+// Micro-Benchmark for Decompression of Gigasampler Samples
+// --------------------------------------------------------
+//
+// Measures the time needed for decoding compressed gig samples for each
+// compression mode (16 bit: modes 0 and 1, 24 bit: modes 2 to 5) of mono
+// and stereo samples, and for 24 bit samples also with truncated bits. The
+// results are printed in nanoseconds per sample point, which allows to
+// evaluate changes to the decompression kernels or compiler settings.
+//
+// The synthetic samples are compressed by Sample::WriteCompressed(), which
+// always picks the smallest lossless mode, so the wave form of each case is
+// chosen such that the intended mode is used for all frames. The resulting
+// average amount of bits per sample point is printed for verification.
+//
+// Like the unit tests, the benchmark is not compiled by default, you have
+// to compile it explicitly by running 'make gigdecompressbench' in this
+// source directory.
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+#include "../gig.h"
+
+using namespace std;
+
+// temporary Gigasampler file containing the synthetic samples
+#define BENCH_GIG_FILE_NAME "decompressbench.gig"
+
+// default length of each synthetic sample (in sample points per channel)
+#define DEFAULT_FRAMES  (1 << 20)
+
+// default amount of times each sample is decoded (the fastest run counts)
+#define DEFAULT_REPEAT  5
+
+// amount of sample points read per Read() call
+#define READ_BLOCK_FRAMES  8192
+
+struct bench_case_t {
+    const char* name;
+    int bitDepth;
+    int channels;
+    int period;         ///< Period of the sine wave form (in sample points), 0 for white noise.
+    int amplitude;      ///< Amplitude of the sine wave form.
+    int truncatedBits;  ///< Value assigned to Sample::TruncatedBits for decoding.
+};
+
+// (periods and amplitudes are chosen such that the encoder's deltas of the
+// sine just fit into the bits of the respective mode)
+static const bench_case_t cases[] = {
+    { "16 bit mode 0 (uncompressed)",   16, 1,   0,     0, 0 },
+    { "16 bit mode 0 (uncompressed)",   16, 2,   0,     0, 0 },
+    { "16 bit mode 1 (8 bit deltas)",   16, 1, 200, 20000, 0 },
+    { "16 bit mode 1 (8 bit deltas)",   16, 2, 200, 20000, 0 },
+    { "24 bit mode 2 (uncompressed)",   24, 1,   0,     0, 0 },
+    { "24 bit mode 2 (uncompressed)",   24, 2,   0,     0, 0 },
+    { "24 bit mode 2 (uncompressed)",   24, 1,   0,     0, 4 },
+    { "24 bit mode 2 (uncompressed)",   24, 2,   0,     0, 4 },
+    { "24 bit mode 3 (16 bit deltas)",  24, 1,  16, 10000, 0 },
+    { "24 bit mode 3 (16 bit deltas)",  24, 2,  16, 10000, 0 },
+    { "24 bit mode 4 (12 bit deltas)",  24, 1,  16,  1000, 0 },
+    { "24 bit mode 4 (12 bit deltas)",  24, 2,  16,  1000, 0 },
+    { "24 bit mode 5 (8 bit deltas)",   24, 1, 400,  1000, 0 },
+    { "24 bit mode 5 (8 bit deltas)",   24, 2, 400,  1000, 0 },
+    { "24 bit mode 5 (8 bit deltas)",   24, 1, 400,  1000, 6 },
+    { "24 bit mode 5 (8 bit deltas)",   24, 2, 400,  1000, 6 },
+};
+
+static const int caseCount = sizeof(cases) / sizeof(bench_case_t);
+
+class PubSample : public gig::Sample {
+public:
+    using DLS::Sample::pCkData;
+};
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + double(tv.tv_usec) / 1000000.0;
+}
+
+// creates the interleaved, native endian sample points of one case
+static void createWaveForm(const bench_case_t& c, long frames, vector<uint8_t>& data) {
+    const int bytes = c.bitDepth / 8;
+    data.resize(frames * c.channels * bytes);
+    // leave headroom for the truncated bits, which are shifted back on decoding
+    const double amplitude = double(c.amplitude) / (1 << c.truncatedBits);
+    uint32_t seed = 12345;
+    for (long i = 0; i < frames; ++i) {
+        for (int ch = 0; ch < c.channels; ++ch) {
+            int x;
+            if (c.period) {
+                // (right channel inverted, so both channels use the same mode)
+                x = int((ch ? -amplitude : amplitude) * sin(2.0 * M_PI * i / c.period));
+            } else {
+                seed = seed * 1664525 + 1013904223;
+                x = int(int32_t(seed) >> (32 - c.bitDepth + c.truncatedBits));
+            }
+            uint8_t* p = &data[(i * c.channels + ch) * bytes];
+            if (bytes == 2) {
+                const int16_t y = x;
+                memcpy(p, &y, 2);
+            } else {
+                p[0] = x;
+                p[1] = x >> 8;
+                p[2] = x >> 16;
+            }
+        }
+    }
+}
+
+static void createBenchFile(long frames) {
+    gig::File file;
+    file.pInfo->Name = "Decompression Benchmark";
+    vector<uint8_t> data;
+    for (int i = 0; i < caseCount; ++i) {
+        const bench_case_t& c = cases[i];
+        gig::Sample* pSample = file.AddSample();
+        pSample->pInfo->Name     = c.name;
+        pSample->Channels        = c.channels;
+        pSample->BitDepth        = c.bitDepth;
+        pSample->FrameSize       = c.bitDepth / 8 * c.channels;
+        pSample->SamplesPerSecond = 44100;
+        createWaveForm(c, frames, data);
+        pSample->WriteCompressed(&data[0], frames);
+    }
+    file.Save(BENCH_GIG_FILE_NAME);
+}
+
+// decodes the entire sample, returns the time of the fastest run in seconds
+static double benchRead(gig::Sample* pSample, int repeat, bool bFloat) {
+    vector<uint8_t> buffer(READ_BLOCK_FRAMES * pSample->FrameSize);
+    vector<float> floatBuffer(READ_BLOCK_FRAMES * pSample->Channels);
+    double best = -1;
+    for (int r = 0; r < repeat; ++r) {
+        pSample->SetPos(0);
+        const double t0 = now();
+        if (bFloat) {
+            while (pSample->ReadFloat(&floatBuffer[0], READ_BLOCK_FRAMES));
+        } else {
+            while (pSample->Read(&buffer[0], READ_BLOCK_FRAMES));
+        }
+        const double t = now() - t0;
+        if (best < 0 || t < best) best = t;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    long frames = DEFAULT_FRAMES;
+    int  repeat = DEFAULT_REPEAT;
+    if (argc > 1) frames = atol(argv[1]);
+    if (argc > 2) repeat = atoi(argv[2]);
+    if (frames <= 0 || repeat <= 0) {
+        cerr << "Usage: " << argv[0] << " [FRAMES [REPEAT]]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        cout << "Creating " << caseCount << " compressed samples of " << frames
+             << " sample points each ..." << endl;
+        createBenchFile(frames);
+
+        RIFF::File riff(BENCH_GIG_FILE_NAME);
+        gig::File file(&riff);
+
+        cout << left << setw(32) << "Mode" << right << setw(8) << "Chans"
+             << setw(6) << "Trunc" << setw(11) << "Bits/smpl"
+             << setw(14) << "Read ns/smpl" << setw(19) << "ReadFloat ns/smpl" << endl;
+        int i = 0;
+        for (gig::Sample* pSample = file.GetFirstSample(); pSample; pSample = file.GetNextSample(), ++i) {
+            const bench_case_t& c = cases[i];
+            pSample->TruncatedBits = c.truncatedBits;
+            const double points = double(frames) * c.channels;
+            const double bits = double(((PubSample*) pSample)->pCkData->GetSize()) * 8.0 / points;
+            const double tRead  = benchRead(pSample, repeat, false);
+            const double tFloat = benchRead(pSample, repeat, true);
+            cout << left << setw(32) << c.name << right << setw(8) << c.channels
+                 << setw(6) << c.truncatedBits << fixed << setprecision(2) << setw(11) << bits
+                 << setprecision(3) << setw(14) << (tRead * 1e9 / points)
+                 << setw(19) << (tFloat * 1e9 / points) << endl;
+        }
+    } catch (RIFF::Exception& e) {
+        e.PrintMessage();
+        remove(BENCH_GIG_FILE_NAME);
+        return EXIT_FAILURE;
+    }
+    remove(BENCH_GIG_FILE_NAME);
+    return EXIT_SUCCESS;
+}
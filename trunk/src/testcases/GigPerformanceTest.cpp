@@ -0,0 +1,318 @@
+#include "GigPerformanceTest.h"
+
+#include <iostream>
+#include <new>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../gig.h"
+#include "../helper.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(GigPerformanceTest);
+
+using namespace std;
+
+// These tests do not measure wall time (which depends on the machine and its
+// current load), but count the operations libgig performs for a certain task
+// instead: device reads, bytes read and heap allocations. The asserted upper
+// bounds only scale linearly with the file's content, so they catch
+// algorithmic regressions (e.g. reading each chunk header individually, or
+// allocating per sample in a per region loop) before they ship.
+
+// file name of the Gigasampler file we are going to create for these tests
+#define TEST_GIG_FILE_NAME "perf.gig"
+
+// structure of the test file
+#define TEST_SAMPLES        256
+#define TEST_SAMPLE_FRAMES  4096
+#define TEST_REGIONS        64
+#define TEST_VELOCITY_ZONES 4
+#define TEST_DIMENSION_REGIONS (TEST_REGIONS * TEST_VELOCITY_ZONES)
+
+// amount of sample points preloaded by testBytesReadForPreload()
+#define TEST_PRELOAD_FRAMES 1024
+
+
+// *************** allocation counter ***************
+// *
+// Replaces the global operator new of the test runner, which libgig uses as
+// well, so all heap allocations performed while counting is enabled are
+// counted. All replaceable (non aligned) variants are replaced as matching
+// pairs, so no allocation is freed by the default implementation.
+
+static bool bCountAllocations = false;
+static long allocations = 0;
+
+#if __cplusplus >= 201103L
+# define NEW_THROWS
+# define DELETE_THROWS noexcept
+#else
+# define NEW_THROWS    throw(std::bad_alloc)
+# define DELETE_THROWS throw()
+#endif
+
+static void* countedAllocNoThrow(size_t size) {
+    if (bCountAllocations) __sync_fetch_and_add(&allocations, 1);
+    return malloc(size ? size : 1);
+}
+
+static void* countedAlloc(size_t size) {
+    void* p = countedAllocNoThrow(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size) NEW_THROWS { return countedAlloc(size); }
+void* operator new[](size_t size) NEW_THROWS { return countedAlloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) DELETE_THROWS { return countedAllocNoThrow(size); }
+void* operator new[](size_t size, const std::nothrow_t&) DELETE_THROWS { return countedAllocNoThrow(size); }
+void operator delete(void* p) DELETE_THROWS { free(p); }
+void operator delete[](void* p) DELETE_THROWS { free(p); }
+void operator delete(void* p, const std::nothrow_t&) DELETE_THROWS { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) DELETE_THROWS { free(p); }
+// (sized variants unconditionally, libgig may be compiled with sized
+// deallocation even if the test runner is not)
+void operator delete(void* p, size_t) DELETE_THROWS { free(p); }
+void operator delete[](void* p, size_t) DELETE_THROWS { free(p); }
+
+static void startCountingAllocations() {
+    allocations = 0;
+    bCountAllocations = true;
+}
+
+static long stopCountingAllocations() {
+    bCountAllocations = false;
+    return allocations;
+}
+
+
+// *************** CountingIODevice ***************
+// *
+
+/*
+ * Provides the test file from RAM and counts how often and how much libgig
+ * reads from it. Each ReadAt() call corresponds to one read system call of
+ * the regular file device.
+ */
+class CountingIODevice : public RIFF::IODevice {
+public:
+    long                Reads;     ///< Amount of ReadAt() calls so far.
+    RIFF::file_offset_t BytesRead; ///< Amount of bytes read so far.
+
+    CountingIODevice(const char* filename) : Reads(0), BytesRead(0) {
+        FILE* hFile = fopen(filename, "rb");
+        if (!hFile) throw RIFF::Exception("Could not open test file");
+        fseek(hFile, 0, SEEK_END);
+        data.resize(ftell(hFile));
+        fseek(hFile, 0, SEEK_SET);
+        const size_t n = fread(&data[0], 1, data.size(), hFile);
+        fclose(hFile);
+        if (n != data.size()) throw RIFF::Exception("Could not read test file");
+    }
+
+    virtual RIFF::file_offset_t ReadAt(RIFF::file_offset_t Offset, void* pData, RIFF::file_offset_t Size) {
+        Reads++;
+        if (Offset >= data.size()) return 0;
+        if (Size > data.size() - Offset) Size = data.size() - Offset;
+        memcpy(pData, &data[Offset], Size);
+        BytesRead += Size;
+        return Size;
+    }
+
+    virtual RIFF::file_offset_t WriteAt(RIFF::file_offset_t /*Offset*/, const void* /*pData*/, RIFF::file_offset_t /*Size*/) {
+        return 0; // read-only
+    }
+
+    virtual RIFF::file_offset_t GetSize() const {
+        return data.size();
+    }
+
+    virtual void Resize(RIFF::file_offset_t /*NewSize*/) {
+        throw RIFF::Exception("CountingIODevice is read-only");
+    }
+
+private:
+    std::vector<uint8_t> data;
+};
+
+// 1. Run) print the purpose of this test case first
+void GigPerformanceTest::printTestSuiteName() {
+    cout << "\b \nTesting Gigasampler performance (operation counts): " << flush;
+}
+
+// code executed when this test suite is created
+void GigPerformanceTest::setUp() {
+}
+
+// code executed when this test suite will be destroyed
+void GigPerformanceTest::tearDown() {
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// The actual test cases (in order) ...
+
+// 2. Run) create a Gigasampler file with many samples and dimension regions
+void GigPerformanceTest::createTestGigFile() {
+    try {
+        gig::File file;
+        file.pInfo->Name = "Performance Test File";
+
+        vector<gig::Sample*> samples;
+        for (int i = 0; i < TEST_SAMPLES; ++i) {
+            gig::Sample* pSample = file.AddSample();
+            pSample->pInfo->Name      = "Sample " + ToString(i + 1);
+            pSample->Channels         = 1;
+            pSample->BitDepth         = 16;
+            pSample->FrameSize        = 2;
+            pSample->SamplesPerSecond = 44100;
+            pSample->Resize(TEST_SAMPLE_FRAMES);
+            samples.push_back(pSample);
+        }
+
+        gig::Instrument* pInstrument = file.AddInstrument();
+        pInstrument->pInfo->Name = "Performance Test Instrument";
+        int iSample = 0;
+        for (int r = 0; r < TEST_REGIONS; ++r) {
+            gig::Region* pRegion = pInstrument->AddRegion();
+            pRegion->SetKeyRange(r * 2, r * 2 + 1);
+            gig::dimension_def_t dim;
+            dim.dimension = gig::dimension_velocity;
+            dim.bits      = 2;
+            dim.zones     = TEST_VELOCITY_ZONES;
+            pRegion->AddDimension(&dim);
+            for (uint d = 0; d < pRegion->DimensionRegions; ++d)
+                pRegion->pDimensionRegions[d]->pSample = samples[iSample++ % TEST_SAMPLES];
+        }
+
+        file.Save(TEST_GIG_FILE_NAME);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nCould not create performance test file:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
+
+// 3. Run) opening a file must read the RIFF tree in bulk, not chunk by chunk
+void GigPerformanceTest::testReadsForOpeningFile() {
+    try {
+        CountingIODevice* pDevice = new CountingIODevice(TEST_GIG_FILE_NAME);
+        RIFF::File riff(pDevice); // takes ownership of pDevice
+        gig::File file(&riff);
+        // (independent of the amount of chunks, currently about 30 reads)
+        CPPUNIT_ASSERT(pDevice->Reads <= 64);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nCould not open performance test file:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
+
+// 4. Run) loading the samples' meta data must be linear to the amount of samples
+void GigPerformanceTest::testReadsForLoadingSamples() {
+    try {
+        CountingIODevice* pDevice = new CountingIODevice(TEST_GIG_FILE_NAME);
+        RIFF::File riff(pDevice);
+        gig::File file(&riff);
+        const long reads = pDevice->Reads;
+        int iSamples = 0;
+        for (gig::Sample* pSample = file.GetFirstSample(); pSample; pSample = file.GetNextSample())
+            iSamples++;
+        CPPUNIT_ASSERT(iSamples == TEST_SAMPLES);
+        // (currently about 7 reads per sample)
+        CPPUNIT_ASSERT(pDevice->Reads - reads <= 10 * TEST_SAMPLES + 32);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nCould not load samples of performance test file:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
+
+// 5. Run) loading an instrument must be linear to its amount of dimension regions
+void GigPerformanceTest::testCostOfLoadingInstrument() {
+    try {
+        CountingIODevice* pDevice = new CountingIODevice(TEST_GIG_FILE_NAME);
+        RIFF::File riff(pDevice);
+        gig::File file(&riff);
+        file.GetFirstSample(); // load samples before, they are not subject of this test
+        const long reads = pDevice->Reads;
+        startCountingAllocations();
+        gig::Instrument* pInstrument = file.GetFirstInstrument();
+        const long allocs = stopCountingAllocations();
+        CPPUNIT_ASSERT(pInstrument);
+
+        int iDimensionRegions = 0;
+        for (gig::Region* pRegion = pInstrument->GetFirstRegion(); pRegion; pRegion = pInstrument->GetNextRegion()) {
+            for (uint d = 0; d < pRegion->DimensionRegions; ++d) {
+                CPPUNIT_ASSERT(pRegion->pDimensionRegions[d]->pSample);
+                iDimensionRegions++;
+            }
+        }
+        CPPUNIT_ASSERT(iDimensionRegions == TEST_DIMENSION_REGIONS);
+        // (currently about 13 allocations and 7 reads per dimension region)
+        CPPUNIT_ASSERT(allocs <= 20 * TEST_DIMENSION_REGIONS + 128);
+        CPPUNIT_ASSERT(pDevice->Reads - reads <= 10 * TEST_DIMENSION_REGIONS + 64);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nCould not load instrument of performance test file:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
+
+// 6. Run) preloading a sample must only read the requested sample points
+void GigPerformanceTest::testBytesReadForPreload() {
+    try {
+        CountingIODevice* pDevice = new CountingIODevice(TEST_GIG_FILE_NAME);
+        RIFF::File riff(pDevice);
+        gig::File file(&riff);
+        gig::Sample* pSample = file.GetFirstSample();
+        CPPUNIT_ASSERT(pSample);
+        const long reads = pDevice->Reads;
+        const RIFF::file_offset_t bytes = pDevice->BytesRead;
+        gig::buffer_t buf = pSample->LoadSampleData(TEST_PRELOAD_FRAMES);
+        CPPUNIT_ASSERT(buf.Size == TEST_PRELOAD_FRAMES * pSample->FrameSize);
+        CPPUNIT_ASSERT(pDevice->Reads - reads <= 2);
+        CPPUNIT_ASSERT(pDevice->BytesRead - bytes <= TEST_PRELOAD_FRAMES * pSample->FrameSize + 4096);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nCould not preload sample of performance test file:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
+
+// 7. Run) the file's I/O statistics must match what actually hit the device
+void GigPerformanceTest::testStatistics() {
+    try {
+        CountingIODevice* pDevice = new CountingIODevice(TEST_GIG_FILE_NAME);
+        RIFF::File riff(pDevice);
+        gig::File file(&riff);
+        gig::Sample* pSample = file.GetFirstSample();
+        CPPUNIT_ASSERT(pSample);
+        gig::statistics_t stats = file.GetStatistics();
+#if !LIBGIG_NO_STATISTICS
+        CPPUNIT_ASSERT(stats.IO.ReadCalls == (uint64_t) pDevice->Reads);
+        CPPUNIT_ASSERT(stats.IO.BytesRead == (uint64_t) pDevice->BytesRead);
+        CPPUNIT_ASSERT(stats.IO.CacheHits > 0);
+#endif
+        file.ResetStatistics();
+        stats = file.GetStatistics();
+        CPPUNIT_ASSERT(stats.IO.ReadCalls == 0 && stats.IO.BytesRead == 0);
+
+        const long reads = pDevice->Reads;
+        const RIFF::file_offset_t bytes = pDevice->BytesRead;
+        vector<uint8_t> buf(TEST_PRELOAD_FRAMES * pSample->FrameSize);
+        CPPUNIT_ASSERT(pSample->Read(&buf[0], TEST_PRELOAD_FRAMES) == TEST_PRELOAD_FRAMES);
+        stats = file.GetStatistics();
+#if !LIBGIG_NO_STATISTICS
+        CPPUNIT_ASSERT(stats.IO.ReadCalls == (uint64_t) (pDevice->Reads - reads));
+        CPPUNIT_ASSERT(stats.IO.BytesRead == pDevice->BytesRead - bytes);
+        CPPUNIT_ASSERT(stats.ReadCalls == 1);
+#endif
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nCould not read statistics of performance test file:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef __LIBGIG_GIGPERFORMANCETEST_H__
+#define __LIBGIG_GIGPERFORMANCETEST_H__
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+class GigPerformanceTest : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE(GigPerformanceTest);
+    CPPUNIT_TEST(printTestSuiteName);
+    CPPUNIT_TEST(createTestGigFile);
+    CPPUNIT_TEST(testReadsForOpeningFile);
+    CPPUNIT_TEST(testReadsForLoadingSamples);
+    CPPUNIT_TEST(testCostOfLoadingInstrument);
+    CPPUNIT_TEST(testBytesReadForPreload);
+    CPPUNIT_TEST(testStatistics);
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        void printTestSuiteName();
+
+        void createTestGigFile();
+        void testReadsForOpeningFile();
+        void testReadsForLoadingSamples();
+        void testCostOfLoadingInstrument();
+        void testBytesReadForPreload();
+        void testStatistics();
+};
+
+#endif // __LIBGIG_GIGPERFORMANCETEST_H__
@@ -4,9 +4,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 
 #include "../gig.h"
 #include "../helper.h"
+#include "../Serialization.h"
+
+#include <map>
+#include <vector>
 
 CPPUNIT_TEST_SUITE_REGISTRATION(GigWriteTest);
 
@@ -22,6 +27,71 @@ int16_t sampleData2[] = { 4, 5, 6 };
 int16_t sampleData3[] = { 7, 8, 9 };
 int16_t sampleData4[] = { 10,11,12 };
 
+// file names of the Gigasampler files created by the round trip tests below
+#define TEST_COMPRESSED_GIG_FILE_NAME "foo_compressed.gig"
+#define TEST_SEQUENTIAL_GIG_FILE_NAME "foo_sequential.gig"
+#define TEST_SNAPSHOT_GIG_FILE_NAME "foo_snapshot.gig"
+
+// length of the sample "waves" used by the round trip tests below, long
+// enough to span several compressed frames (2048 sample points each)
+#define ROUND_TRIP_FRAMES 5000
+
+// creates a deterministic, noisy sine "wave" with the given format, so that
+// the compressed frames end up with different compression modes
+static std::vector<uint8_t> createTestWave(int channels, int bitDepth, int seed) {
+    const int bytesPerSample = bitDepth / 8;
+    std::vector<uint8_t> wave(ROUND_TRIP_FRAMES * channels * bytesPerSample);
+    uint32_t noise = seed;
+    for (int i = 0; i < ROUND_TRIP_FRAMES * channels; ++i) {
+        noise = noise * 1103515245 + 12345;
+        const int amplitude = (i / 1000 % 2) ? 100 : 6000; // loud and quiet parts
+        int32_t value = int32_t(amplitude * sin(double(i) * 0.01 * (seed + 1))) +
+                        int32_t(noise >> 16) % 50 - 25;
+        if (bitDepth == 24) value *= 256;
+        for (int b = 0; b < bytesPerSample; ++b)
+            wave[i * bytesPerSample + b] = uint8_t(value >> (8 * b));
+    }
+    return wave;
+}
+
+// the test "waves" of the round trip tests: mono 16 bit and stereo 24 bit
+static const std::vector<uint8_t> roundTripWave1 = createTestWave(1, 16, 1);
+static const std::vector<uint8_t> roundTripWave2 = createTestWave(2, 24, 2);
+
+// sets the format of a new sample of the round trip tests
+static void setRoundTripFormat(gig::Sample* pSample, int channels, int bitDepth) {
+    pSample->Channels = channels;
+    pSample->BitDepth = bitDepth;
+    pSample->FrameSize = bitDepth / 8 * channels;
+    pSample->SamplesPerSecond = 44100;
+}
+
+// checks that a sample of a reopened file contains exactly the given "wave"
+static void checkRoundTripWave(gig::Sample* pSample, const std::vector<uint8_t>& wave) {
+    CPPUNIT_ASSERT(pSample);
+    CPPUNIT_ASSERT(pSample->SamplesTotal == ROUND_TRIP_FRAMES);
+    gig::buffer_t buffer = pSample->LoadSampleData();
+    CPPUNIT_ASSERT(buffer.pStart);
+    CPPUNIT_ASSERT(buffer.Size == wave.size());
+    CPPUNIT_ASSERT(memcmp(buffer.pStart, &wave[0], wave.size()) == 0);
+    pSample->ReleaseSampleData();
+}
+
+// position of each sample in its "wave" while File::SaveSequential() runs
+typedef std::map<gig::Sample*, std::pair<const std::vector<uint8_t>*, size_t> > sequential_sources_t;
+
+// sample source for File::SaveSequential(), copying from the test "waves"
+static gig::file_offset_t sequentialSource(gig::Sample* pSample, void* pBuffer, gig::file_offset_t FrameCount, void* pUserData) {
+    sequential_sources_t& sources = *(sequential_sources_t*) pUserData;
+    CPPUNIT_ASSERT(sources.count(pSample));
+    const std::vector<uint8_t>& wave = *sources[pSample].first;
+    size_t& pos = sources[pSample].second;
+    const size_t frames = std::min(size_t(FrameCount), (wave.size() - pos) / pSample->FrameSize);
+    memcpy(pBuffer, &wave[pos], frames * pSample->FrameSize);
+    pos += frames * pSample->FrameSize;
+    return frames;
+}
+
 // 1. Run) print the purpose of this test case first
 void GigWriteTest::printTestSuiteName() {
     cout << "\b \nTesting Gigasampler write support: " << flush;
@@ -288,3 +358,196 @@ void GigWriteTest::testSamplesData() {
         throw e; // stop further tests
     }
 }
+
+// 7. Run) write compressed samples to a new Gigasampler file
+void GigWriteTest::testWriteCompressed() {
+    try {
+        gig::File file;
+        file.pInfo->Name = "Foo Compressed Gigasampler File";
+        gig::Sample* pSample1 = file.AddSample();
+        gig::Sample* pSample2 = file.AddSample();
+        setRoundTripFormat(pSample1, 1, 16);
+        setRoundTripFormat(pSample2, 2, 24);
+        // in contrast to Write(), WriteCompressed() neither requires
+        // Resize() nor a Save() call before
+        pSample1->WriteCompressed(&roundTripWave1[0], ROUND_TRIP_FRAMES);
+        pSample2->WriteCompressed(&roundTripWave2[0], ROUND_TRIP_FRAMES, 2);
+        CPPUNIT_ASSERT(pSample1->Compressed);
+        CPPUNIT_ASSERT(pSample2->Compressed);
+        file.Save(TEST_COMPRESSED_GIG_FILE_NAME);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nCould not write compressed samples:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
+
+// 8. Run) check the decoded wave data of the compressed samples
+void GigWriteTest::testCompressedSamplesData() {
+    try {
+        RIFF::File riff(TEST_COMPRESSED_GIG_FILE_NAME);
+        gig::File file(&riff);
+        gig::Sample* pSample1 = file.GetFirstSample();
+        gig::Sample* pSample2 = file.GetNextSample();
+        CPPUNIT_ASSERT(pSample1);
+        CPPUNIT_ASSERT(pSample2);
+        CPPUNIT_ASSERT(!file.GetNextSample());
+        CPPUNIT_ASSERT(pSample1->Compressed);
+        CPPUNIT_ASSERT(pSample2->Compressed);
+        CPPUNIT_ASSERT(pSample1->Channels == 1 && pSample1->BitDepth == 16);
+        CPPUNIT_ASSERT(pSample2->Channels == 2 && pSample2->BitDepth == 24);
+        checkRoundTripWave(pSample1, roundTripWave1);
+        checkRoundTripWave(pSample2, roundTripWave2);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nThere was an exception while checking the compressed samples' data:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
+
+// 9. Run) check that the compressed samples' frame tables were stored with
+//         the file, so they are known without scanning the samples
+void GigWriteTest::testFrameTableChunk() {
+    try {
+        RIFF::File riff(TEST_COMPRESSED_GIG_FILE_NAME);
+        RIFF::List* wvpl = riff.GetSubList(LIST_TYPE_WVPL);
+        CPPUNIT_ASSERT(wvpl);
+        for (size_t i = 0; i < 2; ++i) {
+            RIFF::List* wave = wvpl->GetSubListAt(LIST_TYPE_WAVE, i);
+            CPPUNIT_ASSERT(wave);
+            CPPUNIT_ASSERT(wave->GetSubChunk(CHUNK_ID_LSFT));
+        }
+        gig::File file(&riff);
+        // with lazy scanning the length of compressed samples is only
+        // known at this point if it was restored from the frame table chunk
+        file.SetLazySampleScan(true);
+        gig::Sample* pSample1 = file.GetFirstSample();
+        gig::Sample* pSample2 = file.GetNextSample();
+        CPPUNIT_ASSERT(pSample1);
+        CPPUNIT_ASSERT(pSample2);
+        CPPUNIT_ASSERT(pSample1->SamplesTotal == ROUND_TRIP_FRAMES);
+        CPPUNIT_ASSERT(pSample2->SamplesTotal == ROUND_TRIP_FRAMES);
+        checkRoundTripWave(pSample1, roundTripWave1);
+        checkRoundTripWave(pSample2, roundTripWave2);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nThere was an exception while checking the frame table chunks:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
+
+// 10. Run) write a new Gigasampler file with its samples' wave data in one
+//          sequential pass
+void GigWriteTest::testSaveSequential() {
+    try {
+        // leave a larger file at the destination, which has to be truncated
+        FILE* f = fopen(TEST_SEQUENTIAL_GIG_FILE_NAME, "wb");
+        CPPUNIT_ASSERT(f);
+        std::vector<uint8_t> garbage(1024 * 1024, 0xAB);
+        CPPUNIT_ASSERT(fwrite(&garbage[0], 1, garbage.size(), f) == garbage.size());
+        fclose(f);
+
+        gig::File file;
+        file.pInfo->Name = "Foo Sequential Gigasampler File";
+        gig::Sample* pSample1 = file.AddSample();
+        gig::Sample* pSample2 = file.AddSample();
+        setRoundTripFormat(pSample1, 1, 16);
+        setRoundTripFormat(pSample2, 2, 24);
+        pSample1->Resize(ROUND_TRIP_FRAMES);
+        pSample2->Resize(ROUND_TRIP_FRAMES);
+        gig::Instrument* pInstrument = file.AddInstrument();
+        gig::Region* pRegion = pInstrument->AddRegion();
+        pRegion->SetSample(pSample1);
+        pRegion->pDimensionRegions[0]->SetSample(pSample1);
+
+        sequential_sources_t sources;
+        sources[pSample1] = std::make_pair(&roundTripWave1, size_t(0));
+        sources[pSample2] = std::make_pair(&roundTripWave2, size_t(0));
+        file.SaveSequential(TEST_SEQUENTIAL_GIG_FILE_NAME, sequentialSource, &sources);
+        // every sample's source had to be consumed completely
+        CPPUNIT_ASSERT(sources[pSample1].second == roundTripWave1.size());
+        CPPUNIT_ASSERT(sources[pSample2].second == roundTripWave2.size());
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nCould not save a Gigasampler file sequentially:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
+
+// 11. Run) check the wave data of the sequentially saved Gigasampler file
+void GigWriteTest::testSequentialSamplesData() {
+    try {
+        RIFF::File riff(TEST_SEQUENTIAL_GIG_FILE_NAME);
+        gig::File file(&riff);
+        gig::Sample* pSample1 = file.GetFirstSample();
+        gig::Sample* pSample2 = file.GetNextSample();
+        CPPUNIT_ASSERT(pSample1);
+        CPPUNIT_ASSERT(pSample2);
+        CPPUNIT_ASSERT(!file.GetNextSample());
+        CPPUNIT_ASSERT(!pSample1->Compressed);
+        CPPUNIT_ASSERT(!pSample2->Compressed);
+        checkRoundTripWave(pSample1, roundTripWave1);
+        checkRoundTripWave(pSample2, roundTripWave2);
+        gig::Instrument* pInstrument = file.GetFirstInstrument();
+        CPPUNIT_ASSERT(pInstrument);
+        gig::Region* pRegion = pInstrument->GetFirstRegion();
+        CPPUNIT_ASSERT(pRegion);
+        CPPUNIT_ASSERT(pRegion->pDimensionRegions[0]->pSample == pSample1);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nThere was an exception while checking the sequentially saved samples' data:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
+
+// 12. Run) undo an articulation change with a snapshot history and save
+//          the restored state
+void GigWriteTest::testSnapshotHistoryRestore() {
+    double originalAttack;
+    uint16_t originalSustain;
+    try {
+        RIFF::File riff(TEST_GIG_FILE_NAME);
+        gig::File file(&riff);
+        gig::Instrument* pInstrument = file.GetFirstInstrument();
+        CPPUNIT_ASSERT(pInstrument);
+        gig::Region* pRegion = pInstrument->GetFirstRegion();
+        CPPUNIT_ASSERT(pRegion);
+        gig::DimensionRegion* pDimRgn = pRegion->pDimensionRegions[0];
+        CPPUNIT_ASSERT(pDimRgn);
+        originalAttack = pDimRgn->EG1Attack;
+        originalSustain = pDimRgn->EG1Sustain;
+
+        Serialization::SnapshotHistory history;
+        CPPUNIT_ASSERT(history.capture(pDimRgn) == 0);
+        pDimRgn->EG1Attack = originalAttack + 1.5;
+        pDimRgn->EG1Sustain = originalSustain / 2;
+        CPPUNIT_ASSERT(history.capture(pDimRgn) == 1);
+        CPPUNIT_ASSERT(history.size() == 2);
+        history.restore(pDimRgn, 0);
+        CPPUNIT_ASSERT(history.position() == 0);
+        CPPUNIT_ASSERT(pDimRgn->EG1Attack == originalAttack);
+        CPPUNIT_ASSERT(pDimRgn->EG1Sustain == originalSustain);
+        file.Save(TEST_SNAPSHOT_GIG_FILE_NAME);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nCould not restore a snapshot:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+    try {
+        RIFF::File riff(TEST_SNAPSHOT_GIG_FILE_NAME);
+        gig::File file(&riff);
+        gig::Instrument* pInstrument = file.GetFirstInstrument();
+        CPPUNIT_ASSERT(pInstrument);
+        gig::Region* pRegion = pInstrument->GetFirstRegion();
+        CPPUNIT_ASSERT(pRegion);
+        gig::DimensionRegion* pDimRgn = pRegion->pDimensionRegions[0];
+        CPPUNIT_ASSERT(pDimRgn);
+        // the articulation is stored with limited precision
+        CPPUNIT_ASSERT(fabs(pDimRgn->EG1Attack - originalAttack) < 0.01);
+        CPPUNIT_ASSERT(pDimRgn->EG1Sustain == originalSustain);
+    } catch (RIFF::Exception& e) {
+        std::cerr << "\nThere was an exception while checking the restored snapshot:\n" << std::flush;
+        e.PrintMessage();
+        throw e; // stop further tests
+    }
+}
@@ -13,6 +13,12 @@ class GigWriteTest : public CppUnit::TestFixture {
     CPPUNIT_TEST(testArticulationsOfCreatedGigFile);
     CPPUNIT_TEST(testWriteSamples);
     CPPUNIT_TEST(testSamplesData);
+    CPPUNIT_TEST(testWriteCompressed);
+    CPPUNIT_TEST(testCompressedSamplesData);
+    CPPUNIT_TEST(testFrameTableChunk);
+    CPPUNIT_TEST(testSaveSequential);
+    CPPUNIT_TEST(testSequentialSamplesData);
+    CPPUNIT_TEST(testSnapshotHistoryRestore);
     CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -26,6 +32,12 @@ class GigWriteTest : public CppUnit::TestFixture {
         void testArticulationsOfCreatedGigFile();
         void testWriteSamples();
         void testSamplesData();
+        void testWriteCompressed();
+        void testCompressedSamplesData();
+        void testFrameTableChunk();
+        void testSaveSequential();
+        void testSequentialSamplesData();
+        void testSnapshotHistoryRestore();
 };
 
 #endif // __LIBGIG_GIGWRITETEST_H__
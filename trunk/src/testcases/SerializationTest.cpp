@@ -0,0 +1,163 @@
+#include "SerializationTest.h"
+
+#include <iostream>
+#include <vector>
+#include <string.h>
+
+#include "../Serialization.h"
+#include "../helper.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SerializationTest);
+
+using namespace std;
+
+// amount of nodes of the large archive, so that its member list and
+// string table each exceed the 64 kB blocks read by decodeFrom()
+#define TEST_NODES 20000
+
+// amount of bytes handed out by the chunked source on each call
+#define TEST_CHUNK_SIZE 1000
+
+#define SRLZ(member) \
+    archive->serializeMember(*this, member, #member);
+
+namespace {
+
+    struct TestNode {
+        int32_t  a;
+        double   b;
+        bool     c;
+
+        void serialize(Serialization::Archive* archive) {
+            SRLZ(a);
+            SRLZ(b);
+            SRLZ(c);
+        }
+    };
+
+    struct TestRoot {
+        uint16_t version;
+        TestNode nodes[TEST_NODES];
+
+        void serialize(Serialization::Archive* archive) {
+            SRLZ(version);
+            for (int i = 0; i < TEST_NODES; ++i)
+                archive->serializeMember(*this, nodes[i], ("node" + ToString(i)).c_str());
+        }
+    };
+
+    // stream as passed through encodeTo() / decodeFrom()
+    struct chunked_stream_t {
+        Serialization::RawData data;
+        size_t                 pos;
+        size_t                 calls;
+    };
+
+    void chunkedSink(const uint8_t* data, size_t size, void* pUserData) {
+        chunked_stream_t* stream = static_cast<chunked_stream_t*>(pUserData);
+        stream->data.insert(stream->data.end(), data, data + size);
+        stream->calls++;
+    }
+
+    size_t chunkedSource(uint8_t* buffer, size_t size, void* pUserData) {
+        chunked_stream_t* stream = static_cast<chunked_stream_t*>(pUserData);
+        const size_t n = std::min(std::min(size, (size_t)TEST_CHUNK_SIZE), stream->data.size() - stream->pos);
+        if (n) memcpy(buffer, &stream->data[stream->pos], n);
+        stream->pos += n;
+        stream->calls++;
+        return n;
+    }
+
+    void fillTestRoot(TestRoot& root) {
+        root.version = 3;
+        for (int i = 0; i < TEST_NODES; ++i) {
+            root.nodes[i].a = i * 7 - 1000;
+            root.nodes[i].b = i * 0.25;
+            root.nodes[i].c = i % 3;
+        }
+    }
+
+    bool equalTestRoots(const TestRoot& r1, const TestRoot& r2) {
+        if (r1.version != r2.version) return false;
+        for (int i = 0; i < TEST_NODES; ++i) {
+            if (r1.nodes[i].a != r2.nodes[i].a ||
+                r1.nodes[i].b != r2.nodes[i].b ||
+                r1.nodes[i].c != r2.nodes[i].c) return false;
+        }
+        return true;
+    }
+
+}
+
+// 1. Run) print the purpose of this test case first
+void SerializationTest::printTestSuiteName() {
+    cout << "\b \nTesting Serialization: " << flush;
+}
+
+// code executed when this test suite is created
+void SerializationTest::setUp() {
+}
+
+// code executed when this test suite will be destroyed
+void SerializationTest::tearDown() {
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// The actual test cases (in order) ...
+
+// 2. Run) encode a small archive in binary format and decode it again
+void SerializationTest::testBinaryRoundTrip() {
+    try {
+        TestNode src = { -5, 1.5, true };
+        Serialization::Archive a;
+        a.setEncoding(Serialization::ENCODING_BINARY);
+        a.serialize(&src);
+        Serialization::RawData raw = a.rawData();
+
+        Serialization::Archive b(raw);
+        TestNode dst = { 0, 0.0, false };
+        b.deserialize(&dst);
+        CPPUNIT_ASSERT(dst.a == src.a);
+        CPPUNIT_ASSERT(dst.b == src.b);
+        CPPUNIT_ASSERT(dst.c == src.c);
+    } catch (Serialization::Exception& e) {
+        std::cerr << "\nCould not round trip a binary archive:\n" << std::flush;
+        e.PrintMessage();
+        throw; // stop further tests
+    }
+}
+
+// 3. Run) encode a large archive piece by piece by a sink, and decode it
+// from a source handing out the stream in small chunks
+void SerializationTest::testChunkedDecodeOfLargeArchive() {
+    try {
+        std::vector<TestRoot> roots(2);
+        TestRoot& src = roots[0];
+        TestRoot& dst = roots[1];
+        fillTestRoot(src);
+        memset(&dst, 0, sizeof(TestRoot));
+
+        chunked_stream_t stream;
+        stream.pos   = 0;
+        stream.calls = 0;
+        Serialization::Archive a;
+        a.setEncoding(Serialization::ENCODING_BINARY);
+        a.serialize(&src, chunkedSink, &stream);
+        CPPUNIT_ASSERT(stream.data.size() > 2 * 65536);
+        CPPUNIT_ASSERT(stream.calls > 1);
+
+        stream.pos   = 0;
+        stream.calls = 0;
+        Serialization::Archive b;
+        b.decodeFrom(chunkedSource, &stream);
+        CPPUNIT_ASSERT(stream.pos == stream.data.size());
+        CPPUNIT_ASSERT(stream.calls > stream.data.size() / TEST_CHUNK_SIZE);
+        b.deserialize(&dst);
+        CPPUNIT_ASSERT(equalTestRoots(src, dst));
+    } catch (Serialization::Exception& e) {
+        std::cerr << "\nCould not decode a large archive from a chunked source:\n" << std::flush;
+        e.PrintMessage();
+        throw; // stop further tests
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef __LIBGIG_SERIALIZATIONTEST_H__
+#define __LIBGIG_SERIALIZATIONTEST_H__
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+class SerializationTest : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE(SerializationTest);
+    CPPUNIT_TEST(printTestSuiteName);
+    CPPUNIT_TEST(testBinaryRoundTrip);
+    CPPUNIT_TEST(testChunkedDecodeOfLargeArchive);
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        void printTestSuiteName();
+
+        void testBinaryRoundTrip();
+        void testChunkedDecodeOfLargeArchive();
+};
+
+#endif // __LIBGIG_SERIALIZATIONTEST_H__
@@ -42,13 +42,18 @@
 // for testing the disk streaming methods
 #define USE_DISK_STREAMING 1
 
+// amount of sample points read and written at once when streaming samples
+#define STREAMING_BLOCK_SIZE 65536
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
 #include <sstream>
 #include <string.h>
+#include <vector>
 
 #include "../Akai.h"
+#include "../helper.h"
 
 // only libsndfile is available for Windows, so we use that for writing the sound files
 #ifdef WIN32
@@ -85,16 +90,12 @@ int(*_afCloseFile)(AFfilehandle file);
 #endif // !HAVE_SNDFILE
 
 int writeWav(AkaiSample* sample, const char* filename, void* samples, long samplecount, int channels = 1, int bitdepth = 16, long rate = 44100);
+const char* extractSample(AkaiSample* pSample, const AkaiDirEntry& DirEntry, const char* outPath);
+void extractVolumesParallel(const char* outPath, long totalSamples, int threads, bool& errorOccured);
 void ConvertAkaiToAscii(char * buffer, int length); // debugging purpose only
 
 using namespace std;
 
-template<class T> inline std::string ToString(T o) {
-    std::stringstream ss;
-    ss << o;
-    return ss.str();
-}
-
 void PrintLastError(char* file, int line)
 {
 #ifdef WIN32
@@ -125,11 +126,13 @@ void PrintLastError(char* file, int line)
 static void printUsage() {
 #ifdef WIN32
     const wchar_t* msg =
-        L"akaiextract <source-drive-letter>: <destination-dir>\n"
+        L"akaiextract [-j <threads>] <source-drive-letter>: <destination-dir>\n"
         "by S\351bastien M\351trot (meeloo@meeloo.net)\n\n"
         "Reads an AKAI media (i.e. CDROM, ZIP disk) and extracts all its audio\n"
         "samples as .wav files to the given output directory. If the given output\n"
         "directory does not exist yet, then it will be created.\n\n"
+        "-j <threads> - extract volumes in parallel with the given amount of\n"
+        "               threads (0 = one per CPU core, default: 1)\n\n"
         "Available types of your drives:\n";
     DWORD n = wcslen(msg);
     WriteConsoleW(GetStdHandle(STD_OUTPUT_HANDLE), msg, n, &n, NULL);
@@ -154,7 +157,7 @@ static void printUsage() {
 #elif defined _CARBON_
     setlocale(LC_CTYPE, "");
     printf("%ls",
-        L"akaiextract [<source-path>] <destination-dir>\n"
+        L"akaiextract [-j <threads>] [<source-path>] <destination-dir>\n"
         "by S\351bastien M\351trot (meeloo@meeloo.net)\n\n"
         "Reads an AKAI media (i.e. CDROM, ZIP disk) and extracts all its audio\n"
         "samples as .wav files to the given output directory. If the given output\n"
@@ -162,11 +165,13 @@ static void printUsage() {
         "<source-path> - path of the source AKAI image file, if omitted CDROM\n"
         "                drive ('/dev/rdisk1s0') will be accessed\n\n"
         "<destination-dir> - target directory where samples will be written to\n\n"
+        "-j <threads> - extract volumes in parallel with the given amount of\n"
+        "               threads (0 = one per CPU core, default: 1)\n\n"
     );
 #else
     setlocale(LC_CTYPE, "");
     printf("%ls",
-        L"akaiextract <source-path> <destination-dir>\n"
+        L"akaiextract [-j <threads>] <source-path> <destination-dir>\n"
         "by S\351bastien M\351trot (meeloo@meeloo.net)\n"
         "Linux port by Christian Schoenebeck\n\n"
         "Reads an AKAI media (i.e. CDROM, ZIP disk) and extracts all its audio\n"
@@ -174,11 +179,39 @@ static void printUsage() {
         "directory does not exist yet, then it will be created.\n\n"
         "<source-path> - path of the source drive or image file (i.e. /dev/cdrom)\n\n"
         "<destination-dir> - target directory where samples will be written to\n\n"
+        "-j <threads> - extract volumes in parallel with the given amount of\n"
+        "               threads (0 = one per CPU core, default: 1)\n\n"
     );
 #endif
 }
 
+// input source, remembered for opening one more handle per thread in parallel mode
+static const char* sourcePath = NULL; // NULL: access the drive directly
+#ifdef WIN32
+static int sourceDrive = 0;
+#endif
+
+static DiskImage* newDiskImage() {
+#ifdef WIN32
+    return new DiskImage(sourceDrive);
+#else
+    if (!sourcePath) return new DiskImage((int)0); // arbitrary int, argument will be ignored
+    return new DiskImage(sourcePath);
+#endif
+}
+
 int main(int argc, char** argv) {
+    int threads = 1; // sequential extraction by default
+    while (argc > 1 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-j") && argc > 2) {
+            threads = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
 #if defined _CARBON_
     if (argc < 2) {
         printUsage();
@@ -196,19 +229,19 @@ int main(int argc, char** argv) {
 #ifdef WIN32
     char drive = toupper(*(argv[1]))-'A';
     printf("opening drive %c:\n",drive+'a'); 
-    pImage = new DiskImage(drive);
+    sourceDrive = drive;
 #elif defined _CARBON_
     if (argc == 2) {
         printf("Opening AKAI media at '/dev/rdisk1s0'\n");
-        pImage = new DiskImage((int)0); // arbitrary int, argument will be ignored
     } else {
         printf("Opening source AKAI image file at '%s'\n", argv[1]);
-        pImage = new DiskImage(argv[1]);
+        sourcePath = argv[1];
     }
 #else
     printf("Opening AKAI media or image file at '%s'\n", argv[1]);
-    pImage = new DiskImage(argv[1]);
+    sourcePath = argv[1];
 #endif
+    pImage = newDiskImage();
 
     // determine output directory path
 #if defined _CARBON_
@@ -344,7 +377,10 @@ int main(int argc, char** argv) {
           }
       }
       if (dir) closedir(dir);
-      if (!errorOccured) {
+      if (!errorOccured && threads != 1) {
+          printf("Starting parallel extraction...\n");
+          extractVolumesParallel(outPath, totalSamples, threads, errorOccured);
+      } else if (!errorOccured) {
           printf("Starting extraction...\n");
           long currentsample = 1;
           uint i;
@@ -373,47 +409,12 @@ int main(int argc, char** argv) {
                                      totalSamples,
                                      DirEntry.mName.c_str());
                               fflush(stdout);
-#if USE_DISK_STREAMING
-                              if (pSample->LoadHeader()) {
-                                  uint16_t* pSampleBuf = new uint16_t[pSample->mNumberOfSamples];
-                                  pSample->Read(pSampleBuf, pSample->mNumberOfSamples);
-
-                                  String filename = outPath + String("/") + DirEntry.mName + ".wav";
-                                  int res = writeWav(pSample,
-                                                     filename.c_str(),
-                                                     pSampleBuf,
-                                                     pSample->mNumberOfSamples);
-                                  if (res < 0) {
-                                      printf("couldn't write sample data\n");
-                                      errorOccured = true;
-                                  }
-                                  else printf("ok\n");
-                                  delete[] pSampleBuf;
-                              }
-                              else {
-                                  printf("failed to load sample data\n");
-                                  errorOccured = true;
-                              }
-#else // no disk streaming
-                              if (pSample->LoadSampleData()) {
-
-                                  String filename = outPath + String("/") + DirEntry.mName + ".wav";
-                                  int res = writeWav(pSample,
-                                                     filename.c_str(),
-                                                     pSample->mpSamples,
-                                                     pSample->mNumberOfSamples);
-                                  if (res < 0) {
-                                      printf("couldn't write sample data\n");
-                                      errorOccured = true;
-                                  }
-                                  else printf("ok\n");
-                                  pSample->ReleaseSampleData();
-                              }
-                              else {
-                                  printf("failed to load sample data\n");
+                              const char* err = extractSample(pSample, DirEntry, outPath);
+                              if (err) {
+                                  printf("%s\n", err);
                                   errorOccured = true;
                               }
-#endif // USE_DISK_STREAMING
+                              else printf("ok\n");
                               pSample->Release();
                               samp++;
                           }
@@ -458,6 +459,151 @@ int main(int argc, char** argv) {
 #endif
 }
 
+/**
+ * Writes the given sample as .wav file to @a outPath.
+ *
+ * @returns NULL on success, error message otherwise
+ */
+const char* extractSample(AkaiSample* pSample, const AkaiDirEntry& DirEntry, const char* outPath) {
+    String filename = outPath + String("/") + DirEntry.mName + ".wav";
+#if USE_DISK_STREAMING
+    if (!pSample->LoadHeader())
+        return "failed to load sample data";
+    if (writeWav(pSample, filename.c_str(),
+                 NULL, // stream from disk
+                 pSample->mNumberOfSamples) < 0)
+        return "couldn't write sample data";
+#else // no disk streaming
+    if (!pSample->LoadSampleData())
+        return "failed to load sample data";
+    int res = writeWav(pSample, filename.c_str(),
+                       pSample->mpSamples,
+                       pSample->mNumberOfSamples);
+    pSample->ReleaseSampleData();
+    if (res < 0)
+        return "couldn't write sample data";
+#endif // USE_DISK_STREAMING
+    return NULL;
+}
+
+// one volume to be extracted by a worker thread
+struct VolumeJob {
+    uint partition;
+    uint volume;
+    long firstSample; // running number of the volume's first sample (for output)
+};
+
+// handles of one worker thread, each thread uses its own DiskImage
+struct ExtractionContext {
+    DiskImage* pImage;
+    AkaiDisk*  pAkai;
+};
+
+struct ParallelExtraction {
+    std::vector<VolumeJob> jobs;
+    const char* outPath;
+    long totalSamples;
+    mutex_t mutex; // protects all members below and stdout
+    std::vector<ExtractionContext> contexts; // all contexts created so far
+    std::vector<ExtractionContext> idle; // contexts currently not in use by a thread
+    bool errorOccured;
+};
+
+static void extractVolumeJob(void* arg, size_t index) {
+    ParallelExtraction* p = (ParallelExtraction*) arg;
+    ExtractionContext ctx;
+    {
+        mutex_lock_t lock(p->mutex);
+        if (p->errorOccured) return;
+        if (p->idle.empty()) {
+            ctx.pImage = newDiskImage();
+            ctx.pAkai  = new AkaiDisk(ctx.pImage);
+            ctx.pAkai->GetPartitionCount();
+            p->contexts.push_back(ctx);
+        } else {
+            ctx = p->idle.back();
+            p->idle.pop_back();
+        }
+    }
+
+    const VolumeJob& job = p->jobs[index];
+    AkaiPartition* pPartition = ctx.pAkai->GetPartition(job.partition);
+    AkaiVolume* pVolume = (pPartition) ? pPartition->GetVolume(job.volume) : NULL;
+    if (pVolume) {
+        std::list<AkaiDirEntry> Samples;
+        pVolume->ListSamples(Samples);
+        std::list<AkaiDirEntry>::iterator it;
+        std::list<AkaiDirEntry>::iterator end = Samples.end();
+        uint samp = 0;
+        for (it = Samples.begin(); it != end; it++, samp++) {
+            AkaiSample* pSample = pVolume->GetSample(samp);
+            const char* err = extractSample(pSample, *it, p->outPath);
+            pSample->Release();
+
+            mutex_lock_t lock(p->mutex);
+            printf("Extracting Sample (%ld/%ld) %s...%s\n",
+                   job.firstSample + samp, p->totalSamples,
+                   it->mName.c_str(), (err) ? err : "ok");
+            fflush(stdout);
+            if (err) p->errorOccured = true;
+            if (p->errorOccured) break;
+        }
+        pVolume->Release();
+    }
+    if (pPartition) pPartition->Release();
+
+    mutex_lock_t lock(p->mutex);
+    p->idle.push_back(ctx);
+}
+
+/**
+ * Extracts all samples of the source by distributing the volumes over
+ * @a threads worker threads, each one accessing the source with its own
+ * DiskImage object (so no locking is required for reading the media).
+ */
+void extractVolumesParallel(const char* outPath, long totalSamples, int threads, bool& errorOccured) {
+    ParallelExtraction p;
+    p.outPath      = outPath;
+    p.totalSamples = totalSamples;
+    p.errorOccured = false;
+
+    // collect the volumes to be extracted
+    DiskImage* pImage = newDiskImage();
+    AkaiDisk* pAkai = new AkaiDisk(pImage);
+    long currentsample = 1;
+    for (uint i = 0; i < pAkai->GetPartitionCount(); i++) {
+        AkaiPartition* pPartition = pAkai->GetPartition(i);
+        if (!pPartition) continue;
+        std::list<AkaiDirEntry> Volumes;
+        pPartition->ListVolumes(Volumes);
+        for (uint vol = 0; vol < Volumes.size(); vol++) {
+            AkaiVolume* pVolume = pPartition->GetVolume(vol);
+            if (!pVolume) continue;
+            std::list<AkaiDirEntry> Samples;
+            VolumeJob job;
+            job.partition   = i;
+            job.volume      = vol;
+            job.firstSample = currentsample;
+            currentsample += pVolume->ListSamples(Samples);
+            if (!Samples.empty()) p.jobs.push_back(job);
+            pVolume->Release();
+        }
+        pPartition->Release();
+    }
+    // this one is reused by the first worker thread
+    ExtractionContext ctx = { pImage, pAkai };
+    p.contexts.push_back(ctx);
+    p.idle.push_back(ctx);
+
+    __parallel_for(p.jobs.size(), threads, extractVolumeJob, &p);
+
+    for (size_t i = 0; i < p.contexts.size(); ++i) {
+        delete p.contexts[i].pAkai;
+        delete p.contexts[i].pImage;
+    }
+    if (p.errorOccured) errorOccured = true;
+}
+
 // only for debugging
 void ConvertAkaiToAscii(char * buffer, int length)
 {
@@ -482,7 +628,15 @@ void ConvertAkaiToAscii(char * buffer, int length)
   buffer[length+1] = '\0';
 }
 
+/**
+ * Writes the given sample as .wav file. If @a samples is NULL, the sample
+ * data is streamed from disk block by block with AkaiSample::Read() (16 bit
+ * mono), so the whole sample never has to be held in RAM.
+ */
 int writeWav(AkaiSample* sample, const char* filename, void* samples, long samplecount, int channels, int bitdepth, long rate) {
+    std::vector<int16_t> buffer(samples ? 0 : STREAMING_BLOCK_SIZE);
+    int16_t* streamBuffer = (samples) ? NULL : &buffer[0];
+    if (!samples) sample->SetPos(0);
 #if HAVE_SNDFILE
     SNDFILE* hfile;
     SF_INFO  sfinfo;
@@ -525,6 +679,19 @@ int writeWav(AkaiSample* sample, const char* filename, void* samples, long sampl
         instr.loops[i].count = 0; // infinite
     }
     sf_command(hfile, SFC_SET_INSTRUMENT, &instr, sizeof(instr));
+    if (!samples) {
+        for (long pos = 0; pos < samplecount; ) {
+            int n = sample->Read(streamBuffer, STREAMING_BLOCK_SIZE);
+            if (n <= 0 || sf_write_short(hfile, streamBuffer, n) != n) {
+                cerr << "Error: Could not stream sample data to \'" << filename << "\'.\n" << flush;
+                sf_close(hfile);
+                return -1;
+            }
+            pos += n;
+        }
+        sf_close(hfile);
+        return 0;
+    }
     sf_count_t res = bitdepth == 24 ?
         sf_write_int(hfile, static_cast<int*>(samples), channels * samplecount) :
         sf_write_short(hfile, static_cast<short*>(samples), channels * samplecount);
@@ -543,7 +710,15 @@ int writeWav(AkaiSample* sample, const char* filename, void* samples, long sampl
     if (setup == AF_NULL_FILESETUP) return -1;
     AFfilehandle hFile = _afOpenFile(filename, "w", setup);
     if (hFile == AF_NULL_FILEHANDLE) return -1;
-    if (_afWriteFrames(hFile, AF_DEFAULT_TRACK, samples, samplecount) < 0) return -1;
+    if (samples) {
+        if (_afWriteFrames(hFile, AF_DEFAULT_TRACK, samples, samplecount) < 0) return -1;
+    } else {
+        for (long pos = 0; pos < samplecount; ) {
+            int n = sample->Read(streamBuffer, STREAMING_BLOCK_SIZE);
+            if (n <= 0 || _afWriteFrames(hFile, AF_DEFAULT_TRACK, streamBuffer, n) < 0) return -1;
+            pos += n;
+        }
+    }
     _afCloseFile(hFile);
     _afFreeFileSetup(setup);
 #endif // HAVE_SNDFILE
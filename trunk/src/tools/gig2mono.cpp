@@ -30,11 +30,14 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <string.h>
+#include <stdio.h>
 #include <iostream>
 #include <cstdlib>
 #include <string>
 #include <set>
 #include <vector>
+#include <map>
+#include <utility>
 
 #ifdef WIN32
 # define DIR_SEPARATOR '\\'
@@ -140,173 +143,212 @@ static void collectFiles(string path, bool bRecurse, bool* pbError = NULL) {
     }
 }
 
-static bool convertFileToMono(const string path) {
-    try {
-        RIFF::File riff(path);
-        gig::File gig(&riff);
-        
-        gig::buffer_t decompressionBuffer;
-        unsigned long decompressionBufferSize = 0; // in sample points, not bytes
-        vector< vector<uint8_t> > audioBuffers;
-        vector<uint8_t> stereoBuffer;
-        
-        // count the total amount of samples
-        int nSamples = 0;
-        for (gig::Sample* pSample = gig.GetFirstSample(); pSample; pSample = gig.GetNextSample())
-            nSamples++;
-
-        audioBuffers.resize(nSamples);
+/**
+ * Source of the mono data written by monoSampleSource(): the stereo samples
+ * are read from the unmodified original file, one sample after another.
+ */
+struct mono_source_t {
+    gig::File* pSourceFile; ///< Unmodified original file.
+    map<gig::Sample*, uint> stereoSamples; ///< Index of the stereo sample in @c pSourceFile by new mono sample.
+    gig::Sample* pCurrent; ///< New mono sample currently being written.
+    gig::SampleReader* pReader; ///< Reads the stereo sample of @c pCurrent.
+    vector<uint8_t> stereoBuffer;
+
+    mono_source_t() : pSourceFile(NULL), pCurrent(NULL), pReader(NULL) {}
+    ~mono_source_t() { close(); }
+
+    void close() {
+        if (pReader) delete pReader;
+        pReader = NULL;
+        pCurrent = NULL;
+    }
+};
 
-        // read all original (stereo) sample audio data, convert it to mono and
-        // keep the mono audio data in tempoary buffers in RAM
-        bool bModified = false;
-        int i = 0;
-        for (gig::Sample* pSample = gig.GetFirstSample(); pSample; pSample = gig.GetNextSample(), ++i) {
-            if (pSample->Channels != 2)
-                continue; // ignore samples not being stereo
-
-            // ensure audio conversion buffer is large enough for this sample
-            const long neededStereoSize = pSample->SamplesTotal * pSample->FrameSize;
-            const long neededMonoSize   = neededStereoSize / 2;
-            if (stereoBuffer.size() < neededStereoSize)
-                stereoBuffer.resize(neededStereoSize);
-            audioBuffers[i].resize(neededMonoSize);
-
-            // read sample's current (stereo) audio data
-            if (pSample->Compressed) {
-                if (decompressionBufferSize < pSample->SamplesTotal) {
-                    decompressionBufferSize = pSample->SamplesTotal;
-                    gig::Sample::DestroyDecompressionBuffer(decompressionBuffer);
-                    decompressionBuffer = gig::Sample::CreateDecompressionBuffer(pSample->SamplesTotal);
+/// Converts @a n stereo sample points from @a pIn to mono sample points to @a pOut.
+static void convertToMono(const uint8_t* pIn, uint8_t* pOut, gig::file_offset_t n, int bitDepth) {
+    if (bitDepth == 16) {
+        const int16_t* in = (const int16_t*) pIn;
+        int16_t* out = (int16_t*) pOut;
+        switch (g_conversionMethod) {
+            case CONVERT_LEFT_CHANNEL:
+                for (gig::file_offset_t m = 0; m < n; ++m) out[m] = in[2 * m];
+                break;
+            case CONVERT_RIGHT_CHANNEL:
+                for (gig::file_offset_t m = 0; m < n; ++m) out[m] = in[2 * m + 1];
+                break;
+            case CONVERT_MIX_CHANNELS:
+                for (gig::file_offset_t m = 0; m < n; ++m)
+                    out[m] = int16_t((int(in[2 * m]) + int(in[2 * m + 1])) / 2);
+                break;
+        }
+    } else { // 24 bit little endian
+        switch (g_conversionMethod) {
+            case CONVERT_LEFT_CHANNEL:
+            case CONVERT_RIGHT_CHANNEL: {
+                const uint8_t* in = pIn + ((g_conversionMethod == CONVERT_RIGHT_CHANNEL) ? 3 : 0);
+                for (gig::file_offset_t m = 0; m < n; ++m, in += 6, pOut += 3) {
+                    pOut[0] = in[0];
+                    pOut[1] = in[1];
+                    pOut[2] = in[2];
                 }
-                pSample->Read(&stereoBuffer[0], pSample->SamplesTotal, &decompressionBuffer);
-            } else {
-                pSample->Read(&stereoBuffer[0], pSample->SamplesTotal);
+                break;
             }
+            case CONVERT_MIX_CHANNELS:
+                for (gig::file_offset_t m = 0; m < n; ++m, pIn += 6, pOut += 3) {
+                    const int32_t l = int32_t(uint32_t(pIn[0]) << 8 | uint32_t(pIn[1]) << 16 | uint32_t(pIn[2]) << 24) >> 8;
+                    const int32_t r = int32_t(uint32_t(pIn[3]) << 8 | uint32_t(pIn[4]) << 16 | uint32_t(pIn[5]) << 24) >> 8;
+                    const int32_t y = (l + r) / 2;
+                    pOut[0] = y;
+                    pOut[1] = y >> 8;
+                    pOut[2] = y >> 16;
+                }
+                break;
+        }
+    }
+}
 
-            const int stereoFrameSize = pSample->FrameSize;
-            const int monoFrameSize   = stereoFrameSize / 2;
+/**
+ * Called by gig::File::SaveSequential() for each new mono sample (one after
+ * another). The original stereo sample is read and converted block by
+ * block, so the whole conversion runs with constant memory consumption.
+ */
+static gig::file_offset_t monoSampleSource(gig::Sample* pSample, void* pBuffer, gig::file_offset_t FrameCount, void* pUserData) {
+    mono_source_t* source = (mono_source_t*) pUserData;
+    if (source->pCurrent != pSample) {
+        source->close();
+        map<gig::Sample*, uint>::const_iterator it = source->stereoSamples.find(pSample);
+        if (it == source->stereoSamples.end()) return 0;
+        source->pReader = new gig::SampleReader(source->pSourceFile->GetSample(it->second));
+        source->pCurrent = pSample;
+    }
+    const int stereoFrameSize = source->pReader->GetSample()->FrameSize;
+    if (source->stereoBuffer.size() < FrameCount * stereoFrameSize)
+        source->stereoBuffer.resize(FrameCount * stereoFrameSize);
+    const gig::file_offset_t n = source->pReader->Read(&source->stereoBuffer[0], FrameCount);
+    convertToMono(&source->stereoBuffer[0], (uint8_t*) pBuffer, n, pSample->BitDepth);
+    if (n < FrameCount) source->close();
+    return n;
+}
 
-            // This condition must be satisfied for the conversion for() loops
-            // below to not end up beyond buffer boundaries. This check should
-            // only fail on corrupt .gig files.
-            if (stereoBuffer.size() % stereoFrameSize != 0) {
-                cerr << "Internal error: Invalid stereo data length (" << int(stereoBuffer.size()) << " bytes)" << endl;
-                return false; // error
-            }
+/// Replaces the file @a path by the (converted) file @a tmpPath.
+static bool replaceFile(const string& tmpPath, const string& path) {
+#ifndef WIN32
+    struct stat s;
+    if (!stat(path.c_str(), &s)) chmod(tmpPath.c_str(), s.st_mode & 07777);
+#else
+    remove(path.c_str()); // rename() does not replace existing files on Windows
+#endif
+    if (rename(tmpPath.c_str(), path.c_str())) {
+        cerr << strerror(errno) << " : could not replace '" << path << "' by '" << tmpPath << "'" << endl;
+        return false;
+    }
+    return true;
+}
 
-            // convert stereo -> mono
-            switch (g_conversionMethod) {
-                case CONVERT_LEFT_CHANNEL: {
-                    const int n = pSample->SamplesTotal;
-                    for (int m = 0; m < n; ++m) {
-                        for (int k = 0; k < monoFrameSize; ++k) {
-                            audioBuffers[i][m * monoFrameSize + k] = stereoBuffer[m * stereoFrameSize + k];
-                        }
-                    }
-                    break;
-                }
+/**
+ * Converts the stereo samples of .gig file given by @a path to mono samples.
+ * The converted file is written sequentially to @a outPath, the mono data
+ * being converted block by block on the fly.
+ *
+ * @param path - path and file name of .gig file to be converted
+ * @param outPath - path and file name the converted file is written to
+ * @param written - set to true if the converted file was written, false if
+ *                  there was nothing to convert
+ */
+static bool convertFileToMono(const string path, const string outPath, bool& written) {
+    written = false;
+    try {
+        RIFF::File riff(path);
+        gig::File gig(&riff);
 
-                case CONVERT_RIGHT_CHANNEL: {
-                    const int n = pSample->SamplesTotal;
-                    for (int m = 0; m < n; ++m) {
-                        for (int k = 0; k < monoFrameSize; ++k) {
-                            audioBuffers[i][m * monoFrameSize + k] = stereoBuffer[m * stereoFrameSize + k + monoFrameSize];
-                        }
-                    }
-                    break;
-                }
+        // collect all stereo samples with their index, which is their index
+        // in the unmodified original file as well
+        vector< pair<gig::Sample*, uint> > stereoSamples;
+        {
+            uint i = 0;
+            for (gig::Sample* pSample = gig.GetFirstSample(); pSample; pSample = gig.GetNextSample(), ++i)
+                if (pSample->Channels == 2) // ignore samples not being stereo
+                    stereoSamples.push_back(make_pair(pSample, i));
+        }
+        if (stereoSamples.empty()) {
+            cout << "[ignored: not stereo] " << flush;
+            return true; // success
+        }
 
-                case CONVERT_MIX_CHANNELS:
-                    switch (pSample->BitDepth) {
-                        case 16: {
-                            int16_t* in  = (int16_t*) &stereoBuffer[0];
-                            int16_t* out = (int16_t*) &audioBuffers[i][0];
-                            const int n = pSample->SamplesTotal;
-                            for (int m = 0; m < n; ++m) {
-                                const float l = in[m*2];
-                                const float r = in[m*2+1];
-                                out[m] = int16_t((l + r) * 0.5f);
-                            }
-                            break;
-                        }
-
-                        case 24: {
-                            int8_t* p = (int8_t*) &stereoBuffer[0];
-                            int16_t* out = (int16_t*) &audioBuffers[i][0];
-                            const int n = pSample->SamplesTotal;
-                            for (int t = 0, m = 0; m < n; t += 6, ++m) {
-                                #if WORDS_BIGENDIAN
-                                const float l = p[t + 0] << 8 | p[t + 1] << 16 | p[t + 2] << 24;
-                                const float r = p[t + 3] << 8 | p[t + 4] << 16 | p[t + 5] << 24;
-                                #else
-                                // 24bit read optimization: 
-                                // a misaligned 32bit read and subquent 8 bit shift is faster (on x86)  than reading 3 single bytes and shifting them
-                                const float l = (*((int32_t *)(&p[t])))   << 8;
-                                const float r = (*((int32_t *)(&p[t+3]))) << 8;
-                                #endif
-                                out[m] = int16_t((l + r) * 0.5f);
-                            }
-                            break;
-                        }
-
-                        default:
-                            cerr << "Internal error: Invalid sample bit depth (" << int(pSample->BitDepth) << " bit)" << endl;
-                            return false; // error
-                    }
-                    break;
-                    
-                default:
-                    cerr << "Internal error: Invalid conversion method (#" << int(g_conversionMethod) << ")" << endl;
-                    return false; // error
+        for (size_t k = 0; k < stereoSamples.size(); ++k) {
+            gig::Sample* pSample = stereoSamples[k].first;
+            if (pSample->BitDepth != 16 && pSample->BitDepth != 24) {
+                cerr << "Internal error: Invalid sample bit depth (" << int(pSample->BitDepth) << " bit)" << endl;
+                return false; // error
             }
+        }
 
-            // update sample's meta informations for mono
-            pSample->Channels = 1;
-            if (pSample->FrameSize) pSample->FrameSize /= 2;
+        // the stereo sample data is streamed from the unmodified original
+        // file while the converted file is written (see monoSampleSource())
+        RIFF::File sourceRiff(path);
+        gig::File sourceGig(&sourceRiff);
+        sourceGig.SetLazySampleScan(true);
+        mono_source_t source;
+        source.pSourceFile = &sourceGig;
+
+        // create a mono sample for each stereo sample, since the wave data
+        // of existing samples stored in the file is always copied as it is
+        map<gig::Sample*, gig::Sample*> monoSamples;
+        for (size_t k = 0; k < stereoSamples.size(); ++k) {
+            gig::Sample* pStereoSample = stereoSamples[k].first;
+            gig::Sample* pMonoSample = gig.AddSample();
+            pStereoSample->GetGroup()->AddSample(pMonoSample);
+
+            pMonoSample->pInfo->Name      = pStereoSample->pInfo->Name;
+            pMonoSample->Channels         = 1;
+            pMonoSample->SamplesPerSecond = pStereoSample->SamplesPerSecond;
+            pMonoSample->BitDepth         = pStereoSample->BitDepth;
+            pMonoSample->FrameSize        = pStereoSample->BitDepth / 8;
+            pMonoSample->MIDIUnityNote    = pStereoSample->MIDIUnityNote;
+            pMonoSample->FineTune         = pStereoSample->FineTune;
+            pMonoSample->Loops            = pStereoSample->Loops;
+            pMonoSample->LoopType         = pStereoSample->LoopType;
+            pMonoSample->LoopStart        = pStereoSample->LoopStart;
+            pMonoSample->LoopEnd          = pStereoSample->LoopEnd;
+            pMonoSample->LoopSize         = pStereoSample->LoopSize;
+            pMonoSample->LoopPlayCount    = pStereoSample->LoopPlayCount;
             // libgig does not support saving of compressed samples
-            pSample->Compressed = false;
-
-            // schedule sample for physical resize operation
-            pSample->Resize(pSample->SamplesTotal);
+            pMonoSample->Compressed = false;
 
-            bModified = true;
-        }
+            // schedule new sample for resize (will be performed when the file is written)
+            pMonoSample->Resize(pStereoSample->SamplesTotal);
 
-        if (!bModified) {
-            cout << "[ignored: not stereo] " << flush;
-            return true; // success
+            monoSamples[pStereoSample] = pMonoSample;
+            source.stereoSamples[pMonoSample] = stereoSamples[k].second;
         }
 
-        // remove all stereo dimensions (if any)
+        // replace the stereo sample references by the mono ones and remove
+        // all stereo dimensions (if any)
         for (gig::Instrument* instr = gig.GetFirstInstrument(); instr; instr = gig.GetNextInstrument()) {
             for (gig::Region* rgn = instr->GetFirstRegion(); rgn; rgn = instr->GetNextRegion()) {
+                map<gig::Sample*, gig::Sample*>::const_iterator it = monoSamples.find(rgn->GetSample());
+                if (it != monoSamples.end()) rgn->SetSample(it->second);
+                for (uint dr = 0; dr < rgn->DimensionRegions; ++dr) {
+                    if (!rgn->pDimensionRegions[dr]) continue;
+                    it = monoSamples.find(rgn->pDimensionRegions[dr]->pSample);
+                    if (it != monoSamples.end()) rgn->pDimensionRegions[dr]->SetSample(it->second);
+                }
                 for (int k = 0; k < 8; ++k) {
                     if (rgn->pDimensionDefinitions[k].dimension == gig::dimension_samplechannel) {
                         rgn->DeleteDimension(&rgn->pDimensionDefinitions[k]);
-                        goto nextRegion;
+                        break;
                     }
                 }
-                nextRegion:;
             }
         }
 
-        // Make sure sample chunks are resized to the required size on disk,
-        // so we can directly write the audio data directly to the file on disk
-        // as next step. This is required because in worst case the original
-        // stereo sample audio data might be compressed and might be smaller in
-        // size than the final (always uncompressed) mono audio data size.
-        gig.Save();
-
-        // now convert and write the samples' mono audio data directly to the file
-        i = 0;
-        for (gig::Sample* pSample = gig.GetFirstSample(); pSample; pSample = gig.GetNextSample(), ++i) {
-            if (audioBuffers[i].empty())
-                continue; // was not a stereo sample before, so ignore this one
-
-            const int n = audioBuffers[i].size() / pSample->FrameSize;
-            pSample->Write(&audioBuffers[i][0], n);
-        }
+        // drop the stereo samples
+        for (size_t k = 0; k < stereoSamples.size(); ++k)
+            gig.DeleteSample(stereoSamples[k].first);
+
+        gig.SaveSequential(outPath, monoSampleSource, &source);
+        source.close();
+        written = true;
     } catch (RIFF::Exception e) {
         cerr << "Failed converting file:" << endl;
         e.PrintMessage();
@@ -378,8 +420,16 @@ int main(int argc, char *argv[]) {
         int i = 0;
         for (set<string>::const_iterator it = g_files.begin(); it != g_files.end(); ++it, ++i) {
             cout << "Converting file " << (i+1) << "/" << int(g_files.size()) << ": " << *it << " ... " << flush;
-            bool bSuccess = convertFileToMono(*it);
-            if (!bSuccess) return EXIT_FAILURE;
+            // the converted file is written to a temporary file first, which
+            // replaces the original file on success
+            const string tmpPath = *it + ".tmp";
+            bool bWritten = false;
+            bool bSuccess = convertFileToMono(*it, tmpPath, bWritten);
+            if (bSuccess && bWritten) bSuccess = replaceFile(tmpPath, *it);
+            if (!bSuccess) {
+                remove(tmpPath.c_str());
+                return EXIT_FAILURE;
+            }
             cout << "OK" << endl;
         }
     }
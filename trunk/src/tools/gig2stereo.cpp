@@ -30,6 +30,7 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <string.h>
+#include <stdio.h>
 #include <iostream>
 #include <cstdlib>
 #include <string>
@@ -185,11 +186,99 @@ static string stripAudioChannelFromName(const string& s) {
         cerr << " Merging anyway (upon request)!\n"; \
     }
 
+/**
+ * Source of the true stereo data written by stereoSampleSource(): the mono
+ * sample pairs are read from the unmodified original file, one stereo
+ * sample after another.
+ */
+struct stereo_source_t {
+    gig::File* pSourceFile; ///< Unmodified original file.
+    map<gig::Sample*, pair<uint,uint> > monoPairs; ///< Indices of the left and right mono sample in @c pSourceFile by new stereo sample.
+    gig::Sample* pCurrent; ///< New stereo sample currently being written.
+    gig::StereoPairReader* pReader; ///< Interleaves both mono samples of @c pCurrent.
+    gig::SampleReader* pRightTail; ///< Reads the rest of the right channel, if it is longer than the left one.
+    gig::file_offset_t pos; ///< Current position in @c pCurrent (in sample points).
+    vector<uint8_t> tailBuffer;
+
+    stereo_source_t() : pSourceFile(NULL), pCurrent(NULL), pReader(NULL), pRightTail(NULL), pos(0) {}
+    ~stereo_source_t() { close(); }
+
+    void close() {
+        if (pReader) delete pReader;
+        if (pRightTail) delete pRightTail;
+        pReader = NULL;
+        pRightTail = NULL;
+        pCurrent = NULL;
+    }
+};
+
+/**
+ * Called by gig::File::SaveSequential() for each new stereo sample (one
+ * after another). The mono sample pair is read and interleaved block by
+ * block, so the whole conversion runs with constant memory consumption.
+ */
+static gig::file_offset_t stereoSampleSource(gig::Sample* pSample, void* pBuffer, gig::file_offset_t FrameCount, void* pUserData) {
+    stereo_source_t* source = (stereo_source_t*) pUserData;
+    if (source->pCurrent != pSample) {
+        source->close();
+        map<gig::Sample*, pair<uint,uint> >::const_iterator it = source->monoPairs.find(pSample);
+        if (it == source->monoPairs.end()) return 0;
+        source->pReader = new gig::StereoPairReader(
+            source->pSourceFile->GetSample(it->second.first),
+            source->pSourceFile->GetSample(it->second.second)
+        );
+        source->pCurrent = pSample;
+        source->pos = 0;
+    }
+    const gig::file_offset_t total = pSample->GetSize();
+    if (FrameCount > total - source->pos) FrameCount = total - source->pos;
+    gig::file_offset_t n = source->pReader->Read(pBuffer, FrameCount);
+    if (n < FrameCount) {
+        // left mono sample is shorter than the right one, silence left channel
+        gig::Sample* pRight = source->pReader->GetRightSample();
+        if (!source->pRightTail) {
+            source->pRightTail = new gig::SampleReader(pRight);
+            source->pRightTail->SetPos(source->pos + n);
+        }
+        const int bytes = pRight->FrameSize;
+        if (source->tailBuffer.size() < (FrameCount - n) * bytes)
+            source->tailBuffer.resize((FrameCount - n) * bytes);
+        const gig::file_offset_t m = source->pRightTail->Read(&source->tailBuffer[0], FrameCount - n);
+        uint8_t* pOut = (uint8_t*) pBuffer + n * 2 * bytes;
+        for (gig::file_offset_t i = 0; i < m; ++i, pOut += 2 * bytes) {
+            memset(pOut, 0, bytes);
+            memcpy(pOut + bytes, &source->tailBuffer[i * bytes], bytes);
+        }
+        n += m;
+    }
+    source->pos += n;
+    if (source->pos == total || !n) source->close();
+    return n;
+}
+
+/// Replaces the file @a path by the (converted) file @a tmpPath.
+static bool replaceFile(const string& tmpPath, const string& path) {
+#ifndef WIN32
+    struct stat s;
+    if (!stat(path.c_str(), &s)) chmod(tmpPath.c_str(), s.st_mode & 07777);
+#else
+    remove(path.c_str()); // rename() does not replace existing files on Windows
+#endif
+    if (rename(tmpPath.c_str(), path.c_str())) {
+        cerr << strerror(errno) << " : could not replace '" << path << "' by '" << tmpPath << "'" << endl;
+        return false;
+    }
+    return true;
+}
+
 /**
  * Converts .gig file given by @a path towards using true stereo interleaved
  * samples.
  *
  * @param path - path and file name of .gig file to be converted
+ * @param outPath - path and file name the converted file is written to
+ * @param written - set to true if the converted file was written, false if
+ *                  there was nothing to convert
  * @param keep - if true: do not delete the old mono samples, even if they are
  *               not referenced at all anymore after conversion
  * @param forceReplace - By default certain references of the old mono samples
@@ -207,12 +296,22 @@ static string stripAudioChannelFromName(const string& s) {
  *                    information to be printed to the console while doing the
  *                    conversion (0 .. 2)
  */
-static bool convertFileToStereo(const string path, bool keep, bool forceReplace, bool skipIncompatible, int verbose) {
+static bool convertFileToStereo(const string path, const string outPath, bool& written, bool keep, bool forceReplace, bool skipIncompatible, int verbose) {
+    written = false;
     try {
         // open .gig file
         RIFF::File riff(path);
         gig::File gig(&riff);
 
+        // remember the index of each sample, which is its index in the
+        // unmodified original file as well
+        map<gig::Sample*, uint> sampleIndices;
+        {
+            uint i = 0;
+            for (gig::Sample* pSample = gig.GetFirstSample(); pSample; pSample = gig.GetNextSample(), ++i)
+                sampleIndices[pSample] = i;
+        }
+
         typedef pair<gig::DimensionRegion*, gig::DimensionRegion*> DimRgnPair;
         typedef pair<gig::Sample*, gig::Sample*> SamplePair;
 
@@ -373,7 +472,7 @@ static bool convertFileToStereo(const string path, bool keep, bool forceReplace,
             // libgig does not support saving of compressed samples
             pStereoSample->Compressed = false;
 
-            // schedule new sample for resize (will be performed when gig.Save() is called)
+            // schedule new sample for resize (will be performed when the file is written)
             const long newStereoSamplesTotal = max(pSampleL->SamplesTotal, pSampleR->SamplesTotal);
             if (verbose >= 2) cout << "Resize new stereo sample '" << pStereoSample->pInfo->Name << "' to " << newStereoSamplesTotal << " sample points.\n" << flush;
             pStereoSample->Resize(newStereoSamplesTotal);
@@ -383,94 +482,29 @@ static bool convertFileToStereo(const string path, bool keep, bool forceReplace,
         }
         if (verbose) cout << "Done.\n" << flush;
 
-        // increase the .gig file size appropriately
-        if (verbose) cout << "Increase file size ... " << flush;
-        gig.Save();
-        if (verbose) cout << "Done.\n" << flush;
-
-        vector<uint8_t> bufferMono[2];
-        vector<uint8_t> stereoBuffer;
-        gig::buffer_t decompressionBuffer;
-        unsigned long decompressionBufferSize = 0; // in sample points, not bytes
+        if (samplePairsFiltered.empty()) {
+            if (verbose) cout << "Nothing to convert.\n" << flush;
+            return true; // success
+        }
 
-        // do the actual sample conversion of each mono -> stereo sample by
-        // reading/writing directly from/to disk
-        if (verbose) cout << "Convert mono pair data to true stereo data ... " << flush;
-        if (verbose >= 2) cout << endl;
+        // the mono sample data is streamed from the unmodified original file
+        // while the converted file is written (see stereoSampleSource())
+        RIFF::File sourceRiff(path);
+        gig::File sourceGig(&sourceRiff);
+        sourceGig.SetLazySampleScan(true);
+        stereo_source_t source;
+        source.pSourceFile = &sourceGig;
         set<gig::Sample*> allAffectedMonoSamples;
-        for (map<SamplePair, vector<DimRgnPair> >::iterator it = samplePairsFiltered.begin();
-             it != samplePairsFiltered.end(); ++it)
+        for (map<SamplePair, gig::Sample*>::iterator it = targetStereoSamples.begin();
+             it != targetStereoSamples.end(); ++it)
         {
-            gig::Sample* pSampleL = it->first.first;
-            gig::Sample* pSampleR = it->first.second;
-            gig::Sample* pSampleMono[2] = { pSampleL, pSampleR };
-            gig::Sample* pStereoSample = targetStereoSamples[it->first];
-
-            if ((pSampleMono[0]->SamplesTotal != pStereoSample->GetSize() && 
-                 pSampleMono[1]->SamplesTotal != pStereoSample->GetSize()) || pStereoSample->GetSize() <= 0)
-            {
-                cerr << "Stereo length " << pStereoSample->GetSize() << ", mono L size " << pSampleL->SamplesTotal << ", mono R size " << pSampleR->SamplesTotal << "\n" << flush;
-                cerr << "CRITICAL ERROR: Ill sample sizes detected! Aborting.\n";
-                exit(-1);
-            }
-
-            allAffectedMonoSamples.insert(pSampleL);
-            allAffectedMonoSamples.insert(pSampleR);
-
-            const long neededStereoSize = pStereoSample->GetSize() * pStereoSample->FrameSize;
-            if (stereoBuffer.size() < neededStereoSize)
-                stereoBuffer.resize(neededStereoSize);
-
-            if (bufferMono[0].size() < neededStereoSize / 2) {
-                bufferMono[0].resize(neededStereoSize / 2);
-                bufferMono[1].resize(neededStereoSize / 2);
-            }
-            memset(&bufferMono[0][0], 0, bufferMono[0].size());
-            memset(&bufferMono[1][0], 0, bufferMono[1].size());
-
-            // read mono samples from disk
-            for (int iChan = 0; iChan < 2; ++iChan) {
-                pSampleMono[iChan]->SetPos(0);
-                unsigned long pointsRead = 0;
-                if (pSampleMono[iChan]->Compressed) {
-                    if (decompressionBufferSize < pSampleMono[iChan]->SamplesTotal) {
-                        decompressionBufferSize = pSampleMono[iChan]->SamplesTotal;
-                        gig::Sample::DestroyDecompressionBuffer(decompressionBuffer);
-                        decompressionBuffer = gig::Sample::CreateDecompressionBuffer(pSampleMono[iChan]->SamplesTotal);
-                    }
-                    pointsRead = pSampleMono[iChan]->Read(&bufferMono[iChan][0], pSampleMono[iChan]->SamplesTotal, &decompressionBuffer);
-                } else {
-                    pointsRead = pSampleMono[iChan]->Read(&bufferMono[iChan][0], pSampleMono[iChan]->SamplesTotal);
-                }
-                if (pointsRead != pSampleMono[iChan]->SamplesTotal) {
-                    cerr << "Read " << pointsRead << " sample points from mono sample " << ((iChan == 0) ? "L" : "R") << ".\n";
-                    cerr << "CRITICAL ERROR: Reading entire mono sample data from disk failed! Aborting.\n";
-                    exit(-1);
-                }
-            }
-
-            if (pSampleL->FrameSize != pSampleR->FrameSize || pStereoSample->FrameSize / 2 != pSampleL->FrameSize || pStereoSample->FrameSize < 1) {
-                cerr << "Stereo frame size " << pStereoSample->FrameSize << ", mono L frame size " << pSampleL->FrameSize << ", mono R frame size " << pSampleL->FrameSize << "\n" << flush;
-                cerr << "CRITICAL ERROR: Ill frame sizes detected! Aborting.\n";
-                exit(-1);
-            }
-
-            // convert from the 2 mono buffers to the stereo buffer
-            for (int s = 0; s < pStereoSample->GetSize(); ++s) {
-                memcpy(&stereoBuffer[s * pStereoSample->FrameSize], &bufferMono[0][s * pSampleL->FrameSize], pSampleL->FrameSize);
-                memcpy(&stereoBuffer[s * pStereoSample->FrameSize + pSampleL->FrameSize], &bufferMono[1][s * pSampleR->FrameSize], pSampleR->FrameSize);
-            }
-
-            // write converted stereo sample data directly to disk
-            if (verbose >= 2) cout << "Writing stereo sample '" << pStereoSample->pInfo->Name << "' (" << pStereoSample->GetSize() << " sample points).\n" << flush;
-            pStereoSample->SetPos(0);
-            unsigned long pointsWritten = pStereoSample->Write(&stereoBuffer[0], pStereoSample->GetSize());
-            if (verbose >= 2) cout << "Written " << pointsWritten << " sample points.\n" << flush;
+            allAffectedMonoSamples.insert(it->first.first);
+            allAffectedMonoSamples.insert(it->first.second);
+            source.monoPairs[it->second] = make_pair(
+                sampleIndices[it->first.first], sampleIndices[it->first.second]
+            );
         }
-        if (verbose) cout << "Done.\n" << flush;
 
-        // decompression buffer not needed anymore
-        gig::Sample::DestroyDecompressionBuffer(decompressionBuffer);
 
         // replace the old mono sample references by the new stereo sample
         // references for all instruments of the .gig file
@@ -492,7 +526,7 @@ static bool convertFileToStereo(const string path, bool keep, bool forceReplace,
                                 if (!rgn->pDimensionRegions[dr])
                                     continue;
                                 if (rgn->pDimensionRegions[dr]->pSample == pMonoSample) {
-                                    rgn->pDimensionRegions[dr]->pSample = pStereoSample;
+                                    rgn->pDimensionRegions[dr]->SetSample(pStereoSample);
                                 }
                             }
                         }
@@ -504,8 +538,8 @@ static bool convertFileToStereo(const string path, bool keep, bool forceReplace,
                 const vector<DimRgnPair>& dimRgnPairs = it->second;
                 gig::Sample* pStereoSample = targetStereoSamples[it->first];
                 for (int drp = 0; drp < dimRgnPairs.size(); ++drp) {
-                    dimRgnPairs[drp].first->pSample  = pStereoSample;
-                    dimRgnPairs[drp].second->pSample = pStereoSample;
+                    dimRgnPairs[drp].first->SetSample(pStereoSample);
+                    dimRgnPairs[drp].second->SetSample(pStereoSample);
                 }
             }
         }
@@ -558,9 +592,12 @@ static bool convertFileToStereo(const string path, bool keep, bool forceReplace,
             }
         }
 
-        // save sample reference changes (and drop deleted mono samples)
-        if (verbose) cout << "Saving final sample references to disk and shrink file ... " << flush;
-        gig.Save();
+        // write the converted file sequentially to outPath, the true
+        // stereo data is interleaved block by block on the fly
+        if (verbose) cout << "Writing converted file with true stereo data ... " << flush;
+        gig.SaveSequential(outPath, stereoSampleSource, &source);
+        source.close();
+        written = true;
         if (verbose) cout << "Done.\n" << flush;
 
     } catch (RIFF::Exception e) {
@@ -658,11 +695,19 @@ int main(int argc, char *argv[]) {
         for (set<string>::const_iterator it = g_files.begin(); it != g_files.end(); ++it, ++i) {
             cout << "Converting file " << (i+1) << "/" << int(g_files.size()) << ": " << *it << " ... " << flush;
             if (iVerbose) cout << endl;
+            // the converted file is written to a temporary file first, which
+            // replaces the original file on success
+            const string tmpPath = *it + ".tmp";
+            bool bWritten = false;
             bool bSuccess = convertFileToStereo(
-                *it, bOptionKeep, bOptionForceReplace, !bOptionMatchIncompatible,
-                iVerbose
+                *it, tmpPath, bWritten, bOptionKeep, bOptionForceReplace,
+                !bOptionMatchIncompatible, iVerbose
             );
-            if (!bSuccess) return EXIT_FAILURE;
+            if (bSuccess && bWritten) bSuccess = replaceFile(tmpPath, *it);
+            if (!bSuccess) {
+                remove(tmpPath.c_str());
+                return EXIT_FAILURE;
+            }
             cout << "OK" << endl;
         }
     }
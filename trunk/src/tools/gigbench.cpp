@@ -0,0 +1,797 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This program is part of libgig.                                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <new>
+
+#ifdef WIN32
+# include <windows.h>
+#else
+# include <sys/time.h>
+#endif
+
+#include "../gig.h"
+#include "../SF.h"
+#include "../Serialization.h"
+#include "../helper.h"
+
+using namespace std;
+
+// default amount of sample points to be preloaded for each sample (same order
+// of magnitude a disk streaming sampler engine typically uses)
+#define DEFAULT_PRELOAD_FRAMES  32768
+
+// default amount of sample points to be read per Read() call when streaming
+#define DEFAULT_STREAM_FRAMES   8192
+
+enum format_t {
+    FORMAT_GIG,
+    FORMAT_DLS,
+    FORMAT_SF2
+};
+
+struct bench_result_t {
+    string name;
+    double seconds;
+    long   items;       ///< Amount of objects processed (samples, instruments, regions, ...).
+    double bytes;       ///< Amount of sample data bytes processed (0 if not applicable).
+    double frames;      ///< Amount of sample points processed (0 if not applicable).
+    string details;     ///< Optional additional line printed below the result.
+};
+
+struct bench_options_t {
+    long preloadFrames;
+    long streamFrames;
+    int  repeat;
+    int  voices;        ///< Amount of concurrently streaming threads (0: no concurrent streaming stage).
+    bool serialization; ///< Whether to run the serialization stages.
+};
+
+string Revision();
+void PrintVersion();
+void PrintUsage();
+bool ParseLong(const string& s, long& result);
+double Now();
+format_t DetectFormat(RIFF::File* riff);
+string FormatName(format_t format);
+void RunBenchmark(const char* filename, const bench_options_t& opt, vector<bench_result_t>& results);
+void PrintResults(const vector<bench_result_t>& results);
+
+int main(int argc, char *argv[])
+{
+    bench_options_t opt;
+    opt.preloadFrames = DEFAULT_PRELOAD_FRAMES;
+    opt.streamFrames  = DEFAULT_STREAM_FRAMES;
+    opt.repeat        = 1;
+    opt.voices        = 0;
+    opt.serialization = false;
+
+    if (argc <= 1) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    int iArg;
+    for (iArg = 1; iArg < argc; ++iArg) {
+        const string opt_s = argv[iArg];
+        if (opt_s == "--") { // common for all command line tools: separator between initial option arguments and i.e. subsequent file arguments
+            iArg++;
+            break;
+        }
+        if (opt_s.substr(0, 1) != "-") break;
+
+        if (opt_s == "-v") {
+            PrintVersion();
+            return EXIT_SUCCESS;
+        } else if (opt_s == "--serialization") {
+            opt.serialization = true;
+        } else if (opt_s == "--preload" || opt_s == "--buffer" || opt_s == "--repeat" ||
+                   opt_s == "--voices") {
+            long value;
+            if (iArg + 1 >= argc || !ParseLong(argv[iArg + 1], value) || value < 1) {
+                cerr << "Option '" << opt_s << "' requires a positive number argument" << endl;
+                return EXIT_FAILURE;
+            }
+            ++iArg;
+            if (opt_s == "--preload") opt.preloadFrames = value;
+            else if (opt_s == "--buffer") opt.streamFrames = value;
+            else if (opt_s == "--voices") opt.voices = (int) value;
+            else opt.repeat = (int) value;
+        } else {
+            cerr << "Unknown option '" << opt_s << "'" << endl;
+            cerr << endl;
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (iArg >= argc) {
+        cout << "No file name provided!" << endl;
+        return EXIT_FAILURE;
+    }
+    const char* filename = argv[iArg];
+
+    FILE* hFile = fopen(filename, "r");
+    if (!hFile) {
+        cout << "Invalid file argument!" << endl;
+        return EXIT_FAILURE;
+    }
+    fclose(hFile);
+
+    try {
+        for (int i = 0; i < opt.repeat; ++i) {
+            if (opt.repeat > 1) cout << "Run " << (i + 1) << "/" << opt.repeat << ":" << endl;
+            vector<bench_result_t> results;
+            RunBenchmark(filename, opt, results);
+            PrintResults(results);
+            if (i + 1 < opt.repeat) cout << endl;
+        }
+    } catch (RIFF::Exception& e) {
+        e.PrintMessage();
+        return EXIT_FAILURE;
+    } catch (...) {
+        cout << "Unknown exception while trying to benchmark file." << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/// Returns current wall clock time in seconds.
+double Now() {
+#ifdef WIN32
+    LARGE_INTEGER freq, count;
+    if (QueryPerformanceFrequency(&freq) && QueryPerformanceCounter(&count))
+        return double(count.QuadPart) / double(freq.QuadPart);
+    return double(GetTickCount()) / 1000.0;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + double(tv.tv_usec) / 1000000.0;
+#endif
+}
+
+bool ParseLong(const string& s, long& result) {
+    if (s.empty()) return false;
+    char* end = NULL;
+    result = strtol(s.c_str(), &end, 10);
+    return end && *end == '\0';
+}
+
+format_t DetectFormat(RIFF::File* riff) {
+    if (riff->GetListType() == RIFF_TYPE_SF2) return FORMAT_SF2;
+    if (riff->GetListType() != RIFF_TYPE_DLS)
+        throw RIFF::Exception("Neither a Gigasampler, DLS nor SoundFont file");
+    // the gig format extends DLS, the 3GRI list (sample groups) only exists in gig files
+    return (riff->GetSubList(LIST_TYPE_3GRI)) ? FORMAT_GIG : FORMAT_DLS;
+}
+
+string FormatName(format_t format) {
+    switch (format) {
+        case FORMAT_GIG: return "Gigasampler";
+        case FORMAT_DLS: return "DLS";
+        case FORMAT_SF2: return "SoundFont 2";
+    }
+    return "unknown";
+}
+
+static bench_result_t makeResult(const string& name, double t0, long items,
+                                 double bytes = 0, double frames = 0)
+{
+    bench_result_t r;
+    r.name    = name;
+    r.seconds = Now() - t0;
+    r.items   = items;
+    r.bytes   = bytes;
+    r.frames  = frames;
+    return r;
+}
+
+static void benchGig(gig::File* gig, const bench_options_t& opt, vector<bench_result_t>& results) {
+    double t0 = Now();
+    long samples = 0;
+    for (gig::Sample* s = gig->GetFirstSample(); s; s = gig->GetNextSample())
+        ++samples;
+    results.push_back(makeResult("load samples", t0, samples));
+
+    t0 = Now();
+    long instruments = 0;
+    for (gig::Instrument* instr = gig->GetFirstInstrument(); instr; instr = gig->GetNextInstrument())
+        ++instruments;
+    results.push_back(makeResult("load instruments", t0, instruments));
+
+    t0 = Now();
+    long dimRgns = 0, unresolved = 0;
+    for (gig::Instrument* instr = gig->GetFirstInstrument(); instr; instr = gig->GetNextInstrument()) {
+        for (gig::Region* rgn = instr->GetFirstRegion(); rgn; rgn = instr->GetNextRegion()) {
+            for (uint i = 0; i < rgn->DimensionRegions; ++i) {
+                gig::DimensionRegion* d = rgn->pDimensionRegions[i];
+                if (!d) continue;
+                if (!d->pSample) ++unresolved;
+                ++dimRgns;
+            }
+        }
+    }
+    results.push_back(makeResult("resolve dimension regions", t0, dimRgns));
+    if (unresolved)
+        cout << "Note: " << unresolved << " dimension region(s) without sample." << endl;
+
+    t0 = Now();
+    double bytes = 0, frames = 0;
+    for (gig::Sample* s = gig->GetFirstSample(); s; s = gig->GetNextSample()) {
+        gig::buffer_t buf = s->LoadSampleData(opt.preloadFrames);
+        bytes  += buf.Size;
+        frames += (s->FrameSize) ? buf.Size / s->FrameSize : 0;
+    }
+    results.push_back(makeResult("preload sample heads", t0, samples, bytes, frames));
+    for (gig::Sample* s = gig->GetFirstSample(); s; s = gig->GetNextSample())
+        s->ReleaseSampleData();
+
+    // stream with an external decompression buffer like a disk streaming
+    // engine would do, so the internal one of each sample is not involved
+    gig::buffer_t decompressionBuffer =
+        gig::Sample::CreateDecompressionBuffer(opt.streamFrames);
+    t0 = Now();
+    bytes = frames = 0;
+    vector<uint8_t> buffer;
+    for (gig::Sample* s = gig->GetFirstSample(); s; s = gig->GetNextSample()) {
+        if (!s->FrameSize) continue;
+        buffer.resize(opt.streamFrames * s->FrameSize);
+        s->SetPos(0);
+        while (true) {
+            const RIFF::file_offset_t n = s->Read(&buffer[0], opt.streamFrames, &decompressionBuffer);
+            if (!n) break;
+            frames += n;
+            bytes  += n * s->FrameSize;
+        }
+    }
+    results.push_back(makeResult("stream samples", t0, samples, bytes, frames));
+    gig::Sample::DestroyDecompressionBuffer(decompressionBuffer);
+}
+
+static void benchDLS(DLS::File* dls, const bench_options_t& opt, vector<bench_result_t>& results) {
+    double t0 = Now();
+    long samples = 0;
+    for (DLS::Sample* s = dls->GetFirstSample(); s; s = dls->GetNextSample())
+        ++samples;
+    results.push_back(makeResult("load samples", t0, samples));
+
+    t0 = Now();
+    long instruments = 0;
+    for (DLS::Instrument* instr = dls->GetFirstInstrument(); instr; instr = dls->GetNextInstrument())
+        ++instruments;
+    results.push_back(makeResult("load instruments", t0, instruments));
+
+    t0 = Now();
+    long regions = 0;
+    for (DLS::Instrument* instr = dls->GetFirstInstrument(); instr; instr = dls->GetNextInstrument()) {
+        for (DLS::Region* rgn = instr->GetFirstRegion(); rgn; rgn = instr->GetNextRegion()) {
+            rgn->GetSample();
+            ++regions;
+        }
+    }
+    results.push_back(makeResult("resolve regions", t0, regions));
+
+    // DLS samples can only be loaded entirely into RAM, the preload stage thus
+    // reads the sample heads by Read() instead
+    t0 = Now();
+    double bytes = 0, frames = 0;
+    vector<uint8_t> buffer;
+    for (DLS::Sample* s = dls->GetFirstSample(); s; s = dls->GetNextSample()) {
+        if (!s->FrameSize) continue;
+        buffer.resize(opt.preloadFrames * s->FrameSize);
+        s->SetPos(0);
+        const RIFF::file_offset_t n = s->Read(&buffer[0], opt.preloadFrames);
+        frames += n;
+        bytes  += n * s->FrameSize;
+    }
+    results.push_back(makeResult("preload sample heads", t0, samples, bytes, frames));
+
+    t0 = Now();
+    bytes = frames = 0;
+    for (DLS::Sample* s = dls->GetFirstSample(); s; s = dls->GetNextSample()) {
+        if (!s->FrameSize) continue;
+        buffer.resize(opt.streamFrames * s->FrameSize);
+        s->SetPos(0);
+        while (true) {
+            const RIFF::file_offset_t n = s->Read(&buffer[0], opt.streamFrames);
+            if (!n) break;
+            frames += n;
+            bytes  += n * s->FrameSize;
+        }
+    }
+    results.push_back(makeResult("stream samples", t0, samples, bytes, frames));
+}
+
+static void benchSF2(sf2::File* sf, const bench_options_t& opt, vector<bench_result_t>& results) {
+    double t0 = Now();
+    const long samples = sf->GetSampleCount();
+    for (long i = 0; i < samples; ++i) sf->GetSample(i);
+    results.push_back(makeResult("load samples", t0, samples));
+
+    t0 = Now();
+    const long instruments = sf->GetInstrumentCount() + sf->GetPresetCount();
+    results.push_back(makeResult("load instruments, presets", t0, instruments));
+
+    t0 = Now();
+    long regions = 0;
+    for (int i = 0; i < sf->GetInstrumentCount(); ++i) {
+        sf2::Instrument* instr = sf->GetInstrument(i);
+        for (int j = 0; j < instr->GetRegionCount(); ++j) {
+            instr->GetRegion(j)->GetSample();
+            ++regions;
+        }
+    }
+    results.push_back(makeResult("resolve regions", t0, regions));
+
+    t0 = Now();
+    double bytes = 0, frames = 0;
+    for (long i = 0; i < samples; ++i) {
+        sf2::Sample* s = sf->GetSample(i);
+        sf2::Sample::buffer_t buf = s->LoadSampleData(opt.preloadFrames);
+        bytes  += buf.Size;
+        frames += (s->GetFrameSize()) ? buf.Size / s->GetFrameSize() : 0;
+    }
+    results.push_back(makeResult("preload sample heads", t0, samples, bytes, frames));
+    for (long i = 0; i < samples; ++i)
+        sf->GetSample(i)->ReleaseSampleData();
+
+    t0 = Now();
+    bytes = frames = 0;
+    vector<uint8_t> buffer;
+    for (long i = 0; i < samples; ++i) {
+        sf2::Sample* s = sf->GetSample(i);
+        if (!s->GetFrameSize()) continue;
+        buffer.resize(opt.streamFrames * s->GetFrameSize());
+        s->SetPos(0);
+        while (true) {
+            const unsigned long n = s->Read(&buffer[0], opt.streamFrames);
+            if (!n) break;
+            frames += n;
+            bytes  += n * s->GetFrameSize();
+        }
+    }
+    results.push_back(makeResult("stream samples", t0, samples, bytes, frames));
+}
+
+/*
+ * Concurrent streaming stage: each voice is a thread streaming another
+ * sample of the same file by Sample::ReadAndLoop(), with its own playback
+ * state and decompression buffer, like the disk thread(s) of a sampler
+ * would do.
+ */
+
+struct voice_t {
+    gig::Sample*          pSample;
+    gig::DimensionRegion* pDimRgn;   ///< Provides the loop informations.
+    long                  blockFrames;
+    double                frames;    ///< Out: amount of sample points streamed.
+    vector<double>        latencies; ///< Out: duration of each ReadAndLoop() call (in seconds).
+    bool                  failed;
+};
+
+static void streamVoice(void* arg) {
+    voice_t* voice = (voice_t*) arg;
+    gig::Sample* s = voice->pSample;
+    voice->frames = 0;
+    voice->failed = false;
+    try {
+        gig::buffer_t decompressionBuffer =
+            gig::Sample::CreateDecompressionBuffer(voice->blockFrames);
+        vector<uint8_t> buffer(voice->blockFrames * s->FrameSize);
+        gig::playback_state_t state;
+        state.position         = 0;
+        state.reverse          = false;
+        state.loop_cycles_left = s->LoopPlayCount;
+        // a looped sample would stream forever, so stop after its length
+        while (voice->frames < s->SamplesTotal) {
+            const double t0 = Now();
+            const RIFF::file_offset_t n =
+                s->ReadAndLoop(&buffer[0], voice->blockFrames, &state,
+                               voice->pDimRgn, &decompressionBuffer);
+            voice->latencies.push_back(Now() - t0);
+            if (!n) break;
+            voice->frames += n;
+        }
+        gig::Sample::DestroyDecompressionBuffer(decompressionBuffer);
+    } catch (...) {
+        voice->failed = true;
+    }
+}
+
+// returns the p-th percentile (0 <= p <= 1) of the sorted values
+static double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = size_t(p * (sorted.size() - 1) + 0.5);
+    return sorted[min(i, sorted.size() - 1)];
+}
+
+static void benchGigVoices(gig::File* gig, const bench_options_t& opt, vector<bench_result_t>& results) {
+    // pick one dimension region for each sample (first one referencing it)
+    vector<voice_t> voices;
+    for (gig::Instrument* instr = gig->GetFirstInstrument(); instr; instr = gig->GetNextInstrument()) {
+        for (gig::Region* rgn = instr->GetFirstRegion(); rgn; rgn = instr->GetNextRegion()) {
+            for (uint i = 0; i < rgn->DimensionRegions; ++i) {
+                gig::DimensionRegion* d = rgn->pDimensionRegions[i];
+                if (!d || !d->pSample || !d->pSample->FrameSize) continue;
+                bool used = false;
+                for (size_t v = 0; v < voices.size() && !used; ++v)
+                    used = voices[v].pSample == d->pSample;
+                if (used) continue;
+                voice_t voice;
+                voice.pSample     = d->pSample;
+                voice.pDimRgn     = d;
+                voice.blockFrames = opt.streamFrames;
+                voice.frames      = 0;
+                voices.push_back(voice);
+            }
+        }
+    }
+    // the same sample must not be streamed by two threads (its read position is shared)
+    if (voices.size() > size_t(opt.voices)) voices.resize(opt.voices);
+    if (voices.size() < size_t(opt.voices))
+        cout << "Note: only " << voices.size() << " distinct sample(s) referenced, "
+             << "thus only " << voices.size() << " voice(s)." << endl;
+    if (voices.empty()) return;
+
+    vector<thread_t> threads(voices.size());
+    vector<bool> started(voices.size());
+    const double t0 = Now();
+    for (size_t v = 0; v < voices.size(); ++v)
+        started[v] = __create_thread(threads[v], streamVoice, &voices[v]);
+    for (size_t v = 0; v < voices.size(); ++v) {
+        if (started[v]) __join_thread(threads[v]);
+        else streamVoice(&voices[v]); // no thread support: stream sequentially
+    }
+
+    double bytes = 0, frames = 0;
+    vector<double> latencies;
+    for (size_t v = 0; v < voices.size(); ++v) {
+        if (voices[v].failed)
+            throw RIFF::Exception("Streaming sample '" + voices[v].pSample->pInfo->Name + "' failed");
+        frames += voices[v].frames;
+        bytes  += voices[v].frames * voices[v].pSample->FrameSize;
+        latencies.insert(latencies.end(), voices[v].latencies.begin(), voices[v].latencies.end());
+    }
+    ostringstream name;
+    name << "stream " << voices.size() << " voices";
+    bench_result_t r = makeResult(name.str(), t0, long(voices.size()), bytes, frames);
+    sort(latencies.begin(), latencies.end());
+    ostringstream details;
+    details << fixed << setprecision(1) << "read latency (us): p50 " << percentile(latencies, 0.5) * 1e6
+            << ", p90 " << percentile(latencies, 0.9) * 1e6
+            << ", p99 " << percentile(latencies, 0.99) * 1e6
+            << ", max " << (latencies.empty() ? 0 : latencies.back()) * 1e6
+            << " (" << latencies.size() << " reads)";
+    r.details = details.str();
+    results.push_back(r);
+}
+
+/*
+ * Serialization stages: all dimension regions of the file (and separately
+ * their eg_opt_t, leverage_ctrl_t and crossfade_t members) are serialized
+ * and deserialized again by Serialization::Archive, once for each encoding,
+ * plus delta serialization of the unchanged dimension regions. Besides the
+ * throughput, the archive sizes and the amount of heap allocations are
+ * reported.
+ */
+
+// amount of heap allocations by operator new of the whole process (on
+// Windows only those of gigbench itself, not of the libgig DLL)
+static volatile long allocationCount = 0;
+
+#if __cplusplus >= 201103L
+# define NEW_THROWS
+# define DELETE_NOTHROW noexcept
+#else
+# define NEW_THROWS     throw(std::bad_alloc)
+# define DELETE_NOTHROW throw()
+#endif
+
+// all replaceable (non aligned) variants are replaced as matching pairs,
+// so no allocation is freed by the default implementation
+static void* countedAlloc(size_t size) {
+    __atomicIncrement(allocationCount);
+    return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size) NEW_THROWS {
+    void* p = countedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) NEW_THROWS {
+    void* p = countedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) DELETE_NOTHROW {
+    return countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) DELETE_NOTHROW {
+    return countedAlloc(size);
+}
+
+void operator delete(void* p) DELETE_NOTHROW {
+    free(p);
+}
+
+void operator delete[](void* p) DELETE_NOTHROW {
+    free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) DELETE_NOTHROW {
+    free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) DELETE_NOTHROW {
+    free(p);
+}
+
+// (the sized variants are replaced unconditionally, since libgig may be
+// compiled with sized deallocation even if this file is not)
+void operator delete(void* p, size_t) DELETE_NOTHROW {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) DELETE_NOTHROW {
+    free(p);
+}
+
+static string encodingName(Serialization::encoding_t encoding) {
+    return (encoding == Serialization::ENCODING_BINARY) ? "binary" : "text";
+}
+
+static string serializationDetails(double bytes, long allocations, size_t objects) {
+    ostringstream details;
+    details << fixed << setprecision(1);
+    if (bytes > 0)
+        details << "archive size: " << bytes << " bytes (" << (objects ? bytes / objects : 0) << " per object), ";
+    details << "allocations: " << allocations << " (" << (objects ? double(allocations) / objects : 0) << " per object)";
+    return details.str();
+}
+
+template<class T>
+static void benchSerialize(const string& name, const vector<T*>& objects,
+                           Serialization::encoding_t encoding, vector<bench_result_t>& results)
+{
+    if (objects.empty()) return;
+    vector<Serialization::Archive*> archives(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        archives[i] = new Serialization::Archive;
+        archives[i]->setEncoding(encoding);
+    }
+    const string suffix = " (" + encodingName(encoding) + ")";
+
+    long allocations = allocationCount;
+    double t0 = Now();
+    double bytes = 0;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        archives[i]->serialize(objects[i]);
+        bytes += archives[i]->rawData().size();
+    }
+    bench_result_t r = makeResult("serialize " + name + suffix, t0, long(objects.size()), bytes);
+    r.details = serializationDetails(bytes, allocationCount - allocations, objects.size());
+    results.push_back(r);
+
+    // (the decoding archives decode copies of the encoded data)
+    vector<Serialization::RawData> data(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i)
+        data[i] = archives[i]->rawData();
+    for (size_t i = 0; i < objects.size(); ++i)
+        archives[i]->clear();
+
+    allocations = allocationCount;
+    t0 = Now();
+    for (size_t i = 0; i < objects.size(); ++i) {
+        archives[i]->decode(data[i]);
+        archives[i]->deserialize(objects[i]);
+    }
+    r = makeResult("deserialize " + name + suffix, t0, long(objects.size()), bytes);
+    r.details = serializationDetails(0, allocationCount - allocations, objects.size());
+    results.push_back(r);
+
+    for (size_t i = 0; i < objects.size(); ++i)
+        delete archives[i];
+}
+
+template<class T>
+static void benchSerializeDelta(const string& name, const vector<T*>& objects,
+                                Serialization::encoding_t encoding, vector<bench_result_t>& results)
+{
+    if (objects.empty()) return;
+    vector<Serialization::Archive*> previous(objects.size()), deltas(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        previous[i] = new Serialization::Archive;
+        previous[i]->setEncoding(encoding);
+        previous[i]->serialize(objects[i]);
+        deltas[i] = new Serialization::Archive;
+        deltas[i]->setEncoding(encoding);
+    }
+
+    const long allocations = allocationCount;
+    const double t0 = Now();
+    double bytes = 0;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        deltas[i]->serializeDelta(objects[i], *previous[i]);
+        bytes += deltas[i]->rawData().size();
+    }
+    bench_result_t r = makeResult("serialize delta " + name + " (" + encodingName(encoding) + ")",
+                                  t0, long(objects.size()), bytes);
+    r.details = serializationDetails(bytes, allocationCount - allocations, objects.size());
+    results.push_back(r);
+
+    for (size_t i = 0; i < objects.size(); ++i) {
+        delete previous[i];
+        delete deltas[i];
+    }
+}
+
+static void benchGigSerialization(gig::File* gig, vector<bench_result_t>& results) {
+    vector<gig::DimensionRegion*> dimRgns;
+    vector<gig::eg_opt_t*> egOpts;
+    vector<gig::leverage_ctrl_t*> leverageCtrls;
+    vector<gig::crossfade_t*> crossfades;
+    for (gig::Instrument* instr = gig->GetFirstInstrument(); instr; instr = gig->GetNextInstrument()) {
+        for (gig::Region* rgn = instr->GetFirstRegion(); rgn; rgn = instr->GetNextRegion()) {
+            for (uint i = 0; i < rgn->DimensionRegions; ++i) {
+                gig::DimensionRegion* d = rgn->pDimensionRegions[i];
+                if (!d) continue;
+                dimRgns.push_back(d);
+                egOpts.push_back(&d->EG1Options);
+                egOpts.push_back(&d->EG2Options);
+                leverageCtrls.push_back(&d->EG1Controller);
+                leverageCtrls.push_back(&d->EG2Controller);
+                leverageCtrls.push_back(&d->AttenuationController);
+                crossfades.push_back(&d->Crossfade);
+            }
+        }
+    }
+    const Serialization::encoding_t encodings[] = {
+        Serialization::ENCODING_TEXT, Serialization::ENCODING_BINARY
+    };
+    for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); ++e) {
+        benchSerialize("dimension regions", dimRgns, encodings[e], results);
+        benchSerializeDelta("dimension regions", dimRgns, encodings[e], results);
+        benchSerialize("eg_opt_t", egOpts, encodings[e], results);
+        benchSerialize("leverage_ctrl_t", leverageCtrls, encodings[e], results);
+        benchSerialize("crossfade_t", crossfades, encodings[e], results);
+    }
+}
+
+void RunBenchmark(const char* filename, const bench_options_t& opt, vector<bench_result_t>& results) {
+    double t0 = Now();
+    RIFF::File* riff = new RIFF::File(filename);
+    results.push_back(makeResult("open RIFF tree", t0, 1));
+
+    try {
+        const format_t format = DetectFormat(riff);
+        cout << "File format: " << FormatName(format) << endl;
+        t0 = Now();
+        switch (format) {
+            case FORMAT_GIG: {
+                gig::File* gig = new gig::File(riff);
+                results.push_back(makeResult("open file", t0, 1));
+                benchGig(gig, opt, results);
+                if (opt.voices) benchGigVoices(gig, opt, results);
+                if (opt.serialization) benchGigSerialization(gig, results);
+                delete gig;
+                break;
+            }
+            case FORMAT_DLS: {
+                DLS::File* dls = new DLS::File(riff);
+                results.push_back(makeResult("open file", t0, 1));
+                benchDLS(dls, opt, results);
+                delete dls;
+                break;
+            }
+            case FORMAT_SF2: {
+                sf2::File* sf = new sf2::File(riff);
+                results.push_back(makeResult("open file", t0, 1));
+                benchSF2(sf, opt, results);
+                delete sf;
+                break;
+            }
+        }
+    } catch (...) {
+        delete riff;
+        throw;
+    }
+    delete riff;
+}
+
+void PrintResults(const vector<bench_result_t>& results) {
+    cout << left << setw(28) << "Stage" << right
+         << setw(12) << "Time (ms)" << setw(10) << "Items"
+         << setw(12) << "MB/s" << setw(16) << "Frames/s" << endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const bench_result_t& r = results[i];
+        cout << left << setw(28) << r.name << right << fixed
+             << setw(12) << setprecision(3) << (r.seconds * 1000.0)
+             << setw(10) << r.items;
+        if (r.bytes > 0 && r.seconds > 0)
+            cout << setw(12) << setprecision(1) << (r.bytes / (1024.0 * 1024.0) / r.seconds);
+        else
+            cout << setw(12) << "-";
+        if (r.frames > 0 && r.seconds > 0)
+            cout << setw(16) << setprecision(0) << (r.frames / r.seconds);
+        else
+            cout << setw(16) << "-";
+        cout << endl;
+        if (!r.details.empty()) cout << "  " << r.details << endl;
+    }
+}
+
+string Revision() {
+    string s = "$Revision$";
+    return s.substr(11, s.size() - 13); // cut dollar signs, spaces and CVS macro keyword
+}
+
+void PrintVersion() {
+    cout << "gigbench revision " << Revision() << endl;
+    cout << "using " << gig::libraryName() << " " << gig::libraryVersion() << endl;
+}
+
+void PrintUsage() {
+    cout << "gigbench - measures how fast libgig opens, scans and streams a file." << endl;
+    cout << endl;
+    cout << "Usage: gigbench [-v] [--preload FRAMES] [--buffer FRAMES] [--repeat N]" << endl;
+    cout << "                [--voices N] [--serialization] FILE" << endl;
+    cout << endl;
+    cout << "   -v                 Print version and exit." << endl;
+    cout << endl;
+    cout << "   --preload FRAMES   Amount of sample points to preload of each sample" << endl;
+    cout << "                      (default: " << DEFAULT_PRELOAD_FRAMES << ")." << endl;
+    cout << endl;
+    cout << "   --buffer FRAMES    Amount of sample points to read per Read() call when" << endl;
+    cout << "                      streaming (default: " << DEFAULT_STREAM_FRAMES << ")." << endl;
+    cout << endl;
+    cout << "   --repeat N         Run the entire benchmark N times (default: 1)." << endl;
+    cout << endl;
+    cout << "   --voices N         Additionally stream N different samples concurrently by" << endl;
+    cout << "                      N threads with their loops (gig files only) and report" << endl;
+    cout << "                      aggregate throughput and read latency percentiles." << endl;
+    cout << endl;
+    cout << "   --serialization    Additionally serialize and deserialize all dimension" << endl;
+    cout << "                      regions (and their envelope options, controllers and" << endl;
+    cout << "                      crossfades) with text and binary encoding (gig files" << endl;
+    cout << "                      only) and report archive sizes and heap allocations." << endl;
+    cout << endl;
+    cout << "FILE may be a Gigasampler (.gig), DLS (.dls) or SoundFont 2 (.sf2) file." << endl;
+    cout << endl;
+}
@@ -0,0 +1,141 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This program is part of libgig.                                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../gig.h"
+
+using namespace std;
+
+string Revision();
+void PrintVersion();
+void PrintUsage();
+
+static void progressCallback(RIFF::progress_t* pProgress) {
+    static int lastPercent = -1;
+    const int percent = int(pProgress->factor * 100.f);
+    if (percent == lastPercent) return;
+    lastPercent = percent;
+    cout << "\rSaving ... " << percent << "%" << flush;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc <= 1) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    int iArg;
+    for (iArg = 1; iArg < argc; ++iArg) {
+        const string o = argv[iArg];
+        if (o == "--") { // common for all command line tools: separator between initial option arguments and i.e. subsequent file arguments
+            iArg++;
+            break;
+        }
+        if (o.substr(0, 1) != "-") break;
+
+        if (o == "-v") {
+            PrintVersion();
+            return EXIT_SUCCESS;
+        } else {
+            cerr << "Unknown option '" << o << "'" << endl;
+            cerr << endl;
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (iArg >= argc) {
+        cout << "No input file provided!" << endl;
+        return EXIT_FAILURE;
+    }
+    if (argc - iArg > 2) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+    const string inPath  = argv[iArg];
+    const string outPath = (iArg + 1 < argc) ? argv[iArg + 1] : "";
+
+    try {
+        RIFF::File riff(inPath);
+        gig::File gig(&riff);
+
+        // remember the current order, just for reporting
+        vector<gig::Sample*> samples;
+        for (gig::Sample* s = gig.GetFirstSample(); s; s = gig.GetNextSample())
+            samples.push_back(s);
+
+        gig.SetWavePoolOrder(gig::wave_pool_order_by_instruments);
+        RIFF::progress_t progress;
+        progress.callback = progressCallback;
+        if (outPath.empty())
+            gig.Save(&progress);
+        else
+            gig.Save(outPath, &progress);
+
+        size_t moved = 0;
+        for (size_t i = 0; i < samples.size(); ++i)
+            if (gig.GetSample(uint(i)) != samples[i]) ++moved;
+        cout << "\r" << samples.size() << " sample(s), " << moved << " reordered." << endl;
+    } catch (RIFF::Exception& e) {
+        cout << endl;
+        e.PrintMessage();
+        return EXIT_FAILURE;
+    } catch (...) {
+        cout << endl << "Unknown exception while trying to reorder samples." << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+string Revision() {
+    string s = "$Revision$";
+    return s.substr(11, s.size() - 13); // cut dollar signs, spaces and CVS macro keyword
+}
+
+void PrintVersion() {
+    cout << "gigdefrag revision " << Revision() << endl;
+    cout << "using " << gig::libraryName() << " " << gig::libraryVersion() << endl;
+}
+
+void PrintUsage() {
+    cout << "gigdefrag - stores the samples of a .gig file grouped by the instruments using them." << endl;
+    cout << endl;
+    cout << "Usage: gigdefrag [-v] FILE [NEWFILE]" << endl;
+    cout << endl;
+    cout << "	FILE     .gig file to be reorganized (in place, if no NEWFILE is given)." << endl;
+    cout << endl;
+    cout << "	NEWFILE  Write the reorganized file to NEWFILE instead." << endl;
+    cout << endl;
+    cout << "	-v       Print version and exit." << endl;
+    cout << endl;
+}
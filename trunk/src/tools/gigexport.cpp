@@ -0,0 +1,154 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This program is part of libgig.                                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../gig.h"
+
+using namespace std;
+
+string Revision();
+void PrintVersion();
+void PrintUsage();
+bool ParseIndexRange(const string& s, long& first, long& last);
+
+static void progressCallback(RIFF::progress_t* pProgress) {
+    static int lastPercent = -1;
+    const int percent = int(pProgress->factor * 100.f);
+    if (percent == lastPercent) return;
+    lastPercent = percent;
+    cout << "\rExporting ... " << percent << "%" << flush;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc <= 1) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    int iArg;
+    for (iArg = 1; iArg < argc; ++iArg) {
+        const string o = argv[iArg];
+        if (o == "--") { // common for all command line tools: separator between initial option arguments and i.e. subsequent file arguments
+            iArg++;
+            break;
+        }
+        if (o.substr(0, 1) != "-") break;
+
+        if (o == "-v") {
+            PrintVersion();
+            return EXIT_SUCCESS;
+        } else {
+            cerr << "Unknown option '" << o << "'" << endl;
+            cerr << endl;
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - iArg < 3) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+    const string inPath  = argv[iArg++];
+    const string outPath = argv[iArg++];
+    vector<uint> instruments;
+    for (; iArg < argc; ++iArg) {
+        long first, last;
+        if (!ParseIndexRange(argv[iArg], first, last)) {
+            cerr << "Invalid instrument index '" << argv[iArg] << "'" << endl;
+            return EXIT_FAILURE;
+        }
+        for (long i = first; i <= last; ++i)
+            instruments.push_back(uint(i));
+    }
+
+    try {
+        RIFF::File riff(inPath);
+        gig::File gig(&riff);
+        RIFF::progress_t progress;
+        progress.callback = progressCallback;
+        gig.ExportInstruments(instruments, outPath, &progress);
+
+        RIFF::File riffOut(outPath);
+        gig::File gigOut(&riffOut);
+        cout << "\r" << gigOut.CountInstruments() << " instrument(s) and "
+             << gigOut.CountSamples() << " sample(s) exported." << endl;
+    } catch (RIFF::Exception& e) {
+        cout << endl;
+        e.PrintMessage();
+        return EXIT_FAILURE;
+    } catch (...) {
+        cout << endl << "Unknown exception while trying to export instruments." << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// parses "N" or "FIRST-LAST"
+bool ParseIndexRange(const string& s, long& first, long& last) {
+    if (s.empty() || s[0] == '-') return false;
+    char* end = NULL;
+    first = last = strtol(s.c_str(), &end, 10);
+    if (end && *end == '-') {
+        const char* p = end + 1;
+        if (!*p) return false;
+        last = strtol(p, &end, 10);
+    }
+    return end && *end == '\0' && first >= 0 && first <= last;
+}
+
+string Revision() {
+    string s = "$Revision$";
+    return s.substr(11, s.size() - 13); // cut dollar signs, spaces and CVS macro keyword
+}
+
+void PrintVersion() {
+    cout << "gigexport revision " << Revision() << endl;
+    cout << "using " << gig::libraryName() << " " << gig::libraryVersion() << endl;
+}
+
+void PrintUsage() {
+    cout << "gigexport - exports selected instruments of a .gig file into a new .gig file." << endl;
+    cout << endl;
+    cout << "Usage: gigexport [-v] FILE NEWFILE INDEX [INDEX ...]" << endl;
+    cout << endl;
+    cout << "	FILE     .gig file containing the instruments." << endl;
+    cout << endl;
+    cout << "	NEWFILE  New .gig file to be written with the instruments and their samples." << endl;
+    cout << endl;
+    cout << "	INDEX    Index of an instrument to be exported (starting with 0), or a" << endl;
+    cout << "	         range of instruments like 3-7." << endl;
+    cout << endl;
+    cout << "	-v       Print version and exit." << endl;
+    cout << endl;
+}
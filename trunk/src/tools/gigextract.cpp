@@ -27,17 +27,9 @@
 #include <config.h>
 #endif
 
-// just for testing the disk streaming capability of libgig;
-// you will also need to set this to 1 at the moment if you want to
-// extract compressed samples, as I haven't implemented the
-// decompression algorithm in gig::Sample::LoadSampleData() yet
-#define USE_DISK_STREAMING	1
-
-// only when USE_DISK_STREAMING is set to 1:
-// just for testing the disk stream capability; with this option set
-// gigextract will read the samples in smaller pieces, just to stress
-// gig::Sample::Read() method a bit
-#define HASHED_READS_TEST	1
+// amount of sample points read (and written) at once by gigextract, so the
+// memory needed for extracting a sample does not depend on the sample's size
+#define STREAM_BUFFER_SAMPLES	65536
 
 #include <iostream>
 #include <cstdlib>
@@ -47,8 +39,10 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <vector>
 
 #include "../gig.h"
+#include "../helper.h"
 
 #ifdef _MSC_VER
 #define S_ISDIR(x) (S_IFDIR & (x))
@@ -86,8 +80,8 @@ OrderMap* pOrderedSamples = NULL;
 string Revision();
 void PrintVersion();
 void PrintUsage();
-void ExtractSamples(gig::File* gig, char* destdir, OrderMap* ordered);
-int writeWav(gig::Sample* sample, const char* filename, void* samples, long samplecount, int channels, int bitdepth, long rate);
+void ExtractSamples(gig::File* gig, char* destdir, OrderMap* ordered, int threads);
+const char* extractSample(gig::Sample* sample, const char* filename);
 string ToString(int i);
 
 #if !HAVE_SNDFILE // use libaudiofile
@@ -107,13 +101,18 @@ int(*_afCloseFile)(AFfilehandle file);
 #endif // !HAVE_SNDFILE
 
 int main(int argc, char *argv[]) {
-     if (argc >= 2) {
-        if (argv[1][0] == '-') {
-            switch (argv[1][1]) {
-                case 'v':
-                    PrintVersion();
-                    return EXIT_SUCCESS;
-            }
+    int threads = 1; // sequential extraction by default
+    while (argc >= 2 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-v")) {
+            PrintVersion();
+            return EXIT_SUCCESS;
+        } else if (!strcmp(argv[1], "-j") && argc > 2) {
+            threads = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+        } else {
+            PrintUsage();
+            return EXIT_FAILURE;
         }
     }
     if (argc < 3) {
@@ -159,7 +158,7 @@ int main(int argc, char *argv[]) {
         RIFF::File* riff = new RIFF::File(argv[1]);
         gig::File*  gig  = new gig::File(riff);
         cout << "Extracting samples from \"" << argv[1] << "\" to directory \"" << argv[2] << "\"." << endl << flush;
-        ExtractSamples(gig, argv[2], pOrderedSamples);
+        ExtractSamples(gig, argv[2], pOrderedSamples, threads);
         cout << "Extraction finished." << endl << flush;
         delete gig;
         delete riff;
@@ -197,27 +196,64 @@ static string replacePathSeparators(string s) {
     return s;
 }
 
-void ExtractSamples(gig::File* gig, char* destdir, OrderMap* ordered) {
+// one sample to be extracted by a worker thread
+struct SampleJob {
+    gig::Sample* pSample;
+    int          index;    // running number of the sample (for output)
+    string       name;
+    string       filename;
+};
+
+struct ParallelExtraction {
+    std::vector<SampleJob> jobs;
+    mutex_t mutex; // protects stdout and the sample readers' construction
+};
+
+static void extractSampleJob(void* arg, size_t index) {
+    ParallelExtraction* p = (ParallelExtraction*) arg;
+    const SampleJob& job = p->jobs[index];
+    gig::Sample* pSample = job.pSample;
+    const char* err = extractSample(pSample, job.filename.c_str());
+
+    mutex_lock_t lock(p->mutex);
+    if (pSample->Compressed) cout << "Decompressing ";
+    else                     cout << "Extracting ";
+    cout << "Sample " << job.index << ") " << job.name << " (" << pSample->BitDepth <<"Bits, " << pSample->SamplesPerSecond << "Hz, " << pSample->Channels << " Channels, " << pSample->SamplesTotal << " Samples";
+    if (pSample->Loops > 0) {
+        cout << ", LoopType "  << getLoopTypeText(pSample->LoopType)
+             << ", LoopStart " << pSample->LoopStart
+             << ", LoopEnd "   << pSample->LoopEnd;
+    }
+    cout << ")...";
+    if (err) cout << err << endl << flush;
+    else     cout << "ok" << endl << flush;
+}
+
+// protects the (not thread safe) lazy scanning of compressed samples
+// performed by the gig::SampleReader constructor
+static mutex_t readerMutex;
+
+/**
+ * Extracts the samples of @a gig with @a threads worker threads (0 = one
+ * per CPU core). Each sample is streamed from disk in pieces of
+ * STREAM_BUFFER_SAMPLES sample points by its own gig::SampleReader, which
+ * has its own decompression buffer and read position, so the samples can
+ * be read concurrently without locking.
+ */
+void ExtractSamples(gig::File* gig, char* destdir, OrderMap* ordered, int threads) {
 #if !HAVE_SNDFILE // use libaudiofile
     hAFlib = NULL;
     openAFlib();
 #endif // !HAVE_SNDFILE
-    uint8_t* pWave  = NULL;
-    int* pIntWave = NULL;
-    long BufferSize = 0;
-    int samples     = 0;
-    gig::buffer_t decompressionBuffer;
-    decompressionBuffer.Size = 0;
+    ParallelExtraction p;
+    int samples = 0;
     cout << "Seeking for available samples..." << flush;
     gig::Sample* pSample = gig->GetFirstSample();
     cout << "OK" << endl << flush;
-    while (pSample) {
+    for (; pSample; pSample = gig->GetNextSample()) {
         samples++;
         if (ordered) {
-            if ((*ordered)[samples] == false) {
-                pSample = gig->GetNextSample();
-                continue;
-            }
+            if ((*ordered)[samples] == false) continue;
         }
         string name = replacePathSeparators(pSample->pInfo->Name);
         string filename = destdir;
@@ -234,113 +270,35 @@ void ExtractSamples(gig::File* gig, char* destdir, OrderMap* ordered) {
             name += "\"";
         }
         filename += ".wav";
-        if (pSample->Compressed) cout << "Decompressing ";
-        else                     cout << "Extracting ";
-        cout << "Sample " << samples << ") " << name << " (" << pSample->BitDepth <<"Bits, " << pSample->SamplesPerSecond << "Hz, " << pSample->Channels << " Channels, " << pSample->SamplesTotal << " Samples";
-        if (pSample->Loops > 0) {
-            cout << ", LoopType "  << getLoopTypeText(pSample->LoopType)
-                 << ", LoopStart " << pSample->LoopStart
-                 << ", LoopEnd "   << pSample->LoopEnd;
-        }
-        cout << ")..." << flush;
-
-
-#if USE_DISK_STREAMING
-        long neededsize = pSample->BitDepth == 24 ?
-            pSample->SamplesTotal * pSample->Channels * sizeof(int) :
-            pSample->SamplesTotal * pSample->FrameSize;
-        if (BufferSize < neededsize) {
-            if (pWave) delete[] pWave;
-            pWave = new uint8_t[neededsize];
-            BufferSize = neededsize;
-        }
-        pIntWave = (int*)pWave;
-#  if HASHED_READS_TEST
-        unsigned long readinthisrun   = 0,
-                      samplepiecesize = 2000;
-        uint8_t* pSamplePiece = pWave;
-        do { // we read the sample in small pieces and increment the size with each run just to test streaming capability
-            readinthisrun = pSample->Read(pSamplePiece, ++samplepiecesize);
-            pSamplePiece += readinthisrun * pSample->FrameSize;
-        } while (readinthisrun == samplepiecesize);
-
-#  else // read in one piece
-        if (pSample->Compressed) {
-            if (decompressionBufferSize < pSample->SamplesTotal) {
-                gig::Sample::DestroyDecompressionBuffer(decompressionBuffer);
-                decompressionBuffer = gig::Sample::CreateDecompressionBuffer(pSample->SamplesTotal);
-                decompressionBufferSize = pSample->SamplesTotal;
-            }
-            pSample->Read(pWave, pSample->SamplesTotal, &decompressionBuffer);
-        } else {
-            pSample->Read(pWave, pSample->SamplesTotal);
-        }
-#  endif // HASHED_READS_TEST
-#else // no disk streaming
-        if (pSample->Compressed) {
-            cout << "Sorry, sample is compressed and Sample::LoadSampleData() only decompresses the beginning of the sample - Solution: set USE_DISK_STREAMING in gigextract.cpp (line 32) to 1 and recompile!" << endl;
-        } else {
-            gig::buffer_t buffer = pSample->LoadSampleData(); // load wave into RAM
-            pWave = static_cast<uint8_t*>(buffer.pStart);
-            if (pSample->BitDepth == 24) {
-                long neededsize = pSample->SamplesTotal * pSample->Channels;
-                if (BufferSize < neededsize) {
-                    if (pIntWave) delete[] pIntWave;
-                    pIntWave = new int[neededsize];
-                    BufferSize = neededsize;
-                }
-            }
-        }
-#endif // USE_DISK_STREAMING
-        if (pWave) {
-
-            // Both libsndfile and libaudiofile uses int for 24 bit
-            // samples. libgig however returns 3 bytes per sample, so
-            // we have to convert the wave data before writing.
-            if (pSample->BitDepth == 24) {
-                int n = pSample->SamplesTotal * pSample->Channels;
-                for (int i = n - 1 ; i >= 0 ; i--) {
-#if HAVE_SNDFILE
-                    pIntWave[i] = pWave[i * 3] << 8 | pWave[i * 3 + 1] << 16 | pWave[i * 3 + 2] << 24;
-#else
-                    pIntWave[i] = pWave[i * 3] | pWave[i * 3 + 1] << 8 | pWave[i * 3 + 2] << 16;
-#endif
-                }
-            }
-
-            int res = writeWav(pSample,
-                               filename.c_str(),
-                               pSample->BitDepth == 24 ? static_cast<void*>(pIntWave) : pWave,
-                               pSample->SamplesTotal,
-                               pSample->Channels,
-                               pSample->BitDepth,
-                               pSample->SamplesPerSecond);
-            if (res < 0) cout << "Couldn't write sample data." << endl;
-            else cout << "ok" << endl;
-            pSample->ReleaseSampleData(); // free wave from RAM
-        }
-        else cout << "Failed to load sample data." << endl;
-
-        pSample = gig->GetNextSample();
+        SampleJob job;
+        job.pSample  = pSample;
+        job.index    = samples;
+        job.name     = name;
+        job.filename = filename;
+        p.jobs.push_back(job);
     }
-    gig::Sample::DestroyDecompressionBuffer(decompressionBuffer);
-#if USE_DISK_STREAMING
-    if (pWave) delete[] pWave;
-#else
-    if (pIntWave) delete[] pIntWave;
-#endif
+    __parallel_for(p.jobs.size(), threads, extractSampleJob, &p);
 #if !HAVE_SNDFILE // use libaudiofile
     closeAFlib();
 #endif // !HAVE_SNDFILE
 }
 
-int writeWav(gig::Sample* sample, const char* filename, void* samples, long samplecount, int channels, int bitdepth, long rate) {
+// .wav output file currently being written by extractSample()
+struct WavFile {
+#if HAVE_SNDFILE
+    SNDFILE* hFile;
+#else
+    AFfilesetup  setup;
+    AFfilehandle hFile;
+#endif
+};
+
+static const char* openWav(WavFile& wav, gig::Sample* sample, const char* filename) {
 #if HAVE_SNDFILE
-    SNDFILE* hfile;
     SF_INFO  sfinfo;
     SF_INSTRUMENT instr;
     int format = SF_FORMAT_WAV;
-    switch (bitdepth) {
+    switch (sample->BitDepth) {
         case 8:
             format |= SF_FORMAT_PCM_S8;
             break;
@@ -354,19 +312,16 @@ int writeWav(gig::Sample* sample, const char* filename, void* samples, long samp
             format |= SF_FORMAT_PCM_32;
             break;
         default:
-            cerr << "Error: Bithdepth " << ToString(bitdepth) << " not supported by libsndfile, ignoring sample!\n" << flush;
-            return -1;
+            return "Bit depth not supported by libsndfile, ignoring sample!";
     }
     memset(&sfinfo, 0, sizeof (sfinfo));
     memset(&instr, 0, sizeof (instr));
-    sfinfo.samplerate = rate;
-    sfinfo.frames     = samplecount;
-    sfinfo.channels   = channels;
+    sfinfo.samplerate = sample->SamplesPerSecond;
+    sfinfo.frames     = sample->SamplesTotal;
+    sfinfo.channels   = sample->Channels;
     sfinfo.format     = format;
-    if (!(hfile = sf_open(filename, SFM_WRITE, &sfinfo))) {
-        cerr << "Error: Unable to open output file \'" << filename << "\'.\n" << flush;
-        return -1;
-    }
+    if (!(wav.hFile = sf_open(filename, SFM_WRITE, &sfinfo)))
+        return "Unable to open output file.";
     instr.basenote = sample->MIDIUnityNote;
     instr.detune = sample->FineTune;
     if (sample->Loops > 0) {
@@ -389,31 +344,94 @@ int writeWav(gig::Sample* sample, const char* filename, void* samples, long samp
         instr.loops[0].end   = sample->LoopEnd;
         instr.loops[0].count = sample->LoopPlayCount;
     }
-    sf_command(hfile, SFC_SET_INSTRUMENT, &instr, sizeof(instr));
-    sf_count_t res = bitdepth == 24 ?
-        sf_write_int(hfile, static_cast<int*>(samples), channels * samplecount) :
-        sf_write_short(hfile, static_cast<short*>(samples), channels * samplecount);
-    if (res != channels * samplecount) {
-        cerr << sf_strerror(hfile) << endl << flush;
-        sf_close(hfile);
-        return -1;
+    sf_command(wav.hFile, SFC_SET_INSTRUMENT, &instr, sizeof(instr));
+#else // use libaudiofile
+    wav.setup = _afNewFileSetup();
+    if (wav.setup == AF_NULL_FILESETUP) return "Couldn't write sample data.";
+    _afInitFileFormat(wav.setup, AF_FILE_WAVE);
+    _afInitChannels(wav.setup, AF_DEFAULT_TRACK, sample->Channels);
+    _afInitSampleFormat(wav.setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, sample->BitDepth);
+    _afInitRate(wav.setup, AF_DEFAULT_TRACK, sample->SamplesPerSecond);
+    wav.hFile = _afOpenFile(filename, "w", wav.setup);
+    if (wav.hFile == AF_NULL_FILEHANDLE) {
+        _afFreeFileSetup(wav.setup);
+        return "Unable to open output file.";
     }
-    sf_close(hfile);
+#endif // HAVE_SNDFILE
+    return NULL; // success
+}
+
+static bool writeWavFrames(WavFile& wav, void* samples, long frames, int channels, int bitdepth) {
+#if HAVE_SNDFILE
+    sf_count_t res = bitdepth == 24 ?
+        sf_write_int(wav.hFile, static_cast<int*>(samples), channels * frames) :
+        sf_write_short(wav.hFile, static_cast<short*>(samples), channels * frames);
+    return res == channels * frames;
 #else // use libaudiofile
-    AFfilesetup setup = _afNewFileSetup();
-    _afInitFileFormat(setup, AF_FILE_WAVE);
-    _afInitChannels(setup, AF_DEFAULT_TRACK, channels);
-    _afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, bitdepth);
-    _afInitRate(setup, AF_DEFAULT_TRACK, rate);
-    if (setup == AF_NULL_FILESETUP) return -1;
-    AFfilehandle hFile = _afOpenFile(filename, "w", setup);
-    if (hFile == AF_NULL_FILEHANDLE) return -1;
-    if (_afWriteFrames(hFile, AF_DEFAULT_TRACK, samples, samplecount) < 0) return -1;
-    _afCloseFile(hFile);
-    _afFreeFileSetup(setup);
+    return _afWriteFrames(wav.hFile, AF_DEFAULT_TRACK, samples, frames) == frames;
 #endif // HAVE_SNDFILE
+}
 
-    return 0; // success
+static void closeWav(WavFile& wav) {
+#if HAVE_SNDFILE
+    sf_close(wav.hFile);
+#else // use libaudiofile
+    _afCloseFile(wav.hFile);
+    _afFreeFileSetup(wav.setup);
+#endif // HAVE_SNDFILE
+}
+
+/**
+ * Streams the wave data of @a sample to the .wav file @a filename. Returns
+ * NULL on success or an error message otherwise. May be called by several
+ * threads at the same time for different samples.
+ */
+const char* extractSample(gig::Sample* sample, const char* filename) {
+    WavFile wav;
+    const char* err = openWav(wav, sample, filename);
+    if (err) return err;
+
+    gig::SampleReader* pReader;
+    {
+        mutex_lock_t lock(readerMutex);
+        pReader = new gig::SampleReader(sample, STREAM_BUFFER_SAMPLES);
+    }
+    const int channels = sample->Channels;
+    std::vector<uint8_t> wave(STREAM_BUFFER_SAMPLES * sample->FrameSize);
+    std::vector<int> intWave((sample->BitDepth == 24) ? STREAM_BUFFER_SAMPLES * channels : 0);
+    gig::file_offset_t total = 0;
+    while (total < sample->SamplesTotal) {
+        gig::file_offset_t n = pReader->Read(&wave[0], STREAM_BUFFER_SAMPLES);
+        if (!n) break;
+
+        // Both libsndfile and libaudiofile uses int for 24 bit
+        // samples. libgig however returns 3 bytes per sample, so
+        // we have to convert the wave data before writing.
+        if (sample->BitDepth == 24) {
+            const uint8_t* pWave = &wave[0];
+            for (long i = 0; i < long(n) * channels; i++) {
+#if HAVE_SNDFILE
+                intWave[i] = pWave[i * 3] << 8 | pWave[i * 3 + 1] << 16 | pWave[i * 3 + 2] << 24;
+#else
+                intWave[i] = pWave[i * 3] | pWave[i * 3 + 1] << 8 | pWave[i * 3 + 2] << 16;
+#endif
+            }
+        }
+
+        if (!writeWavFrames(wav,
+                            sample->BitDepth == 24 ? static_cast<void*>(&intWave[0]) : &wave[0],
+                            long(n), channels, sample->BitDepth))
+        {
+            err = "Couldn't write sample data.";
+            break;
+        }
+        total += n;
+    }
+    if (!err && total < sample->SamplesTotal)
+        err = "Failed to read sample data.";
+    delete pReader;
+    closeWav(wav);
+    return err;
 }
 
 #if !HAVE_SNDFILE // use libaudiofile
@@ -465,7 +483,7 @@ void PrintVersion() {
 void PrintUsage() {
     cout << "gigextract - extracts samples from a Gigasampler file." << endl;
     cout << endl;
-    cout << "Usage: gigextract [-v] GIGFILE DESTDIR [SAMPLENR] [ [SAMPLENR] ...]" << endl;
+    cout << "Usage: gigextract [-v] [-j THREADS] GIGFILE DESTDIR [SAMPLENR] [ [SAMPLENR] ...]" << endl;
     cout << endl;
     cout << "	GIGFILE  Input Gigasampler (.gig) file." << endl;
     cout << endl;
@@ -477,6 +495,9 @@ void PrintUsage() {
     cout << endl;
     cout << "	-v       Print version and exit." << endl;
     cout << endl;
+    cout << "	-j       Extract THREADS samples in parallel (0 = one per CPU core," << endl;
+    cout << "	         default: 1)." << endl;
+    cout << endl;
 }
 
 string ToString(int i) {
@@ -0,0 +1,351 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This program is part of libgig.                                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "../gig.h"
+#include "../helper.h"
+
+using namespace std;
+
+struct gen_options_t {
+    int  samples;       ///< Amount of samples, 0: one sample for each dimension region.
+    long frames;        ///< Length of each sample (in sample points).
+    int  bitDepth;
+    int  channels;
+    int  sampleRate;
+    bool loop;
+    int  instruments;
+    int  regions;       ///< Regions per instrument (evenly spread over the keyboard).
+    int  velocityZones; ///< 0: no velocity dimension.
+    int  roundRobinZones;
+    int  keyswitchZones;
+};
+
+// state of the wave form generator, while the file is written sequentially
+struct gen_state_t {
+    const gen_options_t* opt;
+    gig::Sample*         pSample; ///< Sample currently being written.
+    gig::file_offset_t   pos;     ///< Next sample point of @c pSample to be written.
+    double               phaseInc;
+    int                  index;   ///< Index of @c pSample.
+};
+
+string Revision();
+void PrintVersion();
+void PrintUsage();
+bool ParseLong(const string& s, long& result);
+
+static int bitsForZones(int zones) {
+    int bits = 0;
+    while ((1 << bits) < zones) ++bits;
+    return bits;
+}
+
+static void addDimension(gig::Region* rgn, gig::dimension_t type, int zones) {
+    if (zones < 2) return;
+    gig::dimension_def_t dim;
+    dim.dimension = type;
+    dim.bits      = bitsForZones(zones);
+    dim.zones     = zones;
+    rgn->AddDimension(&dim);
+}
+
+/*
+ * Called by gig::File::SaveSequential() for each sample (one after another),
+ * generates a sine wave with a different frequency for each sample. So the
+ * wave data never has to be in RAM, the size of the generated file is only
+ * limited by disk space.
+ */
+static gig::file_offset_t sineSampleSource(gig::Sample* pSample, void* pBuffer, gig::file_offset_t FrameCount, void* pUserData) {
+    gen_state_t* state = (gen_state_t*) pUserData;
+    if (state->pSample != pSample) {
+        state->pSample  = pSample;
+        state->pos      = 0;
+        state->index++;
+        // spread the frequencies over roughly 3 octaves from 110 Hz upwards
+        const double freq = 110.0 * pow(2.0, (state->index % 37) / 12.0);
+        state->phaseInc = 2.0 * M_PI * freq / state->opt->sampleRate;
+    }
+    const gig::file_offset_t total = state->opt->frames;
+    if (FrameCount > total - state->pos) FrameCount = total - state->pos;
+    const int channels = state->opt->channels;
+    const double amplitude = (state->opt->bitDepth == 24) ? 4194304.0 : 16384.0;
+    for (gig::file_offset_t i = 0; i < FrameCount; ++i) {
+        const double phase = double(state->pos + i) * state->phaseInc;
+        for (int c = 0; c < channels; ++c) {
+            const int y = int(amplitude * sin(phase + c * M_PI / 2));
+            if (state->opt->bitDepth == 24) {
+                uint8_t* p = (uint8_t*) pBuffer + (i * channels + c) * 3;
+                p[0] = y;
+                p[1] = y >> 8;
+                p[2] = y >> 16;
+            } else {
+                ((int16_t*) pBuffer)[i * channels + c] = y;
+            }
+        }
+    }
+    state->pos += FrameCount;
+    return FrameCount;
+}
+
+static void printProgress(gig::progress_t* pProgress) {
+    int* lastPercent = (int*) pProgress->custom;
+    const int percent = int(pProgress->factor * 100);
+    if (percent == *lastPercent) return;
+    *lastPercent = percent;
+    cout << "\rWriting file ... " << percent << "%" << flush;
+}
+
+static void generate(const string& filename, const gen_options_t& opt) {
+    gig::File gig;
+    gig.pInfo->Name = "libgig synthetic test file";
+    gig.pInfo->Software = "giggen";
+
+    const int dimRgnsPerRegion =
+        (1 << bitsForZones(opt.velocityZones)) * (1 << bitsForZones(opt.roundRobinZones)) *
+        (1 << bitsForZones(opt.keyswitchZones));
+    const int samples = (opt.samples) ? opt.samples : opt.instruments * opt.regions * dimRgnsPerRegion;
+
+    cout << "Creating " << samples << " samples ..." << endl;
+    vector<gig::Sample*> pSamples;
+    for (int i = 0; i < samples; ++i) {
+        gig::Sample* pSample = gig.AddSample();
+        pSample->pInfo->Name      = "Sample " + ToString(i + 1);
+        pSample->Channels         = opt.channels;
+        pSample->BitDepth         = opt.bitDepth;
+        pSample->FrameSize        = opt.channels * opt.bitDepth / 8;
+        pSample->SamplesPerSecond = opt.sampleRate;
+        if (opt.loop) {
+            pSample->Loops         = 1;
+            pSample->LoopType      = gig::loop_type_normal;
+            pSample->LoopStart     = opt.frames / 2;
+            pSample->LoopEnd       = opt.frames - 1;
+            pSample->LoopSize      = pSample->LoopEnd - pSample->LoopStart;
+            pSample->LoopPlayCount = 0; // infinite
+        }
+        // schedule for resize (performed when the file is saved)
+        pSample->Resize(opt.frames);
+        pSamples.push_back(pSample);
+    }
+
+    cout << "Creating " << opt.instruments << " instruments with " << opt.regions
+         << " regions of " << dimRgnsPerRegion << " dimension regions each ..." << endl;
+    int iSample = 0;
+    for (int i = 0; i < opt.instruments; ++i) {
+        gig::Instrument* pInstrument = gig.AddInstrument();
+        pInstrument->pInfo->Name = "Instrument " + ToString(i + 1);
+        for (int r = 0; r < opt.regions; ++r) {
+            gig::Region* pRegion = pInstrument->AddRegion();
+            const int low  = 128 * r / opt.regions;
+            const int high = 128 * (r + 1) / opt.regions - 1;
+            pRegion->SetKeyRange(low, high);
+            addDimension(pRegion, gig::dimension_velocity, opt.velocityZones);
+            addDimension(pRegion, gig::dimension_roundrobin, opt.roundRobinZones);
+            addDimension(pRegion, gig::dimension_keyboard, opt.keyswitchZones);
+            for (uint d = 0; d < pRegion->DimensionRegions; ++d) {
+                gig::DimensionRegion* pDimRgn = pRegion->pDimensionRegions[d];
+                gig::Sample* pSample = pSamples[iSample++ % samples];
+                pSample->MIDIUnityNote = (low + high) / 2;
+                pDimRgn->pSample = pSample;
+                pDimRgn->UnityNote = (low + high) / 2;
+            }
+            pRegion->SetSample(pRegion->pDimensionRegions[0]->pSample);
+        }
+    }
+
+    const double bytes = double(samples) * opt.frames * opt.channels * opt.bitDepth / 8;
+    cout << "Wave data: " << (bytes / (1024.0 * 1024.0)) << " MB";
+    if (bytes >= 4294967296.0) cout << " (file will use 64 bit offsets)";
+    cout << endl;
+
+    gen_state_t state;
+    state.opt      = &opt;
+    state.pSample  = NULL;
+    state.pos      = 0;
+    state.phaseInc = 0;
+    state.index    = -1;
+    int lastPercent = -1;
+    gig::progress_t progress;
+    progress.callback = printProgress;
+    progress.custom   = &lastPercent;
+    gig.SaveSequential(filename, sineSampleSource, &state, &progress);
+    cout << endl;
+}
+
+int main(int argc, char *argv[]) {
+    gen_options_t opt;
+    opt.samples         = 0;
+    opt.frames          = 44100;
+    opt.bitDepth        = 16;
+    opt.channels        = 1;
+    opt.sampleRate      = 44100;
+    opt.loop            = false;
+    opt.instruments     = 1;
+    opt.regions         = 16;
+    opt.velocityZones   = 0;
+    opt.roundRobinZones = 0;
+    opt.keyswitchZones  = 0;
+
+    if (argc <= 1) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    int iArg;
+    for (iArg = 1; iArg < argc; ++iArg) {
+        const string o = argv[iArg];
+        if (o == "--") { // common for all command line tools: separator between initial option arguments and i.e. subsequent file arguments
+            iArg++;
+            break;
+        }
+        if (o.substr(0, 1) != "-") break;
+
+        if (o == "-v") {
+            PrintVersion();
+            return EXIT_SUCCESS;
+        } else if (o == "--stereo") {
+            opt.channels = 2;
+        } else if (o == "--loop") {
+            opt.loop = true;
+        } else if (o == "--samples" || o == "--length" || o == "--bits" || o == "--rate" ||
+                   o == "--instruments" || o == "--regions" || o == "--velocity" ||
+                   o == "--round-robin" || o == "--keyswitch")
+        {
+            long value;
+            if (iArg + 1 >= argc || !ParseLong(argv[iArg + 1], value) || value < 1) {
+                cerr << "Option '" << o << "' requires a positive number argument" << endl;
+                return EXIT_FAILURE;
+            }
+            ++iArg;
+            if      (o == "--samples")     opt.samples = (int) value;
+            else if (o == "--length")      opt.frames = value;
+            else if (o == "--bits")        opt.bitDepth = (int) value;
+            else if (o == "--rate")        opt.sampleRate = (int) value;
+            else if (o == "--instruments") opt.instruments = (int) value;
+            else if (o == "--regions")     opt.regions = (int) value;
+            else if (o == "--velocity")    opt.velocityZones = (int) value;
+            else if (o == "--round-robin") opt.roundRobinZones = (int) value;
+            else                           opt.keyswitchZones = (int) value;
+        } else {
+            cerr << "Unknown option '" << o << "'" << endl;
+            cerr << endl;
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (iArg >= argc) {
+        cout << "No output file name provided!" << endl;
+        return EXIT_FAILURE;
+    }
+    const string filename = argv[iArg];
+
+    if (opt.bitDepth != 16 && opt.bitDepth != 24) {
+        cerr << "Only 16 and 24 bit samples are supported." << endl;
+        return EXIT_FAILURE;
+    }
+    if (opt.regions > 128) {
+        cerr << "At most 128 regions per instrument are possible." << endl;
+        return EXIT_FAILURE;
+    }
+    if (opt.velocityZones > 128 || opt.roundRobinZones > 128 || opt.keyswitchZones > 128 ||
+        bitsForZones(opt.velocityZones) + bitsForZones(opt.roundRobinZones) +
+        bitsForZones(opt.keyswitchZones) > 8)
+    {
+        cerr << "Too many dimension zones, all dimensions together must fit into 256 dimension regions." << endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        generate(filename, opt);
+    } catch (RIFF::Exception& e) {
+        cerr << endl;
+        e.PrintMessage();
+        return EXIT_FAILURE;
+    }
+    cout << "Done." << endl;
+    return EXIT_SUCCESS;
+}
+
+bool ParseLong(const string& s, long& result) {
+    if (s.empty()) return false;
+    char* end = NULL;
+    result = strtol(s.c_str(), &end, 10);
+    return end && *end == '\0';
+}
+
+string Revision() {
+    string s = "$Revision$";
+    return s.substr(11, s.size() - 13); // cut dollar signs, spaces and CVS macro keyword
+}
+
+void PrintVersion() {
+    cout << "giggen revision " << Revision() << endl;
+    cout << "using " << gig::libraryName() << " " << gig::libraryVersion() << endl;
+}
+
+void PrintUsage() {
+    cout << "giggen - generates synthetic Gigasampler files for testing." << endl;
+    cout << endl;
+    cout << "Usage: giggen [OPTIONS] GIGFILE" << endl;
+    cout << endl;
+    cout << "   -v                   Print version and exit." << endl;
+    cout << endl;
+    cout << "   --samples N          Amount of samples (default: one for each dimension" << endl;
+    cout << "                        region, otherwise samples are shared)." << endl;
+    cout << endl;
+    cout << "   --length FRAMES      Length of each sample in sample points (default: 44100)." << endl;
+    cout << endl;
+    cout << "   --bits 16|24         Bit depth of the samples (default: 16)." << endl;
+    cout << endl;
+    cout << "   --stereo             Create stereo samples (default: mono)." << endl;
+    cout << endl;
+    cout << "   --rate HZ            Sample rate (default: 44100)." << endl;
+    cout << endl;
+    cout << "   --loop               Loop the second half of each sample." << endl;
+    cout << endl;
+    cout << "   --instruments N      Amount of instruments (default: 1)." << endl;
+    cout << endl;
+    cout << "   --regions N          Regions per instrument, evenly spread over the" << endl;
+    cout << "                        keyboard (default: 16)." << endl;
+    cout << endl;
+    cout << "   --velocity N         Add a velocity dimension with N zones." << endl;
+    cout << endl;
+    cout << "   --round-robin N      Add a round robin dimension with N zones." << endl;
+    cout << endl;
+    cout << "   --keyswitch N        Add a keyswitch dimension with N zones." << endl;
+    cout << endl;
+    cout << "Files with more than 4 GB of wave data automatically use 64 bit offsets." << endl;
+    cout << endl;
+}
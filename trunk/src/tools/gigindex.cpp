@@ -0,0 +1,223 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This program is part of libgig.                                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../gig.h"
+#include "../Catalog.h"
+
+using namespace std;
+
+struct index_options_t {
+    int  threads;
+    bool checksums;
+    bool list;
+    bool samples; ///< Also list the samples (with --list).
+};
+
+string Revision();
+void PrintVersion();
+void PrintUsage();
+bool ParseLong(const string& s, long& result);
+
+static const char* formatName(Catalog::format_t format) {
+    switch (format) {
+        case Catalog::format_gig: return "gig";
+        case Catalog::format_dls: return "DLS";
+        case Catalog::format_sf2: return "sf2";
+        default:                  return "unknown";
+    }
+}
+
+static void progressCallback(RIFF::progress_t* pProgress) {
+    cout << "\rScanning files ... " << int(pProgress->factor * 100.f) << "%" << flush;
+}
+
+// prints the whole catalog
+static void printIndex(const Catalog::Index& index, bool samples) {
+    for (uint32_t f = 0; f < index.CountFiles(); ++f) {
+        const Catalog::file_info_t file = index.GetFile(f);
+        cout << file.Path << " (" << formatName(file.Format) << ", " << file.Size << " bytes";
+        if (file.HasCRC)
+            cout << ", CRC " << hex << setw(8) << setfill('0') << file.CRC << dec << setfill(' ');
+        cout << ")";
+        if (file.Failed) {
+            cout << ": could not be read" << endl;
+            continue;
+        }
+        cout << ": " << file.Instruments << " instrument(s), " << file.Samples << " sample(s)" << endl;
+        for (uint32_t i = 0; i < file.Instruments; ++i) {
+            const Catalog::instrument_info_t instr = index.GetInstrument(file.FirstInstrument + i);
+            cout << "    Instrument '" << instr.Name << "' bank " << instr.MIDIBank
+                 << " program " << instr.MIDIProgram << ", ";
+            if (instr.KeyLow <= instr.KeyHigh)
+                cout << "keys " << int(instr.KeyLow) << ".." << int(instr.KeyHigh) << ", ";
+            cout << instr.Regions << " region(s), " << instr.SampleRefs << " sample(s)" << endl;
+        }
+        if (!samples) continue;
+        for (uint32_t i = 0; i < file.Samples; ++i) {
+            const Catalog::sample_info_t s = index.GetSample(file.FirstSample + i);
+            cout << "    Sample '" << s.Name << "' " << s.SampleRate << " Hz, " << s.Channels
+                 << " channel(s), " << s.BitDepth << " bits, ";
+            if (s.Frames) cout << s.Frames << " frames, ";
+            cout << s.DataSize << " bytes" << (s.Compressed ? " (compressed)" : "") << endl;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    index_options_t opt;
+    opt.threads   = 1;
+    opt.checksums = true;
+    opt.list      = false;
+    opt.samples   = false;
+
+    if (argc <= 1) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    int iArg;
+    for (iArg = 1; iArg < argc; ++iArg) {
+        const string o = argv[iArg];
+        if (o == "--") { // common for all command line tools: separator between initial option arguments and i.e. subsequent file arguments
+            iArg++;
+            break;
+        }
+        if (o.substr(0, 1) != "-") break;
+
+        if (o == "-v") {
+            PrintVersion();
+            return EXIT_SUCCESS;
+        } else if (o == "--no-crc") {
+            opt.checksums = false;
+        } else if (o == "--list") {
+            opt.list = true;
+        } else if (o == "--samples") {
+            opt.list = opt.samples = true;
+        } else if (o == "-j") {
+            long value;
+            if (iArg + 1 >= argc || !ParseLong(argv[iArg + 1], value) || value < 0) {
+                cerr << "Option '" << o << "' requires a positive number argument" << endl;
+                return EXIT_FAILURE;
+            }
+            ++iArg;
+            opt.threads = (int) value;
+        } else {
+            cerr << "Unknown option '" << o << "'" << endl;
+            cerr << endl;
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (iArg >= argc) {
+        cout << "No index file name provided!" << endl;
+        return EXIT_FAILURE;
+    }
+    const string indexPath = argv[iArg++];
+    if (iArg >= argc && !opt.list) {
+        cout << "No files or directories to be cataloged provided!" << endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        if (iArg < argc) {
+            Catalog::Builder builder;
+            for (; iArg < argc; ++iArg)
+                builder.AddPath(argv[iArg]);
+            builder.SetThreadCount(opt.threads);
+            builder.SetChecksums(opt.checksums);
+            RIFF::progress_t progress;
+            progress.callback = progressCallback;
+            const Catalog::build_stats_t stats = builder.Build(indexPath, &progress);
+            cout << "\r" << stats.Files << " file(s) cataloged: " << stats.Scanned << " scanned, "
+                 << stats.Reused << " unchanged";
+            if (stats.Failed) cout << ", " << stats.Failed << " could not be read";
+            cout << "." << endl;
+        }
+        if (opt.list) {
+            Catalog::Index index(indexPath);
+            printIndex(index, opt.samples);
+        }
+    } catch (RIFF::Exception& e) {
+        e.PrintMessage();
+        return EXIT_FAILURE;
+    } catch (...) {
+        cout << "Unknown exception while trying to create catalog." << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+bool ParseLong(const string& s, long& result) {
+    if (s.empty()) return false;
+    char* end = NULL;
+    result = strtol(s.c_str(), &end, 10);
+    return end && *end == '\0';
+}
+
+string Revision() {
+    string s = "$Revision$";
+    return s.substr(11, s.size() - 13); // cut dollar signs, spaces and CVS macro keyword
+}
+
+void PrintVersion() {
+    cout << "gigindex revision " << Revision() << endl;
+    cout << "using " << gig::libraryName() << " " << gig::libraryVersion() << endl;
+}
+
+void PrintUsage() {
+    cout << "gigindex - creates a catalog index of the instruments and samples of sound libraries." << endl;
+    cout << endl;
+    cout << "Usage: gigindex [OPTIONS] INDEXFILE PATH [PATH ...]" << endl;
+    cout << "       gigindex --list [--samples] INDEXFILE" << endl;
+    cout << endl;
+    cout << "	INDEXFILE  Catalog index file to be created or updated (only changed" << endl;
+    cout << "	           files are scanned again if it exists already)." << endl;
+    cout << endl;
+    cout << "	PATH       .gig, .dls or .sf2 file or directory to be cataloged (directories" << endl;
+    cout << "	           are searched recursively)." << endl;
+    cout << endl;
+    cout << "	-j THREADS Scan THREADS files in parallel (0 = one per CPU core, default: 1)." << endl;
+    cout << endl;
+    cout << "	--list     Print the catalog." << endl;
+    cout << endl;
+    cout << "	--no-crc   Don't calculate checksums of the files (which requires reading" << endl;
+    cout << "	           them completely)." << endl;
+    cout << endl;
+    cout << "	--samples  Print the catalog including all samples." << endl;
+    cout << endl;
+    cout << "	-v         Print version and exit." << endl;
+    cout << endl;
+}
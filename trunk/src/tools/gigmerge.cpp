@@ -42,11 +42,12 @@ static vector<gig::File*> g_gigs;
 static void printUsage() {
     cout << "gigmerge - merges several Gigasampler files to one Gigasampler file." << endl;
     cout << endl;
-    cout << "Usage: gigmerge [-v] FILE1 FILE2 [ ... ] NEWFILE" << endl;
+    cout << "Usage: gigmerge [-v] [-k] FILE1 FILE2 [ ... ] NEWFILE" << endl;
     cout << endl;
     cout << "   -v  Print version and exit." << endl;
     cout << endl;
-    cout << "Note: There is no check for duplicate (equivalent) samples yet." << endl;
+    cout << "   -k  Keep duplicate samples. By default samples identical to an already" << endl;
+    cout << "       merged sample are only stored once in the new file." << endl;
     cout << endl;
 }
 
@@ -73,24 +74,29 @@ int main(int argc, char *argv[]) {
         printUsage();
         return EXIT_FAILURE;
     }
-    if (argv[1][0] == '-') {
-        switch (argv[1][1]) {
+    bool bDeduplicate = true;
+    int iArg = 1;
+    for (; iArg < argc && argv[iArg][0] == '-'; ++iArg) {
+        switch (argv[iArg][1]) {
             case 'v':
                 printVersion();
                 return EXIT_SUCCESS;
+            case 'k':
+                bDeduplicate = false;
+                break;
         }
     }
-    if (argc <= 3) {
+    if (argc - iArg <= 2) {
         printUsage();
         return EXIT_FAILURE;
     }
     
     // open all input .gig files
-    const int iInputFiles = argc - 2;
+    const int iInputFiles = argc - iArg - 1;
     int i;
     try {
         for (i = 0; i < iInputFiles; ++i) {
-            RIFF::File* riff = new RIFF::File(argv[i+1]);
+            RIFF::File* riff = new RIFF::File(argv[iArg+i]);
             g_riffs.push_back(riff);
 
             gig::File* gig = new gig::File(riff);
@@ -113,7 +119,7 @@ int main(int argc, char *argv[]) {
         outGig = new gig::File();
         outGig->SetFileName(argv[argc-1]); // required, because AddContentOf() performs auto save
         for (int i = 0; i < g_gigs.size(); ++i) {
-            outGig->AddContentOf(g_gigs[i]);
+            outGig->AddContentOf(g_gigs[i], bDeduplicate);
         }
         outGig->Save();
     } catch (RIFF::Exception e) {
@@ -0,0 +1,421 @@
+/***************************************************************************
+ *                                                                         *
+ *   libgig - C++ cross-platform Gigasampler format file access library    *
+ *                                                                         *
+ *   Copyright (C) 2003-2018 by Christian Schoenebeck                      *
+ *                              <cuse@users.sourceforge.net>               *
+ *                                                                         *
+ *   This program is part of libgig.                                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the Free Software           *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston,                 *
+ *   MA  02111-1307  USA                                                   *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <sstream>
+
+#ifdef WIN32
+# include <windows.h>
+#else
+# include <sys/time.h>
+#endif
+
+#include "../gig.h"
+#include "../helper.h"
+
+using namespace std;
+
+// default amount of sample points to be warmed up of each sample (same as the
+// default preload size of gigbench, which is the order of magnitude a disk
+// streaming sampler engine typically preloads)
+#define DEFAULT_PRELOAD_FRAMES  32768
+
+// gaps between ranges up to this size are warmed up as well instead of
+// issuing separate requests (same as the gap Instrument::GetPreloadPlan()
+// coalesces)
+#define MAX_GAP                 (64 * 1024)
+
+// size of the blocks in which the ranges are read with --wait
+#define READ_BLOCK_SIZE         (1024 * 1024)
+
+struct warm_options_t {
+    long        preloadFrames; ///< 0: whole samples.
+    int         threads;
+    bool        wait;          ///< Read the ranges instead of just hinting them.
+    bool        list;          ///< Print the ranges.
+    set<size_t> instruments;   ///< Indices (starting at 1) of the instruments to be warmed up, empty: all.
+};
+
+// contiguous byte range of a file to be brought into the page cache
+struct warm_range_t {
+    RIFF::File*        pFile;
+    gig::file_offset_t offset; ///< Absolute position within @c pFile.
+    gig::file_offset_t size;
+};
+
+// state shared by all worker threads
+struct warm_job_t {
+    const vector<warm_range_t>* pRanges;
+    bool                        wait;
+    size_t                      next;   ///< Index of the next range to be processed.
+    mutex_t                     mutex;  ///< Protects @c next.
+    uint64_t                    bytes;  ///< Amount of bytes read (with --wait).
+    bool                        failed;
+};
+
+string Revision();
+void PrintVersion();
+void PrintUsage();
+bool ParseLong(const string& s, long& result);
+bool ParseIndices(const string& s, set<size_t>& result);
+double Now();
+
+static bool lessRange(const warm_range_t& a, const warm_range_t& b) {
+    if (a.pFile != b.pFile) return a.pFile < b.pFile;
+    return a.offset < b.offset;
+}
+
+// adds the headers of all chunks below the given list and the bodies of all
+// chunks except sample data
+static void addHeaderRanges(RIFF::File* riff, RIFF::List* list, vector<warm_range_t>& ranges) {
+    const gig::file_offset_t headerSize = 4 + riff->GetFileOffsetSize() + 4; // ID, size (and list type)
+    for (RIFF::Chunk* ck = list->GetFirstSubChunk(); ck; ck = list->GetNextSubChunk()) {
+        const gig::file_offset_t start = ck->GetFilePos() - ck->GetPos();
+        const bool isList = ck->GetChunkID() == CHUNK_ID_LIST;
+        warm_range_t range;
+        range.pFile  = riff;
+        range.offset = (start > headerSize) ? start - headerSize : 0;
+        range.size   = start - range.offset;
+        if (!isList && ck->GetChunkID() != CHUNK_ID_DATA) range.size += ck->GetSize();
+        ranges.push_back(range);
+        if (isList) addHeaderRanges(riff, (RIFF::List*) ck, ranges);
+    }
+}
+
+// sorts the ranges and coalesces overlapping and nearby ones
+static vector<warm_range_t> coalesce(vector<warm_range_t> ranges) {
+    sort(ranges.begin(), ranges.end(), lessRange);
+    vector<warm_range_t> result;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        const warm_range_t& r = ranges[i];
+        if (!r.size) continue;
+        if (!result.empty()) {
+            warm_range_t& last = result.back();
+            if (last.pFile == r.pFile && r.offset <= last.offset + last.size + MAX_GAP) {
+                last.size = max(last.size, r.offset + r.size - last.offset);
+                continue;
+            }
+        }
+        result.push_back(r);
+    }
+    return result;
+}
+
+// reads the given range of the file through the page cache
+static bool readRange(const warm_range_t& range, vector<uint8_t>& buffer, uint64_t& bytes) {
+    // the file itself is the root chunk, its body starts after the RIFF header
+    RIFF::File* riff = range.pFile;
+    const gig::file_offset_t bodyStart = riff->GetFilePos() - riff->GetPos();
+    gig::file_offset_t pos = max(range.offset, bodyStart) - bodyStart;
+    const gig::file_offset_t end = range.offset + range.size - bodyStart;
+    while (pos < end) {
+        RIFF::read_op_t op;
+        op.pChunk = riff;
+        op.Pos    = pos;
+        op.pData  = &buffer[0];
+        op.Size   = min(end - pos, (gig::file_offset_t) buffer.size());
+        op.Result = 0;
+        riff->ReadBatch(&op, 1);
+        if (!op.Result) return op.Pos >= riff->GetSize(); // (end of file is fine)
+        bytes += op.Result;
+        pos   += op.Result;
+    }
+    return true;
+}
+
+static void warmWorker(void* arg) {
+    warm_job_t* job = (warm_job_t*) arg;
+    vector<uint8_t> buffer((job->wait) ? READ_BLOCK_SIZE : 0);
+    uint64_t bytes = 0;
+    bool ok = true;
+    while (true) {
+        size_t i;
+        {
+            mutex_lock_t lock(job->mutex);
+            i = job->next++;
+        }
+        if (i >= job->pRanges->size()) break;
+        const warm_range_t& range = (*job->pRanges)[i];
+        range.pFile->Prefetch(range.offset, range.size);
+        if (job->wait && !readRange(range, buffer, bytes)) ok = false;
+    }
+    mutex_lock_t lock(job->mutex);
+    job->bytes += bytes;
+    if (!ok) job->failed = true;
+}
+
+static string formatSize(double bytes) {
+    ostringstream ss;
+    ss << fixed << setprecision(2);
+    if (bytes >= 1024.0 * 1024.0 * 1024.0)
+        ss << bytes / (1024.0 * 1024.0 * 1024.0) << " GB";
+    else if (bytes >= 1024.0 * 1024.0)
+        ss << bytes / (1024.0 * 1024.0) << " MB";
+    else
+        ss << bytes / 1024.0 << " kB";
+    return ss.str();
+}
+
+// collects the ranges of one gig file required to play its (selected) instruments
+static void collectRanges(gig::File* gig, RIFF::File* riff, const warm_options_t& opt,
+                          vector<warm_range_t>& headers, vector<warm_range_t>& samples, size_t& instruments)
+{
+    set<RIFF::File*> files;
+    files.insert(riff);
+    for (size_t i = 0; gig::Instrument* instr = gig->GetInstrument((uint) i); ++i) {
+        if (!opt.instruments.empty() && !opt.instruments.count(i + 1)) continue;
+        ++instruments;
+        const gig::preload_plan_t plan = instr->GetPreloadPlan(opt.preloadFrames);
+        for (size_t r = 0; r < plan.Runs.size(); ++r) {
+            warm_range_t range;
+            range.pFile  = plan.Runs[r].pFile;
+            range.offset = plan.Runs[r].Offset;
+            range.size   = plan.Runs[r].Size;
+            samples.push_back(range);
+            files.insert(range.pFile);
+        }
+    }
+    // headers of the main file and of all extension files with samples to play
+    for (set<RIFF::File*>::iterator it = files.begin(); it != files.end(); ++it) {
+        warm_range_t range; // the RIFF header itself
+        range.pFile  = *it;
+        range.offset = 0;
+        range.size   = (*it)->GetFilePos() - (*it)->GetPos();
+        headers.push_back(range);
+        addHeaderRanges(*it, *it, headers);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    warm_options_t opt;
+    opt.preloadFrames = DEFAULT_PRELOAD_FRAMES;
+    opt.threads       = 1;
+    opt.wait          = false;
+    opt.list          = false;
+
+    if (argc <= 1) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    int iArg;
+    for (iArg = 1; iArg < argc; ++iArg) {
+        const string o = argv[iArg];
+        if (o == "--") { // common for all command line tools: separator between initial option arguments and i.e. subsequent file arguments
+            iArg++;
+            break;
+        }
+        if (o.substr(0, 1) != "-") break;
+
+        if (o == "-v") {
+            PrintVersion();
+            return EXIT_SUCCESS;
+        } else if (o == "--wait") {
+            opt.wait = true;
+        } else if (o == "--list") {
+            opt.list = true;
+        } else if (o == "--instrument") {
+            if (iArg + 1 >= argc || !ParseIndices(argv[iArg + 1], opt.instruments)) {
+                cerr << "Option '" << o << "' requires a comma separated list of instrument numbers (starting at 1)" << endl;
+                return EXIT_FAILURE;
+            }
+            ++iArg;
+        } else if (o == "--preload" || o == "--threads") {
+            long value;
+            if (iArg + 1 >= argc || !ParseLong(argv[iArg + 1], value) || value < 0 ||
+                (o == "--threads" && value < 1))
+            {
+                cerr << "Option '" << o << "' requires a positive number argument" << endl;
+                return EXIT_FAILURE;
+            }
+            ++iArg;
+            if (o == "--preload") opt.preloadFrames = value;
+            else opt.threads = (int) value;
+        } else {
+            cerr << "Unknown option '" << o << "'" << endl;
+            cerr << endl;
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (iArg >= argc) {
+        cout << "No file name provided!" << endl;
+        return EXIT_FAILURE;
+    }
+
+    vector<RIFF::File*> riffs;
+    vector<gig::File*> gigs;
+    vector<warm_range_t> ranges;
+    int result = EXIT_SUCCESS;
+    try {
+        const double t0 = Now();
+        for (; iArg < argc; ++iArg) {
+            const string filename = argv[iArg];
+            RIFF::File* riff = new RIFF::File(filename);
+            riffs.push_back(riff);
+            gig::File* gig = new gig::File(riff);
+            gigs.push_back(gig);
+            // only the positions of the sample data are needed, so don't
+            // read whole compressed samples for scanning them
+            gig->SetLazySampleScan(true);
+            vector<warm_range_t> headers, samples;
+            size_t instruments = 0;
+            collectRanges(gig, riff, opt, headers, samples, instruments);
+            headers = coalesce(headers);
+            samples = coalesce(samples);
+            double h = 0, s = 0;
+            for (size_t i = 0; i < headers.size(); ++i) h += headers[i].size;
+            for (size_t i = 0; i < samples.size(); ++i) s += samples[i].size;
+            cout << filename << ": " << instruments << " instrument(s), "
+                 << formatSize(h) << " headers, " << formatSize(s) << " sample data" << endl;
+            ranges.insert(ranges.end(), headers.begin(), headers.end());
+            ranges.insert(ranges.end(), samples.begin(), samples.end());
+        }
+        // sample runs may overlap or adjoin the headers, so coalesce again
+        ranges = coalesce(ranges);
+        double total = 0;
+        for (size_t i = 0; i < ranges.size(); ++i) total += ranges[i].size;
+
+        if (opt.list) {
+            for (size_t i = 0; i < ranges.size(); ++i)
+                cout << "  " << ranges[i].pFile->GetFileName() << " @" << ranges[i].offset
+                     << " +" << ranges[i].size << endl;
+        }
+
+        warm_job_t job;
+        job.pRanges = &ranges;
+        job.wait    = opt.wait;
+        job.next    = 0;
+        job.bytes   = 0;
+        job.failed  = false;
+        const int threads = (int) min((size_t) opt.threads, max(ranges.size(), (size_t) 1));
+        vector<thread_t> workers(threads);
+        vector<bool> started(threads);
+        for (int t = 0; t < threads; ++t)
+            started[t] = __create_thread(workers[t], warmWorker, &job);
+        for (int t = 0; t < threads; ++t) {
+            if (started[t]) __join_thread(workers[t]);
+            else warmWorker(&job); // no thread support: process sequentially
+        }
+
+        cout << (opt.wait ? "Read " : "Requested ") << ranges.size() << " range(s), "
+             << formatSize(total) << " in total";
+        if (opt.wait) cout << ", " << formatSize((double) job.bytes) << " read";
+        cout << " (" << fixed << setprecision(3) << (Now() - t0) << " s)." << endl;
+        if (job.failed) {
+            cerr << "Reading some of the ranges failed." << endl;
+            result = EXIT_FAILURE;
+        }
+    } catch (RIFF::Exception& e) {
+        e.PrintMessage();
+        result = EXIT_FAILURE;
+    } catch (...) {
+        cout << "Unknown exception while trying to warm up files." << endl;
+        result = EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < gigs.size(); ++i) delete gigs[i];
+    for (size_t i = 0; i < riffs.size(); ++i) delete riffs[i];
+    return result;
+}
+
+/// Returns current wall clock time in seconds.
+double Now() {
+#ifdef WIN32
+    LARGE_INTEGER freq, count;
+    if (QueryPerformanceFrequency(&freq) && QueryPerformanceCounter(&count))
+        return double(count.QuadPart) / double(freq.QuadPart);
+    return double(GetTickCount()) / 1000.0;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + double(tv.tv_usec) / 1000000.0;
+#endif
+}
+
+bool ParseLong(const string& s, long& result) {
+    if (s.empty()) return false;
+    char* end = NULL;
+    result = strtol(s.c_str(), &end, 10);
+    return end && *end == '\0';
+}
+
+bool ParseIndices(const string& s, set<size_t>& result) {
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == string::npos) comma = s.size();
+        long value;
+        if (!ParseLong(s.substr(pos, comma - pos), value) || value < 1) return false;
+        result.insert((size_t) value);
+        pos = comma + 1;
+    }
+    return true;
+}
+
+string Revision() {
+    string s = "$Revision$";
+    return s.substr(11, s.size() - 13); // cut dollar signs, spaces and CVS macro keyword
+}
+
+void PrintVersion() {
+    cout << "gigwarm revision " << Revision() << endl;
+    cout << "using " << gig::libraryName() << " " << gig::libraryVersion() << endl;
+}
+
+void PrintUsage() {
+    cout << "gigwarm - brings the data required to play gig instruments into the page cache." << endl;
+    cout << endl;
+    cout << "Usage: gigwarm [OPTIONS] GIGFILE [GIGFILE ...]" << endl;
+    cout << endl;
+    cout << "   -v                   Print version and exit." << endl;
+    cout << endl;
+    cout << "   --instrument LIST    Only warm up the instruments with the given comma" << endl;
+    cout << "                        separated numbers (starting at 1, as listed by" << endl;
+    cout << "                        gigdump) of each file (default: all instruments)." << endl;
+    cout << endl;
+    cout << "   --preload FRAMES     Amount of sample points to warm up of each sample," << endl;
+    cout << "                        0 for whole samples (default: " << DEFAULT_PRELOAD_FRAMES << ")." << endl;
+    cout << endl;
+    cout << "   --threads N          Amount of threads issuing the requests (default: 1)." << endl;
+    cout << endl;
+    cout << "   --wait               Read the data instead of just asking the operating" << endl;
+    cout << "                        system to read it ahead, so everything is in the" << endl;
+    cout << "                        page cache when gigwarm exits." << endl;
+    cout << endl;
+    cout << "   --list               Print the file ranges being warmed up." << endl;
+    cout << endl;
+}
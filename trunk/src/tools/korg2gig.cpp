@@ -29,6 +29,7 @@
 #include <cstdlib>
 #include <string>
 #include <set>
+#include <string.h>
 
 #if !defined(WIN32)
 # include <unistd.h>
@@ -36,6 +37,12 @@
 
 #include "../Korg.h"
 #include "../gig.h"
+#include "../helper.h"
+
+// amount of sample points read from a .KSF file at once
+#define KSF_BLOCK_FRAMES     65536
+// amount of blocks read ahead while writing the .gig file
+#define KSF_PREFETCH_BLOCKS  4
 
 using namespace std;
 
@@ -383,7 +390,7 @@ static map<Korg::KSFSample*,gig::Sample*> sampleRelations;
  * Because the .gig file needs to be saved and resized in file size accordingly
  * to the total size of all samples. For efficiency reasons the resize opertion
  * is first just here schedued for all samples, then in a second pass the actual
- * data written in writeAllSampleData();
+ * data is written by ksfSampleSource() while the .gig file is being saved.
  */
 static gig::Sample* findOrcreateGigSampleForKSFSample(Korg::KSFSample* ksfSample, gig::Group* gigSampleGroup, const Korg::KMPRegion* kmpRegion = NULL) {
     if (ksfSample->SamplePoints <= 0) {
@@ -425,20 +432,157 @@ static gig::Sample* findOrcreateGigSampleForKSFSample(Korg::KSFSample* ksfSample
 }
 
 /**
- * Second pass: see comment of findOrcreateGigSampleForKSFSample().
+ * Streams the wave data of one .KSF sample in blocks of KSF_BLOCK_FRAMES
+ * sample points. The blocks are read ahead by a separate thread, so reading
+ * the .KSF file overlaps with writing the .gig file. Memory consumption is
+ * constant, independent of the sample's size. If no thread can be created,
+ * the sample is simply read synchronously.
  */
-static void writeAllSampleData() {
-    for (map<Korg::KSFSample*,gig::Sample*>::iterator it = sampleRelations.begin();
-         it != sampleRelations.end(); ++it)
+class KSFSampleStream {
+public:
+    KSFSampleStream(Korg::KSFSample* pSample);
+   ~KSFSampleStream();
+    unsigned long Read(void* pBuffer, unsigned long FrameCount);
+    Korg::KSFSample* GetSample() const { return pSample; }
+private:
+    static void worker(void* arg);
+
+    Korg::KSFSample* pSample;
+    int              frameSize;
+    vector<uint8_t>  blocks[KSF_PREFETCH_BLOCKS];
+    unsigned long    frames[KSF_PREFETCH_BLOCKS]; ///< sample points in the respective block
+    int              head;     ///< oldest block not completely consumed yet
+    int              count;    ///< amount of blocks read, but not consumed yet
+    unsigned long    headPos;  ///< sample points of block @c head already consumed
+    bool             eof;
+    bool             quit;
+    string           error;
+    mutex_t          mutex;    ///< protects all members above, except the content of blocks not yet counted
+    condition_t      produced; ///< signalled when a block was read or EOF reached
+    condition_t      consumed; ///< signalled when a block was consumed or on quit
+    thread_t         thread;
+    bool             threadRunning;
+};
+
+KSFSampleStream::KSFSampleStream(Korg::KSFSample* pSample)
+    : pSample(pSample), frameSize(pSample->FrameSize()), head(0), count(0),
+      headPos(0), eof(false), quit(false)
+{
+    pSample->SetPos(0);
+    for (int i = 0; i < KSF_PREFETCH_BLOCKS; ++i) {
+        blocks[i].resize(KSF_BLOCK_FRAMES * frameSize);
+        frames[i] = 0;
+    }
+    threadRunning = __create_thread(thread, worker, this);
+}
+
+KSFSampleStream::~KSFSampleStream() {
+    if (!threadRunning) return;
     {
-        Korg::KSFSample* ksfSample = it->first;
-        gig::Sample* gigSample     = it->second;
-        if (!gigSample) continue; // can be NULL if the source KORG file had zero length (attempting to write a .gig file with zero size sample would throw an exception)
-        Korg::buffer_t src = ksfSample->LoadSampleData();
-        gigSample->SetPos(0);
-        gigSample->Write(src.pStart, ksfSample->SamplePoints);
-        ksfSample->ReleaseSampleData();
+        mutex_lock_t lock(mutex);
+        quit = true;
+        consumed.signal();
     }
+    __join_thread(thread);
+}
+
+void KSFSampleStream::worker(void* arg) {
+    KSFSampleStream* s = static_cast<KSFSampleStream*>(arg);
+    s->mutex.lock();
+    while (!s->quit && !s->eof) {
+        if (s->count == KSF_PREFETCH_BLOCKS) {
+            s->consumed.wait(s->mutex);
+            continue;
+        }
+        // the consumer never touches this block before it is counted
+        const int slot = (s->head + s->count) % KSF_PREFETCH_BLOCKS;
+        s->mutex.unlock();
+        unsigned long n = 0;
+        string err;
+        try {
+            // (16 bit: same result as Read(), but with bulk byte swapping)
+            n = (s->pSample->BitDepth == 16)
+                ? s->pSample->Read16((int16_t*) &s->blocks[slot][0], KSF_BLOCK_FRAMES)
+                : s->pSample->Read(&s->blocks[slot][0], KSF_BLOCK_FRAMES);
+        } catch (RIFF::Exception& e) {
+            err = e.Message;
+        } catch (...) {
+            err = "Unknown exception while reading .KSF file";
+        }
+        s->mutex.lock();
+        s->frames[slot] = n;
+        if (n) s->count++;
+        if (!n || !err.empty()) {
+            s->eof   = true;
+            s->error = err;
+        }
+        s->produced.signal();
+    }
+    s->mutex.unlock();
+}
+
+/// Copies the next @a FrameCount sample points to @a pBuffer, returns the
+/// amount of sample points actually copied (0 on end of sample).
+unsigned long KSFSampleStream::Read(void* pBuffer, unsigned long FrameCount) {
+    if (!threadRunning) return pSample->Read(pBuffer, FrameCount);
+    uint8_t* pDst = (uint8_t*) pBuffer;
+    unsigned long total = 0;
+    mutex_lock_t lock(mutex);
+    while (total < FrameCount) {
+        while (!count && !eof) produced.wait(mutex);
+        if (!count) break; // end of sample
+        unsigned long n = frames[head] - headPos;
+        if (n > FrameCount - total) n = FrameCount - total;
+        memcpy(pDst + total * frameSize, &blocks[head][headPos * frameSize], n * frameSize);
+        total   += n;
+        headPos += n;
+        if (headPos == frames[head]) {
+            head = (head + 1) % KSF_PREFETCH_BLOCKS;
+            count--;
+            headPos = 0;
+            consumed.signal();
+        }
+    }
+    if (!total && !error.empty()) throw Korg::Exception(error);
+    return total;
+}
+
+// stream of the .KSF sample currently being written by ksfSampleSource()
+static KSFSampleStream* ksfStream = NULL;
+
+/**
+ * Second pass: see comment of findOrcreateGigSampleForKSFSample(). Called by
+ * gig::File::SaveSequential() for each gig sample (one after another). The
+ * Korg sample currently being written is streamed block by block, so the
+ * whole conversion runs with constant memory consumption.
+ */
+static gig::file_offset_t ksfSampleSource(gig::Sample* gigSample, void* pBuffer, gig::file_offset_t FrameCount, void* /*pUserData*/) {
+    static gig::file_offset_t pos = 0;
+    if (!ksfStream || sampleRelations[ksfStream->GetSample()] != gigSample) {
+        if (ksfStream) delete ksfStream;
+        ksfStream = NULL;
+        Korg::KSFSample* ksfSample = NULL;
+        for (map<Korg::KSFSample*,gig::Sample*>::iterator it = sampleRelations.begin();
+             it != sampleRelations.end(); ++it)
+        {
+            if (it->second == gigSample) {
+                ksfSample = it->first;
+                break;
+            }
+        }
+        if (!ksfSample) return 0;
+        ksfStream = new KSFSampleStream(ksfSample);
+        pos = 0;
+    }
+    const gig::file_offset_t total = ksfStream->GetSample()->SamplePoints;
+    if (FrameCount > total - pos) FrameCount = total - pos;
+    FrameCount = ksfStream->Read(pBuffer, FrameCount);
+    pos += FrameCount;
+    if (pos == total || !FrameCount) {
+        delete ksfStream;
+        ksfStream = NULL;
+    }
+    return FrameCount;
 }
 
 static gig::Sample* findOrCreateGigSampleForKSFRegion(const Korg::KMPRegion* kmpRegion) {
@@ -515,6 +659,10 @@ static void loadKorgFile(const string& filename, bool bReferenced = false) {
 }
 
 static void cleanup() {
+    if (ksfStream) {
+        delete ksfStream;
+        ksfStream = NULL;
+    }
     if (g_gig) {
         delete g_gig;
         g_gig = NULL;
@@ -797,10 +945,7 @@ int main(int argc, char *argv[]) {
 
         // save result to disk (as .gig file)
         cout << "Saving converted (.gig) file to '" << outFileName << "' ... " << flush;
-        g_gig->Save(outFileName); 
-        cout << "OK\n";
-        cout << "Writing all samples to converted (.gig) file  ... " << flush;
-        writeAllSampleData();
+        g_gig->SaveSequential(outFileName, ksfSampleSource);
         cout << "OK\n";
     } catch (RIFF::Exception e) {
         cerr << "Failed generating output file:" << endl;
@@ -40,7 +40,9 @@ string Revision();
 void PrintVersion();
 void PrintUsage();
 void PrintChunkList(RIFF::List* list, bool PrintSize);
+RIFF::scan_action_t PrintChunk(const RIFF::scan_entry_t& entry, void* pPrintSize);
 static uint32_t strToChunkID(string s);
+static string chunkIDToString(uint32_t id);
 
 int main(int argc, char *argv[])
 {
@@ -107,10 +109,13 @@ int main(int argc, char *argv[])
     try {
         RIFF::File* riff = NULL;
         switch (layout) {
-            case RIFF::layout_standard:
-                riff = new RIFF::File(argv[FileArgIndex]);
-                cout << "RIFF(" << riff->GetListTypeString() << ")->";
-                break;
+            case RIFF::layout_standard: {
+                // just walk over the chunk headers, no need to load the
+                // whole RIFF tree for printing it
+                RIFF::Scanner scanner(argv[FileArgIndex]);
+                scanner.Scan(PrintChunk, &bPrintSize);
+                return EXIT_SUCCESS;
+            }
             case RIFF::layout_flat:
                 if (!bExpectFirstChunkID) {
                     cerr << "If you are using '--flat' then you must also use '--first-chunk-id'." << endl; 
@@ -167,6 +172,27 @@ void PrintChunkList(RIFF::List* list, bool PrintSize) {
     }
 }
 
+RIFF::scan_action_t PrintChunk(const RIFF::scan_entry_t& entry, void* pPrintSize) {
+    const bool PrintSize = *(bool*) pPrintSize;
+    if (entry.Level == 0) { // root chunk
+        cout << "RIFF(" << chunkIDToString(entry.ListType) << ")->";
+        if (PrintSize) cout << " (" << entry.Size << " Bytes)";
+        cout << endl;
+        return RIFF::scan_continue;
+    }
+    for (int i = 0; i < entry.Level; ++i)
+        cout << "            "; // e.g. 'LIST(INFO)->'
+    cout << chunkIDToString(entry.ChunkID);
+    if (entry.IsList) {
+        cout << "(" << chunkIDToString(entry.ListType) << ")->";
+    } else {
+        cout << ";";
+    }
+    if (PrintSize) cout << " (" << entry.Size << " Bytes)";
+    cout << endl;
+    return RIFF::scan_continue;
+}
+
 static uint32_t strToChunkID(string s) {
     if (s.size() != 4) {
         cerr << "Argument after '--first-chunk-id' must be exactly 4 characters long." << endl;
@@ -180,6 +206,13 @@ static uint32_t strToChunkID(string s) {
     return result;
 }
 
+static string chunkIDToString(uint32_t id) {
+    string result;
+    for (int i = 0; i < 4; ++i)
+        result += char((id >> i*8) & 0xff);
+    return result;
+}
+
 string Revision() {
     string s = "$Revision$";
     return s.substr(11, s.size() - 13); // cut dollar signs, spaces and CVS macro keyword
@@ -36,8 +36,10 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <vector>
 
 #include "../SF.h"
+#include "../helper.h"
 
 #ifdef _MSC_VER
 #define S_ISDIR(x) (S_IFDIR & (x))
@@ -67,12 +69,15 @@
 # include <audiofile.h>
 #endif // HAVE_SNDFILE
 
+// amount of sample frames read (and written) at once by sf2extract, so the
+// memory needed for extracting a sample does not depend on the sample's size
+#define STREAM_BUFFER_FRAMES	65536
+
 using namespace std;
 
 typedef map<unsigned int, bool> OrderMap;
 
-void ExtractSamples(sf2::File* gig, char* destdir, OrderMap& selection);
-int writeWav(sf2::Sample* sample, const char* filename, void* samples, long totalFrameCount, int bitdepth);
+void ExtractSamples(sf2::File* gig, char* destdir, OrderMap& selection, int threads);
 
 string ToString(int i) {
     const int SZ = 64;
@@ -107,7 +112,7 @@ void PrintVersion() {
 static void PrintUsage() {
     cout << "sf2extract - extracts samples from a SoundFont version 2 file." << endl;
     cout << endl;
-    cout << "Usage: sf2extract [-v] SF2FILE DESTDIR [SAMPLENR] [ [SAMPLENR] ...]" << endl;
+    cout << "Usage: sf2extract [-v] [-j THREADS] SF2FILE DESTDIR [SAMPLENR] [ [SAMPLENR] ...]" << endl;
     cout << endl;
     cout << "   SF2FILE  Input SoundFont (.sf2) file." << endl;
     cout << endl;
@@ -119,6 +124,9 @@ static void PrintUsage() {
     cout << endl;
     cout << "   -v       Print version and exit." << endl;
     cout << endl;
+    cout << "   -j       Extract THREADS samples in parallel (0 = one per CPU core," << endl;
+    cout << "            default: 1)." << endl;
+    cout << endl;
 }
 
 #if !HAVE_SNDFILE // use libaudiofile
@@ -138,14 +146,19 @@ int(*_afCloseFile)(AFfilehandle file);
 #endif // !HAVE_SNDFILE
 
 int main(int argc, char *argv[]) {
-     OrderMap selectedSamples;
-     if (argc >= 2) {
-        if (argv[1][0] == '-') {
-            switch (argv[1][1]) {
-                case 'v':
-                    PrintVersion();
-                    return EXIT_SUCCESS;
-            }
+    OrderMap selectedSamples;
+    int threads = 1; // sequential extraction by default
+    while (argc >= 2 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-v")) {
+            PrintVersion();
+            return EXIT_SUCCESS;
+        } else if (!strcmp(argv[1], "-j") && argc > 2) {
+            threads = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+        } else {
+            PrintUsage();
+            return EXIT_FAILURE;
         }
     }
     if (argc < 3) {
@@ -196,7 +209,7 @@ int main(int argc, char *argv[]) {
         }
 
         cout << "Extracting samples from \"" << argv[1] << "\" to directory \"" << argv[2] << "\"." << endl << flush;
-        ExtractSamples(sf, argv[2], selectedSamples);
+        ExtractSamples(sf, argv[2], selectedSamples, threads);
         cout << "Extraction finished." << endl << flush;
         delete sf;
         delete riff;
@@ -250,7 +263,51 @@ inline void stripLeftOrRightMarkerAtEnd(string& s) {
     }
 }
 
-void ExtractSamples(sf2::File* sf, char* destdir, OrderMap& selection) {
+// one (mono) sample or stereo sample pair to be extracted by a worker thread
+struct SampleJob {
+    sf2::Sample* pSample;
+    sf2::Sample* pSample2; // other half of a stereo pair, NULL for mono samples
+    int          index;    // running number of the sample (for output)
+    string       name;
+    string       filename;
+    int          bitdepth;
+    long         totalFrameCount;
+};
+
+struct ParallelExtraction {
+    std::vector<SampleJob> jobs;
+    mutex_t mutex; // protects stdout
+};
+
+static const char* extractSample(const SampleJob& job);
+
+static void extractSampleJob(void* arg, size_t index) {
+    ParallelExtraction* p = (ParallelExtraction*) arg;
+    const SampleJob& job = p->jobs[index];
+    sf2::Sample* pSample = job.pSample;
+    const char* err = extractSample(job);
+
+    mutex_lock_t lock(p->mutex);
+    cout << "Extracting Sample " << job.index << ") " << job.name << " ("
+         << job.bitdepth << "Bits, " << pSample->SampleRate << "Hz, " << pSample->GetChannelCount() << " Channels, " << job.totalFrameCount << " Samples";
+    if (pSample->HasLoops()) {
+        cout << ", LoopStart " << pSample->StartLoop
+             << ", LoopEnd "   << pSample->EndLoop;
+    }
+    cout << ")...";
+    if (err) cout << err << endl << flush;
+    else     cout << "ok" << endl << flush;
+}
+
+/**
+ * Extracts the selected samples of @a sf with @a threads worker threads
+ * (0 = one per CPU core). Linked stereo sample pairs are written as one
+ * interleaved stereo .wav file. The samples are streamed from disk in
+ * pieces of STREAM_BUFFER_FRAMES frames with sf2::Sample::ReadAt(), which
+ * does not use the (shared) read position of the file, so the samples can
+ * be read concurrently without locking.
+ */
+void ExtractSamples(sf2::File* sf, char* destdir, OrderMap& selection, int threads) {
     if (sf->GetSampleCount() <= 0) {
         cerr << "No samples found in file.\n";
         return;
@@ -260,10 +317,7 @@ void ExtractSamples(sf2::File* sf, char* destdir, OrderMap& selection) {
     hAFlib = NULL;
     openAFlib();
 #endif // !HAVE_SNDFILE
-    uint8_t* pWave  = NULL;
-    int* pIntWave = NULL;
-    long BufferSize = 0;
-    sf2::Sample::buffer_t tmpBuf;
+    ParallelExtraction p;
 
     for (int iSample = 0; iSample < sf->GetSampleCount(); ++iSample) {
         sf2::Sample* pSample = sf->GetSample(iSample);
@@ -294,86 +348,49 @@ void ExtractSamples(sf2::File* sf, char* destdir, OrderMap& selection) {
             name += "\"";
         }
         filename += ".wav";
-        const int bitdepth =
-            pSample->GetFrameSize() / pSample->GetChannelCount() * 8;
-        cout << "Extracting Sample " << (iSample+1) << ") " << name << " ("
-             << bitdepth << "Bits, " << pSample->SampleRate << "Hz, " << pSample->GetChannelCount() << " Channels, " << totalFrameCount << " Samples";
-        if (pSample->HasLoops()) {
-            cout << ", LoopStart " << pSample->StartLoop
-                 << ", LoopEnd "   << pSample->EndLoop;
-        }
-        cout << ")..." << flush;
 
         // some sanity checks whether the stereo sample pair matches
         if (pSample2) {
             if (pSample->GetFrameSize()    != pSample2->GetFrameSize() ||
                 pSample->GetChannelCount() != pSample2->GetChannelCount())
             {
-                cerr << "Error: stereo sample pair does not match [ignoring]\n";
+                cerr << "Error: stereo sample pair " << (iSample+1) << ") " << name << " does not match [ignoring]\n";
                 continue;
             }
         }
 
-        const long neededsize = (bitdepth == 24) ?
-            totalFrameCount * pSample->GetChannelCount() * sizeof(int) :
-            totalFrameCount * pSample->GetFrameSize();
-        if (BufferSize < neededsize) {
-            if (pWave) delete[] pWave;
-            pWave = new uint8_t[neededsize];
-            BufferSize = neededsize;
-        }
-        pIntWave = (int*)pWave;
-        memset(pWave, 0, neededsize);
-
-        pSample->SetPos(0);
-        unsigned long nRead = pSample->Read(pWave, pSample->GetTotalFrameCount());
-        if (nRead <= 0)
-            throw RIFF::Exception("Could not load sample data.");
-
-        if (pSample2) {
-            if (tmpBuf.Size < neededsize) {
-                if (tmpBuf.pStart) delete[] (uint8_t*)tmpBuf.pStart;
-                tmpBuf.pStart = new uint8_t[neededsize];
-                tmpBuf.Size   = neededsize;
-            }
-            pSample2->SetPos(0);
-            unsigned long nRead = pSample2->ReadNoClear(pWave, pSample2->GetTotalFrameCount(), tmpBuf);
-            if (nRead <= 0)
-                throw RIFF::Exception("Could not load sample data.");
-        }
-
-        // Both libsndfile and libaudiofile uses int for 24 bit
-        // samples. libgig however returns 3 bytes per sample, so
-        // we have to convert the wave data before writing.
-        if (bitdepth == 24) {
-            int n = totalFrameCount * pSample->GetChannelCount();
-            for (int i = n - 1 ; i >= 0 ; i--) {
-#if HAVE_SNDFILE
-                pIntWave[i] = pWave[i * 3] << 8 | pWave[i * 3 + 1] << 16 | pWave[i * 3 + 2] << 24;
-#else
-                pIntWave[i] = pWave[i * 3] | pWave[i * 3 + 1] << 8 | pWave[i * 3 + 2] << 16;
-#endif
-            }
-        }
-
-        int res = writeWav(pSample, filename.c_str(), pWave, totalFrameCount, bitdepth);
-        if (res < 0) cout << "Couldn't write sample data." << endl;
-        else cout << "ok" << endl;
+        SampleJob job;
+        job.pSample         = pSample;
+        job.pSample2        = pSample2;
+        job.index           = iSample+1;
+        job.name            = name;
+        job.filename        = filename;
+        job.bitdepth        = pSample->GetFrameSize() / pSample->GetChannelCount() * 8;
+        job.totalFrameCount = totalFrameCount;
+        p.jobs.push_back(job);
 
         // make sure we don't extract this stereo sample pair a 2nd time
         if (pSample2)
             selection[pSample->SampleLink] = false;
     }
-    if (pWave) delete[] pWave;
-    if (tmpBuf.pStart) delete[] (uint8_t*)tmpBuf.pStart;
+    __parallel_for(p.jobs.size(), threads, extractSampleJob, &p);
 #if !HAVE_SNDFILE // use libaudiofile
     closeAFlib();
 #endif // !HAVE_SNDFILE
 }
 
-int writeWav(sf2::Sample* sample, const char* filename, void* samples, long totalFrameCount, int bitdepth) {
+// .wav output file currently being written by extractSample()
+struct WavFile {
+#if HAVE_SNDFILE
+    SNDFILE* hFile;
+#else
+    AFfilesetup  setup;
+    AFfilehandle hFile;
+#endif
+};
+
+static const char* openWav(WavFile& wav, sf2::Sample* sample, const char* filename, long totalFrameCount, int bitdepth) {
 #if HAVE_SNDFILE
-    SNDFILE* hfile;
     SF_INFO  sfinfo;
     SF_INSTRUMENT instr;
     int format = SF_FORMAT_WAV;
@@ -391,8 +408,7 @@ int writeWav(sf2::Sample* sample, const char* filename, void* samples, long tota
             format |= SF_FORMAT_PCM_32;
             break;
         default:
-            cerr << "Error: Bithdepth " << ToString(bitdepth) << " not supported by libsndfile, ignoring sample!\n" << flush;
-            return -1;
+            return "Bit depth not supported by libsndfile, ignoring sample!";
     }
     memset(&sfinfo, 0, sizeof (sfinfo));
     memset(&instr, 0, sizeof (instr));
@@ -400,10 +416,8 @@ int writeWav(sf2::Sample* sample, const char* filename, void* samples, long tota
     sfinfo.frames     = totalFrameCount;
     sfinfo.channels   = sample->GetChannelCount();
     sfinfo.format     = format;
-    if (!(hfile = sf_open(filename, SFM_WRITE, &sfinfo))) {
-        cerr << "Error: Unable to open output file \'" << filename << "\'.\n" << flush;
-        return -1;
-    }
+    if (!(wav.hFile = sf_open(filename, SFM_WRITE, &sfinfo)))
+        return "Unable to open output file.";
     instr.basenote = sample->OriginalPitch;
     instr.detune = sample->PitchCorrection;
     if (sample->HasLoops()) {
@@ -413,31 +427,99 @@ int writeWav(sf2::Sample* sample, const char* filename, void* samples, long tota
         instr.loops[0].end   = sample->EndLoop;
         instr.loops[0].count = 1;
     }
-    sf_command(hfile, SFC_SET_INSTRUMENT, &instr, sizeof(instr));
-    sf_count_t res = (bitdepth == 24) ?
-        sf_write_int(hfile, static_cast<int*>(samples), sample->GetChannelCount() * totalFrameCount) :
-        sf_write_short(hfile, static_cast<short*>(samples), sample->GetChannelCount() * totalFrameCount);
-    if (res != sample->GetChannelCount() * totalFrameCount) {
-        cerr << sf_strerror(hfile) << endl << flush;
-        sf_close(hfile);
-        return -1;
+    sf_command(wav.hFile, SFC_SET_INSTRUMENT, &instr, sizeof(instr));
+#else // use libaudiofile
+    wav.setup = _afNewFileSetup();
+    if (wav.setup == AF_NULL_FILESETUP) return "Couldn't write sample data.";
+    _afInitFileFormat(wav.setup, AF_FILE_WAVE);
+    _afInitChannels(wav.setup, AF_DEFAULT_TRACK, sample->GetChannelCount());
+    _afInitSampleFormat(wav.setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, bitdepth);
+    _afInitRate(wav.setup, AF_DEFAULT_TRACK, sample->SampleRate);
+    wav.hFile = _afOpenFile(filename, "w", wav.setup);
+    if (wav.hFile == AF_NULL_FILEHANDLE) {
+        _afFreeFileSetup(wav.setup);
+        return "Unable to open output file.";
     }
-    sf_close(hfile);
+#endif // HAVE_SNDFILE
+    return NULL; // success
+}
+
+static bool writeWavFrames(WavFile& wav, void* samples, long frames, int channels, int bitdepth) {
+#if HAVE_SNDFILE
+    sf_count_t res = (bitdepth == 24) ?
+        sf_write_int(wav.hFile, static_cast<int*>(samples), channels * frames) :
+        sf_write_short(wav.hFile, static_cast<short*>(samples), channels * frames);
+    return res == channels * frames;
 #else // use libaudiofile
-    AFfilesetup setup = _afNewFileSetup();
-    _afInitFileFormat(setup, AF_FILE_WAVE);
-    _afInitChannels(setup, AF_DEFAULT_TRACK, sample->GetChannelCount());
-    _afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, bitdepth);
-    _afInitRate(setup, AF_DEFAULT_TRACK, sample->SampleRate);
-    if (setup == AF_NULL_FILESETUP) return -1;
-    AFfilehandle hFile = _afOpenFile(filename, "w", setup);
-    if (hFile == AF_NULL_FILEHANDLE) return -1;
-    if (_afWriteFrames(hFile, AF_DEFAULT_TRACK, samples, totalFrameCount) < 0) return -1;
-    _afCloseFile(hFile);
-    _afFreeFileSetup(setup);
+    return _afWriteFrames(wav.hFile, AF_DEFAULT_TRACK, samples, frames) == frames;
 #endif // HAVE_SNDFILE
+}
 
-    return 0; // success
+static void closeWav(WavFile& wav) {
+#if HAVE_SNDFILE
+    sf_close(wav.hFile);
+#else // use libaudiofile
+    _afCloseFile(wav.hFile);
+    _afFreeFileSetup(wav.setup);
+#endif // HAVE_SNDFILE
+}
+
+/**
+ * Streams the wave data of the sample (pair) of @a job to its .wav file.
+ * Returns NULL on success or an error message otherwise. May be called by
+ * several threads at the same time for different samples.
+ */
+static const char* extractSample(const SampleJob& job) {
+    sf2::Sample* pSample  = job.pSample;
+    sf2::Sample* pSample2 = job.pSample2;
+    WavFile wav;
+    const char* err = openWav(wav, pSample, job.filename.c_str(), job.totalFrameCount, job.bitdepth);
+    if (err) return err;
+
+    const int channels = pSample->GetChannelCount();
+    std::vector<uint8_t> wave(STREAM_BUFFER_FRAMES * pSample->GetFrameSize());
+    std::vector<int> intWave((job.bitdepth == 24) ? STREAM_BUFFER_FRAMES * channels : 0);
+    for (long pos = 0; pos < job.totalFrameCount; ) {
+        long n = job.totalFrameCount - pos;
+        if (n > STREAM_BUFFER_FRAMES) n = STREAM_BUFFER_FRAMES;
+
+        // the shorter half of a stereo pair (if any) is padded with silence
+        memset(&wave[0], 0, n * pSample->GetFrameSize());
+        unsigned long nRead = pSample->ReadAt(pos, &wave[0], n);
+        if (pSample2) {
+            unsigned long nRead2 = pSample2->ReadAt(pos, &wave[0], n);
+            if (nRead2 > nRead) nRead = nRead2;
+        }
+        if (nRead <= 0) {
+            err = "Could not load sample data.";
+            break;
+        }
+
+        // Both libsndfile and libaudiofile uses int for 24 bit
+        // samples. libgig however returns 3 bytes per sample, so
+        // we have to convert the wave data before writing.
+        if (job.bitdepth == 24) {
+            const uint8_t* pWave = &wave[0];
+            for (long i = 0; i < n * channels; i++) {
+#if HAVE_SNDFILE
+                intWave[i] = pWave[i * 3] << 8 | pWave[i * 3 + 1] << 16 | pWave[i * 3 + 2] << 24;
+#else
+                intWave[i] = pWave[i * 3] | pWave[i * 3 + 1] << 8 | pWave[i * 3 + 2] << 16;
+#endif
+            }
+        }
+
+        if (!writeWavFrames(wav,
+                            (job.bitdepth == 24) ? static_cast<void*>(&intWave[0]) : &wave[0],
+                            n, channels, job.bitdepth))
+        {
+            err = "Couldn't write sample data.";
+            break;
+        }
+        pos += n;
+    }
+    closeWav(wav);
+    return err;
 }
 
 #if !HAVE_SNDFILE // use libaudiofile
@@ -22,11 +22,14 @@
  ***************************************************************************/
 
 #include <typeinfo>
-#include <map>
+#include <algorithm>
 #include <string>
+#include <vector>
 #include <stdlib.h>
 #include <stdint.h>
-#include <string.h> // for strdup()
+#include <string.h>
+
+#include "helper.h"
 
 #if defined _MSC_VER // Microsoft compiler ...
 # define RAW_CPP_TYPENAME(t) t.raw_name()
@@ -36,37 +39,99 @@
 
 #define RAW_CPP_TYPENAME_OF(type) RAW_CPP_TYPENAME(typeid(type))
 
+/// Max. amount of enum types which can be declared by GIG_DECLARE_ENUM().
+#define MAX_ENUM_DECLARATIONS 64
+
+// Only records the enum's type and body source text at static
+// initialization time, the body is parsed on first use (see enumTables()).
 #define GIG_DECLARE_ENUM(type, ...) \
     enum type { __VA_ARGS__ }; \
     \
     struct type##InfoRegistrator { \
         type##InfoRegistrator() { \
-            const char* typeName = RAW_CPP_TYPENAME_OF(type); \
-            g_enumsByRawTypeName[typeName] = _parseEnumBody( #__VA_ARGS__ ); \
+            _registerEnum(RAW_CPP_TYPENAME_OF(type), #__VA_ARGS__); \
         } \
     }; \
     \
     static type##InfoRegistrator g_##type##InfoRegistrator
 
-struct EnumDeclaration {
-    std::map<size_t, std::string> nameByValue;
-    std::map<std::string, size_t> valueByName;
-    char** allKeys;
-
-    EnumDeclaration() : allKeys(NULL) {}
-
-    const size_t countKeys() const { return valueByName.size(); }
-
-    void loadAllKeys() {
-        const size_t n = valueByName.size();
-        allKeys = new char*[n + 1];
-        size_t i = 0;
-        for (std::map<std::string, size_t>::const_iterator it = valueByName.begin();
-             it != valueByName.end(); ++it, ++i)
-        {
-            allKeys[i] = strdup(it->first.c_str());
+/// Source text of an enum type as registered by GIG_DECLARE_ENUM().
+struct EnumSource {
+    const char* typeName;
+    const char* body;
+};
+
+// (POD, so it is ready before any registrator's constructor runs)
+static EnumSource g_enumSources[MAX_ENUM_DECLARATIONS];
+static size_t     g_enumSourceCount = 0;
+
+static void _registerEnum(const char* typeName, const char* body) {
+    if (g_enumSourceCount >= MAX_ENUM_DECLARATIONS) return;
+    g_enumSources[g_enumSourceCount].typeName = typeName;
+    g_enumSources[g_enumSourceCount].body     = body;
+    g_enumSourceCount++;
+}
+
+static inline uint32_t hashString(const char* s) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (; *s; ++s) h = (h ^ uint8_t(*s)) * 16777619u;
+    return h;
+}
+
+/**
+ * Maps C strings to integers by open addressing. The strings are not
+ * copied, so they must stay valid as long as the table is used.
+ */
+class StringTable {
+public:
+    StringTable() : count(0) {}
+
+    /// Adds or replaces the value of @a key.
+    void set(const char* key, size_t value) {
+        if (2 * (count + 1) > slots.size()) grow();
+        Slot& slot = find(key, hashString(key));
+        if (!slot.key) {
+            slot.key  = key;
+            slot.hash = hashString(key);
+            count++;
         }
-        allKeys[n] = NULL;
+        slot.value = value;
+    }
+
+    /// Returns the value of @a key, or NULL if @a key is unknown.
+    const size_t* get(const char* key) const {
+        if (slots.empty()) return NULL;
+        const Slot& slot = const_cast<StringTable*>(this)->find(key, hashString(key));
+        return (slot.key) ? &slot.value : NULL;
+    }
+
+    size_t size() const { return count; }
+
+private:
+    struct Slot {
+        const char* key;
+        uint32_t    hash;
+        size_t      value;
+    };
+    std::vector<Slot> slots; // size is a power of two
+    size_t            count;
+
+    Slot& find(const char* key, uint32_t hash) {
+        const size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; true; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (!slot.key || (slot.hash == hash && !strcmp(slot.key, key)))
+                return slot;
+        }
+    }
+
+    void grow() {
+        std::vector<Slot> old;
+        old.swap(slots);
+        const Slot empty = { NULL, 0, 0 };
+        slots.resize((old.empty()) ? 16 : old.size() * 2, empty);
+        for (size_t i = 0; i < old.size(); ++i)
+            if (old[i].key) find(old[i].key, old[i].hash) = old[i];
     }
 };
 
@@ -76,8 +141,36 @@ struct EnumKeyVal {
     bool isValid() const { return !name.empty(); }
 };
 
-static std::map<std::string, EnumDeclaration> g_enumsByRawTypeName;
-static std::map<std::string, size_t> g_allEnumValuesByKey;
+static bool compareValues(const std::pair<size_t,const char*>& a, const std::pair<size_t,const char*>& b) {
+    return a.first < b.first;
+}
+
+struct EnumDeclaration {
+    std::vector<EnumKeyVal>                     keys;        ///< in order of declaration
+    std::vector<std::pair<size_t,const char*> > nameByValue; ///< sorted by value
+    StringTable                                 valueByName;
+    std::vector<const char*>                    allKeys;     ///< sorted by name, NULL terminated
+
+    size_t countKeys() const { return valueByName.size(); }
+
+    const char* nameOf(size_t value) const {
+        std::vector<std::pair<size_t,const char*> >::const_iterator it =
+            std::lower_bound(nameByValue.begin(), nameByValue.end(),
+                             std::pair<size_t,const char*>(value, (const char*) NULL), compareValues);
+        return (it != nameByValue.end() && it->first == value) ? it->second : NULL;
+    }
+};
+
+struct EnumTables {
+    std::vector<EnumDeclaration> enums;
+    StringTable                  enumsByRawTypeName; ///< index into enums
+    StringTable                  allEnumValuesByKey;
+
+    const EnumDeclaration* enumOf(const char* typeName) const {
+        const size_t* index = enumsByRawTypeName.get(typeName);
+        return (index) ? &enums[*index] : NULL;
+    }
+};
 
 
 
@@ -144,22 +237,70 @@ static EnumKeyVal _parseEnumKeyVal(const char* start, const char* end, size_t va
     return keyval;
 }
 
-static EnumDeclaration _parseEnumBody(const char* body) {
-    EnumDeclaration decl;
+static bool compareNames(const char* a, const char* b) {
+    return strcmp(a, b) < 0;
+}
+
+
+static void _parseEnumBody(const char* body, EnumDeclaration& decl) {
     size_t value = 0;
     for (const char* a = body, *b = body; true; ++b) {
         if (*b == 0 || *b == ',') {
             const EnumKeyVal keyval = _parseEnumKeyVal(a, b, value);
             if (!keyval.isValid()) break;
-            decl.nameByValue[keyval.value] = keyval.name;
-            decl.valueByName[keyval.name] = keyval.value;
-            g_allEnumValuesByKey[keyval.name] = keyval.value;
+            decl.keys.push_back(keyval);
             value = keyval.value + 1;
             if (*b == 0) break;
             a = b + 1;
         }
     }
-    return decl;
+}
+
+// Parses the bodies of all enums registered by GIG_DECLARE_ENUM() and
+// builds their lookup tables (unless done before). For several elements
+// with the same name or value, the one declared last wins.
+static void _buildEnumTables(EnumTables& tables) {
+    tables.enums.resize(g_enumSourceCount);
+    for (size_t i = 0; i < g_enumSourceCount; ++i)
+        _parseEnumBody(g_enumSources[i].body, tables.enums[i]);
+    // (keys are not moved anymore from here on)
+    for (size_t i = 0; i < g_enumSourceCount; ++i) {
+        EnumDeclaration& decl = tables.enums[i];
+        tables.enumsByRawTypeName.set(g_enumSources[i].typeName, i);
+        for (size_t k = 0; k < decl.keys.size(); ++k) {
+            const char* name = decl.keys[k].name.c_str();
+            const size_t value = decl.keys[k].value;
+            decl.valueByName.set(name, value);
+            tables.allEnumValuesByKey.set(name, value);
+        }
+        for (size_t k = decl.keys.size(); k-- > 0; ) {
+            const char* name = decl.keys[k].name.c_str();
+            decl.nameByValue.push_back(std::make_pair(decl.keys[k].value, name));
+            if (*decl.valueByName.get(name) == decl.keys[k].value)
+                decl.allKeys.push_back(name); // (unless redeclared later)
+        }
+        // stable sort keeps the last declared name of each value first
+        std::stable_sort(decl.nameByValue.begin(), decl.nameByValue.end(), compareValues);
+        std::sort(decl.allKeys.begin(), decl.allKeys.end(), compareNames);
+        decl.allKeys.push_back(NULL);
+    }
+}
+
+static EnumTables* volatile g_pEnumTables = NULL;
+static mutex_t     g_enumTablesMutex;
+
+static const EnumTables& enumTables() {
+    EnumTables* pTables = __atomicLoadAcquire(g_pEnumTables);
+    if (!pTables) {
+        mutex_lock_t lock(g_enumTablesMutex);
+        pTables = g_pEnumTables;
+        if (!pTables) {
+            pTables = new EnumTables;
+            _buildEnumTables(*pTables);
+            __atomicStoreRelease(g_pEnumTables, pTables);
+        }
+    }
+    return *pTables;
 }
 
 #include "gig.h"
@@ -188,9 +329,8 @@ namespace gig {
      * @returns enum's amount of elements
      */
     size_t enumCount(String typeName) {
-        if (!g_enumsByRawTypeName.count(typeName))
-            return 0;
-        return g_enumsByRawTypeName[typeName].countKeys();
+        const EnumDeclaration* decl = enumTables().enumOf(typeName.c_str());
+        return (decl) ? decl->countKeys() : 0;
     }
 
     /** @brief Amount of elements in given enum type.
@@ -204,7 +344,8 @@ namespace gig {
      * @returns enum's amount of elements
      */
     size_t enumCount(const std::type_info& type) {
-        return enumCount(RAW_CPP_TYPENAME(type));
+        const EnumDeclaration* decl = enumTables().enumOf(RAW_CPP_TYPENAME(type));
+        return (decl) ? decl->countKeys() : 0;
     }
 
     /** @brief Numeric value of enum constant.
@@ -217,9 +358,8 @@ namespace gig {
      * @returns enum constant's numeric value
      */
     size_t enumValue(String key) {
-        if (!g_allEnumValuesByKey.count(key))
-            return 0;
-        return g_allEnumValuesByKey[key];
+        const size_t* value = enumTables().allEnumValuesByKey.get(key.c_str());
+        return (value) ? *value : 0;
     }
 
     /** @brief Check if enum element exists.
@@ -237,9 +377,8 @@ namespace gig {
      * @returns @c true if requested enum element exists
      */
     bool enumKey(String typeName, String key) {
-        if (!g_enumsByRawTypeName.count(typeName))
-            return false;
-        return g_enumsByRawTypeName[typeName].valueByName.count(key);
+        const EnumDeclaration* decl = enumTables().enumOf(typeName.c_str());
+        return decl && decl->valueByName.get(key.c_str());
     }
 
     /** @brief Check if enum element exists.
@@ -255,7 +394,8 @@ namespace gig {
      * @returns @c true if requested enum element exists
      */
     bool enumKey(const std::type_info& type, String key) {
-        return enumKey(RAW_CPP_TYPENAME(type), key);
+        const EnumDeclaration* decl = enumTables().enumOf(RAW_CPP_TYPENAME(type));
+        return decl && decl->valueByName.get(key.c_str());
     }
 
     /** @brief Enum constant name of numeric value.
@@ -278,11 +418,8 @@ namespace gig {
      * @returns @c true if requested enum element exists
      */
     const char* enumKey(String typeName, size_t value) {
-        if (!g_enumsByRawTypeName.count(typeName))
-            return NULL;
-        if (!g_enumsByRawTypeName[typeName].nameByValue.count(value))
-            return NULL;
-        return g_enumsByRawTypeName[typeName].nameByValue[value].c_str();
+        const EnumDeclaration* decl = enumTables().enumOf(typeName.c_str());
+        return (decl) ? decl->nameOf(value) : NULL;
     }
 
     /** @brief Enum constant name of numeric value.
@@ -303,7 +440,8 @@ namespace gig {
      * @returns @c true if requested enum element exists
      */
     const char* enumKey(const std::type_info& type, size_t value) {
-        return enumKey(RAW_CPP_TYPENAME(type), value);
+        const EnumDeclaration* decl = enumTables().enumOf(RAW_CPP_TYPENAME(type));
+        return (decl) ? decl->nameOf(value) : NULL;
     }
 
     /** @brief All element names of enum type.
@@ -321,11 +459,8 @@ namespace gig {
      * @returns list of all enum element names
      */
     const char** enumKeys(String typeName) {
-        if (!g_enumsByRawTypeName.count(typeName))
-            return NULL;
-        if (!g_enumsByRawTypeName[typeName].allKeys)
-            g_enumsByRawTypeName[typeName].loadAllKeys();
-        return (const char**) g_enumsByRawTypeName[typeName].allKeys;
+        const EnumDeclaration* decl = enumTables().enumOf(typeName.c_str());
+        return (decl) ? const_cast<const char**>(&decl->allKeys[0]) : NULL;
     }
 
     /** @brief All element names of enum type.
@@ -340,7 +475,8 @@ namespace gig {
      * @returns list of all enum element names
      */
     const char** enumKeys(const std::type_info& type) {
-        return enumKeys(RAW_CPP_TYPENAME(type));
+        const EnumDeclaration* decl = enumTables().enumOf(RAW_CPP_TYPENAME(type));
+        return (decl) ? const_cast<const char**>(&decl->allKeys[0]) : NULL;
     }
 
 } // namespace gig